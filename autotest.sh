@@ -256,9 +256,220 @@ write_mpps_config() {
 
 
 
+##################################################################################
+#perf regression gate: ./autotest.sh perf [update]
+#
+#Builds and runs the DP capacity benchmark (dp/run_bench.sh), the simu_cp
+#session setup load test (dp/run.sh) and the DP kernel microbenchmarks
+#(dp/run_microbench.sh), and compares their metrics with a baseline of
+#this CPU model in $PERF_BASELINE_DIR. Fails if a metric is more than
+#PERF_THRESHOLD percent worse. With update, or without a baseline, the
+#results become the new baseline. Results are written to
+#$LOG_DIR/$DATE/perf_results.txt (name value baseline change status) and
+#perf_results.json.
+#
+#Metrics whose names end in _us or _cpp are better lower, all others are
+#better higher.
+
+PERF_THRESHOLD=${PERF_THRESHOLD:-10}
+PERF_BASELINE_DIR=${PERF_BASELINE_DIR:-$NGIC_DIR/config/perf_baseline}
+PERF_TIMEOUT=${PERF_TIMEOUT:-900}
+PERF_LOAD_THREADS=${PERF_LOAD_THREADS:-4}
+PERF_LOAD_SESSIONS=${PERF_LOAD_SESSIONS:-100000}
+#microbench burst size tracked
+PERF_MB_BURST=${PERF_MB_BURST:-32}
+PERF_METRICS=$LOG_DIR/$DATE/perf_metrics.txt
+
+perf_cpu_model() {
+	grep -m1 "model name" /proc/cpuinfo | cut -d: -f2 | \
+		sed -e 's/^ *//' -e 's/[^A-Za-z0-9]\+/_/g' -e 's/_$//'
+}
+
+perf_clean() {
+	pushd $NGIC_DIR/dp > /dev/null
+	make clean &> /dev/null
+	popd > /dev/null
+	#objects built outside of dp/build are not cleaned by make clean
+	find $NGIC_DIR/dp/pipeline $NGIC_DIR/interface $NGIC_DIR/cp_dp_api \
+		$NGIC_DIR/test/simu_cp -name "*.o" -delete
+}
+
+#build the DP with the given flags on top of those of dp/Makefile
+perf_build() {
+	local NAME=$1
+	shift
+	echo "perf: building DP with $*"
+	perf_clean
+	pushd $NGIC_DIR/dp > /dev/null
+	make EXTRA_CFLAGS="$*" &> $LOG_DIR/$DATE/perf_$NAME.build.log
+	local RET=$?
+	popd > /dev/null
+	if [[ $RET -ne 0 ]] ; then echo "perf: $NAME build failed - check $LOG_DIR/$DATE/perf_$NAME.build.log" ; fi
+	return $RET
+}
+
+#Mpps per worker and cycles per pkt of the capacity benchmark
+perf_bench() {
+	perf_build bench -DSIMU_CP -DDP_BENCH || return 1
+	pushd $NGIC_DIR/dp > /dev/null
+	rm -f logs/bench_report.txt
+	timeout $PERF_TIMEOUT ./run_bench.sh </dev/null &> $LOG_DIR/$DATE/perf_bench.dp.log
+	if [ ! -f logs/bench_report.txt ]; then
+		echo "perf: no bench report - check $LOG_DIR/$DATE/perf_bench.dp.log"
+		popd > /dev/null
+		return 1
+	fi
+	cp logs/bench_report.txt $LOG_DIR/$DATE/perf_bench_report.txt
+	popd > /dev/null
+	awk -v w=$NUM_WORKER '
+		$1 == "mpps" { printf "bench_mpps_per_worker %.3f\n", $2 / w }
+		$1 == "cycles_per_pkt" { printf "bench_cpp %s\n", $2 }' \
+		$LOG_DIR/$DATE/perf_bench_report.txt >> $PERF_METRICS
+}
+
+#attach rate of the simu_cp session setup load test, sessions applied
+#as fast as the DP takes them. Runs on a copy of simu_cp.cfg, the DP is
+#built to read it.
+perf_load() {
+	local CFG=$LOG_DIR/$DATE/perf_load.simu_cp.cfg
+	local LOG=$LOG_DIR/$DATE/perf_load.dp.log
+
+	cp $NGIC_DIR/config/simu_cp.cfg $CFG
+	sed -i -e "/^\[load\]/,/^\[/{
+		s/^threads = .*/threads = $PERF_LOAD_THREADS/
+		s/^sessions = .*/sessions = $PERF_LOAD_SESSIONS/
+		s/^step = .*/step = 0/
+		s/^rate = .*/rate = 0/
+		s/^ramp_sec = .*/ramp_sec = 0/
+		s/^hold_sec = .*/hold_sec = 0/
+		s/^cycles = .*/cycles = 1/
+	}" $CFG
+	perf_build load -DSIMU_CP -DSIMU_CP_LOAD "-DSIMU_CP_FILE=\\\"$CFG\\\"" || return 1
+
+	pushd $NGIC_DIR/dp > /dev/null
+	#own session, run.sh and the DP it starts are process group $PID
+	setsid stdbuf -oL -eL ./run.sh </dev/null &> $LOG &
+	local PID=$!
+	for ((i = 0; i < PERF_TIMEOUT; i++)); do
+		sleep 1
+		if grep -q "simu_cp load: done" $LOG; then break; fi
+		if ! kill -0 $PID 2> /dev/null; then break; fi
+	done
+	kill -- -$PID 2> /dev/null
+	wait $PID
+	popd > /dev/null
+
+	if ! grep -q "simu_cp load: done" $LOG; then
+		echo "perf: session setup load test did not finish - check $LOG"
+		return 1
+	fi
+	grep "simu_cp load: cycle [0-9]* attach" $LOG | \
+		sed -e 's/.*, \([0-9.]*\)\/s,.*/sess_setup_per_sec \1/' >> $PERF_METRICS
+}
+
+#ACL build time of the largest rule count, CDR export rate, and cycles
+#per pkt of each kernel and level at PERF_MB_BURST
+perf_microbench() {
+	perf_build microbench -DDP_MICROBENCH || return 1
+	pushd $NGIC_DIR/dp > /dev/null
+	timeout $PERF_TIMEOUT ./run_microbench.sh </dev/null &> $LOG_DIR/$DATE/perf_microbench.dp.log
+	popd > /dev/null
+	awk -v b=$PERF_MB_BURST '
+		$2 == "TSC" { hz = $3 }
+		$2 == "acl_build" { acl = $4 }
+		$4 == "burst" && $5 == b":" {
+			lvl = $3
+			gsub(/[^A-Za-z0-9]/, "", lvl)
+			printf "mb_%s%s_cpp %s\n", $2, (lvl == "") ? "" : "_" lvl, $8
+			if ($2 == "cdr" && $8 > 0)
+				cdr = hz / $8
+		}
+		END {
+			if (acl != "")
+				printf "acl_build_us %s\n", acl
+			if (cdr != "")
+				printf "cdr_export_per_sec %.0f\n", cdr
+		}' $LOG_DIR/$DATE/perf_microbench.dp.log >> $PERF_METRICS
+	if ! grep -q "^acl_build_us" $PERF_METRICS; then
+		echo "perf: no microbench results - check $LOG_DIR/$DATE/perf_microbench.dp.log"
+		return 1
+	fi
+}
+
+#compare PERF_METRICS with baseline $1, write the results and return the
+#number of regressions
+perf_compare() {
+	local BASELINE=$1
+
+	awk -v t=$PERF_THRESHOLD '
+		NR == FNR { base[$1] = $2; next }
+		{
+			b = ($1 in base) ? base[$1] : ""
+			chg = 0
+			st = "new"
+			if (b != "" && b > 0) {
+				chg = ($2 - b) * 100 / b
+				#positive is better
+				if ($1 ~ /_(us|cpp)$/)
+					chg = -chg
+				st = (chg < -t) ? "regressed" : "ok"
+			}
+			if (st == "regressed")
+				n++
+			printf "%s %s %s %.1f %s\n", $1, $2, (b == "") ? "-" : b, chg, st
+		}
+		END { exit n > 125 ? 125 : n }' $BASELINE $PERF_METRICS \
+		> $LOG_DIR/$DATE/perf_results.txt
+	local RET=$?
+
+	awk -v cpu="$(perf_cpu_model)" -v t=$PERF_THRESHOLD -v r=$RET '
+		BEGIN { printf "{\n  \"cpu\": \"%s\",\n  \"threshold_pct\": %s,\n  \"regressions\": %d,\n  \"metrics\": [", cpu, t, r }
+		{
+			printf "%s\n    {\"name\": \"%s\", \"value\": %s, \"baseline\": %s, \"change_pct\": %s, \"status\": \"%s\"}", \
+				(NR > 1) ? "," : "", $1, $2, ($3 == "-") ? "null" : $3, $4, $5
+		}
+		END { printf "\n  ]\n}\n" }' $LOG_DIR/$DATE/perf_results.txt \
+		> $LOG_DIR/$DATE/perf_results.json
+	return $RET
+}
+
+perf_gate() {
+	local BASELINE=$PERF_BASELINE_DIR/$(perf_cpu_model).txt
+	local FAILED=0
+
+	rm -f $PERF_METRICS
+	perf_bench || FAILED=1
+	perf_load || FAILED=1
+	perf_microbench || FAILED=1
+	touch $PERF_METRICS
+	#leave a default DP build behind
+	perf_clean
+	verify_source_build
+
+	if [ "$1" == "update" ] || [ ! -f $BASELINE ]; then
+		mkdir -p $PERF_BASELINE_DIR
+		cp $PERF_METRICS $BASELINE
+		echo "perf: baseline $BASELINE updated"
+	fi
+	perf_compare $BASELINE
+	local REGRESSED=$?
+
+	column -t $LOG_DIR/$DATE/perf_results.txt
+	echo "perf: results in $LOG_DIR/$DATE/perf_results.json"
+	if [[ $FAILED -ne 0 ]] ; then echo "perf: FAILED - a benchmark did not run" ; return 1 ; fi
+	if [[ $REGRESSED -ne 0 ]] ; then echo "perf: FAILED - $REGRESSED metrics regressed more than $PERF_THRESHOLD%" ; return 1 ; fi
+	echo "perf: PASSED"
+	return 0
+}
+
 #syntax:
 #run_testcase (tc_userplane_mpps.ngl | tc_pcc_tft_mpps.ntl) (./cfg | $(write_mpps_config $TESTNAME $NUM_UES $S11_RATE $NUM_RANS $PPS $BPS $TST_DURATION $ACTIVE_BEARER_TM_IN_MS)) $NUM_WORKERS
 
+if [ "$1" == "perf" ]; then
+	perf_gate $2
+	exit $?
+fi
+
 if [ $# -eq 1 ]; then 
 	if [ "$1" == "short" ]; then 
 	for j in {900000,1000000,1100000}; do
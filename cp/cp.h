@@ -17,7 +17,11 @@
 #ifndef _CP_H_
 #define _CP_H_
 
+#include <stdint.h>
 #include <pcap.h>
+#include <netinet/in.h>
+
+#include "cp_worker.h"
 /**
  * @file
  *
@@ -43,6 +47,10 @@ extern enum cp_config spgw_cfg;
 struct cp_params {
 	unsigned stats_core_id;
 	unsigned nb_core_id;
+#ifdef CP_WORKERS
+	unsigned nb_workers;
+	unsigned worker_core_id[CP_MAX_WORKERS];
+#endif
 };
 
 extern pcap_dumper_t *pcap_dumper;
@@ -81,4 +89,21 @@ initialize_tables_on_dp(void);
 void
 control_plane(void);
 
+#if defined(GTPC_BATCH) || defined(CP_WORKERS)
+/**
+ * Processes a GTPv2c message received on s11 or s5s8, writes response
+ * message (if any) to its sender
+ * @param fd
+ *   socket the message was received on
+ * @param peer
+ *   sender of the message
+ * @param buf
+ *   message
+ * @param len
+ *   length of message
+ */
+void
+cp_process_msg(int fd, const struct sockaddr_in *peer, uint8_t *buf, int len);
+#endif
+
 #endif
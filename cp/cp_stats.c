@@ -23,6 +23,7 @@
 #include "nb.h"
 #endif
 #include "cp_stats.h"
+#include "cp_telemetry.h"
 
 struct cp_stats_t cp_stats;
 
@@ -126,6 +127,11 @@ struct stat_entry_t stat_entries[] = {
 	DEFINE_VALUE_STAT(8, &cp_stats.rel_access_bearer, "rel acc", "bearer"),
 	DEFINE_VALUE_STAT(8, &cp_stats.ddn, "",	"ddn"),
 	DEFINE_VALUE_STAT(8, &cp_stats.ddn_ack, "ddn", "ack"),
+	DEFINE_VALUE_STAT(8, &cp_stats.sess_reclaim, "dp", "reclaim"),
+#ifdef GTPC_TIMERS
+	DEFINE_VALUE_STAT(8, &cp_stats.retransmit, "", "retx"),
+	DEFINE_VALUE_STAT(8, &cp_stats.timeout, "req", "timeout"),
+#endif
 #ifdef SDN_ODL_BUILD
 	DEFINE_VALUE_STAT(8, &cp_stats.nb_sent, "nb", "sent"),
 	DEFINE_LAMBDA_STAT(8, nb_ok_delta, "nb ok", "delta"),
@@ -172,6 +178,9 @@ do_stats(__rte_unused void *ptr)
 		if (dpn_id)
 #endif
 			print_stat_entries();
+#ifdef CP_MSG_STATS
+		cp_telemetry_poll();
+#endif
 
 		sleep(1);
 	}
@@ -42,7 +42,12 @@ struct cp_stats_t {
 	uint64_t delete_bearer;
 	uint64_t ddn;
 	uint64_t ddn_ack;
+	uint64_t sess_reclaim;
 	uint64_t echo;
+#ifdef GTPC_TIMERS
+	uint64_t retransmit;
+	uint64_t timeout;
+#endif
 	uint64_t rx;
 	uint64_t tx;
 	uint64_t rx_last;
@@ -56,6 +61,13 @@ struct cp_stats_t {
 
 extern struct cp_stats_t cp_stats;
 
+#ifdef CP_WORKERS
+/* counters are updated by all CP workers */
+#define CP_STATS_INC(field) __sync_fetch_and_add(&cp_stats.field, 1)
+#else
+#define CP_STATS_INC(field) (++cp_stats.field)
+#endif
+
 /**
  * Prints control plane signaling message statistics
  *
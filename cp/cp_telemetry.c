@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef CP_MSG_STATS
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_debug.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#include "cp_stats.h"
+#include "cp_telemetry.h"
+
+/**
+ * @brief counters of an lcore, and the message it is processing
+ */
+struct cp_msg_lcore {
+	uint64_t start_tsc;
+	uint64_t cycles[CP_TM_PHASES];
+	struct cp_tm_msg msg[CP_TM_MSG_TYPES];
+};
+
+/** Counters of each lcore, allocated on first use */
+static struct cp_msg_lcore *cp_msg_tbl[RTE_MAX_LCORE];
+static struct cp_telemetry *cp_tm;
+
+/**
+ * Get counters of calling lcore.
+ */
+static struct cp_msg_lcore *
+cp_msg_get(void)
+{
+	unsigned lcore_id = rte_lcore_id();
+	struct cp_msg_lcore *l = cp_msg_tbl[lcore_id];
+
+	if (likely(l != NULL))
+		return l;
+
+	l = rte_zmalloc_socket("cp_msg_stats", sizeof(struct cp_msg_lcore),
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (l == NULL)
+		rte_panic("lcore %u: Failed to allocate message stats\n",
+				lcore_id);
+	cp_msg_tbl[lcore_id] = l;
+	return l;
+}
+
+static inline unsigned
+cp_tm_bucket(uint64_t cycles)
+{
+	unsigned b = 63 - __builtin_clzll(cycles | 1);
+
+	return b < CP_TM_HIST_BUCKETS ? b : CP_TM_HIST_BUCKETS - 1;
+}
+
+void
+cp_msg_begin(void)
+{
+	struct cp_msg_lcore *l = cp_msg_get();
+
+	l->cycles[CP_TM_DP_SEND] = 0;
+	l->cycles[CP_TM_NB_SEND] = 0;
+	l->start_tsc = rte_rdtsc();
+}
+
+void
+cp_msg_send_time(enum cp_tm_phase phase, uint64_t cycles)
+{
+	cp_msg_get()->cycles[phase] += cycles;
+}
+
+void
+cp_msg_end(uint8_t type, int ret)
+{
+	struct cp_msg_lcore *l = cp_msg_get();
+	struct cp_tm_msg *m = &l->msg[type];
+	unsigned phase;
+
+	l->cycles[CP_TM_TOTAL] = rte_rdtsc() - l->start_tsc;
+
+	m->rx++;
+	if (ret == 0) {
+		m->accepted++;
+	} else {
+		m->rejected++;
+		m->cause[(ret > 0 && ret < CP_TM_CAUSES) ? ret : 0]++;
+	}
+	for (phase = 0; phase < CP_TM_PHASES; phase++) {
+		m->cycles[phase] += l->cycles[phase];
+		m->hist[phase][cp_tm_bucket(l->cycles[phase])]++;
+	}
+}
+
+void
+cp_telemetry_init(void)
+{
+	int fd;
+
+	fd = shm_open(CP_TM_SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		rte_panic("Failed to open shm %s - %s\n", CP_TM_SHM_NAME,
+				strerror(errno));
+	if (ftruncate(fd, sizeof(*cp_tm)) < 0)
+		rte_panic("Failed to size shm %s - %s\n", CP_TM_SHM_NAME,
+				strerror(errno));
+	cp_tm = mmap(NULL, sizeof(*cp_tm), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (cp_tm == MAP_FAILED)
+		rte_panic("Failed to map shm %s - %s\n", CP_TM_SHM_NAME,
+				strerror(errno));
+
+	/* a restarted CP keeps the object, seq stays monotonic for
+	 * collectors that did not remap */
+	cp_tm->seq |= 1;
+	rte_smp_wmb();
+	memset(&cp_tm->tsc, 0, sizeof(*cp_tm) -
+			offsetof(struct cp_telemetry, tsc));
+	memcpy(cp_tm->magic, CP_TM_MAGIC, sizeof(cp_tm->magic));
+	cp_tm->version = CP_TM_VERSION;
+	cp_tm->size = sizeof(*cp_tm);
+	cp_tm->tsc_hz = rte_get_tsc_hz();
+	rte_smp_wmb();
+	cp_tm->seq++;
+
+	printf("Telemetry published to shm %s, %zu bytes\n",
+			CP_TM_SHM_NAME, sizeof(*cp_tm));
+}
+
+static void
+tm_msg_add(struct cp_tm_msg *d, const struct cp_tm_msg *s)
+{
+	unsigned phase, i;
+
+	d->rx += s->rx;
+	d->accepted += s->accepted;
+	d->rejected += s->rejected;
+	for (phase = 0; phase < CP_TM_PHASES; phase++) {
+		d->cycles[phase] += s->cycles[phase];
+		for (i = 0; i < CP_TM_HIST_BUCKETS; i++)
+			d->hist[phase][i] += s->hist[phase][i];
+	}
+	for (i = 0; i < CP_TM_CAUSES; i++)
+		d->cause[i] += s->cause[i];
+}
+
+void
+cp_telemetry_poll(void)
+{
+	unsigned lcore, type;
+
+	if (cp_tm == NULL)
+		return;
+
+	cp_tm->seq++;
+	rte_smp_wmb();
+	memset(cp_tm->msg, 0, sizeof(cp_tm->msg));
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		const struct cp_msg_lcore *l = cp_msg_tbl[lcore];
+
+		if (l == NULL)
+			continue;
+		for (type = 0; type < CP_TM_MSG_TYPES; type++)
+			if (l->msg[type].rx)
+				tm_msg_add(&cp_tm->msg[type], &l->msg[type]);
+	}
+	cp_tm->rx = cp_stats.rx;
+	cp_tm->tx = cp_stats.tx;
+	cp_tm->tsc = rte_rdtsc();
+	cp_tm->updates++;
+	rte_smp_wmb();
+	cp_tm->seq++;
+}
+#endif /* CP_MSG_STATS */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CP_TELEMETRY_H
+#define CP_TELEMETRY_H
+
+/**
+ * @file
+ *
+ * Per GTPv2c message type counters and latency histograms of the Control
+ * Plane, and the layout of the region they are published in.
+ *
+ * Each lcore processing GTPv2c messages counts the messages it received,
+ * accepted and rejected by cause, per message type, and samples the
+ * cycles from the decode of a message to its response: in total, sending
+ * to the DP (the CP-DP API calls) and sending to the NB controller. The
+ * DP and NB replies are asynchronous and are not waited for. The
+ * stats lcore sums the lcores into the POSIX shared memory object
+ * CP_TM_SHM_NAME every second. As with the DP telemetry region, seq is odd
+ * while an update is in progress, so a reader copies the region and
+ * retries if seq was odd or changed meanwhile; the layout only depends on
+ * this file and any change to it bumps CP_TM_VERSION. cp_tmdump.py is a
+ * reference reader.
+ */
+#include <stdint.h>
+
+#define CP_TM_SHM_NAME		"/ngic_cp_telemetry"
+#define CP_TM_MAGIC		"NGICCPTM"
+#define CP_TM_VERSION		1
+
+#define CP_TM_MSG_TYPES		256
+#define CP_TM_CAUSES		256
+#define CP_TM_HIST_BUCKETS	32
+
+/**
+ * Phases of the processing of a message, each with its histogram
+ */
+enum cp_tm_phase {
+	CP_TM_TOTAL,		/** decode to response */
+	CP_TM_DP_SEND,		/** sending to the DP */
+	CP_TM_NB_SEND,		/** sending to the NB controller */
+	CP_TM_PHASES
+};
+
+/**
+ * Counters of a message type.
+ */
+struct cp_tm_msg {
+	uint64_t rx;
+	uint64_t accepted;
+	uint64_t rejected;
+	uint64_t cycles[CP_TM_PHASES];
+	/** log2 of the cycles of each message */
+	uint64_t hist[CP_TM_PHASES][CP_TM_HIST_BUCKETS];
+	/** rejected by GTPv2c cause, 0 for the errors of the CP itself */
+	uint64_t cause[CP_TM_CAUSES];
+};
+
+/**
+ * Telemetry region.
+ */
+struct cp_telemetry {
+	char magic[8];
+	uint32_t version;
+	uint32_t size;			/** bytes of the region */
+	uint64_t tsc_hz;
+	volatile uint64_t seq;		/** odd while being updated */
+	uint64_t tsc;			/** tsc of last update */
+	uint64_t updates;
+	uint64_t rx;			/** cp_stats.rx */
+	uint64_t tx;			/** cp_stats.tx */
+	struct cp_tm_msg msg[CP_TM_MSG_TYPES];
+};
+
+#ifdef CP_MSG_STATS
+/**
+ * Creates and maps the telemetry region.
+ */
+void
+cp_telemetry_init(void);
+
+/**
+ * Publishes the counters of all lcores. Called by the stats lcore.
+ */
+void
+cp_telemetry_poll(void);
+
+/**
+ * Starts the accounting of a message received by the calling lcore.
+ */
+void
+cp_msg_begin(void);
+
+/**
+ * Accounts cycles the message of the calling lcore spent sending.
+ * @param phase
+ *   CP_TM_DP_SEND or CP_TM_NB_SEND
+ * @param cycles
+ *   tsc cycles of the send
+ */
+void
+cp_msg_send_time(enum cp_tm_phase phase, uint64_t cycles);
+
+/**
+ * Ends the accounting of the message of cp_msg_begin().
+ * @param type
+ *   GTPv2c message type
+ * @param ret
+ *   0 if accepted, GTPv2c cause (> 0) or -errno if rejected
+ */
+void
+cp_msg_end(uint8_t type, int ret);
+#endif /* CP_MSG_STATS */
+#endif /* CP_TELEMETRY_H */
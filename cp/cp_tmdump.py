@@ -0,0 +1,107 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2017 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Print a consistent snapshot of the CP telemetry region (cp/cp_telemetry.h)
+# as JSON, with the mean and percentiles of each latency phase in us:
+#   cp_tmdump.py [/dev/shm/ngic_cp_telemetry]
+
+import sys
+import json
+import mmap
+import struct
+import time
+
+VERSION = 1
+MSG_TYPES = 256
+CAUSES = 256
+HIST = 32
+PHASES = ('total', 'dp_send', 'nb_send')
+
+HDR = '<8sIIQQQQQQ'
+MSG = '<3Q%dQ%dQ%dQ' % (len(PHASES), len(PHASES) * HIST, CAUSES)
+SEQ_OFF = 24
+
+NAMES = {1: 'echo_req', 2: 'echo_rsp', 32: 'create_session_req',
+         33: 'create_session_rsp', 34: 'modify_bearer_req',
+         36: 'delete_session_req', 37: 'delete_session_rsp',
+         68: 'bearer_resource_cmd', 96: 'create_bearer_rsp',
+         100: 'delete_bearer_rsp', 170: 'release_access_bearers_req',
+         177: 'ddn_ack'}
+
+def percentile(hist, hz, p):
+  # upper bound of the log2 bucket holding the p-th percentile
+  total = sum(hist)
+  seen = 0
+  for b, n in enumerate(hist):
+    seen += n
+    if seen * 100 >= total * p:
+      return round((2 ** (b + 1)) * 1e6 / hz, 3)
+  return 0
+
+def msg(v, hz):
+  rx, accepted, rejected = v[0:3]
+  cycles = v[3:3 + len(PHASES)]
+  hist = v[3 + len(PHASES):3 + len(PHASES) * (HIST + 1)]
+  cause = v[3 + len(PHASES) * (HIST + 1):]
+  out = {'rx': rx, 'accepted': accepted, 'rejected': rejected,
+         'rejected_by_cause': dict((str(c), n) for c, n in enumerate(cause)
+                                   if n)}
+  for i, name in enumerate(PHASES):
+    h = hist[i * HIST:(i + 1) * HIST]
+    out[name] = {'mean_us': round(cycles[i] * 1e6 / hz / rx, 3),
+                 'p50_us': percentile(h, hz, 50),
+                 'p99_us': percentile(h, hz, 99),
+                 'hist': list(h)}
+  return out
+
+def parse(buf):
+  (magic, version, size, hz, seq, tsc, updates,
+   rx, tx) = struct.unpack_from(HDR, buf, 0)
+  if magic != b'NGICCPTM' or version != VERSION:
+    raise ValueError('not a version %u CP telemetry region' % VERSION)
+  out = {'tsc_hz': hz, 'tsc': tsc, 'updates': updates, 'rx': rx, 'tx': tx,
+         'msgs': {}}
+
+  off = struct.calcsize(HDR)
+  msz = struct.calcsize(MSG)
+  for t in range(MSG_TYPES):
+    v = struct.unpack_from(MSG, buf, off + t * msz)
+    if v[0]:
+      out['msgs'][NAMES.get(t, str(t))] = msg(v, hz)
+  off += MSG_TYPES * msz
+
+  if off != size:
+    raise ValueError('region size %u, layout %u' % (size, off))
+  return out
+
+def snapshot(m):
+  while True:
+    seq = struct.unpack_from('<Q', m, SEQ_OFF)[0]
+    if seq & 1:
+      time.sleep(0.001)
+      continue
+    buf = m[:]
+    if struct.unpack_from('<Q', m, SEQ_OFF)[0] == seq:
+      return buf
+
+def main():
+  path = sys.argv[1] if len(sys.argv) > 1 else '/dev/shm/ngic_cp_telemetry'
+  with open(path, 'rb') as f:
+    m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    print(json.dumps(parse(snapshot(m)), indent=1))
+
+if __name__ == '__main__':
+  main()
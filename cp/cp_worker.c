@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef CP_WORKERS
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_debug.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_jhash.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_udp.h>
+
+#include "gtpv2c.h"
+#include "gtpv2c_ie.h"
+#include "debug_str.h"
+#include "ue.h"
+#include "cp.h"
+#include "cp_worker.h"
+#include "gtpc_timer.h"
+#include "vepc_cp_dp_api.h"
+
+#define RTE_LOGTYPE_CP RTE_LOGTYPE_USER4
+
+/** s11, s5s8 sgwc and s5s8 pgwc sockets */
+#define CP_NB_FD                     (3)
+/** Per lcore cache of the message pool */
+#define CP_WORKER_POOL_CACHE         (CP_WORKER_BURST * 2)
+
+extern const uint32_t s11_sgw_gtpc_base_teid;
+extern const uint32_t s5s8_pgw_gtpc_base_teid;
+
+/**
+ * GTPv2c message or DDN queued to a worker
+ */
+struct cp_worker_msg {
+	int fd;                      /* socket received on, -1 for a DDN */
+	int len;
+	uint64_t sess_id;            /* session of a DDN */
+	struct sockaddr_in peer;
+	uint8_t buf[MAX_GTPV2C_UDP_LEN];
+};
+
+struct cp_worker {
+	unsigned id;
+	unsigned lcore;
+	struct rte_ring *ring;
+	uint64_t drops;              /* ring full */
+} __rte_cache_aligned;
+
+unsigned cp_nb_workers;
+static struct cp_worker cp_workers[CP_MAX_WORKERS];
+static struct rte_mempool *cp_msg_pool;
+
+unsigned
+cp_teid_shard(uint32_t teid)
+{
+	uint32_t base = (spgw_cfg == PGWC) ? s5s8_pgw_gtpc_base_teid
+			: s11_sgw_gtpc_base_teid;
+
+	return (teid - base) % cp_nb_workers;
+}
+
+/**
+ * Worker of a message. Malformed messages go to worker 0, which drops
+ * them as the single threaded CP does.
+ */
+static unsigned
+cp_msg_shard(struct cp_worker_msg *m)
+{
+	gtpv2c_header *gtpv2c_rx = (gtpv2c_header *) m->buf;
+	gtpv2c_ie *current_ie;
+	gtpv2c_ie *limit_ie;
+
+	if (m->fd < 0)
+		return cp_teid_shard(UE_SESS_ID(m->sess_id));
+
+	if ((unsigned)m->len < sizeof(gtpv2c_rx->gtpc) ||
+			(unsigned)m->len != ntohs(gtpv2c_rx->gtpc.length)
+			+ sizeof(gtpv2c_rx->gtpc))
+		return 0;
+
+	/* teids are sent in host order by the CP */
+	if (gtpv2c_rx->gtpc.teidFlg && gtpv2c_rx->teid_u.has_teid.teid)
+		return cp_teid_shard(gtpv2c_rx->teid_u.has_teid.teid);
+
+	FOR_EACH_GTPV2C_IE(gtpv2c_rx, current_ie, limit_ie) {
+		if (current_ie->type == IE_IMSI)
+			return rte_jhash(current_ie + 1,
+					ntohs(current_ie->length), 0)
+					% cp_nb_workers;
+	}
+	return 0;
+}
+
+static void
+cp_worker_enqueue(struct cp_worker_msg *m)
+{
+	struct cp_worker *w = &cp_workers[cp_msg_shard(m)];
+
+	if (rte_ring_mp_enqueue(w->ring, m) == -ENOBUFS) {
+		/* every receiving thread may enqueue to the worker */
+		__sync_add_and_fetch(&w->drops, 1);
+		rte_mempool_put(cp_msg_pool, m);
+	}
+}
+
+static int
+cp_worker_main(void *arg)
+{
+	struct cp_worker *w = arg;
+	struct cp_worker_msg *m[CP_WORKER_BURST];
+	unsigned i, n;
+	int ret;
+
+	ue_shard_init(w->id, cp_nb_workers);
+#ifdef GTPC_TIMERS
+	/* echo responses carry no TEID, they go to worker 0 */
+	if (w->id == 0)
+		gtpc_echo_init();
+#endif
+	RTE_LOG(INFO, CP, "CP worker %u on lcore %u\n", w->id, w->lcore);
+
+	while (1) {
+#ifdef GTPC_TIMERS
+		gtpc_timer_poll();
+#endif
+		n = rte_ring_sc_dequeue_burst(w->ring, (void **)m,
+				CP_WORKER_BURST);
+		if (n == 0) {
+			rte_pause();
+			continue;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (m[i]->fd >= 0) {
+				cp_process_msg(m[i]->fd, &m[i]->peer,
+						m[i]->buf, m[i]->len);
+				continue;
+			}
+			ret = ddn_by_session_id(m[i]->sess_id);
+			if (ret)
+				fprintf(stderr, "Error on DDN Handling %s: "
+						"(%d) %s\n", gtp_type_str(ret), ret,
+						(ret < 0 ? strerror(-ret)
+						 : cause_str(ret)));
+		}
+		rte_mempool_put_bulk(cp_msg_pool, (void **)m, n);
+#ifdef CP_DP_COALESCE
+		cp_dp_flush();
+#endif
+	}
+	return 0;
+}
+
+void
+cp_worker_init(void)
+{
+	char name[RTE_RING_NAMESIZE];
+	unsigned i;
+
+	cp_nb_workers = cp_params.nb_workers;
+	cp_msg_pool = rte_mempool_create("cp_worker_msg_pool",
+			CP_WORKER_RING_SIZE * cp_nb_workers * 2 - 1,
+			sizeof(struct cp_worker_msg), CP_WORKER_POOL_CACHE, 0,
+			NULL, NULL, NULL, NULL, rte_socket_id(), 0);
+	if (cp_msg_pool == NULL)
+		rte_panic("Cannot create cp_worker_msg_pool: %s\n",
+				rte_strerror(rte_errno));
+
+	for (i = 0; i < cp_nb_workers; i++) {
+		struct cp_worker *w = &cp_workers[i];
+
+		w->id = i;
+		w->lcore = cp_params.worker_core_id[i];
+		snprintf(name, sizeof(name), "cp_worker_ring_%u", i);
+		w->ring = rte_ring_create(name, CP_WORKER_RING_SIZE,
+				rte_lcore_to_socket_id(w->lcore), RING_F_SC_DEQ);
+		if (w->ring == NULL)
+			rte_panic("Cannot create %s: %s\n", name,
+					rte_strerror(rte_errno));
+		rte_eal_remote_launch(cp_worker_main, w, w->lcore);
+	}
+}
+
+int
+cp_worker_ddn(uint64_t session_id)
+{
+	struct cp_worker_msg *m;
+
+	if (rte_mempool_get(cp_msg_pool, (void **)&m) < 0)
+		return -1;
+	m->fd = -1;
+	m->len = 0;
+	m->sess_id = session_id;
+	cp_worker_enqueue(m);
+	return 0;
+}
+
+/**
+ * Receives a burst of messages of a socket.
+ * @return
+ *   number of messages received
+ */
+static int
+cp_dispatch_fd(int fd)
+{
+	struct cp_worker_msg *m[CP_WORKER_BURST];
+	struct mmsghdr msg[CP_WORKER_BURST];
+	struct iovec iov[CP_WORKER_BURST];
+	int i, n;
+
+	/* workers are behind, leave the messages in the socket */
+	if (rte_mempool_get_bulk(cp_msg_pool, (void **)m,
+				CP_WORKER_BURST) < 0)
+		return 0;
+
+	memset(msg, 0, sizeof(msg));
+	for (i = 0; i < CP_WORKER_BURST; i++) {
+		iov[i].iov_base = m[i]->buf;
+		iov[i].iov_len = MAX_GTPV2C_UDP_LEN;
+		msg[i].msg_hdr.msg_name = &m[i]->peer;
+		msg[i].msg_hdr.msg_namelen = sizeof(m[i]->peer);
+		msg[i].msg_hdr.msg_iov = &iov[i];
+		msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	n = recvmmsg(fd, msg, CP_WORKER_BURST, MSG_DONTWAIT, NULL);
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			fprintf(stderr, "recvmmsg error on fd %d: %s\n",
+					fd, strerror(errno));
+		n = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		m[i]->fd = fd;
+		m[i]->len = msg[i].msg_len;
+		cp_worker_enqueue(m[i]);
+	}
+	if (n < CP_WORKER_BURST)
+		rte_mempool_put_bulk(cp_msg_pool, (void **)&m[n],
+				CP_WORKER_BURST - n);
+	return n;
+}
+
+/**
+ * Queues the next s11 message of the pcap file, exits once all of them
+ * are processed.
+ */
+static void
+cp_dispatch_pcap(void)
+{
+	const unsigned hdr_len = sizeof(struct ether_hdr)
+			+ sizeof(struct ipv4_hdr) + sizeof(struct udp_hdr);
+	struct pcap_pkthdr *pcap_rx_header;
+	const u_char *pkt;
+	struct cp_worker_msg *m;
+
+	if (pcap_next_ex(pcap_reader, &pcap_rx_header, &pkt) < 0) {
+		while (rte_mempool_avail_count(cp_msg_pool) !=
+				cp_msg_pool->size)
+			rte_pause();
+		printf("Finished reading from pcap file - exiting\n");
+		exit(0);
+	}
+	if (pcap_rx_header->caplen <= hdr_len ||
+			pcap_rx_header->caplen - hdr_len > MAX_GTPV2C_UDP_LEN)
+		return;
+
+	while (rte_mempool_get(cp_msg_pool, (void **)&m) < 0)
+		rte_pause();
+	m->fd = s11_fd;
+	m->len = pcap_rx_header->caplen - hdr_len;
+	m->peer = s11_mme_sockaddr;
+	memcpy(m->buf, pkt + hdr_len, m->len);
+	cp_worker_enqueue(m);
+}
+
+void
+cp_dispatch(void)
+{
+	static struct pollfd pfd[CP_NB_FD];
+	static unsigned nb_pfd;
+	int fds[CP_NB_FD] = {s11_fd, s5s8_sgwc_fd, s5s8_pgwc_fd};
+	unsigned i;
+	int rx = 0;
+
+	if (pcap_reader) {
+		cp_dispatch_pcap();
+		return;
+	}
+
+	if (nb_pfd == 0) {
+		for (i = 0; i < CP_NB_FD; i++) {
+			if (fds[i] < 0)
+				continue;
+			pfd[nb_pfd].fd = fds[i];
+			pfd[nb_pfd].events = POLLIN;
+			nb_pfd++;
+		}
+	}
+
+	for (i = 0; i < nb_pfd; i++)
+		rx += cp_dispatch_fd(pfd[i].fd);
+
+	if (rx == 0 && poll(pfd, nb_pfd, -1) < 0 && errno != EINTR)
+		fprintf(stderr, "poll error: %s\n", strerror(errno));
+}
+#endif /* CP_WORKERS */
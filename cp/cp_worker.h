@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CP_WORKER_H
+#define CP_WORKER_H
+
+/**
+ * @file
+ *
+ * GTPv2c message processing on several CP worker lcores. The master lcore
+ * receives the s11 and s5s8 messages and dispatches each to the worker
+ * owning its UE: by the TEID of the GTPv2c header, or by the IMSI for the
+ * create session requests, which carry no TEID of the CP yet. Each worker
+ * owns the UE context hashes of its shard and hands out the GTPv2c TEIDs
+ * of its shard, see cp_teid_shard(), so the messages of a UE are processed
+ * in order by one worker and workers share no UE state.
+ */
+#ifdef CP_WORKERS
+#include <stdint.h>
+
+/** Max CP worker lcores */
+#define CP_MAX_WORKERS               (16)
+/** Messages queued to each worker, power of 2 */
+#define CP_WORKER_RING_SIZE          (4096)
+/** Messages received or processed per burst */
+#define CP_WORKER_BURST              (32)
+
+/** Number of CP workers */
+extern unsigned cp_nb_workers;
+
+/**
+ * Creates the message rings of the workers of cp_params and launches them
+ * on their lcores.
+ */
+void
+cp_worker_init(void);
+
+/**
+ * Receives the messages of the s11 and s5s8 sockets, or of the pcap file,
+ * and queues them to their workers. Waits for messages if none are ready.
+ */
+void
+cp_dispatch(void);
+
+/**
+ * Queues a downlink data notification to the worker of the session.
+ * @param session_id
+ *   session identifier pertaining to downlink data packets arrived at DP
+ * @return
+ *   0 on success, -1 if the message was dropped
+ */
+int
+cp_worker_ddn(uint64_t session_id);
+
+/**
+ * Shard of a GTPv2c TEID handed out by the CP
+ * @param teid
+ *   s11 sgw or s5s8 pgw gtpc teid, as in the GTPv2c header
+ * @return
+ *   index of the worker owning the teid
+ */
+unsigned
+cp_teid_shard(uint32_t teid);
+
+#endif /* CP_WORKERS */
+#endif /* CP_WORKER_H */
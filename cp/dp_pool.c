@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef MULTI_DP
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+
+#include "dp_ipc_api.h"
+#include "dp_pool.h"
+#include "gtpv2c.h"
+
+struct dp_load dp_load[MAX_DP];
+
+/**
+ * Load of a DP in UEs.
+ */
+static uint64_t
+dp_load_score(const struct dp_load *l, uint64_t stale_tsc)
+{
+	uint64_t score = l->ues;
+
+	if (l->report_tsc && l->report_tsc >= stale_tsc)
+		score += (uint64_t)l->kpps * DP_LOAD_KPPS_WEIGHT
+			+ (uint64_t)l->drops * DP_LOAD_DROP_WEIGHT;
+	return score;
+}
+
+uint8_t
+dp_pool_select(void)
+{
+	uint64_t now = rte_rdtsc();
+	uint64_t stale = DP_LOAD_STALE_INTERVALS * DP_LOAD_INTERVAL_MS
+			* rte_get_tsc_hz() / 1000;
+	uint64_t stale_tsc = now > stale ? now - stale : 0;
+	uint64_t score, best_score = UINT64_MAX;
+	uint8_t dp, best = 0;
+
+	for (dp = 0; dp < nb_dp; dp++) {
+		score = dp_load_score(&dp_load[dp], stale_tsc);
+		if (score < best_score) {
+			best_score = score;
+			best = dp;
+		}
+	}
+	__sync_add_and_fetch(&dp_load[best].ues, 1);
+	return best;
+}
+
+void
+dp_pool_release(uint8_t dp)
+{
+	if (dp < nb_dp)
+		__sync_sub_and_fetch(&dp_load[dp].ues, 1);
+}
+
+struct in_addr
+dp_pool_s1u_ip(uint8_t dp)
+{
+	if (dp < nb_dp && dp_s1u_ip[dp].s_addr)
+		return dp_s1u_ip[dp];
+	return s1u_sgw_ip;
+}
+
+int
+cb_dp_load(struct msgbuf *msg_payload)
+{
+	struct msg_dp_load *rpt = &msg_payload->msg_union.dp_load;
+	uint8_t dp;
+
+	for (dp = 0; dp < nb_dp; dp++) {
+		if (dp_sock[dp].other_addr.sin_addr.s_addr ==
+				rpt->dp_ip.s_addr &&
+				dp_sock[dp].other_addr.sin_port ==
+				htons(rpt->dp_port))
+			break;
+	}
+	if (dp == nb_dp) {
+		fprintf(stderr, "Load report of unknown DP %s:%u\n",
+				inet_ntoa(rpt->dp_ip), rpt->dp_port);
+		return -1;
+	}
+
+	dp_load[dp].kpps = rpt->kpps;
+	dp_load[dp].drops = rpt->drops;
+	dp_load[dp].report_tsc = rte_rdtsc();
+	return 0;
+}
+#endif /* MULTI_DP */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef DP_POOL_H
+#define DP_POOL_H
+
+/**
+ * @file
+ *
+ * Data Plane pool of the Control Plane. With MULTI_DP the CP drives the
+ * DPs of interface.cfg and places each new UE on the least loaded one;
+ * all sessions of the UE go to that DP, see ue_context_t.dp. The load of
+ * a DP is the UEs the CP placed on it, plus the NIC rx rate and drops of
+ * its last load report, MSG_DP_LOAD. Reports older than
+ * DP_LOAD_STALE_INTERVALS intervals are ignored. A UE is placed again once
+ * all its sessions are deleted.
+ */
+#ifdef MULTI_DP
+#include <stdint.h>
+
+#include "interface.h"
+
+struct msgbuf;
+
+/** One kpps of NIC rx weighs as much as this many UEs */
+#define DP_LOAD_KPPS_WEIGHT		4
+/** One NIC rx drop per second weighs as much as this many UEs */
+#define DP_LOAD_DROP_WEIGHT		64
+/** Load reports missed before the last one is ignored */
+#define DP_LOAD_STALE_INTERVALS		3
+
+/**
+ * @brief load of a DP
+ */
+struct dp_load {
+	uint32_t ues;		/** UEs placed on the DP by this CP */
+	uint32_t kpps;		/** of the last report */
+	uint32_t drops;		/** of the last report */
+	uint64_t report_tsc;	/** tsc of the last report, 0 if none */
+};
+
+extern struct dp_load dp_load[MAX_DP];
+
+/**
+ * Picks the least loaded DP for a new UE and accounts the UE to it.
+ * Safe to call from concurrent CP workers.
+ * @return
+ *   index of the DP, below nb_dp
+ */
+uint8_t
+dp_pool_select(void);
+
+/**
+ * Releases a UE of dp_pool_select().
+ * @param dp
+ *   index of the DP of the UE
+ */
+void
+dp_pool_release(uint8_t dp);
+
+/**
+ * S1U SGW ip advertised for the sessions of a DP.
+ * @param dp
+ *   index of the DP
+ * @return
+ *   s1u_sgw_ip of the DP in interface.cfg, s1u_sgw_ip of the CP if none
+ */
+struct in_addr
+dp_pool_s1u_ip(uint8_t dp);
+
+/**
+ * Callback of MSG_DP_LOAD, stores the report of the DP.
+ * @param msg_payload
+ *   load report
+ * @return
+ *   0 on success, -1 if the report is from an unknown DP
+ */
+int
+cb_dp_load(struct msgbuf *msg_payload);
+
+#endif /* MULTI_DP */
+#endif /* DP_POOL_H */
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef GTPC_TIMERS
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <rte_debug.h>
+#include <rte_errno.h>
+#include <rte_jhash.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mempool.h>
+
+#include "cp.h"
+#include "cp_stats.h"
+#include "debug_str.h"
+#include "gtpc_timer.h"
+#include "timer_wheel.h"
+#include "ue.h"
+
+/**
+ * @brief request sent, awaiting its response
+ */
+struct gtpc_pending {
+	struct tw_timer timer;
+	struct gtpc_pending *next;	/** hash chain */
+	uint32_t seq;
+	uint32_t teid;			/** local s11 teid of the UE, 0 if none */
+	uint8_t type;
+	uint8_t tx;			/** transmissions so far */
+	uint16_t len;
+	int fd;
+	struct sockaddr_in peer;
+	uint8_t buf[MAX_GTPV2C_UDP_LEN];
+};
+
+/**
+ * @brief GTPv2c peer monitored by echo requests
+ */
+struct gtpc_peer {
+	struct tw_timer timer;
+	int fd;
+	uint8_t up;
+	struct sockaddr_in addr;
+};
+
+/**
+ * @brief timers of an lcore
+ */
+struct gtpc_timers {
+	struct timer_wheel tw;
+	struct gtpc_pending *bucket[GTPC_PENDING_BUCKETS];
+	struct gtpc_peer peer[GTPC_MAX_PEERS];
+	unsigned nb_peers;
+	uint32_t echo_seq;
+};
+
+/** Timers of each lcore, allocated on first use */
+static struct gtpc_timers *gtpc_timers_tbl[RTE_MAX_LCORE];
+static struct rte_mempool *gtpc_pending_pool;
+
+/**
+ * Get timers of calling lcore.
+ */
+static struct gtpc_timers *
+gtpc_timers_get(void)
+{
+	unsigned lcore_id = rte_lcore_id();
+	struct gtpc_timers *t = gtpc_timers_tbl[lcore_id];
+
+	if (likely(t != NULL))
+		return t;
+
+	t = rte_zmalloc_socket("gtpc_timers", sizeof(struct gtpc_timers),
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (t == NULL)
+		rte_panic("lcore %u: Failed to allocate GTPv2c timers\n",
+				lcore_id);
+	tw_init(&t->tw, GTPC_TIMER_TICK_MS);
+	gtpc_timers_tbl[lcore_id] = t;
+	return t;
+}
+
+static inline uint32_t
+gtpv2c_seq(const gtpv2c_header *gtpv2c)
+{
+	return gtpv2c->gtpc.teidFlg ? gtpv2c->teid_u.has_teid.seq :
+			gtpv2c->teid_u.no_teid.seq;
+}
+
+/**
+ * @return
+ *   1 if the message is a request answered by its peer, 0 otherwise
+ */
+static int
+gtpv2c_is_request(uint8_t type)
+{
+	switch (type) {
+	case GTP_ECHO_REQ:
+	case GTP_CREATE_SESSION_REQ:
+	case GTP_MODIFY_BEARER_REQ:
+	case GTP_DELETE_SESSION_REQ:
+	case GTP_CREATE_BEARER_REQ:
+	case GTP_UPDATE_BEARER_REQ:
+	case GTP_DELETE_BEARER_REQ:
+	case GTP_DOWNLINK_DATA_NOTIFICATION:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static inline struct gtpc_pending **
+gtpc_bucket(struct gtpc_timers *t, uint32_t seq, const struct in_addr *addr)
+{
+	return &t->bucket[rte_jhash_2words(seq, addr->s_addr, 0)
+			& (GTPC_PENDING_BUCKETS - 1)];
+}
+
+/**
+ * Finds the link to the pending request of type sent to peer with seq.
+ */
+static struct gtpc_pending **
+gtpc_pending_find(struct gtpc_timers *t, uint32_t seq, uint8_t type,
+		const struct in_addr *addr)
+{
+	struct gtpc_pending **p = gtpc_bucket(t, seq, addr);
+
+	for (; *p != NULL; p = &(*p)->next)
+		if ((*p)->seq == seq && (*p)->type == type &&
+				(*p)->peer.sin_addr.s_addr == addr->s_addr)
+			break;
+	return p;
+}
+
+static void
+gtpc_send(int fd, const uint8_t *buf, uint16_t len,
+		const struct sockaddr_in *peer)
+{
+	int bytes_tx = sendto(fd, buf, len, 0, (const struct sockaddr *) peer,
+			sizeof(*peer));
+
+	if (bytes_tx != (int) len)
+		fprintf(stderr, "Transmitted Incomplete GTPv2c Message:"
+				"%u of %d tx bytes\n", len, bytes_tx);
+}
+
+static struct gtpc_peer *
+gtpc_peer_find(struct gtpc_timers *t, const struct in_addr *addr)
+{
+	unsigned i;
+
+	for (i = 0; i < t->nb_peers; i++)
+		if (t->peer[i].addr.sin_addr.s_addr == addr->s_addr)
+			return &t->peer[i];
+	return NULL;
+}
+
+/**
+ * Abandons the procedure of a request never answered.
+ */
+static void
+gtpc_request_timeout(struct gtpc_timers *t, struct gtpc_pending *p)
+{
+	struct gtpc_peer *peer;
+	ue_context *context = NULL;
+
+	CP_STATS_INC(timeout);
+
+	switch (p->type) {
+	case GTP_ECHO_REQ:
+		peer = gtpc_peer_find(t, &p->peer.sin_addr);
+		if (peer != NULL && peer->up) {
+			fprintf(stderr, "GTPv2c path to %s failed: no echo "
+					"response\n", inet_ntoa(p->peer.sin_addr));
+			peer->up = 0;
+		}
+		break;
+	case GTP_CREATE_BEARER_REQ:
+		/* release the dedicated bearer the request was for */
+		if (rte_hash_lookup_data(ue_context_by_fteid_hash, &p->teid,
+				(void **) &context) >= 0 && context
+				&& context->ded_bearer) {
+			eps_bearer_free(context->ded_bearer);
+			context->ded_bearer = NULL;
+		}
+		/* no break */
+	default:
+		fprintf(stderr, "%s seq %"PRIu32" to %s timed out after %u "
+				"transmissions\n", gtp_type_str(p->type), p->seq,
+				inet_ntoa(p->peer.sin_addr), p->tx);
+		break;
+	}
+}
+
+static void
+gtpc_pending_expire(struct tw_timer *timer, void *arg)
+{
+	struct gtpc_pending *p = arg;
+	struct gtpc_timers *t = gtpc_timers_get();
+	struct gtpc_pending **link;
+
+	if (p->tx <= GTPC_N3) {
+		gtpc_send(p->fd, p->buf, p->len, &p->peer);
+		CP_STATS_INC(retransmit);
+		p->tx++;
+		tw_arm(&t->tw, timer, GTPC_T3_MS);
+		return;
+	}
+
+	link = gtpc_pending_find(t, p->seq, p->type, &p->peer.sin_addr);
+	if (*link == p)
+		*link = p->next;
+	gtpc_request_timeout(t, p);
+	rte_mempool_put(gtpc_pending_pool, p);
+}
+
+void
+gtpc_timer_request(int fd, const uint8_t *buf, uint16_t len,
+		const struct sockaddr_in *peer, uint32_t teid)
+{
+	const gtpv2c_header *gtpv2c_tx = (const gtpv2c_header *) buf;
+	struct gtpc_timers *t;
+	struct gtpc_pending **link;
+	struct gtpc_pending *p;
+	uint32_t seq;
+
+	/* nothing to retransmit to a pcap file */
+	if (pcap_dumper != NULL || len > MAX_GTPV2C_UDP_LEN ||
+			!gtpv2c_is_request(gtpv2c_tx->gtpc.type))
+		return;
+
+	t = gtpc_timers_get();
+	seq = gtpv2c_seq(gtpv2c_tx);
+	link = gtpc_pending_find(t, seq, gtpv2c_tx->gtpc.type,
+			&peer->sin_addr);
+	p = *link;
+	if (p == NULL) {
+		if (rte_mempool_get(gtpc_pending_pool, (void **) &p) < 0) {
+			fprintf(stderr, "%s seq %"PRIu32" not retransmitted: "
+					"%u requests pending\n",
+					gtp_type_str(gtpv2c_tx->gtpc.type), seq,
+					GTPC_PENDING_MAX);
+			return;
+		}
+		tw_timer_init(&p->timer, gtpc_pending_expire, p);
+		p->seq = seq;
+		p->type = gtpv2c_tx->gtpc.type;
+		p->peer = *peer;
+		p->next = NULL;
+		*link = p;
+	}
+	/* a request sent again restarts its retransmissions */
+	p->teid = teid;
+	p->tx = 1;
+	p->fd = fd;
+	p->len = len;
+	memcpy(p->buf, buf, len);
+	tw_arm(&t->tw, &p->timer, GTPC_T3_MS);
+}
+
+int
+gtpc_timer_response(const gtpv2c_header *gtpv2c_rx,
+		const struct sockaddr_in *peer)
+{
+	struct gtpc_timers *t = gtpc_timers_get();
+	struct gtpc_pending **link;
+	struct gtpc_pending *p;
+	struct gtpc_peer *echo_peer;
+
+	/* every response is of the type following its request */
+	link = gtpc_pending_find(t, gtpv2c_seq(gtpv2c_rx),
+			gtpv2c_rx->gtpc.type - 1, &peer->sin_addr);
+	p = *link;
+	if (p == NULL)
+		return -1;
+
+	*link = p->next;
+	tw_cancel(&t->tw, &p->timer);
+	rte_mempool_put(gtpc_pending_pool, p);
+
+	if (gtpv2c_rx->gtpc.type == GTP_ECHO_RSP) {
+		echo_peer = gtpc_peer_find(t, &peer->sin_addr);
+		if (echo_peer != NULL && !echo_peer->up) {
+			printf("GTPv2c path to %s is up\n",
+					inet_ntoa(peer->sin_addr));
+			echo_peer->up = 1;
+		}
+	}
+	return 0;
+}
+
+static void
+gtpc_echo_send(struct tw_timer *timer, void *arg)
+{
+	struct gtpc_peer *peer = arg;
+	struct gtpc_timers *t = gtpc_timers_get();
+	uint8_t tx_buf[MAX_GTPV2C_UDP_LEN] = { 0 };
+	gtpv2c_header *gtpv2c_tx = (gtpv2c_header *) tx_buf;
+	uint16_t payload_length;
+
+	t->echo_seq = (t->echo_seq + 1) & 0xffffff;
+	set_gtpv2c_echo(gtpv2c_tx, GTP_ECHO_REQ, t->echo_seq);
+	payload_length = ntohs(gtpv2c_tx->gtpc.length)
+			+ sizeof(gtpv2c_tx->gtpc);
+
+	gtpc_send(peer->fd, tx_buf, payload_length, &peer->addr);
+	gtpc_timer_request(peer->fd, tx_buf, payload_length, &peer->addr, 0);
+	tw_arm(&t->tw, timer, GTPC_ECHO_INTERVAL_MS);
+}
+
+static void
+gtpc_echo_peer_add(struct gtpc_timers *t, int fd, struct in_addr ip)
+{
+	struct gtpc_peer *peer;
+
+	if (fd < 0 || t->nb_peers == GTPC_MAX_PEERS)
+		return;
+
+	peer = &t->peer[t->nb_peers++];
+	peer->fd = fd;
+	peer->up = 1;
+	memset(&peer->addr, 0, sizeof(peer->addr));
+	peer->addr.sin_family = AF_INET;
+	peer->addr.sin_port = htons(GTPC_UDP_PORT);
+	peer->addr.sin_addr = ip;
+	tw_timer_init(&peer->timer, gtpc_echo_send, peer);
+	tw_arm(&t->tw, &peer->timer, GTPC_ECHO_INTERVAL_MS);
+}
+
+void
+gtpc_timer_init(void)
+{
+	gtpc_pending_pool = rte_mempool_create("gtpc_pending_pool",
+			GTPC_PENDING_MAX - 1, sizeof(struct gtpc_pending),
+			0, 0, NULL, NULL, NULL, NULL, rte_socket_id(), 0);
+	if (gtpc_pending_pool == NULL)
+		rte_panic("Cannot create gtpc_pending_pool: %s\n",
+				rte_strerror(rte_errno));
+}
+
+void
+gtpc_echo_init(void)
+{
+	struct gtpc_timers *t = gtpc_timers_get();
+
+	if (pcap_reader != NULL || pcap_dumper != NULL)
+		return;
+
+	switch (spgw_cfg) {
+	case SGWC:
+		gtpc_echo_peer_add(t, s11_fd, s11_mme_ip);
+		gtpc_echo_peer_add(t, s5s8_sgwc_fd, s5s8_pgwc_ip);
+		break;
+	case PGWC:
+		gtpc_echo_peer_add(t, s5s8_pgwc_fd, s5s8_sgwc_ip);
+		break;
+	case SPGWC:
+		gtpc_echo_peer_add(t, s11_fd, s11_mme_ip);
+		break;
+	}
+}
+
+void
+gtpc_timer_poll(void)
+{
+	tw_advance(&gtpc_timers_get()->tw);
+}
+
+int
+gtpc_timer_timeout_ms(void)
+{
+	return tw_timeout_ms(&gtpc_timers_get()->tw);
+}
+#endif /* GTPC_TIMERS */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GTPC_TIMER_H
+#define GTPC_TIMER_H
+
+/**
+ * @file
+ *
+ * GTPv2c timers of the Control Plane, clause 7.6 3gpp 29.274. Each lcore
+ * processing GTPv2c messages owns a timer wheel, see timer_wheel.h, and
+ * the requests it sent: a request is retransmitted every GTPC_T3_MS until
+ * its response arrives, GTPC_N3 times at most, then the procedure is
+ * abandoned. The lcore receiving the echo responses also sends an echo
+ * request to each GTPv2c peer every GTPC_ECHO_INTERVAL_MS and reports the
+ * path failures. The requests are found by sequence number and peer in a
+ * hash of GTPC_PENDING_BUCKETS chains, so neither the responses nor the
+ * expiries scan the pending requests.
+ */
+#ifdef GTPC_TIMERS
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "gtpv2c.h"
+
+/** Timer wheel tick */
+#define GTPC_TIMER_TICK_MS           (10)
+/** T3-RESPONSE, wait for the response before retransmitting a request */
+#define GTPC_T3_MS                   (3000)
+/** N3-REQUESTS, retransmissions of a request before giving up */
+#define GTPC_N3                      (3)
+/** Echo request interval of each peer */
+#define GTPC_ECHO_INTERVAL_MS        (60000)
+/** Requests awaiting their response, of all lcores */
+#define GTPC_PENDING_MAX             (4096)
+/** Hash chains of the pending requests of each lcore, power of 2 */
+#define GTPC_PENDING_BUCKETS         (1024)
+/** s11 and s5s8 peers monitored */
+#define GTPC_MAX_PEERS               (2)
+
+/**
+ * Creates the pool of the requests awaiting their response, before the
+ * lcores processing GTPv2c messages start.
+ */
+void
+gtpc_timer_init(void);
+
+/**
+ * Starts timing a request sent by the calling lcore, retransmitted until
+ * gtpc_timer_response() matches its response. Messages other than the
+ * requests answered by the peer are ignored.
+ * @param fd
+ *   socket the request was sent on
+ * @param buf
+ *   request
+ * @param len
+ *   length of request
+ * @param peer
+ *   destination of request
+ * @param teid
+ *   local s11 sgw gtpc teid of the UE the request is for, 0 if none
+ */
+void
+gtpc_timer_request(int fd, const uint8_t *buf, uint16_t len,
+		const struct sockaddr_in *peer, uint32_t teid);
+
+/**
+ * Stops the retransmission of the request answered by a message.
+ * @param gtpv2c_rx
+ *   message received
+ * @param peer
+ *   sender of message
+ * @return
+ *   0 if the message answered a pending request of the calling lcore,
+ *   -1 otherwise
+ */
+int
+gtpc_timer_response(const gtpv2c_header *gtpv2c_rx,
+		const struct sockaddr_in *peer);
+
+/**
+ * Starts the echo path monitoring of the peers of spgw_cfg from the
+ * calling lcore, which must be the one processing the echo responses.
+ */
+void
+gtpc_echo_init(void);
+
+/**
+ * Runs the retransmissions, echoes and timeouts due on the calling lcore.
+ */
+void
+gtpc_timer_poll(void);
+
+/**
+ * @return
+ *   ms to wait for messages before calling gtpc_timer_poll() again, -1 if
+ *   the calling lcore has no timer armed
+ */
+int
+gtpc_timer_timeout_ms(void);
+
+#endif /* GTPC_TIMERS */
+#endif /* GTPC_TIMER_H */
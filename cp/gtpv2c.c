@@ -32,24 +32,32 @@
 
 #define RTE_LOGTYPE_CP RTE_LOGTYPE_USER1
 
-struct in_addr s11_mme_ip;
+#ifdef CP_WORKERS
+RTE_DEFINE_PER_LCORE(struct sockaddr_in, s11_mme_sockaddr);
+RTE_DEFINE_PER_LCORE(uint8_t[MAX_GTPV2C_UDP_LEN], s11_tx_buf);
+RTE_DEFINE_PER_LCORE(struct sockaddr_in, s5s8_sgwc_sockaddr);
+RTE_DEFINE_PER_LCORE(uint8_t[MAX_GTPV2C_UDP_LEN], s5s8_tx_buf);
+#else
 struct sockaddr_in s11_mme_sockaddr;
+uint8_t s11_tx_buf[MAX_GTPV2C_UDP_LEN];
+struct sockaddr_in s5s8_sgwc_sockaddr;
+uint8_t s5s8_tx_buf[MAX_GTPV2C_UDP_LEN];
+#endif
+
+struct in_addr s11_mme_ip;
 
 struct in_addr s11_sgw_ip;
 in_port_t s11_port;
 struct sockaddr_in s11_sgw_sockaddr;
 uint8_t s11_rx_buf[MAX_GTPV2C_UDP_LEN];
-uint8_t s11_tx_buf[MAX_GTPV2C_UDP_LEN];
 
 struct in_addr s5s8_sgwc_ip;
 in_port_t s5s8_sgwc_port;
-struct sockaddr_in s5s8_sgwc_sockaddr;
 
 struct in_addr s5s8_pgwc_ip;
 in_port_t s5s8_pgwc_port;
 struct sockaddr_in s5s8_pgwc_sockaddr;
 uint8_t s5s8_rx_buf[MAX_GTPV2C_UDP_LEN];
-uint8_t s5s8_tx_buf[MAX_GTPV2C_UDP_LEN];
 
 struct in_addr s1u_sgw_ip;
 struct in_addr s5s8_sgwu_ip;
@@ -78,6 +86,65 @@ get_next_ie(gtpv2c_ie *gtpv2c_ie_ptr, gtpv2c_ie *limit)
 	return NULL;
 }
 
+/**
+ * Adds an IE to the index, replacing a previous IE of the same key.
+ *
+ * @return
+ *   0 on success, -1 if the index is full
+ */
+static int
+gtpv2c_ie_index_put(struct gtpv2c_ie_index *idx, uint8_t parent_type,
+		uint8_t parent_instance, gtpv2c_ie *ie)
+{
+	uint32_t key = GTPV2C_IE_INDEX_KEY(parent_type, parent_instance,
+			ie->type, ie->instance);
+	uint32_t h = GTPV2C_IE_INDEX_HASH(key);
+
+	for (; idx->slot[h]; h = (h + 1) & (GTPV2C_IE_INDEX_SLOTS - 1)) {
+		if (idx->key[idx->slot[h] - 1] == key) {
+			idx->ie[idx->slot[h] - 1] = ie;
+			return 0;
+		}
+	}
+	if (idx->nb == GTPV2C_IE_INDEX_SIZE)
+		return -1;
+
+	idx->key[idx->nb] = key;
+	idx->ie[idx->nb] = ie;
+	idx->slot[h] = ++idx->nb;
+	return 0;
+}
+
+int
+gtpv2c_ie_index_build(gtpv2c_header *gtpv2c_h, struct gtpv2c_ie_index *idx)
+{
+	gtpv2c_ie *current_ie;
+	gtpv2c_ie *current_group_ie;
+	gtpv2c_ie *limit_ie;
+	gtpv2c_ie *limit_group_ie;
+	int dropped = 0;
+
+	idx->nb = 0;
+	memset(idx->slot, 0, sizeof(idx->slot));
+
+	FOR_EACH_GTPV2C_IE(gtpv2c_h, current_ie, limit_ie)
+	{
+		if (gtpv2c_ie_index_put(idx, 0, 0, current_ie))
+			dropped++;
+		if (current_ie->type != IE_BEARER_CONTEXT)
+			continue;
+
+		FOR_EACH_GROUPED_IE(current_ie, current_group_ie,
+				limit_group_ie)
+		{
+			if (gtpv2c_ie_index_put(idx, current_ie->type,
+					current_ie->instance, current_group_ie))
+				dropped++;
+		}
+	}
+	return dropped;
+}
+
 
 void
 set_gtpv2c_header(gtpv2c_header *gtpv2c_tx, uint8_t type,
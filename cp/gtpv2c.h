@@ -35,6 +35,8 @@
 #include <stddef.h>
 #include <arpa/inet.h>
 
+#include <rte_per_lcore.h>
+
 #define GTPC_UDP_PORT                                        (2123)
 #define MAX_GTPV2C_UDP_LEN                                   (4096)
 
@@ -296,24 +298,126 @@ get_next_ie(gtpv2c_ie *gtpv2c_ie_ptr, gtpv2c_ie *limit);
 	       child_ie_ptr;                                                  \
 	       child_ie_ptr = get_next_ie(child_ie_ptr, gtpv2c_limit_ie_ptr))
 
-extern struct in_addr s11_mme_ip;
+/** Distinct IEs kept in a gtpv2c_ie_index, grouped children included */
+#define GTPV2C_IE_INDEX_SIZE                                 (64)
+/** Slots of the gtpv2c_ie_index hash table, power of 2 */
+#define GTPV2C_IE_INDEX_SLOTS                                (128)
+
+/**
+ * Index of the IEs of a message by (parent type, parent instance, type,
+ * instance), built in a single pass by gtpv2c_ie_index_build(). Top level
+ * IEs have parent type 0. Children of all grouped IEs with the same type
+ * and instance share one scope, and the last of a duplicate IE is kept,
+ * as with an else if chain over FOR_EACH_GTPV2C_IE/FOR_EACH_GROUPED_IE.
+ */
+struct gtpv2c_ie_index {
+	uint8_t nb;                             /** entries used */
+	uint8_t slot[GTPV2C_IE_INDEX_SLOTS];    /** entry + 1, 0 if free */
+	uint32_t key[GTPV2C_IE_INDEX_SIZE];
+	gtpv2c_ie *ie[GTPV2C_IE_INDEX_SIZE];
+};
+
+#define GTPV2C_IE_INDEX_KEY(parent_type, parent_instance, type, instance) \
+	(((uint32_t)(parent_type) << 16) | ((parent_instance) << 12) |  \
+	 ((type) << 4) | (instance))
+
+#define GTPV2C_IE_INDEX_HASH(key)                                        \
+	(((key) * 2654435761u) >> 25)
+
+/**
+ * Builds the IE index of a message. Children of IE_BEARER_CONTEXT are
+ * indexed under the bearer context type and instance. IEs beyond
+ * GTPV2C_IE_INDEX_SIZE distinct keys are not indexed.
+ * @param gtpv2c_h
+ *   message buffer containing a GTP Header
+ * @param idx
+ *   index to fill
+ * @return
+ *   number of IEs not indexed
+ */
+int
+gtpv2c_ie_index_build(gtpv2c_header *gtpv2c_h, struct gtpv2c_ie_index *idx);
+
+/**
+ * Looks up a child IE in a gtpv2c_ie_index.
+ * @param idx
+ *   index built by gtpv2c_ie_index_build()
+ * @param parent_type
+ *   type of grouped IE, 0 for top level IEs
+ * @param parent_instance
+ *   instance of grouped IE, 0 for top level IEs
+ * @param type
+ *   IE type
+ * @param instance
+ *   IE instance
+ * @return
+ *   IE, NULL if not in message
+ */
+static inline gtpv2c_ie *
+gtpv2c_ie_index_get_grouped(const struct gtpv2c_ie_index *idx,
+		uint8_t parent_type, uint8_t parent_instance,
+		uint8_t type, uint8_t instance)
+{
+	uint32_t key = GTPV2C_IE_INDEX_KEY(parent_type, parent_instance,
+			type, instance);
+	uint32_t h = GTPV2C_IE_INDEX_HASH(key);
+
+	for (; idx->slot[h]; h = (h + 1) & (GTPV2C_IE_INDEX_SLOTS - 1)) {
+		if (idx->key[idx->slot[h] - 1] == key)
+			return idx->ie[idx->slot[h] - 1];
+	}
+	return NULL;
+}
+
+/**
+ * Looks up a top level IE in a gtpv2c_ie_index.
+ * @param idx
+ *   index built by gtpv2c_ie_index_build()
+ * @param type
+ *   IE type
+ * @param instance
+ *   IE instance
+ * @return
+ *   IE, NULL if not in message
+ */
+static inline gtpv2c_ie *
+gtpv2c_ie_index_get(const struct gtpv2c_ie_index *idx,
+		uint8_t type, uint8_t instance)
+{
+	return gtpv2c_ie_index_get_grouped(idx, 0, 0, type, instance);
+}
+
+#ifdef CP_WORKERS
+/* Sender and reply buffers of the message processed by each CP worker */
+RTE_DECLARE_PER_LCORE(struct sockaddr_in, s11_mme_sockaddr);
+RTE_DECLARE_PER_LCORE(uint8_t[MAX_GTPV2C_UDP_LEN], s11_tx_buf);
+RTE_DECLARE_PER_LCORE(struct sockaddr_in, s5s8_sgwc_sockaddr);
+RTE_DECLARE_PER_LCORE(uint8_t[MAX_GTPV2C_UDP_LEN], s5s8_tx_buf);
+#define s11_mme_sockaddr RTE_PER_LCORE(s11_mme_sockaddr)
+#define s11_tx_buf RTE_PER_LCORE(s11_tx_buf)
+#define s5s8_sgwc_sockaddr RTE_PER_LCORE(s5s8_sgwc_sockaddr)
+#define s5s8_tx_buf RTE_PER_LCORE(s5s8_tx_buf)
+#else
 extern struct sockaddr_in s11_mme_sockaddr;
+extern uint8_t s11_tx_buf[MAX_GTPV2C_UDP_LEN];
+extern struct sockaddr_in s5s8_sgwc_sockaddr;
+extern uint8_t s5s8_tx_buf[MAX_GTPV2C_UDP_LEN];
+#endif
+
+extern struct in_addr s11_mme_ip;
 
 extern struct in_addr s11_sgw_ip;
 extern in_port_t s11_port;
 extern struct sockaddr_in s11_sgw_sockaddr;
 extern uint8_t s11_rx_buf[MAX_GTPV2C_UDP_LEN];
-extern uint8_t s11_tx_buf[MAX_GTPV2C_UDP_LEN];
 
 extern struct in_addr s5s8_sgwc_ip;
 extern in_port_t s5s8_sgwc_port;
-extern struct sockaddr_in s5s8_sgwc_sockaddr;
 
 extern struct in_addr s5s8_pgwc_ip;
 extern in_port_t s5s8_pgwc_port;
 extern struct sockaddr_in s5s8_pgwc_sockaddr;
 extern uint8_t s5s8_rx_buf[MAX_GTPV2C_UDP_LEN];
-extern uint8_t s5s8_tx_buf[MAX_GTPV2C_UDP_LEN];
 
 extern struct in_addr s1u_sgw_ip;
 extern struct in_addr s5s8_sgwu_ip;
@@ -446,6 +550,22 @@ set_create_session_response(gtpv2c_header *gtpv2c_tx,
 		uint32_t sequence, ue_context *context, pdn_connection *pdn,
 		eps_bearer *bearer);
 
+/**
+ * Populates the modify bearer response of a bearer, see
+ * gtpv2c_messages/modify_bearer.c
+ * @param gtpv2c_tx
+ *   transmission buffer to contain 'modify bearer response' message
+ * @param sequence
+ *   sequence number as described by clause 7.6 3gpp 29.274
+ * @param context
+ *   UE Context data structure pertaining to the bearer to be modified
+ * @param bearer
+ *   bearer data structure to be modified
+ */
+void
+set_modify_bearer_response(gtpv2c_header *gtpv2c_tx,
+		uint32_t sequence, ue_context *context, eps_bearer *bearer);
+
 /**
  * Handles the processing of pgwc create session request messages
  *
@@ -314,31 +314,23 @@ install_packet_filters(eps_bearer *ded_bearer,
 		if (ret)
 			return -ret;
 
-		int dp_packet_filter_id = get_packet_filter_id(&pf.pkt_fltr);
-
 		/*TODO : rating group is moved to PCC.
 		 * Handle appropriately here. */
 		/*pf.pkt_fltr.rating_group = ded_bearer->qos.qos.qci;*/
 
-		if (dp_packet_filter_id == -ENOENT) {
-			fprintf(stderr,
-			    "Packet filters must be pre-defined by static "
-			    "file prior to reference by s11 Message\n");
-			/* TODO: Implement dynamic installation of packet
-			 * filters on DP  - remove continue*/
-			continue;
-			mbr = get_br(ded_bearer->qos.qos.ul_mbr);
-			/* Convert bit rate into Bytes as CIR stored in bytes */
-			pf.ul_mtr_idx = meter_profile_index_get(mbr);
-
-			mbr = get_br(ded_bearer->qos.qos.dl_mbr);
-			/* Convert bit rate into Bytes as CIR stored in bytes */
-			pf.dl_mtr_idx = meter_profile_index_get(mbr);
-
-			dp_packet_filter_id = install_packet_filter(&pf);
-			if (dp_packet_filter_id < 0)
-				return GTPV2C_CAUSE_SYSTEM_FAILURE;
-		}
+		mbr = get_br(ded_bearer->qos.qos.ul_mbr);
+		/* Convert bit rate into Bytes as CIR stored in bytes */
+		pf.ul_mtr_idx = meter_profile_index_get(mbr);
+
+		mbr = get_br(ded_bearer->qos.qos.dl_mbr);
+		/* Convert bit rate into Bytes as CIR stored in bytes */
+		pf.dl_mtr_idx = meter_profile_index_get(mbr);
+
+		/* shares the filter of other bearers matching the same
+		 * packets, released by eps_bearer_free() */
+		int dp_packet_filter_id = install_packet_filter(&pf);
+		if (dp_packet_filter_id < 0)
+			return GTPV2C_CAUSE_SYSTEM_FAILURE;
 
 		ded_bearer->num_packet_filters++;
 		ded_bearer->packet_filter_map[bearer_filter_id] =
@@ -400,7 +392,8 @@ set_create_bearer_request(gtpv2c_header *gtpv2c_tx, uint32_t sequence,
 			set_ipv4_fteid_ie(gtpv2c_tx,
 				GTPV2C_IFTYPE_S1U_SGW_GTPU,
 				IE_INSTANCE_ZERO,
-				s1u_sgw_ip, bearer->s1u_sgw_gtpu_teid));
+				UE_S1U_SGW_IP(context),
+				bearer->s1u_sgw_gtpu_teid));
 	}
 }
 
@@ -442,9 +435,7 @@ create_dedicated_bearer(gtpv2c_header *gtpv2c_rx,
 	fqos = IE_TYPE_PTR_FROM_GTPV2C_IE(flow_qos_ie,
 	    brc->flow_quality_of_service);
 
-	ded_bearer = brc->context->ded_bearer =
-			rte_zmalloc_socket(NULL, sizeof(eps_bearer),
-					RTE_CACHE_LINE_SIZE, rte_socket_id());
+	ded_bearer = brc->context->ded_bearer = eps_bearer_alloc();
 	if (ded_bearer == NULL) {
 		fprintf(stderr, "Failure to allocate dedicated bearer "
 				"structure: %s (%s:%d)\n",
@@ -461,7 +452,7 @@ create_dedicated_bearer(gtpv2c_header *gtpv2c_rx,
 
 	set_s1u_sgw_gtpu_teid(ded_bearer, brc->context);
 
-	ded_bearer->s1u_sgw_gtpu_ipv4 = s1u_sgw_ip;
+	ded_bearer->s1u_sgw_gtpu_ipv4 = UE_S1U_SGW_IP(brc->context);
 	ded_bearer->pdn = brc->pdn;
 	memcpy(&ded_bearer->qos.qos, &fqos->qos, sizeof(qos_segment));
 	/* default values - to be considered later */
@@ -521,6 +512,8 @@ delete_packet_filter(gtpv2c_header *gtpv2c_rx,
 
 	for (filter_index = 0; filter_index < brc->tad->num_pkt_filters;
 	    ++filter_index) {
+		release_packet_filter(
+				b->packet_filter_map[dpf->pkt_filter_id]);
 		b->packet_filter_map[dpf->pkt_filter_id] = -ENOENT;
 		brc->pdn->packet_filter_map[dpf->pkt_filter_id] = NULL;
 		b->num_packet_filters--;
@@ -137,7 +137,8 @@ process_create_bearer_response(gtpv2c_header *gtpv2c_rx)
 		/* TODO: Investigate correct behavior when new bearers are
 		 * created with an ID of existing bearer
 		 */
-		rte_free(create_bearer_rsp.context->eps_bearers[ebi_index]);
+		eps_bearer_free(
+		    create_bearer_rsp.context->eps_bearers[ebi_index]);
 	}
 
 	create_bearer_rsp.context->eps_bearers[ebi_index] =
@@ -149,7 +150,8 @@ process_create_bearer_response(gtpv2c_header *gtpv2c_rx)
 	create_bearer_rsp.context->eps_bearers[ebi_index] =
 	    create_bearer_rsp.ded_bearer;
 
-	struct dp_id dp_id = { .id = DPN_ID };
+	struct dp_id dp_id = {
+		.id = UE_DPN_ID(create_bearer_rsp.context) };
 	/* using the s1u_sgw_gtpu_teid as unique identifier to the session */
 	struct session_info session;
 	memset(&session, 0, sizeof(session));
@@ -175,6 +177,7 @@ process_create_bearer_response(gtpv2c_header *gtpv2c_rx)
 		ntohl(create_bearer_rsp.ded_bearer->s1u_sgw_gtpu_ipv4.s_addr),
 	session.ul_apn_mtr_idx = ulambr_idx;
 	session.dl_apn_mtr_idx = dlambr_idx;
+	session.mirror = create_bearer_rsp.context->mirror;
 
 	for (i = 0; i < create_bearer_rsp.ded_bearer->num_packet_filters; ++i) {
 		uint8_t packet_filter_direction = get_packet_filter_direction(
@@ -18,6 +18,7 @@
 
 #include "packet_filters.h"
 #include "gtpv2c_set_ie.h"
+#include "gtpv2c_template.h"
 #include "../cp_dp_api/vepc_cp_dp_api.h"
 
 #define RTE_LOGTYPE_CP RTE_LOGTYPE_USER4
@@ -224,7 +225,7 @@ process_pgwc_s5s8_create_session_request(gtpv2c_header *gtpv2c_rx,
 	uint8_t ebi_index =
 		*create_s5s8_session_request.bearer_context_to_be_created_ebi - 5;
 
-	ret = acquire_ip(&ue_ip);
+	ret = acquire_ip(apn_requested, &ue_ip);
 	if (ret)
 		return GTPV2C_CAUSE_ALL_DYNAMIC_ADDRESSES_OCCUPIED;
 
@@ -233,8 +234,10 @@ process_pgwc_s5s8_create_session_request(gtpv2c_header *gtpv2c_rx,
 	 * key->ue_context_by_fteid_hash */
 	ret = create_ue_context(create_s5s8_session_request.imsi_ie,
 	    *create_s5s8_session_request.bearer_context_to_be_created_ebi, &context);
-	if (ret)
+	if (ret) {
+		release_ip(apn_requested->ip_pool, ue_ip);
 		return ret;
+	}
 
 	if (create_s5s8_session_request.msisdn_ie) {
 		memcpy(&context->msisdn,
@@ -250,7 +253,9 @@ process_pgwc_s5s8_create_session_request(gtpv2c_header *gtpv2c_rx,
 		    create_s5s8_session_request.apn_ambr_ie);
 		pdn->apn_restriction = *IE_TYPE_PTR_FROM_GTPV2C_IE(uint8_t,
 		    create_s5s8_session_request.apn_restriction_ie);
+		release_pdn_ip(pdn);
 		pdn->ipv4 = ue_ip;
+		pdn->ip_pool = apn_requested->ip_pool;
 		pdn->pdn_type = *IE_TYPE_PTR_FROM_GTPV2C_IE(pdn_type_ie,
 		    create_s5s8_session_request.pdn_type_ie);
 		if (create_s5s8_session_request.charging_characteristics_ie) {
@@ -345,6 +350,7 @@ process_pgwc_s5s8_create_session_request(gtpv2c_header *gtpv2c_rx,
 			ntohl(bearer->s1u_sgw_gtpu_ipv4.s_addr);
 	session.ul_apn_mtr_idx = ulambr_idx;
 	session.dl_apn_mtr_idx = dlambr_idx;
+	session.mirror = context->mirror;
 	session.num_ul_pcc_rules = 1;
 	session.num_dl_pcc_rules = 1;
 	session.ul_pcc_rule_id[0] = FIRST_FILTER_ID;
@@ -357,7 +363,7 @@ process_pgwc_s5s8_create_session_request(gtpv2c_header *gtpv2c_rx,
 	session.sess_id = SESS_ID(context->s11_sgw_gtpc_teid,
 						bearer->eps_bearer_id);
 
-	struct dp_id dp_id = { .id = DPN_ID };
+	struct dp_id dp_id = { .id = UE_DPN_ID(context) };
 
 	if (session_create(dp_id, session) < 0)
 		rte_exit(EXIT_FAILURE,"Bearer Session create fail !!!");
@@ -585,6 +591,8 @@ process_sgwc_s5s8_create_session_response(gtpv2c_header *gtpv2c_s5s8_rx,
 		pdn->apn_restriction = *IE_TYPE_PTR_FROM_GTPV2C_IE(uint8_t,
 		    create_s5s8_session_response.apn_restriction_ie);
 
+		/* the PGW allocates the UE address */
+		release_pdn_ip(pdn);
 		pdn->ipv4 = get_ipv4_paa_ipv4(
 					create_s5s8_session_response.pdn_addr_alloc_ie);
 
@@ -620,9 +628,15 @@ process_sgwc_s5s8_create_session_response(gtpv2c_header *gtpv2c_s5s8_rx,
 		bearer->pdn = pdn;
 	}
 
+#ifdef GTPC_TEMPLATES
+	gtpv2c_template_create_session_response(
+			gtpv2c_s11_tx, gtpv2c_s5s8_rx->teid_u.has_teid.seq,
+			context, pdn, bearer);
+#else
 	set_create_session_response(
 			gtpv2c_s11_tx, gtpv2c_s5s8_rx->teid_u.has_teid.seq,
 			context, pdn, bearer);
+#endif
 	RTE_LOG(DEBUG, CP, "NGIC- create_s5s8_session.c::"
 			"\n\tprocess_sgwc_s5s8_cs_rsp_cnt= %u;"
 			"\n\tprocess_spgwc_s11_cs_res_cnt= %u;"
@@ -689,6 +703,7 @@ process_sgwc_s5s8_create_session_response(gtpv2c_header *gtpv2c_s5s8_rx,
 			ntohl(bearer->s1u_sgw_gtpu_ipv4.s_addr);
 	session.ul_apn_mtr_idx = ulambr_idx;
 	session.dl_apn_mtr_idx = dlambr_idx;
+	session.mirror = context->mirror;
 	session.num_ul_pcc_rules = 1;
 	session.num_dl_pcc_rules = 1;
 	session.ul_pcc_rule_id[0] = FIRST_FILTER_ID;
@@ -701,7 +716,7 @@ process_sgwc_s5s8_create_session_response(gtpv2c_header *gtpv2c_s5s8_rx,
 	session.sess_id = SESS_ID(context->s11_sgw_gtpc_teid,
 						bearer->eps_bearer_id);
 
-	struct dp_id dp_id = { .id = DPN_ID };
+	struct dp_id dp_id = { .id = UE_DPN_ID(context) };
 
 	if (session_create(dp_id, session) < 0)
 		rte_exit(EXIT_FAILURE,"Bearer Session create fail !!!");
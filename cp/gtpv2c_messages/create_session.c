@@ -20,6 +20,7 @@
 
 #include "packet_filters.h"
 #include "gtpv2c_set_ie.h"
+#include "gtpv2c_template.h"
 #include "../cp_dp_api/vepc_cp_dp_api.h"
 
 #define RTE_LOGTYPE_CP RTE_LOGTYPE_USER4
@@ -65,77 +66,48 @@ static int
 parse_create_session_request(gtpv2c_header *gtpv2c_rx,
 		struct parse_create_session_request_t *csr)
 {
-	gtpv2c_ie *current_ie;
-	gtpv2c_ie *current_group_ie;
-	gtpv2c_ie *limit_ie;
-	gtpv2c_ie *limit_group_ie;
-
-	FOR_EACH_GTPV2C_IE(gtpv2c_rx, current_ie, limit_ie)
-	{
-		if (current_ie->type == IE_BEARER_CONTEXT &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			FOR_EACH_GROUPED_IE(current_ie, current_group_ie,
-					limit_group_ie)
-			{
-				if (current_group_ie->type == IE_EBI &&
-					current_group_ie->instance ==
-							IE_INSTANCE_ZERO) {
-					csr->bearer_context_to_be_created_ebi =
-					    IE_TYPE_PTR_FROM_GTPV2C_IE(uint8_t,
-							    current_group_ie);
-				} else if (current_group_ie->type ==
-						IE_BEARER_QOS &&
-						current_group_ie->instance ==
-							IE_INSTANCE_ZERO) {
-					csr->bearer_qos_ie = current_group_ie;
-				} else if (current_group_ie->type == IE_BEARER_TFT &&
-						current_group_ie->instance ==
-							IE_INSTANCE_ZERO) {
-					csr->bearer_tft_ie = current_group_ie;
-				} else if (current_group_ie->type == IE_FTEID &&
-						current_group_ie->instance ==
-						IE_INSTANCE_ZERO) {
-					csr->s11u_mme_fteid = current_group_ie;
-				}
-			}
-
-		} else if (current_ie->type == IE_FTEID &&
-				current_ie->instance == IE_INSTANCE_ONE) {
-			csr->pgw_s5s8_gtpc_fteid =
-				IE_TYPE_PTR_FROM_GTPV2C_IE(fteid_ie, current_ie);
-		} else if (current_ie->type == IE_FTEID &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->sender_fteid_ie_for_control_plane =
-			    IE_TYPE_PTR_FROM_GTPV2C_IE(fteid_ie, current_ie);
-		} else if (current_ie->type == IE_APN &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->apn_ie = current_ie;
-		} else if (current_ie->type == IE_APN_RESTRICTION &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->apn_restriction_ie = current_ie;
-		} else if (current_ie->type == IE_IMSI &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->imsi_ie = current_ie;
-		} else if (current_ie->type == IE_AMBR &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->apn_ambr_ie = current_ie;
-		} else if (current_ie->type == IE_PDN_TYPE &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->pdn_type_ie = current_ie;
-		} else if (current_ie->type == IE_CHARGING_CHARACTERISTICS &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->charging_characteristics_ie = current_ie;
-		} else if (current_ie->type == IE_INDICATION &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->indication_ie = current_ie;
-		} else if (current_ie->type == IE_MEI &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->mei_ie = current_ie;
-		} else if (current_ie->type == IE_MSISDN &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			csr->msisdn_ie = current_ie;
-		}
-	}
+	struct gtpv2c_ie_index idx;
+	gtpv2c_ie *ie;
+
+	gtpv2c_ie_index_build(gtpv2c_rx, &idx);
+
+	ie = gtpv2c_ie_index_get_grouped(&idx, IE_BEARER_CONTEXT,
+			IE_INSTANCE_ZERO, IE_EBI, IE_INSTANCE_ZERO);
+	if (ie)
+		csr->bearer_context_to_be_created_ebi =
+				IE_TYPE_PTR_FROM_GTPV2C_IE(uint8_t, ie);
+	csr->bearer_qos_ie = gtpv2c_ie_index_get_grouped(&idx,
+			IE_BEARER_CONTEXT, IE_INSTANCE_ZERO,
+			IE_BEARER_QOS, IE_INSTANCE_ZERO);
+	csr->bearer_tft_ie = gtpv2c_ie_index_get_grouped(&idx,
+			IE_BEARER_CONTEXT, IE_INSTANCE_ZERO,
+			IE_BEARER_TFT, IE_INSTANCE_ZERO);
+	csr->s11u_mme_fteid = gtpv2c_ie_index_get_grouped(&idx,
+			IE_BEARER_CONTEXT, IE_INSTANCE_ZERO,
+			IE_FTEID, IE_INSTANCE_ZERO);
+
+	ie = gtpv2c_ie_index_get(&idx, IE_FTEID, IE_INSTANCE_ONE);
+	if (ie)
+		csr->pgw_s5s8_gtpc_fteid =
+				IE_TYPE_PTR_FROM_GTPV2C_IE(fteid_ie, ie);
+	ie = gtpv2c_ie_index_get(&idx, IE_FTEID, IE_INSTANCE_ZERO);
+	if (ie)
+		csr->sender_fteid_ie_for_control_plane =
+				IE_TYPE_PTR_FROM_GTPV2C_IE(fteid_ie, ie);
+	csr->apn_ie = gtpv2c_ie_index_get(&idx, IE_APN, IE_INSTANCE_ZERO);
+	csr->apn_restriction_ie = gtpv2c_ie_index_get(&idx,
+			IE_APN_RESTRICTION, IE_INSTANCE_ZERO);
+	csr->imsi_ie = gtpv2c_ie_index_get(&idx, IE_IMSI, IE_INSTANCE_ZERO);
+	csr->apn_ambr_ie = gtpv2c_ie_index_get(&idx, IE_AMBR, IE_INSTANCE_ZERO);
+	csr->pdn_type_ie = gtpv2c_ie_index_get(&idx, IE_PDN_TYPE,
+			IE_INSTANCE_ZERO);
+	csr->charging_characteristics_ie = gtpv2c_ie_index_get(&idx,
+			IE_CHARGING_CHARACTERISTICS, IE_INSTANCE_ZERO);
+	csr->indication_ie = gtpv2c_ie_index_get(&idx, IE_INDICATION,
+			IE_INSTANCE_ZERO);
+	csr->mei_ie = gtpv2c_ie_index_get(&idx, IE_MEI, IE_INSTANCE_ZERO);
+	csr->msisdn_ie = gtpv2c_ie_index_get(&idx, IE_MSISDN,
+			IE_INSTANCE_ZERO);
 
 	if (csr->indication_ie &&
 			IE_TYPE_PTR_FROM_GTPV2C_IE(indication_ie,
@@ -205,12 +177,12 @@ set_create_session_response(gtpv2c_header *gtpv2c_tx,
 					GTPV2C_IFTYPE_S11U_SGW_GTPU);
 			add_grouped_ie_length(bearer_context_group,
 		    set_ipv4_fteid_ie(gtpv2c_tx, GTPV2C_IFTYPE_S11U_SGW_GTPU,
-				    IE_INSTANCE_SIX, s1u_sgw_ip,
+				    IE_INSTANCE_SIX, UE_S1U_SGW_IP(context),
 				    bearer->s1u_sgw_gtpu_teid));
 		} else {
 			add_grouped_ie_length(bearer_context_group,
 		    set_ipv4_fteid_ie(gtpv2c_tx, GTPV2C_IFTYPE_S1U_SGW_GTPU,
-				    IE_INSTANCE_ZERO, s1u_sgw_ip,
+				    IE_INSTANCE_ZERO, UE_S1U_SGW_IP(context),
 				    bearer->s1u_sgw_gtpu_teid));
 		}
 
@@ -250,7 +222,7 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 	uint8_t ebi_index =
 		*create_session_request.bearer_context_to_be_created_ebi - 5;
 
-	ret = acquire_ip(&ue_ip);
+	ret = acquire_ip(apn_requested, &ue_ip);
 	if (ret)
 		return GTPV2C_CAUSE_ALL_DYNAMIC_ADDRESSES_OCCUPIED;
 
@@ -259,8 +231,10 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 			create_session_request.imsi_ie,
 			*create_session_request.bearer_context_to_be_created_ebi,
 			&context);
-	if (ret)
+	if (ret) {
+		release_ip(apn_requested->ip_pool, ue_ip);
 		return ret;
+	}
 
 	if (create_session_request.mei_ie) {
 		memcpy(&context->mei,
@@ -288,7 +262,9 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 				create_session_request.apn_ambr_ie);
 		pdn->apn_restriction = *IE_TYPE_PTR_FROM_GTPV2C_IE(uint8_t,
 				create_session_request.apn_restriction_ie);
+		release_pdn_ip(pdn);
 		pdn->ipv4 = ue_ip;
+		pdn->ip_pool = apn_requested->ip_pool;
 		pdn->pdn_type = *IE_TYPE_PTR_FROM_GTPV2C_IE(pdn_type_ie,
 				create_session_request.pdn_type_ie);
 		if (create_session_request.charging_characteristics_ie) {
@@ -324,7 +300,7 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 		bearer->qos = *IE_TYPE_PTR_FROM_GTPV2C_IE(bearer_qos_ie,
 				create_session_request.bearer_qos_ie);
 
-		bearer->s1u_sgw_gtpu_ipv4 = s1u_sgw_ip;
+		bearer->s1u_sgw_gtpu_ipv4 = UE_S1U_SGW_IP(context);
 		set_s1u_sgw_gtpu_teid(bearer, context);
 		bearer->s5s8_sgw_gtpu_ipv4 = s5s8_sgwu_ip;
 		/* Note: s5s8_sgw_gtpu_teid based s11_sgw_gtpc_teid
@@ -358,9 +334,15 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 		return ret;
 	}
 
+#ifdef GTPC_TEMPLATES
+	gtpv2c_template_create_session_response(
+			gtpv2c_s11_tx, gtpv2c_rx->teid_u.has_teid.seq,
+			context, pdn, bearer);
+#else
 	set_create_session_response(
 			gtpv2c_s11_tx, gtpv2c_rx->teid_u.has_teid.seq,
 			context, pdn, bearer);
+#endif
 	RTE_LOG(DEBUG, CP, "NGIC- create_session.c::"
 			"\n\tprocess_create_session_request::case= %d;"
 			"\n\tprocess_spgwc_s11_cs_res_cnt= %u;"
@@ -404,6 +386,7 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 			ntohl(bearer->s1u_sgw_gtpu_ipv4.s_addr);
 	session.ul_apn_mtr_idx = ulambr_idx;
 	session.dl_apn_mtr_idx = dlambr_idx;
+	session.mirror = context->mirror;
 	session.num_ul_pcc_rules = 1;
 	session.num_dl_pcc_rules = 1;
 	session.ul_pcc_rule_id[0] = FIRST_FILTER_ID;
@@ -416,7 +399,7 @@ process_create_session_request(gtpv2c_header *gtpv2c_rx,
 	session.sess_id = SESS_ID(context->s11_sgw_gtpc_teid,
 						bearer->eps_bearer_id);
 
-	struct dp_id dp_id = { .id = DPN_ID };
+	struct dp_id dp_id = { .id = UE_DPN_ID(context) };
 
 	if (session_create(dp_id, session) < 0)
 		rte_exit(EXIT_FAILURE,"Bearer Session create fail !!!");
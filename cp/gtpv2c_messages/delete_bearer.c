@@ -148,7 +148,8 @@ process_delete_bearer_response(gtpv2c_header *gtpv2c_rx)
 		    & delete_bearer_rsp.ded_bearer->s1u_sgw_gtpu_teid) >> 24);
 		delete_bearer_rsp.context->teid_bitmap &= ~(0x01 << index);
 
-		struct dp_id dp_id = { .id = DPN_ID };
+		struct dp_id dp_id = {
+			.id = UE_DPN_ID(delete_bearer_rsp.context) };
 
 		struct session_info si;
 		memset(&si, 0, sizeof(si));
@@ -160,7 +161,7 @@ process_delete_bearer_response(gtpv2c_header *gtpv2c_rx)
 				delete_bearer_rsp.ded_bearer->eps_bearer_id);
 		session_delete(dp_id, si);
 
-		rte_free(delete_bearer_rsp.ded_bearer);
+		eps_bearer_free(delete_bearer_rsp.ded_bearer);
 	}
 
 	return 0;
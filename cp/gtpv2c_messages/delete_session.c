@@ -128,10 +128,10 @@ delete_context(gtpv2c_header *gtpv2c_rx, ue_context **_context)
 			si.sess_id = SESS_ID(
 					context->s11_sgw_gtpc_teid,
 					si.bearer_id);
-			struct dp_id dp_id = { .id = DPN_ID };
+			struct dp_id dp_id = { .id = UE_DPN_ID(context) };
 			session_delete(dp_id, si);
 
-			rte_free(pdn->eps_bearers[i]);
+			eps_bearer_free(pdn->eps_bearers[i]);
 			pdn->eps_bearers[i] = NULL;
 			context->eps_bearers[i] = NULL;
 			context->bearer_bitmap &= ~(1 << i);
@@ -140,9 +140,10 @@ delete_context(gtpv2c_header *gtpv2c_rx, ue_context **_context)
 		}
 	}
 	--context->num_pdns;
-	rte_free(pdn);
+	pdn_free(pdn);
 	context->pdns[ebi_index] = NULL;
 	context->teid_bitmap = 0;
+	ue_context_dp_release(context);
 
 	*_context = context;
 	return 0;
@@ -15,11 +15,17 @@
  */
 
 #include "gtpv2c.h"
+#include "gtpv2c_template.h"
 
 
 int
 process_echo_request(gtpv2c_header *gtpv2c_rx, gtpv2c_header *gtpv2c_tx)
 {
+#ifdef GTPC_TEMPLATES
+	gtpv2c_template_echo_response(gtpv2c_tx,
+			gtpv2c_rx->teid_u.no_teid.seq);
+#else
 	set_gtpv2c_echo(gtpv2c_tx, GTP_ECHO_RSP, gtpv2c_rx->teid_u.no_teid.seq);
+#endif
 	return 0;
 }
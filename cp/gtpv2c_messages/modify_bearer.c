@@ -16,6 +16,7 @@
 
 #include "ue.h"
 #include "gtpv2c_set_ie.h"
+#include "gtpv2c_template.h"
 #include "../cp_dp_api/vepc_cp_dp_api.h"
 
 struct parse_modify_bearer_request_t {
@@ -47,10 +48,8 @@ parse_modify_bearer_request(gtpv2c_header *gtpv2c_rx,
 		struct parse_modify_bearer_request_t *modify_bearer_request)
 {
 
-	gtpv2c_ie *current_ie;
-	gtpv2c_ie *current_group_ie;
-	gtpv2c_ie *limit_ie;
-	gtpv2c_ie *limit_group_ie;
+	struct gtpv2c_ie_index idx;
+	gtpv2c_ie *ie;
 
 	int ret = rte_hash_lookup_data(ue_context_by_fteid_hash,
 	    (const void *) &gtpv2c_rx->teid_u.has_teid.teid,
@@ -62,38 +61,25 @@ parse_modify_bearer_request(gtpv2c_header *gtpv2c_rx,
 
 	/** TODO: we should fully verify mandatory fields within received
 	 * message */
-	FOR_EACH_GTPV2C_IE(gtpv2c_rx, current_ie, limit_ie)
-	{
-		if (current_ie->type == IE_BEARER_CONTEXT &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			FOR_EACH_GROUPED_IE(current_ie, current_group_ie,
-					limit_group_ie)
-			{
-				if (current_group_ie->type == IE_EBI &&
-						current_group_ie->instance ==
-							IE_INSTANCE_ZERO) {
-					modify_bearer_request->
-					bearer_context_to_be_created_ebi =
-					current_group_ie;
-				} else if (current_group_ie->type == IE_FTEID &&
-						current_group_ie->instance ==
-							IE_INSTANCE_ZERO) {
-					modify_bearer_request->s1u_enb_fteid =
-							current_group_ie;
-				}
-			}
-		} else if (current_ie->type == IE_FTEID &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			modify_bearer_request->s11_mme_gtpc_fteid =
-				    &(IE_TYPE_PTR_FROM_GTPV2C_IE(fteid_ie,
-				    current_ie)->fteid_ie_hdr.teid_or_gre);
-		} else if (current_ie->type == IE_DELAY_VALUE &&
-				current_ie->instance == IE_INSTANCE_ZERO) {
-			modify_bearer_request->delay =
-					&IE_TYPE_PTR_FROM_GTPV2C_IE(delay_ie,
-						current_ie)->delay_value;
-		}
-	}
+	gtpv2c_ie_index_build(gtpv2c_rx, &idx);
+
+	modify_bearer_request->bearer_context_to_be_created_ebi =
+			gtpv2c_ie_index_get_grouped(&idx, IE_BEARER_CONTEXT,
+				IE_INSTANCE_ZERO, IE_EBI, IE_INSTANCE_ZERO);
+	modify_bearer_request->s1u_enb_fteid =
+			gtpv2c_ie_index_get_grouped(&idx, IE_BEARER_CONTEXT,
+				IE_INSTANCE_ZERO, IE_FTEID, IE_INSTANCE_ZERO);
+
+	ie = gtpv2c_ie_index_get(&idx, IE_FTEID, IE_INSTANCE_ZERO);
+	if (ie)
+		modify_bearer_request->s11_mme_gtpc_fteid =
+				&(IE_TYPE_PTR_FROM_GTPV2C_IE(fteid_ie,
+				ie)->fteid_ie_hdr.teid_or_gre);
+	ie = gtpv2c_ie_index_get(&idx, IE_DELAY_VALUE, IE_INSTANCE_ZERO);
+	if (ie)
+		modify_bearer_request->delay =
+				&IE_TYPE_PTR_FROM_GTPV2C_IE(delay_ie,
+					ie)->delay_value;
 
 	if (!modify_bearer_request->bearer_context_to_be_created_ebi
 			|| !modify_bearer_request->s1u_enb_fteid) {
@@ -139,7 +125,7 @@ parse_modify_bearer_request(gtpv2c_header *gtpv2c_rx,
  * @param bearer
  *   bearer data structure to be modified
  */
-static void
+void
 set_modify_bearer_response(gtpv2c_header *gtpv2c_tx,
 		uint32_t sequence, ue_context *context, eps_bearer *bearer)
 {
@@ -157,7 +143,7 @@ set_modify_bearer_response(gtpv2c_header *gtpv2c_tx,
 				bearer->eps_bearer_id));
 	add_grouped_ie_length(bearer_context_group,
 		set_ipv4_fteid_ie(gtpv2c_tx, GTPV2C_IFTYPE_S1U_SGW_GTPU,
-		IE_INSTANCE_ZERO, s1u_sgw_ip,
+		IE_INSTANCE_ZERO, UE_S1U_SGW_IP(context),
 		bearer->s1u_sgw_gtpu_teid));
 }
 
@@ -166,13 +152,14 @@ int
 process_modify_bearer_request(gtpv2c_header *gtpv2c_rx,
 		gtpv2c_header *gtpv2c_tx)
 {
-	struct dp_id dp_id = { .id = DPN_ID };
+	struct dp_id dp_id;
 	struct parse_modify_bearer_request_t modify_bearer_request = { 0 };
 	uint32_t i;
 	int ret = parse_modify_bearer_request(gtpv2c_rx,
 			&modify_bearer_request);
 	if (ret)
 		return ret;
+	dp_id.id = UE_DPN_ID(modify_bearer_request.context);
 
 	/* TODO something with modify_bearer_request.delay if set */
 
@@ -194,8 +181,14 @@ process_modify_bearer_request(gtpv2c_header *gtpv2c_rx,
 			*IE_TYPE_PTR_FROM_GTPV2C_IE(
 	    uint8_t, modify_bearer_request.bearer_context_to_be_created_ebi);
 
+#ifdef GTPC_TEMPLATES
+	gtpv2c_template_modify_bearer_response(gtpv2c_tx,
+	    gtpv2c_rx->teid_u.has_teid.seq,
+	    modify_bearer_request.context, modify_bearer_request.bearer);
+#else
 	set_modify_bearer_response(gtpv2c_tx, gtpv2c_rx->teid_u.has_teid.seq,
 	    modify_bearer_request.context, modify_bearer_request.bearer);
+#endif
 
 	/* using the s1u_sgw_gtpu_teid as unique identifier to the session */
 	struct session_info session;
@@ -78,7 +78,7 @@ process_release_access_bearer_request(gtpv2c_header *gtpv2c_rx,
 		gtpv2c_header *gtpv2c_tx)
 {
 	int i;
-	struct dp_id dp_id = { .id = DPN_ID };
+	struct dp_id dp_id;
 	struct parse_release_access_bearer_request_t
 		release_access_bearer_request = { 0 };
 
@@ -86,6 +86,7 @@ process_release_access_bearer_request(gtpv2c_header *gtpv2c_rx,
 			&release_access_bearer_request);
 	if (ret)
 		return ret;
+	dp_id.id = UE_DPN_ID(release_access_bearer_request.context);
 
 	set_release_access_bearer_response(gtpv2c_tx,
 			gtpv2c_rx->teid_u.has_teid.seq,
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef GTPC_TEMPLATES
+#include <string.h>
+
+#include <rte_debug.h>
+
+#include "gtpv2c.h"
+#include "gtpv2c_template.h"
+
+enum gtpv2c_template_type {
+	TMPL_CS_RSP,            /* create session response, S1-U bearer */
+	TMPL_CS_RSP_S11U,       /* create session response, S11-U bearer */
+	TMPL_MB_RSP,
+	TMPL_ECHO_RSP,
+	TMPL_MAX
+};
+
+static struct gtpv2c_template tmpl[TMPL_MAX];
+
+/* value of IE 'off' of template t, in the reply h */
+#define TMPL_IE_PTR(type, h, t, off) IE_TYPE_PTR_FROM_GTPV2C_IE(type, \
+		(gtpv2c_ie *)((uint8_t *)(h) + (t)->off))
+#define TMPL_FTEID(h, t, off) TMPL_IE_PTR(fteid_ie, h, t, off)
+#define TMPL_UINT8(h, t, off) TMPL_IE_PTR(uint8_t, h, t, off)
+
+/**
+ * Offset of an IE of the template, 0 if not found.
+ */
+static uint16_t
+tmpl_ie_offset(struct gtpv2c_template *t, gtpv2c_ie *ie)
+{
+	return ie ? (uint8_t *)ie - t->buf : 0;
+}
+
+/**
+ * Completes a template built in t->buf: records its length and the
+ * offsets of the IEs patched per reply.
+ */
+static void
+tmpl_finish(struct gtpv2c_template *t, uint8_t s1u_instance)
+{
+	gtpv2c_header *h = (gtpv2c_header *)t->buf;
+	struct gtpv2c_ie_index idx;
+
+	t->len = sizeof(h->gtpc) + ntohs(h->gtpc.length);
+	if (t->len > GTPV2C_TEMPLATE_LEN)
+		rte_panic("GTPv2c template of type %u too long\n",
+				h->gtpc.type);
+
+	gtpv2c_ie_index_build(h, &idx);
+	t->s11_sgw_fteid = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get(&idx, IE_FTEID, IE_INSTANCE_ZERO));
+	t->s5s8_pgw_fteid = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get(&idx, IE_FTEID, IE_INSTANCE_ONE));
+	t->paa = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get(&idx, IE_PAA, IE_INSTANCE_ZERO));
+	t->apn_restriction = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get(&idx, IE_APN_RESTRICTION,
+				IE_INSTANCE_ZERO));
+	t->ebi = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get_grouped(&idx, IE_BEARER_CONTEXT,
+				IE_INSTANCE_ZERO, IE_EBI, IE_INSTANCE_ZERO));
+	t->s1u_sgw_fteid = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get_grouped(&idx, IE_BEARER_CONTEXT,
+				IE_INSTANCE_ZERO, IE_FTEID, s1u_instance));
+	t->s5s8_pgwu_fteid = tmpl_ie_offset(t,
+			gtpv2c_ie_index_get_grouped(&idx, IE_BEARER_CONTEXT,
+				IE_INSTANCE_ZERO, IE_FTEID, IE_INSTANCE_TWO));
+}
+
+void
+gtpv2c_template_init(void)
+{
+	static ue_context context;
+	static pdn_connection pdn;
+	static eps_bearer bearer;
+
+	set_create_session_response((gtpv2c_header *)tmpl[TMPL_CS_RSP].buf,
+			0, &context, &pdn, &bearer);
+	tmpl_finish(&tmpl[TMPL_CS_RSP], IE_INSTANCE_ZERO);
+
+	/* any non zero teid selects the S11-U FTEID */
+	bearer.s11u_mme_gtpu_teid = 1;
+	set_create_session_response(
+			(gtpv2c_header *)tmpl[TMPL_CS_RSP_S11U].buf,
+			0, &context, &pdn, &bearer);
+	tmpl_finish(&tmpl[TMPL_CS_RSP_S11U], IE_INSTANCE_SIX);
+	bearer.s11u_mme_gtpu_teid = 0;
+
+	set_modify_bearer_response((gtpv2c_header *)tmpl[TMPL_MB_RSP].buf,
+			0, &context, &bearer);
+	tmpl_finish(&tmpl[TMPL_MB_RSP], IE_INSTANCE_ZERO);
+
+	set_gtpv2c_echo((gtpv2c_header *)tmpl[TMPL_ECHO_RSP].buf,
+			GTP_ECHO_RSP, 0);
+	tmpl_finish(&tmpl[TMPL_ECHO_RSP], IE_INSTANCE_ZERO);
+}
+
+void
+gtpv2c_template_create_session_response(gtpv2c_header *gtpv2c_tx,
+		uint32_t sequence, ue_context *context, pdn_connection *pdn,
+		eps_bearer *bearer)
+{
+	struct gtpv2c_template *t = bearer->s11u_mme_gtpu_teid ?
+			&tmpl[TMPL_CS_RSP_S11U] : &tmpl[TMPL_CS_RSP];
+	fteid_ie *fteid;
+
+	memcpy(gtpv2c_tx, t->buf, t->len);
+	gtpv2c_tx->teid_u.has_teid.teid = context->s11_mme_gtpc_teid;
+	gtpv2c_tx->teid_u.has_teid.seq = sequence;
+
+	TMPL_FTEID(gtpv2c_tx, t, s11_sgw_fteid)->fteid_ie_hdr.teid_or_gre =
+			context->s11_sgw_gtpc_teid;
+	fteid = TMPL_FTEID(gtpv2c_tx, t, s5s8_pgw_fteid);
+	fteid->fteid_ie_hdr.teid_or_gre = pdn->s5s8_pgw_gtpc_teid;
+	fteid->ip_u.ipv4 = pdn->s5s8_pgw_gtpc_ipv4;
+	TMPL_IE_PTR(paa_ie, gtpv2c_tx, t, paa)->ip_type_union.ipv4 =
+			pdn->ipv4;
+	*TMPL_UINT8(gtpv2c_tx, t, apn_restriction) = pdn->apn_restriction;
+	*TMPL_UINT8(gtpv2c_tx, t, ebi) = bearer->eps_bearer_id;
+	fteid = TMPL_FTEID(gtpv2c_tx, t, s1u_sgw_fteid);
+	fteid->fteid_ie_hdr.teid_or_gre = bearer->s1u_sgw_gtpu_teid;
+#ifdef MULTI_DP
+	fteid->ip_u.ipv4 = UE_S1U_SGW_IP(context);
+#endif
+	fteid = TMPL_FTEID(gtpv2c_tx, t, s5s8_pgwu_fteid);
+	fteid->fteid_ie_hdr.teid_or_gre = bearer->s1u_sgw_gtpu_teid;
+	fteid->ip_u.ipv4 = pdn->s5s8_pgw_gtpc_ipv4;
+}
+
+void
+gtpv2c_template_modify_bearer_response(gtpv2c_header *gtpv2c_tx,
+		uint32_t sequence, ue_context *context, eps_bearer *bearer)
+{
+	struct gtpv2c_template *t = &tmpl[TMPL_MB_RSP];
+	fteid_ie *fteid;
+
+	memcpy(gtpv2c_tx, t->buf, t->len);
+	gtpv2c_tx->teid_u.has_teid.teid = context->s11_mme_gtpc_teid;
+	gtpv2c_tx->teid_u.has_teid.seq = sequence;
+
+	*TMPL_UINT8(gtpv2c_tx, t, ebi) = bearer->eps_bearer_id;
+	fteid = TMPL_FTEID(gtpv2c_tx, t, s1u_sgw_fteid);
+	fteid->fteid_ie_hdr.teid_or_gre = bearer->s1u_sgw_gtpu_teid;
+#ifdef MULTI_DP
+	fteid->ip_u.ipv4 = UE_S1U_SGW_IP(context);
+#endif
+}
+
+void
+gtpv2c_template_echo_response(gtpv2c_header *gtpv2c_tx, uint32_t sequence)
+{
+	struct gtpv2c_template *t = &tmpl[TMPL_ECHO_RSP];
+
+	memcpy(gtpv2c_tx, t->buf, t->len);
+	gtpv2c_tx->teid_u.no_teid.seq = sequence;
+}
+#endif /* GTPC_TEMPLATES */
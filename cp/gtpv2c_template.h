@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GTPV2C_TEMPLATE_H
+#define GTPV2C_TEMPLATE_H
+
+/**
+ * @file
+ *
+ * Pre-built templates of the GTPv2c replies sent for every session: create
+ * session response, modify bearer response and echo response. Each template
+ * is built once at start up by the regular set_* functions, and the
+ * offsets of its per session IEs are taken from the template itself, so a
+ * reply is a copy of the template and a few stores.
+ */
+#ifdef GTPC_TEMPLATES
+#include <stdint.h>
+
+#include "gtpv2c.h"
+
+/** Max bytes of a template, GTPv2c header included */
+#define GTPV2C_TEMPLATE_LEN          (256)
+
+/**
+ * Template of a reply. IE offsets are from the start of the GTPv2c header,
+ * 0 if the IE is not in the template.
+ */
+struct gtpv2c_template {
+	uint16_t len;                   /** bytes of message */
+	uint16_t s11_sgw_fteid;
+	uint16_t s5s8_pgw_fteid;
+	uint16_t paa;
+	uint16_t apn_restriction;
+	uint16_t ebi;
+	uint16_t s1u_sgw_fteid;         /** S1-U or S11-U SGW FTEID */
+	uint16_t s5s8_pgwu_fteid;
+	uint8_t buf[GTPV2C_TEMPLATE_LEN];
+};
+
+/**
+ * Builds the reply templates. s11_sgw_ip and s1u_sgw_ip are copied into
+ * the templates and must be set. With MULTI_DP the replies carry the S1U
+ * ip of the DP of the UE instead.
+ */
+void
+gtpv2c_template_init(void);
+
+/**
+ * Same as set_create_session_response(), from the templates.
+ */
+void
+gtpv2c_template_create_session_response(gtpv2c_header *gtpv2c_tx,
+		uint32_t sequence, ue_context *context, pdn_connection *pdn,
+		eps_bearer *bearer);
+
+/**
+ * Same as set_modify_bearer_response(), from the templates.
+ */
+void
+gtpv2c_template_modify_bearer_response(gtpv2c_header *gtpv2c_tx,
+		uint32_t sequence, ue_context *context, eps_bearer *bearer);
+
+/**
+ * Same as set_gtpv2c_echo() with GTP_ECHO_RSP, from the templates.
+ */
+void
+gtpv2c_template_echo_response(gtpv2c_header *gtpv2c_tx, uint32_t sequence);
+
+#endif /* GTPC_TEMPLATES */
+#endif /* GTPV2C_TEMPLATE_H */
@@ -15,8 +15,17 @@
  * limitations under the License.
  */
 
+#ifdef GTPC_BATCH
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#endif
 #include <arpa/inet.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <getopt.h>
@@ -38,6 +47,8 @@
 #include <rte_ip.h>
 #include <rte_udp.h>
 #include <rte_ether.h>
+#include <rte_ring.h>
+#include <rte_spinlock.h>
 
 #include <rte_common.h>
 #include <rte_acl.h>
@@ -52,6 +63,11 @@
 #include "dp_ipc_api.h"
 #include "cp.h"
 #include "cp_stats.h"
+#include "cp_worker.h"
+#include "gtpv2c_template.h"
+#include "dp_pool.h"
+#include "gtpc_timer.h"
+#include "cp_telemetry.h"
 #ifdef SDN_ODL_BUILD
 #include "nb.h"
 #endif
@@ -146,6 +162,7 @@ static void
 parse_arg(int argc, char **argv)
 {
 	char errbuff[PCAP_ERRBUF_SIZE];
+	const char *teid_layout_str = NULL;
 	int args_set = 0;
 	int c = 0;
 	pcap_t *pcap;
@@ -165,13 +182,16 @@ parse_arg(int argc, char **argv)
 	  {"log_level",   required_argument, NULL, 'l'},
 	  {"pcap_file_in", required_argument, NULL, 'x'},
 	  {"pcap_file_out", required_argument, NULL, 'y'},
+	  {"max_ue", required_argument, NULL, 'n'},
+	  {"teid_layout", required_argument, NULL, 't'},
+	  {"mirror_imsi", required_argument, NULL, 'M'},
 	  {0, 0, 0, 0}
 	};
 
 	do {
 		int option_index = 0;
 
-		c = getopt_long(argc, argv, "d:m:s:r:g:w:v:u:i:p:a:l:x:y:", long_options,
+		c = getopt_long(argc, argv, "d:m:s:r:g:w:v:u:i:p:a:l:x:y:n:t:M:", long_options,
 		    &option_index);
 
 		if (c == -1)
@@ -234,11 +254,25 @@ parse_arg(int argc, char **argv)
 			pcap_dumper = pcap_dump_open(pcap, optarg);
 			s11_pcap_fd = pcap_fileno(pcap);
 			break;
+		case 'n':
+			ue_pool_size = (uint32_t)atoi(optarg);
+			if (!ue_pool_size)
+				rte_panic("Invalid max_ue - %s\n", optarg);
+			break;
+		case 't':
+			/* checked against max_ue, set once all are parsed */
+			teid_layout_str = optarg;
+			break;
+		case 'M':
+			add_mirror_imsi(optarg);
+			break;
 		default:
 			rte_panic("Unknown argument - %s.", argv[optind]);
 			break;
 		}
 	} while (c != -1);
+	if (teid_layout_str)
+		set_teid_layout(teid_layout_str);
 	if ((args_set & REQ_ARGS) != REQ_ARGS) {
 		fprintf(stderr, "Usage: %s\n", argv[0]);
 		for (c = 0; long_options[c].name; ++c) {
@@ -412,6 +446,235 @@ init_s5s8_pgwc(void)
 	s5s8_sgwc_sockaddr.sin_addr = s5s8_sgwc_ip;
 }
 
+#ifdef GTPC_BATCH
+/** GTPv2c messages received or sent per recvmmsg/sendmmsg call */
+#define GTPC_BURST                   (32)
+/** s11, s5s8 sgwc and s5s8 pgwc sockets */
+#define GTPC_NB_IF                   (3)
+
+/**
+ * GTPv2c messages of one recvmmsg or sendmmsg call
+ */
+struct gtpc_burst {
+	int fd;
+	unsigned n;
+	struct mmsghdr msg[GTPC_BURST];
+	struct iovec iov[GTPC_BURST];
+	struct sockaddr_in addr[GTPC_BURST];
+	uint8_t buf[GTPC_BURST][MAX_GTPV2C_UDP_LEN];
+};
+
+static struct gtpc_burst gtpc_rx;
+static struct gtpc_burst gtpc_tx[GTPC_NB_IF];
+static int gtpc_epfd = -1;
+
+static void
+gtpc_burst_init(struct gtpc_burst *b)
+{
+	unsigned i;
+
+	b->fd = -1;
+	b->n = 0;
+	for (i = 0; i < GTPC_BURST; i++) {
+		b->iov[i].iov_base = b->buf[i];
+		b->iov[i].iov_len = MAX_GTPV2C_UDP_LEN;
+		b->msg[i].msg_hdr.msg_name = &b->addr[i];
+		b->msg[i].msg_hdr.msg_namelen = sizeof(b->addr[i]);
+		b->msg[i].msg_hdr.msg_iov = &b->iov[i];
+		b->msg[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/**
+ * @brief
+ * Sends the queued gtpv2c messages of a socket
+ */
+static void
+gtpc_tx_flush(struct gtpc_burst *tx)
+{
+	unsigned i = 0, j;
+	int ret;
+
+	while (i < tx->n) {
+		ret = sendmmsg(tx->fd, &tx->msg[i], tx->n - i, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "sendmmsg error on fd %d: %s - "
+					"dropped %u GTPv2c Messages\n",
+					tx->fd, strerror(errno), tx->n - i);
+			break;
+		}
+		for (j = i; j < i + ret; j++) {
+			if (tx->msg[j].msg_len != tx->iov[j].iov_len)
+				fprintf(stderr, "Transmitted Incomplete GTPv2c "
+						"Message: %zu of %u tx bytes\n",
+						tx->iov[j].iov_len,
+						tx->msg[j].msg_len);
+		}
+		i += ret;
+	}
+	tx->n = 0;
+}
+
+static void
+gtpc_tx_flush_all(void)
+{
+	unsigned i;
+
+	for (i = 0; i < GTPC_NB_IF; i++)
+		gtpc_tx_flush(&gtpc_tx[i]);
+}
+
+#ifndef CP_WORKERS
+/**
+ * @brief
+ * Queues a gtpv2c message, sent by the next gtpc_tx_flush() of its socket
+ * @return
+ * 0 on success, -1 if no queue is free for the socket
+ */
+static int
+gtpc_tx_enqueue(int fd, uint8_t *buf, uint16_t len,
+		struct sockaddr *dest_addr, socklen_t dest_addr_len)
+{
+	struct gtpc_burst *tx = NULL;
+	unsigned i;
+
+	/* keep the messages of a socket in order */
+	for (i = 0; i < GTPC_NB_IF && tx == NULL; i++)
+		if (gtpc_tx[i].n && gtpc_tx[i].fd == fd)
+			tx = &gtpc_tx[i];
+	for (i = 0; i < GTPC_NB_IF && tx == NULL; i++)
+		if (gtpc_tx[i].n == 0)
+			tx = &gtpc_tx[i];
+	if (tx == NULL || dest_addr_len > sizeof(tx->addr[0]))
+		return -1;
+
+	tx->fd = fd;
+	memcpy(tx->buf[tx->n], buf, len);
+	tx->iov[tx->n].iov_len = len;
+	memcpy(&tx->addr[tx->n], dest_addr, dest_addr_len);
+	tx->msg[tx->n].msg_hdr.msg_namelen = dest_addr_len;
+	if (++tx->n == GTPC_BURST)
+		gtpc_tx_flush(tx);
+	return 0;
+}
+#endif /* CP_WORKERS */
+/**
+ * @brief
+ * Adds the s11 and s5s8 sockets to the epoll set of control_plane()
+ */
+static void
+gtpc_init(void)
+{
+	int fds[GTPC_NB_IF] = {s11_fd, s5s8_sgwc_fd, s5s8_pgwc_fd};
+	struct epoll_event ev = {.events = EPOLLIN};
+	unsigned i;
+
+	gtpc_epfd = epoll_create1(0);
+	if (gtpc_epfd < 0)
+		rte_panic("epoll_create1 failed: %s\n", strerror(errno));
+	for (i = 0; i < GTPC_NB_IF; i++) {
+		if (fds[i] < 0)
+			continue;
+		ev.data.fd = fds[i];
+		if (epoll_ctl(gtpc_epfd, EPOLL_CTL_ADD, fds[i], &ev) < 0)
+			rte_panic("epoll_ctl fd %d failed: %s\n",
+					fds[i], strerror(errno));
+	}
+
+	gtpc_burst_init(&gtpc_rx);
+	for (i = 0; i < GTPC_NB_IF; i++)
+		gtpc_burst_init(&gtpc_tx[i]);
+}
+#endif /* GTPC_BATCH */
+
+#if defined(GTPC_TIMERS) && !defined(CP_WORKERS) && !defined(SDN_ODL_BUILD)
+#define DDN_QUEUE
+/** DDNs queued by the nb listener, power of 2 */
+#define DDN_RING_SIZE                (4096)
+/** DDNs dequeued per burst */
+#define DDN_BURST                    (32)
+
+/**
+ * Session ids of the DDNs received by the nb listener. control_plane()
+ * sends them on the lcore that receives their acks and polls their
+ * retransmission timers.
+ */
+static struct rte_ring *ddn_ring;
+#ifdef GTPC_BATCH
+/** Wakes up the epoll_wait() of gtpc_burst() */
+static int ddn_evfd = -1;
+#endif
+
+static void
+ddn_queue_init(void)
+{
+	ddn_ring = rte_ring_create("ddn_ring", DDN_RING_SIZE, rte_socket_id(),
+			RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (ddn_ring == NULL)
+		rte_panic("Cannot create ddn_ring: %s\n",
+				rte_strerror(rte_errno));
+#ifdef GTPC_BATCH
+	struct epoll_event ev = {.events = EPOLLIN};
+
+	ddn_evfd = eventfd(0, EFD_NONBLOCK);
+	if (ddn_evfd < 0)
+		rte_panic("eventfd failed: %s\n", strerror(errno));
+	ev.data.fd = ddn_evfd;
+	if (epoll_ctl(gtpc_epfd, EPOLL_CTL_ADD, ddn_evfd, &ev) < 0)
+		rte_panic("epoll_ctl fd %d failed: %s\n",
+				ddn_evfd, strerror(errno));
+#endif
+}
+
+/**
+ * @brief queues a DDN to control_plane(), called by the nb listener
+ * @param session_id
+ * session identifier pertaining to downlink data packets arrived at DP
+ * @return
+ * 0 on success, -1 if the queue is full
+ */
+static int
+ddn_queue(uint64_t session_id)
+{
+	if (rte_ring_sp_enqueue(ddn_ring, (void *)(uintptr_t)session_id)
+			== -ENOBUFS)
+		return -1;
+#ifdef GTPC_BATCH
+	uint64_t one = 1;
+
+	if (write(ddn_evfd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		fprintf(stderr, "DDN eventfd write error: %s\n",
+				strerror(errno));
+#endif
+	return 0;
+}
+
+/**
+ * @brief sends the DDNs queued by the nb listener
+ */
+static void
+ddn_drain(void)
+{
+	void *sess_id[DDN_BURST];
+	unsigned i, n;
+	int ret;
+
+	do {
+		n = rte_ring_sc_dequeue_burst(ddn_ring, sess_id, DDN_BURST);
+		for (i = 0; i < n; i++) {
+			ret = ddn_by_session_id((uintptr_t)sess_id[i]);
+			if (ret)
+				fprintf(stderr, "Error on DDN Handling %s: "
+						"(%d) %s\n", gtp_type_str(ret), ret,
+						(ret < 0 ? strerror(-ret)
+						 : cause_str(ret)));
+		}
+	} while (n == DDN_BURST);
+}
+#endif /* DDN_QUEUE */
+
 /**
  * @brief
  * Initializes Control Plane data structures, packet filters, and calls for the
@@ -437,6 +700,29 @@ init_cp(void)
 		break;
 	}
 
+#ifdef GTPC_BATCH
+	gtpc_init();
+#endif
+#ifdef DDN_QUEUE
+	ddn_queue_init();
+#endif
+
+#ifdef GTPC_TEMPLATES
+	gtpv2c_template_init();
+#endif
+
+#ifdef CP_MSG_STATS
+	cp_telemetry_init();
+#endif
+
+#ifdef GTPC_TIMERS
+	gtpc_timer_init();
+#ifndef CP_WORKERS
+	/* CP worker 0 processes the echo responses */
+	gtpc_echo_init();
+#endif
+#endif
+
 	iface_module_constructor();
 
 	if (signal(SIGINT, sig_handler) == SIG_ERR)
@@ -450,8 +736,19 @@ init_cp(void)
 	parse_adc_rules();
 	init_packet_filters();
 #endif
+#ifdef CP_DP_COALESCE
+	cp_dp_flush();
+#endif
 
+#ifdef CP_OBJ_POOL
+	create_ue_pools();
+#endif
+	create_ip_pools();
+
+#ifndef CP_WORKERS
+	/* each CP worker creates the hashes of its shard */
 	create_ue_hash();
+#endif
 }
 
 /**
@@ -467,6 +764,12 @@ gtpv2c_send(int gtpv2c_if_fd, uint8_t *gtpv2c_tx_buf,
 	if (pcap_dumper) {
 		dump_pcap(gtpv2c_pyld_len, gtpv2c_tx_buf);
 	} else {
+#if defined(GTPC_BATCH) && !defined(CP_WORKERS)
+		/* CP workers send their replies right away */
+		if (gtpc_tx_enqueue(gtpv2c_if_fd, gtpv2c_tx_buf, gtpv2c_pyld_len,
+				dest_addr, dest_addr_len) == 0)
+			return;
+#endif
 		bytes_tx = sendto(gtpv2c_if_fd, gtpv2c_tx_buf, gtpv2c_pyld_len, 0,
 			(struct sockaddr *) dest_addr, dest_addr_len);
 		RTE_LOG(DEBUG, CP, "NGIC- main.c::gtpv2c_send()"
@@ -480,10 +783,36 @@ gtpv2c_send(int gtpv2c_if_fd, uint8_t *gtpv2c_tx_buf,
 	}
 }
 
+/**
+ * @brief
+ * Util to send or dump gtpv2c requests, retransmitted until answered
+ * @param teid
+ * local s11 sgw gtpc teid of the UE the request is for, 0 if none
+ */
+static void
+gtpv2c_send_request(int gtpv2c_if_fd, uint8_t *gtpv2c_tx_buf,
+		uint16_t gtpv2c_pyld_len, struct sockaddr *dest_addr,
+		socklen_t dest_addr_len, uint32_t teid)
+{
+	gtpv2c_send(gtpv2c_if_fd, gtpv2c_tx_buf, gtpv2c_pyld_len, dest_addr,
+			dest_addr_len);
+#ifdef GTPC_TIMERS
+	gtpc_timer_request(gtpv2c_if_fd, gtpv2c_tx_buf, gtpv2c_pyld_len,
+			(struct sockaddr_in *) dest_addr, teid);
+#else
+	RTE_SET_USED(teid);
+#endif
+}
+
 void
 dump_pcap(uint16_t payload_length, uint8_t *tx_buf)
 {
 	static struct pcap_pkthdr pcap_tx_header;
+#ifdef CP_WORKERS
+	static rte_spinlock_t pcap_lock = RTE_SPINLOCK_INITIALIZER;
+
+	rte_spinlock_lock(&pcap_lock);
+#endif
 	gettimeofday(&pcap_tx_header.ts, NULL);
 	pcap_tx_header.caplen = payload_length
 			+ sizeof(struct ether_hdr)
@@ -527,18 +856,30 @@ dump_pcap(uint16_t payload_length, uint8_t *tx_buf)
 	pcap_dump((u_char *) pcap_dumper, &pcap_tx_header,
 			dump_buf);
 	fflush(pcap_dump_file(pcap_dumper));
+#ifdef CP_WORKERS
+	rte_spinlock_unlock(&pcap_lock);
+#endif
 }
 
-void
-control_plane(void)
+/**
+ * @brief
+ * Processes a GTPv2c message received on s11 or s5s8, and sends its reply
+ * @param gtpv2c_s11_rx
+ * message received on s11
+ * @param bytes_s11_rx
+ * length of s11 message, 0 if none
+ * @param gtpv2c_s5s8_rx
+ * message received on s5s8
+ * @param bytes_s5s8_rx
+ * length of s5s8 message, 0 if none
+ * @return
+ * 0 if the message was accepted, GTPv2c cause or -errno if rejected
+ */
+static int
+handle_gtpv2c_msg(gtpv2c_header *gtpv2c_s11_rx, int bytes_s11_rx,
+		gtpv2c_header *gtpv2c_s5s8_rx, int bytes_s5s8_rx)
 {
-	bzero(&s11_rx_buf, sizeof(s11_rx_buf));
-	bzero(&s11_tx_buf, sizeof(s11_tx_buf));
-	bzero(&s5s8_rx_buf, sizeof(s5s8_rx_buf));
-	bzero(&s5s8_tx_buf, sizeof(s5s8_tx_buf));
-	gtpv2c_header *gtpv2c_s11_rx = (gtpv2c_header *) s11_rx_buf;
 	gtpv2c_header *gtpv2c_s11_tx = (gtpv2c_header *) s11_tx_buf;
-	gtpv2c_header *gtpv2c_s5s8_rx = (gtpv2c_header *) s5s8_rx_buf;
 	gtpv2c_header *gtpv2c_s5s8_tx = (gtpv2c_header *) s5s8_tx_buf;
 
 	uint16_t payload_length;
@@ -547,80 +888,11 @@ control_plane(void)
 	socklen_t s5s8_pgwc_sockaddr_len = sizeof(s5s8_pgwc_sockaddr);
 
 	uint8_t delay = 0; /*TODO move this when more implemented?*/
-	int bytes_pcap_rx = 0;
-	int bytes_s11_rx = 0;
-	int bytes_s5s8_rx = 0;
 	static uint8_t s11_msgcnt = 0;
 	static uint8_t s5s8_sgwc_msgcnt = 0;
 	static uint8_t s5s8_pgwc_msgcnt = 0;
 	int ret = 0;
 
-	if (pcap_reader) {
-		static struct pcap_pkthdr *pcap_rx_header;
-		const u_char *t;
-		const u_char **tmp = &t;
-		ret = pcap_next_ex(pcap_reader, &pcap_rx_header, tmp);
-		if (ret < 0) {
-			printf("Finished reading from pcap file"
-					" - exiting\n");
-			exit(0);
-		}
-		bytes_pcap_rx = pcap_rx_header->caplen
-				- (sizeof(struct ether_hdr)
-				+ sizeof(struct ipv4_hdr)
-				+ sizeof(struct udp_hdr));
-		memcpy(gtpv2c_s11_rx, *tmp
-				+ (sizeof(struct ether_hdr)
-				+ sizeof(struct ipv4_hdr)
-				+ sizeof(struct udp_hdr)), bytes_pcap_rx);
-	}
-
-	if (spgw_cfg == SGWC) {
-		bytes_s5s8_rx = recvfrom(s5s8_sgwc_fd, s5s8_rx_buf,
-				MAX_GTPV2C_UDP_LEN, MSG_DONTWAIT,
-				(struct sockaddr *) &s5s8_sgwc_sockaddr,
-				&s5s8_sgwc_sockaddr_len);
-		if (bytes_s5s8_rx == 0) {
-			fprintf(stderr, "SGWC_s5s8 recvfrom error:"
-					"\n\ton %s:%u - %s\n",
-					inet_ntoa(s5s8_sgwc_sockaddr.sin_addr),
-					s5s8_sgwc_sockaddr.sin_port,
-					strerror(errno));
-		}
-	}
-	if (spgw_cfg == PGWC) {
-		bytes_s5s8_rx = recvfrom(s5s8_pgwc_fd, s5s8_rx_buf,
-				MAX_GTPV2C_UDP_LEN, MSG_DONTWAIT,
-				(struct sockaddr *) &s5s8_sgwc_sockaddr,
-				&s5s8_sgwc_sockaddr_len);
-		if (bytes_s5s8_rx == 0) {
-			fprintf(stderr, "PGWC_s5s8 recvfrom error:"
-					"\n\ton %s:%u - %s\n",
-					inet_ntoa(s5s8_sgwc_sockaddr.sin_addr),
-					s5s8_sgwc_sockaddr.sin_port,
-					strerror(errno));
-		}
-	}
-	if ((spgw_cfg == SGWC) || (spgw_cfg == SPGWC)) {
-			bytes_s11_rx = recvfrom(s11_fd, s11_rx_buf,
-					MAX_GTPV2C_UDP_LEN, MSG_DONTWAIT,
-					(struct sockaddr *) &s11_mme_sockaddr,
-					&s11_mme_sockaddr_len);
-		if (bytes_s11_rx == 0) {
-			fprintf(stderr, "SGWC|SPGWC_s11 recvfrom error:"
-					"\n\ton %s:%u - %s\n",
-					inet_ntoa(s11_mme_sockaddr.sin_addr),
-					s11_mme_sockaddr.sin_port,
-					strerror(errno));
-			return;
-		}
-	}
-	if (
-		(bytes_s5s8_rx < 0) && (bytes_s11_rx < 0) &&
-		(errno == EAGAIN  || errno == EWOULDBLOCK)
-		)
-		return;
-
 	if ((spgw_cfg == SGWC) || (spgw_cfg == PGWC)) {
 		if ((bytes_s5s8_rx > 0) &&
 			 (unsigned)bytes_s5s8_rx != (
@@ -660,12 +932,12 @@ control_plane(void)
 					sizeof(gtpv2c_s11_rx->gtpc),
 					ntohs(gtpv2c_s11_rx->gtpc.length)
 					+ sizeof(gtpv2c_s11_rx->gtpc));
-			return;
+			return ret;
 		}
 	}
 
 	if ((bytes_s5s8_rx > 0) || (bytes_s11_rx > 0))
-		++cp_stats.rx;
+		CP_STATS_INC(rx);
 
 	if (!pcap_reader) {
 			if (
@@ -681,7 +953,7 @@ control_plane(void)
 						inet_ntoa(s11_mme_sockaddr.sin_addr),
 						ntohs(s11_mme_sockaddr.sin_port),
 						inet_ntoa(s11_mme_ip));
-				return;
+				return -EPERM;
 			} else if (
 						 ((spgw_cfg == PGWC) && (bytes_s5s8_rx > 0)) &&
 						 (
@@ -695,10 +967,22 @@ control_plane(void)
 						inet_ntoa(s5s8_sgwc_sockaddr.sin_addr),
 						ntohs(s5s8_sgwc_sockaddr.sin_port),
 						inet_ntoa(s5s8_sgwc_ip));
-				return;
+				return -EPERM;
 			}
 	}
 
+#ifdef GTPC_TIMERS
+	/* responses stop the retransmission of their request */
+	if (bytes_s11_rx > 0 && gtpc_timer_response(gtpv2c_s11_rx,
+			&s11_mme_sockaddr) == 0 &&
+			gtpv2c_s11_rx->gtpc.type == GTP_ECHO_RSP)
+		return ret;
+	if (bytes_s5s8_rx > 0 && gtpc_timer_response(gtpv2c_s5s8_rx,
+			&s5s8_sgwc_sockaddr) == 0 &&
+			gtpv2c_s5s8_rx->gtpc.type == GTP_ECHO_RSP)
+		return ret;
+#endif
+
 	if (bytes_s5s8_rx > 0) {
 		if (spgw_cfg == SGWC) {
 			switch (gtpv2c_s5s8_rx->gtpc.type) {
@@ -714,7 +998,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s5s8_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
@@ -749,7 +1033,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s5s8_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
@@ -780,7 +1064,7 @@ control_plane(void)
 						spgw_cfg, gtp_type_str(gtpv2c_s5s8_rx->gtpc.type),
 						gtpv2c_s5s8_rx->gtpc.type,
 						gtpv2c_s5s8_rx->gtpc.type);
-				return;
+				return -ENOTSUP;
 				break;
 			}
 		}
@@ -798,7 +1082,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s5s8_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s5s8_tx->gtpc.length)
 						+ sizeof(gtpv2c_s5s8_tx->gtpc);
@@ -828,7 +1112,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s5s8_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s5s8_tx->gtpc.length)
 						+ sizeof(gtpv2c_s5s8_tx->gtpc);
@@ -855,7 +1139,7 @@ control_plane(void)
 						spgw_cfg, gtp_type_str(gtpv2c_s5s8_rx->gtpc.type),
 						gtpv2c_s5s8_rx->gtpc.type,
 						gtpv2c_s5s8_rx->gtpc.type);
-				return;
+				return -ENOTSUP;
 				break;
 			}
 		}
@@ -875,7 +1159,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				if (spgw_cfg == SGWC) {
 					/* Forward s11 create_session_request on s5s8 */
@@ -891,9 +1175,10 @@ control_plane(void)
 							inet_ntoa(s5s8_pgwc_sockaddr.sin_addr),
 							s5s8_pgwc_sockaddr_len,
 							ntohs(s5s8_pgwc_sockaddr.sin_port));
-					gtpv2c_send(s5s8_sgwc_fd, s5s8_tx_buf, payload_length,
+					gtpv2c_send_request(s5s8_sgwc_fd, s5s8_tx_buf,
+							payload_length,
 							(struct sockaddr *) &s5s8_pgwc_sockaddr,
-							s5s8_pgwc_sockaddr_len);
+							s5s8_pgwc_sockaddr_len, 0);
 					s5s8_sgwc_msgcnt++;
 				} else if (spgw_cfg == SPGWC) {
 					payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
@@ -915,7 +1200,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				if (spgw_cfg == SGWC) {
 					/* Forward s11 delete_session_request on s5s8 */
@@ -931,9 +1216,10 @@ control_plane(void)
 							inet_ntoa(s5s8_pgwc_sockaddr.sin_addr),
 							s5s8_pgwc_sockaddr_len,
 							ntohs(s5s8_pgwc_sockaddr.sin_port));
-					gtpv2c_send(s5s8_sgwc_fd, s5s8_tx_buf, payload_length,
+					gtpv2c_send_request(s5s8_sgwc_fd, s5s8_tx_buf,
+							payload_length,
 							(struct sockaddr *) &s5s8_pgwc_sockaddr,
-							s5s8_pgwc_sockaddr_len);
+							s5s8_pgwc_sockaddr_len, 0);
 					s5s8_sgwc_msgcnt++;
 				} else if (spgw_cfg == SPGWC) {
 					payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
@@ -955,7 +1241,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
 						+ sizeof(gtpv2c_s11_tx->gtpc);
@@ -975,7 +1261,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
 						+ sizeof(gtpv2c_s11_tx->gtpc);
@@ -995,12 +1281,15 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
 						+ sizeof(gtpv2c_s11_tx->gtpc);
-				gtpv2c_send(s11_fd, s11_tx_buf, payload_length,
-						(struct sockaddr *) &s11_mme_sockaddr, s11_mme_sockaddr_len);
+				/* create or delete bearer request to the MME */
+				gtpv2c_send_request(s11_fd, s11_tx_buf, payload_length,
+						(struct sockaddr *) &s11_mme_sockaddr,
+						s11_mme_sockaddr_len,
+						gtpv2c_s11_rx->teid_u.has_teid.teid);
 				break;
 
 			case GTP_CREATE_BEARER_RSP:
@@ -1013,7 +1302,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
 						+ sizeof(gtpv2c_s11_tx->gtpc);
@@ -1032,7 +1321,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
 						+ sizeof(gtpv2c_s11_tx->gtpc);
@@ -1051,7 +1340,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 
 				/* TODO something with delay if set */
@@ -1067,7 +1356,7 @@ control_plane(void)
 							gtp_type_str(gtpv2c_s11_rx->gtpc.type), ret,
 							(ret < 0 ? strerror(-ret) : cause_str(ret)));
 					/* Error handling not implemented */
-					return;
+					return ret;
 				}
 				payload_length = ntohs(gtpv2c_s11_tx->gtpc.length)
 						+ sizeof(gtpv2c_s11_tx->gtpc);
@@ -1084,14 +1373,14 @@ control_plane(void)
 						spgw_cfg, gtp_type_str(gtpv2c_s11_rx->gtpc.type),
 						gtpv2c_s11_rx->gtpc.type,
 						gtpv2c_s11_rx->gtpc.type);
-				return;
+				return -ENOTSUP;
 				break;
 			}
 		}
 	}
 
 	if ((bytes_s5s8_rx > 0) || (bytes_s11_rx > 0))
-		++cp_stats.tx;
+		CP_STATS_INC(tx);
 
 	switch (spgw_cfg) {
 	case SGWC:
@@ -1099,30 +1388,30 @@ control_plane(void)
 		if (bytes_s11_rx > 0) {
 			switch (gtpv2c_s11_rx->gtpc.type) {
 			case GTP_CREATE_SESSION_REQ:
-				cp_stats.create_session++;
+				CP_STATS_INC(create_session);
 				break;
 			case GTP_DELETE_SESSION_REQ:
-				cp_stats.delete_session++;
+				CP_STATS_INC(delete_session);
 				break;
 			case GTP_MODIFY_BEARER_REQ:
-				cp_stats.modify_bearer++;
+				CP_STATS_INC(modify_bearer);
 				break;
 			case GTP_RELEASE_ACCESS_BEARERS_REQ:
-				cp_stats.rel_access_bearer++;
+				CP_STATS_INC(rel_access_bearer);
 				break;
 			case GTP_BEARER_RESOURCE_CMD:
-				cp_stats.bearer_resource++;
+				CP_STATS_INC(bearer_resource);
 				break;
 			case GTP_CREATE_BEARER_RSP:
-				cp_stats.create_bearer++;
-				return;
+				CP_STATS_INC(create_bearer);
+				return ret;
 			case GTP_DELETE_BEARER_RSP:
-				cp_stats.delete_bearer++;
-				return;
+				CP_STATS_INC(delete_bearer);
+				return ret;
 			case GTP_DOWNLINK_DATA_NOTIFICATION_ACK:
-				cp_stats.ddn_ack++;
+				CP_STATS_INC(ddn_ack);
 			case GTP_ECHO_REQ:
-				cp_stats.echo++;
+				CP_STATS_INC(echo);
 				break;
 			}
 		}
@@ -1131,10 +1420,10 @@ control_plane(void)
 		if (bytes_s5s8_rx > 0) {
 			switch (gtpv2c_s5s8_rx->gtpc.type) {
 			case GTP_CREATE_SESSION_REQ:
-				cp_stats.create_session++;
+				CP_STATS_INC(create_session);
 				break;
 			case GTP_DELETE_SESSION_REQ:
-				cp_stats.delete_session++;
+				CP_STATS_INC(delete_session);
 				break;
 			}
 		}
@@ -1144,6 +1433,247 @@ control_plane(void)
 				"Unknown spgw_cfg= %u.", spgw_cfg);
 		break;
 	}
+	return ret;
+}
+
+/**
+ * @brief
+ * Processes a GTPv2c message received on s11 or s5s8, and sends its reply,
+ * accounting it to its message type with CP_MSG_STATS
+ * @param gtpv2c_s11_rx
+ * message received on s11
+ * @param bytes_s11_rx
+ * length of s11 message, 0 if none
+ * @param gtpv2c_s5s8_rx
+ * message received on s5s8
+ * @param bytes_s5s8_rx
+ * length of s5s8 message, 0 if none
+ */
+static void
+process_gtpv2c_msg(gtpv2c_header *gtpv2c_s11_rx, int bytes_s11_rx,
+		gtpv2c_header *gtpv2c_s5s8_rx, int bytes_s5s8_rx)
+{
+#ifdef CP_MSG_STATS
+	uint8_t type;
+	int ret;
+
+	if (bytes_s11_rx > 0)
+		type = gtpv2c_s11_rx->gtpc.type;
+	else if (bytes_s5s8_rx > 0)
+		type = gtpv2c_s5s8_rx->gtpc.type;
+	else
+		return;
+
+	cp_msg_begin();
+	ret = handle_gtpv2c_msg(gtpv2c_s11_rx, bytes_s11_rx,
+			gtpv2c_s5s8_rx, bytes_s5s8_rx);
+	cp_msg_end(type, ret);
+#else
+	handle_gtpv2c_msg(gtpv2c_s11_rx, bytes_s11_rx,
+			gtpv2c_s5s8_rx, bytes_s5s8_rx);
+#endif
+}
+
+#if defined(GTPC_BATCH) || defined(CP_WORKERS)
+void
+cp_process_msg(int fd, const struct sockaddr_in *peer, uint8_t *buf, int len)
+{
+	bzero(&s11_tx_buf, sizeof(s11_tx_buf));
+	bzero(&s5s8_tx_buf, sizeof(s5s8_tx_buf));
+	/* the replies go to the sender, as with recvfrom */
+	if (fd == s11_fd) {
+		s11_mme_sockaddr = *peer;
+		process_gtpv2c_msg((gtpv2c_header *) buf, len,
+				(gtpv2c_header *) s5s8_rx_buf, 0);
+	} else {
+		s5s8_sgwc_sockaddr = *peer;
+		process_gtpv2c_msg((gtpv2c_header *) s11_rx_buf, 0,
+				(gtpv2c_header *) buf, len);
+	}
+}
+#endif
+
+#ifdef GTPC_BATCH
+/**
+ * @brief
+ * Receives and processes a burst of gtpv2c messages of a socket
+ */
+static void
+gtpc_rx_burst(int fd)
+{
+	struct gtpc_burst *rx = &gtpc_rx;
+	int i, n;
+
+	for (i = 0; i < GTPC_BURST; i++)
+		rx->msg[i].msg_hdr.msg_namelen = sizeof(rx->addr[i]);
+
+	n = recvmmsg(fd, rx->msg, GTPC_BURST, MSG_DONTWAIT, NULL);
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			fprintf(stderr, "recvmmsg error on fd %d: %s\n",
+					fd, strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		cp_process_msg(fd, &rx->addr[i], rx->buf[i], rx->msg[i].msg_len);
+}
+
+/**
+ * @brief
+ * Waits for gtpv2c messages on the s11 and s5s8 sockets, processes a
+ * burst of each ready socket and sends the replies in bursts
+ */
+static void
+gtpc_burst(void)
+{
+	/* and the DDN eventfd */
+	struct epoll_event ev[GTPC_NB_IF + 1];
+	int i, n;
+
+#ifdef GTPC_TIMERS
+	n = epoll_wait(gtpc_epfd, ev, RTE_DIM(ev), gtpc_timer_timeout_ms());
+	gtpc_timer_poll();
+#else
+	n = epoll_wait(gtpc_epfd, ev, RTE_DIM(ev), -1);
+#endif
+	if (n < 0) {
+		if (errno != EINTR)
+			fprintf(stderr, "epoll_wait error: %s\n",
+					strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+#ifdef DDN_QUEUE
+		if (ev[i].data.fd == ddn_evfd) {
+			uint64_t cnt;
+
+			if (read(ddn_evfd, &cnt, sizeof(cnt)) < 0 &&
+					errno != EAGAIN)
+				fprintf(stderr, "DDN eventfd read error: %s\n",
+						strerror(errno));
+			ddn_drain();
+			continue;
+		}
+#endif
+		gtpc_rx_burst(ev[i].data.fd);
+	}
+	gtpc_tx_flush_all();
+#ifdef CP_DP_COALESCE
+	cp_dp_flush();
+#endif
+}
+#endif /* GTPC_BATCH */
+
+void
+control_plane(void)
+{
+#ifdef CP_WORKERS
+	cp_dispatch();
+	return;
+#endif
+#ifdef GTPC_BATCH
+	if (!pcap_reader) {
+		gtpc_burst();
+		return;
+	}
+#endif
+#ifdef GTPC_TIMERS
+	gtpc_timer_poll();
+#endif
+#ifdef DDN_QUEUE
+	ddn_drain();
+#endif
+	bzero(&s11_rx_buf, sizeof(s11_rx_buf));
+	bzero(&s11_tx_buf, sizeof(s11_tx_buf));
+	bzero(&s5s8_rx_buf, sizeof(s5s8_rx_buf));
+	bzero(&s5s8_tx_buf, sizeof(s5s8_tx_buf));
+	gtpv2c_header *gtpv2c_s11_rx = (gtpv2c_header *) s11_rx_buf;
+	gtpv2c_header *gtpv2c_s5s8_rx = (gtpv2c_header *) s5s8_rx_buf;
+
+	socklen_t s11_mme_sockaddr_len = sizeof(s11_mme_sockaddr);
+	socklen_t s5s8_sgwc_sockaddr_len = sizeof(s5s8_sgwc_sockaddr);
+
+	int bytes_pcap_rx = 0;
+	int bytes_s11_rx = 0;
+	int bytes_s5s8_rx = 0;
+	int ret = 0;
+
+	if (pcap_reader) {
+		static struct pcap_pkthdr *pcap_rx_header;
+		const u_char *t;
+		const u_char **tmp = &t;
+		ret = pcap_next_ex(pcap_reader, &pcap_rx_header, tmp);
+		if (ret < 0) {
+			printf("Finished reading from pcap file"
+					" - exiting\n");
+			exit(0);
+		}
+		bytes_pcap_rx = pcap_rx_header->caplen
+				- (sizeof(struct ether_hdr)
+				+ sizeof(struct ipv4_hdr)
+				+ sizeof(struct udp_hdr));
+		memcpy(gtpv2c_s11_rx, *tmp
+				+ (sizeof(struct ether_hdr)
+				+ sizeof(struct ipv4_hdr)
+				+ sizeof(struct udp_hdr)), bytes_pcap_rx);
+	}
+
+	if (spgw_cfg == SGWC) {
+		bytes_s5s8_rx = recvfrom(s5s8_sgwc_fd, s5s8_rx_buf,
+				MAX_GTPV2C_UDP_LEN, MSG_DONTWAIT,
+				(struct sockaddr *) &s5s8_sgwc_sockaddr,
+				&s5s8_sgwc_sockaddr_len);
+		if (bytes_s5s8_rx == 0) {
+			fprintf(stderr, "SGWC_s5s8 recvfrom error:"
+					"\n\ton %s:%u - %s\n",
+					inet_ntoa(s5s8_sgwc_sockaddr.sin_addr),
+					s5s8_sgwc_sockaddr.sin_port,
+					strerror(errno));
+		}
+	}
+	if (spgw_cfg == PGWC) {
+		bytes_s5s8_rx = recvfrom(s5s8_pgwc_fd, s5s8_rx_buf,
+				MAX_GTPV2C_UDP_LEN, MSG_DONTWAIT,
+				(struct sockaddr *) &s5s8_sgwc_sockaddr,
+				&s5s8_sgwc_sockaddr_len);
+		if (bytes_s5s8_rx == 0) {
+			fprintf(stderr, "PGWC_s5s8 recvfrom error:"
+					"\n\ton %s:%u - %s\n",
+					inet_ntoa(s5s8_sgwc_sockaddr.sin_addr),
+					s5s8_sgwc_sockaddr.sin_port,
+					strerror(errno));
+		}
+	}
+	if ((spgw_cfg == SGWC) || (spgw_cfg == SPGWC)) {
+			bytes_s11_rx = recvfrom(s11_fd, s11_rx_buf,
+					MAX_GTPV2C_UDP_LEN, MSG_DONTWAIT,
+					(struct sockaddr *) &s11_mme_sockaddr,
+					&s11_mme_sockaddr_len);
+		if (bytes_s11_rx == 0) {
+			fprintf(stderr, "SGWC|SPGWC_s11 recvfrom error:"
+					"\n\ton %s:%u - %s\n",
+					inet_ntoa(s11_mme_sockaddr.sin_addr),
+					s11_mme_sockaddr.sin_port,
+					strerror(errno));
+			return;
+		}
+	}
+	if (
+		(bytes_s5s8_rx < 0) && (bytes_s11_rx < 0) &&
+		(errno == EAGAIN  || errno == EWOULDBLOCK)
+		)
+		return;
+
+	process_gtpv2c_msg(gtpv2c_s11_rx, bytes_s11_rx,
+			gtpv2c_s5s8_rx, bytes_s5s8_rx);
+#ifdef GTPC_BATCH
+	gtpc_tx_flush_all();
+#endif
+#ifdef CP_DP_COALESCE
+	cp_dp_flush();
+#endif
 }
 
 int
@@ -1163,7 +1693,7 @@ ddn_by_session_id(uint64_t session_id) {
 
 	ret = create_downlink_data_notification(context,
 			UE_BEAR_ID(session_id),
-			ddn_sequence,
+			__sync_fetch_and_add(&ddn_sequence, 2),
 			gtpv2c_tx);
 
 	if (ret)
@@ -1191,9 +1721,12 @@ ddn_by_session_id(uint64_t session_id) {
 					"%u of %d tx bytes\n",
 					payload_length, bytes_tx);
 		}
+#ifdef GTPC_TIMERS
+		gtpc_timer_request(s11_fd, tx_buf, payload_length,
+				&mme_s11_sockaddr_in, sgw_s11_gtpc_teid);
+#endif
 	}
-	ddn_sequence += 2;
-	++cp_stats.ddn;
+	CP_STATS_INC(ddn);
 
 	return 0;
 }
@@ -1210,6 +1743,25 @@ ddn_by_session_id(uint64_t session_id) {
 static int
 cb_ddn(struct msgbuf *msg_payload)
 {
+#ifdef CP_WORKERS
+	/* the worker owning the UE context sends the DDN */
+	int ret = cp_worker_ddn(msg_payload->msg_union.sess_entry.sess_id);
+
+	if (ret)
+		fprintf(stderr, "DDN of session %"PRIu64" dropped, CP workers "
+				"are busy\n",
+				msg_payload->msg_union.sess_entry.sess_id);
+	return ret;
+#elif defined(DDN_QUEUE)
+	/* sent on the lcore that receives its ack */
+	int ret = ddn_queue(msg_payload->msg_union.sess_entry.sess_id);
+
+	if (ret)
+		fprintf(stderr, "DDN of session %"PRIu64" dropped, DDN queue "
+				"is full\n",
+				msg_payload->msg_union.sess_entry.sess_id);
+	return ret;
+#else
 	int ret = ddn_by_session_id(msg_payload->msg_union.sess_entry.sess_id);
 
 	if (ret) {
@@ -1218,6 +1770,28 @@ cb_ddn(struct msgbuf *msg_payload)
 				(ret < 0 ? strerror(-ret) : cause_str(ret)));
 	}
 	return ret;
+#endif
+}
+
+/**
+ * @brief callback to handle the sessions the data plane reclaimed for
+ * inactivity. The bearer stays in its UE context, a later modify bearer
+ * or delete of the CP finds no session on the DP.
+ * @param msg_payload
+ * message payload received by control plane from the data plane
+ * @return
+ * 0 inicates success, error otherwise
+ */
+static int
+cb_sess_reclaim(struct msgbuf *msg_payload)
+{
+	uint64_t sess_id = msg_payload->msg_union.sess_entry.sess_id;
+
+	fprintf(stderr, "DP reclaimed idle session %"PRIu64" of teid 0x%x "
+			"bearer %u\n", sess_id, (uint32_t)UE_SESS_ID(sess_id),
+			(uint32_t)UE_BEAR_ID(sess_id));
+	CP_STATS_INC(sess_reclaim);
+	return 0;
 }
 
 /**
@@ -1232,8 +1806,16 @@ listener(__rte_unused void *arg)
 {
 	iface_init_ipc_node();
 	iface_ipc_register_msg_cb(MSG_DDN, cb_ddn);
-	while (1)
+	iface_ipc_register_msg_cb(MSG_SESS_RECLAIM, cb_sess_reclaim);
+#ifdef MULTI_DP
+	iface_ipc_register_msg_cb(MSG_DP_LOAD, cb_dp_load);
+#endif
+	while (1) {
 		iface_process_ipc_msgs();
+#ifdef CP_DP_COALESCE
+		cp_dp_flush();
+#endif
+	}
 	return 0;
 }
 #endif
@@ -1259,6 +1841,20 @@ init_cp_params(void) {
 		fprintf(stderr, "Insufficient cores in coremask to "
 				"spawn stats thread\n");
 	last_lcore = cp_params.stats_core_id;
+
+#ifdef CP_WORKERS
+	/* all other cores of the coremask process GTPv2c messages */
+	cp_params.nb_workers = 0;
+	while (cp_params.nb_workers < CP_MAX_WORKERS) {
+		last_lcore = rte_get_next_lcore(last_lcore, 1, 0);
+		if (last_lcore == RTE_MAX_LCORE)
+			break;
+		cp_params.worker_core_id[cp_params.nb_workers++] = last_lcore;
+	}
+	if (cp_params.nb_workers == 0)
+		rte_panic("Insufficient cores in coremask to "
+				"spawn CP workers\n");
+#endif
 }
 
 /**
@@ -1301,6 +1897,9 @@ main(int argc, char **argv)
 #else
 	if (cp_params.nb_core_id != RTE_MAX_LCORE)
 		rte_eal_remote_launch(listener, NULL, cp_params.nb_core_id);
+#ifdef CP_WORKERS
+	cp_worker_init();
+#endif
 
 	while (1)
 		control_plane();
@@ -29,9 +29,11 @@
 #include <stdlib.h>
 #include <linux/tcp.h>
 #include <fcntl.h>
+#include <ctype.h>
 
 
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_debug.h>
 #include <rte_mbuf.h>
 #include <rte_errno.h>
@@ -50,10 +52,13 @@
 #include "cp_stats.h"
 #include "packet_filters.h"
 #include "cp_stats.h"
+#include "cp_telemetry.h"
+#include "gtpc_timer.h"
 
 
 #define MESSAGE_BUFFER_SIZE (1 << 13)
 #define OP_ID_HASH_SIZE     (1 << 14)
+#define NB_TX_BUF_SIZE      (1 << 16)
 
 
 #define DO_CHECK_CURL_EASY_SETOPT(one, two, three) \
@@ -91,9 +96,24 @@ int one = 1;
 
 char message_buffer[MESSAGE_BUFFER_SIZE];
 
+#ifdef NB_PIPELINE
+/** configure chunks queued for the request stream, see nb_flush() */
+static char nb_tx_buf[NB_TX_BUF_SIZE];
+static size_t nb_tx_len;
+#endif
+
+/** topology request handle, kept to reuse its connection to the FPC */
+static CURL *curl_topology;
+static struct curl_slist *topology_list;
+
 struct sse_handle_message_event_map {
 	const char *event;
 	void (*sse_handle_message_func)(json_object *d);
+#ifdef NB_JSON_SCAN
+	/** handles the common message shapes in place, without json-c.
+	 * Returns 0 if handled, -1 to parse the message with json-c */
+	int (*sse_scan_message_func)(const char *data, const char *end);
+#endif
 };
 
 
@@ -264,15 +284,15 @@ static void
 get_topology(void) {
 	int ret;
 	long res_code;
-	CURL *curl_topology = NULL;
-	struct curl_slist *topology_list = NULL;
-
-	curl_global_init(CURL_GLOBAL_ALL);
 
-	init_curl(&curl_topology, &topology_list, HTTP_METHOD_GET,
-			SDN_TOPOLOGY_URI_PATH,
-			fpc_ip, fpc_topology_port,
-			&consume_topology_output);
+	if (curl_topology == NULL) {
+		init_curl(&curl_topology, &topology_list, HTTP_METHOD_GET,
+				SDN_TOPOLOGY_URI_PATH,
+				fpc_ip, fpc_topology_port,
+				&consume_topology_output);
+		DO_CHECK_CURL_EASY_SETOPT(curl_topology, CURLOPT_TCP_KEEPALIVE,
+				1L);
+	}
 
 	ret = curl_easy_perform(curl_topology);
 	if (ret != CURLE_OK) {
@@ -670,6 +690,82 @@ close_sse(int fd)
 }
 
 
+#ifdef NB_PIPELINE
+/**
+ * @brief sends the configure chunks queued for the request stream in one go,
+ * called by the server once it processed a round of S11 messages
+ * @return
+ * 0 on success, error otherwise
+ */
+static int
+nb_flush(void)
+{
+	size_t off = 0;
+	ssize_t tx_bytes;
+
+	if (nb_tx_len == 0)
+		return EXIT_SUCCESS;
+
+	if (request_fd == -1) {
+		fprintf(stderr, "Dropping %zu bytes of configure messages - "
+				"no request stream\n", nb_tx_len);
+		nb_tx_len = 0;
+		return EXIT_FAILURE;
+	}
+
+	while (off < nb_tx_len) {
+		tx_bytes = send(request_fd, nb_tx_buf + off,
+				nb_tx_len - off, 0);
+		if (tx_bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Sending of %zu queued bytes failed: "
+					"%s\n", nb_tx_len - off,
+					strerror(errno));
+			nb_tx_len = 0;
+			return EXIT_FAILURE;
+		}
+		off += tx_bytes;
+	}
+
+	DEBUG_PRINTF("\n%d\tFlushed %zu bytes\n", request_fd, nb_tx_len);
+
+	nb_tx_len = 0;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief queues a SSE message for the request stream, flushing the queue
+ * first if the message does not fit
+ * @param event
+ * event string
+ * @param data
+ * data string
+ * @return
+ * 0 on success, error otherwise
+ */
+static int
+queue_sse(const char *event, const char *data)
+{
+	const char *buffer;
+	size_t len;
+
+	buffer = set_message_sse(event, data);
+	if (buffer == NULL)
+		return EXIT_FAILURE;
+
+	len = strlen(buffer);
+	if (nb_tx_len + len > NB_TX_BUF_SIZE && nb_flush())
+		return EXIT_FAILURE;
+
+	memcpy(nb_tx_buf + nb_tx_len, buffer, len);
+	nb_tx_len += len;
+
+	return EXIT_SUCCESS;
+}
+#endif /* NB_PIPELINE */
+
+
 /**
  * @brief wrapper to conduct error handling on sent SSE messages
  * @param fd
@@ -690,6 +786,12 @@ send_sse(int fd, const char *event, const char *data, const char *calling_func)
 	int tx_bytes;
 	size_t len;
 
+#ifdef NB_PIPELINE
+	/* keep queued configure messages ahead of this one */
+	if (fd == request_fd)
+		nb_flush();
+#endif
+
 	buffer = set_message_sse(event, data);
 	if (buffer == NULL)
 		return EXIT_FAILURE;
@@ -1105,16 +1207,240 @@ sse_handle_message_notification(json_object *jobj)
 }
 
 
+#ifdef NB_JSON_SCAN
+/**
+ * @brief skips the JSON white space at p
+ */
+static inline const char *
+json_scan_ws(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' ||
+			*p == '\r'))
+		++p;
+	return p;
+}
+
+/**
+ * @brief skips the JSON string at p, the opening quote
+ * @return
+ * pointer past the closing quote, NULL if the string is not terminated
+ */
+static const char *
+json_scan_skip_string(const char *p, const char *end)
+{
+	for (++p; p < end; ++p) {
+		if (*p == '\\')
+			++p;
+		else if (*p == '"')
+			return p + 1;
+	}
+	return NULL;
+}
+
+/**
+ * @brief skips the JSON value at p, of any type
+ * @return
+ * pointer past the value, NULL on malformed JSON
+ */
+static const char *
+json_scan_skip_value(const char *p, const char *end)
+{
+	unsigned depth = 0;
+
+	do {
+		if (p >= end)
+			return NULL;
+		switch (*p) {
+		case '"':
+			p = json_scan_skip_string(p, end);
+			if (p == NULL)
+				return NULL;
+			continue;
+		case '{':
+		case '[':
+			++depth;
+			break;
+		case '}':
+		case ']':
+			if (depth == 0)
+				return NULL;
+			--depth;
+			break;
+		default:
+			/* number or literal, up to the next delimiter */
+			if (depth == 0) {
+				while (p < end && *p != ',' && *p != '}' &&
+						*p != ']' && *p != ' ' && *p != '\t' &&
+						*p != '\n' && *p != '\r')
+					++p;
+				return p;
+			}
+		}
+		++p;
+	} while (depth);
+
+	return p;
+}
+
+/**
+ * @brief finds the member key of the JSON object at p. Keys are compared
+ * verbatim, escaped keys do not match
+ * @return
+ * pointer to the value of the member, NULL if not found
+ */
+static const char *
+json_scan_member(const char *p, const char *end, const char *key)
+{
+	size_t key_len = strlen(key);
+	const char *k;
+
+	p = json_scan_ws(p, end);
+	if (p >= end || *p != '{')
+		return NULL;
+	p = json_scan_ws(p + 1, end);
+
+	while (p < end && *p == '"') {
+		k = p + 1;
+		p = json_scan_skip_string(p, end);
+		if (p == NULL)
+			return NULL;
+		p = json_scan_ws(p, end);
+		if (p >= end || *p != ':')
+			return NULL;
+		p = json_scan_ws(p + 1, end);
+
+		if ((size_t)(p - k) > key_len && !memcmp(k, key, key_len) &&
+				k[key_len] == '"')
+			return p;
+
+		p = json_scan_skip_value(p, end);
+		if (p == NULL)
+			return NULL;
+		p = json_scan_ws(p, end);
+		if (p >= end || *p != ',')
+			return NULL;
+		p = json_scan_ws(p + 1, end);
+	}
+	return NULL;
+}
+
+/**
+ * @brief follows the member keys of path from the JSON object at p
+ * @return
+ * pointer to the value found, NULL if not found
+ */
+static const char *
+json_scan_path(const char *p, const char *end, const char *const *path)
+{
+	for (; p != NULL && *path != NULL; ++path)
+		p = json_scan_member(p, end, *path);
+	return p;
+}
+
+/**
+ * @brief reads the JSON integer value at p
+ * @return
+ * 0 on success, -1 if the value is not an integer
+ */
+static int
+json_scan_int64(const char *p, const char *end, int64_t *val)
+{
+	char *num_end;
+
+	if (p == NULL || p >= end || (*p != '-' && !isdigit(*p)))
+		return -1;
+	*val = strtoll(p, &num_end, 10);
+	if (num_end > end || *num_end == '.' || *num_end == 'e' ||
+			*num_end == 'E')
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief compares the JSON string value at p with str
+ * @return
+ * 1 if equal, 0 otherwise
+ */
+static int
+json_scan_str_eq(const char *p, const char *end, const char *str)
+{
+	size_t len = strlen(str);
+
+	return p != NULL && p + len + 2 <= end && *p == '"' &&
+			!memcmp(p + 1, str, len) && p[len + 1] == '"';
+}
+
+/**
+ * @brief in place counterpart of sse_handle_message_configure
+ * @return
+ * 0 if handled, -1 to parse the message with json-c
+ */
+static int
+sse_scan_message_configure(const char *data, const char *end)
+{
+	static const char *const op_id_path[] = {"output", "op-id", NULL};
+	int64_t op_id;
+
+	if (json_scan_int64(json_scan_path(data, end, op_id_path), end,
+			&op_id))
+		return -1;
+
+	check_nb_op_id(op_id);
+	return 0;
+}
+
+/**
+ * @brief in place counterpart of sse_handle_message_notification for
+ * config-result-notification and Downlink-Data-Notification messages
+ * @return
+ * 0 if handled, -1 to parse the message with json-c
+ */
+static int
+sse_scan_message_notification(const char *data, const char *end)
+{
+	static const char *const op_id_path[] = {
+			"config-result-notification", "op-id", NULL};
+	static const char *const notify_path[] = {"notify", NULL};
+	static const char *const type_path[] = {"message-type", NULL};
+	static const char *const session_id_path[] = {"session-id", NULL};
+	const char *notify;
+	int64_t val;
+
+	notify = json_scan_path(data, end, notify_path);
+	if (notify == NULL) {
+		if (json_scan_int64(json_scan_path(data, end, op_id_path), end,
+				&val))
+			return -1;
+		/* truncated as by sse_handle_message_notification */
+		del_nb_op_id((uint32_t)val);
+		return 0;
+	}
+
+	if (!json_scan_str_eq(json_scan_path(notify, end, type_path), end,
+			"Downlink-Data-Notification"))
+		return -1;
+	if (json_scan_int64(json_scan_path(notify, end, session_id_path), end,
+			&val))
+		return -1;
+
+	ddn_by_session_id(val);
+	return 0;
+}
+#endif /* NB_JSON_SCAN */
+
+
 /**
  * @brief message hanlder for the sse messages received on the
  * request or notification streams
  * @param msg
- * message received
+ * message received, NUL terminated within the receive buffer
+ * @param len
+ * length of the message
  * @param map
  * used to map the message contents to a handler function
  */
 static void
-sse_handle_message(const char *msg,
+sse_handle_message(const char *msg, size_t len,
 		const struct sse_handle_message_event_map *map)
 {
 	unsigned i;
@@ -1144,6 +1470,14 @@ sse_handle_message(const char *msg,
 	}
 	ptr += strlen(SSE_DATA);
 
+#ifdef NB_JSON_SCAN
+	if (map[i].sse_scan_message_func != NULL &&
+			!map[i].sse_scan_message_func(ptr, msg + len))
+		return;
+#else
+	RTE_SET_USED(len);
+#endif
+
 	jobj = json_tokener_parse_verbose(ptr, &error);
 
 	if (jobj == NULL || error != json_tokener_success) {
@@ -1194,48 +1528,63 @@ check_header(const int fd, const char *rx_buffer)
 }
 
 /**
- * @brief parses an expected  HTTP chunk message
+ * @brief parses an expected HTTP chunk message in place. The chunk data is
+ * handed to the message handler NUL terminated within rx_buffer
  * @param fd
  * file descriptor on the received message
  * @param rx_buffer
  * message contents received
+ * @param len
+ * bytes of message contents received
  * @param map
  * used to map the message contents to a handler function
  * @return
+ * number of bytes processed, 0 if the chunk is not complete yet
  */
 static size_t
-check_chunk(const int fd, const char *rx_buffer,
+check_chunk(const int fd, char *rx_buffer, size_t len,
 		const struct sse_handle_message_event_map *map)
 {
-	unsigned chunk_size;
-	const char *ptr;
-	int n;
-	int ret;
+	unsigned long chunk_size;
+	char *data;
+	char *ptr;
+	char save;
 
-	ret = sscanf(rx_buffer, "%x" CRLF "%n", &chunk_size, &n);
-	if (ret != 1) {
+	chunk_size = strtoul(rx_buffer, &data, 16);
+	if (data == rx_buffer) {
 		fprintf(stderr, "%d\tMissing chunk size:\n%s\n", fd, rx_buffer);
 		return 0;
 	}
 
+	/* skip any chunk extension */
+	ptr = strstr(data, CRLF);
+	if (ptr == NULL)
+		return 0;
+	data = ptr + strlen(CRLF);
+
 	if (chunk_size == 0) {
 		DEBUG_PRINTF("\n\n%d\tReceived empty chunk\n", fd);
-		ptr = strstr(&rx_buffer[n], CRLF CRLF);
+		ptr = strstr(data - strlen(CRLF), CRLF CRLF);
 		if (ptr == NULL)
 			return 0;
 		return ptr - rx_buffer + strlen(CRLF CRLF);
 	}
 
-
-	ptr = strstr(&rx_buffer[n], CRLF);
-	if (ptr == NULL)
+	if ((size_t)(data - rx_buffer) + chunk_size + strlen(CRLF) > len)
 		return 0;
-	while (isspace(*ptr))
-		++ptr;
 
+	ptr = data + chunk_size;
 	DEBUG_PRINTF("\n\n%d\tRecieved\n%*s", fd,
 			(int)(ptr - rx_buffer), rx_buffer);
-	sse_handle_message(&rx_buffer[n], map);
+
+	save = *ptr;
+	*ptr = '\0';
+	sse_handle_message(data, chunk_size, map);
+	*ptr = save;
+
+	ptr += strlen(CRLF);
+	while (isspace(*ptr))
+		++ptr;
 
 	return ptr - rx_buffer;
 }
@@ -1243,22 +1592,22 @@ check_chunk(const int fd, const char *rx_buffer,
 
 /**
  * @brief receives messages (and bufferes if partial message is received).
- * Messages are expected to be HTTP chunked encoded SSE event-data pairs
+ * Messages are expected to be HTTP chunked encoded SSE event-data pairs, they
+ * are handled in place and only a trailing partial message is moved to the
+ * start of the buffer
  * @param fd
  * file descriptor on the received message
- * @param active
- * active buffer to be used on message receipt
- * @param inactive
- * inactive buffer to be used if buffer swapping is required
+ * @param rx_buffer
+ * receive buffer of MESSAGE_BUFFER_SIZE bytes
  * @param buf_size
- * buffer size remaining in active buffer
+ * bytes of a partial message at the start of the buffer
  * @param map
  * used to map the message contents to a handler function
  * @return
  * number bytes received, or error if negative
  */
 static inline int
-rec_stream(int fd, char **active, char **inactive, size_t *buf_size,
+rec_stream(int fd, char *rx_buffer, size_t *buf_size,
 		const struct sse_handle_message_event_map *map)
 {
 	int rx_bytes;
@@ -1266,7 +1615,7 @@ rec_stream(int fd, char **active, char **inactive, size_t *buf_size,
 	size_t consumed_chunk = 0;
 	size_t consumed = 0;
 
-	rx_bytes = recv(fd, &(*active)[*buf_size],
+	rx_bytes = recv(fd, &rx_buffer[*buf_size],
 			MESSAGE_BUFFER_SIZE - *buf_size - 1, 0);
 
 	if (rx_bytes < 0) {
@@ -1279,14 +1628,15 @@ rec_stream(int fd, char **active, char **inactive, size_t *buf_size,
 		return 0;
 
 	*buf_size += rx_bytes;
-	(*active)[*buf_size] = '\0';
+	rx_buffer[*buf_size] = '\0';
 
 	do {
-		consumed_header = check_header(fd, &(*active)[consumed]);
+		consumed_header = check_header(fd, &rx_buffer[consumed]);
 		consumed += consumed_header;
 		if (consumed >= *buf_size)
 			break;
-		consumed_chunk = check_chunk(fd, &(*active)[consumed], map);
+		consumed_chunk = check_chunk(fd, &rx_buffer[consumed],
+				*buf_size - consumed, map);
 		consumed += consumed_chunk;
 	} while (consumed < *buf_size && (consumed_header || consumed_chunk));
 
@@ -1295,14 +1645,13 @@ rec_stream(int fd, char **active, char **inactive, size_t *buf_size,
 	} else if (consumed > *buf_size) {
 		DEBUG_PRINTF("Consumed more than alloted\n");
 		*buf_size = 0;
-	} else {
+	} else if (consumed == 0 && *buf_size == MESSAGE_BUFFER_SIZE - 1) {
+		fprintf(stderr, "%d\tDropping message larger than %d bytes\n",
+				fd, MESSAGE_BUFFER_SIZE - 1);
+		*buf_size = 0;
+	} else if (consumed) {
 		*buf_size -= consumed;
-		memcpy(*inactive, &(*active)[consumed], *buf_size);
-		if ((*inactive)[0] == '\n' || (*inactive)[0] == '\r')
-			printf("Error switching between inactive & active\n");
-		char *swap = *active;
-		*active = *inactive;
-		*inactive = swap;
+		memmove(rx_buffer, &rx_buffer[consumed], *buf_size);
 	}
 
 
@@ -1315,22 +1664,24 @@ rec_stream(int fd, char **active, char **inactive, size_t *buf_size,
 static void
 rec_response_stream(void)
 {
-	static char rx_buffer[2][MESSAGE_BUFFER_SIZE];
-	static char *active = rx_buffer[0];
-	static char *inactive = rx_buffer[1];
+	static char rx_buffer[MESSAGE_BUFFER_SIZE];
 	static size_t buf_pos;
 	size_t rx_bytes;
 
 	static const struct sse_handle_message_event_map response_map[] = {
 		{SSE_EVENT SSE_CONFIGURE_EVENT LF,
-				sse_handle_message_configure},
+				sse_handle_message_configure,
+#ifdef NB_JSON_SCAN
+				sse_scan_message_configure,
+#endif
+		},
 		{SSE_EVENT SSE_BIND_CLIENT_EVENT LF,
 				sse_handle_message_bind_client},
 		{NULL, NULL}
 	};
 
-	rx_bytes = rec_stream(response_fd, &active, &inactive,
-			&buf_pos, response_map);
+	rx_bytes = rec_stream(response_fd, rx_buffer, &buf_pos,
+			response_map);
 
 	if (rx_bytes == 0) {
 		fprintf(stderr, "%d\tResponse stream closed.\n", response_fd);
@@ -1349,21 +1700,23 @@ rec_response_stream(void)
 static void
 rec_notification_stream(void)
 {
-	static char rx_buffer[2][MESSAGE_BUFFER_SIZE];
-	static char *active = rx_buffer[0];
-	static char *inactive = rx_buffer[1];
+	static char rx_buffer[MESSAGE_BUFFER_SIZE];
 	static size_t buf_pos;
 	size_t rx_bytes;
 
 
 	static const struct sse_handle_message_event_map notification_map[] = {
 		{SSE_EVENT SSE_NOTIFICATION_EVENT LF,
-				sse_handle_message_notification},
+				sse_handle_message_notification,
+#ifdef NB_JSON_SCAN
+				sse_scan_message_notification,
+#endif
+		},
 		{NULL, NULL}
 	};
 
-	rx_bytes = rec_stream(notification_fd, &active, &inactive,
-			&buf_pos, notification_map);
+	rx_bytes = rec_stream(notification_fd, rx_buffer, &buf_pos,
+			notification_map);
 
 	if (rx_bytes == 0) {
 		fprintf(stderr, "%d\tNotification stream closed.\n",
@@ -1384,6 +1737,10 @@ server(void)
 	int ret;
 	fd_set fd_set_read;
 	fd_set fd_set_zero;
+#ifdef GTPC_TIMERS
+	struct timeval tv, *timeout;
+	int ms;
+#endif
 
 	puts("Starting server");
 
@@ -1396,8 +1753,25 @@ server(void)
 		FD_SET(s11_pcap_fd, &fd_set_active);
 
 	while (memcmp(&fd_set_zero, &fd_set_active, sizeof(fd_set))) {
+#ifdef NB_PIPELINE
+		nb_flush();
+#endif
 		fd_set_read = fd_set_active;
+#ifdef GTPC_TIMERS
+		/* DDNs of the notification stream are retransmitted even
+		 * when no s11 message comes in */
+		ms = gtpc_timer_timeout_ms();
+		timeout = NULL;
+		if (ms >= 0) {
+			tv.tv_sec = ms / 1000;
+			tv.tv_usec = (ms % 1000) * 1000;
+			timeout = &tv;
+		}
+		ret = select(FD_SETSIZE, &fd_set_read, NULL, NULL, timeout);
+		gtpc_timer_poll();
+#else
 		ret = select(FD_SETSIZE, &fd_set_read, NULL, NULL, NULL);
+#endif
 		if (ret < 0) {
 			/* If all fd's have been closed, exit server */
 			if (!memcmp(&fd_set_zero, &fd_set_active,
@@ -1519,6 +1893,8 @@ init_nb(void)
 {
 	init_nb_op_id();
 
+	curl_global_init(CURL_GLOBAL_ALL);
+
 	init_server();
 
 	connect_stream(&response_fd);
@@ -1540,6 +1916,33 @@ init_nb(void)
 }
 
 
+/**
+ * Sends a configure request to the NB controller, the time it takes is
+ * accounted as NB send of the GTPv2c message being processed with
+ * CP_MSG_STATS. With NB_PIPELINE the request is only queued, see nb_flush().
+ */
+static int
+send_nb_configure(const char *json_buf, const char *calling_func)
+{
+	int ret;
+#ifdef CP_MSG_STATS
+	uint64_t start = rte_rdtsc();
+#endif
+
+#ifdef NB_PIPELINE
+	RTE_SET_USED(calling_func);
+	ret = queue_sse(SSE_CONFIGURE_EVENT, json_buf);
+#else
+	ret = send_sse(request_fd, SSE_CONFIGURE_EVENT, json_buf,
+			calling_func);
+#endif
+
+#ifdef CP_MSG_STATS
+	cp_msg_send_time(CP_TM_NB_SEND, rte_rdtsc() - start);
+#endif
+	return ret;
+}
+
 int
 send_nb_create_modify(const char *op_type, const char *instruction,
 		uint64_t sess_id, uint32_t assigned_ip,
@@ -1586,7 +1989,7 @@ send_nb_create_modify(const char *op_type, const char *instruction,
 
 	add_nb_op_id_hash();
 
-	return send_sse(request_fd, SSE_CONFIGURE_EVENT, json_buf, __func__);
+	return send_nb_configure(json_buf, __func__);
 }
 
 
@@ -1609,7 +2012,7 @@ send_nb_delete(uint64_t sess_id)
 
 	add_nb_op_id_hash();
 
-	return send_sse(request_fd, SSE_CONFIGURE_EVENT, json_buf, __func__);
+	return send_nb_configure(json_buf, __func__);
 }
 
 
@@ -1631,6 +2034,13 @@ close_nb(void)
 
 	close_sse(request_fd);
 
+	if (curl_topology != NULL) {
+		curl_easy_cleanup(curl_topology);
+		curl_slist_free_all(topology_list);
+		curl_topology = NULL;
+		topology_list = NULL;
+	}
+
 	sleep(2);
 
 	for (i = 0; i < FD_SETSIZE; ++i) {
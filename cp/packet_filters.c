@@ -22,6 +22,10 @@
 #include <rte_lcore.h>
 #include <rte_acl.h>
 #include <rte_cfgfile.h>
+#include <rte_errno.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_spinlock.h>
 
 #include "packet_filters.h"
 #include "vepc_cp_dp_api.h"
@@ -30,6 +34,9 @@
 #ifdef SDN_ODL_BUILD
 #include "nb.h"
 #endif
+#ifdef RULE_CACHE
+#include "rule_cache.h"
+#endif
 
 const char *direction_str[] = {
 		[TFT_DIRECTION_DOWNLINK_ONLY] = "DOWNLINK_ONLY ",
@@ -57,15 +64,25 @@ struct pcc_rules *pcc_filters[PCC_TABLE_SIZE] = {
 		[0] = NULL, /* index = 0 is invalid */
 };
 
-pkt_fltr *sdf_filters[SDF_FILTER_TABLE_SIZE] = {
-		[0] = NULL, /* index = 0 is invalid */
-};
-packet_filter *packet_filters[SDF_FILTER_TABLE_SIZE] = {
+packet_filter *sdf_filters[SDF_FILTER_TABLE_SIZE] = {
 		[0] = NULL, /* index = 0 is invalid */
 };
 
+/* Installed SDF filters by normalized content, see sdf_filter_key() */
+static struct rte_hash *sdf_filter_hash;
+/* References to each SDF filter. The filters of SDF_RULE_FILE hold one
+ * that is never released, as the PCC rules refer to them by index. */
+static uint32_t sdf_filter_refcnt[SDF_FILTER_TABLE_SIZE];
+/* Indices of the released SDF filters, reused first */
+static uint16_t sdf_filter_free[SDF_FILTER_TABLE_SIZE];
+static uint16_t num_sdf_filter_free;
+/* Serializes the CP workers installing and releasing filters */
+static rte_spinlock_t sdf_filter_lock = RTE_SPINLOCK_INITIALIZER;
+/* SDF filters of SDF_RULE_FILE, pushed to DP in bulk by init_sdf_rules() */
+static struct pkt_filter *sdf_batch;
+static uint32_t nb_sdf_batch;
+
 uint16_t num_mtr_profiles;
-uint16_t num_packet_filters = FIRST_FILTER_ID;
 uint16_t num_sdf_filters = FIRST_FILTER_ID;
 uint16_t num_pcc_filter = FIRST_FILTER_ID;
 uint32_t num_adc_rules;
@@ -75,30 +92,99 @@ uint64_t ebs;
 uint16_t ulambr_idx;
 uint16_t dlambr_idx;
 
+/**
+ * Builds the hash key of a filter: the fields of pf with the padding
+ * cleared, the addresses masked by their prefix length and the protocol
+ * cleared when not matched, so filters matching the same packets share
+ * a key. The meters are part of the key, filters metered apart are not
+ * shared.
+ */
+static void
+sdf_filter_key(const packet_filter *filter, packet_filter *hkey)
+{
+	const pkt_fltr *pf = &filter->pkt_fltr;
+	pkt_fltr *key = &hkey->pkt_fltr;
+
+	memset(hkey, 0, sizeof(*hkey));
+	hkey->ul_mtr_idx = filter->ul_mtr_idx;
+	hkey->dl_mtr_idx = filter->dl_mtr_idx;
+	key->direction = pf->direction;
+	key->proto_mask = pf->proto_mask;
+	key->proto = pf->proto & pf->proto_mask;
+	key->remote_ip_mask = pf->remote_ip_mask;
+	if (pf->remote_ip_mask)
+		key->remote_ip_addr.s_addr = pf->remote_ip_addr.s_addr &
+			htonl(UINT32_MAX << (32 - pf->remote_ip_mask));
+	key->remote_port_low = pf->remote_port_low;
+	key->remote_port_high = pf->remote_port_high;
+	key->local_ip_mask = pf->local_ip_mask;
+	if (pf->local_ip_mask)
+		key->local_ip_addr.s_addr = pf->local_ip_addr.s_addr &
+			htonl(UINT32_MAX << (32 - pf->local_ip_mask));
+	key->local_port_low = pf->local_port_low;
+	key->local_port_high = pf->local_port_high;
+}
+
+static void
+sdf_filter_hash_create(void)
+{
+	struct rte_hash_parameters rte_hash_params = {
+		.name = "sdf_filter_hash",
+		.entries = SDF_FILTER_TABLE_SIZE,
+		.key_len = sizeof(packet_filter),
+		.hash_func = rte_hash_crc,
+		.hash_func_init_val = 0,
+		.socket_id = rte_socket_id(),
+	};
+
+	sdf_filter_hash = rte_hash_create(&rte_hash_params);
+	if (!sdf_filter_hash)
+		rte_panic("%s hash create failed: %s (%u)\n.",
+				rte_hash_params.name,
+				rte_strerror(rte_errno), rte_errno);
+}
+
+/**
+ * Looks up the installed filter matching the same packets as pf. Called
+ * with sdf_filter_lock held.
+ */
+static int
+sdf_filter_lookup(const packet_filter *pf)
+{
+	packet_filter key;
+	void *data;
+
+	if (sdf_filter_hash == NULL)
+		return -ENOENT;
+	sdf_filter_key(pf, &key);
+	if (rte_hash_lookup_data(sdf_filter_hash, &key, &data) < 0)
+		return -ENOENT;
+	return (uintptr_t)data;
+}
+
 int
-get_packet_filter_id(const pkt_fltr *pf)
+get_packet_filter_id(const packet_filter *pf)
 {
-	uint16_t index;
-	for (index = FIRST_FILTER_ID; index < num_packet_filters; ++index) {
-		if (!memcmp(pf, &packet_filters[index]->pkt_fltr,
-				sizeof(pkt_fltr)))
-			return index;
-	}
-	return -ENOENT;
+	int index;
+
+	rte_spinlock_lock(&sdf_filter_lock);
+	index = sdf_filter_lookup(pf);
+	rte_spinlock_unlock(&sdf_filter_lock);
+	return index;
 }
 
 uint8_t
 get_packet_filter_direction(uint16_t index)
 {
-	return packet_filters[index]->pkt_fltr.direction;
+	return sdf_filters[index]->pkt_fltr.direction;
 }
 
 packet_filter *
 get_packet_filter(uint16_t index)
 {
-	if (unlikely(index >= num_packet_filters))
+	if (unlikely(index >= num_sdf_filters))
 		return NULL;
-	return packet_filters[index];
+	return sdf_filters[index];
 }
 
 void
@@ -124,71 +210,114 @@ void
 push_sdf_rules(uint16_t index)
 {
 	struct dp_id dp_id = { .id = DPN_ID };
+	const pkt_fltr *f = &sdf_filters[index]->pkt_fltr;
 
 	char local_ip[INET_ADDRSTRLEN];
 	char remote_ip[INET_ADDRSTRLEN];
 
 	snprintf(local_ip, sizeof(local_ip), "%s",
-	    inet_ntoa(sdf_filters[index]->local_ip_addr));
+	    inet_ntoa(f->local_ip_addr));
 	snprintf(remote_ip, sizeof(remote_ip), "%s",
-	    inet_ntoa(sdf_filters[index]->remote_ip_addr));
+	    inet_ntoa(f->remote_ip_addr));
 
 	struct pkt_filter pktf = {
 			.pcc_rule_id = index
 	};
 
-	if (sdf_filters[index]->direction & TFT_DIRECTION_DOWNLINK_ONLY) {
+	if (f->direction & TFT_DIRECTION_DOWNLINK_ONLY) {
 		snprintf(pktf.u.rule_str, MAX_LEN, "%s/%"PRIu8" %s/%"PRIu8
 			" %"PRIu16" : %"PRIu16" %"PRIu16" : %"PRIu16
 			" 0x%"PRIx8"/0x%"PRIx8"\n",
-			remote_ip, sdf_filters[index]->remote_ip_mask, local_ip,
-			sdf_filters[index]->local_ip_mask,
-			ntohs(sdf_filters[index]->remote_port_low),
-			ntohs(sdf_filters[index]->remote_port_high),
-			ntohs(sdf_filters[index]->local_port_low),
-			ntohs(sdf_filters[index]->local_port_high),
-			sdf_filters[index]->proto, sdf_filters[index]->proto_mask);
-		if (sdf_filters[index]->direction ==
+			remote_ip, f->remote_ip_mask, local_ip,
+			f->local_ip_mask,
+			ntohs(f->remote_port_low),
+			ntohs(f->remote_port_high),
+			ntohs(f->local_port_low),
+			ntohs(f->local_port_high),
+			f->proto, f->proto_mask);
+		if (f->direction ==
 				TFT_DIRECTION_BIDIRECTIONAL)
 			fprintf(stderr, "Ignoring uplink portion of packet "
 					"filter for now\n");
-	} else if (sdf_filters[index]->direction & TFT_DIRECTION_UPLINK_ONLY) {
+	} else if (f->direction & TFT_DIRECTION_UPLINK_ONLY) {
 		snprintf(pktf.u.rule_str, MAX_LEN, "%s/%"PRIu8" %s/%"PRIu8" %"
 			PRIu16" : %"PRIu16" %"PRIu16" : %"PRIu16" 0x%"
 			PRIx8"/0x%"PRIx8"\n",
-			local_ip, sdf_filters[index]->local_ip_mask, remote_ip,
-			sdf_filters[index]->remote_ip_mask,
-			ntohs(sdf_filters[index]->local_port_low),
-			ntohs(sdf_filters[index]->local_port_high),
-			ntohs(sdf_filters[index]->remote_port_low),
-			ntohs(sdf_filters[index]->remote_port_high),
-			sdf_filters[index]->proto, sdf_filters[index]->proto_mask);
+			local_ip, f->local_ip_mask, remote_ip,
+			f->remote_ip_mask,
+			ntohs(f->local_port_low),
+			ntohs(f->local_port_high),
+			ntohs(f->remote_port_low),
+			ntohs(f->remote_port_high),
+			f->proto, f->proto_mask);
 	}
 
 	printf("Installing %s pkt_filter #%"PRIu16" : %s",
-	    direction_str[sdf_filters[index]->direction], index,
+	    direction_str[f->direction], index,
 		pktf.u.rule_str);
 
+	if (sdf_batch != NULL) {
+		sdf_batch[nb_sdf_batch++] = pktf;
+		return;
+	}
 	if (sdf_filter_entry_add(dp_id, pktf) < 0)
 		rte_exit(EXIT_FAILURE,"SDF filter entry add fail !!!");
 }
 
 /**
-*Installs a sdf rules in the CP & DP.
-*@param new_packet_filter
-*  A sdf rules yet to be installed
-*@return
-*  \- >= 0 - on success - indicates index of sdf rules
-*  \- < 0 - on error
-*/
+ * Removes an SDF filter with no references left from the CP and DP.
+ * Called with sdf_filter_lock held.
+ */
+static void
+delete_sdf_filter(uint16_t index)
+{
+	struct dp_id dp_id = { .id = DPN_ID };
+	struct pkt_filter pktf = {
+			.pcc_rule_id = index
+	};
+	packet_filter key;
+
+	sdf_filter_key(sdf_filters[index], &key);
+	if (sdf_filter_lookup(sdf_filters[index]) == index)
+		rte_hash_del_key(sdf_filter_hash, &key);
+
+#ifdef SDN_ODL_BUILD
+	if (dpn_id)
+		sdf_filter_entry_delete(dp_id, pktf);
+#else
+	if (sdf_filter_entry_delete(dp_id, pktf) < 0)
+		fprintf(stderr, "SDF filter entry delete fail !!!\n");
+#endif
+	printf("Removed pkt_filter #%"PRIu16"\n", index);
+
+	rte_free(sdf_filters[index]);
+	sdf_filters[index] = NULL;
+	sdf_filter_free[num_sdf_filter_free++] = index;
+}
+
+/**
+ * Adds a filter to the CP and pushes it to the DP, with one reference.
+ * Called with sdf_filter_lock held.
+ * @param new_packet_filter
+ *   filter to add
+ * @param from_file
+ *   filter of SDF_RULE_FILE, added at the next index and never released
+ * @return
+ *   \- >= 0 - on success - indicates index of the filter
+ *   \- < 0 - on error
+ */
 static int
-install_sdf_rules(const pkt_fltr *new_packet_filter)
+add_sdf_filter(const packet_filter *new_packet_filter, int from_file)
 {
-	if (num_sdf_filters >= SDF_FILTER_TABLE_SIZE)
+	uint16_t index;
+	packet_filter key;
+
+	if ((from_file || num_sdf_filter_free == 0)
+			&& num_sdf_filters >= SDF_FILTER_TABLE_SIZE)
 		return -ENOMEM;
 
-	pkt_fltr *filter = rte_zmalloc_socket(NULL, sizeof(pkt_fltr),
-	    RTE_CACHE_LINE_SIZE, rte_socket_id());
+	packet_filter *filter = rte_zmalloc_socket(NULL,
+	    sizeof(packet_filter), RTE_CACHE_LINE_SIZE, rte_socket_id());
 	if (filter == NULL) {
 		fprintf(stderr, "Failure to allocate dedicated packet filter "
 				"structure: %s (%s:%d)\n",
@@ -197,12 +326,23 @@ install_sdf_rules(const pkt_fltr *new_packet_filter)
 				__LINE__);
 		return -ENOMEM;
 	}
+	memcpy(filter, new_packet_filter, sizeof(packet_filter));
 
-	memcpy(filter, new_packet_filter, sizeof(pkt_fltr));
-	uint16_t index = num_sdf_filters;
-
-	num_sdf_filters++;
+	if (from_file || num_sdf_filter_free == 0)
+		index = num_sdf_filters++;
+	else
+		index = sdf_filter_free[--num_sdf_filter_free];
 	sdf_filters[index] = filter;
+	sdf_filter_refcnt[index] = 1;
+
+	/* a duplicate line of SDF_RULE_FILE keeps the first index */
+	if (sdf_filter_lookup(filter) < 0) {
+		sdf_filter_key(filter, &key);
+		if (rte_hash_add_key_data(sdf_filter_hash, &key,
+				(void *)(uintptr_t)index) < 0)
+			fprintf(stderr, "Failure to index pkt_filter #%"PRIu16
+					", it will not be shared\n", index);
+	}
 
 #ifdef SDN_ODL_BUILD
 	if (dpn_id)
@@ -213,6 +353,54 @@ install_sdf_rules(const pkt_fltr *new_packet_filter)
 	return index;
 }
 
+/**
+*Installs a sdf rules in the CP & DP.
+*@param new_packet_filter
+*  A sdf rules yet to be installed
+*@return
+*  \- >= 0 - on success - indicates index of sdf rules
+*  \- < 0 - on error
+*/
+static int
+install_sdf_rules(const pkt_fltr *new_packet_filter)
+{
+	packet_filter pf = { .pkt_fltr = *new_packet_filter };
+	int ret;
+
+	rte_spinlock_lock(&sdf_filter_lock);
+	ret = add_sdf_filter(&pf, 1);
+	rte_spinlock_unlock(&sdf_filter_lock);
+	return ret;
+}
+
+int
+install_packet_filter(const packet_filter *new_packet_filter)
+{
+	int index;
+
+	rte_spinlock_lock(&sdf_filter_lock);
+	index = sdf_filter_lookup(new_packet_filter);
+	if (index >= 0)
+		sdf_filter_refcnt[index]++;
+	else
+		index = add_sdf_filter(new_packet_filter, 0);
+	rte_spinlock_unlock(&sdf_filter_lock);
+	return index;
+}
+
+void
+release_packet_filter(int index)
+{
+	if (index < FIRST_FILTER_ID || index >= SDF_FILTER_TABLE_SIZE)
+		return;
+
+	rte_spinlock_lock(&sdf_filter_lock);
+	if (sdf_filters[index] != NULL && sdf_filter_refcnt[index]
+			&& --sdf_filter_refcnt[index] == 0)
+		delete_sdf_filter(index);
+	rte_spinlock_unlock(&sdf_filter_lock);
+}
+
 /**
 *Installs a pcc rules in the CP & DP.
 *@param new_pcc_entry
@@ -295,11 +483,22 @@ init_mtr_profile(void)
 {
 	unsigned no_of_idx = 0;
 	unsigned i = 0;
-	struct rte_cfgfile *file =
-			rte_cfgfile_load(METER_PROFILE_FILE, 0);
+	struct rte_cfgfile *file;
 	const char *entry;
 	struct dp_id dp_id = { .id = DPN_ID };
+#ifdef RULE_CACHE
+	const struct mtr_entry *cached;
+	uint32_t nb_cached;
+
+	cached = rule_cache_get(RULE_CACHE_MTR, sizeof(*cached), &nb_cached);
+	if (cached != NULL) {
+		for (i = 0; i < nb_cached; i++)
+			install_meter_profiles(dp_id, cached[i]);
+		return;
+	}
+#endif
 
+	file = rte_cfgfile_load(METER_PROFILE_FILE, 0);
 	if (file == NULL)
 		rte_panic("Cannot load configuration file %s\n",
 				METER_PROFILE_FILE);
@@ -334,25 +533,53 @@ init_mtr_profile(void)
 			rte_panic("Invalid EBS configuration\n");
 		mtr_entry.mtr_param.ebs = atoi(entry);
 
+		/* PIR and PBS are optional, used by trTCM meters only */
+		entry = rte_cfgfile_get_entry(file, sectionname,
+				"PIR");
+		mtr_entry.mtr_param.pir = (entry) ? atoi(entry) : 0;
+
+		entry = rte_cfgfile_get_entry(file, sectionname,
+				"PBS");
+		mtr_entry.mtr_param.pbs = (entry) ? atoi(entry) : 0;
+
 		entry = rte_cfgfile_get_entry(file, sectionname,
 				"MTR_PROFILE_IDX");
 		if (!entry)
 			rte_panic("Invalid MTR_PROFILE_IDX configuration\n");
 		mtr_entry.mtr_profile_index = atoi(entry);
 
+#ifdef RULE_CACHE
+		rule_cache_put(RULE_CACHE_MTR, &mtr_entry);
+#endif
 		install_meter_profiles(dp_id, mtr_entry);
 
 	}
 }
 
 static void
-init_sdf_rules(void)
+load_sdf_rules(void)
 {
 	unsigned num_sdf_rules = 0;
 	unsigned i = 0;
 	const char *entry = NULL;
-	struct rte_cfgfile *file = rte_cfgfile_load(SDF_RULE_FILE, 0);
+	struct rte_cfgfile *file;
+#ifdef RULE_CACHE
+	const pkt_fltr *cached;
+	uint32_t nb_cached;
+
+	cached = rule_cache_get(RULE_CACHE_SDF, sizeof(*cached), &nb_cached);
+	if (cached != NULL) {
+		for (i = 0; i < nb_cached; i++)
+			if (install_sdf_rules(&cached[i]) < 0)
+				rte_panic("Failure to install sdf rules: "
+						"%s (%s:%d)\n",
+						rte_strerror(rte_errno),
+						__FILE__, __LINE__);
+		return;
+	}
+#endif
 
+	file = rte_cfgfile_load(SDF_RULE_FILE, 0);
 	if (NULL == file)
 		rte_panic("Cannot load configuration file %s\n",
 				SDF_RULE_FILE);
@@ -456,6 +683,9 @@ init_sdf_rules(void)
 		if (entry)
 			pf.local_port_high = htons((uint16_t) atoi(entry));
 
+#ifdef RULE_CACHE
+		rule_cache_put(RULE_CACHE_SDF, &pf);
+#endif
 		ret = install_sdf_rules(&pf);
 		if (ret < 0) {
 			rte_panic("Failure to install sdf rules: "
@@ -465,14 +695,57 @@ init_sdf_rules(void)
 	}
 }
 
+/**
+ * Installs the SDF filters of SDF_RULE_FILE, pushed to DP with one bulk
+ * so that DP builds them once.
+ */
+static void
+init_sdf_rules(void)
+{
+	struct dp_id dp_id = { .id = DPN_ID };
+
+	/* without the batch the filters are pushed one by one */
+	sdf_batch = rte_zmalloc_socket(NULL,
+			SDF_FILTER_TABLE_SIZE * sizeof(struct pkt_filter),
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	nb_sdf_batch = 0;
+
+	load_sdf_rules();
+
+	if (sdf_batch == NULL)
+		return;
+	if (sdf_filter_entry_add_bulk(dp_id, sdf_batch, nb_sdf_batch,
+			NULL) < 0)
+		rte_exit(EXIT_FAILURE, "SDF filter entry add fail !!!");
+	rte_free(sdf_batch);
+	sdf_batch = NULL;
+}
+
 static void
 init_pcc_rules(void)
 {
 	unsigned num_pcc_rules = 0;
 	unsigned i = 0;
 	const char *entry = NULL;
-	struct rte_cfgfile *file = rte_cfgfile_load(PCC_RULE_FILE, 0);
+	struct rte_cfgfile *file;
+#ifdef RULE_CACHE
+	const struct pcc_rules *cached;
+	uint32_t nb_cached;
+
+	cached = rule_cache_get(RULE_CACHE_PCC, sizeof(*cached), &nb_cached);
+	if (cached != NULL) {
+		rule_cache_ambr_get(&ulambr_idx, &dlambr_idx);
+		for (i = 0; i < nb_cached; i++)
+			if (install_pcc_rules(cached[i]) < 0)
+				rte_panic("Failure to install packet filters: "
+						"%s (%s:%d)\n",
+						rte_strerror(rte_errno),
+						__FILE__, __LINE__);
+		return;
+	}
+#endif
 
+	file = rte_cfgfile_load(PCC_RULE_FILE, 0);
 	if (NULL == file)
 		rte_panic("Cannot load configuration file %s\n",
 				PCC_RULE_FILE);
@@ -494,6 +767,9 @@ init_pcc_rules(void)
 	if (!entry)
 		rte_panic("Invalid AMBR configuration file format\n");
 	dlambr_idx = atoi(entry);
+#ifdef RULE_CACHE
+	rule_cache_ambr_set(ulambr_idx, dlambr_idx);
+#endif
 
 	for (i = 0; i <= num_pcc_rules; ++i) {
 		char sectionname[64] = {0};
@@ -615,6 +891,9 @@ init_pcc_rules(void)
 			tmp_pcc.adc_idx = atoi(entry);
 		}
 
+#ifdef RULE_CACHE
+		rule_cache_put(RULE_CACHE_PCC, &tmp_pcc);
+#endif
 		ret = install_pcc_rules(tmp_pcc);
 		if (ret < 0) {
 			rte_panic("Failure to install packet filters: "
@@ -642,7 +921,12 @@ init_packet_filters(void)
 	sleep(1);
 
 	/* init dpn sdf rules table configuring on dp*/
+	sdf_filter_hash_create();
 	init_sdf_rules();
+
+#ifdef RULE_CACHE
+	rule_cache_write();
+#endif
 }
 
 static void print_adc_rule(struct adc_rules adc_rule)
@@ -674,8 +958,26 @@ parse_adc_rules(void)
 	uint32_t rule_id = 1;
 	const char *entry = NULL;
 	struct dp_id dp_id = { .id = DPN_ID };
-	struct rte_cfgfile *file = rte_cfgfile_load(ADC_RULE_FILE, 0);
+	struct adc_rules adc_batch[MAX_ADC_RULES];
+	struct rte_cfgfile *file;
+#ifdef RULE_CACHE
+	const struct adc_rules *cached;
+	uint32_t nb_cached;
+
+	cached = rule_cache_get(RULE_CACHE_ADC, sizeof(*cached), &nb_cached);
+	if (cached != NULL) {
+		for (i = 0; i < nb_cached; i++) {
+			adc_rule_id[i] = cached[i].rule_id;
+			print_adc_rule(cached[i]);
+		}
+		if (adc_entry_add_bulk(dp_id, (struct adc_rules *)cached,
+				nb_cached, NULL) < 0)
+			rte_exit(EXIT_FAILURE, "ADC entry add fail !!!");
+		return;
+	}
+#endif
 
+	file = rte_cfgfile_load(ADC_RULE_FILE, 0);
 	if (file == NULL)
 		rte_panic("Cannot load configuration file %s\n",
 				ADC_RULE_FILE);
@@ -686,6 +988,9 @@ parse_adc_rules(void)
 		rte_panic("Invalid adc configuration file format\n");
 
 	num_adc_rules = atoi(entry);
+	if (num_adc_rules > MAX_ADC_RULES)
+		rte_panic("%u ADC rules, more than %u\n", num_adc_rules,
+				MAX_ADC_RULES);
 
 	for (i = 0; i < num_adc_rules; ++i) {
 		char sectionname[64] = {0};
@@ -750,12 +1055,17 @@ parse_adc_rules(void)
 		/* Add Default rule */
 		adc_rule_id[rule_id - 1] = rule_id;
 		tmp_adc.rule_id = rule_id++;
-		if (adc_entry_add(dp_id, tmp_adc) < 0)
-			rte_exit(EXIT_FAILURE, "ADC entry add fail !!!");
+#ifdef RULE_CACHE
+		rule_cache_put(RULE_CACHE_ADC, &tmp_adc);
+#endif
+		adc_batch[i] = tmp_adc;
 		print_adc_rule(tmp_adc);
 
 	}
 	num_adc_rules = rule_id - 1;
 
+	/* pushed in bulk so that DP builds the rules once */
+	if (adc_entry_add_bulk(dp_id, adc_batch, num_adc_rules, NULL) < 0)
+		rte_exit(EXIT_FAILURE, "ADC entry add fail !!!");
 }
 
@@ -69,7 +69,8 @@ void
 push_sdf_rules(uint16_t index);
 
 /**
- * Installs a packet filter in the CP & DP.
+ * Installs a packet filter in the CP & DP, or takes a reference to the
+ * installed filter matching the same packets.
  * @param new_packet_filter
  *   A packet filter yet to be installed
  * @return
@@ -80,14 +81,23 @@ int
 install_packet_filter(const packet_filter *new_packet_filter);
 
 /**
- * Returns the packet filter index.
+ * Drops a reference taken by install_packet_filter(). The filter is
+ * removed from the CP & DP with the last reference.
+ * @param index
+ *   Packet filter index, ignored if not a valid index
+ */
+void
+release_packet_filter(int index);
+
+/**
+ * Returns the packet filter index, without taking a reference.
  * @param pf
- *   Packet filter
+ *   Packet filter and its meters
  * @return
- *   Packet filter index matching packet filter 'pf'
+ *   Packet filter index matching packet filter 'pf', -ENOENT if none
  */
 int
-get_packet_filter_id(const pkt_fltr *pf);
+get_packet_filter_id(const packet_filter *pf);
 
 /**
  * Clears the packet filter at '*pf' to accept all packets.
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef RULE_CACHE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <rte_common.h>
+#include <rte_hash_crc.h>
+
+#include "packet_filters.h"
+#include "rule_cache.h"
+
+#define RULE_CACHE_TMP RULE_CACHE_FILE ".tmp"
+#define RULE_CACHE_CHUNK (1 << 16)
+
+static const char *const rule_file[RULE_CACHE_NUM_TYPES] = {
+	[RULE_CACHE_MTR] = METER_PROFILE_FILE,
+	[RULE_CACHE_PCC] = PCC_RULE_FILE,
+	[RULE_CACHE_SDF] = SDF_RULE_FILE,
+	[RULE_CACHE_ADC] = ADC_RULE_FILE,
+};
+
+/**
+ * @brief records of a rule file, from the cache file or parsed
+ */
+struct rule_cache_sect {
+	uint8_t *rec;
+	uint32_t nb_rec;
+	uint32_t max_rec;
+	int parsed;
+	struct rule_cache_src src;
+};
+
+static struct rule_cache_sect sect[RULE_CACHE_NUM_TYPES];
+static uint16_t ambr_idx[2];
+
+/** contents of the cache file, NULL if not valid */
+static uint8_t *cache_buf;
+static int cache_read;
+
+/**
+ * Reads the whole cache file. Sections of records are checked against
+ * the rule files by rule_cache_get().
+ */
+static void
+rule_cache_load(void)
+{
+	const struct rule_cache_hdr *h;
+	uint64_t size = sizeof(*h);
+	long len;
+	FILE *f;
+	int i;
+
+	cache_read = 1;
+	f = fopen(RULE_CACHE_FILE, "rb");
+	if (f == NULL)
+		return;
+	if (fseek(f, 0, SEEK_END) || ((len = ftell(f)) < (long)sizeof(*h))
+			|| fseek(f, 0, SEEK_SET))
+		goto fail;
+	cache_buf = malloc(len);
+	if ((cache_buf == NULL) || (fread(cache_buf, len, 1, f) != 1))
+		goto fail;
+	fclose(f);
+
+	h = (const struct rule_cache_hdr *)cache_buf;
+	for (i = 0; i < RULE_CACHE_NUM_TYPES; i++)
+		size += (uint64_t)h->src[i].nb_rec * h->src[i].rec_size;
+	if (memcmp(h->magic, RULE_CACHE_MAGIC, sizeof(RULE_CACHE_MAGIC))
+			|| (h->version != RULE_CACHE_VERSION)
+			|| (size != (uint64_t)len)) {
+		fprintf(stderr, "Ignoring invalid rule cache %s\n",
+				RULE_CACHE_FILE);
+		free(cache_buf);
+		cache_buf = NULL;
+	}
+	return;
+
+fail:
+	fclose(f);
+	free(cache_buf);
+	cache_buf = NULL;
+}
+
+/**
+ * Gets the size and CRC of a rule file.
+ */
+static int
+rule_file_stamp(const char *path, struct rule_cache_src *src)
+{
+	uint8_t buf[RULE_CACHE_CHUNK];
+	uint32_t crc = 0;
+	uint64_t size = 0;
+	size_t n;
+	FILE *f = fopen(path, "rb");
+
+	if (f == NULL)
+		return -1;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		crc = rte_hash_crc(buf, n, crc);
+		size += n;
+	}
+	fclose(f);
+	src->size = size;
+	src->crc = crc;
+	return 0;
+}
+
+const void *
+rule_cache_get(enum rule_cache_type type, uint32_t rec_size,
+		uint32_t *nb_rec)
+{
+	struct rule_cache_sect *s = &sect[type];
+	const struct rule_cache_hdr *h;
+	uint8_t *rec;
+	int i;
+
+	s->src.rec_size = rec_size;
+	s->parsed = 1;
+	if (rule_file_stamp(rule_file[type], &s->src) < 0)
+		return NULL;
+	if (!cache_read)
+		rule_cache_load();
+	if (cache_buf == NULL)
+		return NULL;
+
+	h = (const struct rule_cache_hdr *)cache_buf;
+	if ((h->src[type].size != s->src.size)
+			|| (h->src[type].crc != s->src.crc)
+			|| (h->src[type].rec_size != rec_size))
+		return NULL;
+
+	rec = cache_buf + sizeof(*h);
+	for (i = 0; i < (int)type; i++)
+		rec += (size_t)h->src[i].nb_rec * h->src[i].rec_size;
+	s->rec = rec;
+	s->nb_rec = s->src.nb_rec = h->src[type].nb_rec;
+	s->parsed = 0;
+	if (type == RULE_CACHE_PCC)
+		rule_cache_ambr_set(h->ulambr_idx, h->dlambr_idx);
+
+	printf("Loaded %u records of %s from %s\n", s->nb_rec,
+			rule_file[type], RULE_CACHE_FILE);
+	*nb_rec = s->nb_rec;
+	return rec;
+}
+
+void
+rule_cache_put(enum rule_cache_type type, const void *rec)
+{
+	struct rule_cache_sect *s = &sect[type];
+	uint32_t max;
+	uint8_t *p;
+
+	if (!s->parsed || (s->src.rec_size == 0))
+		return;
+	if (s->nb_rec == s->max_rec) {
+		max = s->max_rec ? s->max_rec * 2 : 64;
+		p = realloc(s->rec, (size_t)max * s->src.rec_size);
+		if (p == NULL) {
+			/* the file is not cached */
+			s->src.rec_size = 0;
+			return;
+		}
+		s->rec = p;
+		s->max_rec = max;
+	}
+	memcpy(s->rec + (size_t)s->nb_rec++ * s->src.rec_size, rec,
+			s->src.rec_size);
+}
+
+void
+rule_cache_ambr_set(uint16_t ul, uint16_t dl)
+{
+	ambr_idx[0] = ul;
+	ambr_idx[1] = dl;
+}
+
+void
+rule_cache_ambr_get(uint16_t *ul, uint16_t *dl)
+{
+	*ul = ambr_idx[0];
+	*dl = ambr_idx[1];
+}
+
+void
+rule_cache_write(void)
+{
+	struct rule_cache_hdr h = {0};
+	int parsed = 0, err;
+	FILE *f;
+	int i;
+
+	for (i = 0; i < RULE_CACHE_NUM_TYPES; i++)
+		parsed |= sect[i].parsed;
+	if (!parsed)
+		goto out;
+
+	memcpy(h.magic, RULE_CACHE_MAGIC, sizeof(RULE_CACHE_MAGIC));
+	h.version = RULE_CACHE_VERSION;
+	rule_cache_ambr_get(&h.ulambr_idx, &h.dlambr_idx);
+	for (i = 0; i < RULE_CACHE_NUM_TYPES; i++) {
+		/* a file not read on this run, or not kept, is not valid */
+		if (sect[i].src.rec_size == 0)
+			continue;
+		h.src[i] = sect[i].src;
+		h.src[i].nb_rec = sect[i].nb_rec;
+	}
+
+	f = fopen(RULE_CACHE_TMP, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "Cannot write rule cache %s\n", RULE_CACHE_TMP);
+		goto out;
+	}
+	err = (fwrite(&h, sizeof(h), 1, f) != 1);
+	for (i = 0; i < RULE_CACHE_NUM_TYPES && !err; i++) {
+		if (h.src[i].nb_rec)
+			err = (fwrite(sect[i].rec, h.src[i].rec_size,
+					h.src[i].nb_rec, f) != h.src[i].nb_rec);
+	}
+	err |= fclose(f);
+	if (err || rename(RULE_CACHE_TMP, RULE_CACHE_FILE) < 0) {
+		fprintf(stderr, "Cannot write rule cache %s\n",
+				RULE_CACHE_FILE);
+		remove(RULE_CACHE_TMP);
+	} else {
+		printf("Rule cache %s updated\n", RULE_CACHE_FILE);
+	}
+
+out:
+	for (i = 0; i < RULE_CACHE_NUM_TYPES; i++) {
+		if (sect[i].parsed)
+			free(sect[i].rec);
+		memset(&sect[i], 0, sizeof(sect[i]));
+	}
+	free(cache_buf);
+	cache_buf = NULL;
+}
+#endif /* RULE_CACHE */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RULE_CACHE_H
+#define RULE_CACHE_H
+
+/**
+ * @file
+ *
+ * Compiled rule cache of the Control Plane. The meter profile, PCC, SDF
+ * and ADC records parsed from the text rule files are written to
+ * RULE_CACHE_FILE, keyed on the size and CRC of each text file. At the
+ * next start up the records of an unchanged file are loaded from the
+ * cache and installed without parsing the file again. The text files
+ * stay the source of truth, a changed file is parsed and the cache
+ * rewritten.
+ */
+#ifdef RULE_CACHE
+#include <stdint.h>
+
+#define RULE_CACHE_FILE "../config/rules.bin"
+#define RULE_CACHE_MAGIC "NGICRUL"
+#define RULE_CACHE_VERSION 1
+
+/**
+ * @brief rule files kept in the cache
+ */
+enum rule_cache_type {
+	RULE_CACHE_MTR,
+	RULE_CACHE_PCC,
+	RULE_CACHE_SDF,
+	RULE_CACHE_ADC,
+	RULE_CACHE_NUM_TYPES
+};
+
+/**
+ * @brief text rule file a cache section was compiled from
+ */
+struct rule_cache_src {
+	uint64_t size;
+	uint32_t crc;
+	uint32_t nb_rec;
+	uint32_t rec_size;
+	uint32_t pad;
+};
+
+/**
+ * @brief cache file header, followed by the records of each type in
+ * enum rule_cache_type order
+ */
+struct rule_cache_hdr {
+	char magic[8];
+	uint32_t version;
+	uint16_t ulambr_idx;	/* GLOBAL entries of the PCC file */
+	uint16_t dlambr_idx;
+	struct rule_cache_src src[RULE_CACHE_NUM_TYPES];
+};
+
+/**
+ * Returns the cached records of a rule file, if the file did not change
+ * since they were compiled. Otherwise the records are parsed from the
+ * file and passed to rule_cache_put().
+ * @param type
+ *   rule file
+ * @param rec_size
+ *   size of a record
+ * @param nb_rec
+ *   number of records returned
+ * @return
+ *   \- array of nb_rec records
+ *   \- NULL if the file must be parsed
+ */
+const void *
+rule_cache_get(enum rule_cache_type type, uint32_t rec_size,
+		uint32_t *nb_rec);
+
+/**
+ * Keeps a record parsed from a rule file for the next rule_cache_write().
+ * @param type
+ *   rule file
+ * @param rec
+ *   record, of the rec_size given to rule_cache_get()
+ */
+void
+rule_cache_put(enum rule_cache_type type, const void *rec);
+
+/**
+ * Sets the AMBR meter profiles of the PCC file GLOBAL section.
+ * @param ul
+ *   UL_AMBR_MTR_PROFILE_IDX
+ * @param dl
+ *   DL_AMBR_MTR_PROFILE_IDX
+ */
+void
+rule_cache_ambr_set(uint16_t ul, uint16_t dl);
+
+/**
+ * Gets the AMBR meter profiles of a cached PCC file.
+ * @param ul
+ *   UL_AMBR_MTR_PROFILE_IDX
+ * @param dl
+ *   DL_AMBR_MTR_PROFILE_IDX
+ */
+void
+rule_cache_ambr_get(uint16_t *ul, uint16_t *dl);
+
+/**
+ * Writes the cache file if any rule file was parsed, and frees the
+ * records. Called once all rule files are installed.
+ */
+void
+rule_cache_write(void);
+
+#endif /* RULE_CACHE */
+#endif /* RULE_CACHE_H */
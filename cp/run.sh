@@ -19,7 +19,12 @@ APP_PATH="./build"
 APP="ngic_controlplane"
 LOG_LEVEL=1
 
-ARGS="--socket-mem $MEMORY,0 --file-prefix cp --no-pci -- \
+EAL_ARGS="--socket-mem $MEMORY,0 --file-prefix cp --no-pci"
+# CP_DP_SHM_RING builds attach to the DP memory as a secondary process.
+# Start DP first and use below line instead.
+#EAL_ARGS="--proc-type=secondary --file-prefix dp --no-pci"
+
+ARGS="$EAL_ARGS -- \
   -d $SPGW_CFG            \
   -m $S11_MME_IP          \
   -s $S11_SGW_IP          \
@@ -31,7 +36,9 @@ ARGS="--socket-mem $MEMORY,0 --file-prefix cp --no-pci -- \
   -i $IP_POOL_IP          \
   -p $IP_POOL_MASK        \
   -a $APN				  \
-  -l $LOG_LEVEL"
+  -l $LOG_LEVEL           \
+  -n ${MAX_UE:-65536}     \
+  -t ${TEID_LAYOUT:-0:0:0:0}"
 
 USAGE=$"Usage: run.sh [ debug | log ]
 	debug:	executes $APP under gdb
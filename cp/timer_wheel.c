@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <rte_cycles.h>
+
+#include "timer_wheel.h"
+
+/** Ticks of the longest timer */
+#define TW_MAX_TICKS                 ((1ULL << (TW_SLOT_BITS * TW_LEVELS)) - 1)
+
+static inline unsigned
+tw_slot_index(uint64_t tick, unsigned level)
+{
+	return (tick >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK;
+}
+
+/**
+ * Links a timer in the slot of its expiry, relative to the next tick.
+ */
+static void
+tw_link(struct timer_wheel *tw, struct tw_timer *timer)
+{
+	uint64_t delta = timer->expire - tw->now;
+	struct tw_timer **head;
+	unsigned level;
+
+	if ((int64_t)delta < 0) {
+		/* overdue after a cascade, runs on the next tick */
+		timer->expire = tw->now;
+		delta = 0;
+	}
+	for (level = 0; level < TW_LEVELS - 1; level++)
+		if (delta < (1ULL << (TW_SLOT_BITS * (level + 1))))
+			break;
+
+	head = &tw->slot[level][tw_slot_index(timer->expire, level)];
+	timer->next = *head;
+	if (timer->next)
+		timer->next->pprev = &timer->next;
+	timer->pprev = head;
+	*head = timer;
+}
+
+static inline void
+tw_unlink(struct tw_timer *timer)
+{
+	*timer->pprev = timer->next;
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+void
+tw_init(struct timer_wheel *tw, uint32_t tick_ms)
+{
+	unsigned level, i;
+
+	for (level = 0; level < TW_LEVELS; level++)
+		for (i = 0; i < TW_SLOTS; i++)
+			tw->slot[level][i] = NULL;
+	tw->now = 0;
+	tw->nb_armed = 0;
+	tw->tick_ms = tick_ms ? tick_ms : 1;
+	tw->tick_tsc = rte_get_tsc_hz() * tw->tick_ms / 1000;
+	tw->next_tsc = rte_get_tsc_cycles() + tw->tick_tsc;
+}
+
+void
+tw_arm(struct timer_wheel *tw, struct tw_timer *timer, uint64_t ms)
+{
+	uint64_t ticks = (ms + tw->tick_ms - 1) / tw->tick_ms;
+
+	if (tw_timer_pending(timer))
+		tw_unlink(timer);
+	else
+		tw->nb_armed++;
+
+	if (ticks > TW_MAX_TICKS)
+		ticks = TW_MAX_TICKS;
+	/* the next tick is partly elapsed, never expire early */
+	timer->expire = tw->now + ticks;
+	tw_link(tw, timer);
+}
+
+void
+tw_cancel(struct timer_wheel *tw, struct tw_timer *timer)
+{
+	if (!tw_timer_pending(timer))
+		return;
+	tw_unlink(timer);
+	tw->nb_armed--;
+}
+
+/**
+ * Moves the timers of a slot of an upper wheel to the lower wheels.
+ * @return
+ *   index of the slot, 0 once the whole wheel went by
+ */
+static unsigned
+tw_cascade(struct timer_wheel *tw, unsigned level)
+{
+	unsigned index = tw_slot_index(tw->now, level);
+	struct tw_timer *timer = tw->slot[level][index];
+	struct tw_timer *next;
+
+	tw->slot[level][index] = NULL;
+	for (; timer != NULL; timer = next) {
+		next = timer->next;
+		tw_link(tw, timer);
+	}
+	return index;
+}
+
+/**
+ * Runs a tick, the expired timers are unlinked before their callback so
+ * a callback may arm or cancel any timer.
+ * @return
+ *   number of timers expired
+ */
+static unsigned
+tw_tick(struct timer_wheel *tw)
+{
+	unsigned index = tw->now & TW_SLOT_MASK;
+	struct tw_timer *expired;
+	struct tw_timer *timer;
+	unsigned level, n = 0;
+
+	for (level = 1; index == 0 && level < TW_LEVELS; level++)
+		if (tw_cascade(tw, level) != 0)
+			break;
+
+	expired = tw->slot[0][index];
+	tw->slot[0][index] = NULL;
+	if (expired != NULL)
+		expired->pprev = &expired;
+	tw->now++;
+
+	while (expired != NULL) {
+		timer = expired;
+		tw_unlink(timer);
+		tw->nb_armed--;
+		timer->cb(timer, timer->arg);
+		n++;
+	}
+	return n;
+}
+
+unsigned
+tw_advance(struct timer_wheel *tw)
+{
+	uint64_t tsc = rte_get_tsc_cycles();
+	uint64_t ticks;
+	unsigned n = 0;
+
+	if (tsc < tw->next_tsc)
+		return 0;
+
+	ticks = (tsc - tw->next_tsc) / tw->tick_tsc + 1;
+	tw->next_tsc += ticks * tw->tick_tsc;
+
+	/* no timer to run, skip the ticks at once */
+	if (tw->nb_armed == 0) {
+		tw->now += ticks;
+		return 0;
+	}
+	while (ticks--)
+		n += tw_tick(tw);
+	return n;
+}
+
+int
+tw_timeout_ms(const struct timer_wheel *tw)
+{
+	uint64_t tsc = rte_get_tsc_cycles();
+
+	if (tw->nb_armed == 0)
+		return -1;
+	if (tsc >= tw->next_tsc)
+		return 0;
+	return ((tw->next_tsc - tsc) * 1000 + rte_get_tsc_hz() - 1)
+			/ rte_get_tsc_hz();
+}
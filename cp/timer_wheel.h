@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/**
+ * @file
+ *
+ * Hierarchical timer wheel. TW_LEVELS wheels of TW_SLOTS slots each, the
+ * wheel of level n holding the timers due in less than TW_SLOTS^(n+1)
+ * ticks. Timers are armed and cancelled in O(1); the timers of a lower
+ * wheel slot are cascaded down once per TW_SLOTS ticks of the upper one.
+ * A wheel is owned by one lcore and is not thread safe.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+/** Bits of the slot index of each wheel */
+#define TW_SLOT_BITS                 (8)
+#define TW_SLOTS                     (1 << TW_SLOT_BITS)
+#define TW_SLOT_MASK                 (TW_SLOTS - 1)
+/** Wheels, the longest timer is 2^(TW_SLOT_BITS * TW_LEVELS) - 1 ticks */
+#define TW_LEVELS                    (4)
+
+struct tw_timer;
+
+/**
+ * Callback of an expired timer, which may arm it again
+ * @param timer
+ *   the expired timer
+ * @param arg
+ *   argument of tw_timer_init()
+ */
+typedef void (*tw_cb_t)(struct tw_timer *timer, void *arg);
+
+/**
+ * @brief timer, embedded in the object it times
+ */
+struct tw_timer {
+	struct tw_timer *next;
+	struct tw_timer **pprev;	/** NULL if not armed */
+	uint64_t expire;		/** tick the timer expires on */
+	tw_cb_t cb;
+	void *arg;
+};
+
+/**
+ * @brief timer wheel
+ */
+struct timer_wheel {
+	uint64_t now;			/** next tick to run */
+	uint64_t tick_tsc;		/** tsc cycles per tick */
+	uint64_t next_tsc;		/** tsc of the next tick */
+	uint32_t nb_armed;
+	uint32_t tick_ms;
+	struct tw_timer *slot[TW_LEVELS][TW_SLOTS];
+};
+
+/**
+ * Initializes a timer wheel, starting at the current tsc.
+ * @param tw
+ *   timer wheel
+ * @param tick_ms
+ *   duration of a tick
+ */
+void
+tw_init(struct timer_wheel *tw, uint32_t tick_ms);
+
+/**
+ * Initializes a timer, not armed.
+ * @param timer
+ *   timer
+ * @param cb
+ *   callback run on expiry
+ * @param arg
+ *   argument of cb
+ */
+static inline void
+tw_timer_init(struct tw_timer *timer, tw_cb_t cb, void *arg)
+{
+	timer->next = NULL;
+	timer->pprev = NULL;
+	timer->expire = 0;
+	timer->cb = cb;
+	timer->arg = arg;
+}
+
+/**
+ * @return
+ *   1 if the timer is armed, 0 otherwise
+ */
+static inline int
+tw_timer_pending(const struct tw_timer *timer)
+{
+	return timer->pprev != NULL;
+}
+
+/**
+ * Arms a timer, re-arming it if already armed.
+ * @param tw
+ *   timer wheel
+ * @param timer
+ *   initialized timer
+ * @param ms
+ *   expiry delay, rounded up to the next tick
+ */
+void
+tw_arm(struct timer_wheel *tw, struct tw_timer *timer, uint64_t ms);
+
+/**
+ * Cancels a timer, a no-op if not armed.
+ * @param tw
+ *   timer wheel of the timer
+ * @param timer
+ *   timer
+ */
+void
+tw_cancel(struct timer_wheel *tw, struct tw_timer *timer);
+
+/**
+ * Runs the ticks elapsed up to the current tsc, and the callbacks of the
+ * timers expired.
+ * @param tw
+ *   timer wheel
+ * @return
+ *   number of timers expired
+ */
+unsigned
+tw_advance(struct timer_wheel *tw);
+
+/**
+ * Time to wait for events before calling tw_advance() again.
+ * @param tw
+ *   timer wheel
+ * @return
+ *   ms to the next tick, -1 if no timer is armed
+ */
+int
+tw_timeout_ms(const struct timer_wheel *tw);
+
+#endif /* TIMER_WHEEL_H */
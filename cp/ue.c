@@ -16,12 +16,16 @@
 
 #include "ue.h"
 #include "interface.h"
+#include "dp_pool.h"
 
 #include <rte_debug.h>
 #include <rte_branch_prediction.h>
 #include <rte_errno.h>
 #include <rte_lcore.h>
 #include <rte_malloc.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_hash_crc.h>
 
 #include <errno.h>
 #include <stddef.h>
@@ -31,8 +35,13 @@
 #include <arpa/inet.h>
 #include <string.h>
 
+#ifdef CP_WORKERS
+RTE_DEFINE_PER_LCORE(struct rte_hash *, ue_context_by_imsi_hash);
+RTE_DEFINE_PER_LCORE(struct rte_hash *, ue_context_by_fteid_hash);
+#else
 struct rte_hash *ue_context_by_imsi_hash;
 struct rte_hash *ue_context_by_fteid_hash;
+#endif
 
 static struct in_addr ip_pool_ip;
 static struct in_addr ip_pool_mask;
@@ -40,9 +49,19 @@ static struct in_addr ip_pool_mask;
 apn one_apn;
 
 const uint32_t s11_sgw_gtpc_base_teid = 0xC0FFEE;
-static uint32_t s11_sgw_gtpc_teid_offset;
 const uint32_t s5s8_pgw_gtpc_base_teid = 0xD0FFEE;
+#ifdef CP_WORKERS
+static RTE_DEFINE_PER_LCORE(uint32_t, s11_sgw_gtpc_teid_offset);
+static RTE_DEFINE_PER_LCORE(uint32_t, s5s8_pgw_gtpc_teid_offset);
+static RTE_DEFINE_PER_LCORE(uint32_t, gtpc_teid_step);
+#define s11_sgw_gtpc_teid_offset RTE_PER_LCORE(s11_sgw_gtpc_teid_offset)
+#define s5s8_pgw_gtpc_teid_offset RTE_PER_LCORE(s5s8_pgw_gtpc_teid_offset)
+#define GTPC_TEID_STEP RTE_PER_LCORE(gtpc_teid_step)
+#else
+static uint32_t s11_sgw_gtpc_teid_offset;
 static uint32_t s5s8_pgw_gtpc_teid_offset;
+#define GTPC_TEID_STEP 1
+#endif
 
 uint32_t base_s1u_sgw_gtpu_teid = 0xf0000000;
 
@@ -59,11 +78,111 @@ enum cp_config {
 };
 extern enum cp_config spgw_cfg;
 
+struct teid_layout teid_layout;
+
+/* Seed of the UE ip hash steering the UE to a DP worker, PRIME_VALUE of
+ * the DP */
+#define UE_IP_HASH_SEED              (0xeaad8405)
+
+void
+set_teid_layout(const char *str)
+{
+	unsigned dp_bits, shard_bits, dp, dp_workers;
+
+	/* the UE ids left must cover every UE context of the pool */
+	if (sscanf(str, "%u:%u:%u:%u", &dp_bits, &shard_bits, &dp,
+			&dp_workers) != 4
+			|| dp_bits + shard_bits > 12
+			|| dp >= (1u << dp_bits)
+			|| dp_workers > (1u << shard_bits)
+			|| (1u << (24 - dp_bits - shard_bits)) < ue_pool_size)
+		rte_panic("Invalid teid_layout - %s - for max_ue %u - Exiting.",
+				str, ue_pool_size);
+
+	teid_layout.dp_bits = dp_bits;
+	teid_layout.shard_bits = shard_bits;
+	teid_layout.dp = dp;
+	teid_layout.dp_workers = dp_workers;
+}
+
+/** IMSIs given with --mirror_imsi, encoded as ue_context_t imsi */
+static uint64_t mirror_imsi[MIRROR_IMSI_MAX];
+static uint32_t mirror_imsi_cnt;
+
+void
+add_mirror_imsi(const char *str)
+{
+	uint8_t tbcd[sizeof(uint64_t)];
+	size_t len = strlen(str);
+	size_t i;
+	uint8_t d;
+
+	if (len == 0 || len > 2 * sizeof(tbcd)
+			|| strspn(str, "0123456789") != len
+			|| mirror_imsi_cnt == MIRROR_IMSI_MAX)
+		rte_panic("Invalid mirror_imsi - %s - Exiting.", str);
+
+	/* TBCD digits of the IMSI IE, filler and the bytes beyond the IE
+	 * all ones as create_ue_context() leaves them */
+	memset(tbcd, 0xff, sizeof(tbcd));
+	for (i = 0; i < len; i++) {
+		d = str[i] - '0';
+		if (i & 1)
+			tbcd[i / 2] = (tbcd[i / 2] & 0x0f) | (d << 4);
+		else
+			tbcd[i / 2] = 0xf0 | d;
+	}
+	memcpy(&mirror_imsi[mirror_imsi_cnt++], tbcd, sizeof(tbcd));
+}
+
+/**
+ * Checks if the bearers of an IMSI are to be mirrored.
+ */
+static uint8_t
+is_mirror_imsi(uint64_t imsi)
+{
+	uint32_t i;
+
+	for (i = 0; i < mirror_imsi_cnt; i++)
+		if (mirror_imsi[i] == imsi)
+			return 1;
+	return 0;
+}
+
+/**
+ * Low 24 bits of the SGW GTP-U TEIDs of a bearer, see struct teid_layout.
+ * The shard is the DP worker of the UE ip of the bearer, as computed by
+ * set_ue_worker_core_id() of the DP without NIC_RSS_STEERING.
+ */
+static uint32_t
+gtpu_teid_low(eps_bearer *bearer, ue_context *context)
+{
+	uint32_t id_bits = 24 - teid_layout.dp_bits - teid_layout.shard_bits;
+	uint32_t id = context->s11_sgw_gtpc_teid;
+	uint32_t shard = 0;
+	uint32_t dp = teid_layout.dp;
+
+	if (id_bits == 24)
+		return id & 0x00ffffff;
+
+	id -= (spgw_cfg == PGWC) ?
+			s5s8_pgw_gtpc_base_teid : s11_sgw_gtpc_base_teid;
+	if (teid_layout.dp_workers && bearer->pdn)
+		shard = rte_hash_crc_4byte(bearer->pdn->ipv4.s_addr,
+				UE_IP_HASH_SEED) % teid_layout.dp_workers;
+
+#ifdef MULTI_DP
+	dp = (dp + context->dp) & ((1 << teid_layout.dp_bits) - 1);
+#endif
+	return (dp << (24 - teid_layout.dp_bits))
+			| (shard << id_bits) | (id & ((1 << id_bits) - 1));
+}
+
 void
 set_s1u_sgw_gtpu_teid(eps_bearer *bearer, ue_context *context)
 {
 	uint8_t index = __builtin_ffs(~(context->teid_bitmap)) - 1;
-	bearer->s1u_sgw_gtpu_teid = (context->s11_sgw_gtpc_teid & 0x00ffffff)
+	bearer->s1u_sgw_gtpu_teid = gtpu_teid_low(bearer, context)
 	    | ((0xf0 + index) << 24);
 	context->teid_bitmap |= (0x01 << index);
 }
@@ -75,7 +194,7 @@ set_s5s8_sgw_gtpu_teid(eps_bearer *bearer, ue_context *context)
 	/* Note: s5s8_sgw_gtpu_teid based s11_sgw_gtpc_teid
 	 * Computation same as s1u_sgw_gtpu_teid
 	 */
-	bearer->s5s8_sgw_gtpu_teid = (context->s11_sgw_gtpc_teid & 0x00ffffff)
+	bearer->s5s8_sgw_gtpu_teid = gtpu_teid_low(bearer, context)
 	    | ((0xf0 + index) << 24);
 	context->teid_bitmap |= (0x01 << index);
 }
@@ -85,15 +204,16 @@ set_s5s8_pgw_gtpc_teid(pdn_connection *pdn)
 {
 	pdn->s5s8_pgw_gtpc_teid = s5s8_pgw_gtpc_base_teid
 		+ s5s8_pgw_gtpc_teid_offset;
-	++s5s8_pgw_gtpc_teid_offset;
+	s5s8_pgw_gtpc_teid_offset += GTPC_TEID_STEP;
 }
 
-void
-create_ue_hash(void)
+static void
+ue_hash_create(const char *imsi_name, const char *fteid_name,
+		uint32_t entries)
 {
 	struct rte_hash_parameters rte_hash_params = {
-			.name = "bearer_by_imsi_hash",
-	    .entries = LDB_ENTRIES_DEFAULT,
+			.name = imsi_name,
+	    .entries = entries,
 	    .key_len = sizeof(uint64_t),
 	    .hash_func = rte_jhash,
 	    .hash_func_init_val = 0,
@@ -106,7 +226,7 @@ create_ue_hash(void)
 				rte_hash_params.name,
 		    rte_strerror(rte_errno), rte_errno);
 	}
-	rte_hash_params.name = "bearer_by_fteid_hash";
+	rte_hash_params.name = fteid_name;
 	rte_hash_params.key_len = sizeof(uint32_t);
 	ue_context_by_fteid_hash = rte_hash_create(&rte_hash_params);
 	if (!ue_context_by_fteid_hash) {
@@ -116,6 +236,190 @@ create_ue_hash(void)
 	}
 }
 
+uint32_t ue_pool_size = UE_POOL_SIZE_DEFAULT;
+
+#ifdef CP_OBJ_POOL
+static struct rte_mempool *ue_context_pool;
+static struct rte_mempool *pdn_pool;
+static struct rte_mempool *eps_bearer_pool;
+
+static struct rte_mempool *
+ue_pool_create(const char *name, unsigned n, unsigned elt_size)
+{
+	struct rte_mempool *mp = rte_mempool_create(name, n, elt_size,
+			UE_POOL_CACHE_SIZE, 0, NULL, NULL, NULL, NULL,
+			rte_socket_id(), 0);
+
+	if (mp == NULL)
+		rte_panic("%s create failed: %s (%u)\n.", name,
+		    rte_strerror(rte_errno), rte_errno);
+	return mp;
+}
+
+void
+create_ue_pools(void)
+{
+	ue_context_pool = ue_pool_create("ue_context_pool", ue_pool_size,
+			sizeof(ue_context));
+	pdn_pool = ue_pool_create("pdn_pool",
+			ue_pool_size * UE_POOL_PDNS_PER_UE,
+			sizeof(pdn_connection));
+	eps_bearer_pool = ue_pool_create("eps_bearer_pool",
+			ue_pool_size * UE_POOL_BEARERS_PER_UE,
+			sizeof(eps_bearer));
+}
+
+static void *
+ue_pool_get(struct rte_mempool *mp)
+{
+	void *obj;
+
+	if (unlikely(rte_mempool_get(mp, &obj) < 0)) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	memset(obj, 0, mp->elt_size);
+	return obj;
+}
+
+static void
+ue_pool_put(struct rte_mempool *mp, void *obj)
+{
+	if (obj)
+		rte_mempool_put(mp, obj);
+}
+#endif
+
+ue_context *
+ue_context_alloc(void)
+{
+	ue_context *context;
+
+#ifdef CP_OBJ_POOL
+	context = ue_pool_get(ue_context_pool);
+#else
+	context = rte_zmalloc_socket(NULL, sizeof(ue_context),
+	    RTE_CACHE_LINE_SIZE, rte_socket_id());
+#endif
+	return context;
+}
+
+void
+ue_context_free(ue_context *context)
+{
+#ifdef MULTI_DP
+	if (context && context->dp_held)
+		dp_pool_release(context->dp);
+#endif
+#ifdef CP_OBJ_POOL
+	ue_pool_put(ue_context_pool, context);
+#else
+	rte_free(context);
+#endif
+}
+
+void
+ue_context_dp_release(ue_context *context)
+{
+#ifdef MULTI_DP
+	if (context->dp_held && context->bearer_bitmap == 0) {
+		dp_pool_release(context->dp);
+		context->dp_held = 0;
+	}
+#else
+	RTE_SET_USED(context);
+#endif
+}
+
+pdn_connection *
+pdn_alloc(void)
+{
+#ifdef CP_OBJ_POOL
+	return ue_pool_get(pdn_pool);
+#else
+	return rte_zmalloc_socket(NULL, sizeof(pdn_connection),
+	    RTE_CACHE_LINE_SIZE, rte_socket_id());
+#endif
+}
+
+void
+pdn_free(pdn_connection *pdn)
+{
+	if (pdn)
+		release_pdn_ip(pdn);
+#ifdef CP_OBJ_POOL
+	ue_pool_put(pdn_pool, pdn);
+#else
+	rte_free(pdn);
+#endif
+}
+
+eps_bearer *
+eps_bearer_alloc(void)
+{
+#ifdef CP_OBJ_POOL
+	return ue_pool_get(eps_bearer_pool);
+#else
+	return rte_zmalloc_socket(NULL, sizeof(eps_bearer),
+	    RTE_CACHE_LINE_SIZE, rte_socket_id());
+#endif
+}
+
+/**
+ * Drops the packet filter references of a bearer, and the ones of its PDN
+ * to the bearer, before it is freed or cleared for reuse.
+ */
+static void
+eps_bearer_release_filters(eps_bearer *bearer)
+{
+	uint8_t i;
+
+	for (i = 0; i < MAX_FILTERS_PER_UE; ++i) {
+		release_packet_filter(bearer->packet_filter_map[i]);
+		if (bearer->pdn && bearer->pdn->packet_filter_map[i] == bearer)
+			bearer->pdn->packet_filter_map[i] = NULL;
+	}
+}
+
+void
+eps_bearer_free(eps_bearer *bearer)
+{
+	eps_bearer_release_filters(bearer);
+
+#ifdef CP_OBJ_POOL
+	ue_pool_put(eps_bearer_pool, bearer);
+#else
+	rte_free(bearer);
+#endif
+}
+
+void
+create_ue_hash(void)
+{
+	ue_hash_create("bearer_by_imsi_hash", "bearer_by_fteid_hash",
+			LDB_ENTRIES_DEFAULT);
+}
+
+#ifdef CP_WORKERS
+void
+ue_shard_init(unsigned shard, unsigned nb_shards)
+{
+	char imsi_name[RTE_HASH_NAMESIZE];
+	char fteid_name[RTE_HASH_NAMESIZE];
+
+	snprintf(imsi_name, sizeof(imsi_name), "bearer_by_imsi_hash_%u",
+			shard);
+	snprintf(fteid_name, sizeof(fteid_name), "bearer_by_fteid_hash_%u",
+			shard);
+	ue_hash_create(imsi_name, fteid_name,
+			LDB_ENTRIES_DEFAULT / nb_shards);
+
+	s11_sgw_gtpc_teid_offset = shard;
+	s5s8_pgw_gtpc_teid_offset = shard;
+	GTPC_TEID_STEP = nb_shards;
+}
+#endif
+
 
 void
 set_ip_pool_ip(const char *ip_str)
@@ -228,8 +532,7 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 	    (void **) &(*context));
 
 	if (ret == -ENOENT) {
-		(*context) = rte_zmalloc_socket(NULL, sizeof(ue_context),
-		    RTE_CACHE_LINE_SIZE, rte_socket_id());
+		(*context) = ue_context_alloc();
 		if (*context == NULL) {
 			fprintf(stderr, "Failure to allocate ue context "
 					"structure: %s (%s:%d)\n",
@@ -239,20 +542,21 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 			return GTPV2C_CAUSE_SYSTEM_FAILURE;
 		}
 		(*context)->imsi = imsi;
+		(*context)->mirror = is_mirror_imsi(imsi);
 		ret = rte_hash_add_key_data(ue_context_by_imsi_hash,
 		    (const void *) &(*context)->imsi, (void *) (*context));
 		if (ret < 0) {
 			fprintf(stderr,
 				"%s - Error on rte_hash_add_key_data add\n",
 				strerror(ret));
-			rte_free((*context));
+			ue_context_free((*context));
 			return GTPV2C_CAUSE_SYSTEM_FAILURE;
 		}
 
 		if ((spgw_cfg == SGWC) || (spgw_cfg == SPGWC)) {
 			(*context)->s11_sgw_gtpc_teid = s11_sgw_gtpc_base_teid
 			    + s11_sgw_gtpc_teid_offset;
-			++s11_sgw_gtpc_teid_offset;
+			s11_sgw_gtpc_teid_offset += GTPC_TEID_STEP;
 
 		} else if (spgw_cfg == PGWC){
 			(*context)->s11_sgw_gtpc_teid = s5s8_pgw_gtpc_base_teid
@@ -279,11 +583,19 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 					"ue_context_by_imsi_hash del\n",
 					strerror(ret));
 			}
-			rte_free((*context));
+			ue_context_free((*context));
 			return GTPV2C_CAUSE_SYSTEM_FAILURE;
 		}
 	}
 
+#ifdef MULTI_DP
+	/* first session of the UE, or first since all were deleted */
+	if (!(*context)->dp_held) {
+		(*context)->dp = dp_pool_select();
+		(*context)->dp_held = 1;
+	}
+#endif
+
 	ebi_index = ebi - 5;
 	pdn = (*context)->pdns[ebi_index];
 	bearer = (*context)->eps_bearers[ebi_index];
@@ -296,10 +608,11 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 				if (!pdn->eps_bearers[i])
 					continue;
 				if (i == ebi_index) {
+					eps_bearer_release_filters(bearer);
 					bzero(bearer, sizeof(*bearer));
 					continue;
 				}
-				rte_free(pdn->eps_bearers[i]);
+				eps_bearer_free(pdn->eps_bearers[i]);
 				pdn->eps_bearers[i] = NULL;
 				(*context)->eps_bearers[i] = NULL;
 				(*context)->bearer_bitmap &= ~(1 << ebi_index);
@@ -308,10 +621,9 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 			/* created session is creating a default bearer in place */
 			/* of a different pdn connection's dedicated bearer */
 			bearer->pdn->eps_bearers[ebi_index] = NULL;
+			eps_bearer_release_filters(bearer);
 			bzero(bearer, sizeof(*bearer));
-			pdn = rte_zmalloc_socket(NULL,
-				sizeof(struct pdn_connection_t),
-				RTE_CACHE_LINE_SIZE, rte_socket_id());
+			pdn = pdn_alloc();
 			if (pdn == NULL) {
 				fprintf(stderr, "Failure to allocate PDN "
 						"structure: %s (%s:%d)\n",
@@ -326,8 +638,7 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 			pdn->default_bearer_id = ebi;
 		}
 	} else {
-		bearer = rte_zmalloc_socket(NULL, sizeof(eps_bearer),
-			RTE_CACHE_LINE_SIZE, rte_socket_id());
+		bearer = eps_bearer_alloc();
 		if (bearer == NULL) {
 			fprintf(stderr, "Failure to allocate bearer "
 					"structure: %s (%s:%d)\n",
@@ -337,8 +648,7 @@ create_ue_context(gtpv2c_ie *imsi_ie, uint8_t ebi, ue_context **context)
 			return GTPV2C_CAUSE_SYSTEM_FAILURE;
 		}
 		bearer->eps_bearer_id = ebi;
-		pdn = rte_zmalloc_socket(NULL, sizeof(struct pdn_connection_t),
-		    RTE_CACHE_LINE_SIZE, rte_socket_id());
+		pdn = pdn_alloc();
 		if (pdn == NULL) {
 			fprintf(stderr, "Failure to allocate PDN "
 					"structure: %s (%s:%d)\n",
@@ -378,15 +688,85 @@ get_apn(char *apn_label, uint16_t apn_length)
 }
 
 
+/**
+ * Creates the pool of an APN over the host addresses of a subnet.
+ */
+static void
+ip_pool_create(apn *an_apn, struct in_addr ip, struct in_addr mask)
+{
+	static unsigned nb_pools;
+	char name[RTE_RING_NAMESIZE];
+	struct ip_pool *pool;
+	uint32_t hosts = ~ntohl(mask.s_addr);
+	uint32_t i;
+
+	if (hosts < 2)
+		rte_panic("ip_pool_mask %s leaves no UE address\n",
+				inet_ntoa(mask));
+
+	pool = rte_zmalloc_socket(NULL, sizeof(struct ip_pool),
+	    RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (pool == NULL)
+		rte_panic("Failure to allocate ip pool: %s\n",
+				rte_strerror(rte_errno));
+
+	/* network and broadcast addresses are not handed out */
+	pool->last = (ntohl(ip.s_addr) | hosts) - 1;
+	pool->size = RTE_MIN(hosts - 1, (uint32_t)LDB_ENTRIES_DEFAULT - 1);
+
+	/* shared by all CP workers, MP/MC */
+	snprintf(name, sizeof(name), "ip_pool_%u", nb_pools++);
+	pool->free = rte_ring_create(name, rte_align32pow2(pool->size + 1),
+			rte_socket_id(), 0);
+	if (pool->free == NULL)
+		rte_panic("%s create failed: %s (%u)\n.", name,
+		    rte_strerror(rte_errno), rte_errno);
+
+	for (i = 0; i < pool->size; i++)
+		rte_ring_enqueue(pool->free, (void *)(uintptr_t)i);
+
+	an_apn->ip_pool = pool;
+}
+
+void
+create_ip_pools(void)
+{
+	ip_pool_create(&one_apn, ip_pool_ip, ip_pool_mask);
+}
+
 uint32_t
-acquire_ip(struct in_addr *ipv4)
+acquire_ip(apn *an_apn, struct in_addr *ipv4)
 {
-	static uint32_t next_ip_index;
-	if (unlikely(next_ip_index == LDB_ENTRIES_DEFAULT)) {
+	struct ip_pool *pool = an_apn->ip_pool;
+	void *ip_index;
+
+	if (unlikely(rte_ring_dequeue(pool->free, &ip_index) < 0)) {
 		fprintf(stderr, "IP Pool depleted\n");
 		return GTPV2C_CAUSE_ALL_DYNAMIC_ADDRESSES_OCCUPIED;
 	}
-	ipv4->s_addr = GET_UE_IP(next_ip_index++);
+	ipv4->s_addr = htonl(pool->last - (uint32_t)(uintptr_t)ip_index);
 	return 0;
 }
 
+void
+release_ip(struct ip_pool *pool, struct in_addr ipv4)
+{
+	uint32_t ip_index = pool->last - ntohl(ipv4.s_addr);
+
+	if (unlikely(ip_index >= pool->size)) {
+		fprintf(stderr, "Release of %s, not in IP Pool\n",
+				inet_ntoa(ipv4));
+		return;
+	}
+	rte_ring_enqueue(pool->free, (void *)(uintptr_t)ip_index);
+}
+
+void
+release_pdn_ip(pdn_connection *pdn)
+{
+	if (pdn->ip_pool == NULL)
+		return;
+	release_ip(pdn->ip_pool, pdn->ipv4);
+	pdn->ip_pool = NULL;
+}
+
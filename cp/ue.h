@@ -32,11 +32,13 @@
 
 #include <rte_malloc.h>
 #include <rte_lcore.h>
+#include <rte_per_lcore.h>
 #include <rte_jhash.h>
 #include <rte_hash.h>
 
 #include "gtpv2c_ie.h"
 #include "packet_filters.h"
+#include "dp_pool.h"
 
 #define SDF_FILTER_TABLE "sdf_filter_table"
 #define ADC_TABLE "adc_rule_table"
@@ -51,49 +53,87 @@
 #define METER_PROFILE_SDF_TABLE_SIZE (2048)
 
 #define DPN_ID                       (12345)
+/** dp_id.id of the DP serving the sessions of a UE context */
+#define UE_DPN_ID(context)           (DPN_ID + (context)->dp)
+/** S1U SGW ip advertised for the sessions of a UE context */
+#ifdef MULTI_DP
+#define UE_S1U_SGW_IP(context)       dp_pool_s1u_ip((context)->dp)
+#else
+#define UE_S1U_SGW_IP(context)       s1u_sgw_ip
+#endif
 
 #define MAX_BEARERS                  (11)
 #define MAX_FILTERS_PER_UE           (16)
 
-#define GET_UE_IP(ue_index) \
-		(((ip_pool_ip.s_addr | (~ip_pool_mask.s_addr)) \
-				- htonl(ue_index)) - 0x01000000)
-
 struct eps_bearer_t;
 struct pdn_connection_t;
 
+/**
+ * Pool of the UE IPv4 addresses of an APN. Address i of the pool is the
+ * i-th below the broadcast address of the subnet.
+ */
+struct ip_pool {
+	uint32_t last;                  /** address 0, host order */
+	uint32_t size;                  /** addresses in pool */
+	struct rte_ring *free;          /** indices of free addresses */
+};
+
 typedef struct apn_t {
 	char *apn_name_label;
 	size_t apn_name_length;
+	struct ip_pool *ip_pool;
 } apn;
 
+/* Fields are ordered by use: the ones read or written by the messages
+ * of an established session (modify bearer, DDN, delete session) come
+ * first, to share the first cache lines of the context. */
 typedef struct ue_context_t {
-	uint64_t imsi;
-	uint8_t unathenticated_imsi;
-	uint64_t mei;
-	uint64_t msisdn;
-
-	ambr_ie mn_ambr;
-
 	uint32_t s11_sgw_gtpc_teid;
-	struct in_addr s11_sgw_gtpc_ipv4;
 	uint32_t s11_mme_gtpc_teid;
+	struct in_addr s11_sgw_gtpc_ipv4;
 	struct in_addr s11_mme_gtpc_ipv4;
 
 	uint16_t bearer_bitmap;
 	uint16_t teid_bitmap;
 	uint8_t num_pdns;
+	/* DP of the sessions, index in the DP pool with MULTI_DP */
+	uint8_t dp;
+	/* UE accounted to dp in the DP pool, see ue_context_dp_release() */
+	uint8_t dp_held;
+	/* DP mirrors the pkts of the bearers, IMSI set with --mirror_imsi */
+	uint8_t mirror;
 
-	struct pdn_connection_t *pdns[MAX_BEARERS];
 	struct eps_bearer_t *eps_bearers[MAX_BEARERS]; /* index by ebi - 5 */
+	struct pdn_connection_t *pdns[MAX_BEARERS];
 
 	/* temporary bearer to be used during resource bearer cmd -
 	 * create/deletee bearer req - rsp */
 	struct eps_bearer_t *ded_bearer;
 
-} ue_context;
+	uint64_t imsi;
+	uint8_t unathenticated_imsi;
+	uint64_t mei;
+	uint64_t msisdn;
+
+	ambr_ie mn_ambr;
+} __rte_cache_aligned ue_context;
 
+/* Addresses, TEIDs and bearers first, see ue_context_t */
 typedef struct pdn_connection_t {
+	struct in_addr ipv4;
+	/* pool of ipv4, NULL if not allocated by this CP */
+	struct ip_pool *ip_pool;
+
+	uint32_t s5s8_sgw_gtpc_teid;
+	struct in_addr s5s8_sgw_gtpc_ipv4;
+
+	uint32_t s5s8_pgw_gtpc_teid;
+	struct in_addr s5s8_pgw_gtpc_ipv4;
+
+	uint8_t default_bearer_id;
+
+	struct eps_bearer_t *eps_bearers[MAX_BEARERS]; /* index by ebi - 5 */
+
 	apn *apn_in_use;
 	ambr_ie apn_ambr;
 	uint32_t apn_restriction;
@@ -101,56 +141,92 @@ typedef struct pdn_connection_t {
 	ambr_ie session_ambr;
 	ambr_ie session_gbr;
 
-	struct in_addr ipv4;
 	struct in6_addr ipv6;
 
-	uint32_t s5s8_sgw_gtpc_teid;
-	struct in_addr s5s8_sgw_gtpc_ipv4;
-
-	uint32_t s5s8_pgw_gtpc_teid;
-	struct in_addr s5s8_pgw_gtpc_ipv4;
-
 	pdn_type_ie pdn_type;
 	/* See  3GPP TS 32.298 5.1.2.2.7 for Charging Characteristics fields*/
 	charging_characteristics_ie charging_characteristics;
 
-	uint8_t default_bearer_id;
-
-	struct eps_bearer_t *eps_bearers[MAX_BEARERS]; /* index by ebi - 5 */
-
 	struct eps_bearer_t *packet_filter_map[MAX_FILTERS_PER_UE];
-} pdn_connection;
+} __rte_cache_aligned pdn_connection;
 
+/* Tunnel endpoints first, see ue_context_t */
 typedef struct eps_bearer_t {
 	uint8_t eps_bearer_id;
 
-	bearer_qos_ie qos;
-
-	uint32_t charging_id;
-
-	struct in_addr s1u_sgw_gtpu_ipv4;
 	uint32_t s1u_sgw_gtpu_teid;
-	struct in_addr s5s8_sgw_gtpu_ipv4;
+	struct in_addr s1u_sgw_gtpu_ipv4;
+	uint32_t s1u_enb_gtpu_teid;
+	struct in_addr s1u_enb_gtpu_ipv4;
 	uint32_t s5s8_sgw_gtpu_teid;
-	struct in_addr s5s8_pgw_gtpu_ipv4;
+	struct in_addr s5s8_sgw_gtpu_ipv4;
 	uint32_t s5s8_pgw_gtpu_teid;
-	struct in_addr s1u_enb_gtpu_ipv4;
-	uint32_t s1u_enb_gtpu_teid;
+	struct in_addr s5s8_pgw_gtpu_ipv4;
 
-	struct in_addr s11u_mme_gtpu_ipv4;
 	uint32_t s11u_mme_gtpu_teid;
+	struct in_addr s11u_mme_gtpu_ipv4;
 
 	struct pdn_connection_t *pdn;
 
+	bearer_qos_ie qos;
+
+	uint32_t charging_id;
+
 	int packet_filter_map[MAX_FILTERS_PER_UE];
 	uint8_t num_packet_filters;
-} eps_bearer;
-
+} __rte_cache_aligned eps_bearer;
+
+#ifdef CP_WORKERS
+/* UE contexts of the shard of each CP worker, see ue_shard_init() */
+RTE_DECLARE_PER_LCORE(struct rte_hash *, ue_context_by_imsi_hash);
+RTE_DECLARE_PER_LCORE(struct rte_hash *, ue_context_by_fteid_hash);
+#define ue_context_by_imsi_hash RTE_PER_LCORE(ue_context_by_imsi_hash)
+#define ue_context_by_fteid_hash RTE_PER_LCORE(ue_context_by_fteid_hash)
+#else
 extern struct rte_hash *ue_context_by_imsi_hash;
 extern struct rte_hash *ue_context_by_fteid_hash;
+#endif
 extern apn one_apn;
 
 
+/**
+ * Layout of the low 24 bits of the SGW GTP-U TEIDs. From the top: the DP
+ * instance in dp_bits, the DP worker shard of the UE in shard_bits, and
+ * the UE in the remaining bits. The top 8 bits of a TEID select the bearer
+ * of the UE. With no dp_bits and shard_bits, the low 24 bits are those of
+ * the S11 SGW GTP-C TEID of the UE.
+ */
+struct teid_layout {
+	uint8_t dp_bits;
+	uint8_t shard_bits;
+	uint8_t dp;             /** DP instance of the sessions of this CP,
+				 * with MULTI_DP of DP 0 of the DP pool,
+				 * DP i being instance dp + i */
+	uint32_t dp_workers;    /** workers of the DP, 0 for no shard */
+};
+
+extern struct teid_layout teid_layout;
+
+/**
+ * Sets teid_layout from a "dp_bits:shard_bits:dp:dp_workers" c-string.
+ * Panics if the layout leaves less than ue_pool_size UE ids.
+ * @param str
+ *   teid layout c-string from command line
+ */
+void
+set_teid_layout(const char *str);
+
+/** Max number of --mirror_imsi */
+#define MIRROR_IMSI_MAX 16
+
+/**
+ * Adds an IMSI whose bearers the DP mirrors, if built with PKT_MIRROR.
+ * @param str
+ *   IMSI digits c-string from command line
+ */
+void
+add_mirror_imsi(const char *str);
+
 /**
  * sets the s1u_sgw gtpu teid given the bearer
  * @param bearer
@@ -187,6 +263,101 @@ set_s5s8_pgw_gtpc_teid(pdn_connection *pdn);
 void
 create_ue_hash(void);
 
+#ifdef CP_WORKERS
+/**
+ * Initializes the UE hash tables and GTPv2c TEIDs of the shard of calling
+ * CP worker. The TEIDs of shard i of n are i, i + n, i + 2n ... above
+ * their base.
+ * @param shard
+ *   shard of calling worker
+ * @param nb_shards
+ *   number of shards
+ */
+void
+ue_shard_init(unsigned shard, unsigned nb_shards);
+#endif
+
+
+/** Default of ue_pool_size */
+#define UE_POOL_SIZE_DEFAULT         (1024 * 64)
+
+/** UEs the UE context, PDN connection and bearer pools are sized for */
+extern uint32_t ue_pool_size;
+
+#ifdef CP_OBJ_POOL
+/** PDN connections per UE in the pool */
+#define UE_POOL_PDNS_PER_UE          (1)
+/** EPS bearers per UE in the pool, default and one dedicated */
+#define UE_POOL_BEARERS_PER_UE       (2)
+/** Objects cached by each lcore */
+#define UE_POOL_CACHE_SIZE           (256)
+
+/**
+ * Creates the UE context, PDN connection and bearer pools, sized from
+ * ue_pool_size.
+ */
+void
+create_ue_pools(void);
+#endif
+
+/**
+ * Allocates a zeroed UE context, from its pool with CP_OBJ_POOL. With
+ * MULTI_DP create_ue_context() places the UE on the least loaded DP.
+ * @return
+ *   UE context, NULL if none left
+ */
+ue_context *
+ue_context_alloc(void);
+
+/**
+ * Frees a UE context of ue_context_alloc().
+ * @param context
+ *   UE context, may be NULL
+ */
+void
+ue_context_free(ue_context *context);
+
+/**
+ * Releases the DP of a UE context, with MULTI_DP, once all its sessions
+ * are deleted. Its next session places the UE again.
+ * @param context
+ *   UE context
+ */
+void
+ue_context_dp_release(ue_context *context);
+
+/**
+ * Allocates a zeroed PDN connection, from its pool with CP_OBJ_POOL.
+ * @return
+ *   PDN connection, NULL if none left
+ */
+pdn_connection *
+pdn_alloc(void);
+
+/**
+ * Frees a PDN connection of pdn_alloc(), and releases its UE IP address.
+ * @param pdn
+ *   PDN connection, may be NULL
+ */
+void
+pdn_free(pdn_connection *pdn);
+
+/**
+ * Allocates a zeroed EPS bearer, from its pool with CP_OBJ_POOL.
+ * @return
+ *   EPS bearer, NULL if none left
+ */
+eps_bearer *
+eps_bearer_alloc(void);
+
+/**
+ * Frees an EPS bearer of eps_bearer_alloc().
+ * @param bearer
+ *   EPS bearer, may be NULL
+ */
+void
+eps_bearer_free(eps_bearer *bearer);
+
 
 /** creates an UE Context (if needed), and pdn connection with a default bearer
  * given the UE IMSI, and EBI
@@ -252,7 +423,18 @@ get_apn(char *apn_label, uint16_t apn_length);
 
 
 /**
- * Simple ip-pool
+ * Creates the UE IP pool of the APN from the ip_pool_ip and ip_pool_mask
+ * arguments. The pool holds every host address of the subnet, up to
+ * LDB_ENTRIES_DEFAULT - 1.
+ */
+void
+create_ip_pools(void);
+
+/**
+ * Takes a UE IP address from the pool of an APN, in O(1). Addresses are
+ * reused in the order they are released.
+ * @param an_apn
+ *   APN of the PDN connection
  * @param ipv4
  *   ip address to be used for a new UE connection
  * @return
@@ -261,7 +443,26 @@ get_apn(char *apn_label, uint16_t apn_length);
  *          3gpp specified cause error value
  */
 uint32_t
-acquire_ip(struct in_addr *ipv4);
+acquire_ip(apn *an_apn, struct in_addr *ipv4);
+
+/**
+ * Returns a UE IP address of acquire_ip() to its pool.
+ * @param pool
+ *   pool of the address
+ * @param ipv4
+ *   ip address
+ */
+void
+release_ip(struct ip_pool *pool, struct in_addr ipv4);
+
+/**
+ * Returns the UE IP address of a PDN connection to its pool, if it was
+ * taken from one, see pdn_connection_t.ip_pool.
+ * @param pdn
+ *   PDN connection
+ */
+void
+release_pdn_ip(pdn_connection *pdn);
 
 /* debug */
 
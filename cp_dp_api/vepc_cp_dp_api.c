@@ -28,6 +28,8 @@
 #include <rte_jhash.h>
 #include <rte_cfgfile.h>
 #include <rte_byteorder.h>
+#include <rte_lcore.h>
+#include <rte_cycles.h>
 
 #include "nb.h"
 #include "interface.h"
@@ -36,6 +38,9 @@
 #include "acl.h"
 #include "meter.h"
 #include "vepc_cp_dp_api.h"
+#ifdef CP_BUILD
+#include "cp_telemetry.h"
+#endif
 
 /******************** IPC msgs **********************/
 #ifdef CP_BUILD
@@ -72,6 +77,10 @@ build_dp_msg(enum dp_msg_type mtype, struct dp_id dp_id,
 		msg_payload->msg_union.ue_cdr =
 				*(struct msg_ue_cdr *)param;
 		break;
+	case MSG_EXP_CDR_BULK:
+		msg_payload->msg_union.ue_cdr_bulk =
+				*(struct msg_ue_cdr_bulk *)param;
+		break;
 	case MSG_SDF_DES:
 	case MSG_ADC_TBL_DES:
 	case MSG_PCC_TBL_DES:
@@ -104,14 +113,245 @@ build_dp_msg(enum dp_msg_type mtype, struct dp_id dp_id,
 		msg_payload->msg_union.mtr_entry =
 				*(struct mtr_entry *)param;
 		break;
+	case MSG_SESS_BULK_CRE:
+	case MSG_SESS_BULK_MOD:
+	case MSG_SESS_BULK_DEL:
+		/* sessions are copied in place by session_bulk() */
+		break;
+	case MSG_SDF_BULK_ADD:
+	case MSG_ADC_BULK_ADD:
+		/* rules are copied in place by rule_bulk() */
+		break;
 	default:
 		RTE_LOG(ERR, API, "build_dp_msg: Invalid msg type\n");
 		return -1;
 	}
 	return 0;
 }
+
+#define MSG_UNION_LEN(member) \
+	(MSGBUF_HDR_LEN + sizeof(((struct msgbuf *)0)->msg_union.member))
+
+uint32_t
+dp_msg_len(struct msgbuf *msg_payload)
+{
+	switch (msg_payload->mtype) {
+	case MSG_SDF_CRE:
+	case MSG_ADC_TBL_CRE:
+	case MSG_PCC_TBL_CRE:
+	case MSG_SESS_TBL_CRE:
+	case MSG_MTR_CRE:
+	case MSG_SDF_DES:
+	case MSG_ADC_TBL_DES:
+	case MSG_PCC_TBL_DES:
+	case MSG_SESS_TBL_DES:
+	case MSG_MTR_DES:
+		return MSG_UNION_LEN(msg_table);
+	case MSG_EXP_CDR:
+		return MSG_UNION_LEN(ue_cdr);
+	case MSG_EXP_CDR_BULK:
+		return MSGBUF_HDR_LEN +
+			offsetof(struct msg_ue_cdr_bulk, range) +
+			msg_payload->msg_union.ue_cdr_bulk.n *
+			sizeof(struct sess_id_range);
+	case MSG_SDF_ADD:
+	case MSG_SDF_DEL:
+		return MSG_UNION_LEN(pkt_filter_entry);
+	case MSG_ADC_TBL_ADD:
+	case MSG_ADC_TBL_DEL:
+		return MSG_UNION_LEN(adc_filter_entry);
+	case MSG_PCC_TBL_ADD:
+	case MSG_PCC_TBL_DEL:
+		return MSG_UNION_LEN(pcc_entry);
+	case MSG_SESS_CRE:
+	case MSG_SESS_MOD:
+	case MSG_SESS_DEL:
+		return MSG_UNION_LEN(sess_entry);
+	case MSG_MTR_ADD:
+	case MSG_MTR_DEL:
+		return MSG_UNION_LEN(mtr_entry);
+	case MSG_SESS_BULK_CRE:
+	case MSG_SESS_BULK_MOD:
+	case MSG_SESS_BULK_DEL:
+		return MSGBUF_HDR_LEN + offsetof(struct msg_sess_bulk, sess) +
+			msg_payload->msg_union.sess_bulk.n *
+			sizeof(struct session_info);
+	case MSG_SDF_BULK_ADD:
+		return MSGBUF_HDR_LEN + offsetof(struct msg_rule_bulk, u) +
+			msg_payload->msg_union.rule_bulk.n *
+			sizeof(struct pkt_filter);
+	case MSG_ADC_BULK_ADD:
+		return MSGBUF_HDR_LEN + offsetof(struct msg_rule_bulk, u) +
+			msg_payload->msg_union.rule_bulk.n *
+			sizeof(struct adc_rules);
+#ifdef CP_DP_COALESCE
+	case MSG_FRAME:
+		return CP_DP_FRAME_HDR_LEN + msg_payload->msg_union.frame.len;
+#endif
+	default:
+		return sizeof(struct msgbuf);
+	}
+}
+/**
+ * Send a buffer to a DP.
+ * @param dp
+ *	dp - index of the DP.
+ * @param buf
+ *	buf - msg or frame.
+ * @param len
+ *	len - length in bytes.
+ * @return
+ *	0 - success
+ *	-1 - fail
+ */
+static int
+send_dp_buf(uint8_t dp, void *buf, uint32_t len)
+{
+#ifdef MULTI_DP
+	return udp_send_dp(dp, buf, len);
+#else
+	RTE_SET_USED(dp);
+	if (active_comm_msg->send(buf, len) < 0) {
+		perror("msgsnd");
+		return -1;
+	}
+	return 0;
+#endif
+}
+
+#ifdef CP_DP_COALESCE
+#ifdef MULTI_DP
+#define NB_DP_FRAMES	nb_dp
+#else
+#define NB_DP_FRAMES	1
+#endif
+
+/**
+ * Frame being filled for a DP by an lcore.
+ */
+struct dp_frame {
+	uint64_t first_tsc;	/* tsc of its first msg */
+	uint32_t len;		/* bytes used of buf */
+	struct msgbuf buf;
+};
+
+/* Frames of the calling lcore, one per DP, allocated on first use */
+static RTE_DEFINE_PER_LCORE(struct dp_frame *, dp_frames);
+static uint64_t dp_flush_cycles;
+
+/**
+ * Get the frame of the calling lcore for a DP.
+ */
+static struct dp_frame *
+dp_frame_get(uint8_t dp)
+{
+	struct dp_frame *f = RTE_PER_LCORE(dp_frames);
+	uint8_t i;
+
+	if (likely(f != NULL))
+		return &f[dp];
+
+	f = rte_zmalloc_socket("dp_frames", sizeof(*f) * NB_DP_FRAMES,
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (f == NULL) {
+		fprintf(stderr, "lcore %u: Failed to allocate CP DP frames\n",
+				rte_lcore_id());
+		return NULL;
+	}
+	for (i = 0; i < NB_DP_FRAMES; i++) {
+		f[i].buf.mtype = MSG_FRAME;
+		f[i].buf.dp_id.id = DPN_ID + i;
+		f[i].len = CP_DP_FRAME_HDR_LEN;
+	}
+	dp_flush_cycles = rte_get_tsc_hz() * CP_DP_FLUSH_US / 1000000;
+	RTE_PER_LCORE(dp_frames) = f;
+	return &f[dp];
+}
+
+/**
+ * Send the msgs queued in a frame.
+ */
+static int
+dp_frame_flush(uint8_t dp, struct dp_frame *f)
+{
+	int ret;
+
+	if (f->buf.msg_union.frame.n == 0)
+		return 0;
+
+	f->buf.msg_union.frame.len = f->len - CP_DP_FRAME_HDR_LEN;
+	ret = send_dp_buf(dp, &f->buf, f->len);
+	f->buf.msg_union.frame.n = 0;
+	f->len = CP_DP_FRAME_HDR_LEN;
+	return ret;
+}
+
 /**
- * Send message to DP.
+ * Queue a msg in the frame of the calling lcore for a DP. The frame is
+ * sent when the msg does not fit, or when its first msg waited
+ * CP_DP_FLUSH_US. A msg larger than a frame is sent alone.
+ */
+static int
+dp_frame_add(uint8_t dp, struct msgbuf *msg_payload)
+{
+	struct dp_frame *f = dp_frame_get(dp);
+	uint32_t len = dp_msg_len(msg_payload) - MSGBUF_HDR_LEN;
+	struct msg_frame_rec *rec;
+	uint64_t now;
+	int ret = 0;
+
+	if (f == NULL || CP_DP_FRAME_HDR_LEN + sizeof(*rec) + len >
+			CP_DP_FRAME_SIZE)
+		return send_dp_buf(dp, msg_payload, dp_msg_len(msg_payload));
+
+	if (f->len + sizeof(*rec) + len > CP_DP_FRAME_SIZE)
+		ret = dp_frame_flush(dp, f);
+
+	now = rte_rdtsc();
+	if (f->buf.msg_union.frame.n == 0)
+		f->first_tsc = now;
+
+	rec = (struct msg_frame_rec *)((uint8_t *)&f->buf + f->len);
+	rec->len = len;
+	rec->mtype = msg_payload->mtype;
+	memcpy(rec + 1, &msg_payload->msg_union, len);
+	f->len += sizeof(*rec) + len;
+	f->buf.msg_union.frame.n++;
+
+	if (now - f->first_tsc >= dp_flush_cycles)
+		ret |= dp_frame_flush(dp, f);
+	return ret;
+}
+
+void
+cp_dp_flush(void)
+{
+	struct dp_frame *f = RTE_PER_LCORE(dp_frames);
+	uint8_t dp;
+
+	if (f == NULL)
+		return;
+	for (dp = 0; dp < NB_DP_FRAMES; dp++)
+		dp_frame_flush(dp, &f[dp]);
+}
+#endif /* CP_DP_COALESCE */
+
+/**
+ * Send a msg to a DP, or queue it in the frame of the DP with
+ * CP_DP_COALESCE.
+ */
+static int
+send_dp_one(uint8_t dp, struct msgbuf *msg_payload)
+{
+#ifdef CP_DP_COALESCE
+	return dp_frame_add(dp, msg_payload);
+#else
+	return send_dp_buf(dp, msg_payload, dp_msg_len(msg_payload));
+#endif
+}
+
+/**
+ * Send message to the DP, or DPs, of its dp_id.
  * @param dp_id
  *	dp_id - identifier which is unique across DataPlanes.
  * @param  msg_payload
@@ -121,14 +361,65 @@ build_dp_msg(enum dp_msg_type mtype, struct dp_id dp_id,
  *	-1 - fail
  */
 static int
-send_dp_msg(struct dp_id dp_id, struct msgbuf *msg_payload)
+send_dp_route(struct dp_id dp_id, struct msgbuf *msg_payload)
 {
-	RTE_SET_USED(dp_id);
-	if (active_comm_msg->send((void *)msg_payload, sizeof(struct msgbuf)) < 0) {
-		perror("msgsnd");
-		return -1;
+#ifdef MULTI_DP
+	uint8_t dp;
+	int ret = 0;
+
+	/* Sessions, and so their CDRs, live on the DP of their UE, dp_id.id
+	 * is DPN_ID plus its index. Every DP gets the tables and rules. */
+	switch (msg_payload->mtype) {
+	case MSG_SESS_CRE:
+	case MSG_SESS_MOD:
+	case MSG_SESS_DEL:
+	case MSG_SESS_BULK_CRE:
+	case MSG_SESS_BULK_MOD:
+	case MSG_SESS_BULK_DEL:
+	case MSG_EXP_CDR:
+	case MSG_EXP_CDR_BULK:
+		if (dp_id.id - DPN_ID >= nb_dp) {
+			fprintf(stderr, "Session msg to unknown DP %"PRIu64
+					"\n", dp_id.id);
+			return -1;
+		}
+		return send_dp_one(dp_id.id - DPN_ID, msg_payload);
+	default:
+		for (dp = 0; dp < nb_dp; dp++) {
+			if (send_dp_one(dp, msg_payload) < 0)
+				ret = -1;
+		}
+		return ret;
 	}
-	return 0;
+#else
+	RTE_SET_USED(dp_id);
+	return send_dp_one(0, msg_payload);
+#endif
+}
+
+/**
+ * Send message to DP, the time the send takes is accounted as DP send of
+ * the GTPv2c message being processed with CP_MSG_STATS.
+ * @param dp_id
+ *	dp_id - identifier which is unique across DataPlanes.
+ * @param  msg_payload
+ *	msg_payload - message payload to be sent.
+ * @return
+ *	0 - success
+ *	-1 - fail
+ */
+static int
+send_dp_msg(struct dp_id dp_id, struct msgbuf *msg_payload)
+{
+#ifdef CP_MSG_STATS
+	uint64_t start = rte_rdtsc();
+	int ret = send_dp_route(dp_id, msg_payload);
+
+	cp_msg_send_time(CP_TM_DP_SEND, rte_rdtsc() - start);
+	return ret;
+#else
+	return send_dp_route(dp_id, msg_payload);
+#endif
 }
 #endif /* CP_BUILD*/
 /******************** SDF Pkt filter **********************/
@@ -226,6 +517,106 @@ int adc_entry_delete(struct dp_id dp_id, struct adc_rules entry)
 #endif
 }
 
+/**
+ * Add a bulk of SDF filters or ADC rules. Sent to DP MSG_RULE_BULK_MAX
+ * rules per message, added one by one otherwise. The rules are built
+ * once, after the last one.
+ * @param mtype
+ *	mtype - Bulk message type.
+ * @param op
+ *	op - single rule add.
+ * @param size
+ *	size - size of one rule.
+ * @return
+ *	- number of rules on success
+ *	- -1 on failure of any rule
+ */
+static int
+rule_bulk(enum dp_msg_type mtype, int (*op)(struct dp_id, void *),
+		struct dp_id dp_id, void *rules, size_t size,
+		uint32_t n, int *status)
+{
+	uint32_t i;
+	int ret = n;
+#ifdef CP_BUILD
+	struct msg_rule_bulk *bulk;
+	struct msgbuf msg_payload;
+	uint32_t j, m;
+	int rc;
+
+	RTE_SET_USED(op);
+	build_dp_msg(mtype, dp_id, NULL, &msg_payload);
+	bulk = &msg_payload.msg_union.rule_bulk;
+	for (i = 0; i < n; i += m) {
+		m = RTE_MIN(n - i, (uint32_t)MSG_RULE_BULK_MAX);
+		memcpy(&bulk->u, (uint8_t *)rules + i * size, m * size);
+		bulk->n = m;
+		bulk->more = (i + m < n);
+		rc = send_dp_msg(dp_id, &msg_payload);
+		if (rc < 0)
+			ret = -1;
+		if (status != NULL)
+			for (j = 0; j < m; j++)
+				status[i + j] = rc;
+	}
+#else
+	RTE_SET_USED(mtype);
+	acl_rules_batch_begin();
+	for (i = 0; i < n; i++) {
+		int rc = op(dp_id, (uint8_t *)rules + i * size);
+
+		if (rc < 0)
+			ret = -1;
+		if (status != NULL)
+			status[i] = rc;
+	}
+	acl_rules_batch_end();
+#endif
+	return ret;
+}
+
+#ifdef CP_BUILD
+static int
+sdf_filter_add_op(struct dp_id dp_id, void *rule)
+{
+	return sdf_filter_entry_add(dp_id, *(struct pkt_filter *)rule);
+}
+
+static int
+adc_add_op(struct dp_id dp_id, void *rule)
+{
+	return adc_entry_add(dp_id, *(struct adc_rules *)rule);
+}
+#else
+static int
+sdf_filter_add_op(struct dp_id dp_id, void *rule)
+{
+	return dp_sdf_filter_entry_add(dp_id, rule);
+}
+
+static int
+adc_add_op(struct dp_id dp_id, void *rule)
+{
+	return dp_adc_entry_add(dp_id, rule);
+}
+#endif	/* CP_BUILD */
+
+int
+sdf_filter_entry_add_bulk(struct dp_id dp_id,
+		struct pkt_filter *pkt_filter_entry, uint32_t n, int *status)
+{
+	return rule_bulk(MSG_SDF_BULK_ADD, sdf_filter_add_op, dp_id,
+			pkt_filter_entry, sizeof(*pkt_filter_entry), n, status);
+}
+
+int
+adc_entry_add_bulk(struct dp_id dp_id, struct adc_rules *entry,
+		uint32_t n, int *status)
+{
+	return rule_bulk(MSG_ADC_BULK_ADD, adc_add_op, dp_id,
+			entry, sizeof(*entry), n, status);
+}
+
 /******************** PCC Rule Table **********************/
 int
 pcc_table_create(struct dp_id dp_id, uint32_t max_elements)
@@ -371,6 +762,106 @@ session_delete(struct dp_id dp_id,
 #endif		/* CP_BUILD */
 }
 
+/**
+ * Apply a bulk session operation. Sent to DP MSG_SESS_BULK_MAX sessions
+ * per message, applied one by one otherwise.
+ * @param mtype
+ *	mtype - Bulk message type.
+ * @param op
+ *	op - single session operation.
+ * @return
+ *	- number of sessions on success
+ *	- -1 on failure of any session
+ */
+static int
+session_bulk(enum dp_msg_type mtype,
+		int (*op)(struct dp_id, struct session_info *),
+		struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status)
+{
+	uint32_t i;
+	int ret = n;
+#if defined(CP_BUILD) && !defined(SDN_ODL_BUILD)
+	struct msgbuf msg_payload;
+	uint32_t j, m;
+	int rc;
+
+	RTE_SET_USED(op);
+	build_dp_msg(mtype, dp_id, NULL, &msg_payload);
+	for (i = 0; i < n; i += m) {
+		m = RTE_MIN(n - i, (uint32_t)MSG_SESS_BULK_MAX);
+		memcpy(msg_payload.msg_union.sess_bulk.sess, &sess[i],
+				m * sizeof(struct session_info));
+		msg_payload.msg_union.sess_bulk.n = m;
+		rc = send_dp_msg(dp_id, &msg_payload);
+		if (rc < 0)
+			ret = -1;
+		if (status != NULL)
+			for (j = 0; j < m; j++)
+				status[i + j] = rc;
+	}
+#else
+	RTE_SET_USED(mtype);
+	for (i = 0; i < n; i++) {
+		int rc = op(dp_id, &sess[i]);
+
+		if (rc < 0)
+			ret = -1;
+		if (status != NULL)
+			status[i] = rc;
+	}
+#endif
+	return ret;
+}
+
+#ifdef CP_BUILD
+static int
+session_create_op(struct dp_id dp_id, struct session_info *sess)
+{
+	return session_create(dp_id, *sess);
+}
+
+static int
+session_modify_op(struct dp_id dp_id, struct session_info *sess)
+{
+	return session_modify(dp_id, *sess);
+}
+
+static int
+session_delete_op(struct dp_id dp_id, struct session_info *sess)
+{
+	return session_delete(dp_id, *sess);
+}
+#else
+#define session_create_op dp_session_create
+#define session_modify_op dp_session_modify
+#define session_delete_op dp_session_delete
+#endif	/* CP_BUILD */
+
+int
+session_create_bulk(struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status)
+{
+	return session_bulk(MSG_SESS_BULK_CRE, session_create_op, dp_id,
+			sess, n, status);
+}
+
+int
+session_modify_bulk(struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status)
+{
+	return session_bulk(MSG_SESS_BULK_MOD, session_modify_op, dp_id,
+			sess, n, status);
+}
+
+int
+session_delete_bulk(struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status)
+{
+	return session_bulk(MSG_SESS_BULK_DEL, session_delete_op, dp_id,
+			sess, n, status);
+}
+
 /******************** Meter Table **********************/
 int
 meter_profile_table_create(struct dp_id dp_id, uint32_t max_elements)
@@ -431,3 +922,20 @@ ue_cdr_flush(struct dp_id dp_id, struct msg_ue_cdr ue_cdr)
     return dp_ue_cdr_flush(dp_id, &ue_cdr);
 #endif
 }
+
+int
+ue_cdr_flush_bulk(struct dp_id dp_id, struct msg_ue_cdr_bulk *ue_cdr)
+{
+	if (ue_cdr->n > MSG_UE_CDR_BULK_MAX) {
+		RTE_LOG(ERR, API, "ue_cdr_flush_bulk: %u ranges, max %u\n",
+				ue_cdr->n, MSG_UE_CDR_BULK_MAX);
+		return -1;
+	}
+#ifdef CP_BUILD
+	struct msgbuf msg_payload;
+	build_dp_msg(MSG_EXP_CDR_BULK, dp_id, (void *)ue_cdr, &msg_payload);
+	return send_dp_msg(dp_id, &msg_payload);
+#else
+	return dp_ue_cdr_flush_bulk(dp_id, ue_cdr);
+#endif
+}
@@ -265,7 +265,11 @@ struct mtr_params {
 	uint64_t cbs;
 	/* Excess Burst Size (EBS).  Measured in bytes.*/
 	uint64_t ebs;
-	/* TODO: add TRTCM params */
+	/* Peak Information Rate (PIR), trTCM only. Measured in bytes per
+	 * second, 0 to police at CIR.*/
+	uint64_t pir;
+	/* Peak Burst Size (PBS), trTCM only.  Measured in bytes.*/
+	uint64_t pbs;
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
 /**
@@ -415,9 +419,21 @@ struct session_info {
 									 */
 	uint32_t ul_apn_mtr_idx;		/* UL APN meter profile index*/
 	uint32_t dl_apn_mtr_idx;		/* DL APN meter profile index*/
+	uint8_t mirror;				/* mirror the bearer pkts, DP
+						 * built with PKT_MIRROR*/
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
 
+/**
+ * Max number of sessions carried by one bulk session message.
+ */
+#define MSG_SESS_BULK_MAX 8
+
+/**
+ * Max number of SDF filters or ADC rules carried by one bulk rule message.
+ */
+#define MSG_RULE_BULK_MAX 8
+
 /**
  * DataPlane identifier information structure.
  */
@@ -450,6 +466,32 @@ struct msg_ue_cdr {
 							 * write new logs into cdr log file.*/
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
+/**
+ * Max number of session id ranges carried by one bulk CDR flush message.
+ */
+#define MSG_UE_CDR_BULK_MAX 16
+
+/**
+ * Range of session ids, both ends included.
+ */
+struct sess_id_range {
+    uint64_t first;         /* first session id of the range*/
+    uint64_t last;          /* last session id of the range*/
+} __attribute__((packed));
+
+/**
+ * Structure to flush the UE CDRs of all sessions in a set of
+ * session id ranges.
+ */
+struct msg_ue_cdr_bulk {
+    enum cdr_type type;     /* type of cdrs to flush, same as
+							 * struct msg_ue_cdr*/
+    uint8_t action;         /* 0 to append and 1 to clear old logs and
+							 * write new logs into cdr log file.*/
+    uint32_t n;             /* number of ranges*/
+    struct sess_id_range range[MSG_UE_CDR_BULK_MAX];
+} __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
+
 /********************* SDF Pkt filter table ****************/
 /**
  * @brief Function to create Service Data Flow (SDF) filter
@@ -516,6 +558,30 @@ sdf_filter_entry_add(struct dp_id dp_id, struct pkt_filter pkt_filter_entry);
 int
 sdf_filter_entry_delete(struct dp_id dp_id, struct pkt_filter pkt_filter_entry);
 
+/**
+ * @brief Add n SDF filter entries.
+ *	Same as sdf_filter_entry_add() for each entry, sent to DP
+ *	MSG_RULE_BULK_MAX filters per message. DP builds the filters of
+ *	one call once.
+ *
+ * @param dp_id
+ *	table identifier.
+ * @param  pkt_filter_entry
+ *	Array of n sdf packet filter entry structure
+ * @param  n
+ *	Number of filters
+ * @param  status
+ *	Per filter result, 0 or -1, may be NULL. When sent to DP it is
+ *	the result of sending the message carrying the filter.
+ *
+ * @return
+ *	- number of filters on success
+ *	- -1 on failure of any filter
+ */
+int
+sdf_filter_entry_add_bulk(struct dp_id dp_id,
+		struct pkt_filter *pkt_filter_entry, uint32_t n, int *status);
+
 /********************* ADC Rule Table ****************/
 /**
  * @brief Function to create Application Detection and
@@ -572,6 +638,27 @@ int adc_entry_add(struct dp_id dp_id, struct adc_rules entry);
  *	- -1 on failure
  */
 int adc_entry_delete(struct dp_id dp_id, struct adc_rules entry);
+/**
+ * @brief Add n entries in ADC table.
+ *	Same as adc_entry_add() for each entry, sent to DP
+ *	MSG_RULE_BULK_MAX rules per message. DP builds the rules of one
+ *	call once.
+ * @param dp_id
+ *	table identifier.
+ * @param entry
+ *	Array of n elements to be added in this table.
+ * @param n
+ *	Number of elements
+ * @param status
+ *	Per element result, 0 or -1, may be NULL. When sent to DP it is
+ *	the result of sending the message carrying the element.
+ *
+ * @return
+ *	- number of elements on success
+ *	- -1 on failure of any element
+ */
+int adc_entry_add_bulk(struct dp_id dp_id, struct adc_rules *entry,
+		uint32_t n, int *status);
 
 /********************* PCC Table ****************/
 /**
@@ -717,6 +804,68 @@ session_modify(struct dp_id dp_id, struct session_info session);
 int
 session_delete(struct dp_id dp_id, struct session_info session);
 
+/**
+ * @brief Create n Bearer Sessions.
+ *	Same as session_create() for each entry, sent to DP
+ *	MSG_SESS_BULK_MAX sessions per message.
+ * @param dp_id
+ *	table identifier.
+ * @param  sess
+ *	Array of n Session information
+ * @param  n
+ *	Number of sessions
+ * @param  status
+ *	Per session result, 0 or -1, may be NULL. When sent to DP it is
+ *	the result of sending the message carrying the session.
+ *
+ * @return
+ *	- number of sessions on success
+ *	- -1 on failure of any session
+ */
+int
+session_create_bulk(struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status);
+
+/**
+ * @brief Modify n Bearer Sessions.
+ *	Same as session_modify() for each entry, see session_create_bulk().
+ * @param dp_id
+ *	table identifier.
+ * @param  sess
+ *	Array of n Session information
+ * @param  n
+ *	Number of sessions
+ * @param  status
+ *	Per session result, 0 or -1, may be NULL.
+ *
+ * @return
+ *	- number of sessions on success
+ *	- -1 on failure of any session
+ */
+int
+session_modify_bulk(struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status);
+
+/**
+ * @brief Delete n Bearer Sessions.
+ *	Same as session_delete() for each entry, see session_create_bulk().
+ * @param dp_id
+ *	table identifier.
+ * @param  sess
+ *	Array of n Session information
+ * @param  n
+ *	Number of sessions
+ * @param  status
+ *	Per session result, 0 or -1, may be NULL.
+ *
+ * @return
+ *	- number of sessions on success
+ *	- -1 on failure of any session
+ */
+int
+session_delete_bulk(struct dp_id dp_id, struct session_info *sess,
+		uint32_t n, int *status);
+
 /********************* Meter Table ****************/
 /**
  * @brief Create Meter profile table.
@@ -803,4 +952,35 @@ meter_profile_entry_delete(struct dp_id dp_id, struct mtr_entry mtr_entry);
 int
 ue_cdr_flush(struct dp_id dp_id, struct msg_ue_cdr ue_cdr);
 
+/**
+ * @brief Function to flush the UE CDRs of all sessions in up to
+ *  MSG_UE_CDR_BULK_MAX session id ranges with one message.
+ *
+ * @param dp_id
+ *  table identifier.
+ * @param ue_cdr
+ *  structure with the cdr_type and action, applied to every
+ *  session found in the ranges, and the session id ranges.
+ *
+ * @return
+ *  - 0 on success
+ *  - -1 on failure
+ */
+int
+ue_cdr_flush_bulk(struct dp_id dp_id, struct msg_ue_cdr_bulk *ue_cdr);
+
+#if defined(CP_BUILD) && defined(CP_DP_COALESCE)
+/**
+ * @brief Function to send the msgs the calling lcore queued for the DPs.
+ *  With CP_DP_COALESCE the msgs to a DP are coalesced in frames, sent
+ *  when full, after CP_DP_FLUSH_US, or by this function. It is called
+ *  once a burst of GTPv2c msgs is processed, before waiting for more.
+ *
+ * @return
+ *  None
+ */
+void
+cp_dp_flush(void);
+#endif
+
 #endif /* _CP_DP_API_H_ */
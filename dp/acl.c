@@ -14,13 +14,20 @@
  * limitations under the License.
  */
 
-#define _GNU_SOURCE     /* Expose declaration of tdestroy() */
-#include <search.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <rte_spinlock.h>
+#include <rte_cycles.h>
 
 #include "cdr.h"
 #include "acl.h"
 #include "main.h"
 #include "interface.h"
+#include "qsbr.h"
+#include "flow_cache.h"
+#include "sess_store.h"
+#include "ipv6.h"
 
 #define acl_log(format, ...)    RTE_LOG(ERR, DP, format, ##__VA_ARGS__)
 
@@ -32,7 +39,24 @@
 
 /* Currently restrict acl context to use single category*/
 #define DEFAULT_MAX_CATEGORIES	1
+#ifdef COMBINED_SDF_ADC_ACL
+/* Categories of the combined SDF and ADC tables, multiple of
+ * RTE_ACL_RESULTS_MULTIPLIER */
+#define COMB_ACL_CATEGORIES	RTE_ACL_RESULTS_MULTIPLIER
+#define COMB_ACL_CAT_SDF	0
+#define COMB_ACL_CAT_ADC	1
+#endif
 #define NB_SOCKETS 8
+/* Quiet time after a rule update before the rules are built, in us.
+ * Bursts of updates within it are built once. */
+#define ACL_BUILD_HOLDOFF_US	1000
+/* Poll interval of the build thread when idle, in us */
+#define ACL_BUILD_POLL_US	1000
+/* Quiet time within a batch of rule updates, in us. The batch is built
+ * once it ended, or if its sender stalled for this long. */
+#define ACL_BUILD_BATCH_HOLDOFF_US	1000000
+/* Rules added to an ACL context per rte_acl_add_rules() */
+#define ACL_ADD_CHUNK	64
 
 #define uint32_t_to_char(ip, a, b, c, d) do {\
 	*a = (unsigned char)((ip) >> 24 & 0xff);\
@@ -284,6 +308,13 @@ struct acl_search {
 	struct rte_mbuf *m_ipv6[MAX_BURST_SZ];
 	uint32_t res_ipv6[MAX_BURST_SZ];
 	int num_ipv6;
+#ifdef UE_IPV6
+	/* burst index of each pkt of either family */
+	uint8_t idx_ipv4[MAX_BURST_SZ];
+	uint8_t idx_ipv6[MAX_BURST_SZ];
+	/* results in burst order of bursts with both families */
+	uint32_t res[MAX_BURST_SZ];
+#endif /* UE_IPV6 */
 };
 
 static struct{
@@ -302,6 +333,12 @@ enum acl_cfg_tbl{
 	ADC_UL_STANDBY,
 	ADC_DL_ACTIVE,
 	ADC_DL_STANDBY,
+#ifdef COMBINED_SDF_ADC_ACL
+	SDF_ADC_UL_ACTIVE,
+	SDF_ADC_UL_STANDBY,
+	SDF_ADC_DL_ACTIVE,
+	SDF_ADC_DL_STANDBY,
+#endif
 	MAX_TBLS,
 };
 enum acl_rules_params{
@@ -310,48 +347,129 @@ enum acl_rules_params{
 	ADC_DL_PARAM,
 	MAX_PARAM,
 };
+/* Tables built from the rules tables */
+enum acl_build_id {
+	SDF_BUILD,
+	ADC_UL_BUILD,
+	ADC_DL_BUILD,
+#ifdef COMBINED_SDF_ADC_ACL
+	SDF_ADC_UL_BUILD,
+	SDF_ADC_DL_BUILD,
+#endif
+	MAX_BUILD,
+};
+/**
+ * Rules of one rules table, kept contiguous in rules[] in no particular
+ * order and indexed by rule id. A rebuild adds them to the ACL context
+ * in chunks.
+ */
 struct acl_rules_table {
 	char name[MAX_LEN];
-	void *root;
-	uint16_t num_entries;
-	uint16_t max_entries;
-	int (*compare)(const void *r1p, const void *r2p);
-	void (*print_entry)(const void *nodep, const VISIT which, const int depth);
-	void (*add_entry)(const void *nodep, const VISIT which, const int depth);
+	/** struct acl4_rule or struct acl6_rule entries of rule_size */
+	uint8_t *rules;
+	uint32_t rule_size;
+	/** rules[] index + 1 of each rule id, 0 if the rule id is unused */
+	uint32_t *slot;
+	uint32_t num_entries;
+	uint32_t max_entries;
+	/** size of rules[], grown once max_entries is exceeded */
+	uint32_t size;
 };
 
+/** Rule at index i of rules table t */
+#define ACL_RULE(t, i)	\
+	((struct rte_acl_rule *)((t)->rules + (size_t)(i) * (t)->rule_size))
+
 struct acl_config acl_config[MAX_TBLS];
 struct acl_search acl_search[MAX_PARAM][DP_MAX_LCORE];
-enum acl_cfg_tbl sdf_active_tbl = SDF_ACTIVE;
-enum acl_cfg_tbl adc_ul_active_tbl = ADC_UL_ACTIVE, adc_dl_active_tbl = ADC_DL_ACTIVE;
-enum acl_cfg_tbl config_tbl;
 struct acl_rules_table acl_rules_table[MAX_PARAM];
-
-#ifdef ACL_READ_CFG
-/* to read cfg file. */
-struct rte_acl_rule *acl_base_ipv4, *acl_base_ipv6;
-unsigned int acl_num_ipv4, acl_num_ipv6;
-#endif /* ACL_READ_CFG */
+#ifdef UE_IPV6
+/* IPv6 rules of each rules table, built in the acx_ipv6 contexts */
+struct acl_rules_table acl6_rules_table[MAX_PARAM];
+#endif /* UE_IPV6 */
+
+#ifdef COMBINED_SDF_ADC_ACL
+/* Search params and per category results of combined tables */
+struct acl_comb_search {
+	struct acl_search s;
+	uint32_t res[MAX_BURST_SZ * COMB_ACL_CATEGORIES];
+	uint32_t sdf_res[MAX_BURST_SZ];
+	uint32_t adc_res[MAX_BURST_SZ];
+};
+static struct acl_comb_search acl_comb_search[2][DP_MAX_LCORE];
+#endif
 
 /**
- * Compare entries.
+ * Active/standby state of the tables built from one or more rules tables.
+ * Workers classify on the active table only. The build thread builds the rules in the
+ * standby table, swaps it in and may only reuse the swapped out table
+ * once the workers went through a grace period.
  */
-static int acl_rule_id_compare(const void *r1p, const void *r2p)
-{
-	struct acl4_rule *r1, *r2;
+struct acl_build_state {
+	/** table used by workers */
+	volatile enum acl_cfg_tbl active;
+	/** rule updates not built yet */
+	volatile uint32_t pending;
+	/** set while the build thread builds the table */
+	volatile uint8_t building;
+	/** set when the last build failed, its rules are not applied */
+	volatile uint8_t failed;
+	/** tsc of the last rule update */
+	volatile uint64_t update_tsc;
+	/** cycles taken by the last build */
+	volatile uint64_t build_cycles;
+	/** grace period of the table swapped out by the last build */
+	struct dp_qsbr_token retire;
+	uint8_t retiring;
+	/** ACL categories of the table */
+	uint32_t num_categories;
+	/** rules tables built in the table, and their category mask */
+	uint32_t num_src;
+	struct {
+		enum acl_rules_params p;
+		uint32_t category_mask;
+	} src[2];
+};
 
-	r1 = (struct acl4_rule *) r1p;
-	r2 = (struct acl4_rule *) r2p;
+#define ACL_BUILD(tbl, param) {			\
+	.active = tbl,					\
+	.num_categories = DEFAULT_MAX_CATEGORIES,	\
+	.num_src = 1,					\
+	.src = {{param, -1}},				\
+}
+#define ACL_COMB_BUILD(tbl, adc_param) {		\
+	.active = tbl,					\
+	.num_categories = COMB_ACL_CATEGORIES,		\
+	.num_src = 2,					\
+	.src = {{SDF_PARAM, 1 << COMB_ACL_CAT_SDF},	\
+		{adc_param, 1 << COMB_ACL_CAT_ADC}},	\
+}
 
-	/* compare rule_ids */
-	if (r1->data.userdata < r2->data.userdata)
-		return -1;
-	else if (r1->data.userdata == r2->data.userdata)
-		return 0;
-	else
-		return 1;
+static struct acl_build_state acl_build[MAX_BUILD] = {
+#ifndef COMBINED_SDF_ADC_ACL
+	[SDF_BUILD] = ACL_BUILD(SDF_ACTIVE, SDF_PARAM),
+	[ADC_UL_BUILD] = ACL_BUILD(ADC_UL_ACTIVE, ADC_UL_PARAM),
+	[ADC_DL_BUILD] = ACL_BUILD(ADC_DL_ACTIVE, ADC_DL_PARAM),
+#else
+	/* Only the combined tables are built and used */
+	[SDF_BUILD] = {.active = SDF_ACTIVE},
+	[ADC_UL_BUILD] = {.active = ADC_UL_ACTIVE},
+	[ADC_DL_BUILD] = {.active = ADC_DL_ACTIVE},
+	[SDF_ADC_UL_BUILD] = ACL_COMB_BUILD(SDF_ADC_UL_ACTIVE, ADC_UL_PARAM),
+	[SDF_ADC_DL_BUILD] = ACL_COMB_BUILD(SDF_ADC_DL_ACTIVE, ADC_DL_PARAM),
+#endif
+};
+/* Protects rules tables and pending counts, shared by the iface core and
+ * the build thread. */
+static rte_spinlock_t acl_rules_lock = RTE_SPINLOCK_INITIALIZER;
+/* Set while a batch of rule updates is added, see acl_rules_batch_begin() */
+static volatile uint8_t acl_rules_batch;
 
-}
+#ifdef ACL_READ_CFG
+/* to read cfg file. */
+struct rte_acl_rule *acl_base_ipv4, *acl_base_ipv6;
+unsigned int acl_num_ipv4, acl_num_ipv6;
+#endif /* ACL_READ_CFG */
 
 static inline void print_one_ipv4_rule(struct acl4_rule *rule, int extra)
 {
@@ -376,31 +494,7 @@ static inline void print_one_ipv4_rule(struct acl4_rule *rule, int extra)
 				rule->data.priority,
 				rule->data.userdata & ~ACL_DENY_SIGNATURE);
 }
-/**
- * Print the Rule entry.
- */
-static void acl_rule_print(const void *nodep, const VISIT which, const int depth)
-{
-	struct acl4_rule *r;
-	uint32_t rule_id;
-#pragma GCC diagnostic push  /* require GCC 4.6 */
-#pragma GCC diagnostic ignored "-Wcast-qual"
-	r = *(struct acl4_rule **) nodep;
-#pragma GCC diagnostic pop   /* require GCC 4.6 */
-	rule_id = r->data.userdata - ACL_DENY_SIGNATURE;
-	switch (which) {
-	case leaf:
-	case postorder:
-		printf("Depth: %d, Rule ID: %d,",
-				depth, rule_id);
-		printf("Prio: %x, Category mask: %x\n",
-				r->data.priority, r->data.category_mask);
-		print_one_ipv4_rule(r, 1);
-		break;
-	default:
-		break;
-	}
-}
+static inline void print_one_ipv6_rule(struct acl6_rule *rule, int extra);
 
 /**
  * Dump the table entries.
@@ -412,93 +506,104 @@ static void acl_rule_print(const void *nodep, const VISIT which, const int depth
  */
 void acl_table_dump(struct acl_rules_table *t)
 {
-	twalk(t->root, t->print_entry);
-}
+	struct rte_acl_rule *r;
+	uint32_t i;
 
-/**
- * Print the Rule entry in rte acl table.
- */
-static void add_single_rule(const void *nodep, const VISIT which, const int depth)
-{
-	struct acl4_rule *r;
-	uint32_t rule_id;
-	/*
-	 * Check numa socket enable or disable based on
-	 * get or set socketid.
-	 */
-	int socketid = app.numa_on?rte_socket_id():0;
-
-	struct acl_config *pacl_config = &acl_config[config_tbl];
-	struct rte_acl_ctx *context = pacl_config->acx_ipv4[socketid];
-#pragma GCC diagnostic push  /* require GCC 4.6 */
-#pragma GCC diagnostic ignored "-Wcast-qual"
-	r = *(struct acl4_rule **) nodep;
-#pragma GCC diagnostic pop   /* require GCC 4.6 */
-	rule_id = r->data.userdata - ACL_DENY_SIGNATURE;
-	switch (which) {
-	case leaf:
-	case postorder:
-		rte_acl_add_rules(context, (struct rte_acl_rule *)r, 1);
-		break;
-	default:
-		break;
+	for (i = 0; i < t->num_entries; i++) {
+		r = ACL_RULE(t, i);
+		printf("Rule ID: %d, ", r->data.userdata - ACL_DENY_SIGNATURE);
+		printf("Prio: %x, Category mask: %x\n",
+				r->data.priority, r->data.category_mask);
+		if (t->rule_size == sizeof(struct acl6_rule))
+			print_one_ipv6_rule((struct acl6_rule *)r, 1);
+		else
+			print_one_ipv4_rule((struct acl4_rule *)r, 1);
 	}
 }
+
 /**
  * Add rules from local table to rte acl rules table.
- * @param type
- *	table type.
+ * @param t
+ *	rules table.
+ * @param context
+ *	acl context to add the rules to.
+ * @param category_mask
+ *	categories the rules apply to.
  *
  * @return
  *	void
  */
-static void add_rules_to_rte_acl(enum acl_cfg_tbl type)
+static void
+add_rules_to_rte_acl(struct acl_rules_table *t, struct rte_acl_ctx *context,
+		uint32_t category_mask)
 {
-	struct acl_rules_table *t = &acl_rules_table[type/2];
-	config_tbl = type;
-	twalk(t->root, t->add_entry);
+	/* sized for the largest rule */
+	struct acl6_rule chunk[ACL_ADD_CHUNK];
+	uint8_t *c = (uint8_t *)chunk;
+	uint32_t i, j, n;
+
+	for (i = 0; i < t->num_entries; i += n) {
+		n = RTE_MIN(t->num_entries - i, (uint32_t)ACL_ADD_CHUNK);
+		memcpy(c, ACL_RULE(t, i), n * t->rule_size);
+		for (j = 0; j < n; j++)
+			((struct rte_acl_rule *)(c + j * t->rule_size))->
+					data.category_mask = category_mask;
+		if (rte_acl_add_rules(context,
+				(struct rte_acl_rule *)c, n) == 0)
+			continue;
+		/* an invalid rule fails the whole chunk, add its valid
+		 * rules one by one */
+		for (j = 0; j < n; j++)
+			rte_acl_add_rules(context,
+					(struct rte_acl_rule *)(c + j * t->rule_size), 1);
+	}
 }
+
 /**
- * Create ACL table.
+ * Create ACL rules table.
+ * @param t
+ *	rules table.
  * @param type
  *	rules table type.
  * @param max_element
  *	max number of elements in this table.
+ * @param rule_size
+ *	size of the rules of this table.
  *
  * @return
  *	- 0 on success
  *	- -1 on failure
  */
 static int
-dp_acl_rules_table_create(enum acl_rules_params type, uint32_t max_elements)
+acl_rules_table_init(struct acl_rules_table *t, enum acl_rules_params type,
+		uint32_t max_elements, uint32_t rule_size)
 {
-	struct acl_rules_table *t = &acl_rules_table[type];
-	if (t->root != NULL) {
+	if (t->rules != NULL) {
 		RTE_LOG(INFO, DP, "ACL table: \"%s\" exist\n", t->name);
 		return -1;
 	}
 	t->num_entries = 0;
 	t->max_entries = max_elements;
-	sprintf(t->name, "ACL_RULES_TABLE-%d", type);
-	t->compare = acl_rule_id_compare;
-	t->print_entry = acl_rule_print;
-	t->add_entry = add_single_rule;
+	t->rule_size = rule_size;
+	t->size = RTE_MAX(max_elements, 1U);
+	sprintf(t->name, "ACL_RULES_TABLE-%d%s", type,
+			rule_size == sizeof(struct acl6_rule) ? "-v6" : "");
+	t->rules = rte_malloc("acl_rules", (size_t)t->size * rule_size,
+			RTE_CACHE_LINE_SIZE);
+	t->slot = rte_zmalloc("acl_rule_slot",
+			MAX_ACL_RULE_NUM * sizeof(uint32_t), RTE_CACHE_LINE_SIZE);
+	if (t->rules == NULL || t->slot == NULL) {
+		RTE_LOG(ERR, DP, "ACL rules table: \"%s\" failed to allocate "
+				"memory\n", t->name);
+		rte_free(t->rules);
+		rte_free(t->slot);
+		memset(t, 0, sizeof(struct acl_rules_table));
+		return -1;
+	}
 	RTE_LOG(INFO, DP, "ACL rules table: \"%s\" created\n", t->name);
 	return 0;
 }
 
-/**
- * Free the memory allocated for node.
- * @param p
- *	void pointer to be free.
- *
- * @return
- *	None
- */
-static void free_node(void *p)
-{
-	rte_free(p);
-}
 /**
  * Delete Rules table.
  * @param t
@@ -511,18 +616,47 @@ static void free_node(void *p)
 int
 dp_acl_rules_table_delete(struct acl_rules_table *t)
 {
-	tdestroy(&t->root, free_node);
+	rte_free(t->rules);
+	rte_free(t->slot);
 	RTE_LOG(INFO, DP, "ACL Rules table: \"%s\" destroyed\n", t->name);
 	memset(t, 0, sizeof(struct acl_rules_table));
 	return 0;
 }
 
 /**
- * Add rules entry.
+ * Create ACL table, and its IPv6 one with UE_IPV6.
+ * @param type
+ *	rules table type.
+ * @param max_element
+ *	max number of elements in this table.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on failure
+ */
+static int
+dp_acl_rules_table_create(enum acl_rules_params type, uint32_t max_elements)
+{
+	if (acl_rules_table_init(&acl_rules_table[type], type, max_elements,
+			sizeof(struct acl4_rule)) < 0)
+		return -1;
+#ifdef UE_IPV6
+	if (acl_rules_table_init(&acl6_rules_table[type], type, max_elements,
+			sizeof(struct acl6_rule)) < 0) {
+		dp_acl_rules_table_delete(&acl_rules_table[type]);
+		return -1;
+	}
+#endif /* UE_IPV6 */
+	return 0;
+}
+
+/**
+ * Add rules entry. A rule id already in the table keeps its rule, the
+ * ADC IP rules are added for both directions under one rule id.
  * @param t
  *	rules table pointer
  * @param rule
- *	element to be added in this table.
+ *	element to be added in this table, of the table rule size.
  *
  * @return
  *	- 0 on success
@@ -530,54 +664,67 @@ dp_acl_rules_table_delete(struct acl_rules_table *t)
  */
 int
 dp_rules_entry_add(struct acl_rules_table *t,
-				struct acl4_rule *rule)
+				struct rte_acl_rule *rule)
 {
-	if (t->num_entries == t->max_entries)
-		RTE_LOG(INFO, DP, "%s reached max rules entries\n", t->name);
+	uint32_t rule_id = rule->data.userdata - ACL_DENY_SIGNATURE;
+	uint8_t *rules;
 
-	struct acl4_rule *new = rte_malloc("acl_rule", sizeof(struct acl4_rule),
-			RTE_CACHE_LINE_SIZE);
-	if (new == NULL) {
-		RTE_LOG(INFO, DP, "ADC: Failed to allocate memory\n");
+	if (t->rules == NULL || rule_id >= MAX_ACL_RULE_NUM) {
+		RTE_LOG(INFO, DP, "Fail to add acl rule id %u\n", rule_id);
 		return -1;
 	}
-	*new = *rule;
-	/* put node into the tree */
-	if (tsearch(new, &t->root, t->compare) == 0) {
-		RTE_LOG(INFO, DP, "Fail to add acl rule id %d\n",
-				rule->data.userdata - ACL_DENY_SIGNATURE);
-		return -1;
+
+	if (t->slot[rule_id])
+		return 0;
+
+	if (t->num_entries == t->max_entries)
+		RTE_LOG(INFO, DP, "%s reached max rules entries\n", t->name);
+
+	if (t->num_entries == t->size) {
+		rules = rte_realloc(t->rules,
+				2 * (size_t)t->size * t->rule_size,
+				RTE_CACHE_LINE_SIZE);
+		if (rules == NULL) {
+			RTE_LOG(INFO, DP, "ACL: Failed to allocate memory\n");
+			return -1;
+		}
+		t->rules = rules;
+		t->size *= 2;
 	}
 
-	t->num_entries++;
+	memcpy(ACL_RULE(t, t->num_entries++), rule, t->rule_size);
+	t->slot[rule_id] = t->num_entries;
 	return 0;
 }
 
 /**
- * Delete rules entry.
+ * Delete rules entry. The last rule takes its place in rules[].
  * @param t
  *	rules table pointer
- * @param rule
- *	element to be deleted from this table.
+ * @param rule_id
+ *	rule id of the element to be deleted from this table.
  *
  * @return
  *	- 0 on success
  *	- -1 on failure
  */
 int
-dp_rules_entry_delete(struct acl_rules_table *t,
-				struct acl4_rule *rule)
-{
-	void **p;
-	/* delete node from the tree */
-	p = tdelete(rule, &t->root, t->compare);
-	if (p == NULL) {
-		RTE_LOG(INFO, DP, "Fail to delete acl rule id %d\n",
-						rule->data.userdata - ACL_DENY_SIGNATURE);
+dp_rules_entry_delete(struct acl_rules_table *t, uint32_t rule_id)
+{
+	uint32_t idx, last;
+
+	if (t->rules == NULL || rule_id >= MAX_ACL_RULE_NUM
+			|| t->slot[rule_id] == 0)
 		return -1;
+
+	idx = t->slot[rule_id] - 1;
+	last = --t->num_entries;
+	t->slot[rule_id] = 0;
+	if (idx != last) {
+		memcpy(ACL_RULE(t, idx), ACL_RULE(t, last), t->rule_size);
+		t->slot[ACL_RULE(t, idx)->data.userdata - ACL_DENY_SIGNATURE] =
+				idx + 1;
 	}
-	rte_free(*p);
-	t->num_entries--;
 
 	return 0;
 }
@@ -682,6 +829,16 @@ prepare_one_packet_ipv4(struct rte_mbuf **pkts_in, struct acl_search *acl,
 {
 	struct rte_mbuf *pkt = pkts_in[index];
 
+#ifdef UE_IPV6
+	/* each family is classified on its own context */
+	if (mbuf_is_ipv6(pkt)) {
+		acl->data_ipv6[acl->num_ipv6] = MBUF_IPV6_2PROTO(pkt);
+		acl->idx_ipv6[acl->num_ipv6] = index;
+		acl->m_ipv6[(acl->num_ipv6)++] = pkt;
+		return;
+	}
+	acl->idx_ipv4[acl->num_ipv4] = index;
+#endif /* UE_IPV6 */
 	/* Fill acl structure */
 	acl->data_ipv4[acl->num_ipv4] = MBUF_IPV4_2PROTO(pkt);
 	acl->m_ipv4[(acl->num_ipv4)++] = pkt;
@@ -1103,7 +1260,8 @@ static struct rte_acl_ctx *acl_context_init(char *name,
 		rte_exit(EXIT_FAILURE,
 				"Failed to setup classify method for  ACL context\n");
 #ifdef ACL_READ_CFG
-	if (rte_acl_add_rules(context, acl_base_ipv4, acl_num_ipv4) < 0)
+	if (rte_acl_add_rules(context, ipv6 ? acl_base_ipv6 : acl_base_ipv4,
+			ipv6 ? acl_num_ipv6 : acl_num_ipv4) < 0)
 		rte_exit(EXIT_FAILURE, "add rules failed\n");
 	struct rte_acl_config acl_build_param;
 	/* Perform builds */
@@ -1112,8 +1270,12 @@ static struct rte_acl_ctx *acl_context_init(char *name,
 	acl_build_param.num_categories = DEFAULT_MAX_CATEGORIES;
 	acl_build_param.num_fields = dim;
 
-	memcpy(&acl_build_param.defs, ipv4_defs,
-			sizeof(ipv4_defs));
+	if (ipv6)
+		memcpy(&acl_build_param.defs, ipv6_defs,
+				sizeof(ipv6_defs));
+	else
+		memcpy(&acl_build_param.defs, ipv4_defs,
+				sizeof(ipv4_defs));
 	if (rte_acl_build(context, &acl_build_param) != 0)
 		rte_exit(EXIT_FAILURE, "Failed to build ACL trie\n");
 #endif	/*ACL_READ_CFG*/
@@ -1144,6 +1306,9 @@ acl_config_init(struct acl_config *acl_config,
 	unsigned lcore_id;
 	int socketid;
 	unsigned int i;
+#if defined(UE_IPV6) || defined(ACL_READ_CFG)
+	char name6[MAX_LEN];
+#endif
 
 #ifdef ACL_READ_CFG
 	parm_config.rule_ipv4_name = "../config/rules_ipv4.cfg";
@@ -1200,9 +1365,12 @@ acl_config_init(struct acl_config *acl_config,
 			acl_config->acx_ipv4[i] =
 			acl_context_init(name, max_elements, rs, 0, i);
 
-#ifdef ACL_READ_CFG
+#if defined(UE_IPV6) || defined(ACL_READ_CFG)
+			/* a context of the same name would be returned */
+			snprintf(name6, sizeof(name6), "%s-v6", name);
 			acl_config->acx_ipv6[i] =
-			acl_context_init(name, rs, 1, i);
+			acl_context_init(name6, max_elements,
+					sizeof(struct acl6_rule), 1, i);
 #endif
 		}
 	}
@@ -1210,78 +1378,390 @@ acl_config_init(struct acl_config *acl_config,
 }
 
 /**
- * To reset and build ACL table.
- *	This funciton reset the acl context rules,
- *	and add the new rules and build table.
- *	This should be called only for standby tables.
+ * Reset the ACL contexts of a table on every socket.
+ *
+ * @param acl_config
+ *	config base address of this table.
+ *
+ * @return
+ *	None
+ */
+static void
+acl_config_reset(struct acl_config *acl_config)
+{
+	int i;
+
+	for (i = 0; i < NB_SOCKETS; i++) {
+		if (!acl_config->mapped[i])
+			continue;
+		rte_acl_reset(acl_config->acx_ipv4[i]);
+#ifdef UE_IPV6
+		rte_acl_reset(acl_config->acx_ipv6[i]);
+#endif
+	}
+}
+
+/**
+ *	to get standby table id from active table.
  *
  * @param type
- *	table type to reset and build.
+ *	current active table id.
+ *
+ * @return
+ *	standby table id
+ */
+static int
+dp_acl_get_standby(enum acl_cfg_tbl type)
+{
+	return (type % 2)?(type - 1):(type + 1);
+}
+
+/**
+ * To reset and build standby ACL table and swap it in.
+ *	This funciton reset the standby acl context rules on every socket,
+ *	add the current rules and build the tables. Runs on the build
+ *	thread, the workers keep classifying on the active table meanwhile.
+ *
+ * @param b
+ *	build state of the tables to build.
  *
  * @return
  *	- 0 on success
  *	- -1 on failure
  */
 static int
-reset_and_build_rules(enum acl_cfg_tbl type)
+reset_and_build_rules(struct acl_build_state *b)
 {
 	int dim = RTE_DIM(ipv4_defs);
 	struct rte_acl_config acl_build_param;
-	/*
-	 * Check numa socket enable or disable based on
-	 * get or set socketid.
-	 */
-	int socketid = app.numa_on?rte_socket_id():0;
-	struct rte_acl_param acl_param;
-	char name[MAX_LEN];
-	struct acl_config *pacl_config = &acl_config[type];
-	struct rte_acl_ctx *context = pacl_config->acx_ipv4[socketid];
+	enum acl_cfg_tbl standby = dp_acl_get_standby(b->active);
+	struct acl_config *pacl_config = &acl_config[standby];
+	uint64_t start_tsc = rte_rdtsc();
+	uint32_t j;
+	int i;
+#ifdef UE_IPV6
+	struct rte_acl_config acl6_build_param;
+	uint32_t num_ipv6 = 0;
+#endif
 
-	if (socketid < 0) {
-		RTE_LOG(ERR, ACL, "Invalid RTE socket Id: %d. \nExit.\n",
-			socketid);
-		return -1;
+	/* Delete all rules from the ACL contexts and add the current ones.
+	 * building is set under the lock, see acl_build_stop(). */
+	rte_spinlock_lock(&acl_rules_lock);
+	b->building = 1;
+	b->pending = 0;
+	for (i = 0; i < NB_SOCKETS; i++) {
+		if (!pacl_config->mapped[i])
+			continue;
+		rte_acl_reset_rules(pacl_config->acx_ipv4[i]);
+		for (j = 0; j < b->num_src; j++)
+			add_rules_to_rte_acl(&acl_rules_table[b->src[j].p],
+					pacl_config->acx_ipv4[i],
+					b->src[j].category_mask);
+#ifdef UE_IPV6
+		rte_acl_reset_rules(pacl_config->acx_ipv6[i]);
+		for (j = 0; j < b->num_src; j++)
+			add_rules_to_rte_acl(&acl6_rules_table[b->src[j].p],
+					pacl_config->acx_ipv6[i],
+					b->src[j].category_mask);
+#endif
 	}
-
-	sprintf(name, "ACLTable-%d", type);
-	acl_param.name = name;
-	acl_param.socket_id = socketid;
-	acl_param.rule_size = RTE_ACL_RULE_SZ(dim);
-	acl_param.max_rule_num = MAX_ACL_RULE_NUM;
-
-	/* Delete all rules from the ACL context. */
-	rte_acl_reset_rules(context);
-
-	add_rules_to_rte_acl(type);
+#ifdef UE_IPV6
+	for (j = 0; j < b->num_src; j++)
+		num_ipv6 += acl6_rules_table[b->src[j].p].num_entries;
+#endif
+	rte_spinlock_unlock(&acl_rules_lock);
 
 	/* Perform builds */
 	memset(&acl_build_param, 0, sizeof(acl_build_param));
 
-	acl_build_param.num_categories = DEFAULT_MAX_CATEGORIES;
+	acl_build_param.num_categories = b->num_categories;
 	acl_build_param.num_fields = dim;
 
 	memcpy(&acl_build_param.defs, ipv4_defs,
 			sizeof(ipv4_defs));
-	if (rte_acl_build(context, &acl_build_param) != 0)
-		rte_exit(EXIT_FAILURE, "Failed to build ACL trie\n");
+#ifdef UE_IPV6
+	memset(&acl6_build_param, 0, sizeof(acl6_build_param));
 
-	pacl_config->acx_ipv4_built[socketid] = 1;
+	acl6_build_param.num_categories = b->num_categories;
+	acl6_build_param.num_fields = RTE_DIM(ipv6_defs);
 
+	memcpy(&acl6_build_param.defs, ipv6_defs,
+			sizeof(ipv6_defs));
+#endif
+	for (i = 0; i < NB_SOCKETS; i++) {
+		if (!pacl_config->mapped[i])
+			continue;
+		pacl_config->acx_ipv4_built[i] = 0;
+		if (rte_acl_build(pacl_config->acx_ipv4[i],
+					&acl_build_param) != 0) {
+			/* keep classifying on the active table */
+			RTE_LOG(ERR, ACL, "Failed to build ACL trie %d, "
+					"rules not applied\n", standby);
+			b->failed = 1;
+			b->building = 0;
+			return -1;
+		}
+		pacl_config->acx_ipv4_built[i] = 1;
 #ifdef DEBUG_ACL
-	rte_acl_dump(context);
+		rte_acl_dump(pacl_config->acx_ipv4[i]);
+#endif
+#ifdef UE_IPV6
+		/* a context with no rules does not build, its pkts match
+		 * no rule */
+		pacl_config->acx_ipv6_built[i] = 0;
+		if (num_ipv6 == 0)
+			continue;
+		if (rte_acl_build(pacl_config->acx_ipv6[i],
+					&acl6_build_param) != 0) {
+			RTE_LOG(ERR, ACL, "Failed to build IPv6 ACL trie %d, "
+					"rules not applied\n", standby);
+			b->failed = 1;
+			b->building = 0;
+			return -1;
+		}
+		pacl_config->acx_ipv6_built[i] = 1;
+#endif
+	}
+
+	/* Publish the table, the old one is retired after a grace period */
+	rte_smp_wmb();
+	b->active = standby;
+	dp_qsbr_start(&b->retire);
+	b->retiring = 1;
+#ifdef FLOW_CACHE
+	flow_cache_invalidate();
+#endif /* FLOW_CACHE */
+
+	b->build_cycles = rte_rdtsc() - start_tsc;
+	b->failed = 0;
+	b->building = 0;
+
+	RTE_LOG(DEBUG, ACL, "ACL table %d built in %"PRIu64" cycles\n",
+			standby, b->build_cycles);
+	return 0;
+}
+
+/**
+ * ACL build thread. Builds the rules tables updated by the iface core,
+ * once updates stopped for ACL_BUILD_HOLDOFF_US and the standby table is
+ * no longer used by workers.
+ */
+static void *
+acl_build_thread(__rte_unused void *arg)
+{
+	uint64_t holdoff = rte_get_tsc_hz() / 1000000 * ACL_BUILD_HOLDOFF_US;
+	uint64_t batch_holdoff = rte_get_tsc_hz() / 1000000 *
+			ACL_BUILD_BATCH_HOLDOFF_US;
+	struct acl_build_state *b;
+	uint64_t wait;
+	int i;
+
+	while (1) {
+		wait = acl_rules_batch ? batch_holdoff : holdoff;
+		for (i = 0; i < MAX_BUILD; i++) {
+			b = &acl_build[i];
+			if (b->pending == 0)
+				continue;
+			if (b->retiring) {
+				if (!dp_qsbr_elapsed(&b->retire))
+					continue;
+				b->retiring = 0;
+			}
+			if (rte_rdtsc() - b->update_tsc < wait)
+				continue;
+			reset_and_build_rules(b);
+		}
+		usleep(ACL_BUILD_POLL_US);
+	}
+	return NULL;
+}
+
+int
+acl_build_wait(void)
+{
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < MAX_BUILD; i++) {
+		/* pending is cleared only once building is set */
+		while (acl_build[i].pending || acl_build[i].building)
+			usleep(ACL_BUILD_POLL_US);
+		if (acl_build[i].failed)
+			ret = -1;
+	}
+	return ret;
+}
+
+/**
+ * Wait for the build thread to finish the table it builds, so that the
+ * ACL contexts can be reset or created. To be called with acl_rules_lock
+ * held, no build starts until it is released.
+ */
+static void
+acl_build_stop(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_BUILD; i++) {
+		if (!acl_build[i].building)
+			continue;
+		rte_spinlock_unlock(&acl_rules_lock);
+		usleep(ACL_BUILD_POLL_US);
+		rte_spinlock_lock(&acl_rules_lock);
+		/* another table may have started meanwhile */
+		i = -1;
+	}
+}
+
+uint64_t
+acl_build_cycles(void)
+{
+	uint64_t max = 0;
+	int i;
+
+	for (i = 0; i < MAX_BUILD; i++)
+		max = RTE_MAX(max, acl_build[i].build_cycles);
+	return max;
+}
+
+void
+acl_build_cycles_reset(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_BUILD; i++)
+		acl_build[i].build_cycles = 0;
+}
+
+void
+acl_rules_batch_begin(void)
+{
+	acl_rules_batch = 1;
+}
+
+void
+acl_rules_batch_end(void)
+{
+	acl_rules_batch = 0;
+}
+
+/**
+ * Start ACL build thread.
+ */
+static void
+acl_build_thread_start(void)
+{
+	pthread_t t;
+
+	if (pthread_create(&t, NULL, &acl_build_thread, NULL) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot create ACL build thread\n");
+	/* created on the master lcore, keep the builds off the dataplane */
+	epc_ctrl_thread_pin(t, "ACL build");
+}
+
+/**
+ * Mark tables built from the rules table updated, to be built by the
+ * build thread. To be called with acl_rules_lock held.
+ */
+static inline void
+acl_rules_updated(enum acl_rules_params p)
+{
+	uint64_t tsc = rte_rdtsc();
+	uint32_t i, j;
+
+	for (i = 0; i < MAX_BUILD; i++) {
+		for (j = 0; j < acl_build[i].num_src; j++) {
+			if (acl_build[i].src[j].p != p)
+				continue;
+			acl_build[i].update_tsc = tsc;
+			acl_build[i].pending++;
+		}
+	}
+}
+
+/**
+ * Delete rule from rules table.
+ *
+ * @param p
+ *	rules table type.
+ * @param rule_id
+ *	rule id.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on failure
+ */
+static int
+acl_rule_delete(enum acl_rules_params p, uint32_t rule_id)
+{
+	int ret;
+
+	rte_spinlock_lock(&acl_rules_lock);
+	ret = dp_rules_entry_delete(&acl_rules_table[p], rule_id);
+#ifdef UE_IPV6
+	/* the rule id may have a rule of either family, or both */
+	if (dp_rules_entry_delete(&acl6_rules_table[p], rule_id) == 0)
+		ret = 0;
 #endif
+	if (ret == 0)
+		acl_rules_updated(p);
+	rte_spinlock_unlock(&acl_rules_lock);
+	if (ret < 0)
+		RTE_LOG(INFO, DP, "Fail to delete acl rule id %u\n", rule_id);
+	return ret;
+}
+
+#ifdef UE_IPV6
+/**
+ * Check the address family of an acl rule string, IPv6 rules have
+ * ':' in their source address.
+ */
+static inline int
+is_ipv6_rule_str(const char *str)
+{
+	size_t len = strcspn(str, " \t");
+
+	return memchr(str, ':', len) != NULL;
+}
+
+/**
+ * Build the IPv6 rule matching the pkts of an IPv4 rule with wildcard
+ * addresses, for the rule to apply to both families.
+ *
+ * @param r4
+ *	IPv4 rule.
+ * @param r6
+ *	IPv6 rule built.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the IPv4 rule has an address
+ */
+static int
+acl6_rule_from_wildcard(const struct acl4_rule *r4, struct acl6_rule *r6)
+{
+	if (r4->field[SRC_FIELD_IPV4].mask_range.u32 != 0 ||
+			r4->field[DST_FIELD_IPV4].mask_range.u32 != 0)
+		return -1;
+
+	memset(r6, 0, sizeof(*r6));
+	r6->data = r4->data;
+	r6->field[PROTO_FIELD_IPV6] = r4->field[PROTO_FIELD_IPV4];
+	r6->field[SRCP_FIELD_IPV6] = r4->field[SRCP_FIELD_IPV4];
+	r6->field[DSTP_FIELD_IPV6] = r4->field[DSTP_FIELD_IPV4];
 	return 0;
 }
+#endif /* UE_IPV6 */
 
 /**
  *	To add sdf or adc filter in acl table.
- *	The entries are first stored in local memory and then updated on
- *	standby table.
+ *	The entries are stored in local memory and then built on the
+ *	standby table by the build thread.
  *
  * @param name
  *	ACL table name (SDF/ADC), only for debug logs.
- * @param type
- *	table to add entry.
+ * @param p
+ *	rules table to add entry.
  * @param pkt_filter
  *	packet filter which include ruleid, priority and
  *		acl rule string to be added.
@@ -1291,8 +1771,9 @@ reset_and_build_rules(enum acl_cfg_tbl type)
  *	- -1 on failure
  */
 static int
-dp_filter_entry_add(char *name, enum acl_cfg_tbl type, struct pkt_filter *pkt_filter)
+dp_filter_entry_add(char *name, enum acl_rules_params p, struct pkt_filter *pkt_filter)
 {
+	int ret;
 	struct rte_acl_rule *next;
 	uint32_t rule_id;
 
@@ -1314,6 +1795,35 @@ dp_filter_entry_add(char *name, enum acl_cfg_tbl type, struct pkt_filter *pkt_fi
 
 	buf = (char *)&pkt_filter->u.rule_str[0];
 
+#ifdef UE_IPV6
+	struct acl6_rule r6;
+
+	if (is_ipv6_rule_str(buf)) {
+		char tmp[MAX_LEN] = {0};
+
+		/* the parser splits the string, ADC rules reuse it */
+		strncpy(tmp, buf, sizeof(tmp) - 1);
+		next = (struct rte_acl_rule *)&r6;
+		memset(&r6, 0, sizeof(r6));
+		if (parse_cb_ipv6_rule(tmp, next, 0) != 0)
+			rte_exit(EXIT_FAILURE,
+					"%s  parse rules error\n",
+					__func__);
+
+		next->data.userdata = rule_id + ACL_DENY_SIGNATURE;
+		next->data.priority = prio--;
+		next->data.category_mask = -1;
+
+		rte_spinlock_lock(&acl_rules_lock);
+		ret = dp_rules_entry_add(&acl6_rules_table[p], next);
+		if (ret == 0)
+			acl_rules_updated(p);
+		rte_spinlock_unlock(&acl_rules_lock);
+
+		return ret;
+	}
+#endif /* UE_IPV6 */
+
 	struct acl4_rule r;
 	next = (struct rte_acl_rule *)&r;
 	if (parse_cb_ipv4vlan_rule(buf, next, 0) != 0)
@@ -1324,38 +1834,32 @@ dp_filter_entry_add(char *name, enum acl_cfg_tbl type, struct pkt_filter *pkt_fi
 	next->data.userdata = rule_id + ACL_DENY_SIGNATURE;
 	next->data.priority = prio--;
 	next->data.category_mask = -1;
-		if (dp_rules_entry_add(&acl_rules_table[type/2], (struct acl4_rule *)next) < 0)
-			return -1;
 
-	if (reset_and_build_rules(type) < 0)
-		return -1;
-
-	return 0;
-}
-/**
- *	to get standby table id from active table.
- *
- * @param type
- *	current active table id.
- *
- * @return
- *	standby table id
- */
-static int
-dp_acl_get_standby(enum acl_cfg_tbl type)
-{
-	return (type % 2)?(type - 1):(type + 1);
+	rte_spinlock_lock(&acl_rules_lock);
+	ret = dp_rules_entry_add(&acl_rules_table[p], next);
+#ifdef UE_IPV6
+	/* rules with no address, as the default ones, match IPv6 pkts too */
+	if (ret == 0 && acl6_rule_from_wildcard(&r, &r6) == 0 &&
+			dp_rules_entry_add(&acl6_rules_table[p],
+				(struct rte_acl_rule *)&r6) < 0)
+		RTE_LOG(ERR, DP, "Fail to add IPv6 acl rule id %u\n", rule_id);
+#endif /* UE_IPV6 */
+	if (ret == 0)
+		acl_rules_updated(p);
+	rte_spinlock_unlock(&acl_rules_lock);
+
+	return ret;
 }
 
 /**
  *	To delete sdf or adc filter in acl table.
- *	The entries are first removed in local memory and then updated on
- *	standby table.
+ *	The entries are removed in local memory and then built on the
+ *	standby table by the build thread.
  *
  * @param name
  *	ACL table name (SDF/ADC), only for debug logs.
- * @param type
- *	table to add entry.
+ * @param p
+ *	rules table to delete entry.
  * @param pkt_filter
  *	packet filter which include ruleid, priority and
  *		acl rule string to be deleted.
@@ -1365,7 +1869,7 @@ dp_acl_get_standby(enum acl_cfg_tbl type)
  *	- -1 on failure
  */
 static int
-dp_filter_entry_delete(char *name, enum acl_cfg_tbl type,
+dp_filter_entry_delete(char *name, enum acl_rules_params p,
 			struct pkt_filter *pkt_filter_entry)
 {
 	uint32_t rule_id;
@@ -1378,21 +1882,17 @@ dp_filter_entry_delete(char *name, enum acl_cfg_tbl type,
 	RTE_LOG(INFO, DP, "ACL DEL:%s rule_id:%d\n",
 			name, rule_id);
 
-	struct acl4_rule rule;
-	rule.data.userdata = rule_id + ACL_DENY_SIGNATURE;
-	dp_rules_entry_delete(&acl_rules_table[type/2], &rule);
-
-	return reset_and_build_rules(type);
+	return acl_rule_delete(p, rule_id);
 }
 /**
  *	To add sdf or adc filter in acl table.
- *	The entries are first stored in local memory and then updated on
- *	standby table.
+ *	The entries are stored in local memory and then built on the
+ *	standby table by the build thread.
  *
  * @param name
  *	ACL table name (SDF/ADC), only for debug logs.
- * @param type
- *	table to add entry.
+ * @param p
+ *	rules table to add entry.
  * @param rule_id
  *	rule id to add default filter.
  *
@@ -1401,14 +1901,14 @@ dp_filter_entry_delete(char *name, enum acl_cfg_tbl type,
  *	- -1 on failure
  */
 static int
-default_entry_add(char *name, enum acl_cfg_tbl type, uint32_t rule_id)
+default_entry_add(char *name, enum acl_rules_params p, uint32_t rule_id)
 {
 	struct pkt_filter def_pkt_filter;
 	/* default rule id = max_elements of table */
 	def_pkt_filter.pcc_rule_id = rule_id;
 	sprintf((char *)&def_pkt_filter.u.rule_str[0], "0.0.0.0/0 0.0.0.0/0 0 : 65535 0 : 65535 0x0/0x0\n");
 
-	if (dp_filter_entry_add(name, type, &def_pkt_filter) < 0)
+	if (dp_filter_entry_add(name, p, &def_pkt_filter) < 0)
 		return -1;
 	return 0;
 }
@@ -1437,34 +1937,39 @@ dns_entry_add(struct dp_id dp_id)
 int
 dp_sdf_filter_table_create(struct dp_id dp_id, uint32_t max_elements)
 {
+	int ret = -1;
+
 	RTE_SET_USED(dp_id);
+	rte_spinlock_lock(&acl_rules_lock);
+	acl_build_stop();
 	if (acl_config_init(&acl_config[SDF_ACTIVE], "ACLTable-0",
 			max_elements, sizeof(struct acl4_rule)) < 0)
-			return -1;
+		goto out;
 	if (acl_config_init(&acl_config[SDF_STANDBY], "ACLTable-1",
 			max_elements, sizeof(struct acl4_rule)) < 0)
-			return -1;
+		goto out;
 
 	/* create acl rules table */
-	return dp_acl_rules_table_create(SDF_PARAM, max_elements);
+	ret = dp_acl_rules_table_create(SDF_PARAM, max_elements);
+out:
+	rte_spinlock_unlock(&acl_rules_lock);
+	return ret;
 }
 
 int
 dp_sdf_filter_table_delete(struct dp_id dp_id)
 {
-	int i;
 	RTE_SET_USED(dp_id);
-	struct acl_config *pacl_config = &acl_config[SDF_ACTIVE];
-	for (i = 0; i < NB_SOCKETS; i++)
-		if (pacl_config->mapped[i])
-			rte_acl_reset(pacl_config->acx_ipv4[i]);
-
-	pacl_config = &acl_config[SDF_STANDBY];
-	for (i = 0; i < NB_SOCKETS; i++)
-		if (pacl_config->mapped[i])
-			rte_acl_reset(pacl_config->acx_ipv4[i]);
+	rte_spinlock_lock(&acl_rules_lock);
+	acl_build_stop();
+	acl_config_reset(&acl_config[SDF_ACTIVE]);
+	acl_config_reset(&acl_config[SDF_STANDBY]);
 
 	dp_acl_rules_table_delete(&acl_rules_table[SDF_PARAM]);
+#ifdef UE_IPV6
+	dp_acl_rules_table_delete(&acl6_rules_table[SDF_PARAM]);
+#endif
+	rte_spinlock_unlock(&acl_rules_lock);
 
 	return 0;
 }
@@ -1473,7 +1978,6 @@ int
 dp_sdf_filter_entry_add(struct dp_id dp_id, struct pkt_filter *pkt_filter)
 {
 	static int is_first = 1;
-	enum acl_cfg_tbl standby = dp_acl_get_standby(sdf_active_tbl);
 	RTE_SET_USED(dp_id);
 
 	if (is_first == 1) {
@@ -1481,13 +1985,16 @@ dp_sdf_filter_entry_add(struct dp_id dp_id, struct pkt_filter *pkt_filter)
 		is_first = 0;
 	}
 
-	if (dp_filter_entry_add("SDF", standby, pkt_filter) < 0)
+	if (dp_filter_entry_add("SDF", SDF_PARAM, pkt_filter) < 0)
 		return -1;
 
-	sdf_active_tbl = standby;
-
 	RTE_LOG(INFO, DP, "ACL ADD:%s, rule_id:%d, rule:%s\n",
 			"SDF", pkt_filter->pcc_rule_id, pkt_filter->u.rule_str);
+	sess_fast_path_rules_changed();
+#ifdef WARM_RESTART
+	sess_store_rule_add(SESS_STORE_SDF, pkt_filter->pcc_rule_id,
+			pkt_filter, sizeof(*pkt_filter));
+#endif	/* WARM_RESTART */
 	return 0;
 }
 
@@ -1495,69 +2002,65 @@ int
 dp_sdf_filter_entry_delete(struct dp_id dp_id,
 			struct pkt_filter *pkt_filter_entry)
 {
-	enum acl_cfg_tbl standby = dp_acl_get_standby(sdf_active_tbl);
 	RTE_SET_USED(dp_id);
-	if (dp_filter_entry_delete("SDF", standby, pkt_filter_entry) < 0)
+	if (dp_filter_entry_delete("SDF", SDF_PARAM, pkt_filter_entry) < 0)
 		return -1;
-
-	sdf_active_tbl = standby;
+	sess_fast_path_rules_changed();
+#ifdef WARM_RESTART
+	sess_store_rule_del(SESS_STORE_SDF, pkt_filter_entry->pcc_rule_id);
+#endif	/* WARM_RESTART */
 	return 0;
 }
 
 int
 dp_adc_filter_table_create(struct dp_id dp_id, uint32_t max_elements)
 {
+	int ret = -1;
+
 	RTE_SET_USED(dp_id);
+	rte_spinlock_lock(&acl_rules_lock);
+	acl_build_stop();
 	if (acl_config_init(&acl_config[ADC_UL_ACTIVE], "ACLTable-2",
 			max_elements, sizeof(struct acl4_rule)) < 0)
-			return -1;
+		goto out;
 	if (acl_config_init(&acl_config[ADC_UL_STANDBY], "ACLTable-3",
 			max_elements, sizeof(struct acl4_rule)) < 0)
-			return -1;
-	if (acl_config_init(&acl_config[ADC_DL_ACTIVE], "ACLTable-2",
+		goto out;
+	if (acl_config_init(&acl_config[ADC_DL_ACTIVE], "ACLTable-4",
 			max_elements, sizeof(struct acl4_rule)) < 0)
-			return -1;
-	if (acl_config_init(&acl_config[ADC_DL_STANDBY], "ACLTable-3",
+		goto out;
+	if (acl_config_init(&acl_config[ADC_DL_STANDBY], "ACLTable-5",
 			max_elements, sizeof(struct acl4_rule)) < 0)
-			return -1;
+		goto out;
 	/* create acl rules table */
 	dp_acl_rules_table_create(ADC_UL_PARAM, max_elements);
 
 	dp_acl_rules_table_create(ADC_DL_PARAM, max_elements);
-
-	return 0;
+	ret = 0;
+out:
+	rte_spinlock_unlock(&acl_rules_lock);
+	return ret;
 }
 
 int
 dp_adc_filter_table_delete(struct dp_id dp_id)
 {
-	int i;
 	RTE_SET_USED(dp_id);
-	struct acl_config *pacl_config;
-
-	pacl_config	= &acl_config[ADC_UL_PARAM];
-	for (i = 0; i < NB_SOCKETS; i++)
-		if (pacl_config->mapped[i])
-			rte_acl_reset(pacl_config->acx_ipv4[i]);
-
-	pacl_config = &acl_config[ADC_UL_STANDBY];
-	for (i = 0; i < NB_SOCKETS; i++)
-		if (pacl_config->mapped[i])
-			rte_acl_reset(pacl_config->acx_ipv4[i]);
-
-	pacl_config = &acl_config[ADC_DL_ACTIVE];
-	for (i = 0; i < NB_SOCKETS; i++)
-		if (pacl_config->mapped[i])
-			rte_acl_reset(pacl_config->acx_ipv4[i]);
-
-	pacl_config = &acl_config[ADC_DL_STANDBY];
-	for (i = 0; i < NB_SOCKETS; i++)
-		if (pacl_config->mapped[i])
-			rte_acl_reset(pacl_config->acx_ipv4[i]);
+	rte_spinlock_lock(&acl_rules_lock);
+	acl_build_stop();
+	acl_config_reset(&acl_config[ADC_UL_ACTIVE]);
+	acl_config_reset(&acl_config[ADC_UL_STANDBY]);
+	acl_config_reset(&acl_config[ADC_DL_ACTIVE]);
+	acl_config_reset(&acl_config[ADC_DL_STANDBY]);
 
 	dp_acl_rules_table_delete(&acl_rules_table[ADC_UL_PARAM]);
 
 	dp_acl_rules_table_delete(&acl_rules_table[ADC_DL_PARAM]);
+#ifdef UE_IPV6
+	dp_acl_rules_table_delete(&acl6_rules_table[ADC_UL_PARAM]);
+	dp_acl_rules_table_delete(&acl6_rules_table[ADC_DL_PARAM]);
+#endif
+	rte_spinlock_unlock(&acl_rules_lock);
 
 	return 0;
 }
@@ -1565,46 +2068,29 @@ dp_adc_filter_table_delete(struct dp_id dp_id)
 int
 dp_adc_filter_entry_add(struct dp_id dp_id, struct pkt_filter *pkt_filter)
 {
-	enum acl_cfg_tbl standby = dp_acl_get_standby(adc_ul_active_tbl);
-
 	RTE_SET_USED(dp_id);
 
-	if (dp_filter_entry_add("ADC", standby, pkt_filter) < 0)
+	if (dp_filter_entry_add("ADC", ADC_UL_PARAM, pkt_filter) < 0)
 		return -1;
-	adc_ul_active_tbl = standby;
 
 	/* swap the src and dst address for DL traffic.*/
 	swap_src_dst_ip((char *)&pkt_filter->u.rule_str[0]);
 
-	standby = dp_acl_get_standby(adc_dl_active_tbl);
-	RTE_SET_USED(dp_id);
-	if (dp_filter_entry_add("ADC", standby, pkt_filter) < 0)
-		return -1;
-	adc_dl_active_tbl = standby;
-	return 0;
+	return dp_filter_entry_add("ADC", ADC_DL_PARAM, pkt_filter);
 }
 
 int
 dp_adc_filter_entry_delete(struct dp_id dp_id,
 				struct pkt_filter *pkt_filter_entry)
 {
-	enum acl_cfg_tbl standby = dp_acl_get_standby(adc_ul_active_tbl);
 	RTE_SET_USED(dp_id);
-	if (dp_filter_entry_delete("ADC", standby, pkt_filter_entry) < 0)
+	if (dp_filter_entry_delete("ADC", ADC_UL_PARAM, pkt_filter_entry) < 0)
 		return -1;
 
-	adc_ul_active_tbl = standby;
-
 	/* swap the src and dst address for DL traffic.*/
 	swap_src_dst_ip((char *)&pkt_filter_entry->u.rule_str[0]);
 
-	standby = dp_acl_get_standby(adc_dl_active_tbl);
-	RTE_SET_USED(dp_id);
-	if (dp_filter_entry_delete("ADC", standby, pkt_filter_entry) < 0)
-		return -1;
-
-	adc_dl_active_tbl = standby;
-	return 0;
+	return dp_filter_entry_delete("ADC", ADC_DL_PARAM, pkt_filter_entry);
 }
 
 /******************** Callback functions **********************/
@@ -1678,16 +2164,63 @@ cb_sdf_filter_entry_delete(struct msgbuf *msg_payload)
 				msg_payload->msg_union.pkt_filter_entry);
 }
 
+/**
+ *  Callback function to parse msg payload and add a bulk of sdf rules.
+ *
+ * @param msg_payload
+ *	payload from CP
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on failure of any rule
+ */
+static int
+cb_sdf_filter_entry_add_bulk(struct msgbuf *msg_payload)
+{
+	struct msg_rule_bulk *bulk = &msg_payload->msg_union.rule_bulk;
+	int ret;
+
+	if (bulk->n > MSG_RULE_BULK_MAX) {
+		RTE_LOG(ERR, DP, "Bulk SDF msg with %u rules\n", bulk->n);
+		return -1;
+	}
+
+	ret = sdf_filter_entry_add_bulk(msg_payload->dp_id, bulk->u.sdf,
+			bulk->n, NULL);
+	/* hold the build until the last msg of the batch */
+	if (bulk->more)
+		acl_rules_batch_begin();
+	else
+		acl_rules_batch_end();
+	return ret < 0 ? -1 : 0;
+}
+
 /**
  * Initialization of filter table callback functions.
  */
 void app_filter_tbl_init(void)
 {
+#ifdef COMBINED_SDF_ADC_ACL
+	enum acl_cfg_tbl tbl;
+
+	for (tbl = SDF_ADC_UL_ACTIVE; tbl <= SDF_ADC_DL_STANDBY; tbl++) {
+		char name[MAX_LEN];
+
+		snprintf(name, sizeof(name), "ACLTable-%d", tbl);
+		if (acl_config_init(&acl_config[tbl], name,
+				MAX_ACL_RULE_NUM, sizeof(struct acl4_rule)) < 0)
+			rte_exit(EXIT_FAILURE, "Failed to init ACL table %d\n",
+					tbl);
+	}
+#endif
+	acl_build_thread_start();
+
 	/* register msg type in DB*/
 	iface_ipc_register_msg_cb(MSG_SDF_CRE, cb_sdf_filter_table_create);
 	iface_ipc_register_msg_cb(MSG_SDF_DES, cb_sdf_filter_table_delete);
 	iface_ipc_register_msg_cb(MSG_SDF_ADD, cb_sdf_filter_entry_add);
 	iface_ipc_register_msg_cb(MSG_SDF_DEL, cb_sdf_filter_entry_delete);
+	iface_ipc_register_msg_cb(MSG_SDF_BULK_ADD, cb_sdf_filter_entry_add_bulk);
 #ifdef ADC_UPFRONT
 	/* Create ADC Rule table*/
 	struct dp_id dp_id;
@@ -1699,6 +2232,24 @@ void app_filter_tbl_init(void)
 #endif /* ADC_UPFRONT */
 }
 
+#ifdef UE_IPV6
+/**
+ * Classify the IPv6 pkts of a burst on the IPv6 context, pkts match no
+ * rule while the context has none.
+ */
+static inline void
+dp_acl_classify_ipv6(struct acl_config *acl_config, int socketid,
+		struct acl_search *s, uint32_t *res, uint32_t categories)
+{
+	if (!acl_config->acx_ipv6_built[socketid]) {
+		memset(res, 0, s->num_ipv6 * categories * sizeof(res[0]));
+		return;
+	}
+	rte_acl_classify(acl_config->acx_ipv6[socketid], s->data_ipv6, res,
+			s->num_ipv6, categories);
+}
+#endif /* UE_IPV6 */
+
 uint32_t *dp_acl_lookup(struct rte_mbuf **m, int nb_rx,
 		struct acl_config *acl_config,
 		struct acl_search *acl_search)
@@ -1723,27 +2274,158 @@ uint32_t *dp_acl_lookup(struct rte_mbuf **m, int nb_rx,
 			update_stats((acl_search+lcore_id)->res_ipv4,
 					(acl_search+lcore_id)->num_ipv4);
 		}
+#ifdef UE_IPV6
+		struct acl_search *s = acl_search + lcore_id;
+		int i;
+
+		/* single family bursts are in burst order already */
+		if (s->num_ipv6 == 0)
+			return s->res_ipv4;
+
+		dp_acl_classify_ipv6(acl_config, socketid, s, s->res_ipv6,
+				DEFAULT_MAX_CATEGORIES);
+		update_stats(s->res_ipv6, s->num_ipv6);
+		if (s->num_ipv4 == 0)
+			return s->res_ipv6;
+
+		for (i = 0; i < s->num_ipv4; i++)
+			s->res[s->idx_ipv4[i]] = s->res_ipv4[i];
+		for (i = 0; i < s->num_ipv6; i++)
+			s->res[s->idx_ipv6[i]] = s->res_ipv6[i];
+		return s->res;
+#endif /* UE_IPV6 */
 	}
 	return (uint32_t *)&(acl_search+lcore_id)->res_ipv4;
 }
 
 uint32_t *sdf_lookup(struct rte_mbuf **m, int nb_rx)
 {
-	return dp_acl_lookup(m, nb_rx, &acl_config[sdf_active_tbl], acl_search[SDF_PARAM]);
+	return dp_acl_lookup(m, nb_rx,
+			&acl_config[acl_build[SDF_BUILD].active],
+			acl_search[SDF_PARAM]);
 }
 
 uint32_t *adc_ul_lookup(struct rte_mbuf **m, int nb_rx)
 {
-	return dp_acl_lookup(m, nb_rx, &acl_config[adc_ul_active_tbl], acl_search[ADC_UL_PARAM]);
+	return dp_acl_lookup(m, nb_rx,
+			&acl_config[acl_build[ADC_UL_BUILD].active],
+			acl_search[ADC_UL_PARAM]);
 }
 uint32_t *adc_dl_lookup(struct rte_mbuf **m, int nb_rx)
 {
-	return dp_acl_lookup(m, nb_rx, &acl_config[adc_dl_active_tbl], acl_search[ADC_DL_PARAM]);
+	return dp_acl_lookup(m, nb_rx,
+			&acl_config[acl_build[ADC_DL_BUILD].active],
+			acl_search[ADC_DL_PARAM]);
+}
+
+#ifdef COMBINED_SDF_ADC_ACL
+/**
+ * Classify pkts on a combined SDF and ADC table.
+ */
+static void
+dp_acl_comb_lookup(struct rte_mbuf **m, int nb_rx,
+		struct acl_config *acl_config, struct acl_comb_search *cs,
+		uint32_t **sdf_res, uint32_t **adc_res)
+{
+	int socketid;
+	int i;
+
+	socketid = rte_lcore_to_socket_id(rte_lcore_id());
+
+	if (nb_rx > 0) {
+		prepare_acl_parameter(m, &cs->s, nb_rx);
+
+#ifdef UE_IPV6
+		/* single family bursts are in burst order already */
+		if (cs->s.num_ipv6) {
+			uint32_t j;
+
+			if (cs->s.num_ipv4)
+				rte_acl_classify(acl_config->acx_ipv4[socketid],
+						cs->s.data_ipv4, cs->res,
+						cs->s.num_ipv4,
+						COMB_ACL_CATEGORIES);
+			for (i = 0; i < cs->s.num_ipv4; i++) {
+				j = cs->s.idx_ipv4[i];
+				cs->sdf_res[j] = cs->res[i * COMB_ACL_CATEGORIES
+						+ COMB_ACL_CAT_SDF];
+				cs->adc_res[j] = cs->res[i * COMB_ACL_CATEGORIES
+						+ COMB_ACL_CAT_ADC];
+			}
+			dp_acl_classify_ipv6(acl_config, socketid, &cs->s,
+					cs->res, COMB_ACL_CATEGORIES);
+			for (i = 0; i < cs->s.num_ipv6; i++) {
+				j = cs->s.idx_ipv6[i];
+				cs->sdf_res[j] = cs->res[i * COMB_ACL_CATEGORIES
+						+ COMB_ACL_CAT_SDF];
+				cs->adc_res[j] = cs->res[i * COMB_ACL_CATEGORIES
+						+ COMB_ACL_CAT_ADC];
+			}
+			update_stats(cs->sdf_res, nb_rx);
+			update_stats(cs->adc_res, nb_rx);
+		} else
+#endif /* UE_IPV6 */
+		if (cs->s.num_ipv4) {
+			rte_acl_classify(acl_config->acx_ipv4[socketid],
+					cs->s.data_ipv4, cs->res,
+					cs->s.num_ipv4, COMB_ACL_CATEGORIES);
+
+			for (i = 0; i < cs->s.num_ipv4; i++) {
+				cs->sdf_res[i] = cs->res[i * COMB_ACL_CATEGORIES
+						+ COMB_ACL_CAT_SDF];
+				cs->adc_res[i] = cs->res[i * COMB_ACL_CATEGORIES
+						+ COMB_ACL_CAT_ADC];
+			}
+			update_stats(cs->sdf_res, cs->s.num_ipv4);
+			update_stats(cs->adc_res, cs->s.num_ipv4);
+		}
+	}
+	*sdf_res = cs->sdf_res;
+	*adc_res = cs->adc_res;
+}
+
+void sdf_adc_ul_lookup(struct rte_mbuf **m, int nb_rx,
+		uint32_t **sdf_res, uint32_t **adc_res)
+{
+	dp_acl_comb_lookup(m, nb_rx,
+			&acl_config[acl_build[SDF_ADC_UL_BUILD].active],
+			&acl_comb_search[0][rte_lcore_id()], sdf_res, adc_res);
+}
+
+void sdf_adc_dl_lookup(struct rte_mbuf **m, int nb_rx,
+		uint32_t **sdf_res, uint32_t **adc_res)
+{
+	dp_acl_comb_lookup(m, nb_rx,
+			&acl_config[acl_build[SDF_ADC_DL_BUILD].active],
+			&acl_comb_search[1][rte_lcore_id()], sdf_res, adc_res);
+}
+#endif /* COMBINED_SDF_ADC_ACL */
+
+int
+dp_sdf_rule_is_catch_all(uint32_t rule_id)
+{
+	struct acl_rules_table *t = &acl_rules_table[SDF_PARAM];
+	struct acl4_rule *r;
+	int ret = 0;
+
+	rte_spinlock_lock(&acl_rules_lock);
+	if ((t->rules != NULL) && (rule_id < MAX_ACL_RULE_NUM)
+			&& t->slot[rule_id]) {
+		r = (struct acl4_rule *)ACL_RULE(t, t->slot[rule_id] - 1);
+		ret = (r->field[PROTO_FIELD_IPV4].mask_range.u8 == 0)
+			&& (r->field[SRC_FIELD_IPV4].mask_range.u32 == 0)
+			&& (r->field[DST_FIELD_IPV4].mask_range.u32 == 0)
+			&& (r->field[SRCP_FIELD_IPV4].value.u16 == 0)
+			&& (r->field[SRCP_FIELD_IPV4].mask_range.u16 == 0xffff)
+			&& (r->field[DSTP_FIELD_IPV4].value.u16 == 0)
+			&& (r->field[DSTP_FIELD_IPV4].mask_range.u16 == 0xffff);
+	}
+	rte_spinlock_unlock(&acl_rules_lock);
+	return ret;
 }
 
 int dp_sdf_default_entry_add(struct dp_id dp_id, uint32_t rule_id)
 {
-	enum acl_cfg_tbl standby = dp_acl_get_standby(sdf_active_tbl);
 	struct pkt_filter pktf = {
 			.pcc_rule_id = rule_id,
 		};
@@ -1762,25 +2444,17 @@ int dp_sdf_default_entry_add(struct dp_id dp_id, uint32_t rule_id)
 		0, 0/*proto, proto_mask)*/
 		);
 
-	if (dp_filter_entry_add("SDF", standby, &pktf) < 0)
-		return -1;
-
-	sdf_active_tbl = standby;
-	return 0;
+	return dp_filter_entry_add("SDF", SDF_PARAM, &pktf);
 }
 
 int dp_sdf_default_entry_action_modify(struct dp_id dp_id, uint32_t rule_id)
 {
-	enum acl_cfg_tbl standby = dp_acl_get_standby(sdf_active_tbl);
-
 	RTE_SET_USED(dp_id);
 
 	RTE_LOG(INFO, DP, "ACL DEL:%s rule_id:%d\n",
 			"SDF", rule_id);
 
-	struct acl4_rule rule;
-	rule.data.userdata = rule_id + ACL_DENY_SIGNATURE;
-	if (dp_rules_entry_delete(&acl_rules_table[standby/2], &rule))
+	if (acl_rule_delete(SDF_PARAM, rule_id))
 		return -1;
 
 	struct pkt_filter pktf = {
@@ -1799,10 +2473,9 @@ int dp_sdf_default_entry_action_modify(struct dp_id dp_id, uint32_t rule_id)
 		0, 0/*proto, proto_mask)*/
 		);
 
-	if (dp_filter_entry_add("SDF", standby, &pktf) < 0)
+	if (dp_filter_entry_add("SDF", SDF_PARAM, &pktf) < 0)
 		return -1;
-
-	sdf_active_tbl = standby;
+	sess_fast_path_rules_changed();
 	return 0;
 }
 
@@ -1810,16 +2483,11 @@ int
 dp_adc_filter_default_entry_add(struct dp_id dp_id)
 {
 	struct pkt_filter adc_filter;
-	enum acl_cfg_tbl standby = dp_acl_get_standby(adc_ul_active_tbl);
 	RTE_SET_USED(dp_id);
 
 	adc_filter.pcc_rule_id = ADC_DEFAULT_RULE_ID;
 	sprintf(adc_filter.u.rule_str, "0.0.0.0/0 0.0.0.0/0 "
 		"0 : 65535 0 : 65535 0x0/0x0\n");
 
-	if (dp_filter_entry_add("ADC", standby, &adc_filter) < 0)
-		return -1;
-	adc_ul_active_tbl = standby;
-
-	return 0;
+	return dp_filter_entry_add("ADC", ADC_UL_PARAM, &adc_filter);
 }
@@ -95,6 +95,115 @@ adc_ul_lookup(struct rte_mbuf **m, int nb_rx);
 uint32_t *
 adc_dl_lookup(struct rte_mbuf **m, int nb_rx);
 
+#ifdef COMBINED_SDF_ADC_ACL
+/**
+ * Function for combined SDF and ADC table lookup for Upsstream traffic.
+ * A single classify returns the SDF and the ADC rule of each pkt.
+ *
+ * @param m
+ *	pointer to pkts.
+ * @param nb_rx
+ *	num. of pkts.
+ * @param sdf_res
+ *	array containing SDF search results for each input buf
+ * @param adc_res
+ *	array containing ADC search results for each input buf
+ *
+ * @return
+ *	None
+ */
+void
+sdf_adc_ul_lookup(struct rte_mbuf **m, int nb_rx,
+		uint32_t **sdf_res, uint32_t **adc_res);
+
+/**
+ * Function for combined SDF and ADC table lookup for Downsstream traffic.
+ * A single classify returns the SDF and the ADC rule of each pkt.
+ *
+ * @param m
+ *	pointer to pkts.
+ * @param nb_rx
+ *	num. of pkts.
+ * @param sdf_res
+ *	array containing SDF search results for each input buf
+ * @param adc_res
+ *	array containing ADC search results for each input buf
+ *
+ * @return
+ *	None
+ */
+void
+sdf_adc_dl_lookup(struct rte_mbuf **m, int nb_rx,
+		uint32_t **sdf_res, uint32_t **adc_res);
+#endif /* COMBINED_SDF_ADC_ACL */
+
+/**
+ * Wait until the ACL build thread built all rule updates made so far
+ * and the new tables are used for lookups.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the last build of a table failed, its rules are not applied
+ */
+int
+acl_build_wait(void);
+
+/**
+ * Get the time taken by the last build of the ACL build thread, the
+ * longest one of the tables built since acl_build_cycles_reset().
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	build time in TSC cycles.
+ */
+uint64_t
+acl_build_cycles(void);
+
+/**
+ * Forget the build times of the tables, so that acl_build_cycles() only
+ * reports the builds that follow.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+acl_build_cycles_reset(void);
+
+/**
+ * Start a batch of rule updates. The ACL build thread holds off the
+ * build of the updates until acl_rules_batch_end(), or until no update
+ * came for ACL_BUILD_BATCH_HOLDOFF_US, so that the batch is built once.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+acl_rules_batch_begin(void);
+
+/**
+ * End the batch of rule updates started by acl_rules_batch_begin(), its
+ * updates are built after the usual holdoff.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+acl_rules_batch_end(void);
+
 /**
  * Get SDF ACL table base address.
  *
@@ -234,6 +343,19 @@ int
 dp_adc_filter_entry_delete(struct dp_id dp_id,
 				struct pkt_filter *pkt_filter_entry);
 
+/**
+ * Check whether a SDF rule matches every pkt: wildcard addresses,
+ * protocol and ports.
+ *
+ * @param rule_id
+ *	sdf rule id
+ *
+ * @return
+ *	1 if the rule is a catch-all, 0 otherwise or if there is no rule.
+ */
+int
+dp_sdf_rule_is_catch_all(uint32_t rule_id);
+
 /**
  * Add default SDF entry
  *
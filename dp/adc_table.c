@@ -24,6 +24,8 @@
 #include "util.h"
 #include "acl.h"
 #include "interface.h"
+#include "qsbr.h"
+#include "sess_store.h"
 #include <sponsdn.h>
 
 #define IS_MAX_REACHED(table) \
@@ -31,6 +33,27 @@
 
 struct table adc_table;
 
+/**
+ * Dense rule id indexed view of adc_table, read on the fast path.
+ * Rule ids outside the array fall back to the tree.
+ */
+#define ADC_RULE_ARRAY_SIZE	ADC_TABLE_SIZE
+
+static struct adc_rules *adc_rule_array[ADC_RULE_ARRAY_SIZE];
+
+/**
+ * Publish ADC rule pointer of rule id to the fast path.
+ * rte_smp_wmb orders the rule contents before the pointer store.
+ */
+static inline void
+adc_rule_array_set(uint32_t rule_id, struct adc_rules *rule)
+{
+	if (rule_id >= ADC_RULE_ARRAY_SIZE)
+		return;
+	rte_smp_wmb();
+	*(struct adc_rules * volatile *)&adc_rule_array[rule_id] = rule;
+}
+
 /**
  * Compare ADC Rule entries.
  */
@@ -125,7 +148,7 @@ dp_adc_table_create(struct dp_id dp_id, uint32_t max_elements)
  */
 static void free_node(void *p)
 {
-	rte_free(p);
+	dp_defer_free(p);
 }
 /**
  * Delete ADC filter table.
@@ -139,7 +162,11 @@ static void free_node(void *p)
 int
 dp_adc_table_delete(struct dp_id dp_id)
 {
-	tdestroy(&adc_table.root, free_node);
+	uint32_t i;
+
+	for (i = 0; i < ADC_RULE_ARRAY_SIZE; i++)
+		adc_rule_array_set(i, NULL);
+	tdestroy(adc_table.root, free_node);
 	memset(&adc_table, 0, sizeof(struct table));
 	RTE_LOG(INFO, DP, "ADC filter table: \"%s\" destroyed\n", dp_id.name);
 	return 0;
@@ -159,6 +186,9 @@ dp_adc_table_delete(struct dp_id dp_id)
 int
 dp_adc_entry_add(struct dp_id dp_id, struct adc_rules *adc_filter_entry)
 {
+	struct adc_rules *old;
+	void **p;
+
 	if (IS_MAX_REACHED(adc_table)) {
 		RTE_LOG(INFO, DP, "Reached max ADC filter entries\n");
 		return -1;
@@ -172,13 +202,24 @@ dp_adc_entry_add(struct dp_id dp_id, struct adc_rules *adc_filter_entry)
 	}
 	*new = *adc_filter_entry;
 	/* put node into the tree */
-	if (tsearch(new, &adc_table.root, adc_table.compare) == 0) {
+	p = tsearch(new, &adc_table.root, adc_table.compare);
+	if (p == NULL) {
 		RTE_LOG(INFO, DP, "Fail to add adc rule_id %d\n",
 				adc_filter_entry->rule_id);
+		rte_free(new);
 		return -1;
 	}
 
-	adc_table.num_entries++;
+	if (*p != new) {
+		/* rule_id exist, replace the node */
+		old = *p;
+		*p = new;
+		adc_rule_array_set(new->rule_id, new);
+		dp_defer_free(old);
+	} else {
+		adc_rule_array_set(new->rule_id, new);
+		adc_table.num_entries++;
+	}
 
 	/* add entry in adc acl table */
 	if (adc_filter_entry->sel_type == DOMAIN_IP_ADDR) {
@@ -228,6 +269,10 @@ dp_adc_entry_add(struct dp_id dp_id, struct adc_rules *adc_filter_entry)
 		RTE_LOG(INFO, DP, "Spons DN ADD: rule_id:%d, domain_name:%s\n",
 				adc_filter_entry->rule_id, adc_filter_entry->u.domain_name);
 	}
+#ifdef WARM_RESTART
+	sess_store_rule_add(SESS_STORE_ADC, adc_filter_entry->rule_id,
+			adc_filter_entry, sizeof(*adc_filter_entry));
+#endif	/* WARM_RESTART */
 	return 0;
 }
 
@@ -245,17 +290,26 @@ dp_adc_entry_add(struct dp_id dp_id, struct adc_rules *adc_filter_entry)
 int
 dp_adc_entry_delete(struct dp_id dp_id, struct adc_rules *adc_filter_entry)
 {
+	struct adc_rules *rule;
 	void **p;
 	RTE_SET_USED(dp_id);
-	/* delete node from the tree */
-	p = tdelete(adc_filter_entry, &adc_table.root, adc_rule_id_compare);
+
+	p = tfind(adc_filter_entry, &adc_table.root, adc_rule_id_compare);
 	if (p == NULL) {
 		RTE_LOG(INFO, DP, "Fail to delete rule_id %d\n",
 						adc_filter_entry->rule_id);
 		return -1;
 	}
-	rte_free(*p);
+	rule = *p;
+	adc_rule_array_set(rule->rule_id, NULL);
+	/* delete node from the tree */
+	tdelete(adc_filter_entry, &adc_table.root, adc_rule_id_compare);
+	/* workers may still hold the rule */
+	dp_defer_free(rule);
 	adc_table.num_entries--;
+#ifdef WARM_RESTART
+	sess_store_rule_del(SESS_STORE_ADC, adc_filter_entry->rule_id);
+#endif	/* WARM_RESTART */
 	RTE_LOG(INFO, DP, "ADC filter entry with rule_id %d deleted\n",
 					adc_filter_entry->rule_id);
 	return 0;
@@ -276,7 +330,18 @@ adc_rule_info_get(uint32_t *rid, uint32_t n, uint64_t *pkts_mask, void **adc_inf
 			continue;
 		}
 
-		/* put node into the tree */
+		if (likely(new.rule_id < ADC_RULE_ARRAY_SIZE)) {
+			adc_info[i] = *(struct adc_rules * volatile *)
+						&adc_rule_array[new.rule_id];
+			if (adc_info[i] == NULL) {
+				/* adc rule not found, drop the pkt*/
+				RESET_BIT(*pkts_mask, i);
+				RTE_LOG(DEBUG, DP, "ADC rule not found for id %u\n",
+						rid[i]);
+			}
+			continue;
+		}
+
 		p = tfind(&new, &adc_table.root, adc_table.compare);
 		if (p == NULL) {
 			/* adc rule not found, drop the pkt*/
@@ -377,6 +442,37 @@ cb_adc_entry_add(struct msgbuf *msg_payload)
 					msg_payload->msg_union.adc_filter_entry);
 }
 
+/**
+ *  Callback to parse msg to add a bulk of adc rules
+ *
+ * @param msg_payload
+ *	payload from CP
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on failure of any rule
+ */
+static int
+cb_adc_entry_add_bulk(struct msgbuf *msg_payload)
+{
+	struct msg_rule_bulk *bulk = &msg_payload->msg_union.rule_bulk;
+	int ret;
+
+	if (bulk->n > MSG_RULE_BULK_MAX) {
+		RTE_LOG(ERR, DP, "Bulk ADC msg with %u rules\n", bulk->n);
+		return -1;
+	}
+
+	ret = adc_entry_add_bulk(msg_payload->dp_id, bulk->u.adc, bulk->n,
+			NULL);
+	/* hold the build until the last msg of the batch */
+	if (bulk->more)
+		acl_rules_batch_begin();
+	else
+		acl_rules_batch_end();
+	return ret < 0 ? -1 : 0;
+}
+
 /**
  * Delete adc rules.
  *
@@ -404,4 +500,5 @@ void app_adc_tbl_init(void)
 	iface_ipc_register_msg_cb(MSG_ADC_TBL_DES, cb_adc_table_delete);
 	iface_ipc_register_msg_cb(MSG_ADC_TBL_ADD, cb_adc_entry_add);
 	iface_ipc_register_msg_cb(MSG_ADC_TBL_DEL, cb_adc_entry_delete);
+	iface_ipc_register_msg_cb(MSG_ADC_BULK_ADD, cb_adc_entry_add_bulk);
 }
@@ -0,0 +1,727 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef DP_BENCH
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_random.h>
+#include <rte_cfgfile.h>
+#include <rte_ethdev.h>
+#include <rte_eth_ring.h>
+#include <rte_ether.h>
+#include <rte_arp.h>
+#include <rte_ip.h>
+#include <rte_udp.h>
+
+#include "main.h"
+#include "util.h"
+#include "epc_packet_framework.h"
+#include "bench.h"
+
+#ifndef SIMU_CP
+#error "DP_BENCH requires the sessions of SIMU_CP"
+#endif
+#ifdef NIC_RSS_STEERING
+#error "DP_BENCH ring ports have no RSS redirection table"
+#endif
+
+/** Same file simu_cp creates its sessions from */
+#ifdef SIMU_CP_FILE
+#define BENCH_SIMU_CP_FILE	SIMU_CP_FILE
+#else
+#define BENCH_SIMU_CP_FILE	"../config/simu_cp.cfg"
+#endif
+
+/** Inner L4 port of the AS for SDF rule hits */
+#define BENCH_AS_PORT		80
+/** Base inner L4 port of the UEs for SDF rule hits */
+#define BENCH_UE_PORT		10000
+/** L4 ports matched by the UL default SDF rule of simu_cp, 25000-27000 */
+#define BENCH_UL_DEF_PORT	25000
+#define BENCH_UL_DEF_RANGE	2001
+/** L4 ports matched by the DL default SDF rule of simu_cp, sport
+ * 1200-1300 and dport 0-100 */
+#define BENCH_DL_DEF_SPORT	1200
+#define BENCH_DL_DEF_RANGE	101
+/** Outer IP, UDP and GTP-U bytes of the UL pkts */
+#define BENCH_GTPU_OVERHEAD	(sizeof(struct ipv4_hdr) + \
+		sizeof(struct udp_hdr) + 8)
+
+/** MAC of eNB and SGi peer, answered to the ARP requests of the DP */
+static const struct ether_addr bench_peer_mac = {
+	.addr_bytes = {0x02, 0x00, 0x00, 0x00, 0x00, 0xfe}
+};
+
+struct bench_ul_hdr {
+	struct ether_hdr eth;
+	struct ipv4_hdr ip;
+	struct udp_hdr udp;
+	uint8_t gtpu_flags;
+	uint8_t gtpu_type;
+	uint16_t gtpu_len;
+	uint32_t gtpu_teid;
+	struct ipv4_hdr in_ip;
+	struct udp_hdr in_udp;
+} __attribute__((packed));
+
+struct bench_dl_hdr {
+	struct ether_hdr eth;
+	struct ipv4_hdr ip;
+	struct udp_hdr udp;
+} __attribute__((packed));
+
+/** Bench counters of a port side, S1U_PORT_ID or SGI_PORT_ID */
+struct bench_ctrs {
+	uint64_t gen;		/** pkts enqueued to the rx rings */
+	uint64_t rx_full;	/** pkts dropped, rx ring full */
+	uint64_t no_mbuf;	/** pkts not generated, pool empty */
+	uint64_t tx_pkts;	/** pkts transmitted by the DP */
+	uint64_t tx_bytes;	/** bytes transmitted by the DP, no CRC */
+	uint64_t arp;		/** ARP requests answered */
+};
+
+/** Counters sampled at the start and end of the measurement */
+struct bench_snap {
+	uint64_t tsc;
+	struct bench_ctrs ctrs[NUM_SPGW_PORTS];
+	struct epc_stage_stats stage[DP_MAX_LCORE][EPC_PIPELINE_MAX];
+	uint64_t ring_drops[EPC_RING_STATS_MAX];
+};
+
+enum bench_phase {
+	BENCH_INIT,
+	BENCH_WARMUP,
+	BENCH_RUN,
+	BENCH_DONE,
+};
+
+int bench_on;
+static struct bench_cfg bench_cfg;
+
+static struct rte_mempool *bench_pool;
+static struct rte_ring *bench_rx[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
+static struct rte_ring *bench_tx[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
+static struct bench_ul_hdr bench_ul_tpl[BENCH_SIZE_SLOTS];
+static struct bench_dl_hdr bench_dl_tpl[BENCH_SIZE_SLOTS];
+
+static struct bench_ctrs bench_ctrs[NUM_SPGW_PORTS];
+/** next UE of each side, advanced by bench_stride */
+static uint32_t bench_ue[NUM_SPGW_PORTS];
+static uint32_t bench_stride;
+static uint32_t bench_q[NUM_SPGW_PORTS];
+static uint32_t bench_ul_rem;
+static enum bench_phase bench_phase;
+static uint64_t bench_hz, bench_t0, bench_t_run, bench_t_end;
+static struct bench_snap bench_start, bench_end;
+
+static uint32_t
+cfg_u32(struct rte_cfgfile *file, const char *key, uint32_t def)
+{
+	const char *entry = rte_cfgfile_get_entry(file, "0", key);
+
+	return entry ? (uint32_t)strtoul(entry, NULL, 10) : def;
+}
+
+static int
+cfg_ip(struct rte_cfgfile *file, const char *key, uint32_t *ip)
+{
+	const char *entry = rte_cfgfile_get_entry(file, "0", key);
+	struct in_addr addr;
+
+	if (entry == NULL || inet_aton(entry, &addr) == 0) {
+		fprintf(stderr, "bench: invalid %s in %s\n", key,
+				BENCH_SIMU_CP_FILE);
+		return -1;
+	}
+	*ip = ntohl(addr.s_addr);
+	return 0;
+}
+
+/**
+ * Parse "size:weight,..." into the weighted size table.
+ */
+static int
+parse_sizes(const char *str, uint16_t *tbl)
+{
+	char buf[256];
+	uint32_t size[BENCH_SIZE_SLOTS], weight[BENCH_SIZE_SLOTS];
+	uint32_t n = 0, total = 0, slot = 0, i, j, cnt;
+	char *tok, *save, *w;
+
+	snprintf(buf, sizeof(buf), "%s", str);
+	for (tok = strtok_r(buf, ",", &save); tok != NULL;
+			tok = strtok_r(NULL, ",", &save)) {
+		if (n == BENCH_SIZE_SLOTS)
+			return -1;
+		size[n] = strtoul(tok, &w, 10);
+		weight[n] = (*w == ':') ? strtoul(w + 1, NULL, 10) : 1;
+		if (size[n] < BENCH_MIN_FRAME || size[n] > BENCH_MAX_FRAME
+				|| weight[n] == 0) {
+			fprintf(stderr, "bench: invalid size %s\n", tok);
+			return -1;
+		}
+		total += weight[n];
+		n++;
+	}
+	if (n == 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		cnt = (i == n - 1) ? BENCH_SIZE_SLOTS - slot :
+			weight[i] * BENCH_SIZE_SLOTS / total;
+		for (j = 0; j < cnt && slot < BENCH_SIZE_SLOTS; j++)
+			tbl[slot++] = size[i];
+	}
+	return 0;
+}
+
+static uint32_t
+gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+int
+bench_parse(const char *path)
+{
+	struct bench_cfg *cfg = &bench_cfg;
+	struct rte_cfgfile *file;
+	const char *entry;
+
+	file = rte_cfgfile_load(path, 0);
+	if (file == NULL) {
+		fprintf(stderr, "bench: cannot load %s\n", path);
+		return -1;
+	}
+	cfg->ues = cfg_u32(file, "ues", 0);
+	cfg->ul_pct = cfg_u32(file, "ul_pct", 50);
+	cfg->rule_pct = cfg_u32(file, "rule_pct", 100);
+	cfg->pps = cfg_u32(file, "kpps", 0) * 1000ULL;
+	cfg->warmup_sec = cfg_u32(file, "warmup_sec", 5);
+	cfg->duration_sec = cfg_u32(file, "duration_sec", 30);
+	cfg->seed = cfg_u32(file, "seed", 1);
+	cfg->exit_on_done = cfg_u32(file, "exit_on_done", 1);
+	entry = rte_cfgfile_get_entry(file, "0", "sizes");
+	if (parse_sizes(entry ? entry : "64", cfg->size_tbl) < 0)
+		return -1;
+	entry = rte_cfgfile_get_entry(file, "0", "report");
+	snprintf(cfg->report, sizeof(cfg->report), "%s", entry ? entry : "");
+	entry = rte_cfgfile_get_entry(file, "0", "core");
+	if (entry)
+		epc_app.core_bench = atoi(entry);
+	rte_cfgfile_close(file);
+
+	file = rte_cfgfile_load(BENCH_SIMU_CP_FILE, 0);
+	if (file == NULL) {
+		fprintf(stderr, "bench: cannot load %s\n", BENCH_SIMU_CP_FILE);
+		return -1;
+	}
+	if (cfg_ip(file, "enodeb_ip", &cfg->enb_ip) < 0
+			|| cfg_ip(file, "ue_ip_start", &cfg->ue_ip_s) < 0
+			|| cfg_ip(file, "as_ip_start", &cfg->as_ip_s) < 0) {
+		rte_cfgfile_close(file);
+		return -1;
+	}
+	cfg->max_ue_sess = cfg_u32(file, "max_ue_sess", 0);
+	cfg->max_ul_rules = cfg_u32(file, "max_ul_rules", 0);
+	cfg->max_dl_rules = cfg_u32(file, "max_dl_rules", 0);
+	rte_cfgfile_close(file);
+
+	if (cfg->ues == 0 || cfg->ues > cfg->max_ue_sess)
+		cfg->ues = cfg->max_ue_sess;
+	if (cfg->ues == 0 || cfg->duration_sec == 0 || cfg->ul_pct > 100
+			|| cfg->rule_pct > 100) {
+		fprintf(stderr, "bench: invalid ues, duration_sec, ul_pct "
+				"or rule_pct\n");
+		return -1;
+	}
+
+	/* visit the UEs in a fixed scattered order, not sequentially */
+	for (bench_stride = cfg->ues * 0.618 + 1; bench_stride > 1;
+			bench_stride--)
+		if (gcd(bench_stride, cfg->ues) == 1)
+			break;
+	bench_stride %= cfg->ues;
+	if (bench_stride == 0)
+		bench_stride = 1;
+
+	bench_on = 1;
+	printf("Parsed bench:\t%u UEs, ul %u%%, rule hits %u%%, "
+			"%"PRIu64" pps, warmup %us, duration %us\n", cfg->ues,
+			cfg->ul_pct, cfg->rule_pct, cfg->pps, cfg->warmup_sec,
+			cfg->duration_sec);
+	return 0;
+}
+
+static void
+bench_tpl_init(const struct app_params *app)
+{
+	uint32_t i, len;
+
+	for (i = 0; i < BENCH_SIZE_SLOTS; i++) {
+		struct bench_ul_hdr *ul = &bench_ul_tpl[i];
+		struct bench_dl_hdr *dl = &bench_dl_tpl[i];
+
+		/* SGi side IP length, UL pkts carry GTP-U on top */
+		len = bench_cfg.size_tbl[i] - ETHER_CRC_LEN - ETHER_HDR_LEN;
+
+		ether_addr_copy(&app->s1u_ether_addr, &ul->eth.d_addr);
+		ether_addr_copy(&bench_peer_mac, &ul->eth.s_addr);
+		ul->eth.ether_type = htons(ETHER_TYPE_IPv4);
+		ul->ip.version_ihl = 0x45;
+		ul->ip.total_length = htons(BENCH_GTPU_OVERHEAD + len);
+		ul->ip.time_to_live = 64;
+		ul->ip.next_proto_id = IPPROTO_UDP;
+		ul->ip.src_addr = htonl(bench_cfg.enb_ip);
+		ul->ip.dst_addr = app->s1u_ip;
+		ul->ip.hdr_checksum = rte_ipv4_cksum(&ul->ip);
+		ul->udp.src_port = htons(UDP_PORT_GTPU);
+		ul->udp.dst_port = htons(UDP_PORT_GTPU);
+		ul->udp.dgram_len = htons(sizeof(struct udp_hdr) + 8 + len);
+		ul->gtpu_flags = 0x30;
+		ul->gtpu_type = 0xff;
+		ul->gtpu_len = htons(len);
+		ul->in_ip.version_ihl = 0x45;
+		ul->in_ip.total_length = htons(len);
+		ul->in_ip.time_to_live = 64;
+		ul->in_ip.next_proto_id = IPPROTO_UDP;
+		ul->in_udp.dgram_len = htons(len - sizeof(struct ipv4_hdr));
+
+		ether_addr_copy(&app->sgi_ether_addr, &dl->eth.d_addr);
+		ether_addr_copy(&bench_peer_mac, &dl->eth.s_addr);
+		dl->eth.ether_type = htons(ETHER_TYPE_IPv4);
+		dl->ip.version_ihl = 0x45;
+		dl->ip.total_length = htons(len);
+		dl->ip.time_to_live = 64;
+		dl->ip.next_proto_id = IPPROTO_UDP;
+		dl->udp.dgram_len = htons(len - sizeof(struct ipv4_hdr));
+	}
+}
+
+static uint8_t
+bench_ring_port(const char *name, uint32_t side,
+		const struct ether_addr *mac)
+{
+	char ring_name[RTE_RING_NAMESIZE];
+	struct ether_addr *addr;
+	int port;
+	uint32_t q;
+
+	for (q = 0; q < EPC_MAX_PORT_QUEUES; q++) {
+		snprintf(ring_name, sizeof(ring_name), "bench_rx%u_%u",
+				side, q);
+		bench_rx[side][q] = rte_ring_create(ring_name,
+				BENCH_RING_SIZE, rte_socket_id(),
+				RING_F_SP_ENQ | RING_F_SC_DEQ);
+		snprintf(ring_name, sizeof(ring_name), "bench_tx%u_%u",
+				side, q);
+		bench_tx[side][q] = rte_ring_create(ring_name,
+				BENCH_RING_SIZE, rte_socket_id(),
+				RING_F_SC_DEQ);
+		if (bench_rx[side][q] == NULL || bench_tx[side][q] == NULL)
+			rte_panic("bench: cannot create rings of %s\n", name);
+	}
+
+	port = rte_eth_from_rings(name, bench_rx[side], EPC_MAX_PORT_QUEUES,
+			bench_tx[side], EPC_MAX_PORT_QUEUES, rte_socket_id());
+	if (port < 0)
+		rte_panic("bench: cannot create ring port %s\n", name);
+
+	/* ring ports have no MAC of their own, give each the configured
+	 * one so that the DP sees its own L2 address */
+	addr = rte_zmalloc("bench_mac", sizeof(*addr), 0);
+	if (addr == NULL)
+		rte_panic("bench: cannot allocate MAC of %s\n", name);
+	ether_addr_copy(mac, addr);
+	rte_eth_devices[port].data->mac_addrs = addr;
+
+	printf("bench %s port %d\n", name, port);
+	return port;
+}
+
+void
+bench_port_create(struct app_params *app)
+{
+	if (app->spgw_cfg != SPGWU)
+		rte_panic("bench: only SPGWU is supported\n");
+	if (rte_eth_dev_count() != 0)
+		rte_panic("bench: %u ports probed, run with --no-pci\n",
+				rte_eth_dev_count());
+
+	app->s1u_port = bench_ring_port("bench_s1u", S1U_PORT_ID,
+			&app->s1u_ether_addr);
+	app->sgi_port = bench_ring_port("bench_sgi", SGI_PORT_ID,
+			&app->sgi_ether_addr);
+
+	bench_pool = rte_pktmbuf_pool_create("BENCH_POOL", BENCH_NUM_MBUFS,
+			RTE_MEMPOOL_CACHE_MAX_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+			rte_socket_id());
+	if (bench_pool == NULL)
+		rte_panic("bench: cannot create mbuf pool\n");
+
+	bench_tpl_init(app);
+	rte_srand(bench_cfg.seed);
+}
+
+static inline uint32_t
+bench_next_ue(uint32_t side)
+{
+	uint32_t ue = bench_ue[side];
+
+	bench_ue[side] += bench_stride;
+	if (bench_ue[side] >= bench_cfg.ues)
+		bench_ue[side] -= bench_cfg.ues;
+	return ue;
+}
+
+/**
+ * Pick the AS and L4 ports of a pkt of UE ue: one of the per-AS SDF
+ * rules of simu_cp, or the default rule of the direction.
+ */
+static inline void
+bench_flow(uint32_t ue, uint32_t hit, uint32_t side, uint32_t *as,
+		uint16_t *ue_port, uint16_t *as_port)
+{
+	uint32_t n_rules = (side == S1U_PORT_ID) ?
+		bench_cfg.max_ul_rules : bench_cfg.max_dl_rules;
+
+	if (hit && n_rules) {
+		/* UL rule i matches dst, DL rule i src as_ip_start + i */
+		*as = bench_cfg.as_ip_s + ue % n_rules;
+		*ue_port = htons(BENCH_UE_PORT + (ue & 0x3fff));
+		*as_port = htons(BENCH_AS_PORT);
+		return;
+	}
+
+	*as = bench_cfg.as_ip_s + bench_cfg.max_ul_rules +
+		bench_cfg.max_dl_rules + (ue & 0xff);
+	if (side == S1U_PORT_ID) {
+		*ue_port = htons(BENCH_UL_DEF_PORT + ue % BENCH_UL_DEF_RANGE);
+		*as_port = *ue_port;
+	} else {
+		*as_port = htons(BENCH_DL_DEF_SPORT + ue % BENCH_DL_DEF_RANGE);
+		*ue_port = htons(ue % BENCH_DL_DEF_RANGE);
+	}
+}
+
+static inline void
+bench_fill_ul(struct rte_mbuf *m, uint64_t r)
+{
+	uint32_t slot = r % BENCH_SIZE_SLOTS;
+	uint32_t hit = ((r >> 16) % 100) < bench_cfg.rule_pct;
+	uint32_t ue = bench_next_ue(S1U_PORT_ID);
+	uint32_t as;
+	uint16_t ue_port, as_port;
+	struct bench_ul_hdr *h;
+
+	h = (struct bench_ul_hdr *)rte_pktmbuf_append(m,
+			bench_cfg.size_tbl[slot] - ETHER_CRC_LEN +
+			BENCH_GTPU_OVERHEAD);
+	*h = bench_ul_tpl[slot];
+	bench_flow(ue, hit, S1U_PORT_ID, &as, &ue_port, &as_port);
+	/* simu_cp UE s has uplink teid s + 1 */
+	h->gtpu_teid = htonl(ue + 1);
+	h->in_ip.src_addr = htonl(bench_cfg.ue_ip_s + ue);
+	h->in_ip.dst_addr = htonl(as);
+	h->in_ip.hdr_checksum = rte_ipv4_cksum(&h->in_ip);
+	h->in_udp.src_port = ue_port;
+	h->in_udp.dst_port = as_port;
+}
+
+static inline void
+bench_fill_dl(struct rte_mbuf *m, uint64_t r)
+{
+	uint32_t slot = r % BENCH_SIZE_SLOTS;
+	uint32_t hit = ((r >> 16) % 100) < bench_cfg.rule_pct;
+	uint32_t ue = bench_next_ue(SGI_PORT_ID);
+	uint32_t as;
+	uint16_t ue_port, as_port;
+	struct bench_dl_hdr *h;
+
+	h = (struct bench_dl_hdr *)rte_pktmbuf_append(m,
+			bench_cfg.size_tbl[slot] - ETHER_CRC_LEN);
+	*h = bench_dl_tpl[slot];
+	bench_flow(ue, hit, SGI_PORT_ID, &as, &ue_port, &as_port);
+	h->ip.src_addr = htonl(as);
+	h->ip.dst_addr = htonl(bench_cfg.ue_ip_s + ue);
+	h->ip.hdr_checksum = rte_ipv4_cksum(&h->ip);
+	h->udp.src_port = as_port;
+	h->udp.dst_port = ue_port;
+}
+
+static void
+bench_gen(uint32_t side, uint32_t n)
+{
+	struct rte_mbuf *pkts[BENCH_BURST];
+	struct bench_ctrs *c = &bench_ctrs[side];
+	struct rte_ring *r;
+	uint32_t i, sent;
+
+	if (n == 0)
+		return;
+	if (rte_pktmbuf_alloc_bulk(bench_pool, pkts, n) != 0) {
+		c->no_mbuf += n;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (side == S1U_PORT_ID)
+			bench_fill_ul(pkts[i], rte_rand());
+		else
+			bench_fill_dl(pkts[i], rte_rand());
+	}
+
+	r = bench_rx[side][bench_q[side]];
+	if (++bench_q[side] == epc_app.n_queues)
+		bench_q[side] = 0;
+	sent = rte_ring_sp_enqueue_burst(r, (void **)pkts, n);
+	c->gen += sent;
+	c->rx_full += n - sent;
+	for (i = sent; i < n; i++)
+		rte_pktmbuf_free(pkts[i]);
+}
+
+/**
+ * Turn an ARP request of the DP into the reply of the bench peer.
+ *
+ * @return
+ *	- 1 if m was an ARP request, and is queued back to the DP
+ *	- 0 otherwise
+ */
+static int
+bench_arp_reply(uint32_t side, struct rte_mbuf *m)
+{
+	struct ether_hdr *eth = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	struct arp_hdr *arp = (struct arp_hdr *)(eth + 1);
+	uint32_t ip;
+
+	if (eth->ether_type != htons(ETHER_TYPE_ARP)
+			|| arp->arp_op != htons(ARP_OP_REQUEST))
+		return 0;
+
+	arp->arp_op = htons(ARP_OP_REPLY);
+	ether_addr_copy(&arp->arp_data.arp_sha, &arp->arp_data.arp_tha);
+	ether_addr_copy(&bench_peer_mac, &arp->arp_data.arp_sha);
+	ip = arp->arp_data.arp_sip;
+	arp->arp_data.arp_sip = arp->arp_data.arp_tip;
+	arp->arp_data.arp_tip = ip;
+	ether_addr_copy(&eth->s_addr, &eth->d_addr);
+	ether_addr_copy(&bench_peer_mac, &eth->s_addr);
+
+	if (rte_ring_sp_enqueue(bench_rx[side][0], m) != 0)
+		rte_pktmbuf_free(m);
+	bench_ctrs[side].arp++;
+	return 1;
+}
+
+static void
+bench_drain(uint32_t side)
+{
+	struct rte_mbuf *pkts[BENCH_BURST];
+	struct bench_ctrs *c = &bench_ctrs[side];
+	uint32_t q, i, n;
+
+	for (q = 0; q < EPC_MAX_PORT_QUEUES; q++) {
+		n = rte_ring_sc_dequeue_burst(bench_tx[side][q],
+				(void **)pkts, BENCH_BURST);
+		for (i = 0; i < n; i++) {
+			if (bench_arp_reply(side, pkts[i]))
+				continue;
+			c->tx_pkts++;
+			c->tx_bytes += rte_pktmbuf_pkt_len(pkts[i]);
+			rte_pktmbuf_free(pkts[i]);
+		}
+	}
+}
+
+static void
+bench_snap(struct bench_snap *s, uint64_t now)
+{
+	uint32_t lcore, i;
+
+	s->tsc = now;
+	memcpy(s->ctrs, bench_ctrs, sizeof(s->ctrs));
+	for (lcore = 0; lcore < DP_MAX_LCORE; lcore++) {
+		struct epc_lcore_config *config = &epc_app.lcores[lcore];
+
+		for (i = 0; i < (uint32_t)config->allocated; i++)
+			s->stage[lcore][i] = config->launch[i].stats;
+	}
+	for (i = 0; i < epc_ring_stats_count; i++)
+		s->ring_drops[i] = epc_ring_stats[i].n_drops;
+}
+
+#define BENCH_DELTA(f)	(bench_end.f - bench_start.f)
+
+static void
+bench_report(void)
+{
+	FILE *out[2] = {stdout, NULL};
+	double sec = (double)BENCH_DELTA(tsc) / bench_hz;
+	uint64_t gen = 0, rx_full = 0, no_mbuf = 0, pkts = 0, bytes = 0;
+	uint64_t busy = 0, ul, dl;
+	uint32_t lcore, i, f;
+
+	for (i = 0; i < NUM_SPGW_PORTS; i++) {
+		gen += BENCH_DELTA(ctrs[i].gen);
+		rx_full += BENCH_DELTA(ctrs[i].rx_full);
+		no_mbuf += BENCH_DELTA(ctrs[i].no_mbuf);
+		pkts += BENCH_DELTA(ctrs[i].tx_pkts);
+		bytes += BENCH_DELTA(ctrs[i].tx_bytes);
+	}
+	/* UL pkts leave on SGi, DL pkts on S1U */
+	ul = BENCH_DELTA(ctrs[SGI_PORT_ID].tx_pkts);
+	dl = BENCH_DELTA(ctrs[S1U_PORT_ID].tx_pkts);
+	for (lcore = 0; lcore < DP_MAX_LCORE; lcore++)
+		for (i = 0; i < (uint32_t)epc_app.lcores[lcore].allocated; i++)
+			if (lcore != (uint32_t)epc_app.core_bench)
+				busy += BENCH_DELTA(stage[lcore][i].busy_cycles);
+
+	if (bench_cfg.report[0]) {
+		out[1] = fopen(bench_cfg.report, "w");
+		if (out[1] == NULL)
+			RTE_LOG(ERR, DP, "bench: cannot open %s\n",
+					bench_cfg.report);
+	}
+
+	for (f = 0; f < RTE_DIM(out) && out[f] != NULL; f++) {
+		FILE *o = out[f];
+
+		fprintf(o, "bench_ues %u\n", bench_cfg.ues);
+		fprintf(o, "bench_sec %.3f\n", sec);
+		fprintf(o, "offered_mpps %.3f\n",
+				(gen + rx_full + no_mbuf) / sec / 1e6);
+		fprintf(o, "mpps %.3f\n", pkts / sec / 1e6);
+		fprintf(o, "ul_mpps %.3f\n", ul / sec / 1e6);
+		fprintf(o, "dl_mpps %.3f\n", dl / sec / 1e6);
+		/* L2 incl. CRC */
+		fprintf(o, "gbps %.3f\n",
+				(bytes + pkts * ETHER_CRC_LEN) * 8 / sec / 1e9);
+		fprintf(o, "cycles_per_pkt %"PRIu64"\n",
+				pkts ? busy / pkts : 0);
+		fprintf(o, "drop_rx_full %"PRIu64"\n", rx_full);
+		fprintf(o, "drop_no_mbuf %"PRIu64"\n", no_mbuf);
+		/* includes the pkts in flight at the end */
+		fprintf(o, "drop_dp %"PRIu64"\n",
+				gen > pkts ? gen - pkts : 0);
+		for (i = 0; i < epc_ring_stats_count; i++)
+			fprintf(o, "drop_ring_%s %"PRIu64"\n",
+					epc_ring_stats[i].name,
+					BENCH_DELTA(ring_drops[i]));
+		for (lcore = 0; lcore < DP_MAX_LCORE; lcore++) {
+			struct epc_lcore_config *config =
+				&epc_app.lcores[lcore];
+
+			for (i = 0; i < (uint32_t)config->allocated; i++) {
+				uint64_t p = BENCH_DELTA(stage[lcore][i].pkts);
+
+				fprintf(o, "stage_%u_%s_pkts %"PRIu64"\n",
+						lcore, config->launch[i].name, p);
+				fprintf(o, "stage_%u_%s_cycles_per_pkt "
+						"%"PRIu64"\n", lcore,
+						config->launch[i].name, p ?
+						BENCH_DELTA(stage[lcore][i].
+							busy_cycles) / p : 0);
+			}
+		}
+	}
+	if (out[1] != NULL)
+		fclose(out[1]);
+}
+
+void
+bench_core(__rte_unused void *arg)
+{
+	uint64_t now = rte_rdtsc();
+	uint32_t budget = 2 * BENCH_BURST, n_ul;
+
+	switch (bench_phase) {
+	case BENCH_INIT:
+		/* no pkts before the sessions exist */
+		budget = 0;
+		if (!simu_cp_ready)
+			break;
+		bench_hz = rte_get_tsc_hz();
+		bench_t0 = now;
+		bench_t_run = now + bench_cfg.warmup_sec * bench_hz;
+		bench_t_end = bench_t_run + bench_cfg.duration_sec * bench_hz;
+		bench_phase = BENCH_WARMUP;
+		RTE_LOG(INFO, DP, "bench: warming up for %us\n",
+				bench_cfg.warmup_sec);
+		break;
+	case BENCH_WARMUP:
+		if (now < bench_t_run)
+			break;
+		bench_snap(&bench_start, now);
+		bench_phase = BENCH_RUN;
+		RTE_LOG(INFO, DP, "bench: measuring for %us\n",
+				bench_cfg.duration_sec);
+		break;
+	case BENCH_RUN:
+		if (now < bench_t_end)
+			break;
+		bench_snap(&bench_end, now);
+		bench_phase = BENCH_DONE;
+		bench_report();
+		if (bench_cfg.exit_on_done)
+			kill(getpid(), SIGINT);
+		break;
+	case BENCH_DONE:
+		budget = 0;
+		break;
+	}
+
+	if (budget && bench_cfg.pps) {
+		uint64_t offered = 0, due;
+		uint32_t i;
+
+		for (i = 0; i < NUM_SPGW_PORTS; i++)
+			offered += bench_ctrs[i].gen + bench_ctrs[i].rx_full +
+				bench_ctrs[i].no_mbuf;
+		due = (double)(now - bench_t0) * bench_cfg.pps / bench_hz;
+		if (due <= offered)
+			budget = 0;
+		else if (due - offered < budget)
+			budget = due - offered;
+	}
+
+	n_ul = (budget * bench_cfg.ul_pct + bench_ul_rem) / 100;
+	bench_ul_rem = (budget * bench_cfg.ul_pct + bench_ul_rem) % 100;
+	bench_gen(S1U_PORT_ID, RTE_MIN(n_ul, (uint32_t)BENCH_BURST));
+	bench_gen(SGI_PORT_ID, RTE_MIN(budget - n_ul, (uint32_t)BENCH_BURST));
+
+	bench_drain(S1U_PORT_ID);
+	bench_drain(SGI_PORT_ID);
+}
+#endif /* DP_BENCH */
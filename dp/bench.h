@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the DP capacity benchmark.
+ *
+ * With --bench the S1U and SGi ports are ring PMDs owned by the bench
+ * lcore. It synthesizes UL GTP-U and DL SGi traffic for the UEs created
+ * by simu_cp from ../config/simu_cp.cfg, with the packet size and SDF
+ * rule mix of the bench config file, drains and counts what the DP
+ * transmits, and reports Mpps, Gbps, cycles per packet and the drops of
+ * each stage for the measured interval.
+ */
+#ifdef DP_BENCH
+#include <stdint.h>
+#include <limits.h>
+
+#include "main.h"
+
+/** Pkts generated and drained per ring per call */
+#define BENCH_BURST		32
+/** Slots of the weighted packet size table */
+#define BENCH_SIZE_SLOTS	100
+/** Entries of the rx and tx rings of the bench ports, power of 2 */
+#define BENCH_RING_SIZE		1024
+/** mbufs of the bench traffic pool */
+#define BENCH_NUM_MBUFS		(1 << 16)
+/** Max frame size, incl. CRC */
+#define BENCH_MAX_FRAME		1518
+/** Min frame size, incl. CRC */
+#define BENCH_MIN_FRAME		64
+
+/**
+ * Bench parameters, read from the bench config file.
+ */
+struct bench_cfg {
+	uint32_t ues;		/** UEs addressed, 0- all simu_cp sessions */
+	uint32_t ul_pct;	/** percent of pkts sent uplink */
+	uint32_t rule_pct;	/** percent of pkts hitting a per-AS SDF rule */
+	uint64_t pps;		/** offered load, 0- as fast as rx accepts */
+	uint32_t warmup_sec;	/** seconds before the measurement starts */
+	uint32_t duration_sec;	/** seconds measured */
+	uint32_t seed;		/** seed of the size, rule and direction mix */
+	uint32_t exit_on_done;	/** stop the DP after the report */
+	/** SGi side frame sizes incl. CRC, weighted over the slots */
+	uint16_t size_tbl[BENCH_SIZE_SLOTS];
+	char report[PATH_MAX];	/** report file, empty- stdout only */
+
+	/* from simu_cp.cfg, so pkts match the simulated sessions */
+	uint32_t enb_ip;	/** eNB ip, host order */
+	uint32_t ue_ip_s;	/** ip of simu_cp UE 0, host order */
+	uint32_t as_ip_s;	/** ip of the first AS, host order */
+	uint32_t max_ue_sess;	/** simu_cp sessions */
+	uint32_t max_ul_rules;	/** UL SDF rules, one per AS */
+	uint32_t max_dl_rules;	/** DL SDF rules, one per AS */
+};
+
+/** Set when the DP runs the benchmark */
+extern int bench_on;
+
+/**
+ * Parse the bench config file and enable the benchmark.
+ *
+ * @param path
+ *	bench config file.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on parse error
+ */
+int bench_parse(const char *path);
+
+/**
+ * Create the S1U and SGi ring ports with the configured port MACs.
+ * Called after the config is parsed, the DP must run with no other
+ * ports (--no-pci).
+ *
+ * @param app
+ *	DP config, s1u_port and sgi_port are set to the ring ports.
+ *
+ * @return
+ *	None
+ */
+void bench_port_create(struct app_params *app);
+
+/**
+ * Bench lcore. Generates and drains one burst per port per call, and
+ * reports once the measurement interval elapsed.
+ *
+ * @param arg
+ *	unused.
+ *
+ * @return
+ *	None
+ */
+void bench_core(void *arg);
+
+#endif /* DP_BENCH */
+#endif /* _BENCH_H_ */
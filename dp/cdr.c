@@ -35,6 +35,14 @@
 
 #include <rte_ether.h>
 #include <rte_debug.h>
+#include <rte_atomic.h>
+#include <rte_spinlock.h>
+#ifdef CDR_ASYNC
+#include <rte_errno.h>
+#include <rte_ring.h>
+#include <rte_mempool.h>
+#include <rte_cycles.h>
+#endif
 
 #include "cdr.h"
 #include "master_cdr.h"
@@ -58,6 +66,79 @@ FILE *mtr_file;
 
 uint64_t cdr_count;
 
+/** master record of cdr_file */
+static struct cdr_file_summary cdr_summary;
+
+static struct cdr_time cdr_clock;
+static rte_spinlock_t cdr_clock_lock = RTE_SPINLOCK_INITIALIZER;
+static const char *cdr_time_formats[CDR_TIME_NUM_FMT] = {
+	[CDR_TIME_RECORD] = RECORD_TIME_FORMAT,
+	[CDR_TIME_LOG] = LOG_TIME_FORMAT,
+};
+
+#ifdef CDR_ASYNC
+/**
+ * CDR queued to the writer lcore. Values are taken from the field
+ * callbacks by the producer, the writer only formats them.
+ */
+struct cdr_record {
+	uint64_t val[NUM_CDR_FIELDS];	/** numeric fields, time of time field */
+	uint16_t str[NUM_CDR_FIELDS];	/** offset of string fields in buf */
+	uint16_t len;			/** bytes used in buf */
+	char buf[CDR_RECORD_STR_SIZE];
+};
+
+static struct rte_ring *cdr_ring;
+static struct rte_mempool *cdr_pool;
+/** CDRs queued by the producers */
+static volatile uint64_t cdr_queued;
+/** CDRs written and flushed by the writer lcore */
+static volatile uint64_t cdr_written;
+uint64_t cdr_stalls;
+#endif /* CDR_ASYNC */
+#ifdef CDR_BINARY
+FILE *cdr_bin_file;
+#endif
+
+void
+cdr_time_refresh(void)
+{
+	time_t t = time(NULL);
+	struct tm tm;
+	unsigned i;
+
+	/* localtime takes the glibc tz lock, only once per second */
+	if (likely(t == cdr_clock.t))
+		return;
+	if (!rte_spinlock_trylock(&cdr_clock_lock))
+		return;
+	if ((t != cdr_clock.t) && (localtime_r(&t, &tm) != NULL)) {
+		++cdr_clock.seq;
+		rte_smp_wmb();
+		for (i = 0; i < CDR_TIME_NUM_FMT; ++i)
+			strftime(cdr_clock.str[i], RECORD_TIME_LENGTH,
+					cdr_time_formats[i], &tm);
+		cdr_clock.t = t;
+		rte_smp_wmb();
+		++cdr_clock.seq;
+	}
+	rte_spinlock_unlock(&cdr_clock_lock);
+}
+
+void
+cdr_time_get(char *buf, enum cdr_time_fmt fmt)
+{
+	uint32_t seq;
+
+	cdr_time_refresh();
+	do {
+		seq = cdr_clock.seq;
+		rte_smp_rmb();
+		memcpy(buf, cdr_clock.str[fmt], RECORD_TIME_LENGTH);
+		rte_smp_rmb();
+	} while ((seq & 1) || (seq != cdr_clock.seq));
+}
+
 /* CDR IP to string helper functions */
 const char *
 iptoa(struct ip_addr addr)
@@ -107,11 +188,8 @@ cdr_time_cb(struct dp_session_info *session,
 		struct dp_pcc_rules *pcc_rule,
 		struct adc_rules *adc_rule) {
 	static char time_str[RECORD_TIME_LENGTH];
-	time_t t = time(NULL);
-	struct tm *tmp = localtime(&t);
-	if (tmp == NULL)
-		return NULL;
-	strftime(time_str, RECORD_TIME_LENGTH, RECORD_TIME_FORMAT, tmp);
+
+	cdr_time_get(time_str, CDR_TIME_RECORD);
 	return time_str;
 }
 
@@ -374,6 +452,8 @@ static void
 write_to_cdr(void)
 {
 	fflush(cdr_file_stream);
+	cdr_file_summary_update(&cdr_summary, cdr_file_stream_ptr,
+			cdr_file_stream_sizeloc);
 	fwrite(cdr_file_stream_ptr, sizeof(char),
 			cdr_file_stream_sizeloc, cdr_file);
 	rewind(cdr_file_stream);
@@ -395,6 +475,257 @@ export_cdr_field_headers(void)
 	write_to_cdr();
 }
 
+#ifdef CDR_ASYNC
+/**
+ * Copy string field i to rec, truncated to the space left.
+ */
+static inline void
+cdr_record_str(struct cdr_record *rec, unsigned i, const char *s)
+{
+	size_t room = sizeof(rec->buf) - rec->len;
+	size_t n;
+
+	if (s == NULL)
+		s = "(null)";
+	if (room <= 1) {
+		/* last byte is always the terminator */
+		rec->str[i] = sizeof(rec->buf) - 1;
+		return;
+	}
+	n = strnlen(s, room - 1);
+	memcpy(rec->buf + rec->len, s, n);
+	rec->buf[rec->len + n] = '\0';
+	rec->str[i] = rec->len;
+	rec->len += n + 1;
+}
+
+/**
+ * Fill a CDR buffer from the field callbacks and queue it to the writer
+ * lcore. Waits for the writer if all buffers are in use, records are
+ * never dropped.
+ */
+static void
+queue_record(struct dp_session_info *session,
+		struct chrg_data_vol *vol,
+		struct dp_pcc_rules *pcc_rule,
+		struct adc_rules *adc_rule)
+{
+	struct cdr_record *rec;
+	unsigned i;
+
+	while (rte_mempool_get(cdr_pool, (void **)&rec) < 0) {
+		++cdr_stalls;
+		rte_pause();
+	}
+
+	rec->len = 0;
+	rec->buf[sizeof(rec->buf) - 1] = '\0';
+	for (i = 0; i < RTE_DIM(cdr_fields); ++i) {
+		switch (cdr_fields[i].type) {
+		case CDR_VALUE:
+			/* record counter, numbered by the writer */
+			break;
+		case CDR_CB_STR:
+			if (i == CDR_TIME_FIELD_INDEX) {
+				/* formatted by the writer */
+				rec->val[i] = time(NULL);
+				break;
+			}
+			cdr_record_str(rec, i, cdr_fields[i].cb_str(session,
+						vol, pcc_rule, adc_rule));
+			break;
+		case CDR_CB_8:
+			rec->val[i] = cdr_fields[i].cb_8(session,
+					vol, pcc_rule, adc_rule);
+			break;
+		case CDR_CB_32:
+			rec->val[i] = cdr_fields[i].cb_32(session,
+					vol, pcc_rule, adc_rule);
+			break;
+		case CDR_CB_64:
+			rec->val[i] = cdr_fields[i].cb_64(session,
+					vol, pcc_rule, adc_rule);
+			break;
+		}
+	}
+
+	__sync_add_and_fetch(&cdr_queued, 1);
+	/* pool holds less buffers than the ring, enqueue cannot fail */
+	rte_ring_mp_enqueue(cdr_ring, rec);
+}
+
+/**
+ * Copy the cached wall clock string if it is still of second t.
+ * @return
+ *  0 - on success
+ *  -1 - clock is on another second
+ */
+static int
+cdr_time_get_at(time_t t, char *buf, enum cdr_time_fmt fmt)
+{
+	uint32_t seq;
+	int hit;
+
+	do {
+		seq = cdr_clock.seq;
+		rte_smp_rmb();
+		hit = (cdr_clock.t == t);
+		if (hit)
+			memcpy(buf, cdr_clock.str[fmt], RECORD_TIME_LENGTH);
+		rte_smp_rmb();
+	} while ((seq & 1) || (seq != cdr_clock.seq));
+	return hit ? 0 : -1;
+}
+
+/**
+ * Format time field of rec, the string is reused within a second.
+ */
+static const char *
+cdr_record_time(struct cdr_record *rec)
+{
+	static char time_str[RECORD_TIME_LENGTH];
+	static time_t last;
+	time_t t = rec->val[CDR_TIME_FIELD_INDEX];
+	struct tm tm;
+
+	if (t == last && time_str[0] != '\0')
+		return time_str;
+	/* usual case, record is from the current second. The clock is
+	 * checked and copied as one, it may tick in between */
+	if (cdr_time_get_at(t, time_str, CDR_TIME_RECORD) < 0) {
+		if (localtime_r(&t, &tm) == NULL)
+			return NULL;
+		strftime(time_str, RECORD_TIME_LENGTH, RECORD_TIME_FORMAT,
+				&tm);
+	}
+	last = t;
+	return time_str;
+}
+
+/**
+ * Format rec as a CSV line into cdr_file_stream.
+ */
+static void
+write_record_csv(struct cdr_record *rec)
+{
+	unsigned i;
+
+	for (i = 0; i < RTE_DIM(cdr_fields); ++i) {
+		switch (cdr_fields[i].type) {
+		case CDR_VALUE:
+			fprintf(cdr_file_stream, cdr_fields[i].format_specifier,
+					*cdr_fields[i].value);
+			break;
+		case CDR_CB_STR:
+			fprintf(cdr_file_stream, cdr_fields[i].format_specifier,
+					(i == CDR_TIME_FIELD_INDEX) ?
+					cdr_record_time(rec) :
+					rec->buf + rec->str[i]);
+			break;
+		default:
+			fprintf(cdr_file_stream, cdr_fields[i].format_specifier,
+					rec->val[i]);
+			break;
+		}
+	}
+	++cdr_count;
+	fprintf(cdr_file_stream, "\n");
+	cdr_file_summary_add(&cdr_summary, rec->val[CDR_TIME_FIELD_INDEX]);
+}
+
+#ifdef CDR_BINARY
+/**
+ * Write rec to the binary CDR file, before the record counter is
+ * incremented by write_record_csv().
+ */
+static void
+write_record_bin(struct cdr_record *rec)
+{
+	uint8_t out[sizeof(uint16_t) + NUM_CDR_FIELDS * sizeof(uint64_t)
+			+ NUM_CDR_FIELDS + CDR_RECORD_STR_SIZE];
+	uint16_t len = sizeof(uint16_t);
+	uint64_t v;
+	size_t n;
+	unsigned i;
+
+	for (i = 0; i < RTE_DIM(cdr_fields); ++i) {
+		if (cdr_fields[i].type == CDR_CB_STR
+				&& i != CDR_TIME_FIELD_INDEX) {
+			n = strnlen(rec->buf + rec->str[i], UINT8_MAX);
+			out[len++] = n;
+			memcpy(out + len, rec->buf + rec->str[i], n);
+			len += n;
+			continue;
+		}
+		v = (cdr_fields[i].type == CDR_VALUE) ?
+				*cdr_fields[i].value : rec->val[i];
+		memcpy(out + len, &v, sizeof(v));
+		len += sizeof(v);
+	}
+	*(uint16_t *)out = len - sizeof(uint16_t);
+	fwrite(out, 1, len, cdr_bin_file);
+}
+
+/**
+ * Writes the binary CDR file header
+ */
+static void
+export_cdr_bin_header(void)
+{
+	uint16_t v;
+	uint8_t t, n;
+	unsigned i;
+
+	fwrite(CDR_BIN_MAGIC, 1, sizeof(CDR_BIN_MAGIC), cdr_bin_file);
+	v = CDR_BIN_VERSION;
+	fwrite(&v, sizeof(v), 1, cdr_bin_file);
+	v = RTE_DIM(cdr_fields);
+	fwrite(&v, sizeof(v), 1, cdr_bin_file);
+	for (i = 0; i < RTE_DIM(cdr_fields); ++i) {
+		t = ((cdr_fields[i].type == CDR_CB_STR)
+				&& (i != CDR_TIME_FIELD_INDEX)) ?
+				CDR_BIN_STR : CDR_BIN_U64;
+		n = strlen(cdr_fields[i].header);
+		fwrite(&t, 1, 1, cdr_bin_file);
+		fwrite(&n, 1, 1, cdr_bin_file);
+		fwrite(cdr_fields[i].header, 1, n, cdr_bin_file);
+	}
+	fflush(cdr_bin_file);
+}
+#endif /* CDR_BINARY */
+
+void
+cdr_writer_core(__rte_unused void *args)
+{
+	struct cdr_record *rec[CDR_WRITER_BURST];
+	unsigned i, n;
+
+	n = rte_ring_sc_dequeue_burst(cdr_ring, (void **)rec,
+			CDR_WRITER_BURST);
+	if (n == 0)
+		return;
+
+	for (i = 0; i < n; ++i) {
+#ifdef CDR_BINARY
+		write_record_bin(rec[i]);
+#endif
+		write_record_csv(rec[i]);
+	}
+	rte_mempool_put_bulk(cdr_pool, (void **)rec, n);
+	write_to_cdr();
+
+	/* large writes while busy, flush as soon as the queue is drained */
+	if (rte_ring_empty(cdr_ring)) {
+		fflush(cdr_file);
+#ifdef CDR_BINARY
+		fflush(cdr_bin_file);
+#endif
+	}
+	__sync_add_and_fetch(&cdr_written, n);
+	epc_stage_pkts_add(n);
+}
+#endif /* CDR_ASYNC */
+
 /**
  * common function to export pcc & adc cdr
  * @param session
@@ -426,6 +757,10 @@ export_record(struct dp_session_info *session,
 			|| vol->dl_drop.pkt_count || vol->ul_drop.pkt_count))
 		return;
 
+#ifdef CDR_ASYNC
+	queue_record(session, vol, pcc_rule, adc_rule);
+	return;
+#endif
 	for (i = 0; i < RTE_DIM(cdr_fields); ++i) {
 		switch (cdr_fields[i].type) {
 		case CDR_VALUE:
@@ -460,6 +795,7 @@ export_record(struct dp_session_info *session,
 	}
 	++cdr_count;
 	fprintf(cdr_file_stream, "\n");
+	cdr_file_summary_add(&cdr_summary, cdr_clock.t);
 
 	write_to_cdr();
 }
@@ -504,17 +840,12 @@ create_sys_path(char *path)
 static void
 create_new_cdr_file(void)
 {
-	char timestamp[NAME_MAX];
+	char timestamp[RECORD_TIME_LENGTH];
 	char filename[PATH_MAX];
 	int ret;
-	time_t t = time(NULL);
-	struct tm *tmp = localtime(&t);
-
-	if (tmp == NULL)
-		rte_panic("Failed to obtain CDR timestamp\n");
 
-	ret = strftime(timestamp, NAME_MAX, "%Y%m%d%H%M%S", tmp);
-	if (ret == 0)
+	cdr_time_get(timestamp, CDR_TIME_RECORD);
+	if (timestamp[0] == '\0')
 		rte_panic("Failed to generate CDR timestamp\n");
 
 #ifdef SDN_ODL_BUILD
@@ -533,12 +864,30 @@ create_new_cdr_file(void)
 	printf("Logging CDR Records to %s\n", filename);
 
 	cdr_count = 0;
+	cdr_file_summary_init(&cdr_summary, filename);
 	cdr_file = fopen(filename, "w");
 	if (!cdr_file)
 		rte_panic("CDR file %s failed to open for writing\n - %s (%d)",
 					filename, strerror(errno), errno);
 
+#ifdef CDR_ASYNC
+	/* only the writer lcore writes, flushed when its queue is empty */
+	setvbuf(cdr_file, NULL, _IOFBF, CDR_FILE_BUF_SIZE);
+#else
 	setvbuf(cdr_file, NULL, _IOLBF, BUFFER_SIZE);
+#endif
+
+#ifdef CDR_BINARY
+	/* same name as the CSV file, never picked up as a .cur file */
+	strcpy(filename + ret - strlen(CDR_CUR_EXTENSION), CDR_BIN_EXTENSION);
+	printf("Logging binary CDR Records to %s\n", filename);
+	cdr_bin_file = fopen(filename, "w");
+	if (!cdr_bin_file)
+		rte_panic("CDR file %s failed to open for writing\n - %s (%d)",
+					filename, strerror(errno), errno);
+	setvbuf(cdr_bin_file, NULL, _IOFBF, CDR_FILE_BUF_SIZE);
+	export_cdr_bin_header();
+#endif
 
 	cdr_file_stream = open_memstream(&cdr_file_stream_ptr,
 			&cdr_file_stream_sizeloc);
@@ -547,6 +896,9 @@ create_new_cdr_file(void)
 					strerror(errno), errno);
 
 	export_cdr_field_headers();
+#ifdef CDR_ASYNC
+	fflush(cdr_file);
+#endif
 }
 
 void
@@ -554,10 +906,19 @@ cdr_close(void)
 {
 	if (cdr_file) {
 		FILE *old_cdr_file = cdr_file;
+#ifdef CDR_ASYNC
+		/* wait for the writer lcore to drain and flush its queue */
+		while (cdr_written != cdr_queued)
+			rte_pause();
+#endif
+#ifdef CDR_BINARY
+		fclose(cdr_bin_file);
+		cdr_bin_file = NULL;
+#endif
 		cdr_file = stderr;
 
 		fclose(old_cdr_file);
-		finalize_cur_cdrs(cdr_path);
+		finalize_cur_cdrs(cdr_path, &cdr_summary);
 	}
 
 	free_master_cdr();
@@ -602,6 +963,20 @@ cdr_init(void)
 {
 	create_sys_path(cdr_path);
 
+#ifdef CDR_ASYNC
+	cdr_ring = rte_ring_create("cdr_ring", CDR_RING_SIZE, rte_socket_id(),
+			RING_F_SC_DEQ);
+	if (cdr_ring == NULL)
+		rte_panic("Failed to create CDR ring - %s\n",
+				rte_strerror(rte_errno));
+	/* one buffer less than the ring holds */
+	cdr_pool = rte_mempool_create("cdr_pool", CDR_RING_SIZE - 1,
+			sizeof(struct cdr_record), 0, 0, NULL, NULL, NULL, NULL,
+			rte_socket_id(), 0);
+	if (cdr_pool == NULL)
+		rte_panic("Failed to create CDR pool - %s\n",
+				rte_strerror(rte_errno));
+#endif
 	create_new_cdr_file();
 
 	mtr_init();
@@ -628,13 +1003,9 @@ export_session_adc_record(struct adc_rules *adc_rule,
 void export_mtr(struct dp_session_info *session,
 		char *name, uint32_t id, uint64_t drops)
 {
-	/* create time string */
-	char time_str[30];
-	time_t t = time(NULL);
-	struct tm *tmp = localtime(&t);
-	if (tmp == NULL)
-		return;
-	strftime(time_str, sizeof(time_str), "%y%m%d_%H%M%S", tmp);
+	char time_str[RECORD_TIME_LENGTH];
+
+	cdr_time_get(time_str, CDR_TIME_LOG);
 	fprintf(mtr_file, "%s,%s,%s,%d,%"PRIu64"\n",
 				time_str,
 				iptoa(session->ue_addr),
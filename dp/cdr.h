@@ -21,6 +21,8 @@
  * This file contains function prototypes of User data
  * PCC and ADC charging records.
  */
+#include <time.h>
+
 #include "main.h"
 
 #define CDR_CUR_EXTENSION ".cur"
@@ -32,8 +34,42 @@
 
 #define RECORD_TIME_FORMAT "%Y%m%d%H%M%S"
 #define RECORD_TIME_LENGTH 16 /* buffer size for RECORD_TIME_FORMAT-ed string */
+#define LOG_TIME_FORMAT "%y%m%d_%H%M%S" /* session CDR and meter logs */
 #define BUFFER_SIZE 4096
 
+#ifdef CDR_ASYNC
+/** CDRs queued to the writer lcore, power of 2 */
+#define CDR_RING_SIZE        (1 << 14)
+/** CDRs formatted by the writer lcore per call */
+#define CDR_WRITER_BURST     64
+/** string storage of a queued CDR */
+#define CDR_RECORD_STR_SIZE  512
+/** stdio buffer of the CDR files, written out in one go */
+#define CDR_FILE_BUF_SIZE    (1 << 20)
+#endif /* CDR_ASYNC */
+
+#ifdef CDR_BINARY
+#ifndef CDR_ASYNC
+#error "CDR_BINARY requires CDR_ASYNC"
+#endif
+#define CDR_BIN_EXTENSION ".bin"
+/**
+ * Binary CDR file, written next to the CSV file. All integers are in
+ * host byte order.
+ *
+ * header: CDR_BIN_MAGIC (8 bytes), uint16 version, uint16 number of
+ *	fields, then per field uint8 type (CDR_BIN_U64 or CDR_BIN_STR),
+ *	uint8 name length and the name.
+ * record: uint16 length of rest of record, then per field either
+ *	an uint64 or an uint8 string length and the string. The time
+ *	field is an uint64 of seconds since the epoch.
+ */
+#define CDR_BIN_MAGIC        "NGICCDR"
+#define CDR_BIN_VERSION      1
+#define CDR_BIN_U64          0
+#define CDR_BIN_STR          1
+#endif /* CDR_BINARY */
+
 
 /* cdr field type callbacks
  * all callbacks must have the same parameters
@@ -68,9 +104,46 @@ struct cdr_field_t {
 	};
 };
 
+/** formats of the cached wall clock */
+enum cdr_time_fmt {
+	CDR_TIME_RECORD,	/** RECORD_TIME_FORMAT */
+	CDR_TIME_LOG,		/** LOG_TIME_FORMAT */
+	CDR_TIME_NUM_FMT,
+};
+
+/**
+ * Wall clock of the current second, formatted once per second for all
+ * CDR producers. Readers retry while seq is odd or changed.
+ */
+struct cdr_time {
+	volatile uint32_t seq;
+	volatile time_t t;
+	char str[CDR_TIME_NUM_FMT][RECORD_TIME_LENGTH];
+};
+
 extern struct cdr_field_t cdr_fields[NUM_CDR_FIELDS];
 extern char *cdr_path;
 
+/**
+ * Reformat the cached wall clock if the second changed. Called by the
+ * stats core and by readers, only one caller formats at a time.
+ */
+void
+cdr_time_refresh(void);
+
+/**
+ * Copy the cached wall clock string.
+ * @param buf
+ *	buffer of RECORD_TIME_LENGTH bytes.
+ * @param fmt
+ *	format of the string.
+ *
+ * @return
+ * Void
+ */
+void
+cdr_time_get(char *buf, enum cdr_time_fmt fmt);
+
 /**
 * Creates file system path recursively
 */
@@ -178,4 +251,21 @@ export_cdr_record(struct dp_session_info *session, char *name,
  */
 void export_mtr(struct dp_session_info *session, char *name,
 		uint32_t id, uint64_t drops);
+
+#ifdef CDR_ASYNC
+/**
+ * CDR writer lcore. Formats the CDRs queued by export_record() and
+ * writes them out, the files are flushed whenever the queue is empty.
+ *
+ * @param args
+ *	unused.
+ *
+ * @return
+ * Void
+ */
+void cdr_writer_core(__rte_unused void *args);
+
+/** Times a CDR producer waited for a free CDR buffer */
+extern uint64_t cdr_stalls;
+#endif /* CDR_ASYNC */
 #endif /* _CDR_H */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef CDR_COUNTER_SHARDS
+#include <string.h>
+#include <rte_malloc.h>
+#include <rte_mempool.h>
+#include <rte_errno.h>
+
+#include "main.h"
+#include "qsbr.h"
+#include "cdr_shard.h"
+
+struct chrg_data_vol *cdr_shard[DP_MAX_LCORE];
+
+/**
+ * Pool element owning a slot. Slots go back to the pool through the
+ * QSBR queue, so a slot is not reused while a worker may still count
+ * in it.
+ */
+struct cdr_slot_obj {
+	uint32_t slot;
+};
+
+static struct rte_mempool *cdr_slot_pool;
+/** Pool element of each slot */
+static struct cdr_slot_obj **cdr_slot_objs;
+
+static void
+cdr_slot_obj_init(__rte_unused struct rte_mempool *mp,
+		__rte_unused void *arg, void *obj, unsigned idx)
+{
+	struct cdr_slot_obj *o = obj;
+
+	/* slot 0 is CDR_SLOT_NONE */
+	o->slot = idx + 1;
+	cdr_slot_objs[o->slot] = o;
+}
+
+void
+cdr_shard_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < epc_app.num_workers; i++) {
+		cdr_shard[i] = rte_zmalloc_socket("cdr_shard",
+				CDR_SLOTS * sizeof(struct chrg_data_vol),
+				RTE_CACHE_LINE_SIZE,
+				rte_lcore_to_socket_id(epc_app.worker_cores[i]));
+		if (cdr_shard[i] == NULL)
+			rte_panic("Failed to allocate CDR counters of worker"
+					" %u\n", i);
+	}
+
+	cdr_slot_objs = rte_zmalloc("cdr_slot_objs",
+			CDR_SLOTS * sizeof(struct cdr_slot_obj *), 0);
+	if (cdr_slot_objs == NULL)
+		rte_panic("Failed to allocate CDR slot table\n");
+	cdr_slot_pool = rte_mempool_create("cdr_slot_pool", CDR_SLOTS - 1,
+			sizeof(struct cdr_slot_obj), 0, 0, NULL, NULL,
+			cdr_slot_obj_init, NULL, rte_socket_id(), 0);
+	if (cdr_slot_pool == NULL)
+		rte_panic("Failed to create CDR slot pool - %s\n",
+				rte_strerror(rte_errno));
+	RTE_LOG(INFO, DP, "CDR counters: %u slots per worker\n", CDR_SLOTS);
+}
+
+uint32_t
+cdr_slot_alloc(void)
+{
+	struct cdr_slot_obj *o;
+	uint32_t i;
+
+	if (rte_mempool_get(cdr_slot_pool, (void **)&o) < 0) {
+		RTE_LOG(ERR, DP, "Out of CDR slots, using shared counters\n");
+		return CDR_SLOT_NONE;
+	}
+	for (i = 0; i < epc_app.num_workers; i++)
+		memset(&cdr_shard[i][o->slot], 0, sizeof(struct chrg_data_vol));
+	return o->slot;
+}
+
+void
+cdr_slot_free(uint32_t slot)
+{
+	if (slot == CDR_SLOT_NONE)
+		return;
+	dp_defer_mempool_put(cdr_slot_pool, cdr_slot_objs[slot]);
+}
+
+void
+cdr_slot_sum(uint32_t slot, struct chrg_data_vol *vol)
+{
+	struct chrg_data_vol *w;
+	uint32_t i;
+
+	if (slot == CDR_SLOT_NONE)
+		return;
+
+	memset(vol, 0, sizeof(*vol));
+	for (i = 0; i < epc_app.num_workers; i++) {
+		w = &cdr_shard[i][slot];
+		vol->ul_cdr.bytes += w->ul_cdr.bytes;
+		vol->ul_cdr.pkt_count += w->ul_cdr.pkt_count;
+		vol->dl_cdr.bytes += w->dl_cdr.bytes;
+		vol->dl_cdr.pkt_count += w->dl_cdr.pkt_count;
+		vol->ul_drop.bytes += w->ul_drop.bytes;
+		vol->ul_drop.pkt_count += w->ul_drop.pkt_count;
+		vol->dl_drop.bytes += w->dl_drop.bytes;
+		vol->dl_drop.pkt_count += w->dl_drop.pkt_count;
+	}
+}
+#endif /* CDR_COUNTER_SHARDS */
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CDR_SHARD_H_
+#define _CDR_SHARD_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the per worker CDR counters.
+ *
+ * Each bearer, SDF per bearer, ADC per UE and rating group CDR owns a
+ * counter slot. Every worker counts its packets in its own slab at that
+ * slot, so workers never write the same cache line. The slabs of a slot
+ * are summed into the CDR by the iface core when the CDR is exported.
+ */
+#include <stdint.h>
+#include <rte_branch_prediction.h>
+#include <rte_lcore.h>
+
+#include "vepc_cp_dp_api.h"
+#include "epc_packet_framework.h"
+
+#ifdef CDR_COUNTER_SHARDS
+#ifndef CDR_SLOTS
+/** Counter slots of each worker slab */
+#define CDR_SLOTS		(1 << 18)
+#endif
+
+/** No slot, counted in the shared CDR. Slot 0 is never handed out. */
+#define CDR_SLOT_NONE		0
+
+/** Counter slab of each worker, indexed by slot */
+extern struct chrg_data_vol *cdr_shard[DP_MAX_LCORE];
+
+/**
+ * Allocate the worker slabs and the slot pool.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void cdr_shard_init(void);
+
+/**
+ * Get a counter slot, zeroed in every slab. Called by the iface core
+ * before the owning CDR is visible to the workers.
+ *
+ * @return
+ *	slot, CDR_SLOT_NONE if all slots are used.
+ */
+uint32_t cdr_slot_alloc(void);
+
+/**
+ * Release a counter slot once the workers are done with it. The owning
+ * CDR must already be unlinked from every table the workers look up.
+ *
+ * @param slot
+ *	slot, CDR_SLOT_NONE is ignored.
+ *
+ * @return
+ *	None
+ */
+void cdr_slot_free(uint32_t slot);
+
+/**
+ * Sum the worker slabs of a slot into vol. Called by the iface core.
+ *
+ * @param slot
+ *	slot, CDR_SLOT_NONE leaves vol unchanged.
+ * @param vol
+ *	CDR volume to fill.
+ *
+ * @return
+ *	None
+ */
+void cdr_slot_sum(uint32_t slot, struct chrg_data_vol *vol);
+
+/**
+ * Counters a worker updates for a CDR.
+ *
+ * @param cdr
+ *	shared CDR.
+ * @param slot
+ *	counter slot of the CDR.
+ *
+ * @return
+ *	slab counters of calling worker, or the shared CDR counters.
+ */
+static inline struct chrg_data_vol *
+cdr_vol(struct ipcan_dp_bearer_cdr *cdr, uint32_t slot)
+{
+	if (likely(slot != CDR_SLOT_NONE))
+		return &cdr_shard[epc_app.worker_core_mapping[rte_lcore_id()]]
+				[slot];
+	return &cdr->data_vol;
+}
+#endif /* CDR_COUNTER_SHARDS */
+#endif /* _CDR_SHARD_H_ */
@@ -72,6 +72,15 @@
 #include <rte_string_fns.h>
 
 #include "stats.h"
+#include "trace.h"
+#ifdef PKT_CAPTURE
+#include "main.h"
+#include "pkt_capture.h"
+#endif
+#ifdef PKT_MIRROR
+#include "pkt_mirror.h"
+#endif
+#include "health.h"
 
 /**********************************************************/
 struct cmd_show_result {
@@ -106,6 +115,23 @@ static void cmd_show_stats(void *parsed_result,
 	display_mtr_stats();
 #endif
 #endif	/* STATS */
+	display_stage_stats();
+	display_ring_stats();
+#ifdef PKT_LATENCY
+	display_latency_stats();
+#endif
+#ifdef SESS_MEMPOOL
+	display_sess_pool_stats();
+#endif
+#ifdef PKT_CAPTURE
+	display_capture_stats();
+#endif
+#ifdef PKT_MIRROR
+	display_mirror_stats();
+#endif
+#ifdef HEALTH_MON
+	display_health_stats();
+#endif
 
 }
 
@@ -148,6 +174,261 @@ cmdline_parse_inst_t cmd_obj_quit_app = {
 	},
 };
 
+#ifdef PKT_CAPTURE
+/**********************************************************/
+struct cmd_capture_start_result {
+	cmdline_fixed_string_t capture;
+	cmdline_fixed_string_t start;
+	cmdline_fixed_string_t file;
+	cmdline_fixed_string_t port;
+	uint32_t sample;
+};
+
+cmdline_parse_token_string_t cmd_capture_start_capture =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_start_result, capture, "capture");
+cmdline_parse_token_string_t cmd_capture_start_start =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_start_result, start, "start");
+cmdline_parse_token_string_t cmd_capture_start_file =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_start_result, file, NULL);
+cmdline_parse_token_string_t cmd_capture_start_port =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_start_result, port,
+		"s1u#sgi#all");
+cmdline_parse_token_num_t cmd_capture_start_sample =
+TOKEN_NUM_INITIALIZER(struct cmd_capture_start_result, sample, UINT32);
+
+static void cmd_capture_start(void *parsed_result,
+		struct cmdline *cl,
+		__attribute__((unused)) void *data)
+{
+	struct cmd_capture_start_result *res = parsed_result;
+	uint32_t port_mask;
+
+	if (!strcmp(res->port, "s1u"))
+		port_mask = 1 << S1U_PORT_ID;
+	else if (!strcmp(res->port, "sgi"))
+		port_mask = 1 << SGI_PORT_ID;
+	else
+		port_mask = (1 << S1U_PORT_ID) | (1 << SGI_PORT_ID);
+
+	if (capture_start(res->file, port_mask, res->sample) == 0)
+		cmdline_printf(cl, "Capture to %s started\n", res->file);
+}
+
+cmdline_parse_inst_t cmd_obj_capture_start = {
+	.f = cmd_capture_start,  /* function to call */
+	.data = NULL,      /* 2nd arg of func */
+	.help_str = "capture start <file> s1u|sgi|all <1-in-N sample>",
+	.tokens = {        /* token list, NULL terminated */
+		(void *)&cmd_capture_start_capture,
+		(void *)&cmd_capture_start_start,
+		(void *)&cmd_capture_start_file,
+		(void *)&cmd_capture_start_port,
+		(void *)&cmd_capture_start_sample,
+		NULL,
+	},
+};
+
+/**********************************************************/
+struct cmd_capture_stop_result {
+	cmdline_fixed_string_t capture;
+	cmdline_fixed_string_t stop;
+};
+
+cmdline_parse_token_string_t cmd_capture_stop_capture =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_stop_result, capture, "capture");
+cmdline_parse_token_string_t cmd_capture_stop_stop =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_stop_result, stop, "stop");
+
+static void cmd_capture_stop(void *parsed_result,
+		struct cmdline *cl,
+		__attribute__((unused)) void *data)
+{
+	RTE_SET_USED(parsed_result);
+	if (capture_stop() < 0)
+		cmdline_printf(cl, "No capture running\n");
+}
+
+cmdline_parse_inst_t cmd_obj_capture_stop = {
+	.f = cmd_capture_stop,  /* function to call */
+	.data = NULL,      /* 2nd arg of func */
+	.help_str = "capture stop",
+	.tokens = {        /* token list, NULL terminated */
+		(void *)&cmd_capture_stop_capture,
+		(void *)&cmd_capture_stop_stop,
+		NULL,
+	},
+};
+
+/**********************************************************/
+struct cmd_capture_match_result {
+	cmdline_fixed_string_t capture;
+	cmdline_fixed_string_t match;
+	uint32_t teid;
+	cmdline_ipaddr_t ue_ip;
+};
+
+cmdline_parse_token_string_t cmd_capture_match_capture =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_match_result, capture, "capture");
+cmdline_parse_token_string_t cmd_capture_match_match =
+TOKEN_STRING_INITIALIZER(struct cmd_capture_match_result, match, "match");
+cmdline_parse_token_num_t cmd_capture_match_teid =
+TOKEN_NUM_INITIALIZER(struct cmd_capture_match_result, teid, UINT32);
+cmdline_parse_token_ipaddr_t cmd_capture_match_ue_ip =
+TOKEN_IPV4_INITIALIZER(struct cmd_capture_match_result, ue_ip);
+
+static void cmd_capture_match(void *parsed_result,
+		__attribute__((unused)) struct cmdline *cl,
+		__attribute__((unused)) void *data)
+{
+	struct cmd_capture_match_result *res = parsed_result;
+
+	capture_set_match(res->teid, res->ue_ip.addr.ipv4.s_addr);
+}
+
+cmdline_parse_inst_t cmd_obj_capture_match = {
+	.f = cmd_capture_match,  /* function to call */
+	.data = NULL,      /* 2nd arg of func */
+	.help_str = "capture match <teid|0> <ue ip|0.0.0.0>",
+	.tokens = {        /* token list, NULL terminated */
+		(void *)&cmd_capture_match_capture,
+		(void *)&cmd_capture_match_match,
+		(void *)&cmd_capture_match_teid,
+		(void *)&cmd_capture_match_ue_ip,
+		NULL,
+	},
+};
+#endif /* PKT_CAPTURE */
+
+#ifdef PKT_MIRROR
+/**********************************************************/
+struct cmd_mirror_select_result {
+	cmdline_fixed_string_t mirror;
+	cmdline_fixed_string_t action;
+	uint32_t teid;
+	cmdline_ipaddr_t ue_ip;
+};
+
+cmdline_parse_token_string_t cmd_mirror_select_mirror =
+TOKEN_STRING_INITIALIZER(struct cmd_mirror_select_result, mirror, "mirror");
+cmdline_parse_token_string_t cmd_mirror_select_action =
+TOKEN_STRING_INITIALIZER(struct cmd_mirror_select_result, action, "add#del");
+cmdline_parse_token_num_t cmd_mirror_select_teid =
+TOKEN_NUM_INITIALIZER(struct cmd_mirror_select_result, teid, UINT32);
+cmdline_parse_token_ipaddr_t cmd_mirror_select_ue_ip =
+TOKEN_IPV4_INITIALIZER(struct cmd_mirror_select_result, ue_ip);
+
+static void cmd_mirror_select(void *parsed_result,
+		struct cmdline *cl,
+		__attribute__((unused)) void *data)
+{
+	struct cmd_mirror_select_result *res = parsed_result;
+	int add = !strcmp(res->action, "add");
+
+	if (mirror_select_set(res->teid, ntohl(res->ue_ip.addr.ipv4.s_addr),
+				add) < 0)
+		cmdline_printf(cl, add ? "Mirror selectors full\n" :
+				"Mirror selector not found\n");
+}
+
+cmdline_parse_inst_t cmd_obj_mirror_select = {
+	.f = cmd_mirror_select,  /* function to call */
+	.data = NULL,      /* 2nd arg of func */
+	.help_str = "mirror add|del <teid|0> <ue ip|0.0.0.0>",
+	.tokens = {        /* token list, NULL terminated */
+		(void *)&cmd_mirror_select_mirror,
+		(void *)&cmd_mirror_select_action,
+		(void *)&cmd_mirror_select_teid,
+		(void *)&cmd_mirror_select_ue_ip,
+		NULL,
+	},
+};
+
+/**********************************************************/
+struct cmd_mirror_sample_result {
+	cmdline_fixed_string_t mirror;
+	cmdline_fixed_string_t sample;
+	uint32_t n;
+	uint32_t snaplen;
+};
+
+cmdline_parse_token_string_t cmd_mirror_sample_mirror =
+TOKEN_STRING_INITIALIZER(struct cmd_mirror_sample_result, mirror, "mirror");
+cmdline_parse_token_string_t cmd_mirror_sample_sample =
+TOKEN_STRING_INITIALIZER(struct cmd_mirror_sample_result, sample, "sample");
+cmdline_parse_token_num_t cmd_mirror_sample_n =
+TOKEN_NUM_INITIALIZER(struct cmd_mirror_sample_result, n, UINT32);
+cmdline_parse_token_num_t cmd_mirror_sample_snaplen =
+TOKEN_NUM_INITIALIZER(struct cmd_mirror_sample_result, snaplen, UINT32);
+
+static void cmd_mirror_sample(void *parsed_result,
+		__attribute__((unused)) struct cmdline *cl,
+		__attribute__((unused)) void *data)
+{
+	struct cmd_mirror_sample_result *res = parsed_result;
+
+	mirror_set_sample(res->n, res->snaplen);
+}
+
+cmdline_parse_inst_t cmd_obj_mirror_sample = {
+	.f = cmd_mirror_sample,  /* function to call */
+	.data = NULL,      /* 2nd arg of func */
+	.help_str = "mirror sample <1-in-N sample> <snaplen|0>",
+	.tokens = {        /* token list, NULL terminated */
+		(void *)&cmd_mirror_sample_mirror,
+		(void *)&cmd_mirror_sample_sample,
+		(void *)&cmd_mirror_sample_n,
+		(void *)&cmd_mirror_sample_snaplen,
+		NULL,
+	},
+};
+#endif /* PKT_MIRROR */
+
+#ifdef TRACE_POINTS
+/**********************************************************/
+struct cmd_trace_result {
+	cmdline_fixed_string_t trace;
+	cmdline_fixed_string_t action;
+	cmdline_fixed_string_t arg;
+};
+
+cmdline_parse_token_string_t cmd_trace_trace =
+TOKEN_STRING_INITIALIZER(struct cmd_trace_result, trace, "trace");
+cmdline_parse_token_string_t cmd_trace_action =
+TOKEN_STRING_INITIALIZER(struct cmd_trace_result, action, "set#dump");
+cmdline_parse_token_string_t cmd_trace_arg =
+TOKEN_STRING_INITIALIZER(struct cmd_trace_result, arg, NULL);
+
+static void cmd_trace(void *parsed_result,
+		struct cmdline *cl,
+		__attribute__((unused)) void *data)
+{
+	struct cmd_trace_result *res = parsed_result;
+	uint32_t mask;
+
+	if (!strcmp(res->action, "dump")) {
+		if (dp_trace_dump(res->arg) < 0)
+			cmdline_printf(cl, "Failed to write %s\n", res->arg);
+		return;
+	}
+	if (dp_trace_parse(res->arg, &mask) < 0)
+		return;
+	dp_trace_mask = mask;
+	cmdline_printf(cl, "Trace mask 0x%x\n", mask);
+}
+
+cmdline_parse_inst_t cmd_obj_trace = {
+	.f = cmd_trace,  /* function to call */
+	.data = NULL,      /* 2nd arg of func */
+	.help_str = "trace set <rx,gtpu,sess,adc|all|none> | trace dump <file>",
+	.tokens = {        /* token list, NULL terminated */
+		(void *)&cmd_trace_trace,
+		(void *)&cmd_trace_action,
+		(void *)&cmd_trace_arg,
+		NULL,
+	},
+};
+#endif /* TRACE_POINTS */
+
 /**********************************************************/
 struct cmd_help_result {
 	cmdline_fixed_string_t help;
@@ -166,6 +447,19 @@ static void cmd_help(__attribute__((unused)) void *parsed_result,
 			"Command supported:\n"
 			"- show\n"
 			"- quit\n"
+#ifdef PKT_CAPTURE
+			"- capture start <file> s1u|sgi|all <sample>\n"
+			"- capture match <teid> <ue ip>\n"
+			"- capture stop\n"
+#endif
+#ifdef PKT_MIRROR
+			"- mirror add|del <teid> <ue ip>\n"
+			"- mirror sample <sample> <snaplen>\n"
+#endif
+#ifdef TRACE_POINTS
+			"- trace set <subsystems>\n"
+			"- trace dump <file>\n"
+#endif
 			"- help\n\n");
 }
 
@@ -185,5 +479,17 @@ cmdline_parse_ctx_t main_ctx[] = {
 	(cmdline_parse_inst_t *)&cmd_obj_show_stats,
 	(cmdline_parse_inst_t *)&cmd_obj_quit_app,
 	(cmdline_parse_inst_t *)&cmd_obj_help,
+#ifdef PKT_CAPTURE
+	(cmdline_parse_inst_t *)&cmd_obj_capture_start,
+	(cmdline_parse_inst_t *)&cmd_obj_capture_stop,
+	(cmdline_parse_inst_t *)&cmd_obj_capture_match,
+#endif
+#ifdef PKT_MIRROR
+	(cmdline_parse_inst_t *)&cmd_obj_mirror_select,
+	(cmdline_parse_inst_t *)&cmd_obj_mirror_sample,
+#endif
+#ifdef TRACE_POINTS
+	(cmdline_parse_inst_t *)&cmd_obj_trace,
+#endif
 	NULL,
 };
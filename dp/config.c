@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <arpa/inet.h>
 
@@ -25,6 +26,15 @@
 #include "cdr.h"
 #include "master_cdr.h"
 #include "pipeline/epc_packet_framework.h"
+#include "trace.h"
+#include "health.h"
+#include "bench.h"
+#include "microbench.h"
+#include "sess_store.h"
+#include "table_budget.h"
+#include "hash_select.h"
+#include "s5s8_bypass.h"
+#include "pkt_mirror.h"
 
 /* app config structure */
 struct app_params app;
@@ -142,6 +152,26 @@ static inline void dp_print_usage(void)
 			PRESENCE_WIDTH,    "MANDATORY",
 			DESCRIPTION_WIDTH, "no. of worker instances.");
 
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--num_queues",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH, "no. of rx/tx queues per port.");
+
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--num_spns_dns",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH, "no. of cores scanning DNS responses.");
+
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--ue_ip_pool",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH, "UE IP pool, same as CP ip_pool_ip.");
+
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--ue_ip_pool_mask",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH, "UE IP pool mask, same as CP.");
+
 	printf("| %-*s | %-*s | %-*s |\n",
 			ARGUMENT_WIDTH,    "--log",
 			PRESENCE_WIDTH,    "MANDATORY",
@@ -154,6 +184,178 @@ static inline void dp_print_usage(void)
 			DESCRIPTION_WIDTH,
 			"CDR file path location.");
 
+#ifdef CDR_ASYNC
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--cdr_writer",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"CDR writer core.");
+#endif
+
+#ifdef TRACE_POINTS
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--trace",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"trace subsystems: rx,gtpu,sess,adc,all.");
+#endif
+
+#ifdef PKT_CAPTURE
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--capture_core",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"pkt capture writer core.");
+#endif
+
+#ifdef DP_BENCH
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--bench",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"bench config file, ring ports replace the NICs.");
+#endif
+
+#ifdef DP_MICROBENCH
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--microbench",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"kernels to measure and exit, comma list or all.");
+#endif
+
+#ifdef WARM_RESTART
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--warm_restart",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"session store file, restored at start up.");
+#endif
+
+#ifdef TABLE_BUDGET
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--table_budget",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"<MB>[,<bearers>[,<UEs>]] sizes session tables.");
+#endif
+
+#ifdef HASH_SELECT
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--hash_func",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"auto|jhash|crc[,<table>=<func>]... table hashes.");
+#endif
+
+#ifdef SESS_SNAPSHOT
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--sess_snapshot",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"base name of session snapshot and journal.");
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--sess_restore",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"base name of session snapshot to restore.");
+#endif
+
+#ifdef HEALTH_MON
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--pool_alarm",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"mempool in use alarm, percent, 0- disable.");
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--ring_alarm",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"ring occupancy alarm, percent, 0- disable.");
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--drop_alarm",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"NIC/ring drops per second alarm, 0- disable.");
+#endif
+
+#ifdef INTERIM_CDR
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--interim_cdr",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"interim CDR interval in seconds, 0- disable.");
+#endif
+
+#ifdef ADAPTIVE_FLUSH
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--flush_us",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"max us pkts wait in pipeline tx buffers.");
+#endif
+
+#ifdef JUMBO_FRAMES
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--max_pkt_len",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"largest frame received, up to 9018 bytes.");
+#endif
+
+#ifdef GTPU_FRAG
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--gtpu_mtu",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"outer ipv4 MTU of the GTPU ports, default 1500.");
+#endif
+
+#ifdef S5S8_BYPASS
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--s5s8_bypass",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"shm name shared with the co-located SGWU/PGWU.");
+#endif
+
+#ifdef PKT_MIRROR
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--mirror_port",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"port id the mirrored pkts are sent on.");
+#endif
+
+#ifdef SERVICE_SCHED
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--idle_sleep",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"idle service lcore sleep in us, 0- pause only.");
+#endif
+
+#ifdef SESS_AGING
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--sess_idle",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"bearer inactivity to report, seconds, 0- disable.");
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--sess_reclaim",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"bearer inactivity to delete, seconds, 0- disable.");
+#endif
+
+#ifdef RUNTIME_STAGES
+	printf("| %-*s | %-*s | %-*s |\n",
+			ARGUMENT_WIDTH,    "--stages",
+			PRESENCE_WIDTH,    "OPTIONAL",
+			DESCRIPTION_WIDTH,
+			"worker stages, comma list, default all.");
+#endif
+
 	printf("| %-*s | %-*s | %-*s |\n",
 			ARGUMENT_WIDTH,    "--master_cdr",
 			PRESENCE_WIDTH,    "OPTIONAL",
@@ -242,6 +444,56 @@ static inline void set_unused_lcore(int *core, uint64_t *used_coremask)
 	rte_panic("No free core available - check coremask");
 }
 
+#ifdef RUNTIME_STAGES
+/**
+ * Parse --stages list, e.g. "sdf_mtr,apn_mtr,dns".
+ *
+ * @param arg
+ *	comma separated stage names, "none" or "all".
+ * @param stages
+ *	DP_STAGE_* mask.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on unknown stage
+ */
+static int
+parse_stages(const char *arg, uint32_t *stages)
+{
+	static const struct {
+		const char *name;
+		uint32_t bit;
+	} names[] = {
+		{"sdf_mtr", DP_STAGE_SDF_MTR},
+		{"apn_mtr", DP_STAGE_APN_MTR},
+		{"rating_grp", DP_STAGE_RATING_GRP},
+		{"egress_qos", DP_STAGE_EGRESS_QOS},
+		{"dns", DP_STAGE_DNS},
+		{"pcap", DP_STAGE_PCAP},
+		{"all", DP_STAGE_ALL},
+		{"none", 0},
+	};
+	char buf[128];
+	char *tok, *save = NULL;
+	uint32_t i;
+
+	snprintf(buf, sizeof(buf), "%s", arg);
+	*stages = 0;
+	for (tok = strtok_r(buf, ",", &save); tok != NULL;
+			tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < RTE_DIM(names); i++)
+			if (!strcmp(tok, names[i].name))
+				break;
+		if (i == RTE_DIM(names)) {
+			printf("Unknown stage %s\n", tok);
+			return -1;
+		}
+		*stages |= names[i].bit;
+	}
+	return 0;
+}
+#endif /* RUNTIME_STAGES */
+
 /**
  * Function to parse command line config.
  *
@@ -265,6 +517,9 @@ parse_config_args(struct app_params *app, int argc, char **argv)
 	struct ether_addr mac_addr;
 	uint64_t used_coremask = 0;
 	const char *master_cdr_file = NULL;
+#ifdef TRACE_POINTS
+	uint32_t trace_mask;
+#endif
 
 	static struct option spgw_opts[] = {
 		{"s1u_ip", required_argument, 0, 'i'},
@@ -286,16 +541,46 @@ parse_config_args(struct app_params *app, int argc, char **argv)
 		{"mct", required_argument, 0, 'c'},
 		{"spns_dns", required_argument, 0, 'p'},
 		{"num_workers", required_argument, 0, 'w'},
+		{"num_queues", required_argument, 0, 'y'},
+		{"num_spns_dns", required_argument, 0, 'N'},
+		{"ue_ip_pool", required_argument, 0, 'P'},
+		{"ue_ip_pool_mask", required_argument, 0, 'Q'},
 		{"iface", required_argument, 0, 'd'},
 		{"stats", required_argument, 0, 't'},
 		{"cdr_path", required_argument, 0, 'a'},
 		{"master_cdr", required_argument, 0, 'e'},
+		{"cdr_writer", required_argument, 0, 'C'},
+		{"capture_core", required_argument, 0, 'K'},
+		{"trace", required_argument, 0, 'T'},
+		{"pool_alarm", required_argument, 0, 'A'},
+		{"ring_alarm", required_argument, 0, 'R'},
+		{"drop_alarm", required_argument, 0, 'D'},
+		{"bench", required_argument, 0, 'B'},
+		{"microbench", required_argument, 0, 'M'},
+		{"warm_restart", required_argument, 0, 'W'},
+		{"sess_snapshot", required_argument, 0, 'J'},
+		{"sess_restore", required_argument, 0, 'L'},
+		{"table_budget", required_argument, 0, 'O'},
+		{"hash_func", required_argument, 0, 'G'},
+		{"interim_cdr", required_argument, 0, 'I'},
+		{"sess_idle", required_argument, 0, 'E'},
+		{"sess_reclaim", required_argument, 0, 'F'},
+		{"idle_sleep", required_argument, 0, 'H'},
+		{"flush_us", required_argument, 0, 'U'},
+		{"s5s8_bypass", required_argument, 0, 'V'},
+		{"gtpu_mtu", required_argument, 0, 'X'},
+		{"max_pkt_len", required_argument, 0, 'Y'},
+		{"mirror_port", required_argument, 0, 'Z'},
 		{"numa", required_argument, 0, 'f'},
+		{"stages", required_argument, 0, 'S'},
 		{"spgw_cfg",  required_argument, 0, 'h'},
 		{NULL, 0, 0, 0}
 	};
 
 	optind = 0;/* reset getopt lib */
+#ifdef RUNTIME_STAGES
+	app->stages = DP_STAGE_ALL;
+#endif
 
 	while ((opt = getopt_long(argc, argv, "i:s:m:n:u:g:b:m:w:d",
 					spgw_opts, &option_index)) != EOF) {
@@ -480,24 +765,49 @@ parse_config_args(struct app_params *app, int argc, char **argv)
 					inet_ntoa(*((struct in_addr *)&app->sgi_mask)));
 			break;
 
+			/* UE ip pool, downlink lookups are indexed in the pool */
+		case 'P':
+			if (!inet_aton(optarg, (struct in_addr *)&app->ue_pool_ip)) {
+				printf("Invalid ue ip pool ->%s<-\n",
+						optarg);
+				dp_print_usage();
+				app->ue_pool_ip = 0;
+				return -1;
+			}
+			printf("Parsed ue ip pool: %s\n",
+					inet_ntoa(*((struct in_addr *)&app->ue_pool_ip)));
+			break;
+
+		case 'Q':
+			if (!inet_aton(optarg, (struct in_addr *)&app->ue_pool_mask)) {
+				printf("Invalid ue ip pool mask ->%s<-\n",
+						optarg);
+				dp_print_usage();
+				app->ue_pool_mask = 0;
+				return -1;
+			}
+			printf("Parsed ue ip pool mask: %s\n",
+					inet_ntoa(*((struct in_addr *)&app->ue_pool_mask)));
+			break;
+
 		case 'l':
 			app->log_level = atoi(optarg);
 			break;
 
 		case 'u':
-			epc_app.core_rx[S1U_PORT_ID] = atoi(optarg);
-			epc_app.core_tx[S1U_PORT_ID] = atoi(optarg);
+			epc_app.core_rx[S1U_PORT_ID][0] = atoi(optarg);
+			epc_app.core_tx[S1U_PORT_ID][0] = atoi(optarg);
 			printf("Parsed core_s1u:\t%d\n",
-						epc_app.core_rx[S1U_PORT_ID]);
-			used_coremask |= (1ULL << epc_app.core_rx[S1U_PORT_ID]);
+						epc_app.core_rx[S1U_PORT_ID][0]);
+			used_coremask |= (1ULL << epc_app.core_rx[S1U_PORT_ID][0]);
 			break;
 
 		case 'g':
-			epc_app.core_rx[SGI_PORT_ID] = atoi(optarg);
-			epc_app.core_tx[SGI_PORT_ID] = atoi(optarg);
+			epc_app.core_rx[SGI_PORT_ID][0] = atoi(optarg);
+			epc_app.core_tx[SGI_PORT_ID][0] = atoi(optarg);
 			printf("Parsed core_sgi:\t%d\n",
-						epc_app.core_rx[SGI_PORT_ID]);
-			used_coremask |= (1ULL << epc_app.core_rx[SGI_PORT_ID]);
+						epc_app.core_rx[SGI_PORT_ID][0]);
+			used_coremask |= (1ULL << epc_app.core_rx[SGI_PORT_ID][0]);
 			break;
 
 		case 'b':
@@ -525,6 +835,18 @@ parse_config_args(struct app_params *app, int argc, char **argv)
 						epc_app.num_workers);
 			break;
 
+		case 'y':
+			epc_app.n_queues = atoi(optarg);
+			printf("Parsed num_queues:\t%d\n",
+						epc_app.n_queues);
+			break;
+
+		case 'N':
+			epc_app.num_spns_dns = atoi(optarg);
+			printf("Parsed num_spns_dns:\t%d\n",
+						epc_app.num_spns_dns);
+			break;
+
 		case 'd':
 			epc_app.core_iface = atoi(optarg);
 			printf("Parsed core_iface:\t%d\n", epc_app.core_iface);
@@ -550,10 +872,255 @@ parse_config_args(struct app_params *app, int argc, char **argv)
 			master_cdr_file = optarg;
 			break;
 
+		case 'C':
+#ifdef CDR_ASYNC
+			epc_app.core_cdr = atoi(optarg);
+			printf("Parsed core_cdr:\t%d\n", epc_app.core_cdr);
+			used_coremask |= (1ULL << epc_app.core_cdr);
+#else
+			printf("DP compiled without CDR_ASYNC flag in Makefile."
+				" Ignoring cdr writer core assignment");
+#endif
+			break;
+
+		case 'K':
+#ifdef PKT_CAPTURE
+			epc_app.core_capture = atoi(optarg);
+			printf("Parsed core_capture:\t%d\n",
+					epc_app.core_capture);
+			used_coremask |= (1ULL << epc_app.core_capture);
+#else
+			printf("DP compiled without PKT_CAPTURE flag in Makefile."
+				" Ignoring capture core assignment");
+#endif
+			break;
+
+		case 'T':
+#ifdef TRACE_POINTS
+			if (dp_trace_parse(optarg, &trace_mask) < 0)
+				return -1;
+			dp_trace_mask = trace_mask;
+			printf("Parsed trace:\t0x%x\n", trace_mask);
+#else
+			printf("DP compiled without TRACE_POINTS flag in Makefile."
+				" Ignoring trace");
+#endif
+			break;
+
+		case 'A':
+#ifdef HEALTH_MON
+			health_cfg.pool_pct = atoi(optarg);
+			printf("Parsed pool_alarm:\t%u\n", health_cfg.pool_pct);
+#else
+			printf("DP compiled without HEALTH_MON flag in Makefile."
+				" Ignoring pool alarm");
+#endif
+			break;
+
+		case 'R':
+#ifdef HEALTH_MON
+			health_cfg.ring_pct = atoi(optarg);
+			printf("Parsed ring_alarm:\t%u\n", health_cfg.ring_pct);
+#else
+			printf("DP compiled without HEALTH_MON flag in Makefile."
+				" Ignoring ring alarm");
+#endif
+			break;
+
+		case 'D':
+#ifdef HEALTH_MON
+			health_cfg.drops = atoi(optarg);
+			printf("Parsed drop_alarm:\t%u\n", health_cfg.drops);
+#else
+			printf("DP compiled without HEALTH_MON flag in Makefile."
+				" Ignoring drop alarm");
+#endif
+			break;
+
+		case 'B':
+#ifdef DP_BENCH
+			if (bench_parse(optarg) < 0)
+				return -1;
+			if (epc_app.core_bench >= 0)
+				used_coremask |= (1ULL << epc_app.core_bench);
+#else
+			printf("DP compiled without DP_BENCH flag in Makefile."
+				" Ignoring bench");
+#endif
+			break;
+
+		case 'M':
+#ifdef DP_MICROBENCH
+			if (microbench_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without DP_MICROBENCH flag in Makefile."
+				" Ignoring microbench");
+#endif
+			break;
+
+		case 'W':
+#ifdef WARM_RESTART
+			if (sess_store_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without WARM_RESTART flag in Makefile."
+				" Ignoring warm restart");
+#endif
+			break;
+
+		case 'J':
+#ifdef SESS_SNAPSHOT
+			if (sess_snapshot_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without SESS_SNAPSHOT flag in Makefile."
+				" Ignoring session snapshot");
+#endif
+			break;
+
+		case 'L':
+#ifdef SESS_SNAPSHOT
+			if (sess_restore_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without SESS_SNAPSHOT flag in Makefile."
+				" Ignoring session restore");
+#endif
+			break;
+
+		case 'O':
+#ifdef TABLE_BUDGET
+			if (table_budget_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without TABLE_BUDGET flag in Makefile."
+				" Ignoring table budget");
+#endif
+			break;
+
+		case 'G':
+#ifdef HASH_SELECT
+			if (hash_select_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without HASH_SELECT flag in Makefile."
+				" Ignoring hash function");
+#endif
+			break;
+
+		case 'I':
+#ifdef INTERIM_CDR
+			app->interim_cdr_sec = atoi(optarg);
+			printf("Parsed interim_cdr:\t%u\n", app->interim_cdr_sec);
+#else
+			printf("DP compiled without INTERIM_CDR flag in Makefile."
+				" Ignoring interim cdr interval");
+#endif
+			break;
+
+		case 'E':
+#ifdef SESS_AGING
+			app->sess_idle_sec = atoi(optarg);
+			printf("Parsed sess_idle:\t%u\n", app->sess_idle_sec);
+#else
+			printf("DP compiled without SESS_AGING flag in Makefile."
+				" Ignoring session idle time");
+#endif
+			break;
+
+		case 'F':
+#ifdef SESS_AGING
+			app->sess_reclaim_sec = atoi(optarg);
+			printf("Parsed sess_reclaim:\t%u\n",
+					app->sess_reclaim_sec);
+#else
+			printf("DP compiled without SESS_AGING flag in Makefile."
+				" Ignoring session reclaim time");
+#endif
+			break;
+
+		case 'H':
+#ifdef SERVICE_SCHED
+			app->idle_sleep_us = atoi(optarg);
+			printf("Parsed idle_sleep:\t%u\n", app->idle_sleep_us);
+#else
+			printf("DP compiled without SERVICE_SCHED flag in Makefile."
+				" Ignoring idle sleep");
+#endif
+			break;
+
+		case 'U':
+#ifdef ADAPTIVE_FLUSH
+			epc_app.flush_us = atoi(optarg);
+			printf("Parsed flush_us:\t%u\n", epc_app.flush_us);
+#else
+			printf("DP compiled without ADAPTIVE_FLUSH flag in Makefile."
+				" Ignoring flush deadline");
+#endif
+			break;
+
+		case 'V':
+#ifdef S5S8_BYPASS
+			if (s5s8_bypass_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without S5S8_BYPASS flag in Makefile."
+				" Ignoring S5/S8 bypass");
+#endif
+			break;
+
+		case 'X':
+#ifdef GTPU_FRAG
+			app->gtpu_mtu = atoi(optarg);
+			printf("Parsed gtpu_mtu:\t%u\n", app->gtpu_mtu);
+#else
+			printf("DP compiled without GTPU_FRAG flag in Makefile."
+				" Ignoring GTPU MTU");
+#endif
+			break;
+
+		case 'Y':
+#ifdef JUMBO_FRAMES
+			app->max_pkt_len = atoi(optarg);
+			if (app->max_pkt_len > JUMBO_FRAME_MAX_LEN) {
+				printf("Invalid max_pkt_len %u, should be up to "
+						"%u\n", app->max_pkt_len,
+						JUMBO_FRAME_MAX_LEN);
+				return -1;
+			}
+			printf("Parsed max_pkt_len:\t%u\n", app->max_pkt_len);
+#else
+			printf("DP compiled without JUMBO_FRAMES flag in Makefile."
+				" Ignoring max pkt len");
+#endif
+			break;
+
+		case 'Z':
+#ifdef PKT_MIRROR
+			if (mirror_parse(optarg) < 0)
+				return -1;
+#else
+			printf("DP compiled without PKT_MIRROR flag in Makefile."
+				" Ignoring mirror port");
+#endif
+			break;
+
 		case 'f':
 			app->numa_on = atoi(optarg);
 			break;
 
+		case 'S':
+#ifdef RUNTIME_STAGES
+			if (parse_stages(optarg, &app->stages) < 0)
+				return -1;
+			printf("Parsed stages:\t0x%x\n", app->stages);
+#else
+			printf("DP compiled without RUNTIME_STAGES flag in Makefile."
+				" Ignoring stages");
+#endif
+			break;
+
 		default:
 			dp_print_usage();
 			return -1;
@@ -561,17 +1128,70 @@ parse_config_args(struct app_params *app, int argc, char **argv)
 	}			/* end while() */
 
 	set_master_cdr_file(master_cdr_file);
-	set_unused_lcore(&epc_app.core_rx[S1U_PORT_ID], &used_coremask);
-	epc_app.core_tx[S1U_PORT_ID] = epc_app.core_rx[S1U_PORT_ID];
-	set_unused_lcore(&epc_app.core_rx[SGI_PORT_ID], &used_coremask);
-	epc_app.core_tx[SGI_PORT_ID] = epc_app.core_rx[SGI_PORT_ID];
+#ifdef ADAPTIVE_FLUSH
+	epc_app.flush_deadline_cycles =
+		rte_get_tsc_hz() / 1000000 * epc_app.flush_us;
+#endif
+#ifdef NIC_RSS_STEERING
+	/* rx queues are owned by the workers */
+	epc_app.n_queues = 1;
+#endif
+	if (epc_app.n_queues < 1 || epc_app.n_queues > EPC_MAX_PORT_QUEUES ||
+			epc_app.n_queues > epc_app.num_workers) {
+		printf("Invalid num_queues %u, should be 1 - %u and not more "
+				"than num_workers\n", epc_app.n_queues,
+				EPC_MAX_PORT_QUEUES);
+		return -1;
+	}
+	if (epc_app.num_spns_dns < 1 ||
+			epc_app.num_spns_dns > EPC_MAX_SPNS_DNS) {
+		printf("Invalid num_spns_dns %u, should be 1 - %u\n",
+				epc_app.num_spns_dns, EPC_MAX_SPNS_DNS);
+		return -1;
+	}
+#ifndef RUN_TO_COMPLETION
+	set_unused_lcore(&epc_app.core_rx[S1U_PORT_ID][0], &used_coremask);
+	epc_app.core_tx[S1U_PORT_ID][0] = epc_app.core_rx[S1U_PORT_ID][0];
+	set_unused_lcore(&epc_app.core_rx[SGI_PORT_ID][0], &used_coremask);
+	epc_app.core_tx[SGI_PORT_ID][0] = epc_app.core_rx[SGI_PORT_ID][0];
+	/* additional queues get the next free cores */
+	for (i = 1; i < (int)epc_app.n_queues; ++i) {
+		epc_app.core_rx[S1U_PORT_ID][i] = -1;
+		set_unused_lcore(&epc_app.core_rx[S1U_PORT_ID][i],
+				&used_coremask);
+		epc_app.core_tx[S1U_PORT_ID][i] =
+				epc_app.core_rx[S1U_PORT_ID][i];
+		epc_app.core_rx[SGI_PORT_ID][i] = -1;
+		set_unused_lcore(&epc_app.core_rx[SGI_PORT_ID][i],
+				&used_coremask);
+		epc_app.core_tx[SGI_PORT_ID][i] =
+				epc_app.core_rx[SGI_PORT_ID][i];
+	}
+#endif
+#ifndef NIC_RSS_STEERING
 	set_unused_lcore(&epc_app.core_load_balance, &used_coremask);
+#endif
 	set_unused_lcore(&epc_app.core_mct, &used_coremask);
 	set_unused_lcore(&epc_app.core_iface, &used_coremask);
 #ifdef STATS
 	set_unused_lcore(&epc_app.core_stats, &used_coremask);
 #endif
 	set_unused_lcore(&epc_app.core_spns_dns, &used_coremask);
+	for (i = 1; i < (int)epc_app.num_spns_dns; ++i) {
+		epc_app.core_spns_dns_extra[i - 1] = -1;
+		set_unused_lcore(&epc_app.core_spns_dns_extra[i - 1],
+				&used_coremask);
+	}
+#ifdef CDR_ASYNC
+	set_unused_lcore(&epc_app.core_cdr, &used_coremask);
+#endif
+#ifdef PKT_CAPTURE
+	set_unused_lcore(&epc_app.core_capture, &used_coremask);
+#endif
+#ifdef DP_BENCH
+	if (bench_on)
+		set_unused_lcore(&epc_app.core_bench, &used_coremask);
+#endif
 	for (i = 0; i < epc_app.num_workers; ++i) {
 		epc_app.worker_cores[i] = -1;
 		set_unused_lcore(&epc_app.worker_cores[i], &used_coremask);
@@ -598,4 +1218,10 @@ void dp_init(int argc, char **argv)
 {
 	if (parse_config_args(&app, argc, argv) < 0)
 		rte_exit(EXIT_FAILURE, "Error: Config parse fail !!!\n");
+#ifdef RUNTIME_STAGES
+	pkt_stages_init(app.stages);
+#endif
+#ifdef TRACE_POINTS
+	dp_trace_init();
+#endif
 }
@@ -24,27 +24,118 @@
 #include <rte_ip.h>
 #include <rte_ip_frag.h>
 #include <rte_errno.h>
+#include <rte_prefetch.h>
+#ifdef EGRESS_QOS
+#include <rte_sched.h>
+#endif
 
 #include "main.h"
 #include "interface.h"
 #include "epc_packet_framework.h"
 #include "gtpu.h"
 #include "ipv4.h"
+#include "ipv6.h"
 #include "ether.h"
 #include "util.h"
 #include "meter.h"
 #include "acl.h"
+#include "cdr_shard.h"
+#include "qsbr.h"
+#include "trace.h"
+#include "table_budget.h"
+#include "hash_select.h"
 #include <sponsdn.h>
 #include <stdbool.h>
 
 struct rte_hash *rte_uplink_hash;
 struct rte_hash *rte_downlink_hash;
+#ifdef UE_IPV6
+struct rte_hash *rte_downlink6_hash;
+#endif /* UE_IPV6 */
 struct rte_hash *rte_adc_hash;
 struct rte_hash *rte_adc_ue_hash;
 struct rte_hash *rte_sess_hash;
 struct rte_hash *rte_ue_hash;
 struct rte_hash *rte_sdf_pcc_hash;
 struct rte_hash *rte_adc_pcc_hash;
+struct rte_hash *rte_filter_pcc_node_hash;
+
+/*
+ * The lookups below are software pipelined: packet headers are prefetched
+ * PREFETCH_OFFSET packets ahead of the key build, the hash buckets are
+ * prefetched by rte_hash_lookup_bulk_data() and the returned bearer and
+ * session structures PREFETCH_OFFSET hits ahead of their first use.
+ */
+
+/**
+ * Prefetch the headers of the first packets of a burst.
+ */
+static inline void
+prefetch_pkts_head(struct rte_mbuf **pkts, uint32_t n)
+{
+	uint32_t j;
+
+	for (j = 0; j < PREFETCH_OFFSET && j < n; j++)
+		rte_prefetch0(rte_pktmbuf_mtod(pkts[j], void *));
+}
+
+/**
+ * Prefetch the headers of the packet PREFETCH_OFFSET after j.
+ */
+static inline void
+prefetch_pkt_ahead(struct rte_mbuf **pkts, uint32_t j, uint32_t n)
+{
+	if (j + PREFETCH_OFFSET < n)
+		rte_prefetch0(rte_pktmbuf_mtod(pkts[j + PREFETCH_OFFSET],
+					void *));
+}
+
+/**
+ * Prefetch the metadata of the first packets of a burst.
+ */
+static inline void
+prefetch_meta_head(struct rte_mbuf **pkts, uint32_t n)
+{
+	uint32_t j;
+
+	for (j = 0; j < PREFETCH_OFFSET && j < n; j++)
+		rte_prefetch0(RTE_MBUF_METADATA_UINT8_PTR(pkts[j],
+					META_DATA_OFFSET));
+}
+
+/**
+ * Prefetch the metadata of the packet PREFETCH_OFFSET after j.
+ */
+static inline void
+prefetch_meta_ahead(struct rte_mbuf **pkts, uint32_t j, uint32_t n)
+{
+	if (j + PREFETCH_OFFSET < n)
+		rte_prefetch0(RTE_MBUF_METADATA_UINT8_PTR(
+				pkts[j + PREFETCH_OFFSET], META_DATA_OFFSET));
+}
+
+/**
+ * Prefetch the lookup results of the first hits of a burst.
+ */
+static inline void
+prefetch_hits_head(void **data, uint32_t n, uint64_t hit_mask)
+{
+	uint32_t j;
+
+	for (j = 0; j < PREFETCH_OFFSET && j < n; j++)
+		if (ISSET_BIT(hit_mask, j))
+			rte_prefetch0(data[j]);
+}
+
+/**
+ * Prefetch the lookup result PREFETCH_OFFSET after j.
+ */
+static inline void
+prefetch_hit_ahead(void **data, uint32_t j, uint32_t n, uint64_t hit_mask)
+{
+	if (j + PREFETCH_OFFSET < n && ISSET_BIT(hit_mask, j + PREFETCH_OFFSET))
+		rte_prefetch0(data[j + PREFETCH_OFFSET]);
+}
 
 #ifdef PCAP_GEN
 pcap_dumper_t *pcap_dumper_east;
@@ -56,66 +147,34 @@ gtpu_decap(struct rte_mbuf **pkts, uint32_t n,
 		uint64_t *pkts_mask)
 {
 	uint32_t i;
-	int ret = 0;
 	static uint64_t ul_num_dcap;
 	struct ipv4_hdr *ipv4_hdr;
-	struct udp_hdr *udp_hdr;
 	struct gtpu_hdr *gtpu_hdr;
 	struct epc_meta_data *meta_data;
+	uint64_t mask;
+	/* reject if not with s1u ip */
+	uint32_t ip = (app.spgw_cfg == PGWU) ? app.s5s8_pgwu_ip : app.s1u_ip;
 
-	for (i = 0; i < n; i++) {
-		/* reject if not with s1u ip */
-		ipv4_hdr = get_mtoip(pkts[i]);
-		uint32_t ip;
-
-		switch(app.spgw_cfg) {
-			case SPGWU:
-				ip = app.s1u_ip;
-				break;
-
-			case PGWU:
-				ip = app.s5s8_pgwu_ip;
-				break;
-
-			default:
-				break;
-		}
-
-		if (ipv4_hdr->dst_addr != ip) {
-			RESET_BIT(*pkts_mask, i);
-			continue;
-		}
+	/* reject un-tunneled packets of the whole burst at once */
+	*pkts_mask &= gtpu_check_burst(pkts, n, ip);
 
-		/* reject un-tunneled packet */
-		udp_hdr = get_mtoudp(pkts[i]);
-		if (ntohs(udp_hdr->dst_port) != UDP_PORT_GTPU) {
-			RESET_BIT(*pkts_mask, i);
-			continue;
-		}
+	for (mask = *pkts_mask; mask; mask &= (mask - 1)) {
+		i = __builtin_ctzll(mask);
 
+		ipv4_hdr = get_mtoip(pkts[i]);
 		gtpu_hdr = get_mtogtpu(pkts[i]);
-		if (gtpu_hdr->teid == 0 || gtpu_hdr->msgtype != GTP_GPDU) {
-			RESET_BIT(*pkts_mask, i);
-			continue;
-		}
-
 
 		meta_data =
 		(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(pkts[i],
 						META_DATA_OFFSET);
 		meta_data->teid = ntohl(gtpu_hdr->teid);
 		meta_data->enb_ipv4 = ntohl(ipv4_hdr->src_addr);
-		RTE_LOG(DEBUG, DP, "Received tunneled packet with teid 0x%x\n",
-				meta_data->teid);
-		RTE_LOG(DEBUG, DP, "From Ue IP " IPV4_ADDR "\n",
-				IPV4_ADDR_FORMAT(gtpu_inner_src_ip(pkts[i])));
+		TRACE_POINT(DP_TRACE_GTPU, TP_GTPU_DECAP, meta_data->teid,
+				gtpu_inner_src_ip(pkts[i]), 0);
 
-		ret = decap_gtpu_hdr(pkts[i]);
-
-		if (ret < 0)
+		if (decap_gtpu_hdr(pkts[i]) < 0)
 			RESET_BIT(*pkts_mask, i);
 		ul_num_dcap++;
-
 	}
 }
 
@@ -126,9 +185,8 @@ gtpu_encap(struct dp_session_info **sess_info, struct rte_mbuf **pkts,
 	uint32_t i;
 	struct dp_session_info *si;
 	struct rte_mbuf *m;
-	uint16_t len;
-	uint32_t src_addr;
-	uint32_t dst_addr;
+	uint8_t out_port = (app.spgw_cfg == PGWU) ?
+			app.s5s8_pgwu_port : app.s1u_port;
 
 	for (i = 0; i < n; i++) {
 		si = sess_info[i];
@@ -142,47 +200,51 @@ gtpu_encap(struct dp_session_info **sess_info, struct rte_mbuf **pkts,
 			continue;
 		}
 
-		if (!si->dl_s1_info.enb_teid) {
+#ifdef DDN_BUF_POOL
+		/* behind the pkts still buffered, in order */
+		if (!si->dl_encap->teid || si->ddn_buf) {
+#else
+		if (!si->dl_encap->teid) {
+#endif	/* DDN_BUF_POOL */
 			RESET_BIT(*pkts_mask, i);
 			SET_BIT(*pkts_queue_mask, i);
 			continue;
 		}
 
-		if (encap_gtpu_hdr(m, si->dl_s1_info.enb_teid) < 0) {
+		/* outer headers are precomputed in the session */
+		if (encap_gtpu_tmpl(m, si->dl_encap, out_port) < 0)
 			RESET_BIT(*pkts_mask, i);
-			continue;
-		}
-
-		len = rte_pktmbuf_data_len(m);
-		len = len - ETH_HDR_SIZE;
-
-		if (app.spgw_cfg == PGWU)
-			dst_addr = si->dl_s1_info.s5s8_sgwu_addr.u.ipv4_addr;
-		else
-			dst_addr = si->dl_s1_info.enb_addr.u.ipv4_addr;
-
-		/* construct iphdr */
-		switch(app.spgw_cfg) {
-			case SPGWU:
-				src_addr = app.s1u_ip;
-				break;
+	}
+}
 
-			case PGWU:
-				src_addr = app.s5s8_pgwu_ip;
-				break;
+#ifdef SESS_AGING
+/**
+ * Stamp the bearers of a burst with the aging clock. Pkts of a bearer
+ * mostly come in runs, and a stamp is only written when the clock moved,
+ * so a bearer line is written at most once per burst and per second.
+ */
+static inline void
+sess_age_touch(struct dp_sdf_per_bearer_info **sess_info, uint32_t n,
+		uint64_t pkts_mask)
+{
+	struct dp_session_info *si, *last = NULL;
+	uint32_t now = sess_age_now;
+	uint32_t j;
 
-			default:
-				break;
-		}
+	for (j = 0; j < n; j++) {
+		if (!ISSET_BIT(pkts_mask, j) || (sess_info[j] == NULL))
+			continue;
 
-		construct_ipv4_hdr(m, len, IP_PROTO_UDP, ntohl(src_addr),
-					dst_addr);
+		si = sess_info[j]->bear_sess_info;
+		if ((si == NULL) || (si == last))
+			continue;
 
-		len = len - IPv4_HDR_SIZE;
-		/* construct udphdr */
-		construct_udp_hdr(m, len, UDP_PORT_GTPU, UDP_PORT_GTPU);
+		last = si;
+		if (si->last_active != now)
+			si->last_active = now;
 	}
 }
+#endif	/* SESS_AGING */
 
 void
 ul_sess_info_get(struct rte_mbuf **pkts, uint32_t n,
@@ -203,48 +265,37 @@ ul_sess_info_get(struct rte_mbuf **pkts, uint32_t n,
 		key[j].rid =1;
 		key[j].s1u_sgw_teid = 0;
 		key_ptr[j] = &key[j];
+	}
 
-		switch (app.spgw_cfg) {
-			case SPGWU: {
+	switch (app.spgw_cfg) {
+		case SPGWU:
+			prefetch_meta_head(pkts, n);
+			for (j = 0; j < n; j++) {
+				prefetch_meta_ahead(pkts, j, n);
 				meta_data =
 					(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(pkts[j],
 					META_DATA_OFFSET);
 				key[j].s1u_sgw_teid = meta_data->teid;
-				break;
 			}
+			break;
 
-			case SGWU: {
-				struct ipv4_hdr *ipv4_hdr = NULL;
-				struct udp_hdr *udp_hdr = NULL;
-				struct gtpu_hdr *gtpu_hdr = NULL;
-
-				/* reject if not with s1u ip */
-				ipv4_hdr = get_mtoip(pkts[j]);
-				if (ipv4_hdr->dst_addr != app.s1u_ip) {
-					RESET_BIT(*pkts_mask, j);
-					continue;
-				}
-
-				/* reject un-tunneled packet */
-				udp_hdr = get_mtoudp(pkts[j]);
-				if (ntohs(udp_hdr->dst_port) != UDP_PORT_GTPU) {
-					RESET_BIT(*pkts_mask, j);
-					continue;
-				}
+		case SGWU: {
+			uint64_t valid;
 
-				gtpu_hdr = get_mtogtpu(pkts[j]);
-				if (gtpu_hdr->teid == 0 || gtpu_hdr->msgtype != GTP_GPDU) {
-					RESET_BIT(*pkts_mask, j);
-					continue;
-				}
+			/* reject un-tunneled packets or not with s1u ip */
+			valid = gtpu_check_burst(pkts, n, app.s1u_ip);
+			*pkts_mask &= valid;
 
-				key[j].s1u_sgw_teid = ntohl(gtpu_hdr->teid);
-				break;
+			for (j = 0; j < n; j++) {
+				if (ISSET_BIT(valid, j))
+					key[j].s1u_sgw_teid =
+						ntohl(get_mtogtpu(pkts[j])->teid);
 			}
-
-			default:
-				break;
+			break;
 		}
+
+		default:
+			break;
 	}
 
 	if ((iface_lookup_uplink_bulk_data((const void **)&key_ptr[0], n,
@@ -252,15 +303,26 @@ ul_sess_info_get(struct rte_mbuf **pkts, uint32_t n,
 		hit_mask = 0;
 	}
 
+	/* bearer info is read by the filtering stages next */
+	prefetch_hits_head((void **)sess_info, n, hit_mask);
 	for (j = 0; j < n; j++) {
+		prefetch_hit_ahead((void **)sess_info, j, n, hit_mask);
 		if (!ISSET_BIT(hit_mask, j)) {
 			RESET_BIT(*pkts_mask, j);
-			RTE_LOG(DEBUG, DP, "SDF BEAR LKUP:FAIL!! UL_KEY "
-				"teid:%u, rid:%u\n",
-				key[j].s1u_sgw_teid, key[j].rid);
+			TRACE_POINT(DP_TRACE_SESS, TP_UL_SESS_MISS,
+				key[j].s1u_sgw_teid, key[j].rid, 0);
 			sess_info[j] = NULL;
 		}
+#ifdef SESS_AGING
+		/* bearer line of the activity stamp */
+		if (sess_info[j] != NULL)
+			rte_prefetch0(RTE_PTR_ADD(sess_info[j]->bear_sess_info,
+					2 * RTE_CACHE_LINE_SIZE));
+#endif	/* SESS_AGING */
 	}
+#ifdef SESS_AGING
+	sess_age_touch(sess_info, n, *pkts_mask);
+#endif	/* SESS_AGING */
 }
 
 void
@@ -273,9 +335,16 @@ adc_ue_info_get(struct rte_mbuf **pkts, uint32_t n, uint32_t *res,
 	void *key_ptr[MAX_BURST_SZ];
 	uint64_t hit_mask = 0;
 
+	prefetch_pkts_head(pkts, n);
 	for (j = 0; j < n; j++) {
+		prefetch_pkt_ahead(pkts, j, n);
 		ipv4_hdr = get_mtoip(pkts[j]);
 		key[j].rid = res[j];
+#ifdef UE_IPV6
+		/* ADC UE info is kept for IPv4 UEs only */
+		if (ip_hdr_is_ipv6(ipv4_hdr))
+			key[j].rid = 0;
+#endif /* UE_IPV6 */
 		if (flow == UL_FLOW)
 			key[j].ue_ipv4 = ntohl(ipv4_hdr->src_addr);
 		else
@@ -284,13 +353,16 @@ adc_ue_info_get(struct rte_mbuf **pkts, uint32_t n, uint32_t *res,
 		key_ptr[j] = &key[j];
 	}
 
-	if ((rte_hash_lookup_bulk_data(rte_adc_ue_hash,
+	if ((iface_lookup_adc_ue_bulk_data(
 		(const void **)&key_ptr[0], n, &hit_mask, adc_ue_info)) < 0)
 		RTE_LOG(ERR, DP, "ADC UE Bulk LKUP:FAIL!!\n");
 
-	for (j = 0; j < n; j++)
+	prefetch_hits_head(adc_ue_info, n, hit_mask);
+	for (j = 0; j < n; j++) {
+		prefetch_hit_ahead(adc_ue_info, j, n, hit_mask);
 		if (!ISSET_BIT(hit_mask, j))
 			adc_ue_info[j] = NULL;
+	}
 }
 
 void
@@ -304,74 +376,67 @@ dl_sess_info_get(struct rte_mbuf **pkts, uint32_t n,
 	struct ipv4_hdr *ipv4_hdr = NULL;
 	uint32_t dst_addr = 0;
 	uint64_t hit_mask = 0;
+	/* UE address is the inner dst for SGWU, the outer dst otherwise */
+	uint32_t ue_ip_off = (app.spgw_cfg == SGWU) ?
+		(ETH_HDR_SIZE + IPv4_HDR_SIZE + UDP_HDR_SIZE + GPDU_HDR_SIZE) :
+		ETH_HDR_SIZE;
+	uint64_t valid = ~0LLU;
+#ifdef UE_IPV6
+	struct dl6_bm_key key6[MAX_BURST_SZ];
+	void *key6_ptr[MAX_BURST_SZ];
+	void *sess6_info[MAX_BURST_SZ];
+	uint8_t idx6[MAX_BURST_SZ];
+	struct ipv6_hdr *ipv6_hdr;
+	uint64_t hit6_mask = 0;
+	uint32_t n6 = 0;
+#endif /* UE_IPV6 */
 
 	/* TODO: downlink hash is created based on values pushed from CP.
 	 * CP always sends rule-id = 1 while creation.
 	 * After new implementation of ADC-PCC relation lookup will fail.
 	 * Hard coding rule id to 1. (temporary fix)
 	 */
+	if (app.spgw_cfg == SGWU) {
+		/* reject un-tunneled packets or not with s5s8 sgwu ip */
+		valid = gtpu_check_burst(pkts, n, app.s5s8_sgwu_ip);
+		*pkts_mask &= valid;
+	}
+
+	prefetch_pkts_head(pkts, n);
+	prefetch_meta_head(pkts, n);
 	for (j = 0; j < n; j++) {
 		key[j].rid =1;
 		key[j].ue_ipv4 = 0;
 		key_ptr[j] = &key[j];
 
-		switch (app.spgw_cfg) {
-			case SGWU: {
-				struct udp_hdr *udp_hdr = NULL;
-				struct gtpu_hdr *gtpu_hdr = NULL;
-
-				/* reject if not with s1u ip */
-				ipv4_hdr = get_mtoip(pkts[j]);
-				if (ipv4_hdr->dst_addr != app.s5s8_sgwu_ip) {
-					RESET_BIT(*pkts_mask, j);
-					continue;
-				}
-
-				/* reject un-tunneled packet */
-				udp_hdr = get_mtoudp(pkts[j]);
-				if (ntohs(udp_hdr->dst_port) != UDP_PORT_GTPU) {
-					RESET_BIT(*pkts_mask, j);
-					continue;
-				}
-
-				gtpu_hdr = get_mtogtpu(pkts[j]);
-				if (gtpu_hdr->teid == 0 || gtpu_hdr->msgtype != GTP_GPDU) {
-					RESET_BIT(*pkts_mask, j);
-					continue;
-				}
-
-				uint8_t *pkt_ptr = (uint8_t *) gtpu_hdr;
-				pkt_ptr += GPDU_HDR_SIZE;
-				ipv4_hdr = (struct ipv4_hdr *)pkt_ptr;
-				dst_addr = ntohl(ipv4_hdr->dst_addr);
-				break;
-			}
-
-			case PGWU: {
-				/* Values are same as SPGWU.*/
-			}
-
-			case SPGWU: {
-				ipv4_hdr = get_mtoip(pkts[j]);
-				dst_addr = ntohl(ipv4_hdr->dst_addr);
-				break;
-			}
-
-			default:
-				break;
-		}
-
+		prefetch_pkt_ahead(pkts, j, n);
+		prefetch_meta_ahead(pkts, j, n);
+		if (!ISSET_BIT(valid, j))
+			continue;
 
+		ipv4_hdr = rte_pktmbuf_mtod_offset(pkts[j], struct ipv4_hdr *,
+				ue_ip_off);
+#ifdef UE_IPV6
+		if (ip_hdr_is_ipv6(ipv4_hdr)) {
+			/* looked up in the IPv6 table, on the dst /64 */
+			ipv6_hdr = (struct ipv6_hdr *)ipv4_hdr;
+			key6[n6].ue_prefix = ipv6_prefix64(ipv6_hdr->dst_addr);
+			key6[n6].rid = 1;
+			key6[n6].pad = 0;
+			key6_ptr[n6] = &key6[n6];
+			idx6[n6++] = j;
+			dst_addr = ntohl(ipv6_prefix_fold(ipv6_hdr->dst_addr));
+		} else
+#endif /* UE_IPV6 */
+		dst_addr = ntohl(ipv4_hdr->dst_addr);
 		key[j].ue_ipv4 = dst_addr;
 		struct epc_meta_data *meta_data =
 		(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(pkts[j],
 							META_DATA_OFFSET);
 		meta_data->key.ue_ipv4 = key[j].ue_ipv4;
 		meta_data->key.rid = key[j].rid;
-		RTE_LOG(DEBUG, DP, "BEAR_SESS LKUP:DL_KEY ue_addr:"IPV4_ADDR
-				", rid:%u\n",
-				IPV4_ADDR_HOST_FORMAT(meta_data->key.ue_ipv4),
-				meta_data->key.rid);
+		TRACE_POINT(DP_TRACE_SESS, TP_DL_SESS_KEY,
+				meta_data->key.ue_ipv4, meta_data->key.rid, 0);
 		key_ptr[j] = &key[j];
 	}
 
@@ -379,19 +444,45 @@ dl_sess_info_get(struct rte_mbuf **pkts, uint32_t n,
 			&hit_mask, (void **)sess_info)) < 0)
 		RTE_LOG(ERR, DP, "SDF BEAR Bulk LKUP:FAIL!!\n");
 
+#ifdef UE_IPV6
+	if (n6) {
+		/* folded v6 keys can not hit the v4 table, merge v6 hits */
+		for (j = 0; j < n6; j++)
+			RESET_BIT(hit_mask, idx6[j]);
+		if ((iface_lookup_downlink6_bulk_data(
+				(const void **)&key6_ptr[0], n6, &hit6_mask,
+				sess6_info)) < 0)
+			RTE_LOG(ERR, DP, "SDF BEAR6 Bulk LKUP:FAIL!!\n");
+		for (j = 0; j < n6; j++) {
+			if (!ISSET_BIT(hit6_mask, j))
+				continue;
+			sess_info[idx6[j]] = sess6_info[j];
+			SET_BIT(hit_mask, idx6[j]);
+		}
+	}
+#endif /* UE_IPV6 */
+
+	prefetch_hits_head((void **)sess_info, n, hit_mask);
 	for (j = 0; j < n; j++) {
+		prefetch_hit_ahead((void **)sess_info, j, n, hit_mask);
 		if (!ISSET_BIT(hit_mask, j)) {
 			RESET_BIT(*pkts_mask, j);
-			RTE_LOG(DEBUG, DP, "SDF BEAR LKUP FAIL!! DL_KEY "
-					"ue_addr:"IPV4_ADDR", rid:%u\n",
-				IPV4_ADDR_HOST_FORMAT((key[j]).ue_ipv4),
-				key[j].rid);
+			TRACE_POINT(DP_TRACE_SESS, TP_DL_SESS_MISS,
+				key[j].ue_ipv4, key[j].rid, 0);
 			sess_info[j] = NULL;
 			si[j] = NULL;
 		} else {
 			si[j] = sess_info[j]->bear_sess_info;
+			/* encap templates and per packet session state */
+			rte_prefetch0(si[j]);
+			rte_prefetch0(RTE_PTR_ADD(si[j], RTE_CACHE_LINE_SIZE));
+			rte_prefetch0(RTE_PTR_ADD(si[j],
+					2 * RTE_CACHE_LINE_SIZE));
 		}
 	}
+#ifdef SESS_AGING
+	sess_age_touch(sess_info, n, *pkts_mask);
+#endif	/* SESS_AGING */
 }
 
 void
@@ -431,56 +522,43 @@ pcc_gating(struct pcc_id_precedence *sdf_info, struct pcc_id_precedence *adc_inf
 	}
 }
 
-/**
- * To map rating group value to index
- * @param rg_val
- * rating group.
- * @param  rg_idx_map
- * index map structure.
- *
- * @return
- * rating group index
- */
-static uint8_t
-get_rg_idx(uint32_t rg_val, struct rating_group_index_map *rg_idx_map)
-{
-	uint32_t i;
-	if (rg_val == 0)
-		return MAX_RATING_GRP;
-	for (i = 0; i < MAX_RATING_GRP; i++)
-		if (rg_idx_map[i].rg_val == rg_val)
-			return i;
-	return MAX_RATING_GRP;
-}
-
 void
 get_rating_grp(void **adc_ue_info, void **sdf_info,
-		uint32_t **rgrp, uint32_t n)
+		uint8_t *rg_idx, uint32_t n)
 {
 	uint32_t i;
 	struct dp_adc_ue_info *adc_ue;
 	struct dp_sdf_per_bearer_info *psdf;
-	struct dp_pcc_rules *pcc;
 
 	for (i = 0; i < n; i++) {
 			adc_ue = adc_ue_info[i];
-			if (adc_ue && adc_ue->adc_info.rating_group) {
-					rgrp[i] = &adc_ue->adc_info.rating_group;
+			if (adc_ue && (adc_ue->rg_idx < MAX_RATING_GRP)) {
+					rg_idx[i] = adc_ue->rg_idx;
 					continue;
 			}
 			psdf = (struct dp_sdf_per_bearer_info *)sdf_info[i];
-			if (psdf == NULL)
-					continue;
-			pcc = &psdf->pcc_info;
-			if (pcc && pcc->rating_group)
-					rgrp[i] = &pcc->rating_group;
-			else
-					rgrp[i] = NULL;
+			rg_idx[i] = (psdf) ? psdf->rg_idx : MAX_RATING_GRP;
 	}
 }
 
+#ifdef CDR_COUNTER_SHARDS
+#define BEAR_CDR_VOL(si) \
+	cdr_vol(&(si)->ipcan_dp_bearer_cdr, (si)->cdr_slot)
+#define SDF_CDR_VOL(psdf) \
+	cdr_vol(&(psdf)->sdf_cdr, (psdf)->cdr_slot)
+#define ADC_UE_CDR_VOL(adc_ue) \
+	cdr_vol(&(adc_ue)->adc_cdr, (adc_ue)->cdr_slot)
+#define RG_CDR_VOL(ue, idx) \
+	cdr_vol(&(ue)->rating_grp[(idx)], (ue)->rg_cdr_slot[(idx)])
+#else
+#define BEAR_CDR_VOL(si)	(&(si)->ipcan_dp_bearer_cdr.data_vol)
+#define SDF_CDR_VOL(psdf)	(&(psdf)->sdf_cdr.data_vol)
+#define ADC_UE_CDR_VOL(adc_ue)	(&(adc_ue)->adc_cdr.data_vol)
+#define RG_CDR_VOL(ue, idx)	(&(ue)->rating_grp[(idx)].data_vol)
+#endif /* CDR_COUNTER_SHARDS */
+
 static void
-update_cdr(struct ipcan_dp_bearer_cdr *cdr, struct rte_mbuf *pkt,
+update_cdr(struct chrg_data_vol *vol, struct rte_mbuf *pkt,
 				uint32_t flow, enum pkt_action_t action)
 {
 	uint32_t charged_len;
@@ -488,25 +566,34 @@ update_cdr(struct ipcan_dp_bearer_cdr *cdr, struct rte_mbuf *pkt,
 
 	ip_h = rte_pktmbuf_mtod_offset(pkt, struct ipv4_hdr *,
 			sizeof(struct ether_hdr));
+#ifdef UE_IPV6
+	if (ip_hdr_is_ipv6(ip_h))
+		charged_len =
+			RTE_MIN(rte_pktmbuf_pkt_len(pkt) -
+					sizeof(struct ether_hdr),
+					ntohs(((struct ipv6_hdr *)ip_h)->payload_len) +
+					sizeof(struct ipv6_hdr));
+	else
+#endif /* UE_IPV6 */
 	charged_len =
 			RTE_MIN(rte_pktmbuf_pkt_len(pkt) -
 					sizeof(struct ether_hdr),
 					ntohs(ip_h->total_length));
 	if (action == CHARGED) {
 		if (flow == UL_FLOW) {
-			cdr->data_vol.ul_cdr.bytes += charged_len;
-			cdr->data_vol.ul_cdr.pkt_count++;
+			vol->ul_cdr.bytes += charged_len;
+			vol->ul_cdr.pkt_count++;
 		} else {
-			cdr->data_vol.dl_cdr.bytes += charged_len;
-			cdr->data_vol.dl_cdr.pkt_count++;
+			vol->dl_cdr.bytes += charged_len;
+			vol->dl_cdr.pkt_count++;
 		}	/* if (flow == UL_FLOW) */
 	} else {
 		if (flow == UL_FLOW) {
-			cdr->data_vol.ul_drop.bytes += charged_len;
-			cdr->data_vol.ul_drop.pkt_count++;
+			vol->ul_drop.bytes += charged_len;
+			vol->ul_drop.pkt_count++;
 		} else {
-			cdr->data_vol.dl_drop.bytes += charged_len;
-			cdr->data_vol.dl_drop.pkt_count++;
+			vol->dl_drop.bytes += charged_len;
+			vol->dl_drop.pkt_count++;
 		}	/* if (flow == UL_FLOW) */
 	}
 }
@@ -530,11 +617,13 @@ update_adc_cdr(void **adc_ue_info,
 		 * due to pcc rule of metering.*/
 		if ((ISSET_BIT(*adc_pkts_mask, i))
 				&& (ISSET_BIT(*pkts_mask, i)))
-			update_cdr(&adc_ue->adc_cdr, pkts[i], flow, CHARGED);
+			update_cdr(ADC_UE_CDR_VOL(adc_ue), pkts[i], flow,
+					CHARGED);
 
 		/* record drop counts if ADC rule is hit but gate is closed*/
 		if (!(ISSET_BIT(*adc_pkts_mask, i)))
-			update_cdr(&adc_ue->adc_cdr, pkts[i], flow, DROPPED);
+			update_cdr(ADC_UE_CDR_VOL(adc_ue), pkts[i], flow,
+					DROPPED);
 	}	/* for (i = 0; i < n; i++)*/
 }
 #endif /* ADC_UPFRONT*/
@@ -567,9 +656,9 @@ update_sdf_cdr(void **adc_ue_info,
 			continue;
 
 		if (ISSET_BIT(*pkts_mask, i))
-			update_cdr(&psdf->sdf_cdr, pkts[i], flow, CHARGED);
+			update_cdr(SDF_CDR_VOL(psdf), pkts[i], flow, CHARGED);
 		else
-			update_cdr(&psdf->sdf_cdr, pkts[i], flow, DROPPED);
+			update_cdr(SDF_CDR_VOL(psdf), pkts[i], flow, DROPPED);
 	}	/* for (i = 0; i < n; i++)*/
 }
 
@@ -592,25 +681,27 @@ update_bear_cdr(struct dp_sdf_per_bearer_info **sdf_bear_info,
 			continue;
 
 		if (ISSET_BIT(*pkts_mask, i))
-			update_cdr(&si->ipcan_dp_bearer_cdr, pkts[i],
+			update_cdr(BEAR_CDR_VOL(si), pkts[i],
 					flow, CHARGED);
 		else
-			update_cdr(&si->ipcan_dp_bearer_cdr, pkts[i],
+			update_cdr(BEAR_CDR_VOL(si), pkts[i],
 					flow, DROPPED);
 	}	/* for (i = 0; i < n; i++)*/
 }
 
 void
-update_rating_grp_cdr(void **sess_info, uint32_t **rgrp,
+update_rating_grp_cdr(void **sess_info, uint8_t *rg_idx,
 		struct rte_mbuf **pkts, uint32_t n,
 		uint64_t *pkts_mask, uint32_t flow)
 {
 	uint32_t i;
 	struct dp_session_info *si;
 	struct dp_sdf_per_bearer_info *psdf;
-	uint8_t rg_idx;
 
 	for (i = 0; i < n; i++) {
+		if (rg_idx[i] >= MAX_RATING_GRP)
+			continue;
+
 		psdf = (struct dp_sdf_per_bearer_info *)sess_info[i];
 		if (psdf == NULL)
 			continue;
@@ -619,18 +710,11 @@ update_rating_grp_cdr(void **sess_info, uint32_t **rgrp,
 		if (si == NULL)
 			continue;
 
-		if (rgrp[i] == NULL)
-			continue;
-
-		rg_idx = get_rg_idx(*rgrp[i], si->ue_info_ptr->rg_idx_map);
-		if (rg_idx >= MAX_RATING_GRP)
-			continue;
-
 		if (ISSET_BIT(*pkts_mask, i))
-			update_cdr(&si->ue_info_ptr->rating_grp[rg_idx],
+			update_cdr(RG_CDR_VOL(si->ue_info_ptr, rg_idx[i]),
 					pkts[i], flow, CHARGED);
 		else
-			update_cdr(&si->ue_info_ptr->rating_grp[rg_idx],
+			update_cdr(RG_CDR_VOL(si->ue_info_ptr, rg_idx[i]),
 					pkts[i], flow, DROPPED);
 	}	/* for (i = 0; i < n; i++)*/
 }
@@ -649,6 +733,11 @@ adc_hash_lookup(struct rte_mbuf **pkts, uint32_t n, uint32_t *rid, uint8_t flow)
 		ipv4_hdr = get_mtoip(pkts[j]);
 		key32[j] = (flow == UL_FLOW) ? ipv4_hdr->dst_addr :
 				ipv4_hdr->src_addr;
+#ifdef UE_IPV6
+		/* domain hash holds IPv4 servers only */
+		if (ip_hdr_is_ipv6(ipv4_hdr))
+			key32[j] = 0;
+#endif /* UE_IPV6 */
 		key_ptr[j] = &key32[j];
 	}
 
@@ -658,8 +747,8 @@ adc_hash_lookup(struct rte_mbuf **pkts, uint32_t n, uint32_t *rid, uint8_t flow)
 
 	for (j = 0; j < n; j++) {
 		if (ISSET_BIT(hit_mask, j)) {
-			RTE_LOG(DEBUG, DP, "ADC_DNS_LKUP: rid[%d]:%u\n", j,
-					data[j]->rule_id);
+			TRACE_POINT(DP_TRACE_ADC, TP_ADC_DNS_HIT, j,
+					data[j]->rule_id, 0);
 			rid[j] = data[j]->rule_id;
 		} else {
 			rid[j] = 0;
@@ -675,6 +764,10 @@ static inline bool is_dns_pkt(struct rte_mbuf *m, uint32_t rid)
 	eth_hdr = rte_pktmbuf_mtod(m, struct ether_hdr *);
 	ip_hdr = (struct ipv4_hdr *)(eth_hdr + 1);
 
+#ifdef UE_IPV6
+	if (ip_hdr_is_ipv6(ip_hdr))
+		return false;
+#endif /* UE_IPV6 */
 	if (rte_ipv4_frag_pkt_is_fragmented(ip_hdr))
 		return false;
 
@@ -738,7 +831,10 @@ update_nexthop_info(struct rte_mbuf **pkts, uint32_t n,
 		struct dp_sdf_per_bearer_info **sess_info)
 {
 	uint32_t i;
+
+	prefetch_pkts_head(pkts, n);
 	for (i = 0; i < n; i++) {
+		prefetch_pkt_ahead(pkts, i, n);
 		if (ISSET_BIT(*pkts_mask, i)) {
 			if (construct_ether_hdr(pkts[i], portid, &sess_info[i]) < 0)
 				RESET_BIT(*pkts_mask, i);
@@ -757,20 +853,22 @@ update_nexts5s8_info(struct rte_mbuf **pkts, uint32_t n,
 
 	for (i = 0; i < n; i++) {
 		if (ISSET_BIT(*pkts_mask, i)) {
-			len = rte_pktmbuf_data_len(pkts[i]);
+			len = rte_pktmbuf_pkt_len(pkts[i]);
 			len = len - ETH_HDR_SIZE;
 
 			if (app.spgw_cfg == SGWU) {
 				/*TODO : Make readable*/
 				uint32_t s5s8_pgwu_addr =
-					sdf_bear_info[i]->bear_sess_info->ul_s1_info.s5s8_pgwu_addr.u.ipv4_addr;
+					sdf_bear_info[i]->bear_sess_info->s5s8_pgwu_ipv4;
 				construct_ipv4_hdr(pkts[i], len, IP_PROTO_UDP,
-						ntohl(app.s5s8_sgwu_ip), s5s8_pgwu_addr);
+						ntohl(app.s5s8_sgwu_ip), s5s8_pgwu_addr,
+						app.s5s8_sgwu_port);
 			}else if (app.spgw_cfg == PGWU) {
 				uint32_t s5s8_sgwu_addr =
-					sdf_bear_info[i]->bear_sess_info->dl_s1_info.s5s8_sgwu_addr.u.ipv4_addr;
+					sdf_bear_info[i]->bear_sess_info->s5s8_sgwu_ipv4;
 				construct_ipv4_hdr(pkts[i], len, IP_PROTO_UDP,
-						ntohl(app.s5s8_pgwu_ip), s5s8_sgwu_addr);
+						ntohl(app.s5s8_pgwu_ip), s5s8_sgwu_addr,
+						app.s5s8_pgwu_port);
 			}
 		}
 	}
@@ -785,21 +883,82 @@ update_enb_info(struct rte_mbuf **pkts, uint32_t n,
 
 	for (i = 0; i < n; i++) {
 		if (ISSET_BIT(*pkts_mask, i)) {
-			len = rte_pktmbuf_data_len(pkts[i]);
+			len = rte_pktmbuf_pkt_len(pkts[i]);
 			len = len - ETH_HDR_SIZE;
 
 			uint32_t enb_addr =
-					sess_info[i]->bear_sess_info->dl_s1_info.enb_addr.u.ipv4_addr;
+					sess_info[i]->bear_sess_info->enb_ipv4;
 			construct_ipv4_hdr(pkts[i], len, IP_PROTO_UDP,
-					ntohl(app.s1u_ip), enb_addr);
+					ntohl(app.s1u_ip), enb_addr, app.s1u_port);
 
 			/*Update tied in GTP U header*/
 			((struct gtpu_hdr *)get_mtogtpu(pkts[i]))->teid  =
-					ntohl(sess_info[i]->bear_sess_info->dl_s1_info.enb_teid);
+					ntohl(sess_info[i]->bear_sess_info->enb_teid);
 		}
 	}
 }
 
+#ifdef EGRESS_QOS
+/**
+ * Egress traffic class of QCI.
+ */
+static inline uint32_t
+egress_qos_tc(uint8_t qci)
+{
+	switch (qci) {
+	case 5:		/* IMS signalling */
+	case 69:	/* Mission critical signalling */
+		return EGRESS_QOS_TC_SIGNALLING;
+	case 1:
+	case 2:
+	case 3:
+	case 4:
+	case 65:
+	case 66:
+	case 67:
+	case 75:
+		return EGRESS_QOS_TC_GBR;
+	case 6:
+	case 7:
+	case 70:
+		return EGRESS_QOS_TC_PRIO;
+	default:
+		return EGRESS_QOS_TC_BE;
+	}
+}
+
+void
+egress_qos_classify(struct rte_mbuf **pkts, uint32_t n,
+		uint64_t *pkts_mask, struct dp_sdf_per_bearer_info **sess_info)
+{
+	struct dp_session_info *si;
+	uint32_t i, subport, pipe, queue;
+
+	for (i = 0; i < n; i++) {
+		if (!ISSET_BIT(*pkts_mask, i))
+			continue;
+
+		if (sess_info[i] == NULL) {
+			rte_sched_port_pkt_write(pkts[i], 0, 0,
+					EGRESS_QOS_TC_BE, 0, e_RTE_METER_GREEN);
+			continue;
+		}
+
+		si = sess_info[i]->bear_sess_info;
+		subport = rte_jhash_1word(si->enb_ipv4, 0)
+				& (EGRESS_QOS_SUBPORTS - 1);
+		pipe = rte_jhash_1word((uint32_t)UE_SESS_ID(si->sess_id), 0)
+				& (EGRESS_QOS_PIPES - 1);
+		/* ARP priority level 1..15, higher WRR weight for 1..4 */
+		queue = ((sess_info[i]->qos.arp - 1) >> 2) & 0x3;
+
+		rte_sched_port_pkt_write(pkts[i], subport, pipe,
+				egress_qos_tc(sess_info[i]->qos.qci), queue,
+				e_RTE_METER_GREEN);
+	}
+}
+#endif	/* EGRESS_QOS */
+
 void
 update_adc_rid_from_domain_lookup(uint32_t *rb, uint32_t *rc, uint32_t n)
 {
@@ -815,43 +974,86 @@ update_adc_rid_from_domain_lookup(uint32_t *rb, uint32_t *rc, uint32_t n)
  *
  */
 int
-hash_create(const char *name, struct rte_hash **rte_hash,
-		uint32_t entries, uint32_t key_len)
+hash_create_socket(const char *name, struct rte_hash **rte_hash,
+		uint32_t entries, uint32_t key_len, int socket_id)
 {
 	struct rte_hash_parameters rte_hash_params = {
 		.name = name,
 		.entries = entries,
 		.key_len = key_len,
+#ifdef HASH_SELECT
+		.hash_func = hash_select_func(name, key_len),
+#else
 		.hash_func = DEFAULT_HASH_FUNC,
+#endif
 		.hash_func_init_val = 0,
-		.socket_id = rte_socket_id(),
+		.socket_id = socket_id,
 	};
 
+#ifdef TABLE_BUDGET
+	size_t mark = table_budget_mark();
+#endif
+
 	*rte_hash = rte_hash_create(&rte_hash_params);
 	if (*rte_hash == NULL)
 		rte_exit(EXIT_FAILURE, "%s hash create failed: %s (%u)\n",
 			rte_hash_params.name,
 			rte_strerror(rte_errno), rte_errno);
+#ifdef TABLE_BUDGET
+	table_budget_account(name, mark);
+#endif
 	return 0;
 }
 
+int
+hash_create(const char *name, struct rte_hash **rte_hash,
+		uint32_t entries, uint32_t key_len)
+{
+	return hash_create_socket(name, rte_hash, entries, key_len,
+			rte_socket_id());
+}
+
 void dp_table_init(void)
 {
 #ifdef DP_TABLE_CONFIG
 	int ret;
 
+#ifdef TABLE_BUDGET
+	table_budget_init();
+#endif
+#ifdef HASH_SELECT
+	hash_select_init();
+#endif
+#ifdef SHARDED_SESS_TABLE
+	/*
+	 * Create per worker Uplink, Downlink and ADC UE info DBs
+	 */
+	sess_table_shards_init();
+#else
 	/*
 	 * Create Uplink DB
 	 */
-	hash_create("iface_uplink_db", &rte_uplink_hash,
-				LDB_ENTRIES_DEFAULT * HASH_SIZE_FACTOR,
+	hash_create("iface_uplink_db", &rte_uplink_hash, DP_BEARER_ENTRIES,
 				sizeof(struct ul_bm_key));
 	/*
 	 * Create Downlink DB
 	 */
-	hash_create("iface_downlink_db", &rte_downlink_hash,
-				LDB_ENTRIES_DEFAULT * HASH_SIZE_FACTOR,
+	hash_create("iface_downlink_db", &rte_downlink_hash, DP_BEARER_ENTRIES,
 				sizeof(struct dl_bm_key));
+#ifdef UE_IPV6
+	/*
+	 * Create IPv6 UE Downlink DB
+	 */
+	hash_create("iface_downlink6_db", &rte_downlink6_hash,
+			DP_BEARER_ENTRIES, sizeof(struct dl6_bm_key));
+#endif /* UE_IPV6 */
+#endif	/* SHARDED_SESS_TABLE */
+#ifdef UL_TEID_TABLE
+	ul_teid_table_init();
+#endif
+#ifdef CDR_COUNTER_SHARDS
+	cdr_shard_init();
+#endif
 
 	/*
 	 * Create ADC Domain Hash table
@@ -859,16 +1061,19 @@ void dp_table_init(void)
 	hash_create("adc_domain_hash", &rte_adc_hash, LDB_ENTRIES_DEFAULT,
 			sizeof(uint32_t));
 
+#ifndef SHARDED_SESS_TABLE
 	/*
 	 * Create ADC UE info Hash table
 	 */
-	hash_create("adc_ue_info", &rte_adc_ue_hash, LDB_ENTRIES_DEFAULT,
+	hash_create("adc_ue_info", &rte_adc_ue_hash, DP_UE_ENTRIES,
 			sizeof(struct dl_bm_key));
+#endif
+	ue_pool_tables_init();
 
 	/*
 	 * Create UE Sess Hash table
 	 */
-	hash_create("ue_sess_info", &rte_ue_hash, LDB_ENTRIES_DEFAULT,
+	hash_create("ue_sess_info", &rte_ue_hash, DP_UE_ENTRIES,
 			sizeof(uint32_t));
 
 	/* Create table for sponsored domain names */
@@ -876,6 +1081,8 @@ void dp_table_init(void)
 	if (ret)
 		rte_exit(EXIT_FAILURE,
 			"error allocating sponsored DN context %d\n", ret);
+	/* DNS lcores may still scan a replaced database */
+	epc_sponsdn_set_retire(dp_defer_call);
 	/*
 	 * Init callback APIs
 	 */
@@ -912,7 +1119,7 @@ void dp_table_init(void)
 			"error in creating Meter profile table %d\n", ret);
 
 	sprintf(dp_id.name, SESSION_TABLE);
-	ret = dp_session_table_create(dp_id, LDB_ENTRIES_DEFAULT);
+	ret = dp_session_table_create(dp_id, DP_SESS_ENTRIES);
 	if (ret)
 		rte_exit(EXIT_FAILURE,
 			"error in creating session table %d\n", ret);
@@ -939,6 +1146,17 @@ void dp_table_init(void)
 	hash_create("adc_pcc_hash", &rte_adc_pcc_hash, SDF_FILTER_TABLE_SIZE,
 			sizeof(uint32_t));
 
+	/*
+	 * Create SDF/ADC rule PCC node Hash table
+	 */
+	hash_create("filter_pcc_node_hash", &rte_filter_pcc_node_hash,
+			FILTER_PCC_NODE_TABLE_SIZE,
+			sizeof(struct filter_pcc_node_key));
+
+#ifdef TABLE_BUDGET
+	table_budget_print();
+#endif
+
 #ifdef PCAP_GEN
 	printf("\n\npcap files will be overwritten. Press ENTER to continue...\n");
 	getchar();
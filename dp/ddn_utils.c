@@ -16,6 +16,367 @@
 
 #include "main.h"
 #include <rte_errno.h>
+#ifdef DDN_BUF_POOL
+#include "gtpu.h"
+#include "qsbr.h"
+#endif
+/**
+ * @brief Send Downlink Data Notification of an idle session to CP.
+ *
+ * @param si
+ * Session.
+ *
+ * @return
+ *  void
+ */
+static void
+send_ddn(struct dp_session_info *si)
+{
+#ifdef SDN_ODL_BUILD
+	zmq_ddn(si->sess_id, si->client_id);
+#else
+	struct msgbuf msg_payload = {
+		.mtype = MSG_DDN,
+		.dp_id.id = DPN_ID,
+		.msg_union.sess_entry.sess_id = si->sess_id };
+
+	if (comm_node[COMM_CP_DP].send(&msg_payload,
+			sizeof(struct msgbuf)) < 0) {
+			perror("msgsnd");
+	}
+#endif
+	si->sess_state = IN_PROGRESS;
+}
+
+#ifdef DDN_BUF_POOL
+uint64_t ddn_buf_deleted;
+volatile uint32_t ddn_buf_pkts;
+
+void
+ddn_buf_pool_init(struct epc_worker_params *wk_params, int core)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "ddn_buf_pool_%d", core);
+	/* multi producer: buffers of deleted sessions are put back by the
+	 * lcore reclaiming them */
+	wk_params->ddn_buf_pool = rte_mempool_create(name, DDN_BUF_UES,
+			sizeof(struct ddn_buf), 0, 0, NULL, NULL, NULL, NULL,
+			dp_lcore_socket(core), 0);
+	if (wk_params->ddn_buf_pool == NULL)
+		rte_panic("Couldnt create %s - %s\n", name,
+				rte_strerror(rte_errno));
+}
+
+/**
+ * @brief Attach an empty paging buffer to a session.
+ *
+ * @return
+ *  - paging buffer
+ *  - NULL if the pool is empty or the session is being deleted
+ */
+static struct ddn_buf *
+ddn_buf_attach(struct dp_session_info *si,
+		struct epc_worker_params *wk_params)
+{
+	struct ddn_buf *buf;
+
+	if (rte_mempool_get(wk_params->ddn_buf_pool, (void **)&buf) < 0)
+		return NULL;
+
+	buf->head = NULL;
+	buf->tail = NULL;
+	buf->pkts = 0;
+	buf->bytes = 0;
+	buf->mp = wk_params->ddn_buf_pool;
+	buf->queued = 0;
+	/* the iface core may have closed it since it was read */
+	if (!__sync_bool_compare_and_swap(&si->ddn_buf, NULL, buf)) {
+		rte_mempool_put(buf->mp, buf);
+		return NULL;
+	}
+	return buf;
+}
+
+/**
+ * @brief Append a pkt to a paging buffer, evicting the oldest pkts
+ * beyond DDN_BUF_UE_PKTS or DDN_BUF_UE_BYTES. Past DDN_BUF_PKTS the
+ * pkt replaces the oldest one of the session, or is dropped if the
+ * session has none.
+ */
+static inline void
+ddn_buf_append(struct ddn_buf *buf, struct rte_mbuf *m,
+		struct ddn_buf_stats *stats)
+{
+	struct rte_mbuf *old;
+	uint32_t evict = 0;
+
+	if (unlikely(__sync_fetch_and_add(&ddn_buf_pkts, 1) >=
+				DDN_BUF_PKTS)) {
+		if (buf->head == NULL) {
+			__sync_fetch_and_sub(&ddn_buf_pkts, 1);
+			rte_pktmbuf_free(m);
+			stats->full++;
+			return;
+		}
+		evict = 1;
+	}
+
+	m->userdata = NULL;
+	if (buf->tail != NULL)
+		buf->tail->userdata = m;
+	else
+		buf->head = m;
+	buf->tail = m;
+	buf->pkts++;
+	buf->bytes += rte_pktmbuf_pkt_len(m);
+	stats->buffered++;
+
+	while (evict || (buf->pkts > DDN_BUF_UE_PKTS) ||
+			(buf->bytes > DDN_BUF_UE_BYTES)) {
+		old = buf->head;
+		buf->head = old->userdata;
+		if (buf->head == NULL)
+			buf->tail = NULL;
+		buf->pkts--;
+		buf->bytes -= rte_pktmbuf_pkt_len(old);
+		rte_pktmbuf_free(old);
+		__sync_fetch_and_sub(&ddn_buf_pkts, 1);
+		stats->evicted++;
+		evict = 0;
+	}
+}
+
+/**
+ * @brief Take the paging buffer of a session.
+ *
+ * @return
+ *  - paging buffer, to be returned to buf->mp
+ *  - NULL if the session has none or is being deleted
+ */
+static struct ddn_buf *
+ddn_buf_detach(struct dp_session_info *si)
+{
+	struct ddn_buf *buf;
+
+	do {
+		buf = si->ddn_buf;
+		if ((buf == NULL) || (buf == DDN_BUF_CLOSED))
+			return NULL;
+	} while (!__sync_bool_compare_and_swap(&si->ddn_buf, buf, NULL));
+
+	return buf;
+}
+
+/**
+ * @brief Dequeue up to n pkts, oldest first, from a paging buffer.
+ *
+ * @return
+ *  number of pkts dequeued
+ */
+static uint32_t
+ddn_buf_dequeue_burst(struct ddn_buf *buf, struct rte_mbuf **pkts,
+		uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; (i < n) && (buf->head != NULL); i++) {
+		pkts[i] = buf->head;
+		buf->head = pkts[i]->userdata;
+		buf->pkts--;
+		buf->bytes -= rte_pktmbuf_pkt_len(pkts[i]);
+	}
+	if (buf->head == NULL)
+		buf->tail = NULL;
+	if (i)
+		__sync_fetch_and_sub(&ddn_buf_pkts, i);
+	return i;
+}
+
+/**
+ * @brief Encap and send up to max pkts of the paging buffer of a
+ * connected session.
+ *
+ * @return
+ *  number of pkts taken from the buffer
+ */
+static uint32_t
+ddn_buf_send(struct epc_worker_params *wk_params,
+		struct dp_session_info *si, struct ddn_buf *buf, uint32_t max)
+{
+	struct rte_mbuf *pkts[MAX_BURST_SZ];
+	struct dp_sdf_per_bearer_info *sdf_info[MAX_BURST_SZ] = {NULL};
+	uint64_t pkts_mask;
+	uint32_t n, i, sent = 0;
+
+	while ((sent < max) && ((n = ddn_buf_dequeue_burst(buf, pkts,
+				RTE_MIN(max - sent, (uint32_t)MAX_BURST_SZ)))
+				> 0)) {
+		pkts_mask = (~0LLU) >> (64 - n);
+		for (i = 0; i < n; i++)
+			if (encap_gtpu_tmpl(pkts[i], si->dl_encap,
+						app.s1u_port) < 0)
+				RESET_BIT(pkts_mask, i);
+		update_nexthop_info(pkts, n, &pkts_mask, app.s1u_port,
+				&sdf_info[0]);
+		for (i = 0; i < n; i++) {
+			if (ISSET_BIT(pkts_mask, i))
+				rte_pipeline_port_out_packet_insert(
+						wk_params->pipeline,
+						app.s1u_port, pkts[i]);
+			else
+				rte_pktmbuf_free(pkts[i]);
+		}
+		sent += n;
+	}
+	wk_params->ddn_stats.released += sent;
+	return sent;
+}
+
+/**
+ * @brief Return the emptied paging buffer of a session to its pool.
+ * The buffer of a session being deleted goes back with ddn_buf_drop().
+ */
+static inline void
+ddn_buf_done(struct dp_session_info *si, struct ddn_buf *buf)
+{
+	if (ddn_buf_detach(si) == buf)
+		rte_mempool_put(buf->mp, buf);
+}
+
+void
+ddn_buf_release_queue(struct epc_worker_params *wk_params,
+		struct dp_session_info *si)
+{
+	struct ddn_release_queue *q = &wk_params->ddn_release;
+	struct ddn_buf *buf = si->ddn_buf;
+
+	if ((buf == NULL) || (buf == DDN_BUF_CLOSED) || buf->queued)
+		return;
+
+	if (unlikely(q->n == DDN_RELEASE_QUEUE_SZ)) {
+		ddn_buf_send(wk_params, si, buf, UINT32_MAX);
+		ddn_buf_done(si, buf);
+		return;
+	}
+	buf->queued = 1;
+	q->sess_id[(q->head + q->n) % DDN_RELEASE_QUEUE_SZ] = si->sess_id;
+	q->n++;
+}
+
+void
+ddn_buf_release_run(struct epc_worker_params *wk_params, uint32_t budget)
+{
+	struct ddn_release_queue *q = &wk_params->ddn_release;
+	struct dp_session_info *si;
+	struct ddn_buf *buf;
+	uint32_t visits = q->n;
+	uint64_t sess_id;
+
+	while (budget && visits--) {
+		sess_id = q->sess_id[q->head];
+		q->head = (q->head + 1) % DDN_RELEASE_QUEUE_SZ;
+		q->n--;
+
+		si = get_session_data(sess_id, 1);
+		buf = (si != NULL) ? si->ddn_buf : NULL;
+		if ((buf == NULL) || (buf == DDN_BUF_CLOSED))
+			continue;
+		if (!si->dl_encap->teid) {
+			/* idle again, released after the next modify */
+			buf->queued = 0;
+			continue;
+		}
+
+		budget -= ddn_buf_send(wk_params, si, buf,
+				RTE_MIN(budget, (uint32_t)MAX_BURST_SZ));
+		if (buf->head == NULL) {
+			buf->queued = 0;
+			ddn_buf_done(si, buf);
+			continue;
+		}
+		/* back of the queue, the other sessions go first */
+		q->sess_id[(q->head + q->n) % DDN_RELEASE_QUEUE_SZ] = sess_id;
+		q->n++;
+	}
+}
+
+/**
+ * @brief Drop the pkts of a closed paging buffer and return it to its
+ * pool, once the worker is done with it.
+ */
+static void
+ddn_buf_drop(void *obj)
+{
+	struct ddn_buf *buf = obj;
+	struct rte_mbuf *m, *next;
+
+	for (m = buf->head; m != NULL; m = next) {
+		next = m->userdata;
+		rte_pktmbuf_free(m);
+	}
+	ddn_buf_deleted += buf->pkts;
+	__sync_fetch_and_sub(&ddn_buf_pkts, buf->pkts);
+	rte_mempool_put(buf->mp, buf);
+}
+
+void
+ddn_buf_close(struct dp_session_info *si)
+{
+	struct ddn_buf *buf;
+
+	do {
+		buf = si->ddn_buf;
+	} while (!__sync_bool_compare_and_swap(&si->ddn_buf, buf,
+				DDN_BUF_CLOSED));
+
+	/* the worker may still be appending to it */
+	if ((buf != NULL) && (buf != DDN_BUF_CLOSED))
+		dp_defer_call(ddn_buf_drop, buf);
+}
+
+void
+enqueue_dl_pkts(struct dp_sdf_per_bearer_info **sess_info,
+		struct rte_mbuf **pkts, uint64_t pkts_queue_mask,
+		int wk_index)
+{
+	struct epc_worker_params *wk_params = &epc_app.worker[wk_index];
+	struct ddn_buf_stats *stats = &wk_params->ddn_stats;
+	struct dp_session_info *si;
+	struct ddn_buf *buf;
+	int i;
+
+	while (pkts_queue_mask) {
+		i = __builtin_ffsll(pkts_queue_mask) - 1;
+		RESET_BIT(pkts_queue_mask, i);
+
+		si = ((struct dp_sdf_per_bearer_info *)
+				sess_info[i])->bear_sess_info;
+
+		if (si->sess_state == IDLE)
+			send_ddn(si);
+
+		buf = si->ddn_buf;
+		if (unlikely(buf == DDN_BUF_CLOSED)) {
+			rte_pktmbuf_free(pkts[i]);
+			stats->closed++;
+			continue;
+		}
+		if (buf == NULL) {
+			buf = ddn_buf_attach(si, wk_params);
+			if (buf == NULL) {
+				rte_pktmbuf_free(pkts[i]);
+				if (si->ddn_buf == DDN_BUF_CLOSED)
+					stats->closed++;
+				else
+					stats->no_buf++;
+				continue;
+			}
+		}
+		ddn_buf_append(buf, pkts[i], stats);
+	}
+}
+#else
 /**
  * @brief Allocates ring for buffering downlink packets
  * Allocate downlink packet buffer ring from a set of
@@ -100,24 +461,10 @@ enqueue_dl_pkts(struct dp_sdf_per_bearer_info **sess_info,
 				continue;
 			}
 			si->dl_ring = ring;
-			if (si->sess_state == IDLE) {
-#ifdef SDN_ODL_BUILD
-				zmq_ddn(si->sess_id, si->client_id);
-#else
-				struct msgbuf msg_payload = {
-					.mtype = MSG_DDN,
-					.dp_id.id = DPN_ID,
-					.msg_union.sess_entry.sess_id = si->sess_id };
-
-				if (comm_node[COMM_SOCKET].send(&msg_payload,
-						sizeof(struct msgbuf)) < 0) {
-						perror("msgsnd");
-				}
-#endif
-				si->sess_state = IN_PROGRESS;
-			}
+			if (si->sess_state == IDLE)
+				send_ddn(si);
 		}
 		rte_ring_enqueue(ring, (void *)pkts[i]);
 	}
 }
-
+#endif	/* DDN_BUF_POOL */
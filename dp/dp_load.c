@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef MULTI_DP
+#include <stdio.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+
+#include "main.h"
+#include "epc_packet_framework.h"
+#include "interface.h"
+#include "dp_ipc_api.h"
+#include "dp_load.h"
+
+#ifndef STATS
+#error "MULTI_DP requires STATS"
+#endif
+
+static uint64_t load_interval;
+static uint64_t load_last;
+static uint64_t rx_prev;
+static uint64_t drops_prev;
+
+/**
+ * Sum the rx pkts and rx drops of all ports.
+ */
+static void
+dp_load_sample(uint64_t *rx, uint64_t *drops)
+{
+	struct rte_eth_stats es;
+	uint8_t port;
+
+	*rx = 0;
+	*drops = 0;
+	for (port = 0; port < epc_app.n_ports; port++) {
+		if (rte_eth_stats_get(port, &es))
+			continue;
+		*rx += es.ipackets;
+		*drops += es.imissed + es.rx_nombuf + es.ierrors;
+	}
+}
+
+void
+dp_load_init(void)
+{
+	load_interval = rte_get_tsc_hz() * DP_LOAD_INTERVAL_MS / 1000;
+	load_last = rte_rdtsc();
+	dp_load_sample(&rx_prev, &drops_prev);
+}
+
+void
+dp_load_poll(void)
+{
+	struct msgbuf msg_payload = {
+		.mtype = MSG_DP_LOAD,
+		.dp_id.id = DPN_ID };
+	struct msg_dp_load *rpt = &msg_payload.msg_union.dp_load;
+	uint64_t now = rte_rdtsc();
+	uint64_t rx, drops, ms;
+
+	if (load_interval == 0 || now - load_last < load_interval)
+		return;
+	ms = (now - load_last) * 1000 / rte_get_tsc_hz();
+	load_last = now;
+
+	dp_load_sample(&rx, &drops);
+	/* counters restart from 0 with STATS_CLR */
+	if (rx < rx_prev || drops < drops_prev) {
+		rx_prev = 0;
+		drops_prev = 0;
+	}
+
+	rpt->dp_ip = dp_comm_ip;
+	rpt->dp_port = dp_comm_port;
+	rpt->kpps = (rx - rx_prev) / ms;
+	rpt->drops = (drops - drops_prev) * 1000 / ms;
+	rx_prev = rx;
+	drops_prev = drops;
+
+	if (comm_node[COMM_CP_DP].send(&msg_payload,
+			MSGBUF_HDR_LEN + sizeof(*rpt)) < 0)
+		RTE_LOG(ERR, DP, "Failed to send load report\n");
+}
+#endif /* MULTI_DP */
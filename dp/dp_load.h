@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _DP_LOAD_H_
+#define _DP_LOAD_H_
+/**
+ * @file
+ * This file contains the prototypes of the DP load reporter.
+ *
+ * With MULTI_DP one CP spreads the UEs over several DPs. The stats lcore
+ * of each DP sends the CP a MSG_DP_LOAD every DP_LOAD_INTERVAL_MS with
+ * the NIC rx rate and drops of the last interval, summed over the ports.
+ * The CP places new UEs by these and by the UEs it already placed, see
+ * cp/dp_pool.h.
+ */
+#ifdef MULTI_DP
+
+/**
+ * Take the first sample of the NIC counters. Called once the ports are
+ * started.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void dp_load_init(void);
+
+/**
+ * Send the load report if DP_LOAD_INTERVAL_MS passed since the last one.
+ * Called by the stats lcore.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void dp_load_poll(void);
+
+#endif /* MULTI_DP */
+#endif /* _DP_LOAD_H_ */
@@ -22,7 +22,9 @@
 #include "ether.h"
 #include "util.h"
 #include "ipv4.h"
+#include "ipv6.h"
 #include "pipeline/epc_arp_icmp.h"
+#include "neigh_cache.h"
 
 /**
  * Function to set ethertype.
@@ -95,6 +97,17 @@ int construct_ether_hdr(struct rte_mbuf *m, uint8_t portid,
 		}
 	}
 
+#ifdef UE_IPV6
+	/*
+	 * Uplink IPv6 UE pkts leave untunneled on SGi only, there is no
+	 * neighbor discovery: they go to the MAC of the SGi gateway.
+	 */
+	if (app.spgw_cfg != SGWU && portid == app.sgi_port &&
+			ip_hdr_is_ipv6(ipv4_hdr)) {
+		tmp_arp_key.ip = app.sgi_gw_ip;
+		eth_hdr->ether_type = htons(ETH_TYPE_IPv6);
+	} else
+#endif /* UE_IPV6 */
 	/* IPv4 L2 hdr */
 	eth_hdr->ether_type = htons(ETH_TYPE_IPv4);
 
@@ -124,6 +137,25 @@ int construct_ether_hdr(struct rte_mbuf *m, uint8_t portid,
 	} else
 		return 0;
 #endif
+#ifdef NEIGH_CACHE
+	struct neigh_cache *nc = neigh_cache_get();
+	uint32_t epoch = neigh_cache_epoch;
+	const struct ether_addr *nh_mac = NULL;
+
+	/* the MAC read below is at least as new as epoch */
+	rte_smp_rmb();
+	if (likely(nc != NULL))
+		nh_mac = neigh_cache_lookup(nc, tmp_arp_key.ip, portid, epoch);
+	if (likely(nh_mac != NULL)) {
+		ether_addr_copy(nh_mac, &eth_hdr->d_addr);
+		ether_addr_copy(&ports_eth_addr[portid], &eth_hdr->s_addr);
+#ifdef INSTMNT
+		flag_wrkr_update_diff = 1;
+		total_wrkr_pkts_processed++;
+#endif
+		return 0;
+	}
+#endif	/* NEIGH_CACHE */
 	ret_arp_data = retrieve_arp_entry(tmp_arp_key);
 
 
@@ -153,6 +185,11 @@ int construct_ether_hdr(struct rte_mbuf *m, uint8_t portid,
 					ret_arp_data->eth_addr.addr_bytes[5]);
 
 	ether_addr_copy(&ret_arp_data->eth_addr, &eth_hdr->d_addr);
+#ifdef NEIGH_CACHE
+	if ((nc != NULL) && (ret_arp_data->status == COMPLETE))
+		neigh_cache_insert(nc, tmp_arp_key.ip, portid,
+				&ret_arp_data->eth_addr, epoch);
+#endif	/* NEIGH_CACHE */
 #endif				/* SKIP_ARP_LOOKUP */
 
 	ether_addr_copy(&ports_eth_addr[portid], &eth_hdr->s_addr);
@@ -26,6 +26,7 @@
 #include <rte_ether.h>
 
 #define ETH_TYPE_IPv4 0x0800
+#define ETH_TYPE_IPv6 0x86DD
 
 /**
  * Function to return pointer to L2 headers.
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef FLOW_CACHE
+#include <rte_malloc.h>
+#include <rte_ip.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+#include <rte_hash_crc.h>
+
+#include "main.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "flow_cache.h"
+
+volatile uint32_t flow_cache_epoch = 1;
+
+/** Flow cache of each worker lcore, allocated on first use */
+static struct flow_cache *flow_cache_tbl[RTE_MAX_LCORE];
+
+void
+flow_cache_invalidate(void)
+{
+	/* Writers run on the iface core and the ACL build thread. The
+	 * atomic add is a full barrier, so the table update is visible
+	 * before the new epoch. */
+	if (__sync_add_and_fetch(&flow_cache_epoch, 1) == 0) {
+		/* 0 marks unused entries */
+		__sync_add_and_fetch(&flow_cache_epoch, 1);
+	}
+}
+
+/**
+ * Get flow cache of calling lcore.
+ */
+static struct flow_cache *
+flow_cache_get(void)
+{
+	unsigned lcore_id = rte_lcore_id();
+	struct flow_cache *fc = flow_cache_tbl[lcore_id];
+
+	if (likely(fc != NULL))
+		return fc;
+
+	fc = rte_zmalloc_socket("flow_cache", sizeof(struct flow_cache),
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (fc == NULL) {
+		RTE_LOG(ERR, DP, "lcore %u: Failed to allocate flow cache\n",
+				lcore_id);
+		return NULL;
+	}
+	flow_cache_tbl[lcore_id] = fc;
+	return fc;
+}
+
+/**
+ * Build flow cache key of pkt. Only unfragmented TCP and UDP pkts are
+ * cached, the filters look at the L4 ports of all other pkts as well.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if pkt is not cacheable
+ */
+static inline int
+flow_cache_key_get(struct rte_mbuf *m, uint8_t dir,
+		struct flow_cache_key *key)
+{
+	struct ipv4_hdr *ip = get_mtoip(m);
+	struct udp_hdr *l4;
+	struct epc_meta_data *meta_data;
+
+#ifdef UE_IPV6
+	/* the key holds IPv4 addresses only */
+	if (ip_hdr_is_ipv6(ip))
+		return -1;
+#endif /* UE_IPV6 */
+	if ((ip->next_proto_id != IPPROTO_TCP)
+			&& (ip->next_proto_id != IPPROTO_UDP))
+		return -1;
+	if (rte_ipv4_frag_pkt_is_fragmented(ip))
+		return -1;
+
+	/* TCP and UDP ports are at the same offset */
+	l4 = (struct udp_hdr *)((uint8_t *)ip +
+			((ip->version_ihl & IPV4_HDR_IHL_MASK) *
+			 IPV4_IHL_MULTIPLIER));
+
+	key->src_ip = ip->src_addr;
+	key->dst_ip = ip->dst_addr;
+	key->src_port = l4->src_port;
+	key->dst_port = l4->dst_port;
+	key->proto = ip->next_proto_id;
+	key->dir = dir;
+	key->pad = 0;
+	key->bearer = 0;
+	if (dir == UL_FLOW) {
+		meta_data = (struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(
+				m, META_DATA_OFFSET);
+		key->bearer = meta_data->teid;
+	}
+	return 0;
+}
+
+uint64_t
+flow_cache_lookup(struct flow_cache_burst *b, struct rte_mbuf **pkts,
+		uint32_t n, uint8_t dir, uint32_t *adc_rid,
+		struct pcc_id_precedence *sdf_pcc,
+		struct pcc_id_precedence *adc_pcc)
+{
+	struct flow_cache_entry *e;
+	uint64_t hit_mask = 0;
+	uint32_t i, hits = 0;
+
+	b->cacheable = 0;
+	b->fc = flow_cache_get();
+	if (unlikely(b->fc == NULL))
+		return 0;
+
+	b->epoch = flow_cache_epoch;
+	/* verdicts computed after this point are from this epoch on */
+	rte_smp_rmb();
+
+	for (i = 0; i < n; i++) {
+		if (flow_cache_key_get(pkts[i], dir, &b->key[i]) < 0)
+			continue;
+
+		SET_BIT(b->cacheable, i);
+		b->slot[i] = rte_hash_crc(&b->key[i], sizeof(b->key[i]), 0)
+				& (FLOW_CACHE_SIZE - 1);
+		e = &b->fc->ent[b->slot[i]];
+		rte_prefetch0(e);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (!ISSET_BIT(b->cacheable, i))
+			continue;
+
+		e = &b->fc->ent[b->slot[i]];
+		if ((e->epoch != b->epoch) ||
+				memcmp(&e->key, &b->key[i], sizeof(e->key)))
+			continue;
+
+		adc_rid[i] = e->adc_rid;
+		sdf_pcc[i] = e->sdf_pcc;
+		adc_pcc[i] = e->adc_pcc;
+		SET_BIT(hit_mask, i);
+		hits++;
+	}
+
+	b->fc->hits += hits;
+	b->fc->misses += n - hits;
+	return hit_mask;
+}
+#endif /* FLOW_CACHE */
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FLOW_CACHE_H_
+#define _FLOW_CACHE_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the per worker flow cache.
+ *
+ * The flow cache keeps the SDF/ADC classification verdict of a flow,
+ * keyed on its 5-tuple, direction and bearer, so that packets of long
+ * lived flows skip the ACL, ADC domain and PCC lookups. All entries are
+ * invalidated at once by an epoch bump whenever a filter, PCC or ADC
+ * domain table changes.
+ */
+#ifdef FLOW_CACHE
+#include <stdint.h>
+#include <rte_mbuf.h>
+
+#include "main.h"
+
+/** Entries of each worker flow cache, power of 2 */
+#define FLOW_CACHE_SIZE		(1 << 12)
+
+/**
+ * Flow cache key.
+ */
+struct flow_cache_key {
+	uint32_t src_ip;	/** source IP, network order */
+	uint32_t dst_ip;	/** destination IP, network order */
+	uint16_t src_port;	/** source port, network order */
+	uint16_t dst_port;	/** destination port, network order */
+	uint32_t bearer;	/** uplink teid, 0 for downlink */
+	uint8_t proto;		/** IP protocol */
+	uint8_t dir;		/** UL_FLOW or DL_FLOW */
+	uint16_t pad;
+} __attribute__((packed));
+
+/**
+ * Flow cache entry.
+ */
+struct flow_cache_entry {
+	struct flow_cache_key key;
+	uint32_t epoch;			/** epoch of verdict, 0 if unused */
+	uint32_t adc_rid;		/** ADC rule id */
+	struct pcc_id_precedence sdf_pcc;	/** PCC of SDF rule */
+	struct pcc_id_precedence adc_pcc;	/** PCC of ADC rule */
+} __rte_cache_aligned;
+
+/**
+ * Per worker flow cache.
+ */
+struct flow_cache {
+	uint64_t hits;
+	uint64_t misses;
+	struct flow_cache_entry ent[FLOW_CACHE_SIZE];
+};
+
+/**
+ * Flow cache state of a burst, filled by flow_cache_lookup().
+ */
+struct flow_cache_burst {
+	struct flow_cache *fc;
+	uint32_t epoch;		/** epoch at start of burst */
+	uint64_t cacheable;	/** pkts with a flow cache key */
+	struct flow_cache_key key[MAX_BURST_SZ];
+	uint32_t slot[MAX_BURST_SZ];
+};
+
+/** Current flow cache epoch */
+extern volatile uint32_t flow_cache_epoch;
+
+/**
+ * Invalidate every worker flow cache. Called by the table writers
+ * after a change is visible to the workers.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void flow_cache_invalidate(void);
+
+/**
+ * Look up the verdicts of a burst in the flow cache of calling lcore.
+ *
+ * @param b
+ *	burst state, passed on to flow_cache_insert().
+ * @param pkts
+ *	pkts, with ether header at offset 0.
+ * @param n
+ *	number of pkts.
+ * @param dir
+ *	UL_FLOW or DL_FLOW.
+ * @param adc_rid
+ *	ADC rule id of hit pkts.
+ * @param sdf_pcc
+ *	SDF PCC of hit pkts.
+ * @param adc_pcc
+ *	ADC PCC of hit pkts.
+ *
+ * @return
+ *	mask of pkts found in the cache.
+ */
+uint64_t
+flow_cache_lookup(struct flow_cache_burst *b, struct rte_mbuf **pkts,
+		uint32_t n, uint8_t dir, uint32_t *adc_rid,
+		struct pcc_id_precedence *sdf_pcc,
+		struct pcc_id_precedence *adc_pcc);
+
+/**
+ * Store the verdict of a pkt missed by flow_cache_lookup().
+ *
+ * @param b
+ *	burst state.
+ * @param i
+ *	index of pkt in the burst.
+ * @param adc_rid
+ *	ADC rule id.
+ * @param sdf_pcc
+ *	SDF PCC.
+ * @param adc_pcc
+ *	ADC PCC.
+ *
+ * @return
+ *	None
+ */
+static inline void
+flow_cache_insert(struct flow_cache_burst *b, uint32_t i, uint32_t adc_rid,
+		const struct pcc_id_precedence *sdf_pcc,
+		const struct pcc_id_precedence *adc_pcc)
+{
+	struct flow_cache_entry *e;
+
+	if (!ISSET_BIT(b->cacheable, i))
+		return;
+
+	e = &b->fc->ent[b->slot[i]];
+	e->key = b->key[i];
+	e->adc_rid = adc_rid;
+	e->sdf_pcc = *sdf_pcc;
+	e->adc_pcc = *adc_pcc;
+	e->epoch = b->epoch;
+}
+#endif /* FLOW_CACHE */
+#endif /* _FLOW_CACHE_H_ */
@@ -14,10 +14,16 @@
  * limitations under the License.
  */
 
+#include <string.h>
 #include <arpa/inet.h>
 #include <rte_ip.h>
+#include <rte_memcpy.h>
+#ifdef RTE_MACHINE_CPUFLAG_SSE2
+#include <emmintrin.h>
+#endif
 #include "main.h"
 #include "gtpu.h"
+#include "trace.h"
 
 /**
  * Function to construct gtpu header.
@@ -79,9 +85,8 @@ int decap_gtpu_hdr(struct rte_mbuf *m)
 		return -1;
 	}
 
-	RTE_LOG(DEBUG, DP,
-			"Decap: modified mbuf offset %d, data_len %d, pkt_len%d\n",
-			m->data_off, m->data_len, m->pkt_len);
+	TRACE_POINT(DP_TRACE_GTPU, TP_GTPU_DECAP_LEN, m->data_off, m->data_len,
+			m->pkt_len);
 	return 0;
 }
 
@@ -90,7 +95,7 @@ int encap_gtpu_hdr(struct rte_mbuf *m, uint32_t teid)
 	uint8_t *pkt_ptr;
 	uint16_t tpdu_len;
 
-	tpdu_len = rte_pktmbuf_data_len(m);
+	tpdu_len = rte_pktmbuf_pkt_len(m);
 	tpdu_len -= ETH_HDR_SIZE;
 	/* Prepend GPDU hdr = 8 Bytes, IPv4 hdr= 20 Bytes,
 	 * UDP = 8 Bytes to mbuf data in headroom.
@@ -103,23 +108,169 @@ int encap_gtpu_hdr(struct rte_mbuf *m, uint32_t teid)
 		RTE_LOG(ERR, DP, "Error: Failed to add GTPU header\n");
 		return -1;
 	}
-	RTE_LOG(DEBUG, DP,
-			"Encap: modified mbuf offset %d, data_len %d, pkt_len %d\n",
-			m->data_off, m->data_len, m->pkt_len);
+	TRACE_POINT(DP_TRACE_GTPU, TP_GTPU_ENCAP_LEN, m->data_off, m->data_len,
+			m->pkt_len);
 
 	construct_gtpu_hdr(m, teid, tpdu_len);
 
 	return 0;
 }
 
+/* UDP dst port 2152 and GTP_GPDU message type packed as checked */
+#define GTPU_PORT_TYPE(port, type)	(((uint32_t)(type) << 16) | (port))
+
+/**
+ * Function to read the fields checked by gtpu_check_burst().
+ */
+static inline void
+gtpu_check_fields(struct rte_mbuf *m, uint32_t *ip, uint32_t *port_type,
+		uint32_t *teid)
+{
+	struct ipv4_hdr *ipv4_hdr = get_mtoip(m);
+	struct udp_hdr *udp_hdr = (struct udp_hdr *)(ipv4_hdr + 1);
+	struct gtpu_hdr *gtpu_hdr = (struct gtpu_hdr *)(udp_hdr + 1);
+
+	*ip = ipv4_hdr->dst_addr;
+	*port_type = GTPU_PORT_TYPE(udp_hdr->dst_port, gtpu_hdr->msgtype);
+	*teid = gtpu_hdr->teid;
+}
+
+uint64_t gtpu_check_burst(struct rte_mbuf **pkts, uint32_t n,
+		uint32_t dst_ip)
+{
+	const uint32_t port_type =
+		GTPU_PORT_TYPE(htons(UDP_PORT_GTPU), GTP_GPDU);
+	uint64_t mask = 0;
+	uint32_t i = 0;
+
+#ifdef RTE_MACHINE_CPUFLAG_SSE2
+	const __m128i v_ip = _mm_set1_epi32(dst_ip);
+	const __m128i v_pt = _mm_set1_epi32(port_type);
+	const __m128i v_zero = _mm_setzero_si128();
+
+	for (; i + 4 <= n; i += 4) {
+		uint32_t ip[4], pt[4], teid[4];
+		__m128i ok;
+
+		gtpu_check_fields(pkts[i], &ip[0], &pt[0], &teid[0]);
+		gtpu_check_fields(pkts[i + 1], &ip[1], &pt[1], &teid[1]);
+		gtpu_check_fields(pkts[i + 2], &ip[2], &pt[2], &teid[2]);
+		gtpu_check_fields(pkts[i + 3], &ip[3], &pt[3], &teid[3]);
+
+		ok = _mm_and_si128(
+			_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)ip), v_ip),
+			_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)pt), v_pt));
+		ok = _mm_andnot_si128(
+			_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)teid),
+				v_zero), ok);
+
+		mask |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(ok)) << i;
+	}
+#endif	/* RTE_MACHINE_CPUFLAG_SSE2 */
+
+	for (; i < n; i++) {
+		uint32_t ip, pt, teid;
+
+		gtpu_check_fields(pkts[i], &ip, &pt, &teid);
+		mask |= (uint64_t)((ip == dst_ip) & (pt == port_type) &
+				(teid != 0)) << i;
+	}
+
+	return mask;
+}
+
+void gtpu_encap_tmpl_build(struct dl_encap_tmpl *t, uint32_t src_ip,
+		uint32_t dst_ip, uint32_t teid)
+{
+	struct dl_encap_tmpl new;
+	struct ipv4_hdr *ip = (struct ipv4_hdr *)new.hdr;
+	struct udp_hdr *udp = (struct udp_hdr *)(ip + 1);
+	struct gtpu_hdr *gtpu = (struct gtpu_hdr *)(udp + 1);
+
+	RTE_BUILD_BUG_ON(GTPU_ENCAP_HDR_SIZE > DL_ENCAP_HDR_MAX);
+
+	memset(&new, 0, sizeof(new));
+
+	/* same defaults as build_ipv4_default_hdr(), length left to 0 */
+	ip->version_ihl = 0x45;
+	ip->packet_id = 0x1513;
+	ip->time_to_live = 64;
+	ip->next_proto_id = IP_PROTO_UDP;
+	ip->src_addr = src_ip;
+	ip->dst_addr = htonl(dst_ip);
+
+	udp->src_port = htons(UDP_PORT_GTPU);
+	udp->dst_port = htons(UDP_PORT_GTPU);
+
+	gtpu->version = GTPU_VERSION;
+	gtpu->pt = GTP_PROTOCOL_TYPE_GTP;
+#ifdef GTPU_HDR_SEQNB
+	gtpu->seq = GTPU_SEQPRESENT;
+#endif  /* GTPU_HDR_SEQNB */
+	gtpu->msgtype = GTP_GPDU;
+	gtpu->teid = htonl(teid);
+
+	new.ip_sum = rte_raw_cksum(ip, IPv4_HDR_SIZE);
+	new.teid = teid;
+
+	*t = new;
+}
+
+int encap_gtpu_tmpl(struct rte_mbuf *m, const struct dl_encap_tmpl *t,
+		uint8_t port)
+{
+	uint8_t *pkt_ptr;
+	struct ipv4_hdr *ip;
+	struct udp_hdr *udp;
+	struct gtpu_hdr *gtpu;
+	uint16_t tpdu_len;
+	uint16_t ip_len;
+	uint64_t ol_flags = epc_app.tx_cksum_ol[port];
+
+	tpdu_len = rte_pktmbuf_pkt_len(m) - ETH_HDR_SIZE;
+	ip_len = tpdu_len + GTPU_ENCAP_HDR_SIZE;
+
+	pkt_ptr = (uint8_t *)rte_pktmbuf_prepend(m, GTPU_ENCAP_HDR_SIZE);
+	if (pkt_ptr == NULL) {
+		RTE_LOG(ERR, DP, "Error: Failed to add GTPU header\n");
+		return -1;
+	}
+
+	ip = (struct ipv4_hdr *)(pkt_ptr + ETH_HDR_SIZE);
+	rte_memcpy(ip, t->hdr, GTPU_ENCAP_HDR_SIZE);
+	udp = (struct udp_hdr *)(ip + 1);
+	gtpu = (struct gtpu_hdr *)(udp + 1);
+
+	ip->total_length = htons(ip_len);
+	udp->dgram_len = htons(ip_len - IPv4_HDR_SIZE);
+#ifdef GTPU_HDR_SEQNB
+	gtpu->msglen = htons(tpdu_len + sizeof(GTPU_STATIC_SEQNB));
+	gtpu->seqnb = GTPU_STATIC_SEQNB | htons(gtpu_seqnb);
+	gtpu_seqnb++;
+#else
+	gtpu->msglen = htons(tpdu_len);
+#endif  /* GTPU_HDR_SEQNB */
+
+	if (likely(ol_flags)) {
+		m->l2_len = ETH_HDR_SIZE;
+		m->l3_len = IPv4_HDR_SIZE;
+		m->ol_flags |= ol_flags;
+	} else {
+		uint32_t sum = t->ip_sum + ip->total_length;
+
+		sum = (sum & 0xffff) + (sum >> 16);
+		ip->hdr_checksum = (sum == 0xffff) ? sum : (uint16_t)~sum;
+	}
+
+	return 0;
+}
+
 uint32_t gtpu_inner_src_ip(struct rte_mbuf *m)
 {
 	uint8_t *pkt_ptr;
 	struct ipv4_hdr *inner_ipv4_hdr;
 
 	pkt_ptr = (uint8_t *) get_mtogtpu(m);
-	RTE_LOG(DEBUG, DP, "ASR-SpirentvLS gtpu.c: GPDU_HDR_SIZE %u\n",
-			GPDU_HDR_SIZE);
 
 	pkt_ptr += GPDU_HDR_SIZE;
 	inner_ipv4_hdr = (struct ipv4_hdr *)pkt_ptr;
@@ -96,6 +96,65 @@ int decap_gtpu_hdr(struct rte_mbuf *m);
  */
 int encap_gtpu_hdr(struct rte_mbuf *m, uint32_t teid);
 
+/**
+ * Function to validate the outer headers of a burst of tunneled packets:
+ * outer dst ip, UDP port 2152, GTP_GPDU message type and non zero teid.
+ * Packets are checked four at a time with SSE where available.
+ *
+ * @param pkts
+ *	mbufs of the burst.
+ * @param n
+ *	number of pkts.
+ * @param dst_ip
+ *	expected outer dst ip, network order.
+ *
+ * @return
+ *	bit mask of the valid packets
+ */
+uint64_t gtpu_check_burst(struct rte_mbuf **pkts, uint32_t n,
+		uint32_t dst_ip);
+
+/**
+ * Size of the outer headers prepended by encap.
+ */
+#define GTPU_ENCAP_HDR_SIZE	(IPv4_HDR_SIZE + UDP_HDR_SIZE + GPDU_HDR_SIZE)
+
+/**
+ * Function to build the downlink encap header template of a session.
+ *
+ * @param t
+ *	template to build.
+ * @param src_ip
+ *	outer source ip, network order.
+ * @param dst_ip
+ *	outer destination ip, host order.
+ * @param teid
+ *	tunnel endpoint id, 0 when the tunnel is not established.
+ *
+ * @return
+ *	None
+ */
+void gtpu_encap_tmpl_build(struct dl_encap_tmpl *t, uint32_t src_ip,
+		uint32_t dst_ip, uint32_t teid);
+
+/**
+ * Function for encapsulation of gtpu headers from a session template.
+ * Only the lengths and the IPv4 checksum are computed per packet, the
+ * checksum is offloaded when the port supports it.
+ *
+ * @param m
+ *	mbuf pointer
+ * @param t
+ *	encap header template.
+ * @param port
+ *	port the packet is sent on.
+ * @return
+ *	- 0 on success
+ *	- -1 on failure
+ */
+int encap_gtpu_tmpl(struct rte_mbuf *m, const struct dl_encap_tmpl *t,
+		uint8_t port);
+
 /**
  * Function to get inner dst ip of tunneled packet.
  *
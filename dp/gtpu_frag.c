@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef GTPU_FRAG
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_malloc.h>
+
+#include "main.h"
+#include "gtpu_frag.h"
+
+/**
+ * Reassembly state of an lcore.
+ */
+struct gtpu_frag_ctx {
+	struct rte_ip_frag_tbl *tbl;
+	struct rte_ip_frag_death_row dr;
+	uint16_t packet_id;	/**< id of the next fragmented pkt */
+	uint16_t packet_id_step;	/**< lcores sharing the ids */
+} __rte_cache_aligned;
+
+struct gtpu_frag_stats gtpu_frag_stats[RTE_MAX_LCORE];
+
+static struct gtpu_frag_ctx *gtpu_frag_ctx[RTE_MAX_LCORE];
+static struct rte_mempool *frag_pool_direct;
+static struct rte_mempool *frag_pool_indirect;
+
+void
+gtpu_frag_init(void)
+{
+	uint64_t ttl = rte_get_tsc_hz() / 1000 * GTPU_FRAG_TTL_MS;
+	struct gtpu_frag_ctx *ctx;
+	unsigned lcore;
+	uint16_t idx = 0;
+
+	if (app.gtpu_mtu == 0)
+		app.gtpu_mtu = ETHER_MTU;
+
+	RTE_LCORE_FOREACH(lcore) {
+		int socket = dp_lcore_socket(lcore);
+
+		ctx = rte_zmalloc_socket("gtpu_frag_ctx", sizeof(*ctx),
+				RTE_CACHE_LINE_SIZE, socket);
+		if (ctx == NULL)
+			rte_exit(EXIT_FAILURE, "Cannot allocate fragment "
+					"context of lcore %u\n", lcore);
+
+		ctx->tbl = rte_ip_frag_table_create(GTPU_FRAG_TBL_BUCKETS,
+				GTPU_FRAG_TBL_ENTRIES,
+				GTPU_FRAG_TBL_BUCKETS * GTPU_FRAG_TBL_ENTRIES,
+				ttl, socket);
+		if (ctx->tbl == NULL)
+			rte_exit(EXIT_FAILURE, "Cannot create fragment table "
+					"of lcore %u\n", lcore);
+		/* the lcores take every rte_lcore_count()th id, apart
+		 * until the ids wrap */
+		ctx->packet_id = idx++;
+		ctx->packet_id_step = rte_lcore_count();
+		gtpu_frag_ctx[lcore] = ctx;
+	}
+
+	frag_pool_direct = rte_pktmbuf_pool_create("GTPU_FRAG_DIRECT",
+			GTPU_FRAG_NUM_MBUFS, 250, 0,
+			RTE_PKTMBUF_HEADROOM + sizeof(struct ipv4_hdr),
+			rte_socket_id());
+	frag_pool_indirect = rte_pktmbuf_pool_create("GTPU_FRAG_INDIRECT",
+			GTPU_FRAG_NUM_MBUFS, 250, 0, 0, rte_socket_id());
+	if (frag_pool_direct == NULL || frag_pool_indirect == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot create fragment mempools\n");
+
+	RTE_LOG(INFO, DP, "GTPU fragmentation at MTU %u\n", app.gtpu_mtu);
+}
+
+uint64_t
+gtpu_reassemble(struct rte_mbuf **pkts, uint32_t n)
+{
+	struct gtpu_frag_ctx *ctx = gtpu_frag_ctx[rte_lcore_id()];
+	struct gtpu_frag_stats *st = &gtpu_frag_stats[rte_lcore_id()];
+	struct ether_hdr *eth;
+	struct ipv4_hdr *ip;
+	struct rte_mbuf *m;
+	uint64_t held = 0;
+	uint64_t tsc = 0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		eth = rte_pktmbuf_mtod(pkts[i], struct ether_hdr *);
+		ip = (struct ipv4_hdr *)(eth + 1);
+		if (likely(eth->ether_type != htons(ETHER_TYPE_IPv4) ||
+				!rte_ipv4_frag_pkt_is_fragmented(ip)))
+			continue;
+
+		if (tsc == 0)
+			tsc = rte_rdtsc();
+		st->reasm_in++;
+		pkts[i]->l2_len = ETHER_HDR_LEN;
+		pkts[i]->l3_len = (ip->version_ihl & IPV4_HDR_IHL_MASK) *
+				IPV4_IHL_MULTIPLIER;
+
+		m = rte_ipv4_frag_reassemble_packet(ctx->tbl, &ctx->dr,
+				pkts[i], tsc, ip);
+		if (m == NULL) {
+			/* held in the table or freed on the death row */
+			SET_BIT(held, i);
+			continue;
+		}
+		pkts[i] = m;
+		st->reasm_out++;
+	}
+
+	if (unlikely(ctx->dr.cnt))
+		rte_ip_frag_free_death_row(&ctx->dr, 3);
+	return held;
+}
+
+/**
+ * Fragment a pkt and send the fragments on port. The pkt is freed, the
+ * fragments keep references to its data.
+ *
+ * @return
+ *	number of fragments sent, 0 if the pkt is dropped
+ */
+static uint32_t
+gtpu_fragment_pkt(struct rte_pipeline *p, struct gtpu_frag_ctx *ctx,
+		struct rte_mbuf *m, uint32_t port)
+{
+	struct rte_mbuf *frags[GTPU_FRAG_MAX_FRAGS];
+	uint64_t ol_flags = epc_app.tx_cksum_ol[port];
+	struct ether_hdr eth, *feth;
+	struct ipv4_hdr *ip, *fip;
+	int32_t nb, j;
+	uint32_t sent = 0;
+
+	eth = *rte_pktmbuf_mtod(m, struct ether_hdr *);
+	ip = rte_pktmbuf_mtod_offset(m, struct ipv4_hdr *, ETHER_HDR_LEN);
+	if (eth.ether_type != htons(ETHER_TYPE_IPv4) ||
+			(ip->fragment_offset & htons(IPV4_HDR_DF_FLAG))) {
+		rte_pktmbuf_free(m);
+		return 0;
+	}
+
+	/* the encap templates share one id */
+	ip->packet_id = htons(ctx->packet_id);
+	ctx->packet_id += ctx->packet_id_step;
+
+	rte_pktmbuf_adj(m, ETHER_HDR_LEN);
+	nb = rte_ipv4_fragment_packet(m, frags, GTPU_FRAG_MAX_FRAGS,
+			app.gtpu_mtu, frag_pool_direct, frag_pool_indirect);
+	if (nb < 0) {
+		rte_pktmbuf_free(m);
+		return 0;
+	}
+
+	for (j = 0; j < nb; j++) {
+		feth = (struct ether_hdr *)rte_pktmbuf_prepend(frags[j],
+				ETHER_HDR_LEN);
+		if (unlikely(feth == NULL)) {
+			rte_pktmbuf_free(frags[j]);
+			continue;
+		}
+		*feth = eth;
+
+		fip = (struct ipv4_hdr *)(feth + 1);
+		fip->hdr_checksum = 0;
+		if (likely(ol_flags)) {
+			frags[j]->l2_len = ETHER_HDR_LEN;
+			frags[j]->l3_len = sizeof(struct ipv4_hdr);
+			frags[j]->ol_flags |= ol_flags;
+		} else {
+			fip->hdr_checksum = rte_ipv4_cksum(fip);
+		}
+
+		rte_pipeline_port_out_packet_insert(p, port, frags[j]);
+		sent++;
+	}
+	/* rte_ipv4_fragment_packet() does not consume its input */
+	rte_pktmbuf_free(m);
+	return sent;
+}
+
+void
+gtpu_fragment(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
+		uint64_t *pkts_mask, uint32_t port)
+{
+	struct gtpu_frag_stats *st = &gtpu_frag_stats[rte_lcore_id()];
+	uint32_t max_len = app.gtpu_mtu + ETHER_HDR_LEN;
+	uint32_t i, sent;
+	uint64_t frag_mask = 0;
+
+	for (i = 0; i < n; i++) {
+		if (likely(!ISSET_BIT(*pkts_mask, i) ||
+				rte_pktmbuf_pkt_len(pkts[i]) <= max_len))
+			continue;
+
+		st->frag_in++;
+		sent = gtpu_fragment_pkt(p, gtpu_frag_ctx[rte_lcore_id()],
+				pkts[i], port);
+		if (sent)
+			st->frag_out += sent;
+		else
+			st->frag_fail++;
+		/* freed by gtpu_fragment_pkt(), the fragments replace it */
+		RESET_BIT(*pkts_mask, i);
+		SET_BIT(frag_mask, i);
+	}
+	/* taken out of the pipeline so that its drop does not free them */
+	if (frag_mask)
+		rte_pipeline_ah_packet_hijack(p, frag_mask);
+}
+#endif	/* GTPU_FRAG */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _GTPU_FRAG_H_
+#define _GTPU_FRAG_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the IPv4 reassembly and fragmentation of GTPU pkts.
+ *
+ * With GTPU_FRAG the lcores reading the GTPU ports reassemble the
+ * fragmented outer IPv4 pkts before they are classified, so that all
+ * fragments reach the worker of the bearer as one pkt. Workers fragment the pkts
+ * exceeding --gtpu_mtu once their next hop is set, the encap adds 36
+ * bytes to full size downlink pkts. The fragment tables and mbuf pools
+ * are allocated at start up, pkts that are not fragmented or fit the
+ * MTU cost a header check.
+ */
+#ifdef GTPU_FRAG
+#include <stdint.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_pipeline.h>
+
+/** Buckets of the fragment table of each lcore */
+#define GTPU_FRAG_TBL_BUCKETS	1024
+/** Entries of each bucket */
+#define GTPU_FRAG_TBL_ENTRIES	4
+/** Reassembly timeout in ms, incomplete pkts are freed after it */
+#define GTPU_FRAG_TTL_MS	100
+/** Largest number of fragments of a pkt */
+#define GTPU_FRAG_MAX_FRAGS	RTE_LIBRTE_IP_FRAG_MAX_FRAG
+/** mbufs of the fragment headers */
+#define GTPU_FRAG_NUM_MBUFS	8191
+
+/**
+ * Fragmentation statistics.
+ */
+struct gtpu_frag_stats {
+	uint64_t reasm_in;	/**< fragments received */
+	uint64_t reasm_out;	/**< pkts reassembled */
+	uint64_t frag_in;	/**< pkts exceeding the MTU */
+	uint64_t frag_out;	/**< fragments sent */
+	uint64_t frag_fail;	/**< pkts dropped, DF set or no mbuf */
+};
+
+/** Statistics of each lcore */
+extern struct gtpu_frag_stats gtpu_frag_stats[RTE_MAX_LCORE];
+
+/**
+ * Create the fragment tables of the enabled lcores and the mbuf pools
+ * of the fragments. Called before the pipelines are created.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+gtpu_frag_init(void);
+
+/**
+ * Reassemble the fragments of a burst read from a GTPU port. The
+ * reassembled pkt takes the place of its last fragment in pkts, the
+ * other fragments are held in the fragment table until their pkt is
+ * complete. The caller removes the held fragments from the burst.
+ *
+ * @param pkts
+ *	pkts of the burst.
+ * @param n
+ *	number of pkts.
+ *
+ * @return
+ *	bit mask of the held fragments
+ */
+uint64_t
+gtpu_reassemble(struct rte_mbuf **pkts, uint32_t n);
+
+/**
+ * Fragment the pkts of pkts_mask exceeding --gtpu_mtu. The fragments are
+ * sent on the output port, the pkts are cleared from pkts_mask.
+ *
+ * @param p
+ *	worker pipeline.
+ * @param pkts
+ *	pkts with their next hop L2 header set.
+ * @param n
+ *	number of pkts.
+ * @param pkts_mask
+ *	bit mask of the pkts to send.
+ * @param port
+ *	output port.
+ *
+ * @return
+ *	None
+ */
+void
+gtpu_fragment(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
+		uint64_t *pkts_mask, uint32_t port);
+#endif	/* GTPU_FRAG */
+#endif	/* _GTPU_FRAG_H_ */
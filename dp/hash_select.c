@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HASH_SELECT
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_random.h>
+#include <rte_jhash.h>
+#include <rte_hash_crc.h>
+
+#include "main.h"
+#include "hash_select.h"
+
+enum hash_kind {
+	HASH_KIND_AUTO,
+	HASH_KIND_JHASH,
+	HASH_KIND_CRC,
+	HASH_KIND_MAX
+};
+
+static const char *hash_kind_name[HASH_KIND_MAX] = {
+	[HASH_KIND_AUTO] = "auto",
+	[HASH_KIND_JHASH] = "jhash",
+	[HASH_KIND_CRC] = "crc",
+};
+
+/** Key widths benchmarked, any other width uses the generic forms */
+enum hash_width {
+	HASH_WIDTH_4,
+	HASH_WIDTH_8,
+	HASH_WIDTH_ANY,
+	HASH_WIDTH_MAX
+};
+
+/** Key length the generic forms are benchmarked with */
+#define HASH_BENCH_ANY_LEN	16
+
+static uint32_t
+jhash_4byte(const void *key, uint32_t key_len, uint32_t init_val)
+{
+	RTE_SET_USED(key_len);
+	return rte_jhash_1word(*(const uint32_t *)key, init_val);
+}
+
+static uint32_t
+jhash_8byte(const void *key, uint32_t key_len, uint32_t init_val)
+{
+	const uint32_t *k = key;
+
+	RTE_SET_USED(key_len);
+	return rte_jhash_2words(k[0], k[1], init_val);
+}
+
+static uint32_t
+crc_4byte(const void *key, uint32_t key_len, uint32_t init_val)
+{
+	RTE_SET_USED(key_len);
+	return rte_hash_crc_4byte(*(const uint32_t *)key, init_val);
+}
+
+static uint32_t
+crc_8byte(const void *key, uint32_t key_len, uint32_t init_val)
+{
+	RTE_SET_USED(key_len);
+	return rte_hash_crc_8byte(*(const uint64_t *)key, init_val);
+}
+
+/** Hash function of each kind and key width */
+static const rte_hash_function hash_funcs[HASH_KIND_MAX][HASH_WIDTH_MAX] = {
+	[HASH_KIND_JHASH] = { jhash_4byte, jhash_8byte, rte_jhash },
+	[HASH_KIND_CRC] = { crc_4byte, crc_8byte, rte_hash_crc },
+};
+
+static const uint32_t hash_width_len[HASH_WIDTH_MAX] = {
+	4, 8, HASH_BENCH_ANY_LEN
+};
+
+/** Kind picked by the benchmark per key width */
+static enum hash_kind hash_auto[HASH_WIDTH_MAX] = {
+	HASH_KIND_JHASH, HASH_KIND_JHASH, HASH_KIND_JHASH
+};
+
+/** Parsed --hash_func */
+static enum hash_kind hash_default = HASH_KIND_AUTO;
+static struct {
+	char table[RTE_HASH_NAMESIZE];
+	enum hash_kind kind;
+} rules[HASH_SELECT_MAX_RULES];
+static uint32_t nb_rules;
+
+static int
+hash_kind_parse(const char *s, size_t len, enum hash_kind *kind)
+{
+	int k;
+
+	for (k = 0; k < HASH_KIND_MAX; k++) {
+		if ((strlen(hash_kind_name[k]) == len)
+				&& !strncmp(s, hash_kind_name[k], len)) {
+			*kind = k;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int
+hash_select_parse(const char *arg)
+{
+	const char *s = arg;
+	const char *end, *eq;
+	size_t len;
+
+	end = strchr(s, ',');
+	len = end ? (size_t)(end - s) : strlen(s);
+	if (hash_kind_parse(s, len, &hash_default) < 0)
+		goto err;
+
+	while (end != NULL) {
+		s = end + 1;
+		end = strchr(s, ',');
+		len = end ? (size_t)(end - s) : strlen(s);
+		eq = memchr(s, '=', len);
+		if ((eq == NULL) || (eq == s)
+				|| ((size_t)(eq - s) >= RTE_HASH_NAMESIZE)
+				|| (nb_rules == HASH_SELECT_MAX_RULES))
+			goto err;
+		if (hash_kind_parse(eq + 1, len - (eq + 1 - s),
+					&rules[nb_rules].kind) < 0)
+			goto err;
+		memcpy(rules[nb_rules].table, s, eq - s);
+		rules[nb_rules].table[eq - s] = '\0';
+		nb_rules++;
+	}
+
+	printf("Parsed hash_func:\t%s, %u table rules\n",
+			hash_kind_name[hash_default], nb_rules);
+	return 0;
+
+err:
+	printf("Invalid hash_func %s\n", arg);
+	return -1;
+}
+
+/**
+ * Cycles per key of a hash function.
+ */
+static double
+hash_bench(rte_hash_function fn, const uint8_t *keys, uint32_t key_len)
+{
+	volatile uint32_t sink;
+	uint32_t sum = 0;
+	uint64_t start;
+	uint32_t r, i;
+
+	start = rte_rdtsc();
+	for (r = 0; r < HASH_BENCH_ROUNDS; r++)
+		for (i = 0; i < HASH_BENCH_KEYS; i++)
+			sum += fn(keys + i * HASH_BENCH_ANY_LEN, key_len, 0);
+	sink = sum;
+	RTE_SET_USED(sink);
+
+	return (double)(rte_rdtsc() - start) /
+		(HASH_BENCH_ROUNDS * HASH_BENCH_KEYS);
+}
+
+void
+hash_select_init(void)
+{
+	static uint8_t keys[HASH_BENCH_KEYS * HASH_BENCH_ANY_LEN]
+		__rte_cache_aligned;
+	double cycles[HASH_KIND_MAX];
+	int w, k;
+	uint32_t i;
+
+	for (i = 0; i < RTE_DIM(keys); i += sizeof(uint64_t)) {
+		uint64_t r = rte_rand();
+
+		memcpy(&keys[i], &r, sizeof(r));
+	}
+
+	printf("%-12s %12s %12s %8s\n", "Hash key", "jhash cyc",
+			"crc cyc", "auto");
+	for (w = 0; w < HASH_WIDTH_MAX; w++) {
+		for (k = HASH_KIND_JHASH; k < HASH_KIND_MAX; k++) {
+			/* warm up */
+			hash_bench(hash_funcs[k][w], keys, hash_width_len[w]);
+			cycles[k] = hash_bench(hash_funcs[k][w], keys,
+					hash_width_len[w]);
+		}
+		hash_auto[w] = (cycles[HASH_KIND_CRC] < cycles[HASH_KIND_JHASH])
+			? HASH_KIND_CRC : HASH_KIND_JHASH;
+		printf("%-12s %12.1f %12.1f %8s\n",
+				(w == HASH_WIDTH_ANY) ? "other" :
+				(w == HASH_WIDTH_4) ? "4 bytes" : "8 bytes",
+				cycles[HASH_KIND_JHASH], cycles[HASH_KIND_CRC],
+				hash_kind_name[hash_auto[w]]);
+	}
+}
+
+rte_hash_function
+hash_select_func(const char *name, uint32_t key_len)
+{
+	enum hash_kind kind = hash_default;
+	enum hash_width w;
+	uint32_t i;
+
+	for (i = 0; i < nb_rules; i++) {
+		if (!strncmp(name, rules[i].table, strlen(rules[i].table))) {
+			kind = rules[i].kind;
+			break;
+		}
+	}
+
+	w = (key_len == 4) ? HASH_WIDTH_4 :
+		(key_len == 8) ? HASH_WIDTH_8 : HASH_WIDTH_ANY;
+	if (kind == HASH_KIND_AUTO)
+		kind = hash_auto[w];
+
+	RTE_LOG(INFO, DP, "Hash %s: %u byte keys, %s%s\n", name, key_len,
+			hash_kind_name[kind], (w == HASH_WIDTH_ANY) ? "" :
+			" fixed width");
+	return hash_funcs[kind][w];
+}
+#endif /* HASH_SELECT */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HASH_SELECT_H_
+#define _HASH_SELECT_H_
+/**
+ * @file
+ * This file contains macros and function prototypes of the selection of
+ * the hash functions of the DP tables.
+ *
+ * With HASH_SELECT the tables created by hash_create_socket() hash their
+ * keys with jhash or CRC32C, picked per table at start up with
+ * --hash_func. 4 and 8 byte keys use the fixed width forms of both.
+ * Tables left to auto use the function of their key width found fastest
+ * by a self benchmark run before the tables are created. CRC32C uses the
+ * SSE4.2 or ARMv8 CRC instructions when the CPU has them and is
+ * benchmarked against jhash either way.
+ */
+#ifdef HASH_SELECT
+#include <stdint.h>
+#include <rte_hash.h>
+
+/** Per table rules of --hash_func */
+#define HASH_SELECT_MAX_RULES	16
+/** Keys hashed per benchmark round */
+#define HASH_BENCH_KEYS		1024
+/** Benchmark rounds per function */
+#define HASH_BENCH_ROUNDS	256
+
+/**
+ * Parse --hash_func.
+ *
+ * @param arg
+ *	<func>[,<table>=<func>]..., func one of auto, jhash or crc. Table
+ *	names match as prefix, so that iface_uplink_db covers its shards.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on parse error
+ */
+int
+hash_select_parse(const char *arg);
+
+/**
+ * Benchmark the hash functions of each key width and print the picks.
+ * Called by dp_table_init() before the tables are created.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+hash_select_init(void);
+
+/**
+ * Hash function of a table.
+ *
+ * @param name
+ *	table name.
+ * @param key_len
+ *	key length of the table.
+ *
+ * @return
+ *	hash function to create the table with.
+ */
+rte_hash_function
+hash_select_func(const char *name, uint32_t key_len);
+#endif /* HASH_SELECT */
+#endif /* _HASH_SELECT_H_ */
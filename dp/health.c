@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef HEALTH_MON
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+
+#include "main.h"
+#include "epc_packet_framework.h"
+#include "health.h"
+
+#ifndef STATS
+#error "HEALTH_MON requires STATS"
+#endif
+
+struct health_cfg health_cfg = {
+	.pool_pct = 90,
+	.ring_pct = 90,
+	.drops = 1,
+};
+
+/** Fill level of a pool or ring */
+struct health_level {
+	uint32_t last;		/** percent at last sample */
+	uint32_t peak;		/** peak percent */
+	uint8_t alarm;		/** alarm raised */
+	uint64_t raised;	/** alarms raised */
+};
+
+/** Counter sampled as a delta per interval */
+struct health_rate {
+	uint64_t prev;		/** counter at last sample */
+	uint64_t last;		/** delta at last sample */
+	uint64_t peak;		/** peak delta */
+	uint8_t alarm;		/** alarm raised */
+	uint64_t raised;	/** alarms raised */
+};
+
+struct health_pool {
+	const struct rte_mempool *mp;
+	struct health_level lvl;
+};
+
+struct health_ring {
+	struct health_level lvl;
+	struct health_rate drops;
+};
+
+struct health_port {
+	struct health_rate imissed;
+	struct health_rate rx_nombuf;
+	struct health_rate ierrors;
+	struct health_rate oerrors;
+	/** xstats of the port, sized at health_init() */
+	struct rte_eth_xstat *xs;
+	uint32_t n_xs;
+	/** tracked xstats, index into xs */
+	uint32_t n_tracked;
+	uint32_t xs_idx[HEALTH_MAX_XSTATS];
+	char xs_name[HEALTH_MAX_XSTATS][RTE_ETH_XSTATS_NAME_SIZE];
+	struct health_rate xs_rate[HEALTH_MAX_XSTATS];
+};
+
+static struct health_pool health_pools[HEALTH_MAX_POOLS];
+static uint32_t health_n_pools;
+static struct health_ring health_rings[EPC_RING_STATS_MAX];
+static uint32_t health_n_rings;
+static struct health_port health_ports[NUM_SPGW_PORTS];
+static uint64_t health_interval;
+static uint64_t health_last;
+static uint64_t health_samples;
+
+/** xstats tracked when their name contains one of these */
+static const char *health_xs_match[] = {
+	"miss", "nombuf", "no_mbuf", "drop", "error",
+};
+
+static void
+health_level_update(struct health_level *l, uint32_t pct, uint32_t thresh,
+		const char *kind, const char *name)
+{
+	l->last = pct;
+	if (pct > l->peak)
+		l->peak = pct;
+	if (thresh == 0)
+		return;
+
+	if (!l->alarm && pct >= thresh) {
+		l->alarm = 1;
+		l->raised++;
+		RTE_LOG(WARNING, DP, "HEALTH: %s %s at %u%%, threshold %u%%\n",
+				kind, name, pct, thresh);
+	} else if (l->alarm && pct + HEALTH_HYSTERESIS_PCT < thresh) {
+		l->alarm = 0;
+		RTE_LOG(NOTICE, DP, "HEALTH: %s %s back to %u%%\n",
+				kind, name, pct);
+	}
+}
+
+static void
+health_rate_update(struct health_rate *r, uint64_t val, uint32_t thresh,
+		const char *kind, const char *name)
+{
+	/* NIC stats restart from 0 when cleared by STATS_CLR */
+	uint64_t d = (val >= r->prev) ? val - r->prev : val;
+
+	r->prev = val;
+	r->last = d;
+	if (d > r->peak)
+		r->peak = d;
+	if (thresh == 0)
+		return;
+
+	if (!r->alarm && d >= thresh) {
+		r->alarm = 1;
+		r->raised++;
+		RTE_LOG(WARNING, DP, "HEALTH: %s %s +%"PRIu64" in %u ms\n",
+				kind, name, d, HEALTH_INTERVAL_MS);
+	} else if (r->alarm && d < thresh) {
+		r->alarm = 0;
+		RTE_LOG(NOTICE, DP, "HEALTH: %s %s back to +%"PRIu64"\n",
+				kind, name, d);
+	}
+}
+
+static int
+health_xs_tracked(const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < RTE_DIM(health_xs_match); i++)
+		if (strstr(name, health_xs_match[i]) != NULL)
+			return 1;
+	return 0;
+}
+
+static void
+health_port_init(uint8_t port)
+{
+	struct health_port *hp = &health_ports[port];
+	struct rte_eth_xstat_name *names;
+	struct rte_eth_stats es;
+	int i, n;
+
+	if (rte_eth_stats_get(port, &es) == 0) {
+		hp->imissed.prev = es.imissed;
+		hp->rx_nombuf.prev = es.rx_nombuf;
+		hp->ierrors.prev = es.ierrors;
+		hp->oerrors.prev = es.oerrors;
+	}
+
+	n = rte_eth_xstats_get_names(port, NULL, 0);
+	if (n <= 0)
+		return;
+	names = calloc(n, sizeof(*names));
+	hp->xs = calloc(n, sizeof(*hp->xs));
+	if (names == NULL || hp->xs == NULL)
+		rte_panic("Failed to allocate xstats of port %u\n", port);
+	if (rte_eth_xstats_get_names(port, names, n) != n
+			|| rte_eth_xstats_get(port, hp->xs, n) != n) {
+		RTE_LOG(ERR, DP, "HEALTH: Failed to get xstats of port %u\n",
+				port);
+		free(names);
+		return;
+	}
+	hp->n_xs = n;
+
+	for (i = 0; i < n && hp->n_tracked < HEALTH_MAX_XSTATS; i++) {
+		if (!health_xs_tracked(names[i].name))
+			continue;
+		hp->xs_idx[hp->n_tracked] = i;
+		snprintf(hp->xs_name[hp->n_tracked], RTE_ETH_XSTATS_NAME_SIZE,
+				"%s", names[i].name);
+		hp->xs_rate[hp->n_tracked].prev = hp->xs[i].value;
+		hp->n_tracked++;
+	}
+	free(names);
+	RTE_LOG(INFO, DP, "HEALTH: port %u tracking %u of %d xstats\n",
+			port, hp->n_tracked, n);
+}
+
+void
+health_init(void)
+{
+	uint8_t port;
+
+	for (port = 0; port < epc_app.n_ports; port++)
+		health_port_init(port);
+
+	health_interval = rte_get_tsc_hz() * HEALTH_INTERVAL_MS / 1000;
+	health_last = rte_rdtsc();
+	RTE_LOG(INFO, DP, "HEALTH: pool alarm %u%%, ring alarm %u%%, "
+			"drop alarm %u/interval\n", health_cfg.pool_pct,
+			health_cfg.ring_pct, health_cfg.drops);
+}
+
+static void
+health_pool_sample(struct rte_mempool *mp, void *arg __rte_unused)
+{
+	struct health_pool *p = NULL;
+	uint32_t i, pct;
+
+	for (i = 0; i < health_n_pools; i++) {
+		if (health_pools[i].mp == mp) {
+			p = &health_pools[i];
+			break;
+		}
+	}
+	if (p == NULL) {
+		if (health_n_pools == HEALTH_MAX_POOLS)
+			return;
+		p = &health_pools[health_n_pools++];
+		p->mp = mp;
+	}
+
+	pct = mp->size ? (uint64_t)rte_mempool_in_use_count(mp) * 100
+			/ mp->size : 0;
+	health_level_update(&p->lvl, pct, health_cfg.pool_pct, "pool",
+			mp->name);
+}
+
+static void
+health_ring_sample(void)
+{
+	uint32_t i, n = epc_ring_stats_count;
+
+	/* rings registered since the last sample start from their
+	 * current drops */
+	for (; health_n_rings < n; health_n_rings++)
+		health_rings[health_n_rings].drops.prev =
+			epc_ring_stats[health_n_rings].n_drops;
+
+	for (i = 0; i < n; i++) {
+		const struct epc_ring_stats *s = &epc_ring_stats[i];
+		struct health_ring *hr = &health_rings[i];
+		uint32_t size = s->ring->prod.size;
+
+		health_level_update(&hr->lvl, size ?
+				rte_ring_count(s->ring) * 100 / size : 0,
+				health_cfg.ring_pct, "ring", s->name);
+		health_rate_update(&hr->drops, s->n_drops, health_cfg.drops,
+				"ring drops", s->name);
+	}
+}
+
+static void
+health_port_sample(uint8_t port)
+{
+	struct health_port *hp = &health_ports[port];
+	struct rte_eth_stats es;
+	char name[RTE_ETH_XSTATS_NAME_SIZE + 8];
+	uint32_t i;
+
+	if (rte_eth_stats_get(port, &es) == 0) {
+		snprintf(name, sizeof(name), "%u imissed", port);
+		health_rate_update(&hp->imissed, es.imissed,
+				health_cfg.drops, "port", name);
+		snprintf(name, sizeof(name), "%u rx_nombuf", port);
+		health_rate_update(&hp->rx_nombuf, es.rx_nombuf,
+				health_cfg.drops, "port", name);
+		snprintf(name, sizeof(name), "%u ierrors", port);
+		health_rate_update(&hp->ierrors, es.ierrors,
+				health_cfg.drops, "port", name);
+		snprintf(name, sizeof(name), "%u oerrors", port);
+		health_rate_update(&hp->oerrors, es.oerrors,
+				health_cfg.drops, "port", name);
+	}
+
+	if (hp->n_xs == 0
+			|| rte_eth_xstats_get(port, hp->xs, hp->n_xs)
+			!= (int)hp->n_xs)
+		return;
+	for (i = 0; i < hp->n_tracked; i++) {
+		snprintf(name, sizeof(name), "%u %s", port, hp->xs_name[i]);
+		health_rate_update(&hp->xs_rate[i], hp->xs[hp->xs_idx[i]].value,
+				health_cfg.drops, "port", name);
+	}
+}
+
+void
+health_poll(void)
+{
+	uint64_t now = rte_rdtsc();
+	uint8_t port;
+
+	if (health_interval == 0 || now - health_last < health_interval)
+		return;
+	health_last = now;
+	health_samples++;
+
+	rte_mempool_walk(health_pool_sample, NULL);
+	health_ring_sample();
+	for (port = 0; port < epc_app.n_ports; port++)
+		health_port_sample(port);
+}
+
+static void
+display_rate(const char *name, const struct health_rate *r)
+{
+	printf("  %-32s %12"PRIu64" %12"PRIu64" %8"PRIu64" %s\n", name,
+			r->last, r->peak, r->raised, r->alarm ? "ALARM" : "");
+}
+
+static void
+display_level(const char *name, const struct health_level *l)
+{
+	printf("  %-32s %11u%% %11u%% %8"PRIu64" %s\n", name, l->last,
+			l->peak, l->raised, l->alarm ? "ALARM" : "");
+}
+
+void
+display_health_stats(void)
+{
+	struct health_port *hp;
+	uint32_t i;
+	uint8_t port;
+
+	printf("\n%s %"PRIu64" samples, thresholds pool %u%% ring %u%% "
+			"drops %u\n", "HEALTH", health_samples,
+			health_cfg.pool_pct, health_cfg.ring_pct,
+			health_cfg.drops);
+	printf("  %-32s %12s %12s %8s\n", "metric", "last", "peak", "alarms");
+	for (i = 0; i < health_n_pools; i++)
+		display_level(health_pools[i].mp->name, &health_pools[i].lvl);
+	for (i = 0; i < health_n_rings; i++) {
+		display_level(epc_ring_stats[i].name, &health_rings[i].lvl);
+		display_rate("  drops", &health_rings[i].drops);
+	}
+	for (port = 0; port < epc_app.n_ports; port++) {
+		hp = &health_ports[port];
+		printf("  port %u\n", port);
+		display_rate("  imissed", &hp->imissed);
+		display_rate("  rx_nombuf", &hp->rx_nombuf);
+		display_rate("  ierrors", &hp->ierrors);
+		display_rate("  oerrors", &hp->oerrors);
+		for (i = 0; i < hp->n_tracked; i++) {
+			char name[RTE_ETH_XSTATS_NAME_SIZE + 2];
+
+			snprintf(name, sizeof(name), "  %s", hp->xs_name[i]);
+			display_rate(name, &hp->xs_rate[i]);
+		}
+	}
+}
+#endif /* HEALTH_MON */
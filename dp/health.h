@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _HEALTH_H_
+#define _HEALTH_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the DP health sampler.
+ *
+ * The stats lcore samples the fill level of every mempool and pipeline
+ * ring and the drop counters of the NICs (rte_eth_stats and the xstats
+ * named like a drop or error counter) every HEALTH_INTERVAL_MS. A
+ * metric crossing its threshold raises an alarm that is logged once,
+ * and cleared with hysteresis when it falls back, so pool exhaustion is
+ * reported as it builds up rather than after the throughput collapsed.
+ */
+#ifdef HEALTH_MON
+#include <stdint.h>
+
+/** Sample interval of the stats lcore */
+#define HEALTH_INTERVAL_MS	1000
+/** Max mempools tracked */
+#define HEALTH_MAX_POOLS	64
+/** Max NIC xstats tracked per port */
+#define HEALTH_MAX_XSTATS	64
+/** Alarms clear this many percent below the threshold */
+#define HEALTH_HYSTERESIS_PCT	10
+
+/**
+ * Alarm thresholds, set with --pool_alarm, --ring_alarm and
+ * --drop_alarm.
+ */
+struct health_cfg {
+	uint32_t pool_pct;	/** mempool in use, percent of size */
+	uint32_t ring_pct;	/** ring occupancy, percent of size */
+	uint32_t drops;		/** NIC or ring drops per interval */
+};
+
+extern struct health_cfg health_cfg;
+
+/**
+ * Look up the NIC xstats to track. Called once the ports are started.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void health_init(void);
+
+/**
+ * Sample the metrics if HEALTH_INTERVAL_MS passed since the last
+ * sample. Called by the stats lcore.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void health_poll(void);
+
+/**
+ * Print the tracked metrics with their peak and alarm state.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_health_stats(void);
+
+#endif /* HEALTH_MON */
+#endif /* _HEALTH_H_ */
@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <rte_lcore.h>
 #include <rte_per_lcore.h>
@@ -25,8 +26,10 @@
 #include <rte_ring.h>
 #include <rte_mempool.h>
 #include <rte_mbuf.h>
+#include <rte_malloc.h>
 
 #include "main.h"
+#include "pkt_mirror.h"
 
 /**
  * macro to config rx ring size.
@@ -38,11 +41,6 @@
  */
 #define TX_RING_SIZE 512
 
-/**
- * macro to config number of mbufs.
- */
-#define NUM_MBUFS 8191
-
 /**
  * macro to config cache size.
  */
@@ -57,6 +55,166 @@ static const struct rte_eth_conf port_conf_default = {
 };
 
 
+#ifdef NIC_RSS_STEERING
+/**
+ * RSS hash key. The first 64 bits are zero so that the source address
+ * does not contribute to the IPv4 Toeplitz hash: all downlink packets of
+ * a UE land on the same worker queue irrespective of the SGi peer.
+ */
+uint8_t epc_rss_key[EPC_RSS_KEY_LEN] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
+/**
+ * RSS hash key of the tunneled ports. All GTPU pkts are sent to the one
+ * SGWU/PGWU address, the source address and the UDP ports of the peers
+ * spread them over the worker queues.
+ */
+static uint8_t epc_tun_rss_key[EPC_RSS_KEY_LEN] = {
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+#endif	/* NIC_RSS_STEERING */
+
+#if defined(NIC_RSS_STEERING) || defined(HW_CTRL_STEERING)
+/**
+ * Function to program the RSS redirection table of a port so that
+ * hash bucket i is served by worker queue (i % nb_queues).
+ * @param port
+ *	port number.
+ * @param nb_queues
+ *	number of worker rx queues.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on failure
+ */
+static int rss_reta_init(uint8_t port, uint16_t nb_queues)
+{
+	struct rte_eth_dev_info dev_info;
+	struct rte_eth_rss_reta_entry64
+		reta_conf[ETH_RSS_RETA_SIZE_512 / RTE_RETA_GROUP_SIZE];
+	uint16_t i;
+
+	rte_eth_dev_info_get(port, &dev_info);
+	if (dev_info.reta_size == 0 ||
+		dev_info.reta_size > ETH_RSS_RETA_SIZE_512)
+		return -1;
+
+	memset(reta_conf, 0, sizeof(reta_conf));
+	for (i = 0; i < dev_info.reta_size; i++) {
+		reta_conf[i / RTE_RETA_GROUP_SIZE].mask |=
+			(1ULL << (i % RTE_RETA_GROUP_SIZE));
+		reta_conf[i / RTE_RETA_GROUP_SIZE].reta[i % RTE_RETA_GROUP_SIZE]
+			= i % nb_queues;
+	}
+
+	if (rte_eth_dev_rss_reta_update(port, reta_conf, dev_info.reta_size))
+		return -1;
+
+#ifdef NIC_RSS_STEERING
+	epc_app.rss_reta_size = dev_info.reta_size;
+#endif
+	return 0;
+}
+#endif	/* NIC_RSS_STEERING || HW_CTRL_STEERING */
+
+#ifdef HW_CTRL_STEERING
+/**
+ * Function to add an ntuple filter sending the IPv4 pkts of proto to
+ * addr on queue.
+ * @param port
+ *	port number.
+ * @param addr
+ *	destination ipv4 address, network order.
+ * @param proto
+ *	ip protocol, 0 matches any protocol.
+ * @param queue
+ *	rx queue.
+ *
+ * @return
+ *	- 0 on success
+ *	- < 0 on failure
+ */
+static int ctrl_ntuple_add(uint8_t port, uint32_t addr, uint8_t proto,
+		uint16_t queue)
+{
+	struct rte_eth_ntuple_filter filter = {
+		.flags = RTE_5TUPLE_FLAGS,
+		.dst_ip = addr,
+		.dst_ip_mask = UINT32_MAX,
+		.proto = proto,
+		.proto_mask = proto ? UINT8_MAX : 0,
+		.priority = 1,
+		.queue = queue,
+	};
+
+	return rte_eth_dev_filter_ctrl(port, RTE_ETH_FILTER_NTUPLE,
+			RTE_ETH_FILTER_ADD, &filter);
+}
+
+/**
+ * Function to steer the control traffic of a port on its control queue:
+ * ARP, and the pkts addressed to the port ip that are not GTPU. Ports
+ * terminating GTPU only get ICMP and TCP steered, the other GTPU peer
+ * traffic stays on the data queues.
+ * @param port
+ *	port number.
+ * @param queue
+ *	control rx queue.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the NIC cannot hold the filters
+ */
+static int ctrl_steering_init(uint8_t port, uint16_t queue)
+{
+	struct rte_eth_ethertype_filter arp = {
+		.ether_type = ETHER_TYPE_ARP,
+		.queue = queue,
+	};
+	uint32_t addr;
+	int gtpu;
+
+	if (port == app.s1u_port) {
+		addr = app.s1u_ip;
+		gtpu = 1;
+	} else if (port == app.s5s8_sgwu_port && app.spgw_cfg == SGWU) {
+		addr = app.s5s8_sgwu_ip;
+		gtpu = 1;
+	} else if (port == app.s5s8_pgwu_port && app.spgw_cfg == PGWU) {
+		addr = app.s5s8_pgwu_ip;
+		gtpu = 1;
+	} else {
+		addr = app.sgi_ip;
+		gtpu = 0;
+	}
+
+	if (rte_eth_dev_filter_supported(port, RTE_ETH_FILTER_ETHERTYPE) ||
+		rte_eth_dev_filter_supported(port, RTE_ETH_FILTER_NTUPLE))
+		return -1;
+
+	if (rte_eth_dev_filter_ctrl(port, RTE_ETH_FILTER_ETHERTYPE,
+			RTE_ETH_FILTER_ADD, &arp) < 0)
+		return -1;
+
+	if (!gtpu)
+		return (ctrl_ntuple_add(port, addr, 0, queue) < 0) ? -1 : 0;
+
+	if (ctrl_ntuple_add(port, addr, IPPROTO_ICMP, queue) < 0 ||
+		ctrl_ntuple_add(port, addr, IPPROTO_TCP, queue) < 0)
+		return -1;
+	return 0;
+}
+#endif	/* HW_CTRL_STEERING */
+
 /**
  * Function to Initialize a given port using global settings and with the rx
  * buffers coming from the mbuf_pool passed as parameter
@@ -72,21 +230,119 @@ static const struct rte_eth_conf port_conf_default = {
 static inline int port_init(uint8_t port, struct rte_mempool *mbuf_pool)
 {
 	struct rte_eth_conf port_conf = port_conf_default;
-	const uint16_t rx_rings = 1, tx_rings = 1;
+#ifdef NIC_RSS_STEERING
+	/* One rx queue per worker, NIC distributes packets with RSS */
+#ifdef WORKER_DIRECT_TX
+	/* One tx queue per worker plus one for the mct core */
+	const uint16_t rx_rings = epc_app.num_workers,
+			tx_rings = epc_app.num_workers + 1;
+#else
+	const uint16_t rx_rings = epc_app.num_workers, tx_rings = 1;
+#endif
+
+	port_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
+	port_conf.rx_adv_conf.rss_conf.rss_key_len = EPC_RSS_KEY_LEN;
+	if (app.spgw_cfg != SGWU && port == app.sgi_port) {
+		/* untunneled downlink: UE affinity on the dst address */
+		port_conf.rx_adv_conf.rss_conf.rss_key = epc_rss_key;
+		port_conf.rx_adv_conf.rss_conf.rss_hf = ETH_RSS_IP;
+	} else {
+		port_conf.rx_adv_conf.rss_conf.rss_key = epc_tun_rss_key;
+		port_conf.rx_adv_conf.rss_conf.rss_hf = ETH_RSS_IP |
+			ETH_RSS_NONFRAG_IPV4_UDP;
+	}
+#else
+#ifdef WORKER_DIRECT_TX
+	/* One rx queue per rx pipeline instance, one tx queue per worker
+	 * plus one for the mct core */
+	const uint16_t rx_rings = epc_app.n_queues,
+			tx_rings = epc_app.num_workers + 1;
+#else
+	/* One rx/tx queue per rx/tx pipeline instance */
+	const uint16_t rx_rings = epc_app.n_queues,
+			tx_rings = epc_app.n_queues;
+#endif
+
+	if (rx_rings > 1) {
+		port_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
+		port_conf.rx_adv_conf.rss_conf.rss_key = NULL;
+		port_conf.rx_adv_conf.rss_conf.rss_hf = ETH_RSS_IP;
+	}
+#endif
 	int retval;
 	uint16_t q;
+	uint16_t nb_tx_rings = tx_rings;
+	struct rte_eth_dev_info dev_info;
+	struct rte_eth_txconf txconf;
+
+#ifdef JUMBO_FRAMES
+	if (app.max_pkt_len > ETHER_MAX_LEN) {
+		port_conf.rxmode.jumbo_frame = 1;
+		port_conf.rxmode.max_rx_pkt_len = app.max_pkt_len;
+		/* pkts larger than an mbuf are received chained */
+		if (app.max_pkt_len > RTE_MBUF_DEFAULT_DATAROOM)
+			port_conf.rxmode.enable_scatter = 1;
+	}
+#endif
 
 	if (port >= rte_eth_dev_count())
 		return -1;
-	/* TODO: use q 1 for arp */
+
+	rte_eth_dev_info_get(port, &dev_info);
+	txconf = dev_info.default_txconf;
+#ifdef PKT_CAPTURE
+	/* captured pkts are still referenced when tx frees them */
+	txconf.txq_flags &= ~ETH_TXQ_FLAGS_NOREFCOUNT;
+#endif
+#ifdef PKT_MIRROR
+	/* mirrored pkts are referenced by their clones, which are chained
+	 * when the pkts are */
+	txconf.txq_flags &= ~(ETH_TXQ_FLAGS_NOMULTSEGS |
+			ETH_TXQ_FLAGS_NOREFCOUNT);
+	/* The mirror queue follows the data queues */
+	if (port == mirror_port) {
+		epc_app.mirror_queue = tx_rings;
+		nb_tx_rings++;
+	}
+#endif
+#ifdef JUMBO_FRAMES
+	/* jumbo pkts are sent chained */
+	txconf.txq_flags &= ~ETH_TXQ_FLAGS_NOMULTSEGS;
+#endif
+#ifdef GTPU_FRAG
+	/* reassembled pkts and fragments are chained, fragments reference
+	 * the data of their pkt */
+	txconf.txq_flags &= ~(ETH_TXQ_FLAGS_NOMULTSEGS |
+			ETH_TXQ_FLAGS_NOREFCOUNT);
+#endif
+	epc_app.tx_cksum_ol[port] = 0;
+	if (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_IPV4_CKSUM) {
+		/* Select the offload capable tx path of the PMD */
+		txconf.txq_flags &= ~ETH_TXQ_FLAGS_NOXSUMS;
+		epc_app.tx_cksum_ol[port] = PKT_TX_IPV4 | PKT_TX_IP_CKSUM;
+	}
+	RTE_LOG(INFO, DP, "Port %u: IPv4 checksum %s\n", port,
+			epc_app.tx_cksum_ol[port] ? "offloaded" : "in software");
 
 	/* Configure the Ethernet device. */
-	retval = rte_eth_dev_configure(port, rx_rings, tx_rings, &port_conf);
+#ifdef HW_CTRL_STEERING
+	/* The control queue follows the data queues */
+	epc_app.ctrl_queue = rx_rings;
+	retval = rte_eth_dev_configure(port, rx_rings + 1, nb_tx_rings,
+			&port_conf);
+#else
+	retval = rte_eth_dev_configure(port, rx_rings, nb_tx_rings,
+			&port_conf);
+#endif
 	if (retval != 0)
 		return retval;
 
 	/* Allocate and set up RX queue per Ethernet port. */
+#ifdef HW_CTRL_STEERING
+	for (q = 0; q <= rx_rings; q++) {
+#else
 	for (q = 0; q < rx_rings; q++) {
+#endif
 		retval = rte_eth_rx_queue_setup(port, q, RX_RING_SIZE,
 				rte_eth_dev_socket_id(port),
 				NULL, mbuf_pool);
@@ -95,10 +351,10 @@ static inline int port_init(uint8_t port, struct rte_mempool *mbuf_pool)
 	}
 
 	/* Allocate and set up TX queue per Ethernet port. */
-	for (q = 0; q < tx_rings; q++) {
+	for (q = 0; q < nb_tx_rings; q++) {
 		retval = rte_eth_tx_queue_setup(port, q, TX_RING_SIZE,
 				rte_eth_dev_socket_id(port),
-				NULL);
+				&txconf);
 		if (retval < 0)
 			return retval;
 	}
@@ -108,6 +364,30 @@ static inline int port_init(uint8_t port, struct rte_mempool *mbuf_pool)
 	if (retval < 0)
 		return retval;
 
+#ifdef NIC_RSS_STEERING
+	if (rss_reta_init(port, rx_rings) < 0) {
+		RTE_LOG(ERR, DP, "Port %u: RSS redirection table update failed\n",
+				port);
+		return -1;
+	}
+#elif defined(HW_CTRL_STEERING)
+	/* Keep the RSS buckets off the control queue */
+	if (rx_rings > 1 && rss_reta_init(port, rx_rings) < 0) {
+		RTE_LOG(ERR, DP, "Port %u: RSS redirection table update failed\n",
+				port);
+		return -1;
+	}
+#endif
+
+#ifdef HW_CTRL_STEERING
+	if (ctrl_steering_init(port, epc_app.ctrl_queue) < 0)
+		RTE_LOG(INFO, DP, "Port %u: control pkts classified in "
+				"software\n", port);
+	else
+		RTE_LOG(INFO, DP, "Port %u: control pkts steered to rx "
+				"queue %u\n", port, epc_app.ctrl_queue);
+#endif
+
 	/* Display the port MAC address. */
 
 	rte_eth_macaddr_get(port, &ports_eth_addr[port]);
@@ -127,27 +407,76 @@ static inline int port_init(uint8_t port, struct rte_mempool *mbuf_pool)
 	return 0;
 }
 
+int dp_lcore_socket(unsigned lcore)
+{
+	static int8_t has_mem[RTE_MAX_NUMA_NODES];
+	struct rte_malloc_socket_stats st;
+	unsigned socket;
+
+	if (!app.numa_on || lcore >= RTE_MAX_LCORE)
+		return rte_socket_id();
+
+	socket = rte_lcore_to_socket_id(lcore);
+	if (socket >= RTE_MAX_NUMA_NODES)
+		return rte_socket_id();
+	if (has_mem[socket] == 0)
+		has_mem[socket] = (rte_malloc_get_socket_stats(socket, &st) == 0
+				&& st.heap_totalsz_bytes) ? 1 : -1;
+	return (has_mem[socket] > 0) ? (int)socket : (int)rte_socket_id();
+}
+
+int dp_port_socket(uint8_t port)
+{
+	int socket = rte_eth_dev_socket_id(port);
+	unsigned lcore;
+
+	if (!app.numa_on || socket < 0)
+		return rte_socket_id();
+	/* an lcore of the port socket tells if it has memory */
+	RTE_LCORE_FOREACH(lcore) {
+		if ((int)rte_lcore_to_socket_id(lcore) == socket)
+			return dp_lcore_socket(lcore);
+	}
+	return rte_socket_id();
+}
+
 void dp_port_init(void)
 {
-	struct rte_mempool *mbuf_pool;
+	struct rte_mempool *mbuf_pool[RTE_MAX_NUMA_NODES] = {NULL};
+	uint32_t nb_sock_ports[RTE_MAX_NUMA_NODES] = {0};
+	char name[RTE_MEMPOOL_NAMESIZE];
 	uint32_t nb_ports;
 	uint8_t portid;
+	int socket;
 
 	nb_ports = rte_eth_dev_count();
 	if (nb_ports < 2 || (nb_ports & 1))
 		rte_exit(EXIT_FAILURE, "Error: number of ports must be two\n");
 
-	/* Creates a new mempool in memory to hold the mbufs. */
-	mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL", NUM_MBUFS * nb_ports,
-			MBUF_CACHE_SIZE, 0,
-			RTE_MBUF_DEFAULT_BUF_SIZE,
-			rte_socket_id());
-	if (mbuf_pool == NULL)
-		rte_exit(EXIT_FAILURE, "Cannot create mempool !!!\n");
+	for (portid = 0; portid < nb_ports; portid++)
+		nb_sock_ports[dp_port_socket(portid)]++;
+
+	/* Creates a mempool to hold the mbufs of the ports of each socket */
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+		if (nb_sock_ports[socket] == 0)
+			continue;
+		if (socket == (int)rte_socket_id())
+			snprintf(name, sizeof(name), "MBUF_POOL");
+		else
+			snprintf(name, sizeof(name), "MBUF_POOL_%d", socket);
+		mbuf_pool[socket] = rte_pktmbuf_pool_create(name,
+				NUM_MBUFS * nb_sock_ports[socket],
+				MBUF_CACHE_SIZE, 0,
+				RTE_MBUF_DEFAULT_BUF_SIZE, socket);
+		if (mbuf_pool[socket] == NULL)
+			rte_exit(EXIT_FAILURE, "Cannot create mempool !!!\n");
+		RTE_LOG(INFO, DP, "%s: %u ports on socket %d\n", name,
+				nb_sock_ports[socket], socket);
+	}
 
 	/* Initialize all ports. */
 	for (portid = 0; portid < nb_ports; portid++)
-		if (port_init(portid, mbuf_pool) != 0)
+		if (port_init(portid, mbuf_pool[dp_port_socket(portid)]) != 0)
 			rte_exit(EXIT_FAILURE, "Cannot init port %" PRIu8 "\n",
 					portid);
 
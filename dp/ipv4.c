@@ -37,11 +37,22 @@ static void update_ckcum(struct rte_mbuf *m)
 
 void
 construct_ipv4_hdr(struct rte_mbuf *m, uint16_t len, uint8_t protocol,
-		   uint32_t src_ip, uint32_t dst_ip)
+		   uint32_t src_ip, uint32_t dst_ip, uint8_t port)
 {
+	uint64_t ol_flags = epc_app.tx_cksum_ol[port];
+
 	build_ipv4_default_hdr(m);
 
 	set_ipv4_hdr(m, len, protocol, src_ip, dst_ip);
 
+	if (likely(ol_flags)) {
+		/* NIC computes the checksum, header is untagged */
+		get_mtoip(m)->hdr_checksum = 0;
+		m->l2_len = ETH_HDR_SIZE;
+		m->l3_len = IPv4_HDR_SIZE;
+		m->ol_flags |= ol_flags;
+		return;
+	}
+
 	update_ckcum(m);
 }
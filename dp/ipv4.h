@@ -116,12 +116,15 @@ set_ipv4_hdr(struct rte_mbuf *m, uint16_t len, uint8_t protocol,
  *	next protocol id
  * @param src_ip
  * @param dst_ip
+ * @param port
+ *	port the packet is sent on, the checksum is offloaded to the NIC
+ *	when the port supports it
  *
  * @return
  *	None
  */
 void
 construct_ipv4_hdr(struct rte_mbuf *m, uint16_t len, uint8_t protocol,
-		   uint32_t src_ip, uint32_t dst_ip);
+		   uint32_t src_ip, uint32_t dst_ip, uint8_t port);
 
 #endif				/* _IPV4_H_ */
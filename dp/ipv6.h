@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _IPV6_H_
+#define _IPV6_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and helpers of
+ * the dataplane IPv6 UE pkts.
+ * IPv6 UEs are assigned a /64 prefix, their sessions are keyed on it.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include "vepc_cp_dp_api.h"
+
+/** Length of the UE prefix of IPv6 UEs, in bytes */
+#define UE_IPV6_PREFIX_LEN	8
+
+/**
+ * Downlink bearer map key of IPv6 UEs.
+ */
+struct dl6_bm_key {
+	/** UE /64 prefix, packet byte order */
+	uint64_t ue_prefix;
+	/** Rule id */
+	uint32_t rid;
+	uint32_t pad;
+};
+
+/**
+ * Check the IP version of an ip header.
+ *
+ * @param ip
+ *	ip header pointer
+ *
+ * @return
+ *	non zero if IPv6
+ */
+static inline int ip_hdr_is_ipv6(const void *ip)
+{
+	return (*(const uint8_t *)ip >> 4) == 6;
+}
+
+/**
+ * Check the IP version of the untagged pkt.
+ *
+ * @param m
+ *	mbuf pointer
+ *
+ * @return
+ *	non zero if IPv6
+ */
+static inline int mbuf_is_ipv6(struct rte_mbuf *m)
+{
+	return ip_hdr_is_ipv6(rte_pktmbuf_mtod_offset(m, void *,
+				sizeof(struct ether_hdr)));
+}
+
+/**
+ * Function to return pointer to ipv6 header, assuming ether header is
+ * untagged.
+ *
+ * @param m
+ *	mbuf pointer
+ *
+ * @return
+ *	pointer to ipv6 header
+ */
+static inline struct ipv6_hdr *get_mtoip6(struct rte_mbuf *m)
+{
+	return rte_pktmbuf_mtod_offset(m, struct ipv6_hdr *,
+				       sizeof(struct ether_hdr));
+}
+
+/**
+ * Get the /64 prefix of an IPv6 address.
+ *
+ * @param addr
+ *	IPv6 address
+ *
+ * @return
+ *	prefix, packet byte order
+ */
+static inline uint64_t ipv6_prefix64(const uint8_t *addr)
+{
+	uint64_t prefix;
+
+	memcpy(&prefix, addr, sizeof(prefix));
+	return prefix;
+}
+
+/**
+ * Fold the /64 prefix of an IPv6 address to the 32 bits the load
+ * balancer hashes.
+ *
+ * @param addr
+ *	IPv6 address
+ *
+ * @return
+ *	folded prefix, packet byte order
+ */
+static inline uint32_t ipv6_prefix_fold(const uint8_t *addr)
+{
+	uint64_t prefix = ipv6_prefix64(addr);
+
+	return (uint32_t)prefix ^ (uint32_t)(prefix >> 32);
+}
+
+/**
+ * Get the UE ip address the load balancer steers the pkts of a UE on.
+ *
+ * @param ue_addr
+ *	UE ip address
+ *
+ * @return
+ *	UE ip, packet byte order
+ */
+static inline uint32_t ue_addr_lb_ip(const struct ip_addr *ue_addr)
+{
+#ifdef UE_IPV6
+	if (ue_addr->iptype == IPTYPE_IPV6)
+		return ipv6_prefix_fold(ue_addr->u.ipv6_addr);
+#endif /* UE_IPV6 */
+	return htonl(ue_addr->u.ipv4_addr);
+}
+
+#ifdef UE_IPV6
+#define UE_ADDR_IS_IPV6(ue_addr)	((ue_addr)->iptype == IPTYPE_IPV6)
+#else
+#define UE_ADDR_IS_IPV6(ue_addr)	0
+#endif /* UE_IPV6 */
+
+#endif /* _IPV6_H_ */
@@ -30,6 +30,36 @@
 #include "cdr.h"
 #include "session_cdr.h"
 #include "master_cdr.h"
+#ifdef PKT_CAPTURE
+#include "pkt_capture.h"
+#endif
+#ifdef TELEMETRY_SHM
+#include "telemetry.h"
+#endif
+#ifdef HEALTH_MON
+#include "health.h"
+#endif
+#ifdef MULTI_DP
+#include "dp_load.h"
+#endif
+#ifdef S5S8_BYPASS
+#include "s5s8_bypass.h"
+#endif
+#ifdef GTPU_FRAG
+#include "gtpu_frag.h"
+#endif
+#ifdef PKT_MIRROR
+#include "pkt_mirror.h"
+#endif
+#ifdef DP_BENCH
+#include "bench.h"
+#endif
+#ifdef DP_MICROBENCH
+#include "microbench.h"
+#endif
+#ifdef WARM_RESTART
+#include "sess_store.h"
+#endif
 
 /* Temp. work around for debug log level. Issue in DPDK-16.11*/
 #if (RTE_VER_YEAR >= 16) && (RTE_VER_MONTH >= 11)
@@ -53,11 +83,39 @@ int main(int argc, char **argv)
 	argc -= ret;
 	argv += ret;
 
-	dp_port_init();
-
 	/* DP Init */
 	dp_init(argc, argv);
 
+#ifdef DP_MICROBENCH
+	/* kernels run on this lcore, no ports or workers are used */
+	if (microbench_mask) {
+		dp_table_init();
+		microbench_run();
+		return 0;
+	}
+#endif
+
+#ifdef DP_BENCH
+	/* ring ports of the bench lcore replace the NICs */
+	if (bench_on)
+		bench_port_create(&app);
+#endif
+
+	/* Port queues depend on the parsed number of workers */
+	dp_port_init();
+
+#ifdef S5S8_BYPASS
+	/* rx pipelines of the S5/S8 port read the bypass */
+	s5s8_bypass_init();
+#endif
+#ifdef GTPU_FRAG
+	gtpu_frag_init();
+#endif
+#ifdef PKT_MIRROR
+	/* the mirror queue is set up with the ports */
+	mirror_init();
+#endif
+
 /** Note :In dpdk set max log level is INFO, here override the
  *  max value of RTE_LOG_INFO for enable DEBUG logs (dpdk-16.11.4).
  */
@@ -116,13 +174,28 @@ int main(int argc, char **argv)
 			rte_exit(EXIT_FAILURE, "Invalid DP type(SPGW_CFG).\n");
 	}
 
-	finalize_cur_cdrs(cdr_path);
+	finalize_cur_cdrs(cdr_path, NULL);
 
 	sess_cdr_init();
-
+#ifdef PKT_CAPTURE
+	capture_init();
+#endif
+#ifdef TELEMETRY_SHM
+	dp_telemetry_init();
+#endif
+#ifdef HEALTH_MON
+	health_init();
+#endif
 
 	iface_module_constructor();
+#ifdef MULTI_DP
+	dp_load_init();
+#endif
 	dp_table_init();
+#ifdef WARM_RESTART
+	/* tables of the previous DP, before the CP messages */
+	sess_store_init();
+#endif
 
 	packet_framework_launch();
 
@@ -31,6 +31,7 @@
 #include <rte_hash.h>
 #include <rte_malloc.h>
 #include <rte_meter.h>
+#include <rte_spinlock.h>
 #include <rte_jhash.h>
 #include <rte_version.h>
 
@@ -97,6 +98,11 @@ extern uint8_t RTE_LOG_INFO;
  */
 #define ISSET_BIT(mask, n)  (((mask) & (1LLU << (n))) ? 1 : 0)
 
+/**
+ * macro to config number of mbufs, per port.
+ */
+#define NUM_MBUFS 8191
+
 /**
  * default ring size
  */
@@ -127,6 +133,11 @@ extern uint8_t RTE_LOG_INFO;
  */
 #define DNS_RULE_ID (MAX_ADC_RULES + 1)
 
+/**
+ * UDP source port of DNS responses.
+ */
+#define DNS_PORT 53
+
 /**
  * max length of name string.
  */
@@ -171,6 +182,25 @@ extern uint8_t RTE_LOG_INFO;
 #define HASH_SIZE_FACTOR 1
 #endif
 
+#ifdef TABLE_BUDGET
+/**
+ * Session table sizes, set at start up by table_budget_init().
+ */
+struct dp_table_size {
+	uint32_t bearers;	/** uplink, downlink and session entries */
+	uint32_t ues;		/** UE and ADC UE entries */
+};
+extern struct dp_table_size dp_tbl_size;
+
+#define DP_BEARER_ENTRIES	(dp_tbl_size.bearers)
+#define DP_SESS_ENTRIES		(dp_tbl_size.bearers)
+#define DP_UE_ENTRIES		(dp_tbl_size.ues)
+#else
+#define DP_BEARER_ENTRIES	(LDB_ENTRIES_DEFAULT * HASH_SIZE_FACTOR)
+#define DP_SESS_ENTRIES		LDB_ENTRIES_DEFAULT
+#define DP_UE_ENTRIES		LDB_ENTRIES_DEFAULT
+#endif /* TABLE_BUDGET */
+
 #ifdef DP_TABLE_CONFIG
 #define SDF_FILTER_TABLE "sdf_filter_table"
 #define ADC_TABLE "adc_rule_table"
@@ -182,6 +212,7 @@ extern uint8_t RTE_LOG_INFO;
 #define SDF_FILTER_TABLE_SIZE        (1024)
 #define ADC_TABLE_SIZE               (1024)
 #define PCC_TABLE_SIZE               (1025)
+#define FILTER_PCC_NODE_TABLE_SIZE   (PCC_TABLE_SIZE * MAX_SDF_IDX_COUNT)
 #define METER_PROFILE_SDF_TABLE_SIZE (2048)
 #define DPN_ID                       (12345)
 #endif /* DP_TABLE_CONFIG */
@@ -232,6 +263,8 @@ struct app_params {
 	uint32_t sgi_net;			/* sgi network address */
 	uint32_t sgi_gw_ip;			/* sgi gateway ipv4 address */
 	uint32_t sgi_mask;			/* sgi network mask */
+	uint32_t ue_pool_ip;			/* UE ip pool address */
+	uint32_t ue_pool_mask;			/* UE ip pool mask */
 	uint32_t s1u_port;			/* port no. to act as s1u */
 	uint32_t s5s8_sgwu_port;	/* port no. to act as s5s8_sgwu */
 	uint32_t s5s8_pgwu_port;	/* port no. to act as s5s8_pgwu */
@@ -241,6 +274,31 @@ struct app_params {
 	uint32_t numa_on;			/* Numa socket default 0 - disable,
 						 * 1 - enable	 */
 	enum dp_config spgw_cfg;
+#ifdef INTERIM_CDR
+	uint32_t interim_cdr_sec;		/* interim CDR interval,
+						 * 0 - disable	 */
+#endif
+#ifdef SESS_AGING
+	uint32_t sess_idle_sec;			/* bearer inactivity before it is
+						 * reported idle, 0 - disable */
+	uint32_t sess_reclaim_sec;		/* bearer inactivity before it is
+						 * deleted, 0 - disable */
+#endif
+#ifdef RUNTIME_STAGES
+	uint32_t stages;			/* DP_STAGE_* run by workers */
+#endif
+#ifdef JUMBO_FRAMES
+	uint32_t max_pkt_len;			/* largest frame received on the
+						 * ports, 0 - ETHER_MAX_LEN */
+#endif
+#ifdef GTPU_FRAG
+	uint32_t gtpu_mtu;			/* outer ipv4 MTU of the GTPU
+						 * ports, 0 - ETHER_MTU */
+#endif
+#ifdef SERVICE_SCHED
+	uint32_t idle_sleep_us;			/* sleep of idle service lcores,
+						 * 0 - pause only */
+#endif
 	struct ether_addr s1u_ether_addr;		/* s1u mac addr */
 	struct ether_addr s5s8_sgwu_ether_addr;	/* s5s8_sgwu mac addr */
 	struct ether_addr s5s8_pgwu_ether_addr;	/* s5s8_pgwu mac addr */
@@ -250,6 +308,34 @@ struct app_params {
 /** extern the app config struct */
 extern struct app_params app;
 
+#ifdef RUNTIME_STAGES
+/** Worker stages selected with --stages, if compiled in */
+#define DP_STAGE_SDF_MTR	(1 << 0)
+#define DP_STAGE_APN_MTR	(1 << 1)
+#define DP_STAGE_RATING_GRP	(1 << 2)
+#define DP_STAGE_EGRESS_QOS	(1 << 3)
+#define DP_STAGE_DNS		(1 << 4)
+#define DP_STAGE_PCAP		(1 << 5)
+#define DP_STAGE_ALL		((1 << 6) - 1)
+
+/** Check if optional worker stage s is selected */
+#define DP_STAGE_ON(s)		(app.stages & (s))
+
+/**
+ * @brief Assemble the charging stages run by the workers on filtered
+ * pkts from the compiled in stages selected in stages.
+ * @param stages
+ *	DP_STAGE_* mask.
+ *
+ * @return
+ *	None
+ */
+void
+pkt_stages_init(uint32_t stages);
+#else
+#define DP_STAGE_ON(s)		1
+#endif	/* RUNTIME_STAGES */
+
 /** ethernet addresses of ports */
 struct ether_addr ports_eth_addr[RTE_MAX_ETHPORTS];
 
@@ -260,6 +346,10 @@ extern struct ether_addr ports_eth_addr[];
 struct msg_adc {
 	uint32_t ipv4;
 	uint32_t rule_id;
+#ifdef ADC_DNS_AGING
+	/** TTL of the DNS answer, seconds */
+	uint32_t ttl;
+#endif
 };
 
 /** UL Bearer Map key for hash lookup.*/
@@ -297,14 +387,81 @@ struct dp_adc_rules {
 	uint16_t mtr_profile_index;             /* index 0 to skip */
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
+/**
+ * Max size of the outer IPv4/UDP/GTP-U header added by downlink encap.
+ */
+#define DL_ENCAP_HDR_MAX	40
+
+/**
+ * Downlink encap header template, built when the session is created or
+ * modified so that encap only copies it and patches the lengths.
+ */
+struct dl_encap_tmpl {
+	uint8_t hdr[DL_ENCAP_HDR_MAX];	/**< outer IPv4/UDP/GTP-U header */
+	uint32_t ip_sum;		/**< IPv4 header sum without length */
+	uint32_t teid;			/**< tunnel teid, 0 when not known */
+} __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
+
 /**
  * Bearer Session information structure
+ *
+ * Cache lines 0 and 1 hold the two downlink encap templates, line 2 the
+ * other fields read per packet and line 3 onwards the bearer CDR, whose
+ * counters are written per packet. Fields after the CDR are control only.
  */
 struct dp_session_info {
+	/** DL encap headers, one in use and one for the next modify */
+	struct dl_encap_tmpl dl_encap_buf[2];
+	/* Per packet, read only */
+	/** DL encap header in use, switched in one store on modify */
+	const struct dl_encap_tmpl *dl_encap;
+	/** Session state for use with downlink data processing*/
+	enum dp_session_state sess_state;
+	/** Default bearer only session, pkts skip SDF and ADC filtering
+	 * while it equals sess_fast_path_gen, 0 if not flagged */
+	uint32_t fast_path;
+#ifdef PKT_MIRROR
+	/** Egress pkts are mirrored, see mirror_sess_update() */
+	uint8_t mirror;
+#endif	/* PKT_MIRROR */
+#ifdef DDN_BUF_POOL
+	/** Paging buffer of the DL pkts for this session, NULL if none */
+	struct ddn_buf *ddn_buf;
+#else
+	/** Ring to hold the DL pkts for this session */
+	struct rte_ring *dl_ring;
+#endif	/* DDN_BUF_POOL */
+	struct ue_session_info *ue_info_ptr;	/**< Pointer to UE info of this bearer */
+	uint64_t sess_id;						/**< session id of this bearer
+									 * last 4 bits of sess_id
+									 * maps to bearer id*/
+#ifdef SESS_AGING
+	uint32_t last_active;				/**< sess_age_now of the last pkt*/
+#endif	/* SESS_AGING */
+	uint32_t enb_teid;				/**< dl_s1_info.enb_teid*/
+	uint32_t enb_ipv4;				/**< dl_s1_info.enb_addr*/
+	uint32_t s5s8_pgwu_ipv4;			/**< ul_s1_info.s5s8_pgwu_addr*/
+	uint32_t s5s8_sgwu_ipv4;			/**< dl_s1_info.s5s8_sgwu_addr*/
+#ifdef CDR_COUNTER_SHARDS
+	uint32_t cdr_slot;				/**< worker counters of ipcan_dp_bearer_cdr*/
+#endif	/* CDR_COUNTER_SHARDS */
+
+	/* Charging Data Records, counters written per packet*/
+	struct ipcan_dp_bearer_cdr ipcan_dp_bearer_cdr;	/**< IP CAN bearer CDR*/
+
+	/* Control only */
 	struct ip_addr ue_addr;				/**< UE ip address*/
 	struct ul_s1_info ul_s1_info;			/**< UpLink S1u info*/
 	struct dl_s1_info dl_s1_info;			/**< DownLink S1u info*/
 	uint8_t linked_bearer_id;				/**< Linked EPS Bearer ID (LBI)*/
+	uint32_t client_id;
+#ifdef SESS_AGING
+	uint8_t idle_reported;			/**< idle bearer counted in sess_age_stats*/
+#endif	/* SESS_AGING */
+#ifdef PKT_MIRROR
+	uint8_t mirror_cp;			/**< mirroring requested by the CP*/
+#endif	/* PKT_MIRROR */
+	uint32_t dl_encap_epoch;		/**< dp_qsbr_epoch() of the last dl_encap switch*/
 
 	/* PCC rules related params*/
 	uint32_t num_ul_pcc_rules;			/**< No. of UL PCC rule*/
@@ -312,23 +469,22 @@ struct dp_session_info {
 	uint32_t num_dl_pcc_rules;			/**< No. of PCC rule*/
 	uint32_t dl_pcc_rule_id[MAX_PCC_RULES];		/**< PCC rule id*/
 
-	/* Charging Data Records*/
-	struct ipcan_dp_bearer_cdr ipcan_dp_bearer_cdr;	/**< IP CAN bearer CDR*/
-
-	uint32_t client_id;
-	uint64_t sess_id;						/**< session id of this bearer
-									 * last 4 bits of sess_id
-									 * maps to bearer id*/
 	uint32_t service_id;						/**< Type of service given
 									 * to this session like
 									 * Internet, Management, CIPA etc
 									 */
-	struct ue_session_info *ue_info_ptr;	/**< Pointer to UE info of this bearer */
-
-	/** Session state for use with downlink data processing*/
-	enum dp_session_state sess_state;
-	/** Ring to hold the DL pkts for this session */
-	struct rte_ring *dl_ring;
+#ifdef LB_LOAD_SHEDDING
+	uint8_t shed_protected;		/**< bearer counted in epc_ue_protected*/
+#endif	/* LB_LOAD_SHEDDING */
+#ifdef WARM_RESTART
+	uint32_t store_slot;		/**< session store slot, 0 if not kept*/
+#endif	/* WARM_RESTART */
+#ifdef MTR_HIERARCHICAL
+	/* Per packet, written */
+	FLOW_METER ul_bearer_mtr_obj __rte_cache_aligned;	/**< UL GBR bearer meter object*/
+	FLOW_METER dl_bearer_mtr_obj;				/**< DL GBR bearer meter object*/
+	uint64_t bearer_mtr_drops;				/**< drop count due to bearer metering*/
+#endif	/* MTR_HIERARCHICAL */
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
 /**
@@ -337,14 +493,23 @@ struct dp_session_info {
 struct ue_session_info {
 	struct ip_addr ue_addr;			/**< UE ip address*/
 	uint32_t bearer_count;			/**< Num. of bearers configured*/
-	struct rte_meter_srtcm ul_apn_mtr_obj;
+	FLOW_METER ul_apn_mtr_obj;
 	/**< UL APN meter object pointer*/
-	struct rte_meter_srtcm dl_apn_mtr_obj;
+	FLOW_METER dl_apn_mtr_obj;
 	/**< DL APN meter object pointer*/
+#ifdef APN_MTR_SHARDED
+	rte_spinlock_t apn_mtr_lock;
+	/**< lock of APN meters, taken by workers to borrow bytes*/
+	uint32_t apn_mtr_gen;
+	/**< id of the UE context, tells the credits of a reused one apart*/
+#endif	/* APN_MTR_SHARDED */
 
 	/* rating groups CDRs*/
 	struct rating_group_index_map rg_idx_map[MAX_RATING_GRP]; /**< Rating group index*/
 	struct ipcan_dp_bearer_cdr rating_grp[MAX_RATING_GRP];	/**< rating groups CDRs*/
+#ifdef CDR_COUNTER_SHARDS
+	uint32_t rg_cdr_slot[MAX_RATING_GRP];	/**< worker counters of rating_grp*/
+#endif	/* CDR_COUNTER_SHARDS */
 	uint32_t ul_apn_mtr_idx;	/**< UL APN meter profile index*/
 	uint32_t dl_apn_mtr_idx;	/**< DL APN meter profile index*/
 	uint64_t ul_apn_mtr_drops;	/**< drop count due to ul apn metering*/
@@ -355,15 +520,51 @@ struct ue_session_info {
 	uint32_t adc_rule_id[MAX_ADC_RULES]; 	/**< list of ADC rule id*/
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
+/**
+ * Session table objects, allocated from fixed size pools when
+ * SESS_MEMPOOL is enabled.
+ */
+enum sess_obj_type {
+	SESS_OBJ_BEARER,	/**< struct dp_session_info */
+	SESS_OBJ_UE,		/**< struct ue_session_info */
+	SESS_OBJ_SDF,		/**< struct dp_sdf_per_bearer_info */
+	SESS_OBJ_ADC_UE,	/**< struct dp_adc_ue_info */
+	SESS_OBJ_MAX
+};
+
+#ifdef SESS_MEMPOOL
+/**
+ * Per lcore cache size of the session object pools.
+ */
+#define SESS_POOL_CACHE_SIZE	64
+
+/** Session object pools, indexed by enum sess_obj_type */
+extern struct rte_mempool *sess_obj_pool[SESS_OBJ_MAX];
+#endif	/* SESS_MEMPOOL */
+
 /**
  * SDF and Bearer specific information structure
+ *
+ * Cache line 0 holds the fields read per packet, line 1 the meter and
+ * the following lines the CDR. The full PCC rule is control only.
  */
 struct dp_sdf_per_bearer_info {
-	struct dp_pcc_rules pcc_info;						/**< PCC info of this bearer */
-	struct rte_meter_srtcm sdf_mtr_obj;					/**< meter object for this SDF flow */
-	struct ipcan_dp_bearer_cdr sdf_cdr;					/**< per SDF bearer CDR*/
+	/* Per packet, read only */
 	struct dp_session_info *bear_sess_info;  	/**< pointer to bearer this flow belongs to */
+	uint32_t rating_group;				/**< pcc_info.rating_group */
+	uint8_t rg_idx;						/**< rating_group index in UE rg_idx_map */
+	struct qos_info qos;				/**< pcc_info.qos */
+
+	/* Per packet, written */
+	FLOW_METER sdf_mtr_obj __rte_cache_aligned;	/**< meter object for this SDF flow */
 	uint64_t sdf_mtr_drops;								/**< drop count due to sdf metering*/
+#ifdef CDR_COUNTER_SHARDS
+	uint32_t cdr_slot;						/**< worker counters of sdf_cdr*/
+#endif	/* CDR_COUNTER_SHARDS */
+	struct ipcan_dp_bearer_cdr sdf_cdr;					/**< per SDF bearer CDR*/
+
+	/* Control only */
+	struct dp_pcc_rules pcc_info;						/**< PCC info of this bearer */
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
 /**
@@ -371,8 +572,12 @@ struct dp_sdf_per_bearer_info {
  */
 struct dp_adc_ue_info {
 	struct dp_adc_rules adc_info;		/**< ADC info of this bearer */
+	uint8_t rg_idx;				/**< adc_info.rating_group index in UE rg_idx_map */
+#ifdef CDR_COUNTER_SHARDS
+	uint32_t cdr_slot;			/**< worker counters of adc_cdr*/
+#endif	/* CDR_COUNTER_SHARDS */
 	struct ipcan_dp_bearer_cdr adc_cdr;	/**< per ADC bearer CDR*/
-	struct rte_meter_srtcm mtr_obj;	/**< meter object for this SDF flow */
+	FLOW_METER mtr_obj;	/**< meter object for this SDF flow */
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
 #ifdef INSTMNT
@@ -422,6 +627,32 @@ scan_dns_ring(__rte_unused void *args);
 void
 dp_port_init(void);
 
+/**
+ * Socket to place the memory used by an lcore on. With --numa 1 this is
+ * the socket of the lcore, if it has hugepage memory, otherwise the
+ * socket of the init core.
+ *
+ * @param lcore
+ *	lcore id.
+ *
+ * @return
+ *	socket id.
+ */
+int
+dp_lcore_socket(unsigned lcore);
+
+/**
+ * Socket to place the memory used by a port on, see dp_lcore_socket().
+ *
+ * @param port
+ *	port id.
+ *
+ * @return
+ *	socket id.
+ */
+int
+dp_port_socket(uint8_t port);
+
 /**
  * Function to initialize the dataplane application config.
  *
@@ -774,6 +1005,36 @@ int
 apn_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info, uint32_t flow,
 			struct rte_mbuf **pkt, uint32_t n, uint64_t *pkts_mask);
 
+#ifdef MTR_HIERARCHICAL
+/**
+ * Process SDF/ADC, GBR bearer and APN metering as one chain. A pkt
+ * uses the tokens of a level only if it conforms at every level, and the
+ * drop is counted at the first level it does not conform to.
+ *
+ * @param sdf_info
+ *     sdf info ptr.
+ * @param adc_ue_info
+ *     adc ue info ptr.
+ * @param flow
+ *     uplink or downlink.
+ * @param pkt
+ *     mbuf pointer
+ * @param n
+ *     num. of pkts.
+ * @param pkts_mask
+ *     bit mask to process the pkts,
+ *     reset bit to free the pkt.
+ *
+ * @return
+ *     - 0 on success
+ *     - -1 on failure
+ */
+int
+hier_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info,
+			void **adc_ue_info, uint32_t flow,
+			struct rte_mbuf **pkt, uint32_t n, uint64_t *pkts_mask);
+#endif	/* MTR_HIERARCHICAL */
+
 /**
  * Update CDR records per adc per ue.
  * @param adc_ue_info
@@ -850,8 +1111,8 @@ update_bear_cdr(struct dp_sdf_per_bearer_info **sdf_bear_info,
  * Update CDR records per rating group.
  * @param sess_info
  *	list of per sdf bearer structs pointer.
- * @param  rgrp
- *	list of rating group ids, whose CDRs to be updated.
+ * @param  rg_idx
+ *	list of rating group indexes, from get_rating_grp().
  * @param  pkts
  *	mbuf pkts.
  * @param  n
@@ -865,7 +1126,7 @@ update_bear_cdr(struct dp_sdf_per_bearer_info **sdf_bear_info,
  * Void
  */
 void
-update_rating_grp_cdr(void **sess_info, uint32_t **rgrp,
+update_rating_grp_cdr(void **sess_info, uint8_t *rg_idx,
 		struct rte_mbuf **pkts, uint32_t n,
 		uint64_t *pkts_mask, uint32_t flow);
 /**
@@ -917,8 +1178,8 @@ update_adc_rid_from_domain_lookup(uint32_t *rb, uint32_t *rc, uint32_t n);
  *  list of pointers to adc_ue_info struct.
  * @param  sdf_info
  *	list of pointers to sdf flows.
- * @param  rgrp
- *	rating group list.
+ * @param  rg_idx
+ *	rating group index list, MAX_RATING_GRP for no rating group.
  * @param  n
  *	number of pkts.
  *
@@ -927,7 +1188,7 @@ update_adc_rid_from_domain_lookup(uint32_t *rb, uint32_t *rc, uint32_t n);
  */
 void
 get_rating_grp(void **adc_ue_info, void **sdf_info,
-		uint32_t **rgrp, uint32_t n);
+		uint8_t *rg_idx, uint32_t n);
 
 /**
  * Initialization of PCC Table Callback functions.
@@ -1252,6 +1513,17 @@ iface_lookup_downlink_data(struct dl_bm_key *key,
 int
 iface_lookup_downlink_bulk_data(const void **key, uint32_t n,
 		uint64_t *hit_mask, void **value);
+#ifdef UE_IPV6
+/**
+ * @brief Called by DP to do bulk lookup of key-value pair in IPv6 UE
+ * downlink look up table.
+ *
+ * This function is thread safe (Read Only).
+ */
+int
+iface_lookup_downlink6_bulk_data(const void **key, uint32_t n,
+		uint64_t *hit_mask, void **value);
+#endif /* UE_IPV6 */
 /**
  * @brief Called by DP to lookup key-value pair in adc ue look up table.
  *
@@ -1260,6 +1532,16 @@ iface_lookup_downlink_bulk_data(const void **key, uint32_t n,
 int
 iface_lookup_adc_ue_data(struct dl_bm_key *key,
 		void **value);
+
+/**
+ * @brief Called by DP to do bulk lookup of key-value pair in adc ue
+ * look up table.
+ *
+ * This function is thread safe (Read Only).
+ */
+int
+iface_lookup_adc_ue_bulk_data(const void **key, uint32_t n,
+		uint64_t *hit_mask, void **value);
 /**
  * @brief Function to return address of uplink hash table bucket, for the
  * 64 bits key.
@@ -1276,6 +1558,14 @@ struct rte_hash_bucket *bucket_ul_addr(uint64_t key);
  */
 struct rte_hash_bucket *bucket_dl_addr(uint64_t key);
 
+/**
+ * @brief Function to create hash table on a socket.
+ *
+ */
+int
+hash_create_socket(const char *name, struct rte_hash **rte_hash,
+		uint32_t entries, uint32_t key_len, int socket_id);
+
 /**
  * @brief Function to create hash table..
  *
@@ -1291,6 +1581,43 @@ hash_create(const char *name, struct rte_hash **rte_hash,
 void
 dp_table_init(void);
 
+/**
+ * @brief allocates the UE ip pool indexed downlink and adc ue tables,
+ * used ahead of the hashes when a UE ip pool is configured.
+ */
+void
+ue_pool_tables_init(void);
+
+#ifdef SHARDED_SESS_TABLE
+/**
+ * @brief creates one uplink, downlink and adc ue hash per worker, used
+ * instead of the global ones.
+ */
+void
+sess_table_shards_init(void);
+#endif	/* SHARDED_SESS_TABLE */
+
+#ifdef DEFERRED_SESS_CDR
+/** deleted bearers exported per sess_cdr_snap_drain() call */
+#define SESS_CDR_SNAP_BUDGET	8
+
+/**
+ * @brief exports the CDRs of up to budget deleted bearers, queued by
+ * dp_session_delete(). Called by the iface core.
+ */
+void
+sess_cdr_snap_drain(unsigned budget);
+#endif	/* DEFERRED_SESS_CDR */
+
+#ifdef UL_TEID_TABLE
+/**
+ * @brief allocates the TEID indexed uplink table, used ahead of the
+ * uplink hash for bearer lookup.
+ */
+void
+ul_teid_table_init(void);
+#endif	/* UL_TEID_TABLE */
+
 /**
  * @brief Called by DP to lookup key-value in ADC table.
  *
@@ -1328,6 +1655,42 @@ int iface_lookup_pcc_data(const uint32_t key32,
 int
 adc_dns_entry_add(struct msg_adc *entry);
 
+/**
+ * Add a batch of entries in ADC dns table. Entries already mapped to
+ * the same rule are skipped, the flow cache is invalidated once per
+ * batch. Safe to call from several DNS lcores.
+ * @param entry
+ *	elements to be added in this table.
+ * @param n
+ *	number of elements.
+ *
+ * @return
+ *	- 0 - success
+ *	- -1 - fail
+ */
+int
+adc_dns_entry_add_bulk(const struct msg_adc *entry, uint32_t n);
+
+#ifdef ADC_DNS_AGING
+/** TTL bounds of DNS learned ADC entries, seconds */
+#define ADC_DNS_TTL_MIN		30
+#define ADC_DNS_TTL_MAX		(24 * 3600)
+/** Entries visited per adc_dns_age_poll() call */
+#define ADC_DNS_AGE_BUDGET	256
+
+/**
+ * Remove the ADC dns entries whose TTL ran out, visiting at most budget
+ * entries. Called by the DNS lcores, only one of them ages at a time.
+ * @param budget
+ *	max entries visited.
+ *
+ * @return
+ *	None
+ */
+void
+adc_dns_age_poll(unsigned budget);
+#endif	/* ADC_DNS_AGING */
+
 /**
  * Delete entry in ADC dns table.
  * This function is thread safe due to message queue implementation.
@@ -1349,8 +1712,8 @@ adc_dns_entry_delete(struct msg_adc *entry);
  *	index map structure.
  *
  * @return
- *	- 0  on success
- *	- -1 on failure
+ *	- index of rating group, MAX_RATING_GRP if rg_val is 0
+ *	- -1 if the map is full
  */
 int
 add_rg_idx(uint32_t rg_val, struct rating_group_index_map *rg_idx_map);
@@ -1378,11 +1741,180 @@ add_rg_idx(uint32_t rg_val, struct rating_group_index_map *rg_idx_map);
 int
 dp_ue_cdr_flush(struct dp_id dp_id,	struct msg_ue_cdr *ue_cdr);
 
+/**
+ * @brief Function to export the UE CDRs of every session in a set of
+ *	session id ranges. Ranges of up to UE_CDR_RANGE_LOOKUP_MAX ids
+ *	are looked up id by id, larger ones with one walk of the session
+ *	table.
+ *
+ * @param dp_id
+ *  table identifier.
+ * @param ue_cdr
+ *	cdr type and action, as in struct msg_ue_cdr, and the ranges.
+ *
+ * @return
+ *  - 0 on success
+ *  - -1 on failure
+ */
+int
+dp_ue_cdr_flush_bulk(struct dp_id dp_id, struct msg_ue_cdr_bulk *ue_cdr);
+
+/** ids of a bulk CDR flush range looked up one by one */
+#define UE_CDR_RANGE_LOOKUP_MAX	4096
+
+#ifdef INTERIM_CDR
+/** sessions exported per interim_cdr_poll() call */
+#define INTERIM_CDR_BUDGET	32
+
+/**
+ * @brief exports the CDRs of up to budget sessions of the running
+ * interim CDR round. A round walks the whole session table and starts
+ * every app.interim_cdr_sec seconds. Called by the iface core.
+ */
+void
+interim_cdr_poll(unsigned budget);
+#endif	/* INTERIM_CDR */
+
+#ifdef SESS_AGING
+/** sessions checked per sess_age_poll() call */
+#define SESS_AGE_BUDGET	32
+
+/**
+ * Session aging counters, written by the iface core.
+ */
+struct sess_age_stats {
+	uint64_t rounds;	/**< completed walks of the session table */
+	uint32_t idle;		/**< connected bearers idle in the last round */
+	uint64_t reported;	/**< bearers reported idle */
+	uint64_t reclaimed;	/**< bearers deleted after sess_reclaim_sec */
+};
+
+extern struct sess_age_stats sess_age_stats;
+
+/** Aging clock in seconds, each pkt stamps its bearer with it */
+extern volatile uint32_t sess_age_now;
+
+/**
+ * @brief advances the aging clock and checks up to budget sessions of
+ * the running round for inactivity. Connected bearers idle for
+ * app.sess_idle_sec are reported once, bearers idle for
+ * app.sess_reclaim_sec are deleted. A round walks the whole session
+ * table, at most one starts per second. Called by the iface core.
+ */
+void
+sess_age_poll(unsigned budget);
+#endif	/* SESS_AGING */
+
+/** sessions re-evaluated per sess_fast_path_poll() call */
+#define SESS_FAST_PATH_BUDGET	64
+
+/** Generation of the PCC and SDF rules the fast path flags hold for */
+extern volatile uint32_t sess_fast_path_gen;
+
+/**
+ * @brief Called on a change of the PCC or SDF rules: drops the default
+ * bearer fast path flag of every bearer at once and starts their
+ * re-evaluation by sess_fast_path_poll(). Called by the iface core.
+ */
+void
+sess_fast_path_rules_changed(void);
+
+/**
+ * @brief Re-evaluates the default bearer fast path flag of up to budget
+ * bearers after a change of the rules. Called by the iface core.
+ */
+void
+sess_fast_path_poll(unsigned budget);
+
 struct dp_session_info *
 get_session_data(uint64_t sess_id, uint32_t is_mod);
 
 
 /***********************ddn_utils.c functions start**********************/
+#ifdef DDN_BUF_POOL
+/**
+ * Paging buffer of a session: list of DL pkts linked through
+ * mbuf userdata, taken from the pool of the session worker.
+ */
+struct ddn_buf {
+	struct rte_mbuf *head;		/** oldest pkt */
+	struct rte_mbuf *tail;		/** newest pkt */
+	uint32_t pkts;			/** pkts buffered */
+	uint32_t bytes;			/** bytes buffered */
+	struct rte_mempool *mp;		/** pool of the buffer */
+	uint8_t queued;			/** on the worker release queue */
+};
+
+/** dp_session_info.ddn_buf of a session being deleted */
+#define DDN_BUF_CLOSED	((struct ddn_buf *)1)
+
+/** pkts dropped with the paging buffers of deleted sessions */
+extern uint64_t ddn_buf_deleted;
+/** pkts in the paging buffers of all the workers */
+extern volatile uint32_t ddn_buf_pkts;
+
+/**
+ * @brief Create the paging buffer pool of a worker.
+ *
+ * @param wk_params
+ * Worker params.
+ * @param core
+ * Worker core, used to name the pool.
+ *
+ * @return
+ *  void
+ */
+void
+ddn_buf_pool_init(struct epc_worker_params *wk_params, int core);
+
+/**
+ * @brief Queue the paging buffer of a session for release, once the
+ * session is connected again. Called by the session worker.
+ *
+ * @param wk_params
+ * Worker params.
+ * @param si
+ * Session.
+ *
+ * @return
+ *  void
+ */
+void
+ddn_buf_release_queue(struct epc_worker_params *wk_params,
+		struct dp_session_info *si);
+
+/**
+ * @brief Send up to budget buffered pkts of the queued sessions, up to
+ * MAX_BURST_SZ per session in turn. DL pkts of a session keep going to
+ * its paging buffer until it is empty, so they leave in order. Called
+ * by the worker once per run.
+ *
+ * @param wk_params
+ * Worker params.
+ * @param budget
+ * Max pkts to send.
+ *
+ * @return
+ *  void
+ */
+void
+ddn_buf_release_run(struct epc_worker_params *wk_params, uint32_t budget);
+
+/**
+ * @brief Close the paging buffer of a session being deleted. Buffered
+ * pkts are dropped after a QSBR grace period, pkts arriving later are
+ * dropped by the worker. Called by the iface core.
+ *
+ * @param si
+ * Session.
+ *
+ * @return
+ *  void
+ */
+void
+ddn_buf_close(struct dp_session_info *si);
+#endif	/* DDN_BUF_POOL */
+
 /**
  * @brief Enqueue the downlink packets based upon the mask.
  *
@@ -1483,6 +2015,22 @@ int
 filter_pcc_entry_lookup(enum filter_pcc_type type, uint32_t *rule_ids,
 		uint32_t n, struct pcc_id_precedence *pcc_info);
 
+/**
+ * Recompute the highest precedence PCC of the SDF/ADC rules of PCC rules
+ * whose precedence or gate status changed. The filters of each entry
+ * must be the ones it was added with.
+ * @param entries
+ *	PCC rules with their new precedence and gate status.
+ * @param  n
+ *	Number of PCC rules.
+ *
+ * @return
+ *	0 - on success
+ *	-1 - on failure
+ */
+int
+filter_pcc_precedence_update(struct pcc_rules *entries, uint32_t n);
+
 /**
  * update nexthop info.
  * @param pkts
@@ -1513,6 +2061,25 @@ void
 update_enb_info(struct rte_mbuf **pkts, uint32_t n,
 		uint64_t *pkts_mask, struct dp_sdf_per_bearer_info **sess_info);
 
+#ifdef EGRESS_QOS
+/**
+ * Set the egress scheduler path of pkts from their bearer: eNB subport,
+ * UE pipe, QCI traffic class and ARP queue. Pkts with no bearer are
+ * best effort.
+ * @param pkts
+ *	pointer to mbuf of packets.
+ * @param n
+ *	number of pkts.
+ * @param pkts_mask
+ *	bit mask to process the pkts.
+ * @param sess_info
+ *	pointer to session bear info
+ */
+void
+egress_qos_classify(struct rte_mbuf **pkts, uint32_t n,
+		uint64_t *pkts_mask, struct dp_sdf_per_bearer_info **sess_info);
+#endif	/* EGRESS_QOS */
+
 #ifdef PCAP_GEN
 /**
  * initialize pcap dumper.
@@ -1537,5 +2104,59 @@ void dump_pcap(struct rte_mbuf **pkts, uint32_t n,
 #endif /* PCAP_GEN */
 
 /***********************ddn_utils.c functions end**********************/
+
+#ifdef PKT_LATENCY
+/**
+ * Stamp the rx TSC into the metadata of a received burst.
+ *
+ * @param pkts
+ *	Received packets
+ * @param n
+ *	Number of packets
+ */
+static inline void epc_latency_stamp(struct rte_mbuf **pkts, uint32_t n)
+{
+	uint64_t now = rte_rdtsc();
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		struct epc_meta_data *meta_data =
+			(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(
+					pkts[i], META_DATA_OFFSET);
+
+		meta_data->rx_tsc = now;
+	}
+}
+
+/**
+ * Sample the rx to tx latency of a burst about to be transmitted.
+ *
+ * @param h
+ *	Histogram to update
+ * @param pkts
+ *	Packets to transmit
+ * @param n
+ *	Number of packets
+ */
+static inline void
+epc_latency_sample(struct epc_latency_hist *h, struct rte_mbuf **pkts,
+		uint32_t n)
+{
+	uint64_t now = rte_rdtsc();
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		struct epc_meta_data *meta_data =
+			(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(
+					pkts[i], META_DATA_OFFSET);
+		uint64_t lat = now - meta_data->rx_tsc;
+
+		h->hist[epc_latency_bucket(lat)]++;
+		if (lat > h->max)
+			h->max = lat;
+	}
+	h->count += n;
+}
+#endif	/* PKT_LATENCY */
 #endif /* _MAIN_H_ */
 
@@ -16,7 +16,6 @@
 
 #define _GNU_SOURCE     /* Expose declaration of strptime() */
 #include <time.h>
-#include <openssl/md5.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <dirent.h>
@@ -215,35 +214,68 @@ parse_records(FILE *file,
 	return EXIT_SUCCESS;
 }
 
+void
+cdr_file_summary_init(struct cdr_file_summary *s, const char *filename)
+{
+	memset(s, 0, sizeof(*s));
+	snprintf(s->filename, sizeof(s->filename), "%s", filename);
+	if (MD5_Init(&s->md5) != 1)
+		rte_panic("MD5 Init failed for file %s\n", filename);
+}
+
+/**
+ * Fill master entry from the summary kept while writing the file.
+ */
+static void
+summary_master_entry(struct cdr_file_summary *s,
+		struct master_file_entry_t *master_entry)
+{
+	MD5_CTX md5_context = s->md5;
+
+	MD5_Final(master_entry->md5_digest, &md5_context);
+	master_entry->num_entries = s->num_entries;
+	gmtime_r(&s->start, &master_entry->start_tm);
+	gmtime_r(&s->end, &master_entry->end_tm);
+}
+
 static void
 create_master_entry(FILE *master_file,
 		const char *old_filename,
-		const char *new_filename)
+		const char *new_filename,
+		struct cdr_file_summary *cur)
 {
 	struct stat statbuf;
 	static struct master_file_entry_t master_entry;
 	int ret;
 	unsigned i;
 	memset(&master_entry, 0, sizeof(struct master_file_entry_t));
-	ret = stat(old_filename, &statbuf);
-	FILE *file = fopen(old_filename, "r");
-	if (file == NULL) {
-		printf("Unable to open %s to finalize record\n", old_filename);
-		return;
-	}
-	ret = parse_records(file, &master_entry);
-	if (ret != EXIT_SUCCESS) {
-		fprintf(stderr, "Failed to parse records of %s "
-				"(%s:%u)\n",
-				old_filename, __FILE__, __LINE__);
-		return;
-	}
-	ret = calc_md5(file, statbuf.st_size, &master_entry);
-	if (ret != EXIT_SUCCESS) {
-		fprintf(stderr, "Failed to calculate MD5 of %s "
-				"(%s:%u)\n",
-				old_filename, __FILE__, __LINE__);
-		return;
+	if (cur && strcmp(old_filename, cur->filename) == 0) {
+		/* written by us, no need to read it back */
+		summary_master_entry(cur, &master_entry);
+	} else {
+		ret = stat(old_filename, &statbuf);
+		FILE *file = fopen(old_filename, "r");
+		if (file == NULL) {
+			printf("Unable to open %s to finalize record\n",
+					old_filename);
+			return;
+		}
+		ret = parse_records(file, &master_entry);
+		if (ret != EXIT_SUCCESS) {
+			fprintf(stderr, "Failed to parse records of %s "
+					"(%s:%u)\n",
+					old_filename, __FILE__, __LINE__);
+			fclose(file);
+			return;
+		}
+		ret = calc_md5(file, statbuf.st_size, &master_entry);
+		fclose(file);
+		if (ret != EXIT_SUCCESS) {
+			fprintf(stderr, "Failed to calculate MD5 of %s "
+					"(%s:%u)\n",
+					old_filename, __FILE__, __LINE__);
+			return;
+		}
 	}
 
 
@@ -277,7 +309,7 @@ create_master_dir(void)
 }
 
 void
-finalize_cur_cdrs(const char *cdr_path)
+finalize_cur_cdrs(const char *cdr_path, struct cdr_file_summary *cur)
 {
 	char old_filename[PATH_MAX];
 	char new_filename[PATH_MAX];
@@ -326,7 +358,8 @@ finalize_cur_cdrs(const char *cdr_path)
 		if (ret > PATH_MAX || ret < 0)
 			fprintf(stderr, "Failed to finalize %s (%s:%u)\n",
 					dir_entry->d_name, __FILE__, __LINE__);
-		create_master_entry(master_file, old_filename, new_filename);
+		create_master_entry(master_file, old_filename, new_filename,
+				cur);
 	}
 	if (errno)
 		rte_panic("Failed to scan cdr_path to finalize old records:"
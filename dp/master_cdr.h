@@ -21,8 +21,68 @@
  * This file contains function prototypes for the CDR master record
  */
 
+#include <limits.h>
+#include <time.h>
+#include <openssl/md5.h>
+
 #include "cdr.h"
 
+/**
+ * Master record of the CDR file being written, kept up to date as
+ * records are written so that the file is finalized without reading it
+ * back.
+ */
+struct cdr_file_summary {
+	char filename[PATH_MAX];	/** path of the .cur file */
+	MD5_CTX md5;			/** MD5 of the bytes written so far */
+	uint32_t num_entries;
+	time_t start;
+	time_t end;
+};
+
+/**
+ * Start the summary of a new CDR file.
+ * @param s
+ *	summary.
+ * @param filename
+ *	path of the .cur file.
+ */
+void
+cdr_file_summary_init(struct cdr_file_summary *s, const char *filename);
+
+/**
+ * Account bytes written to the CDR file.
+ * @param s
+ *	summary.
+ * @param buf
+ *	bytes written.
+ * @param len
+ *	number of bytes.
+ */
+static inline void
+cdr_file_summary_update(struct cdr_file_summary *s, const void *buf,
+		size_t len)
+{
+	MD5_Update(&s->md5, buf, len);
+}
+
+/**
+ * Account a record written to the CDR file.
+ * @param s
+ *	summary.
+ * @param t
+ *	time of the record.
+ */
+static inline void
+cdr_file_summary_add(struct cdr_file_summary *s, time_t t)
+{
+	if (s->num_entries == 0 || t < s->start)
+		s->start = t;
+	if (s->num_entries == 0 || t > s->end)
+		s->end = t;
+	s->num_entries++;
+}
+
 
 /**
  * sets the master cdr file
@@ -34,9 +94,12 @@ set_master_cdr_file(const char *master_cdr_file);
 /**
  * finalizes *.cur cdr files into *.csv and records into the master cdr file
  * @param cdr_path
+ * @param cur
+ *	summary of the file written by this process, NULL if none. Other
+ *	*.cur files, left by an earlier run, are read back.
  */
 void
-finalize_cur_cdrs(const char *cdr_path);
+finalize_cur_cdrs(const char *cdr_path, struct cdr_file_summary *cur);
 
 /**
  * @brief frees all memory allocated by master_cdr.c
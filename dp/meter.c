@@ -21,10 +21,12 @@
 #include <rte_mempool.h>
 #include <rte_ethdev.h>
 #include <rte_cycles.h>
+#include <rte_spinlock.h>
 
 #include "main.h"
 #include "meter.h"
 #include "interface.h"
+#include "sess_store.h"
 
 #define APP_PKT_FLOW_POS                33
 #define APP_PKT_COLOR_DSCP              15
@@ -41,7 +43,11 @@
 #define APP_MODE_TRTCM_COLOR_BLIND      3
 #define APP_MODE_TRTCM_COLOR_AWARE      4
 
+#ifdef MTR_TRTCM
+#define APP_MODE	APP_MODE_TRTCM_COLOR_BLIND
+#else
 #define APP_MODE	APP_MODE_SRTCM_COLOR_BLIND
+#endif /* MTR_TRTCM */
 
 #if APP_MODE == APP_MODE_FWD
 
@@ -49,7 +55,6 @@
 			pkt_len = pkt_len, time = time)
 #define FUNC_CONFIG(a, b)
 #define PARAMS	app_srtcm_params
-#define FLOW_METER int
 
 #elif APP_MODE == APP_MODE_SRTCM_COLOR_BLIND
 
@@ -57,7 +62,6 @@
 #define FUNC_CONFIG   rte_meter_srtcm_config
 #define PARAMS        app_srtcm_params
 #define PARAMS_AMBR   ambr_srtcm_params
-#define FLOW_METER    struct rte_meter_srtcm
 
 #elif (APP_MODE == APP_MODE_SRTCM_COLOR_AWARE)
 
@@ -65,7 +69,6 @@
 #define FUNC_CONFIG   rte_meter_srtcm_config
 #define PARAMS        app_srtcm_params
 #define PARAMS_AMBR   ambr_srtcm_params
-#define FLOW_METER    struct rte_meter_srtcm
 
 #elif (APP_MODE == APP_MODE_TRTCM_COLOR_BLIND)
 
@@ -73,7 +76,6 @@
 #define FUNC_CONFIG  rte_meter_trtcm_config
 #define PARAMS       app_trtcm_params
 #define PARAMS_AMBR   ambr_trtcm_params
-#define FLOW_METER   struct rte_meter_trtcm
 
 #elif (APP_MODE == APP_MODE_TRTCM_COLOR_AWARE)
 
@@ -81,12 +83,41 @@
 #define FUNC_CONFIG  rte_meter_trtcm_config
 #define PARAMS       app_trtcm_params
 #define PARAMS_AMBR   ambr_trtcm_params
-#define FLOW_METER   struct rte_meter_trtcm
 
 #else
 #error Invalid value for APP_MODE
 #endif
 
+#if defined(MTR_HIERARCHICAL) && (APP_MODE != APP_MODE_SRTCM_COLOR_BLIND) \
+	&& (APP_MODE != APP_MODE_TRTCM_COLOR_BLIND)
+#error "MTR_HIERARCHICAL needs a color blind APP_MODE"
+#endif
+
+#ifdef APN_MTR_SHARDED
+#if (APP_MODE != APP_MODE_SRTCM_COLOR_BLIND) \
+	&& (APP_MODE != APP_MODE_TRTCM_COLOR_BLIND)
+#error "APN_MTR_SHARDED needs a color blind APP_MODE"
+#endif
+#ifdef MTR_HIERARCHICAL
+#error "APN_MTR_SHARDED and MTR_HIERARCHICAL are exclusive"
+#endif
+
+/** APN credit entries of each worker, power of 2 */
+#define APN_MTR_CREDITS		(1 << 10)
+
+/** Max bytes borrowed from the APN budget at once */
+#define APN_MTR_QUANTUM		(16 * 1024)
+
+/** Lifetime of borrowed bytes, unused bytes go back to the APN budget */
+#define APN_MTR_CREDIT_US	1000
+#endif /* APN_MTR_SHARDED */
+
+/** Max meters refreshed once per burst, others are refreshed per pkt */
+#define MTR_BURST_METERS	16
+
+/** Max levels of the hierarchical meter chain: SDF, bearer, APN */
+#define MTR_LEVELS		3
+
 enum policer_action {
 	GREEN = e_RTE_METER_GREEN,
 	YELLOW = e_RTE_METER_YELLOW,
@@ -95,11 +126,21 @@ enum policer_action {
 };
 struct mtr_table {
 	char name[MAX_LEN];
-	struct rte_meter_srtcm_params *params;
+	struct mtr_params *params;
 	uint16_t num_entries;
 	uint16_t max_entries;
 };
 
+/**
+ * Meters of a burst. Buckets are refilled once per burst, for a single
+ * TSC read, then each pkt is checked against the buckets only.
+ */
+struct mtr_burst {
+	uint64_t time;			/** TSC of burst, 0 until first use */
+	uint32_t n;			/** number of refreshed meters */
+	FLOW_METER *m[MTR_BURST_METERS];	/** refreshed meters */
+};
+
 static enum policer_action policer_table[e_RTE_METER_COLORS][e_RTE_METER_COLORS] = {
 	{GREEN, YELLOW, RED},
 	{DROP, YELLOW, RED},
@@ -126,34 +167,207 @@ app_set_pkt_color(uint8_t *pkt_data, enum policer_action color)
 	pkt_data[APP_PKT_COLOR_POS] = (uint8_t) color;
 }
 
+/**
+ * TSC the buckets of meter were last refilled at.
+ */
+static inline uint64_t
+mtr_time(const FLOW_METER *m)
+{
+#ifdef MTR_TRTCM
+	return RTE_MAX(m->time_tc, m->time_tp);
+#else
+	return m->time;
+#endif /* MTR_TRTCM */
+}
+
+/**
+ * Refill the buckets of meter up to the burst TSC, once per burst.
+ *
+ * @param b
+ *	burst meters.
+ * @param m
+ *	meter object.
+ *
+ * @return
+ *	None
+ */
+static inline void
+mtr_burst_refresh(struct mtr_burst *b, FLOW_METER *m)
+{
+	uint32_t i;
+
+	if (b->time == 0)
+		b->time = rte_rdtsc();
+
+	for (i = 0; i < b->n; i++)
+		if (b->m[i] == m)
+			return;
+
+	/* A zero length check only refills the buckets. Other workers
+	 * sharing the meter may have refilled it with a later TSC. */
+	if (b->time > mtr_time(m))
+		FUNC_METER(m, b->time, 0, e_RTE_METER_GREEN);
+	if (b->n < MTR_BURST_METERS)
+		b->m[b->n++] = m;
+}
+
+#if (APP_MODE == APP_MODE_SRTCM_COLOR_BLIND)
+/**
+ * Color of pkt on a refreshed meter, same as
+ * rte_meter_srtcm_color_blind_check() with no elapsed time.
+ */
+static inline enum rte_meter_color
+mtr_color(struct mtr_burst *b, FLOW_METER *m, uint32_t pkt_len,
+		enum rte_meter_color input_color)
+{
+	RTE_SET_USED(b);
+	RTE_SET_USED(input_color);
+
+	if (m->tc >= pkt_len) {
+		m->tc -= pkt_len;
+		return e_RTE_METER_GREEN;
+	}
+	if (m->te >= pkt_len) {
+		m->te -= pkt_len;
+		return e_RTE_METER_YELLOW;
+	}
+	return e_RTE_METER_RED;
+}
+
+/**
+ * Check that pkt is green on a refreshed meter, without using tokens.
+ */
+static inline int
+mtr_conform(const FLOW_METER *m, uint32_t pkt_len)
+{
+	return m->tc >= pkt_len;
+}
+
+/**
+ * Use tokens of a green pkt.
+ */
+static inline void
+mtr_debit(FLOW_METER *m, uint32_t pkt_len)
+{
+	m->tc -= pkt_len;
+}
+
+/**
+ * Bytes that can be sent green on a refreshed meter.
+ */
+static inline uint64_t
+mtr_tokens(const FLOW_METER *m)
+{
+	return m->tc;
+}
+
+/**
+ * Give back unused tokens, up to the bucket size.
+ */
+static inline void
+mtr_refund(FLOW_METER *m, uint64_t tokens)
+{
+	m->tc = RTE_MIN(m->tc + tokens, m->cbs);
+}
+#elif (APP_MODE == APP_MODE_TRTCM_COLOR_BLIND)
+/**
+ * Color of pkt on a refreshed meter, same as
+ * rte_meter_trtcm_color_blind_check() with no elapsed time.
+ */
+static inline enum rte_meter_color
+mtr_color(struct mtr_burst *b, FLOW_METER *m, uint32_t pkt_len,
+		enum rte_meter_color input_color)
+{
+	RTE_SET_USED(b);
+	RTE_SET_USED(input_color);
+
+	if (m->tp < pkt_len)
+		return e_RTE_METER_RED;
+	if (m->tc < pkt_len) {
+		m->tp -= pkt_len;
+		return e_RTE_METER_YELLOW;
+	}
+	m->tp -= pkt_len;
+	m->tc -= pkt_len;
+	return e_RTE_METER_GREEN;
+}
+
+/**
+ * Check that pkt is green on a refreshed meter, without using tokens.
+ */
+static inline int
+mtr_conform(const FLOW_METER *m, uint32_t pkt_len)
+{
+	return (m->tp >= pkt_len) && (m->tc >= pkt_len);
+}
+
+/**
+ * Use tokens of a green pkt.
+ */
+static inline void
+mtr_debit(FLOW_METER *m, uint32_t pkt_len)
+{
+	m->tp -= pkt_len;
+	m->tc -= pkt_len;
+}
+
+/**
+ * Bytes that can be sent green on a refreshed meter.
+ */
+static inline uint64_t
+mtr_tokens(const FLOW_METER *m)
+{
+	return RTE_MIN(m->tc, m->tp);
+}
+
+/**
+ * Give back unused tokens, up to the bucket sizes.
+ */
+static inline void
+mtr_refund(FLOW_METER *m, uint64_t tokens)
+{
+	m->tc = RTE_MIN(m->tc + tokens, m->cbs);
+	m->tp = RTE_MIN(m->tp + tokens, m->pbs);
+}
+#else
+/**
+ * Color of pkt, color aware modes go through the library check.
+ */
+static inline enum rte_meter_color
+mtr_color(struct mtr_burst *b, FLOW_METER *m, uint32_t pkt_len,
+		enum rte_meter_color input_color)
+{
+	return FUNC_METER(m, b->time, pkt_len, input_color);
+}
+#endif /* APP_MODE */
+
 /**
  * Process the packet to get action
  *
+ * @param b
+ *	burst meters.
+ * @param m
+ *	meter context
  * @param pkt
  *	mbuf pointer
- * @param time
- * @param m
- *	srtcm context
  *
  * @return
  *	int - action to be performed on the packet
  */
-static int
-app_pkt_handle(struct rte_meter_srtcm *m, struct rte_mbuf *pkt,
-				uint64_t time)
+static inline int
+app_pkt_handle(struct mtr_burst *b, FLOW_METER *m, struct rte_mbuf *pkt)
 {
 	uint8_t input_color, output_color;
 	uint8_t *pkt_data = rte_pktmbuf_mtod(pkt, uint8_t *);
 	uint32_t pkt_len = rte_pktmbuf_pkt_len(pkt) - sizeof(struct ether_hdr);
 	enum policer_action action;
 
+	mtr_burst_refresh(b, m);
+
 	input_color = pkt_data[APP_PKT_COLOR_POS] & 0x3;
 	/* color input is not used for blind modes */
-	output_color =
-		(uint8_t) FUNC_METER(m,
-				 time,
-				 pkt_len,
-				 (enum rte_meter_color)input_color);
+	output_color = (uint8_t) mtr_color(b, m, pkt_len,
+				(enum rte_meter_color)input_color);
 
 	/* Apply policing and set the output color */
 	action = policer_table[input_color][output_color];
@@ -183,7 +397,7 @@ mtr_table_create(struct mtr_table *mtr_tbl,
 	mtr_tbl->max_entries = max_entries;
 	strncpy(mtr_tbl->name, table_name, MAX_LEN);
 	mtr_tbl->params = rte_zmalloc("params",
-			sizeof(struct rte_meter_srtcm_params) * max_entries,
+			sizeof(struct mtr_params) * max_entries,
 			RTE_CACHE_LINE_SIZE);
 	if (mtr_tbl->params == NULL)
 		rte_panic("Meter table memory alloc fail");
@@ -224,7 +438,7 @@ static void
 mtr_add_entry(struct mtr_table *mtr_tbl,
 		uint16_t mtr_profile_index, struct mtr_params *mtr_param)
 {
-	struct rte_meter_srtcm_params *app_srtcm_params;
+	struct mtr_params *params;
 
 	if (mtr_tbl->num_entries == mtr_tbl->max_entries) {
 		printf("MTR: Max entries reached\n");
@@ -235,15 +449,13 @@ mtr_add_entry(struct mtr_table *mtr_tbl,
 		return;
 	}
 
-	app_srtcm_params = &mtr_tbl->params[mtr_profile_index];
-	app_srtcm_params->cir = mtr_param->cir;
-	app_srtcm_params->cbs = mtr_param->cbs;
-	app_srtcm_params->ebs = mtr_param->ebs;
+	params = &mtr_tbl->params[mtr_profile_index];
+	*params = *mtr_param;
 	mtr_tbl->num_entries++;
 	RTE_LOG(INFO, DP, "MTR_PROFILE ADD: index %d cir:%lu,"
-			" cbs:%lu, ebs:%lu\n",
-			mtr_profile_index, app_srtcm_params->cir,
-			app_srtcm_params->cbs, app_srtcm_params->ebs);
+			" cbs:%lu, ebs:%lu, pir:%lu, pbs:%lu\n",
+			mtr_profile_index, params->cir,
+			params->cbs, params->ebs, params->pir, params->pbs);
 }
 
 /**
@@ -260,36 +472,58 @@ mtr_add_entry(struct mtr_table *mtr_tbl,
 static void
 mtr_del_entry(struct mtr_table *mtr_tbl, uint16_t mtr_profile_index)
 {
-	struct rte_meter_srtcm_params *app_srtcm_params;
-
 	if (mtr_profile_index >= mtr_tbl->max_entries) {
 		printf("MTR: profile id greater than max entries\n");
 		return;
 	}
 
-	app_srtcm_params = &mtr_tbl->params[mtr_profile_index];
-	app_srtcm_params->cir = 0;
-	app_srtcm_params->cbs = 0;
-	app_srtcm_params->ebs = 0;
+	memset(&mtr_tbl->params[mtr_profile_index], 0,
+			sizeof(struct mtr_params));
 	mtr_tbl->num_entries--;
 }
 
 int
-mtr_cfg_entry(int msg_id, struct rte_meter_srtcm *msg_payload)
+mtr_cfg_entry(int msg_id, FLOW_METER *msg_payload)
 {
-	struct rte_meter_srtcm *m;
+	FLOW_METER *m;
 	struct mtr_table *mtr_tbl = &mtr_profile_tbl;
-	struct rte_meter_srtcm_params *app_srtcm_params =
-					&mtr_tbl->params[msg_id];
-	m = (struct rte_meter_srtcm *)msg_payload;
+	struct mtr_params *params;
+	int ret;
+	m = msg_payload;
 	/* NOTE: rte_malloc will be replaced by simple ring_alloc in future*/
 
-	if ((msg_id == 0) || (app_srtcm_params->cir == 0)) {
-		memset(m, 0, sizeof(struct rte_meter_srtcm));
+	if ((msg_id <= 0) || (msg_id >= mtr_tbl->max_entries)
+			|| (mtr_tbl->params[msg_id].cir == 0)) {
+		memset(m, 0, sizeof(FLOW_METER));
+		return -1;
+	}
+	params = &mtr_tbl->params[msg_id];
+
+#ifdef MTR_TRTCM
+	/* Profiles with no peak rate police at CIR with a CBS + EBS peak
+	 * bucket, close to the srTCM profile. */
+	struct rte_meter_trtcm_params app_trtcm_params = {
+		.cir = params->cir,
+		.pir = (params->pir) ? params->pir : params->cir,
+		.cbs = params->cbs,
+		.pbs = (params->pir) ? params->pbs : params->cbs + params->ebs,
+	};
+
+	ret = FUNC_CONFIG(m, &PARAMS);
+#else
+	struct rte_meter_srtcm_params app_srtcm_params = {
+		.cir = params->cir,
+		.cbs = params->cbs,
+		.ebs = params->ebs,
+	};
+
+	ret = FUNC_CONFIG(m, &PARAMS);
+#endif /* MTR_TRTCM */
+	if (ret) {
+		RTE_LOG(ERR, DP, "Invalid MTR profile %d\n", msg_id);
+		memset(m, 0, sizeof(FLOW_METER));
 		return -1;
 	}
-
-	rte_meter_srtcm_config(m, &mtr_tbl->params[msg_id]);
 
 	RTE_LOG(DEBUG, DP, "Configuring MTR index %d\n", msg_id);
 	if ((m)->cir_period == 0)
@@ -302,12 +536,11 @@ sdf_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info,
 			void **adc_ue_info, uint64_t *adc_pkts_mask,
 			struct rte_mbuf **pkt, uint32_t n, uint64_t *pkts_mask)
 {
-	uint64_t current_time;
-	struct rte_meter_srtcm *m;
+	struct mtr_burst b = {.time = 0, .n = 0};
+	FLOW_METER *m;
 	uint32_t i;
 	struct dp_sdf_per_bearer_info *psdf;
 	struct dp_adc_ue_info *adc_ue;
-	struct qos_info *qos;
 	enum policer_action action;
 
 	for (i = 0; i < n; i++) {
@@ -315,19 +548,17 @@ sdf_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info,
 			continue;
 		psdf = (struct dp_sdf_per_bearer_info *)sdf_info[i];
 		adc_ue = adc_ue_info[i];
-		qos = &psdf->pcc_info.qos;
 		if (adc_ue)
 			m = &adc_ue->mtr_obj;
 		else
 			m = &psdf->sdf_mtr_obj;
 
-		current_time = rte_rdtsc();
 		if (m->cir_period == 0) {
 			RTE_LOG(DEBUG, DP, "SDF: Either MTR not found or"
 				" MTR not configured!!!\n");
 			continue;
 		}
-		action = app_pkt_handle(m, pkt[i], current_time);
+		action = app_pkt_handle(&b, m, pkt[i]);
 		if ((action == RED)
 			|| (action == YELLOW)
 			|| (action == DROP)) {
@@ -351,12 +582,134 @@ is_qci_gbr(struct qos_info *qos, uint32_t flow)
 	return FALSE;
 }
 
+#ifdef APN_MTR_SHARDED
+/**
+ * Bytes of an APN budget borrowed by one worker.
+ */
+struct apn_mtr_credit {
+	const struct ue_session_info *ue;	/** owner, NULL if unused */
+	uint32_t gen;				/** apn_mtr_gen of owner */
+	uint32_t flow;				/** UL_FLOW or DL_FLOW */
+	uint32_t tokens;			/** bytes left */
+	uint64_t expiry;			/** TSC the bytes expire at */
+};
+
+/** APN credits of each worker lcore, allocated on first use */
+static struct apn_mtr_credit *apn_mtr_credit_tbl[RTE_MAX_LCORE];
+
+/**
+ * Get APN credit of UE on calling lcore. An entry of another UE is
+ * taken over and its bytes are forfeited, as that UE may be gone. A UE
+ * context freed and reused at the same address has a new apn_mtr_gen,
+ * so it does not get the bytes of the old one.
+ *
+ * @return
+ *	credit, NULL if the lcore table can not be allocated.
+ */
+static inline struct apn_mtr_credit *
+apn_mtr_credit_get(const struct ue_session_info *ue, uint32_t flow)
+{
+	unsigned lcore_id = rte_lcore_id();
+	struct apn_mtr_credit *tbl = apn_mtr_credit_tbl[lcore_id];
+	struct apn_mtr_credit *c;
+
+	if (unlikely(tbl == NULL)) {
+		tbl = rte_zmalloc_socket("apn_mtr_credit",
+				sizeof(struct apn_mtr_credit) * APN_MTR_CREDITS,
+				RTE_CACHE_LINE_SIZE, rte_socket_id());
+		if (tbl == NULL)
+			return NULL;
+		apn_mtr_credit_tbl[lcore_id] = tbl;
+	}
+
+	c = &tbl[(((uintptr_t)ue / RTE_CACHE_LINE_SIZE) * 2 + flow)
+			& (APN_MTR_CREDITS - 1)];
+	if ((c->ue != ue) || (c->gen != ue->apn_mtr_gen)
+			|| (c->flow != flow)) {
+		c->ue = ue;
+		c->gen = ue->apn_mtr_gen;
+		c->flow = flow;
+		c->tokens = 0;
+		c->expiry = 0;
+	}
+	return c;
+}
+
+/**
+ * Check pkt against the APN budget shared by all workers. Workers use
+ * bytes borrowed in advance and take the UE lock only to borrow again,
+ * so the meter of the UE is written once per quantum, not per pkt.
+ *
+ * @param b
+ *	burst meters.
+ * @param ue
+ *	UE of pkt.
+ * @param m
+ *	APN meter of UE, the global budget.
+ * @param flow
+ *	UL_FLOW or DL_FLOW.
+ * @param pkt_len
+ *	bytes to send.
+ *
+ * @return
+ *	- 1 if pkt conforms
+ *	- 0 otherwise
+ */
+static inline int
+apn_mtr_shard_conform(struct mtr_burst *b, struct ue_session_info *ue,
+		FLOW_METER *m, uint32_t flow, uint32_t pkt_len)
+{
+	struct apn_mtr_credit *c = apn_mtr_credit_get(ue, flow);
+	struct apn_mtr_credit none = {.ue = ue, .gen = ue->apn_mtr_gen,
+			.flow = flow};
+	uint64_t quantum, avail, grant;
+
+	if (b->time == 0)
+		b->time = rte_rdtsc();
+
+	if (unlikely(c == NULL))
+		c = &none;	/* borrow per pkt */
+
+	if ((c->tokens >= pkt_len) && (b->time < c->expiry)) {
+		c->tokens -= pkt_len;
+		return 1;
+	}
+
+	/* Share the bucket between the workers, so one worker can not
+	 * hold all of it. */
+	quantum = RTE_MIN(m->cbs / RTE_MAX(epc_app.num_workers, 1U),
+			(uint64_t)APN_MTR_QUANTUM);
+	quantum = RTE_MAX(quantum, (uint64_t)pkt_len);
+
+	rte_spinlock_lock(&ue->apn_mtr_lock);
+	/* bursts of other workers may have a later TSC */
+	if (b->time > mtr_time(m))
+		FUNC_METER(m, b->time, 0, e_RTE_METER_GREEN);
+	if (c->tokens)
+		mtr_refund(m, c->tokens);
+	c->tokens = 0;
+
+	avail = mtr_tokens(m);
+	if (avail < pkt_len) {
+		rte_spinlock_unlock(&ue->apn_mtr_lock);
+		return 0;
+	}
+	grant = RTE_MIN(avail, quantum);
+	mtr_debit(m, grant);
+	rte_spinlock_unlock(&ue->apn_mtr_lock);
+
+	c->tokens = grant - pkt_len;
+	c->expiry = b->time + rte_get_tsc_hz() / 1000000 * APN_MTR_CREDIT_US;
+	return 1;
+}
+#endif /* APN_MTR_SHARDED */
+
 int
 apn_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info, uint32_t flow,
 			struct rte_mbuf **pkt, uint32_t n, uint64_t *pkts_mask)
 {
-	uint64_t current_time;
-	struct rte_meter_srtcm *m;
+	struct mtr_burst b = {.time = 0, .n = 0};
+	FLOW_METER *m;
 	uint32_t i;
 	struct dp_session_info *si;
 	struct dp_sdf_per_bearer_info *psdf;
@@ -369,7 +722,7 @@ apn_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info, uint32_t flow,
 		if (!ISSET_BIT(*pkts_mask, i))
 			continue;
 		psdf = (struct dp_sdf_per_bearer_info *)sdf_info[i];
-		qos = &psdf->pcc_info.qos;
+		qos = &psdf->qos;
 		if (is_qci_gbr(qos, flow))
 			continue;
 		si = psdf->bear_sess_info;
@@ -391,13 +744,22 @@ apn_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info, uint32_t flow,
 					(uint64_t)&ue->dl_apn_mtr_obj);
 		}
 
-		current_time = rte_rdtsc();
 		if (m->cir_period == 0) {
 			RTE_LOG(DEBUG, DP, "APN: Either MTR not found or"
 				" MTR not configured!!!\n");
 			continue;
 		}
-		action = app_pkt_handle(m, pkt[i], current_time);
+#ifdef APN_MTR_SHARDED
+		if (apn_mtr_shard_conform(&b, ue, m, flow,
+				rte_pktmbuf_pkt_len(pkt[i]) -
+				sizeof(struct ether_hdr)))
+			action = GREEN;
+		else
+			action = RED;
+		app_set_pkt_color(rte_pktmbuf_mtod(pkt[i], uint8_t *), action);
+#else
+		action = app_pkt_handle(&b, m, pkt[i]);
+#endif /* APN_MTR_SHARDED */
 		if ((action == RED)
 			|| (action == YELLOW)
 			|| (action == DROP)) {
@@ -408,6 +770,84 @@ apn_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info, uint32_t flow,
 	return 0;
 }
 
+#ifdef MTR_HIERARCHICAL
+int
+hier_mtr_process_pkt(struct dp_sdf_per_bearer_info **sdf_info,
+			void **adc_ue_info, uint32_t flow,
+			struct rte_mbuf **pkt, uint32_t n, uint64_t *pkts_mask)
+{
+	struct mtr_burst b = {.time = 0, .n = 0};
+	FLOW_METER *m[MTR_LEVELS];
+	uint64_t *mtr_drops[MTR_LEVELS];
+	uint32_t i, j, k;
+	struct dp_session_info *si;
+	struct dp_sdf_per_bearer_info *psdf;
+	struct dp_adc_ue_info *adc_ue;
+	struct ue_session_info *ue;
+	uint8_t *pkt_data;
+	uint32_t pkt_len;
+
+	for (i = 0; i < n; i++) {
+		if (!ISSET_BIT(*pkts_mask, i))
+			continue;
+		psdf = (struct dp_sdf_per_bearer_info *)sdf_info[i];
+		adc_ue = adc_ue_info[i];
+		si = psdf->bear_sess_info;
+		ue = si->ue_info_ptr;
+		k = 0;
+
+		/* SDF or ADC level */
+		m[k] = (adc_ue) ? &adc_ue->mtr_obj : &psdf->sdf_mtr_obj;
+		mtr_drops[k] = &psdf->sdf_mtr_drops;
+		if (m[k]->cir_period)
+			k++;
+
+		/* bearer level, GBR bearers only */
+		m[k] = (flow == UL_FLOW) ? &si->ul_bearer_mtr_obj :
+				&si->dl_bearer_mtr_obj;
+		mtr_drops[k] = &si->bearer_mtr_drops;
+		if (m[k]->cir_period)
+			k++;
+
+		/* APN-AMBR level, non GBR bearers only */
+		if (!is_qci_gbr(&psdf->qos, flow)) {
+			m[k] = (flow == UL_FLOW) ? &ue->ul_apn_mtr_obj :
+					&ue->dl_apn_mtr_obj;
+			mtr_drops[k] = (flow == UL_FLOW) ?
+					&ue->ul_apn_mtr_drops :
+					&ue->dl_apn_mtr_drops;
+			if (m[k]->cir_period)
+				k++;
+		}
+
+		if (k == 0)
+			continue;
+
+		pkt_data = rte_pktmbuf_mtod(pkt[i], uint8_t *);
+		pkt_len = rte_pktmbuf_pkt_len(pkt[i]) - sizeof(struct ether_hdr);
+
+		/* Tokens are used only if the pkt is green at every level,
+		 * so a pkt dropped by the APN-AMBR does not use SDF tokens. */
+		for (j = 0; j < k; j++) {
+			mtr_burst_refresh(&b, m[j]);
+			if (!mtr_conform(m[j], pkt_len))
+				break;
+		}
+
+		if (j < k) {
+			RESET_BIT(*pkts_mask, i);
+			*mtr_drops[j] += 1;
+			continue;
+		}
+
+		for (j = 0; j < k; j++)
+			mtr_debit(m[j], pkt_len);
+		app_set_pkt_color(pkt_data, GREEN);
+	}
+	return 0;
+}
+#endif /* MTR_HIERARCHICAL */
+
 int
 dp_meter_profile_table_create(struct dp_id dp_id, uint32_t max_elements)
 {
@@ -433,6 +873,10 @@ dp_meter_profile_entry_add(struct dp_id dp_id, struct mtr_entry *entry)
 {
 	mtr_add_entry(&mtr_profile_tbl,
 			entry->mtr_profile_index, &entry->mtr_param);
+#ifdef WARM_RESTART
+	sess_store_rule_add(SESS_STORE_MTR, entry->mtr_profile_index, entry,
+			sizeof(*entry));
+#endif	/* WARM_RESTART */
 	return 0;
 }
 
@@ -440,6 +884,9 @@ int
 dp_meter_profile_entry_delete(struct dp_id dp_id, struct mtr_entry *entry)
 {
 	mtr_del_entry(&mtr_profile_tbl, entry->mtr_profile_index);
+#ifdef WARM_RESTART
+	sess_store_rule_del(SESS_STORE_MTR, entry->mtr_profile_index);
+#endif	/* WARM_RESTART */
 	return 0;
 }
 
@@ -24,6 +24,23 @@
 #include <rte_mbuf.h>
 #include <rte_meter.h>
 
+#if defined(MTR_HIERARCHICAL) && !(defined(SDF_MTR) && defined(APN_MTR))
+#error "MTR_HIERARCHICAL needs SDF_MTR and APN_MTR"
+#endif
+
+#if defined(APN_MTR_SHARDED) && !defined(APN_MTR)
+#error "APN_MTR_SHARDED needs APN_MTR"
+#endif
+
+/**
+ * Meter object of SDF, ADC, bearer and APN meters.
+ */
+#ifdef MTR_TRTCM
+#define FLOW_METER	struct rte_meter_trtcm
+#else
+#define FLOW_METER	struct rte_meter_srtcm
+#endif /* MTR_TRTCM */
+
 /**
  * config meter entry.
  *
@@ -37,6 +54,6 @@
  *	- -1 on failure
  */
 int
-mtr_cfg_entry(int msg_id, struct rte_meter_srtcm *msg_payload);
+mtr_cfg_entry(int msg_id, FLOW_METER *msg_payload);
 
 #endif				/* _METER_H_ */
@@ -0,0 +1,815 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef DP_MICROBENCH
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_mbuf.h>
+#include <rte_random.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_udp.h>
+
+#include <sponsdn.h>
+
+#include "main.h"
+#include "acl.h"
+#include "util.h"
+#include "session_cdr.h"
+#include "microbench.h"
+
+#ifdef SIMU_CP
+#error "DP_MICROBENCH sessions and rules would mix with those of SIMU_CP"
+#endif
+
+/** First UE IP, UE s has IP MB_UE_IP + s and UL teid s + 1 */
+#define MB_UE_IP	0x10000001	/* 16.0.0.1 */
+/** First AS IP, SDF rule r matches DL pkts from MB_AS_IP + r - 1 */
+#define MB_AS_IP	0x0d01016e	/* 13.1.1.110 */
+#define MB_ENB_IP	0x0b010165	/* 11.1.1.101 */
+/** S1U IP used when none is configured */
+#define MB_S1U_IP	0x0b010164	/* 11.1.1.100 */
+/** Meter profile of all PCC rules and APNs, never runs out of tokens
+ * during a run */
+#define MB_MTR_IDX	1
+#define MB_MTR_RATE	(1ULL << 40)
+/** Inner IP pkt length of UL and DL pkts */
+#define MB_IP_LEN	100
+#define MB_GTPU_LEN	8
+/** mbufs of the microbench pool */
+#define MB_NUM_MBUFS	1024
+/** Calls run before each measurement */
+#define MB_WARMUP	256
+/** A records of the sponsdn DNS response */
+#define MB_DNS_ANS	4
+
+struct mb_ul_hdr {
+	struct ether_hdr eth;
+	struct ipv4_hdr ip;
+	struct udp_hdr udp;
+	uint8_t gtpu_flags;
+	uint8_t gtpu_type;
+	uint16_t gtpu_len;
+	uint32_t gtpu_teid;
+	struct ipv4_hdr in_ip;
+	struct udp_hdr in_udp;
+} __attribute__((packed));
+
+struct mb_dl_hdr {
+	struct ether_hdr eth;
+	struct ipv4_hdr ip;
+	struct udp_hdr udp;
+} __attribute__((packed));
+
+/**
+ * Kernel measured by mb_measure(). prep() sets up the state of a call
+ * outside of the measured interval, op() is the measured call, and
+ * check() returns the pkts of the call the kernel hit or passed.
+ */
+struct mb_kernel {
+	const char *name;
+	uint32_t bit;
+	void (*prep)(uint32_t burst, uint32_t base);
+	void (*op)(uint32_t burst);
+	uint32_t (*check)(uint32_t burst);
+};
+
+uint32_t microbench_mask;
+
+static const struct {
+	const char *name;
+	uint32_t bit;
+} mb_names[] = {
+	{"ul_lookup", MB_UL_LOOKUP},
+	{"dl_lookup", MB_DL_LOOKUP},
+	{"acl", MB_ACL},
+	{"pcc", MB_PCC},
+	{"decap", MB_DECAP},
+	{"encap", MB_ENCAP},
+	{"sdf_mtr", MB_SDF_MTR},
+	{"apn_mtr", MB_APN_MTR},
+	{"sponsdn", MB_SPONSDN},
+	{"cdr", MB_CDR},
+	{"all", MB_ALL},
+};
+
+static struct dp_id mb_dp_id = {.id = 0, .name = "microbench"};
+static uint32_t mb_nb_sess;
+static uint32_t mb_nb_rules;
+static uint32_t mb_ue[MB_KEYS];
+static uint64_t mb_tsc_overhead;
+
+static struct rte_mempool *mb_pool;
+static struct rte_mbuf *mb_pkts[MB_MAX_BURST];
+static struct mb_ul_hdr mb_ul_tpl;
+static struct mb_dl_hdr mb_dl_tpl;
+static uint64_t mb_mask;
+static uint64_t mb_queue_mask;
+
+static struct ul_bm_key mb_ul_key[MB_MAX_BURST];
+static struct dl_bm_key mb_dl_key[MB_MAX_BURST];
+static void *mb_key_ptr[MB_MAX_BURST];
+static uint64_t mb_hit_mask;
+static void *mb_value[MB_MAX_BURST];
+static struct dp_sdf_per_bearer_info *mb_sdf_info[MB_MAX_BURST];
+static struct dp_session_info *mb_si[MB_MAX_BURST];
+static void *mb_adc_ue_info[MB_MAX_BURST];
+static uint64_t mb_adc_mask;
+static uint32_t mb_rule_ids[MB_MAX_BURST];
+static struct pcc_id_precedence mb_pcc[MB_MAX_BURST];
+static uint32_t *mb_res;
+#ifdef COMBINED_SDF_ADC_ACL
+static uint32_t *mb_adc_res;
+#endif
+
+static char mb_dns[512];
+static unsigned mb_dns_len;
+static uint64_t mb_dns_hits;
+
+int
+microbench_parse(const char *arg)
+{
+	char buf[256];
+	char *tok, *save;
+	uint32_t i;
+
+	snprintf(buf, sizeof(buf), "%s", arg);
+	for (tok = strtok_r(buf, ",", &save); tok != NULL;
+			tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < RTE_DIM(mb_names); i++) {
+			if (!strcmp(tok, mb_names[i].name))
+				break;
+		}
+		if (i == RTE_DIM(mb_names)) {
+			printf("Unknown microbench kernel %s\n", tok);
+			return -1;
+		}
+		microbench_mask |= mb_names[i].bit;
+	}
+	printf("Parsed microbench:\t0x%x\n", microbench_mask);
+	return 0;
+}
+
+static inline uint64_t
+mb_burst_mask(uint32_t burst)
+{
+	return (burst == 64) ? ~0ULL : ((1ULL << burst) - 1);
+}
+
+static inline uint32_t
+mb_ue_get(uint32_t base, uint32_t i)
+{
+	return mb_ue[(base + i) & (MB_KEYS - 1)];
+}
+
+/**
+ * Draw the UEs addressed by the kernels from the sessions created.
+ */
+static void
+mb_ue_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < MB_KEYS; i++)
+		mb_ue[i] = rte_rand() % RTE_MAX(mb_nb_sess, 1U);
+}
+
+/**
+ * Add SDF rules and their PCC rules up to n rules. Rule r matches the
+ * DL pkts of AS MB_AS_IP + r - 1 to any UE.
+ */
+static void
+mb_rules_add(uint32_t n)
+{
+	struct pkt_filter filter;
+	struct pcc_rules pcc;
+	uint32_t r;
+
+	if (n <= mb_nb_rules)
+		return;
+
+	/* only the tables these rules rebuild are reported */
+	acl_build_cycles_reset();
+	memset(&pcc, 0, sizeof(pcc));
+	pcc.gate_status = OPEN;
+	pcc.qos.ul_mtr_profile_index = MB_MTR_IDX;
+	pcc.qos.dl_mtr_profile_index = MB_MTR_IDX;
+
+	for (r = mb_nb_rules + 1; r <= n; r++) {
+		memset(&filter, 0, sizeof(filter));
+		filter.pcc_rule_id = r;
+		snprintf(filter.u.rule_str, sizeof(filter.u.rule_str),
+				IPV4_ADDR"/32 16.0.0.0/8 0 : 65535 0 : 65535"
+				" 0x0/0x0\n",
+				IPV4_ADDR_HOST_FORMAT(MB_AS_IP + r - 1));
+		if (dp_sdf_filter_entry_add(mb_dp_id, &filter) < 0)
+			rte_exit(EXIT_FAILURE, "microbench: SDF rule %u add"
+					" failed\n", r);
+
+		pcc.rule_id = r;
+		pcc.precedence = r;
+		if (dp_pcc_entry_add(mb_dp_id, &pcc) < 0)
+			rte_exit(EXIT_FAILURE, "microbench: PCC rule %u add"
+					" failed\n", r);
+	}
+	mb_nb_rules = n;
+	if (acl_build_wait() < 0)
+		rte_exit(EXIT_FAILURE, "microbench: ACL build failed\n");
+	printf("microbench: %-10s rules=%-6u %12.1f usec\n", "acl_build",
+			n, acl_build_cycles() * 1e6 / rte_get_tsc_hz());
+}
+
+/**
+ * Add default bearer sessions up to n sessions, fewer if the session
+ * tables fill up.
+ */
+static void
+mb_sess_add(uint32_t n)
+{
+	struct session_info si;
+	uint32_t s;
+
+	for (s = mb_nb_sess; s < n; s++) {
+		memset(&si, 0, sizeof(si));
+		si.sess_id = SESS_ID(s + 1, DEFAULT_BEARER);
+		si.ue_addr.iptype = IPTYPE_IPV4;
+		si.ue_addr.u.ipv4_addr = MB_UE_IP + s;
+		si.ul_apn_mtr_idx = MB_MTR_IDX;
+		si.dl_apn_mtr_idx = MB_MTR_IDX;
+		si.ul_s1_info.sgw_teid = s + 1;
+		si.ul_s1_info.enb_addr.iptype = IPTYPE_IPV4;
+		si.ul_s1_info.enb_addr.u.ipv4_addr = MB_ENB_IP;
+		si.dl_s1_info.enb_teid = s + 1;
+		si.dl_s1_info.enb_addr.iptype = IPTYPE_IPV4;
+		si.dl_s1_info.enb_addr.u.ipv4_addr = MB_ENB_IP;
+		si.num_ul_pcc_rules = 1;
+		si.ul_pcc_rule_id[0] = 1;
+		si.num_dl_pcc_rules = 1;
+		si.dl_pcc_rule_id[0] = 1;
+		if (dp_session_create(mb_dp_id, &si) < 0) {
+			printf("microbench: session tables full at %u"
+					" sessions\n", s);
+			break;
+		}
+	}
+	mb_nb_sess = s;
+	mb_ue_init();
+}
+
+/**
+ * Build the pkt templates; the per UE fields are set by the prep
+ * functions.
+ */
+static void
+mb_tpl_init(void)
+{
+	struct mb_ul_hdr *ul = &mb_ul_tpl;
+	struct mb_dl_hdr *dl = &mb_dl_tpl;
+
+	if (app.s1u_ip == 0)
+		app.s1u_ip = htonl(MB_S1U_IP);
+
+	ul->eth.ether_type = htons(ETHER_TYPE_IPv4);
+	ul->ip.version_ihl = 0x45;
+	ul->ip.total_length = htons(sizeof(struct ipv4_hdr) +
+			sizeof(struct udp_hdr) + MB_GTPU_LEN + MB_IP_LEN);
+	ul->ip.time_to_live = 64;
+	ul->ip.next_proto_id = IPPROTO_UDP;
+	ul->ip.src_addr = htonl(MB_ENB_IP);
+	ul->ip.dst_addr = app.s1u_ip;
+	ul->ip.hdr_checksum = rte_ipv4_cksum(&ul->ip);
+	ul->udp.src_port = htons(UDP_PORT_GTPU);
+	ul->udp.dst_port = htons(UDP_PORT_GTPU);
+	ul->udp.dgram_len = htons(sizeof(struct udp_hdr) + MB_GTPU_LEN +
+			MB_IP_LEN);
+	ul->gtpu_flags = 0x30;
+	ul->gtpu_type = 0xff;
+	ul->gtpu_len = htons(MB_IP_LEN);
+	ul->in_ip.version_ihl = 0x45;
+	ul->in_ip.total_length = htons(MB_IP_LEN);
+	ul->in_ip.time_to_live = 64;
+	ul->in_ip.next_proto_id = IPPROTO_UDP;
+	ul->in_udp.src_port = htons(10000);
+	ul->in_udp.dst_port = htons(80);
+	ul->in_udp.dgram_len = htons(MB_IP_LEN - sizeof(struct ipv4_hdr));
+
+	dl->eth.ether_type = htons(ETHER_TYPE_IPv4);
+	dl->ip.version_ihl = 0x45;
+	dl->ip.total_length = htons(MB_IP_LEN);
+	dl->ip.time_to_live = 64;
+	dl->ip.next_proto_id = IPPROTO_UDP;
+	dl->udp.src_port = htons(80);
+	dl->udp.dst_port = htons(10000);
+	dl->udp.dgram_len = htons(MB_IP_LEN - sizeof(struct ipv4_hdr));
+}
+
+/**
+ * Reset mbuf and copy hdr to it, padded to the pkt length.
+ */
+static inline void *
+mb_pkt_fill(struct rte_mbuf *m, const void *hdr, uint32_t hdr_len,
+		uint32_t len)
+{
+	char *p;
+
+	rte_pktmbuf_reset(m);
+	p = rte_pktmbuf_append(m, len);
+	memset(p, 0, len);
+	memcpy(p, hdr, hdr_len);
+	return p;
+}
+
+static void
+mb_ul_pkts_prep(uint32_t burst, uint32_t base)
+{
+	struct mb_ul_hdr *h;
+	uint32_t i, ue;
+
+	for (i = 0; i < burst; i++) {
+		ue = mb_ue_get(base, i);
+		h = mb_pkt_fill(mb_pkts[i], &mb_ul_tpl, sizeof(mb_ul_tpl),
+				sizeof(struct ether_hdr) + sizeof(struct ipv4_hdr)
+				+ sizeof(struct udp_hdr) + MB_GTPU_LEN
+				+ MB_IP_LEN);
+		h->gtpu_teid = htonl(ue + 1);
+		h->in_ip.src_addr = htonl(MB_UE_IP + ue);
+		h->in_ip.dst_addr = htonl(MB_AS_IP);
+		h->in_ip.hdr_checksum = rte_ipv4_cksum(&h->in_ip);
+	}
+	mb_mask = mb_burst_mask(burst);
+}
+
+static void
+mb_dl_pkts_prep(uint32_t burst, uint32_t base)
+{
+	struct mb_dl_hdr *h;
+	uint32_t i, ue;
+
+	for (i = 0; i < burst; i++) {
+		ue = mb_ue_get(base, i);
+		h = mb_pkt_fill(mb_pkts[i], &mb_dl_tpl, sizeof(mb_dl_tpl),
+				sizeof(struct ether_hdr) + MB_IP_LEN);
+		h->ip.src_addr = htonl(MB_AS_IP +
+				ue % RTE_MAX(mb_nb_rules, 1U));
+		h->ip.dst_addr = htonl(MB_UE_IP + ue);
+		h->ip.hdr_checksum = rte_ipv4_cksum(&h->ip);
+	}
+	mb_mask = mb_burst_mask(burst);
+}
+
+/**
+ * DL pkts with their bearers looked up, as the meters and encap get
+ * them in the DL pipeline.
+ */
+static void
+mb_dl_sess_prep(uint32_t burst, uint32_t base)
+{
+	uint32_t i;
+
+	mb_dl_pkts_prep(burst, base);
+	for (i = 0; i < burst; i++) {
+		mb_dl_key[i].ue_ipv4 = MB_UE_IP + mb_ue_get(base, i);
+		mb_dl_key[i].rid = 1;
+		mb_key_ptr[i] = &mb_dl_key[i];
+	}
+	mb_hit_mask = 0;
+	iface_lookup_downlink_bulk_data((const void **)mb_key_ptr, burst,
+			&mb_hit_mask, (void **)mb_sdf_info);
+	for (i = 0; i < burst; i++) {
+		mb_adc_ue_info[i] = NULL;
+		if (!ISSET_BIT(mb_hit_mask, i)) {
+			mb_sdf_info[i] = NULL;
+			mb_si[i] = NULL;
+			continue;
+		}
+		mb_si[i] = mb_sdf_info[i]->bear_sess_info;
+	}
+	/* the meters do not check for missed bearers */
+	mb_mask &= mb_hit_mask;
+	mb_adc_mask = 0;
+	mb_queue_mask = 0;
+}
+
+static void
+mb_ul_key_prep(uint32_t burst, uint32_t base)
+{
+	uint32_t i;
+
+	for (i = 0; i < burst; i++) {
+		mb_ul_key[i].s1u_sgw_teid = mb_ue_get(base, i) + 1;
+		mb_ul_key[i].rid = 1;
+		mb_key_ptr[i] = &mb_ul_key[i];
+	}
+	mb_hit_mask = 0;
+}
+
+static void
+mb_dl_key_prep(uint32_t burst, uint32_t base)
+{
+	uint32_t i;
+
+	for (i = 0; i < burst; i++) {
+		mb_dl_key[i].ue_ipv4 = MB_UE_IP + mb_ue_get(base, i);
+		mb_dl_key[i].rid = 1;
+		mb_key_ptr[i] = &mb_dl_key[i];
+	}
+	mb_hit_mask = 0;
+}
+
+static void
+mb_rule_ids_prep(uint32_t burst, uint32_t base)
+{
+	uint32_t i;
+
+	for (i = 0; i < burst; i++)
+		mb_rule_ids[i] = 1 + mb_ue_get(base, i) %
+				RTE_MAX(mb_nb_rules, 1U);
+}
+
+static void
+mb_nop_op(uint32_t burst)
+{
+	RTE_SET_USED(burst);
+}
+
+static void
+mb_ul_lookup_op(uint32_t burst)
+{
+	iface_lookup_uplink_bulk_data((const void **)mb_key_ptr, burst,
+			&mb_hit_mask, mb_value);
+}
+
+static void
+mb_dl_lookup_op(uint32_t burst)
+{
+	iface_lookup_downlink_bulk_data((const void **)mb_key_ptr, burst,
+			&mb_hit_mask, mb_value);
+}
+
+static uint32_t
+mb_hit_check(uint32_t burst)
+{
+	return __builtin_popcountll(mb_hit_mask & mb_burst_mask(burst));
+}
+
+static void
+mb_acl_op(uint32_t burst)
+{
+#ifdef COMBINED_SDF_ADC_ACL
+	/* the only ACL classify of the DL path, SDF and ADC together */
+	sdf_adc_dl_lookup(mb_pkts, burst, &mb_res, &mb_adc_res);
+#else
+	mb_res = sdf_lookup(mb_pkts, burst);
+#endif
+}
+
+static uint32_t
+mb_acl_check(uint32_t burst)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < burst; i++) {
+		if (mb_res[i] && (mb_res[i] != SDF_DEFAULT_DROP_RULE_ID))
+			n++;
+	}
+	return n;
+}
+
+static void
+mb_pcc_op(uint32_t burst)
+{
+	filter_pcc_entry_lookup(FILTER_SDF, mb_rule_ids, burst, mb_pcc);
+}
+
+static uint32_t
+mb_pcc_check(uint32_t burst)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < burst; i++) {
+		if (mb_pcc[i].pcc_id)
+			n++;
+	}
+	return n;
+}
+
+static void
+mb_decap_op(uint32_t burst)
+{
+	gtpu_decap(mb_pkts, burst, &mb_mask);
+}
+
+static void
+mb_encap_op(uint32_t burst)
+{
+	gtpu_encap(mb_si, mb_pkts, burst, &mb_mask, &mb_queue_mask);
+}
+
+static void
+mb_sdf_mtr_op(uint32_t burst)
+{
+	sdf_mtr_process_pkt(mb_sdf_info, mb_adc_ue_info, &mb_adc_mask,
+			mb_pkts, burst, &mb_mask);
+}
+
+static void
+mb_apn_mtr_op(uint32_t burst)
+{
+	apn_mtr_process_pkt(mb_sdf_info, DL_FLOW, mb_pkts, burst, &mb_mask);
+}
+
+static void
+mb_cdr_op(uint32_t burst)
+{
+	struct dp_session_info *si;
+	uint32_t i;
+
+	for (i = 0; i < burst; i++) {
+		si = mb_si[i];
+		if (si != NULL)
+			export_cdr_record(si, "BEARER", UE_BEAR_ID(si->sess_id),
+					&si->ipcan_dp_bearer_cdr);
+	}
+}
+
+static uint32_t
+mb_mask_check(uint32_t burst)
+{
+	return __builtin_popcountll(mb_mask & mb_burst_mask(burst));
+}
+
+static void
+mb_sponsdn_prep(uint32_t burst, uint32_t base)
+{
+	RTE_SET_USED(burst);
+	RTE_SET_USED(base);
+	mb_dns_hits = 0;
+}
+
+static void
+mb_sponsdn_op(uint32_t burst)
+{
+	struct in_addr addr4[MB_DNS_ANS];
+	char hname[EPC_SPONSDN_QNAME_MAX];
+	unsigned int rule_id;
+	int cnt, cnt6;
+	uint32_t i;
+
+	for (i = 0; i < burst; i++) {
+		cnt = MB_DNS_ANS;
+		cnt6 = 0;
+		rule_id = 0;
+		epc_sponsdn_scan(mb_dns, mb_dns_len, hname, &rule_id, addr4,
+				&cnt, NULL, NULL, &cnt6);
+		if (cnt > 0)
+			mb_dns_hits++;
+	}
+}
+
+static uint32_t
+mb_sponsdn_check(uint32_t burst)
+{
+	RTE_SET_USED(burst);
+	return mb_dns_hits;
+}
+
+/**
+ * Add the sponsored DNs and build a DNS response to one of them, with
+ * MB_DNS_ANS A records.
+ */
+static void
+mb_sponsdn_init(void)
+{
+	static char names[MB_SPONSDN_DN][32];
+	char *dn[MB_SPONSDN_DN];
+	unsigned int ids[MB_SPONSDN_DN];
+	const char *label[] = {"mb7", "microbench", "com"};
+	uint8_t *p = (uint8_t *)mb_dns;
+	uint32_t i;
+	size_t l;
+
+	for (i = 0; i < MB_SPONSDN_DN; i++) {
+		snprintf(names[i], sizeof(names[i]), "mb%u.microbench.com", i);
+		dn[i] = names[i];
+		ids[i] = i + 1;
+	}
+	if (epc_sponsdn_dn_add_multi(dn, ids, MB_SPONSDN_DN) < 0)
+		rte_exit(EXIT_FAILURE, "microbench: sponsored DN add"
+				" failed\n");
+
+	/* header: id, response flags, 1 question, MB_DNS_ANS answers */
+	memset(mb_dns, 0, sizeof(mb_dns));
+	p[0] = 0x12;
+	p[1] = 0x34;
+	p[2] = 0x81;
+	p[3] = 0x80;
+	p[5] = 1;
+	p[7] = MB_DNS_ANS;
+	p += 12;
+	for (i = 0; i < RTE_DIM(label); i++) {
+		l = strlen(label[i]);
+		*p++ = l;
+		memcpy(p, label[i], l);
+		p += l;
+	}
+	*p++ = 0;
+	/* type A, class IN */
+	*p++ = 0;
+	*p++ = 1;
+	*p++ = 0;
+	*p++ = 1;
+	for (i = 0; i < MB_DNS_ANS; i++) {
+		/* name pointer to the question, type A, class IN, TTL 300 */
+		*p++ = 0xc0;
+		*p++ = 12;
+		*p++ = 0;
+		*p++ = 1;
+		*p++ = 0;
+		*p++ = 1;
+		*p++ = 0;
+		*p++ = 0;
+		*p++ = 0x01;
+		*p++ = 0x2c;
+		*p++ = 0;
+		*p++ = 4;
+		*p++ = 13;
+		*p++ = 2;
+		*p++ = 0;
+		*p++ = i + 1;
+	}
+	mb_dns_len = p - (uint8_t *)mb_dns;
+}
+
+/**
+ * Run kernel for all burst sizes and print the cycles per call and per
+ * pkt, less the cost of reading the TSC and of an empty call.
+ */
+static void
+mb_measure(const struct mb_kernel *k, const char *level)
+{
+	uint64_t t0, t1, cycles;
+	uint64_t pass, call;
+	uint32_t burst, it;
+
+	for (burst = 1; burst <= MB_MAX_BURST; burst <<= 1) {
+		cycles = 0;
+		pass = 0;
+		for (it = 0; it < MB_WARMUP + MB_ITERS; it++) {
+			k->prep(burst, it * burst);
+			t0 = rte_rdtsc_precise();
+			k->op(burst);
+			t1 = rte_rdtsc_precise();
+			if (it < MB_WARMUP)
+				continue;
+			cycles += t1 - t0;
+			pass += k->check(burst);
+		}
+		call = cycles / MB_ITERS;
+		call = (call > mb_tsc_overhead) ? call - mb_tsc_overhead : 0;
+		printf("microbench: %-10s %-12s burst %2u: %8"PRIu64
+				" cycles/call %8.1f cycles/pkt %5.1f%% hit\n",
+				k->name, level, burst, call,
+				(double)call / burst,
+				100.0 * pass / ((uint64_t)MB_ITERS * burst));
+	}
+}
+
+/**
+ * Measure the cost of the measurement, an empty kernel call between
+ * two TSC reads.
+ */
+static void
+mb_calibrate(void)
+{
+	/* called through a pointer, as the kernels are */
+	void (*volatile op)(uint32_t) = mb_nop_op;
+	uint64_t t0, t1, min = UINT64_MAX;
+	uint32_t it;
+
+	for (it = 0; it < MB_WARMUP + MB_ITERS; it++) {
+		t0 = rte_rdtsc_precise();
+		op(1);
+		t1 = rte_rdtsc_precise();
+		if (t1 - t0 < min)
+			min = t1 - t0;
+	}
+	mb_tsc_overhead = min;
+	printf("microbench: TSC %"PRIu64" Hz, %"PRIu64" cycles overhead"
+			" subtracted\n", rte_get_tsc_hz(), mb_tsc_overhead);
+}
+
+static const struct mb_kernel mb_sess_kernels[] = {
+	{"ul_lookup", MB_UL_LOOKUP, mb_ul_key_prep, mb_ul_lookup_op,
+		mb_hit_check},
+	{"dl_lookup", MB_DL_LOOKUP, mb_dl_key_prep, mb_dl_lookup_op,
+		mb_hit_check},
+	{"encap", MB_ENCAP, mb_dl_sess_prep, mb_encap_op, mb_mask_check},
+	{"sdf_mtr", MB_SDF_MTR, mb_dl_sess_prep, mb_sdf_mtr_op,
+		mb_mask_check},
+	{"apn_mtr", MB_APN_MTR, mb_dl_sess_prep, mb_apn_mtr_op,
+		mb_mask_check},
+	{"cdr", MB_CDR, mb_dl_sess_prep, mb_cdr_op, mb_mask_check},
+};
+
+static const struct mb_kernel mb_rule_kernels[] = {
+	{"acl", MB_ACL, mb_dl_pkts_prep, mb_acl_op, mb_acl_check},
+	{"pcc", MB_PCC, mb_rule_ids_prep, mb_pcc_op, mb_pcc_check},
+};
+
+static const struct mb_kernel mb_other_kernels[] = {
+	{"decap", MB_DECAP, mb_ul_pkts_prep, mb_decap_op, mb_mask_check},
+	{"sponsdn", MB_SPONSDN, mb_sponsdn_prep, mb_sponsdn_op,
+		mb_sponsdn_check},
+};
+
+void
+microbench_run(void)
+{
+	const uint32_t sess_levels[] = MB_SESS_LEVELS;
+	const uint32_t rule_levels[] = MB_RULE_LEVELS;
+	struct mtr_entry mtr;
+	char level[32];
+	uint32_t i, j;
+
+	mb_pool = rte_pktmbuf_pool_create("MB_POOL", MB_NUM_MBUFS, 0, 0,
+			RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (mb_pool == NULL)
+		rte_exit(EXIT_FAILURE, "microbench: cannot create mbuf pool\n");
+	for (i = 0; i < MB_MAX_BURST; i++) {
+		mb_pkts[i] = rte_pktmbuf_alloc(mb_pool);
+		if (mb_pkts[i] == NULL)
+			rte_exit(EXIT_FAILURE, "microbench: no mbufs\n");
+	}
+	mb_tpl_init();
+
+	memset(&mtr, 0, sizeof(mtr));
+	mtr.metering_method = SRTCM_COLOR_BLIND;
+	mtr.mtr_profile_index = MB_MTR_IDX;
+	mtr.mtr_param.cir = MB_MTR_RATE;
+	mtr.mtr_param.cbs = MB_MTR_RATE;
+	mtr.mtr_param.ebs = MB_MTR_RATE;
+	if (dp_meter_profile_entry_add(mb_dp_id, &mtr) < 0)
+		rte_exit(EXIT_FAILURE, "microbench: meter profile add"
+				" failed\n");
+
+	/* sessions refer to PCC rule 1 */
+	mb_rules_add(1);
+	mb_calibrate();
+	/* bearer CDRs go to the session CDR file, as on session delete */
+	if (microbench_mask & MB_CDR)
+		sess_cdr_init();
+
+	for (i = 0; i < RTE_DIM(sess_levels); i++) {
+		if (mb_nb_sess < sess_levels[i])
+			mb_sess_add(RTE_MIN(sess_levels[i],
+					(uint32_t)LDB_ENTRIES_DEFAULT));
+		snprintf(level, sizeof(level), "sess=%u", mb_nb_sess);
+		for (j = 0; j < RTE_DIM(mb_sess_kernels); j++) {
+			if (microbench_mask & mb_sess_kernels[j].bit)
+				mb_measure(&mb_sess_kernels[j], level);
+		}
+		/* the tables are full */
+		if (mb_nb_sess < sess_levels[i])
+			break;
+	}
+	if (microbench_mask & MB_CDR)
+		sess_cdr_flush();
+
+	for (i = 0; i < RTE_DIM(rule_levels); i++) {
+		mb_rules_add(RTE_MIN(rule_levels[i],
+				(uint32_t)SDF_FILTER_TABLE_SIZE - 1));
+		snprintf(level, sizeof(level), "rules=%u", mb_nb_rules);
+		for (j = 0; j < RTE_DIM(mb_rule_kernels); j++) {
+			if (microbench_mask & mb_rule_kernels[j].bit)
+				mb_measure(&mb_rule_kernels[j], level);
+		}
+	}
+
+	if (microbench_mask & MB_SPONSDN)
+		mb_sponsdn_init();
+	for (j = 0; j < RTE_DIM(mb_other_kernels); j++) {
+		if (microbench_mask & mb_other_kernels[j].bit)
+			mb_measure(&mb_other_kernels[j], "-");
+	}
+}
+#endif /* DP_MICROBENCH */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _MICROBENCH_H_
+#define _MICROBENCH_H_
+/**
+ * @file
+ * This file contains macros and function prototypes of the DP kernel
+ * microbenchmarks.
+ *
+ * With --microbench the DP creates its tables, runs the selected
+ * kernels on the master lcore against synthetic sessions, rules and
+ * packets, prints the cycles per call and per packet of each burst size
+ * and the ACL build time of each rule count, and exits. Ports and
+ * worker lcores are not used.
+ */
+#ifdef DP_MICROBENCH
+#include <stdint.h>
+
+/** Kernel selection bits of --microbench */
+#define MB_UL_LOOKUP	(1 << 0)	/** uplink bulk session lookup */
+#define MB_DL_LOOKUP	(1 << 1)	/** downlink bulk session lookup */
+#define MB_ACL		(1 << 2)	/** SDF ACL classify */
+#define MB_PCC		(1 << 3)	/** SDF rule to PCC lookup */
+#define MB_DECAP	(1 << 4)	/** GTP-U decap */
+#define MB_ENCAP	(1 << 5)	/** GTP-U encap */
+#define MB_SDF_MTR	(1 << 6)	/** SDF metering */
+#define MB_APN_MTR	(1 << 7)	/** APN metering */
+#define MB_SPONSDN	(1 << 8)	/** sponsored DN scan of DNS responses */
+#define MB_CDR		(1 << 9)	/** bearer CDR export */
+#define MB_ALL		((1 << 10) - 1)
+
+/** Calls measured per kernel, level and burst size */
+#define MB_ITERS	4096
+/** Max burst size measured, burst sizes are 1, 2, 4 .. MB_MAX_BURST */
+#define MB_MAX_BURST	64
+/** Sessions in the tables at each measured fill level */
+#define MB_SESS_LEVELS	{1 << 10, 1 << 14, 1 << 18, 1 << 20}
+/** SDF rules and PCC rules at each measured rule count */
+#define MB_RULE_LEVELS	{1, 16, 128, 1000}
+/** Sponsored DNs in the database of the sponsdn kernel */
+#define MB_SPONSDN_DN	256
+/** Random UEs addressed by the pkts and keys of each kernel, power of 2 */
+#define MB_KEYS		(1 << 14)
+
+/** Kernels selected with --microbench, 0 if disabled */
+extern uint32_t microbench_mask;
+
+/**
+ * Parse the kernel list of --microbench.
+ *
+ * @param arg
+ *	comma separated kernel names, or all.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on unknown kernel name
+ */
+int
+microbench_parse(const char *arg);
+
+/**
+ * Create the sessions, rules and pkts, run the selected kernels on the
+ * calling lcore and print the results. Called after dp_table_init().
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+microbench_run(void);
+#endif /* DP_MICROBENCH */
+#endif /* _MICROBENCH_H_ */
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef NEIGH_CACHE
+#include <rte_malloc.h>
+
+#include "main.h"
+#include "neigh_cache.h"
+
+volatile uint32_t neigh_cache_epoch = 1;
+
+/** Neighbor cache of each lcore, allocated on first use */
+static struct neigh_cache *neigh_cache_tbl[RTE_MAX_LCORE];
+
+void
+neigh_cache_invalidate(void)
+{
+	/* The atomic add is a full barrier, the new MAC is visible
+	 * before the new epoch. */
+	if (__sync_add_and_fetch(&neigh_cache_epoch, 1) == 0) {
+		/* 0 marks unused entries */
+		__sync_add_and_fetch(&neigh_cache_epoch, 1);
+	}
+}
+
+struct neigh_cache *
+neigh_cache_get(void)
+{
+	unsigned lcore_id = rte_lcore_id();
+	struct neigh_cache *nc = neigh_cache_tbl[lcore_id];
+
+	if (likely(nc != NULL))
+		return nc;
+	if (lcore_id >= RTE_MAX_LCORE)
+		return NULL;
+
+	nc = rte_zmalloc_socket("neigh_cache", sizeof(struct neigh_cache),
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (nc == NULL) {
+		RTE_LOG(ERR, DP, "lcore %u: Failed to allocate neighbor cache\n",
+				lcore_id);
+		return NULL;
+	}
+	neigh_cache_tbl[lcore_id] = nc;
+	return nc;
+}
+#endif /* NEIGH_CACHE */
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NEIGH_CACHE_H_
+#define _NEIGH_CACHE_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the per lcore neighbor cache.
+ *
+ * The neighbor cache is a read only copy, per lcore, of the resolved
+ * entries of the ARP table maintained by the epc_arp_icmp core. Next
+ * hop MACs are served from it without the ARP hash lookup. All entries
+ * are invalidated at once by an epoch bump whenever the ARP core
+ * changes a resolved MAC.
+ */
+#ifdef NEIGH_CACHE
+#include <stdint.h>
+#include <rte_ether.h>
+#include <rte_hash_crc.h>
+
+/** Entries of each lcore neighbor cache, power of 2 */
+#define NEIGH_CACHE_SIZE	(1 << 10)
+
+/**
+ * Neighbor cache entry.
+ */
+struct neigh_cache_entry {
+	uint32_t ip;			/** next hop ip, network order */
+	uint32_t epoch;			/** epoch of the MAC, 0 if unused */
+	struct ether_addr mac;		/** next hop MAC */
+	uint8_t port;			/** output port */
+	uint8_t pad;
+} __attribute__((packed));
+
+/**
+ * Per lcore neighbor cache.
+ */
+struct neigh_cache {
+	uint64_t hits;
+	uint64_t misses;
+	struct neigh_cache_entry ent[NEIGH_CACHE_SIZE];
+};
+
+/** Current neighbor cache epoch */
+extern volatile uint32_t neigh_cache_epoch;
+
+/**
+ * Invalidate every lcore neighbor cache. Called by the ARP core after
+ * the new MAC of an entry is written.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void neigh_cache_invalidate(void);
+
+/**
+ * Get neighbor cache of calling lcore, allocated on first use.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	- neighbor cache
+ *	- NULL on allocation failure
+ */
+struct neigh_cache *neigh_cache_get(void);
+
+/**
+ * Neighbor cache slot of a next hop.
+ */
+static inline struct neigh_cache_entry *
+neigh_cache_slot(struct neigh_cache *nc, uint32_t ip, uint8_t port)
+{
+	return &nc->ent[rte_hash_crc_4byte(ip, port) &
+		(NEIGH_CACHE_SIZE - 1)];
+}
+
+/**
+ * Look up the MAC of a next hop.
+ *
+ * @param nc
+ *	neighbor cache of calling lcore.
+ * @param ip
+ *	next hop ip, network order.
+ * @param port
+ *	output port.
+ * @param epoch
+ *	neigh_cache_epoch read before the lookup.
+ *
+ * @return
+ *	- MAC of the next hop
+ *	- NULL on miss, resolve through the ARP table
+ */
+static inline const struct ether_addr *
+neigh_cache_lookup(struct neigh_cache *nc, uint32_t ip, uint8_t port,
+		uint32_t epoch)
+{
+	struct neigh_cache_entry *e = neigh_cache_slot(nc, ip, port);
+
+	if (likely((e->epoch == epoch) && (e->ip == ip) &&
+				(e->port == port))) {
+		nc->hits++;
+		return &e->mac;
+	}
+	nc->misses++;
+	return NULL;
+}
+
+/**
+ * Store the resolved MAC of a next hop missed by neigh_cache_lookup().
+ *
+ * @param nc
+ *	neighbor cache of calling lcore.
+ * @param ip
+ *	next hop ip, network order.
+ * @param port
+ *	output port.
+ * @param mac
+ *	MAC read from the ARP table.
+ * @param epoch
+ *	neigh_cache_epoch read before the ARP table, so that a MAC changed
+ *	meanwhile is not cached as current.
+ *
+ * @return
+ *	None
+ */
+static inline void
+neigh_cache_insert(struct neigh_cache *nc, uint32_t ip, uint8_t port,
+		const struct ether_addr *mac, uint32_t epoch)
+{
+	struct neigh_cache_entry *e = neigh_cache_slot(nc, ip, port);
+
+	e->ip = ip;
+	e->port = port;
+	ether_addr_copy(mac, &e->mac);
+	e->epoch = epoch;
+}
+#endif /* NEIGH_CACHE */
+#endif /* _NEIGH_CACHE_H_ */
@@ -23,10 +23,186 @@
 #include "meter.h"
 #include "interface.h"
 #include "structs.h"
+#include "qsbr.h"
+#include "flow_cache.h"
+#include "sess_store.h"
 
 struct rte_hash *rte_pcc_hash;
 extern struct rte_hash *rte_sdf_pcc_hash;
 extern struct rte_hash *rte_adc_pcc_hash;
+extern struct rte_hash *rte_filter_pcc_node_hash;
+
+/** Initial capacity of the precedence heap of a SDF/ADC rule */
+#define FILTER_PCC_HEAP_MIN	4
+
+/** Add order of the PCC nodes */
+static uint32_t filter_pcc_seq;
+
+/**
+ * Highest precedence PCC of each SDF/ADC rule id, indexed by rule id.
+ * Workers resolve the ACL results with one load per packet instead of a
+ * hash lookup. Written by the iface core with a single 8 byte store.
+ */
+union pcc_id_precedence_ent {
+	struct pcc_id_precedence pcc;
+	uint8_t b[8];	/* b[7] lies in the alignment padding of pcc */
+	uint64_t u64;
+};
+
+#define PCC_ENT_VALID_BYTE	7
+
+static union pcc_id_precedence_ent sdf_pcc_tbl[MAX_ACL_RULE_NUM];
+static union pcc_id_precedence_ent adc_pcc_tbl[MAX_ACL_RULE_NUM];
+
+/**
+ * Table read by the workers of each socket. With --numa 1 sockets of
+ * workers other than the init core socket get a local replica, written
+ * along with the tables above.
+ */
+static union pcc_id_precedence_ent *sdf_pcc_rep[RTE_MAX_NUMA_NODES];
+static union pcc_id_precedence_ent *adc_pcc_rep[RTE_MAX_NUMA_NODES];
+
+static void
+filter_pcc_rep_init(union pcc_id_precedence_ent **rep,
+		union pcc_id_precedence_ent *tbl, const char *name)
+{
+	unsigned i, socket;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++)
+		rep[socket] = tbl;
+
+	for (i = 0; i < epc_app.num_workers; i++) {
+		socket = dp_lcore_socket(epc_app.worker_cores[i]);
+		if (socket == rte_socket_id() || rep[socket] != tbl)
+			continue;
+		rep[socket] = rte_zmalloc_socket(name, sizeof(sdf_pcc_tbl),
+				RTE_CACHE_LINE_SIZE, socket);
+		if (rep[socket] == NULL)
+			rte_panic("Failed to allocate %s on socket %u\n",
+					name, socket);
+		RTE_LOG(INFO, DP, "%s replica on socket %u\n", name, socket);
+	}
+}
+
+/**
+ * Table of rep for calling lcore.
+ */
+static inline const union pcc_id_precedence_ent *
+filter_pcc_rep_get(union pcc_id_precedence_ent **rep,
+		const union pcc_id_precedence_ent *tbl)
+{
+	unsigned socket = rte_socket_id();
+
+	return likely(socket < RTE_MAX_NUMA_NODES) ? rep[socket] : tbl;
+}
+
+/**
+ * Publish highest precedence PCC of rule id, the head of its heap. A rule
+ * left with no PCC is unpublished.
+ *
+ * @return
+ *	1 if the published PCC changed, 0 otherwise.
+ */
+static int
+filter_pcc_tbl_set(union pcc_id_precedence_ent **rep, uint32_t ruleid,
+		const struct filter_pcc_data *data)
+{
+	union pcc_id_precedence_ent e = {.u64 = 0};
+	unsigned socket;
+
+	RTE_BUILD_BUG_ON(sizeof(struct pcc_id_precedence) != sizeof(uint64_t));
+
+	if (ruleid >= MAX_ACL_RULE_NUM) {
+		RTE_LOG(ERR, DP, "Filter rule id %u exceeds %u\n",
+				ruleid, MAX_ACL_RULE_NUM);
+		return 0;
+	}
+	if (data->entries) {
+		e.pcc = data->heap[0]->pcc;
+		e.b[PCC_ENT_VALID_BYTE] = 1;
+	}
+	/* every replica holds the same entry */
+	if (rep[0][ruleid].u64 == e.u64)
+		return 0;
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++)
+		*(volatile uint64_t *)&rep[socket][ruleid].u64 = e.u64;
+	return 1;
+}
+
+/**
+ * Drop the flows cached with the PCCs of the rules, once per update of
+ * the published PCCs.
+ */
+static inline void
+filter_pcc_tbl_changed(int changed)
+{
+#ifdef FLOW_CACHE
+	if (changed)
+		flow_cache_invalidate();
+#else
+	RTE_SET_USED(changed);
+#endif /* FLOW_CACHE */
+}
+
+/**
+ * SDF/ADC rule ids and filter type of a PCC rule.
+ *
+ * @return
+ *	rule ids.
+ */
+static uint32_t *
+pcc_filters_get(struct pcc_rules *entry, enum filter_pcc_type *type,
+		uint32_t *n)
+{
+	/*If there are no SDF indices send(count <0) then ADC parameters are passed.
+	 * Either ADC or SDF will be passed.*/
+	if (entry->sdf_idx_cnt > 0) {
+		*type = FILTER_SDF;
+		*n = entry->sdf_idx_cnt;
+		return entry->sdf_idx;
+	}
+	*type = FILTER_ADC;
+	*n = 1;
+	return (uint32_t *)&entry->adc_idx;
+}
+
+/**
+ * Check whether two PCC rules have the same SDF/ADC rules.
+ */
+static int
+pcc_filters_equal(struct pcc_rules *a, struct pcc_rules *b)
+{
+	enum filter_pcc_type type_a, type_b;
+	uint32_t n_a, n_b;
+	uint32_t *ids_a = pcc_filters_get(a, &type_a, &n_a);
+	uint32_t *ids_b = pcc_filters_get(b, &type_b, &n_b);
+
+	return (type_a == type_b) && (n_a == n_b) &&
+		!memcmp(ids_a, ids_b, n_a * sizeof(uint32_t));
+}
+
+/**
+ * Check SDF/ADC rule ids of a PCC rule fit the published PCC tables.
+ * Ids are shifted by 1 as in filter_pcc_entry_add().
+ *
+ * @return
+ *	0 - on success
+ *	-1 - on failure
+ */
+static int
+filter_pcc_rule_ids_check(uint32_t n, const uint32_t *rule_ids)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (rule_ids[i] + 1 >= MAX_ACL_RULE_NUM) {
+			RTE_LOG(ERR, DP, "Filter rule id %u exceeds %u\n",
+					rule_ids[i] + 1, MAX_ACL_RULE_NUM);
+			return -1;
+		}
+	}
+	return 0;
+}
 /**
  * @brief Called by DP to lookup key-value in PCC table.
  *
@@ -63,8 +239,17 @@ dp_pcc_entry_add(struct dp_id dp_id, struct pcc_rules *entry)
 {
 	struct dp_pcc_rules *pcc;
 	uint32_t key32;
+	struct dp_pcc_rules *old;
+	enum filter_pcc_type type;
+	uint32_t *rule_ids;
+	uint32_t n;
 	int ret;
 
+	/* rejected before the PCC rule replaces a valid one */
+	rule_ids = pcc_filters_get(entry, &type, &n);
+	if (filter_pcc_rule_ids_check(n, rule_ids) < 0)
+		return -1;
+
 	pcc = rte_zmalloc("data", sizeof(struct dp_pcc_rules),
 			   RTE_CACHE_LINE_SIZE);
 	if (pcc == NULL)
@@ -72,6 +257,9 @@ dp_pcc_entry_add(struct dp_id dp_id, struct pcc_rules *entry)
 	memcpy(pcc, entry, sizeof(struct pcc_rules));
 
 	key32 = entry->rule_id;
+	/* re-add of a PCC rule updates it in place */
+	if (rte_hash_lookup_data(rte_pcc_hash, &key32, (void **)&old) < 0)
+		old = NULL;
 	ret = rte_hash_add_key_data(rte_pcc_hash, &key32,
 				  pcc);
 	if (ret < 0) {
@@ -85,21 +273,34 @@ dp_pcc_entry_add(struct dp_id dp_id, struct pcc_rules *entry)
 			pcc->qos.ul_mtr_profile_index,
 			pcc->qos.dl_mtr_profile_index, pcc->sdf_idx_cnt, pcc->adc_idx);
 
-	/*If there are no SDF indices send(count <0) then ADC parameters are passed.
-	 * Either ADC or SDF will be passed.*/
-	if (entry->sdf_idx_cnt > 0)
-		filter_pcc_entry_add(FILTER_SDF, key32, entry->precedence,
-				entry->gate_status, entry->sdf_idx_cnt, entry->sdf_idx);
-	else
-		filter_pcc_entry_add(FILTER_ADC, key32, entry->precedence,
-				entry->gate_status, 1, &entry->adc_idx);
+	if (old != NULL && pcc_filters_equal(old, entry)) {
+		/* same rules, only their winning PCC may change */
+		filter_pcc_precedence_update(entry, 1);
+	} else {
+		if (old != NULL) {
+			rule_ids = pcc_filters_get(old, &type, &n);
+			filter_pcc_entry_delete(type, key32, n, rule_ids);
+		}
+		rule_ids = pcc_filters_get(entry, &type, &n);
+		filter_pcc_entry_add(type, key32, entry->precedence,
+				entry->gate_status, n, rule_ids);
+	}
+	if (old != NULL)
+		dp_defer_free(old);
+	sess_fast_path_rules_changed();
+#ifdef WARM_RESTART
+	sess_store_rule_add(SESS_STORE_PCC, key32, entry, sizeof(*entry));
+#endif	/* WARM_RESTART */
 	return 0;
 }
 int
 dp_pcc_entry_delete(struct dp_id dp_id, struct pcc_rules *entry)
 {
 	struct dp_pcc_rules *pcc;
+	enum filter_pcc_type type;
+	uint32_t *rule_ids;
 	uint32_t key32;
+	uint32_t n;
 	int ret;
 	key32 = entry->rule_id;
 	ret = rte_hash_lookup_data(rte_pcc_hash, &key32,
@@ -113,6 +314,12 @@ dp_pcc_entry_delete(struct dp_id dp_id, struct pcc_rules *entry)
 	ret = rte_hash_del_key(rte_pcc_hash, &key32);
 	if (ret < 0)
 		return -1;
+	rule_ids = pcc_filters_get(pcc, &type, &n);
+	filter_pcc_entry_delete(type, key32, n, rule_ids);
+	sess_fast_path_rules_changed();
+#ifdef WARM_RESTART
+	sess_store_rule_del(SESS_STORE_PCC, key32);
+#endif	/* WARM_RESTART */
 
 	rte_free(pcc);
 	return 0;
@@ -186,6 +393,9 @@ cb_pcc_entry_delete(struct msgbuf *msg_payload)
  */
 void app_pcc_tbl_init(void)
 {
+	filter_pcc_rep_init(sdf_pcc_rep, sdf_pcc_tbl, "sdf_pcc_tbl");
+	filter_pcc_rep_init(adc_pcc_rep, adc_pcc_tbl, "adc_pcc_tbl");
+
 	/* register msg type in DB*/
 	iface_ipc_register_msg_cb(MSG_PCC_TBL_CRE, cb_pcc_table_create);
 	iface_ipc_register_msg_cb(MSG_PCC_TBL_DES, cb_pcc_table_delete);
@@ -194,47 +404,142 @@ void app_pcc_tbl_init(void)
 }
 
 /**
- * Returns insertion position in sorted array, after moving elements.
- * Capacity of pcc should be n+1
- * @param pcc
- *	Pointer to pcc_id_precedence structure
- * @param n
- *	no of entries in pcc
- * @param precedence
- *	Comparison is based on precedence.
+ * Hash of the SDF/ADC rules and published table of a filter type.
+ * @param type
+ *  Type of hash table, SDF/ADC.
+ * @param hash
+ *  SDF-PCC or ADC-PCC association hash.
+ * @param tbl
+ *  Published PCC table.
+ *
  * @return
- * Insert position for new element.
+ *  0 - on success
+ *  -1 - on failure
  */
-static uint32_t
-get_insert_position(struct pcc_id_precedence *pcc, uint32_t n,
-		uint32_t precedence)
+static int
+filter_pcc_type_get(enum filter_pcc_type type, struct rte_hash **hash,
+		union pcc_id_precedence_ent ***tbl)
 {
-	int i;
-	for(i = n-1; (i >= 0 && pcc[i].precedence <= precedence); i--)
-		pcc[i+1] = pcc[i];
-	return i+1;
+	if (type == FILTER_SDF) {
+		*hash = rte_sdf_pcc_hash;
+		*tbl = sdf_pcc_rep;
+	} else if (type == FILTER_ADC) {
+		*hash = rte_adc_pcc_hash;
+		*tbl = adc_pcc_rep;
+	} else
+		return -1;
+	return 0;
+}
+
+static inline void
+filter_pcc_node_key_set(struct filter_pcc_node_key *key,
+		enum filter_pcc_type type, uint32_t ruleid, uint32_t pcc_id)
+{
+	key->ruleid = ruleid;
+	key->pcc_id = pcc_id;
+	key->type = type;
 }
 
 /**
- * Returns delete position in sorted array, after moving elements.
- * Capacity of pcc should be n-1
- * @param pcc
- *	Pointer to pcc_id_precedence structure
- * @param n
- *	no of entries in pcc
- * @param precedence
- *	Comparison is based on precedence.
+ * Order of the PCCs of a rule.
+ * @return
+ *  1 if a wins over b, 0 otherwise.
+ */
+static inline int
+filter_pcc_before(const struct filter_pcc_node *a,
+		const struct filter_pcc_node *b)
+{
+	/* Lowest value, highest precedance. ref: 29.212 */
+	if (a->pcc.precedence != b->pcc.precedence)
+		return a->pcc.precedence < b->pcc.precedence;
+	return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static inline void
+filter_pcc_heap_place(struct filter_pcc_data *data,
+		struct filter_pcc_node *node, uint32_t idx)
+{
+	data->heap[idx] = node;
+	node->heap_idx = idx;
+}
+
+/**
+ * Restore the heap order around the node at idx, after it was added or
+ * its precedence changed. O(log n).
+ * @param data
+ *  PCCs of the rule.
+ * @param idx
+ *  heap position of the node.
+ */
+static void
+filter_pcc_heap_fix(struct filter_pcc_data *data, uint32_t idx)
+{
+	struct filter_pcc_node *node = data->heap[idx];
+	uint32_t parent, child;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (!filter_pcc_before(node, data->heap[parent]))
+			break;
+		filter_pcc_heap_place(data, data->heap[parent], idx);
+		idx = parent;
+	}
+	for (;;) {
+		child = 2 * idx + 1;
+		if (child >= data->entries)
+			break;
+		if ((child + 1 < data->entries) &&
+				filter_pcc_before(data->heap[child + 1],
+					data->heap[child]))
+			child++;
+		if (!filter_pcc_before(data->heap[child], node))
+			break;
+		filter_pcc_heap_place(data, data->heap[child], idx);
+		idx = child;
+	}
+	filter_pcc_heap_place(data, node, idx);
+}
+
+/**
+ * Add PCC node to the heap of its rule.
  * @return
- * Insert position for new element.
+ *  0 - on success
+ *  -1 - on failure
+ */
+static int
+filter_pcc_heap_push(struct filter_pcc_data *data,
+		struct filter_pcc_node *node)
+{
+	struct filter_pcc_node **heap;
+	uint32_t size;
+
+	if (data->entries == data->size) {
+		size = data->size ? 2 * data->size : FILTER_PCC_HEAP_MIN;
+		heap = rte_realloc(data->heap, size * sizeof(*heap),
+				RTE_CACHE_LINE_SIZE);
+		if (heap == NULL)
+			return -1;
+		data->heap = heap;
+		data->size = size;
+	}
+	filter_pcc_heap_place(data, node, data->entries++);
+	filter_pcc_heap_fix(data, node->heap_idx);
+	return 0;
+}
+
+/**
+ * Remove PCC node from the heap of its rule.
  */
-static uint32_t
-get_delete_position(struct pcc_id_precedence *pcc, uint32_t n,
-		uint32_t pcc_id)
+static void
+filter_pcc_heap_remove(struct filter_pcc_data *data,
+		struct filter_pcc_node *node)
 {
-	int i;
-	for(i = n-1; (i >= 0 && pcc[i].pcc_id == pcc_id); i--)
-		return i;
-	return -1;
+	uint32_t idx = node->heap_idx;
+
+	if (idx != --data->entries) {
+		filter_pcc_heap_place(data, data->heap[data->entries], idx);
+		filter_pcc_heap_fix(data, idx);
+	}
 }
 
 /**
@@ -263,15 +568,16 @@ filter_pcc_entry_add(enum filter_pcc_type type, uint32_t pcc_id,
 {
 	int ret;
 	uint32_t i;
+	int changed = 0;
 	struct filter_pcc_data *pinfo = NULL;
+	struct filter_pcc_node *node = NULL;
+	struct filter_pcc_node_key key;
 	struct rte_hash *hash = NULL;
-	uint32_t ruleid;
+	union pcc_id_precedence_ent **tbl;
 
-	if (type == FILTER_SDF)
-		hash = rte_sdf_pcc_hash;
-	else if (type == FILTER_ADC)
-		hash = rte_adc_pcc_hash;
-	else
+	if (filter_pcc_type_get(type, &hash, &tbl) < 0)
+		return -1;
+	if (filter_pcc_rule_ids_check(n, rule_ids) < 0)
 		return -1;
 
 	for (i = 0; i < n; i++) {
@@ -282,89 +588,157 @@ filter_pcc_entry_add(enum filter_pcc_type type, uint32_t pcc_id,
 		 *       So incrementing rule_ids[i] by 1 to consider above scenario.
 		 *       Need to revisit.
 		 */
-		ruleid = rule_ids[i] + 1;
-		ret = rte_hash_lookup_data(hash, &ruleid, (void **)&pinfo);
+		filter_pcc_node_key_set(&key, type, rule_ids[i] + 1, pcc_id);
+		if (rte_hash_lookup_data(rte_filter_pcc_node_hash, &key,
+				(void **)&node) >= 0) {
+			RTE_LOG(DEBUG, DP, "PCC %u already on filter rule %u\n",
+					pcc_id, key.ruleid);
+			continue;
+		}
 
+		ret = rte_hash_lookup_data(hash, &key.ruleid, (void **)&pinfo);
 		if (ret < 0 || pinfo == NULL) {
 			/* No data found for sdf id, insert new entry*/
-
-			struct pcc_id_precedence *pcc = rte_zmalloc("pcc_id_preced",
-					sizeof(struct pcc_id_precedence), RTE_CACHE_LINE_SIZE);
-			if (pcc == NULL)
-				rte_panic("Failed to allocate memory for pcc_id_precedence");
-
-			pcc->pcc_id = pcc_id;
-			pcc->precedence = precedence;
-			pcc->gate_status = gate_status;
-
-			struct filter_pcc_data *data = rte_zmalloc("filter_pcc_data",
-					sizeof(struct filter_pcc_data), RTE_CACHE_LINE_SIZE);
-
-			if (data == NULL) {
-				rte_free(pcc);
+			pinfo = rte_zmalloc("filter_pcc_data",
+					sizeof(struct filter_pcc_data),
+					RTE_CACHE_LINE_SIZE);
+			if (pinfo == NULL)
 				rte_panic("Failed to allocate memory for filter_pcc_data");
-			}
-
-			data->entries = 1;
-			data->pcc_info = pcc;
-
-			ret = rte_hash_add_key_data(hash, &ruleid, data);
 
+			ret = rte_hash_add_key_data(hash, &key.ruleid, pinfo);
 			if (ret < 0) {
-				rte_free(pcc);
-				rte_free(data);
+				rte_free(pinfo);
 				RTE_LOG(DEBUG, DP, "Failed to add entry in rte_sdf_pcc hash.\n");
 				continue;
 			}
-		} else {
-			struct pcc_id_precedence *pcc = rte_zmalloc("pcc_id_precedence",
-					(pinfo->entries + 1) * sizeof(struct pcc_id_precedence),
-					RTE_CACHE_LINE_SIZE);
-
-			if (pcc == NULL)
-				rte_panic("Failed to allocate memory for pcc_id_precedence");
-
-			rte_memcpy(pcc, pinfo->pcc_info,
-					(pinfo->entries) * sizeof(struct pcc_id_precedence));
-			uint32_t insert_pos = get_insert_position(pcc, pinfo->entries,
-									precedence);
-			pcc[insert_pos].pcc_id = pcc_id;
-			pcc[insert_pos].precedence = precedence;
-			pcc[insert_pos].gate_status = gate_status;
+		}
 
-			struct filter_pcc_data *data = rte_zmalloc("filter_pcc_data",
-					sizeof(struct filter_pcc_data), RTE_CACHE_LINE_SIZE);
+		node = rte_zmalloc("filter_pcc_node",
+				sizeof(struct filter_pcc_node), 0);
+		if (node == NULL)
+			rte_panic("Failed to allocate memory for filter_pcc_node");
+
+		node->pcc.pcc_id = pcc_id;
+		node->pcc.precedence = precedence;
+		node->pcc.gate_status = gate_status;
+		node->seq = filter_pcc_seq++;
+
+		ret = rte_hash_add_key_data(rte_filter_pcc_node_hash, &key,
+				node);
+		if (ret < 0) {
+			rte_free(node);
+			RTE_LOG(DEBUG, DP,
+					"Failed to add entry in filter_pcc_node hash\n");
+			continue;
+		}
+		if (filter_pcc_heap_push(pinfo, node) < 0)
+			rte_panic("Failed to allocate memory for filter_pcc_data heap");
 
-			if (data == NULL)
-				rte_panic("Failed to allocate memory for filter_pcc_data");
+		changed |= filter_pcc_tbl_set(tbl, key.ruleid, pinfo);
+	}
+	filter_pcc_tbl_changed(changed);
+	return 0;
+}
 
-			data->entries = pinfo->entries + 1;
-			data->pcc_info = pcc;
+/**
+ * Delete entry from SDF-PCC or ADC-PCC association hash.
+ * @param type
+ *  Type of hash table, SDF/ADC.
+ * @param pcc_id
+ *  PCC rule id to be deleted.
+ * @param  n
+ *  Number of SDF/ADC rules.
+ * @param  rule_ids
+ *  Pointer to SDF/ADC rule ids.
+ *
+ * @return
+ *  0 - on success
+ *  -1 - on failure
+ */
+int
+filter_pcc_entry_delete(enum filter_pcc_type type, uint32_t pcc_id,
+		uint32_t n, uint32_t *rule_ids)
+{
+	uint32_t i;
+	int changed = 0;
+	struct filter_pcc_data *pinfo = NULL;
+	struct filter_pcc_node *node = NULL;
+	struct filter_pcc_node_key key;
+	struct rte_hash *hash = NULL;
+	union pcc_id_precedence_ent **tbl;
 
-			ret = rte_hash_del_key(hash, &ruleid);
-			if (ret < 0) {
-				rte_free(pcc);
-				rte_free(data);
-				RTE_LOG(DEBUG, DP, "Failed to delete from rte_sdf_pcc hash\n");
-				continue;
-			}
+	if (filter_pcc_type_get(type, &hash, &tbl) < 0)
+		return -1;
 
-			rte_free(pinfo->pcc_info);
+	for (i = 0; i < n; i++) {
+		/* rule ids are shifted by 1 as in filter_pcc_entry_add() */
+		filter_pcc_node_key_set(&key, type, rule_ids[i] + 1, pcc_id);
+		if (rte_hash_lookup_data(rte_filter_pcc_node_hash, &key,
+				(void **)&node) < 0)
+			continue;
+		if (rte_hash_lookup_data(hash, &key.ruleid,
+				(void **)&pinfo) < 0 || pinfo == NULL)
+			continue;
+
+		filter_pcc_heap_remove(pinfo, node);
+		rte_hash_del_key(rte_filter_pcc_node_hash, &key);
+		/* workers only read the published table */
+		rte_free(node);
+
+		changed |= filter_pcc_tbl_set(tbl, key.ruleid, pinfo);
+		if (pinfo->entries == 0) {
+			rte_hash_del_key(hash, &key.ruleid);
+			rte_free(pinfo->heap);
 			rte_free(pinfo);
-			pinfo = NULL;
+		}
+	}
+	filter_pcc_tbl_changed(changed);
+	return 0;
+}
 
-			ret = rte_hash_add_key_data(hash,
-					&ruleid, data);
-			if (ret < 0) {
-				rte_free(pcc);
-				rte_free(data);
-				RTE_LOG(DEBUG, DP,
-						"Failed to add entry in sdf_pcc hash table\n");
+int
+filter_pcc_precedence_update(struct pcc_rules *entries, uint32_t n)
+{
+	uint32_t i, j, cnt;
+	int changed = 0;
+	int ret = 0;
+	enum filter_pcc_type type;
+	uint32_t *rule_ids;
+	struct filter_pcc_data *pinfo = NULL;
+	struct filter_pcc_node *node = NULL;
+	struct filter_pcc_node_key key;
+	struct rte_hash *hash = NULL;
+	union pcc_id_precedence_ent **tbl = NULL;
+
+	for (i = 0; i < n; i++) {
+		rule_ids = pcc_filters_get(&entries[i], &type, &cnt);
+		filter_pcc_type_get(type, &hash, &tbl);
+		for (j = 0; j < cnt; j++) {
+			filter_pcc_node_key_set(&key, type, rule_ids[j] + 1,
+					entries[i].rule_id);
+			if ((rte_hash_lookup_data(rte_filter_pcc_node_hash, &key,
+					(void **)&node) < 0) ||
+					(rte_hash_lookup_data(hash, &key.ruleid,
+					(void **)&pinfo) < 0)) {
+				RTE_LOG(DEBUG, DP, "PCC %u not on filter rule %u\n",
+						key.pcc_id, key.ruleid);
+				ret = -1;
 				continue;
 			}
+			if ((node->pcc.precedence == (uint8_t)entries[i].precedence)
+					&& (node->pcc.gate_status ==
+						entries[i].gate_status))
+				continue;
+
+			node->pcc.precedence = entries[i].precedence;
+			node->pcc.gate_status = entries[i].gate_status;
+			filter_pcc_heap_fix(pinfo, node->heap_idx);
+			changed |= filter_pcc_tbl_set(tbl, key.ruleid, pinfo);
 		}
 	}
-	return 0;
+	/* one flow cache flush for the whole batch */
+	filter_pcc_tbl_changed(changed);
+	return ret;
 }
 
 /**
@@ -386,24 +760,26 @@ int
 filter_pcc_entry_lookup(enum filter_pcc_type type, uint32_t* rule_ids,
 		uint32_t n, struct pcc_id_precedence *pcc_ids)
 {
-	int ret = 0;
+	const union pcc_id_precedence_ent *tbl;
+	union pcc_id_precedence_ent e;
 	uint32_t i;
-	struct filter_pcc_data *pinfo = NULL;
-	struct rte_hash *hash = NULL;
 
 	if (type == FILTER_SDF)
-		hash = rte_sdf_pcc_hash;
+		tbl = filter_pcc_rep_get(sdf_pcc_rep, sdf_pcc_tbl);
 	else if (type == FILTER_ADC)
-		hash = rte_adc_pcc_hash;
+		tbl = filter_pcc_rep_get(adc_pcc_rep, adc_pcc_tbl);
 	else {
 		RTE_LOG(INFO, DP, "filter_pcc_entry_lookup hash type mistmatch");
 		return -1;
 	}
 
 	for (i = 0; i < n; i++) {
-		ret = rte_hash_lookup_data(hash, &rule_ids[i], (void **)&pinfo);
+		if (likely(rule_ids[i] < MAX_ACL_RULE_NUM))
+			e.u64 = *(const volatile uint64_t *)&tbl[rule_ids[i]].u64;
+		else
+			e.u64 = 0;
 
-		if (ret < 0 || pinfo == NULL) {
+		if (unlikely(e.b[PCC_ENT_VALID_BYTE] == 0)) {
 			/* TODO : If there is no matching pcc rule, what should be
 			 *        values of pcc? Currently hardcoding to 0 with
 			 *        gate-status 1 (pass traffic)
@@ -412,7 +788,7 @@ filter_pcc_entry_lookup(enum filter_pcc_type type, uint32_t* rule_ids,
 			pcc_ids[i].precedence = 255;
 			pcc_ids[i].gate_status = 1;
 		} else {
-			pcc_ids[i] = pinfo->pcc_info[pinfo->entries - 1];
+			pcc_ids[i] = e.pcc;
 		}
 	}
 	return 0;
@@ -35,6 +35,9 @@
 #include <rte_hash.h>
 #include <rte_jhash.h>
 #include <rte_port_ring.h>
+#ifdef HW_CTRL_STEERING
+#include <rte_port_ethdev.h>
+#endif
 #include <rte_table_stub.h>
 #include <rte_mbuf.h>
 #include <rte_ring.h>
@@ -50,6 +53,7 @@
 #include "util.h"
 #include "cdr.h"
 #include "main.h"
+#include "neigh_cache.h"
 
 #ifdef STATIC_ARP
 #define STATIC_ARP_FILE "../config/static_arp.cfg"
@@ -143,6 +147,14 @@ struct rte_mempool *arp_queued_pktmbuf_tx_pool;
  * arp pkts buffer.
  */
 struct rte_mbuf *arp_icmp_pkt;
+#ifdef ARP_LOCKLESS_QUEUE
+struct arp_queue_stats arp_queue_stats[RTE_MAX_LCORE];
+/**
+ * Set by a worker that queued a pkt after the ARP core drained the
+ * neighbor queue.
+ */
+static volatile int arp_queue_recheck;
+#endif	/* ARP_LOCKLESS_QUEUE */
 /**
  * hash params.
  */
@@ -194,7 +206,14 @@ struct epc_arp_icmp_params {
 	/** RTE pipeline params */
 	struct rte_pipeline_params pipeline_params;
 	/** Input port id */
+#ifdef HW_CTRL_STEERING
+	/* mct rings followed by the NIC control queues */
+	uint32_t port_in_id[NUM_SPGW_PORTS * 2];
+#else
 	uint32_t port_in_id[NUM_SPGW_PORTS];
+#endif
+	/** Number of input ports */
+	uint32_t n_ports_in;
 	/** Output port IDs */
 	uint32_t port_out_id[NUM_SPGW_PORTS];
 	/** table id */
@@ -290,6 +309,143 @@ static int add_arp_data(struct pipeline_arp_icmp_arp_key_ipv4 *arp_key,
 }
 
 
+#ifdef ARP_LOCKLESS_QUEUE
+/**
+ * Create the pkt queue of an unresolved neighbor. The ring is not
+ * registered in a memzone, any worker may enqueue and only the ARP core
+ * dequeues, unless the oldest pkts are dropped by the workers.
+ */
+static struct rte_ring *
+arp_queue_create(uint32_t ip)
+{
+	struct rte_ring *r;
+	unsigned flags = RING_F_SC_DEQ;
+
+#ifdef ARP_QUEUE_DROP_OLDEST
+	flags = 0;
+#endif
+	r = rte_zmalloc_socket(NULL, rte_ring_get_memsize(ARP_BUFFER_RING_SIZE),
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (r == NULL)
+		return NULL;
+
+	if (rte_ring_init(r, inet_ntoa(*(struct in_addr *)&ip),
+				ARP_BUFFER_RING_SIZE, flags)) {
+		rte_free(r);
+		return NULL;
+	}
+	return r;
+}
+
+/**
+ * Send pkts queued for a resolved neighbor. Called on the ARP core.
+ */
+static void
+arp_queue_drain(struct arp_entry_data *arp_data)
+{
+	struct rte_mbuf *pkts[MAX_BURST_SZ];
+	struct ether_hdr *e_hdr;
+	unsigned n, i;
+
+	do {
+		n = rte_ring_dequeue_burst(arp_data->queue, (void **)pkts,
+				MAX_BURST_SZ);
+		for (i = 0; i < n; i++) {
+			e_hdr = rte_pktmbuf_mtod(pkts[i], struct ether_hdr *);
+			ether_addr_copy(&arp_data->eth_addr, &e_hdr->d_addr);
+			ether_addr_copy(&ports_eth_addr[arp_data->port],
+					&e_hdr->s_addr);
+			rte_pipeline_port_out_packet_insert(myP, arp_data->port,
+					pkts[i]);
+		}
+		arp_queue_stats[rte_lcore_id()].sent += n;
+	} while (n == MAX_BURST_SZ);
+}
+
+/**
+ * Drain the queues of neighbors resolved while a worker was queueing.
+ */
+static void
+arp_queue_recheck_all(void)
+{
+	const void *next_key;
+	void *next_data;
+	uint32_t iter = 0;
+	struct arp_entry_data *arp_data;
+
+	arp_queue_recheck = 0;
+	rte_smp_mb();
+
+	rte_rwlock_read_lock(&arp_hash_handle_lock);
+	while (rte_hash_iterate(arp_hash_handle, &next_key, &next_data,
+				&iter) >= 0) {
+		arp_data = (struct arp_entry_data *)next_data;
+		if (arp_data->status == COMPLETE && arp_data->queue != NULL
+				&& !rte_ring_empty(arp_data->queue))
+			arp_queue_drain(arp_data);
+	}
+	rte_rwlock_read_unlock(&arp_hash_handle_lock);
+}
+
+/**
+ * returns 0 if packet was queued or dropped on a full queue
+ * return 1 if arp was resolved - not queued - to be forwarded
+ * return -1 if packet could not be queued - no ring or no mbuf
+ */
+int arp_queue_unresolved_packet(struct arp_entry_data *arp_data, struct rte_mbuf *m)
+{
+	struct arp_queue_stats *stats = &arp_queue_stats[rte_lcore_id()];
+	struct rte_mbuf *buf_pkt;
+	int ret;
+
+	if (arp_data->status == COMPLETE)
+		return 1;
+
+	if (arp_data->queue == NULL) {
+		RTE_LOG(NOTICE, DP, "ARP: No %s buffer exists for pkt - Dropping\n",
+				inet_ntoa(*(struct in_addr *)&arp_data->ip));
+		return -1;
+	}
+
+	buf_pkt = rte_pktmbuf_clone(m, arp_queued_pktmbuf_tx_pool);
+	if (buf_pkt == NULL) {
+		stats->no_mbuf++;
+		return -1;
+	}
+	*(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(buf_pkt,
+			META_DATA_OFFSET) =
+		*(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(m,
+				META_DATA_OFFSET);
+
+	ret = rte_ring_mp_enqueue(arp_data->queue, buf_pkt);
+#ifdef ARP_QUEUE_DROP_OLDEST
+	while (ret == -ENOBUFS) {
+		struct rte_mbuf *tmp;
+
+		if (rte_ring_mc_dequeue(arp_data->queue, (void **)&tmp) == 0) {
+			rte_pktmbuf_free(tmp);
+			stats->full++;
+		}
+		ret = rte_ring_mp_enqueue(arp_data->queue, buf_pkt);
+	}
+#else
+	if (ret == -ENOBUFS) {
+		rte_pktmbuf_free(buf_pkt);
+		stats->full++;
+		return 0;
+	}
+#endif	/* ARP_QUEUE_DROP_OLDEST */
+	stats->queued++;
+
+	/* The ARP core marks the entry COMPLETE before draining it. A pkt
+	 * enqueued after the drain is sent on the next ARP core run. */
+	rte_smp_mb();
+	if (arp_data->status == COMPLETE)
+		arp_queue_recheck = 1;
+
+	return 0;
+}
+#else
 /**
  * returns 0 if packet was queued
  * return 1 if arp was resolved prior to acquiring lock - not queued - to be forwarded
@@ -367,6 +523,7 @@ int arp_queue_unresolved_packet(struct arp_entry_data *arp_data, struct rte_mbuf
 
 	return 0;
 }
+#endif	/* ARP_LOCKLESS_QUEUE */
 
 static const char *
 arp_op_name(uint16_t arp_op)
@@ -528,6 +685,37 @@ retrieve_arp_entry(struct pipeline_arp_icmp_arp_key_ipv4 arp_key)
 		/* We have to keep trying to prevent race condition:
 		 * multiple threads each creating arp_data for same ip */
 		ret = rte_hash_lookup_data(arp_hash_handle, &arp_key, (void **)&ret_arp_data);
+#ifdef ARP_LOCKLESS_QUEUE
+		if (ret < 0) {
+			/* create a arp_entry with its queue, no worker sees
+			 * it before it is added */
+			ret_arp_data = rte_zmalloc_socket(NULL,
+					sizeof(struct arp_entry_data),
+					RTE_CACHE_LINE_SIZE, rte_socket_id());
+			if (ret_arp_data == NULL)
+				return NULL;
+			ret_arp_data->last_update = time(NULL);
+			ret_arp_data->status = INCOMPLETE;
+			ret_arp_data->port = arp_key.port_id;
+			ret_arp_data->ip = arp_key.ip;
+			rte_rwlock_init(&ret_arp_data->queue_lock);
+			ret_arp_data->queue = arp_queue_create(arp_key.ip);
+			if (ret_arp_data->queue == NULL)
+				RTE_LOG(NOTICE, DP, "Error creating arp ring for %s"
+						" on port %d\n",
+						inet_ntoa(*(struct in_addr *)&arp_key.ip),
+						arp_key.port_id);
+
+			ret = add_arp_data(&arp_key, ret_arp_data);
+			if (ret == EEXIST) {
+				rte_free(ret_arp_data->queue);
+				rte_free(ret_arp_data);
+				/* Some other thread has 'beat' this thread in creation of arp_data, try again */
+				continue;
+			}
+			send_arp_req(arp_key.port_id, arp_key.ip);
+		} else {
+#else
 		if (ret < 0) {
 			/* create a arp_entry */
 			ret_arp_data = rte_malloc_socket(NULL, sizeof(struct arp_entry_data),
@@ -572,6 +760,7 @@ retrieve_arp_entry(struct pipeline_arp_icmp_arp_key_ipv4 arp_key)
 			rte_rwlock_write_unlock(&ret_arp_data->queue_lock);
 
 		} else {
+#endif	/* ARP_LOCKLESS_QUEUE */
 			/* arp_entry has already been created for this ip */
 			if (ARPICMP_DEBUG)
 				printf("ARP entry found for ip 0x%x\n", arp_key.ip);
@@ -619,6 +808,7 @@ print_arp_table(void)
 	}
 }
 
+#ifndef ARP_LOCKLESS_QUEUE
 static void
 arp_send_buffered_pkts(struct rte_ring *queue, const struct ether_addr *hw_addr, uint8_t portid)
 {
@@ -643,8 +833,8 @@ arp_send_buffered_pkts(struct rte_ring *queue, const struct ether_addr *hw_addr,
 	}
 
 	rte_ring_free(queue);
-	queue = NULL;
 }
+#endif	/* !ARP_LOCKLESS_QUEUE */
 
 static void
 populate_arp_entry(const struct ether_addr *hw_addr, uint32_t ipaddr, uint8_t portid)
@@ -670,13 +860,28 @@ populate_arp_entry(const struct ether_addr *hw_addr, uint32_t ipaddr, uint8_t po
 				return;
 			} else {
 				ether_addr_copy(hw_addr, &arp_data->eth_addr);
+#ifdef NEIGH_CACHE
+				/* workers may hold the old MAC */
+				neigh_cache_invalidate();
+#endif	/* NEIGH_CACHE */
 				if (arp_data->status == INCOMPLETE) {
+#ifdef ARP_LOCKLESS_QUEUE
+					/* Workers stop queueing once they see
+					 * COMPLETE, the queue lives as long as
+					 * the entry. */
+					arp_data->status = COMPLETE;
+					rte_smp_mb();
+					if (arp_data->queue)
+						arp_queue_drain(arp_data);
+#else
 					if (arp_data->queue) {
 						rte_rwlock_write_lock(&arp_data->queue_lock);
 						arp_send_buffered_pkts(arp_data->queue, hw_addr, portid);
+						arp_data->queue = NULL;
 						rte_rwlock_write_unlock(&arp_data->queue_lock);
 					}
 					arp_data->status = COMPLETE;
+#endif	/* ARP_LOCKLESS_QUEUE */
 				}
 			}
 			return;
@@ -1233,6 +1438,30 @@ epc_arp_icmp_init(void)
 		}
 		get_mac_ip_addr(arp_port_addresses, i);
 	}
+	params->n_ports_in = epc_app.n_ports;
+
+#ifdef HW_CTRL_STEERING
+	/* The NIC puts ARP and the pkts to the port ip on the control queue */
+	for (i = 0; i < epc_app.n_ports; i++) {
+		struct rte_port_ethdev_reader_params port_ethdev_params = {
+			.port_id = epc_app.ports[i],
+			.queue_id = epc_app.ctrl_queue,
+		};
+
+		struct rte_pipeline_port_in_params port_params = {
+			.ops = &rte_port_ethdev_reader_ops,
+			.arg_create = (void *)&port_ethdev_params,
+			.f_action = port_in_ah_arp_icmp_key,
+			.arg_ah = (void *)(uintptr_t)i,
+			.burst_size = epc_app.burst_size_rx_read
+		};
+
+		if (rte_pipeline_port_in_create(p, &port_params,
+				&params->port_in_id[params->n_ports_in++]))
+			rte_panic("%s: Unable to configure control queue of "
+					"port %u\n", __func__, i);
+	}
+#endif
 
 	/* Output ports */
 	for (i = 0; i < epc_app.n_ports; i++) {
@@ -1280,7 +1509,7 @@ epc_arp_icmp_init(void)
 	}
 
 
-	for (i = 0; i < epc_app.n_ports; i++) {
+	for (i = 0; i < params->n_ports_in; i++) {
 		int status = rte_pipeline_port_in_connect_to_table(p,
 				params->port_in_id[i],
 				params->table_id);
@@ -1290,7 +1519,7 @@ epc_arp_icmp_init(void)
 		}
 	}
 
-	for (i = 0; i < epc_app.n_ports; i++) {
+	for (i = 0; i < params->n_ports_in; i++) {
 		int status = rte_pipeline_port_in_enable(p,
 				params->port_in_id[i]);
 
@@ -1350,7 +1579,11 @@ void epc_arp_icmp(__rte_unused void *arg)
 {
 	struct epc_arp_icmp_params *param = &ai_params;
 
-	rte_pipeline_run(myP);
+	epc_stage_pkts_add(rte_pipeline_run(myP));
+#ifdef ARP_LOCKLESS_QUEUE
+	if (unlikely(arp_queue_recheck))
+		arp_queue_recheck_all();
+#endif	/* ARP_LOCKLESS_QUEUE */
 	if (++param->flush_count >= param->flush_max) {
 		rte_pipeline_flush(myP);
 		param->flush_count = 0;
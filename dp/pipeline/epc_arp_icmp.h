@@ -29,9 +29,11 @@
  */
 #define ARP_TIMEOUT 2
 /**
- * ring size.
+ * ring size, max pkts queued per unresolved neighbor.
  */
+#ifndef ARP_BUFFER_RING_SIZE
 #define ARP_BUFFER_RING_SIZE 128
+#endif
 /**
  * ARP entry populated and echo reply received.
  */
@@ -109,6 +111,25 @@ struct arp_entry_data {
 	rte_rwlock_t queue_lock;
 } __attribute__((packed));
 
+#ifdef ARP_LOCKLESS_QUEUE
+/**
+ * Per lcore counters of pkts queued for unresolved neighbors.
+ */
+struct arp_queue_stats {
+	/** pkts queued */
+	uint64_t queued;
+	/** pkts dropped, neighbor queue full */
+	uint64_t full;
+	/** pkts dropped, no mbuf to clone */
+	uint64_t no_mbuf;
+	/** queued pkts sent on resolution, counted by the ARP core */
+	uint64_t sent;
+} __rte_cache_aligned;
+
+/** Unresolved pkt counters of each lcore */
+extern struct arp_queue_stats arp_queue_stats[RTE_MAX_LCORE];
+#endif	/* ARP_LOCKLESS_QUEUE */
+
 /**
  * Print ARP packet.
  *
@@ -39,7 +39,25 @@
 #define OFFSET_PORT_ID	0
 
 
-static inline void epc_lb_set_port_id(struct rte_mbuf *m, uint32_t port_id)
+#ifdef LB_LOAD_SHEDDING
+uint16_t epc_ue_protected[EPC_UE_CLASS_SIZE];
+
+/**
+ * Check if pkt of UE is shed: its worker ring is filling up and the UE
+ * has no signalling or GBR bearer.
+ */
+static inline int
+epc_lb_shed(uint32_t core_id, uint32_t port_id, uint32_t hash)
+{
+	struct epc_load_balance_params *param = &epc_app.lb_params;
+	struct epc_ring_stats *s = param->work_ring_stats[core_id][port_id];
+
+	return (s->count >= param->shed_threshold) &&
+			!epc_ue_is_protected(hash);
+}
+#endif	/* LB_LOAD_SHEDDING */
+
+static inline uint32_t epc_lb_set_port_id(struct rte_mbuf *m, uint32_t port_id)
 {
 	struct epc_meta_data *meta_data =
 	    (struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(m, 128);
@@ -50,21 +68,41 @@ static inline void epc_lb_set_port_id(struct rte_mbuf *m, uint32_t port_id)
 	set_worker_core_id(&core_id, ue_ipv4_hash_offset);
 
 	*offset_port_id = port_id + (core_id << 1);
+	return core_id;
 }
 static int
 epc_lb_action_handler(struct rte_pipeline *p, struct rte_mbuf **pkts,
 			uint32_t n, void *arg)
 {
 	uint32_t i;
+#ifdef LB_LOAD_SHEDDING
+	uint64_t shed_mask = 0;
+	uint32_t port_id = (uint32_t) (uintptr_t) arg;
+#endif
 
 	RTE_SET_USED(p);
 	RTE_SET_USED(arg);
 
 	for (i = 0; i < n; i++) {
 		struct rte_mbuf *m = pkts[i];
-
-		epc_lb_set_port_id(m, (uint32_t) (uintptr_t) arg);
+		uint32_t core_id;
+
+		core_id = epc_lb_set_port_id(m, (uint32_t) (uintptr_t) arg);
+#ifdef LB_LOAD_SHEDDING
+		if (unlikely(epc_lb_shed(core_id, port_id,
+				((struct epc_meta_data *)
+				 RTE_MBUF_METADATA_UINT8_PTR(m, 128))->ue_ipv4_hash)))
+			shed_mask |= 1LLU << i;
+#else
+		RTE_SET_USED(core_id);
+#endif
 	}
+#ifdef LB_LOAD_SHEDDING
+	if (unlikely(shed_mask)) {
+		rte_pipeline_ah_packet_drop(p, shed_mask);
+		epc_app.lb_params.n_shed += __builtin_popcountll(shed_mask);
+	}
+#endif
 	return 0;
 }
 
@@ -72,12 +110,14 @@ epc_lb_action_handler(struct rte_pipeline *p, struct rte_mbuf **pkts,
 void epc_load_balance_init(struct epc_load_balance_params *param)
 {
 	unsigned i;
+	unsigned n_port_in = epc_app.n_ports * epc_app.n_queues;
 	struct rte_pipeline *p;
 
 	memset(param, 0, sizeof(*param));
 
 	snprintf((char *)param->name, PIPE_NAME_SIZE, "load_balance");
-	param->pipeline_params.socket_id = rte_socket_id();
+	param->pipeline_params.socket_id =
+		dp_lcore_socket(epc_app.core_load_balance);
 	param->pipeline_params.name = param->name;
 	param->pipeline_params.offset_port_id = 128;
 
@@ -85,17 +125,19 @@ void epc_load_balance_init(struct epc_load_balance_params *param)
 	if (p == NULL)
 		rte_panic("Unable to configure the pipeline\n");
 
-	/* Input port configuration */
-	for (i = 0; i < epc_app.n_ports; i++) {
+	/* Input port configuration, one per rx queue of each port */
+	for (i = 0; i < n_port_in; i++) {
+		uint32_t port = i / epc_app.n_queues;
+		uint32_t queue = i % epc_app.n_queues;
 		struct rte_port_ring_reader_params port_ring_params = {
-			.ring = epc_app.epc_lb_rx[i]
+			.ring = epc_app.epc_lb_rx[port][queue]
 		};
 
 		struct rte_pipeline_port_in_params port_params = {
 			.ops = &rte_port_ring_reader_ops,
 			.arg_create = (void *)&port_ring_params,
 			.f_action = epc_lb_action_handler,
-			.arg_ah = (void *)(uintptr_t) i,
+			.arg_ah = (void *)(uintptr_t) port,
 			.burst_size = epc_app.burst_size_rx_read
 		};
 
@@ -120,7 +162,7 @@ void epc_load_balance_init(struct epc_load_balance_params *param)
 		};
 
 		struct rte_pipeline_port_out_params port_params = {
-			.ops = &rte_port_ring_writer_ops,
+			.ops = &epc_port_ring_writer_ops,
 			.arg_create = (void *)&port_ring_params,
 			.f_action = NULL,
 			.arg_ah = NULL,
@@ -143,7 +185,17 @@ void epc_load_balance_init(struct epc_load_balance_params *param)
 			("%s: Unable to configure output port for ring RX %i\n",
 			     __func__, i);
 		}
+#ifdef LB_LOAD_SHEDDING
+		param->work_ring_stats[i][0] =
+				epc_ring_stats_get(epc_app.epc_work_rx[core_id][0]);
+		param->work_ring_stats[i][1] =
+				epc_ring_stats_get(epc_app.epc_work_rx[core_id][1]);
+#endif	/* LB_LOAD_SHEDDING */
 	}
+#ifdef LB_LOAD_SHEDDING
+	/* shed from 3/4 full, leaving room for protected bursts */
+	param->shed_threshold = epc_app.ring_rx_size / 4 * 3;
+#endif	/* LB_LOAD_SHEDDING */
 
 	/* table configuration */
 	/* Tables */
@@ -165,7 +217,7 @@ void epc_load_balance_init(struct epc_load_balance_params *param)
 		return;
 	}
 
-	for (i = 0; i < epc_app.n_ports; i++) {
+	for (i = 0; i < n_port_in; i++) {
 		int status = rte_pipeline_port_in_connect_to_table(p,
 								   i,
 								   param->
@@ -196,7 +248,7 @@ void epc_load_balance_init(struct epc_load_balance_params *param)
 	}
 
 	/* Enable input ports */
-	for (i = 0; i < epc_app.n_ports; i++) {
+	for (i = 0; i < n_port_in; i++) {
 		int status = rte_pipeline_port_in_enable(p, i);
 
 		if (status) {
@@ -222,10 +274,10 @@ void epc_load_balance(void *args)
 {
 	struct epc_load_balance_params *param =
 	    (struct epc_load_balance_params *)args;
+	uint32_t n = rte_pipeline_run(param->pipeline);
 
-	rte_pipeline_run(param->pipeline);
-	if (++param->flush_count >= param->flush_max) {
-		rte_pipeline_flush(param->pipeline);
-		param->flush_count = 0;
-	}
+	epc_stage_pkts_add(n);
+	epc_pipeline_flush(param->pipeline, &param->flush_count,
+			&param->flush_max, EPC_FLUSH_CTL(param), n,
+			epc_app.burst_size_rx_read);
 }
@@ -48,8 +48,26 @@
 #include "meter.h"
 #include "acl.h"
 #include "commands.h"
+#include "qsbr.h"
+#include "session_cdr.h"
+#ifdef CDR_ASYNC
+#include "cdr.h"
+#endif
+#ifdef PKT_CAPTURE
+#include "pkt_capture.h"
+#endif
+#ifdef PKT_MIRROR
+#include "pkt_mirror.h"
+#endif
+#ifdef DP_BENCH
+#include "bench.h"
+#endif
+#ifdef SESS_SNAPSHOT
+#include "sess_store.h"
+#endif
 
 struct rte_ring *epc_mct_spns_dns_rx;
+RTE_DEFINE_PER_LCORE(uint32_t, epc_stage_pkts);
 struct epc_app_params epc_app = {
 	/* Ports */
 	.n_ports = NUM_SPGW_PORTS,
@@ -65,16 +83,31 @@ struct epc_app_params epc_app = {
 	.burst_size_worker_write = EPC_BURST_SZ_64,
 	.burst_size_tx_read = EPC_DEFAULT_BURST_SZ,
 	.burst_size_tx_write = EPC_BURST_SZ_64,
+#ifdef ADAPTIVE_FLUSH
+	.flush_us = EPC_FLUSH_DEADLINE_US,
+#endif
+
+	.n_queues = 1,
 
-	.core_rx[S1U_PORT_ID] = -1,
-	.core_tx[S1U_PORT_ID] = -1,
-	.core_rx[SGI_PORT_ID] = -1,
-	.core_tx[SGI_PORT_ID] = -1,
+	.core_rx[S1U_PORT_ID][0] = -1,
+	.core_tx[S1U_PORT_ID][0] = -1,
+	.core_rx[SGI_PORT_ID][0] = -1,
+	.core_tx[SGI_PORT_ID][0] = -1,
 	.core_load_balance = -1,
 	.core_mct = -1,
 	.core_iface = -1,
 	.core_stats = -1,
 	.core_spns_dns = -1,
+	.num_spns_dns = 1,
+#ifdef CDR_ASYNC
+	.core_cdr = -1,
+#endif
+#ifdef PKT_CAPTURE
+	.core_capture = -1,
+#endif
+#ifdef DP_BENCH
+	.core_bench = -1,
+#endif
 };
 
 static void *dp_zmq_thread(__rte_unused void *arg)
@@ -83,6 +116,10 @@ static void *dp_zmq_thread(__rte_unused void *arg)
 		iface_remove_que(COMM_ZMQ);
 }
 
+/**
+ * iface pipeline: processes up to IFACE_MSG_BUDGET CP msgs per call and
+ * returns, so iface can share its lcore with other stages.
+ */
 static void epc_iface_core(__rte_unused void *args)
 {
 #ifdef SIMU_CP
@@ -91,97 +128,194 @@ static void epc_iface_core(__rte_unused void *args)
 	if (simu_call == 0) {
 		simu_cp();
 		simu_call = 1;
+#ifdef SIMU_CP_LOAD
+		simu_cp_load_start();
+#endif
 	}
 #else
-	uint32_t lcore;
+	static int iface_ready;
 
-	lcore = rte_lcore_id();
-	RTE_LOG(NOTICE, API, "RTE NOTICE enabled on lcore %d\n", lcore);
-	RTE_LOG(INFO, API, "RTE INFO enabled on lcore %d\n", lcore);
-	RTE_LOG(DEBUG, API, "RTE DEBUG enabled on lcore %d\n", lcore);
-#if defined(SDN_ODL_BUILD)
-	pthread_t t;
-	int err;
+	if (iface_ready == 0) {
+		uint32_t lcore;
 
-	err = pthread_create(&t, NULL, &dp_zmq_thread, NULL);
-	if (err != 0)
-		RTE_LOG(INFO, API, "\ncan't create ZMQ read thread :[%s]", strerror(err));
-	else
-		RTE_LOG(INFO, API, "\n ZMQ read thread created successfully\n");
+		lcore = rte_lcore_id();
+		RTE_LOG(NOTICE, API, "RTE NOTICE enabled on lcore %d\n", lcore);
+		RTE_LOG(INFO, API, "RTE INFO enabled on lcore %d\n", lcore);
+		RTE_LOG(DEBUG, API, "RTE DEBUG enabled on lcore %d\n", lcore);
+#if defined(SDN_ODL_BUILD)
+		pthread_t t;
+		int err;
+
+		err = pthread_create(&t, NULL, &dp_zmq_thread, NULL);
+		if (err != 0)
+			RTE_LOG(INFO, API, "\ncan't create ZMQ read thread :[%s]", strerror(err));
+		else
+			RTE_LOG(INFO, API, "\n ZMQ read thread created successfully\n");
 #endif  /* DP:(SDN_ODL_BUILD */
+		iface_ready = 1;
+	}
+#endif
 	/*
-	 * Poll message que. Populate hash table from que.
+	 * Poll message que. Populate hash table from que. With SIMU_CP,
+	 * msgs of the SIMU_CP_LOAD test.
 	 */
-	while (1)
-		iface_process_ipc_msgs();
+	epc_stage_pkts_add(iface_poll_ipc_msgs(IFACE_MSG_BUDGET));
+	dp_qsbr_reclaim();
+#ifdef DEFERRED_SESS_CDR
+	sess_cdr_snap_drain(SESS_CDR_SNAP_BUDGET);
+#endif
+#ifdef INTERIM_CDR
+	interim_cdr_poll(INTERIM_CDR_BUDGET);
+#endif
+#ifdef SESS_AGING
+	sess_age_poll(SESS_AGE_BUDGET);
+#endif
+	sess_cdr_flush_check();
+#ifndef SIMU_CP
+#ifdef PKT_MIRROR
+	mirror_select_poll(MIRROR_SELECT_BUDGET);
+#endif
+#ifdef DEFAULT_BEARER_FAST_PATH
+	sess_fast_path_poll(SESS_FAST_PATH_BUDGET);
+#endif
+#endif
+#ifdef SESS_SNAPSHOT
+	sess_store_poll();
 #endif
 }
 
+#define for_each_port(port) for (port = 0; port < epc_app.n_ports; port++)
+#define for_each_core(core) for (core = 0; core < DP_MAX_LCORE; core++)
+#define for_each_queue(q) for (q = 0; q < epc_app.n_queues; q++)
+
 static void epc_init_lcores(void)
 {
 	unsigned i;
+	uint32_t port;
+#ifndef RUN_TO_COMPLETION
+	uint32_t q;
+#endif
 
-	epc_alloc_lcore(epc_rx, &epc_app.rx_params[WEST_PORT_ID],
-						epc_app.core_rx[WEST_PORT_ID]);
-	epc_alloc_lcore(epc_rx, &epc_app.rx_params[EAST_PORT_ID],
-						epc_app.core_rx[EAST_PORT_ID]);
+#ifndef NIC_RSS_STEERING
+	for_each_port(port) {
+		for_each_queue(q)
+			epc_alloc_lcore(epc_rx, &epc_app.rx_params[port][q],
+						epc_app.core_rx[port][q],
+						epc_app.rx_params[port][q].name);
+	}
 
 	epc_alloc_lcore(epc_load_balance, &epc_app.lb_params,
-						epc_app.core_load_balance);
-	epc_alloc_lcore(epc_arp_icmp, NULL, epc_app.core_mct);
+						epc_app.core_load_balance,
+						epc_app.lb_params.name);
+#endif
+	epc_alloc_service(epc_arp_icmp, NULL, epc_app.core_mct, "arp_icmp",
+			EPC_SCHED_PRIO_HIGH, 1);
 
 	for (i = 0; i < epc_app.num_workers; i++) {
 		epc_alloc_lcore(epc_worker_core, &epc_app.worker[i],
-				epc_app.worker_cores[i]);
+				epc_app.worker_cores[i],
+				epc_app.worker[i].name);
 	}
 
-	epc_alloc_lcore(epc_tx, &epc_app.tx_params[WEST_PORT_ID],
-						epc_app.core_tx[WEST_PORT_ID]);
-	epc_alloc_lcore(epc_tx, &epc_app.tx_params[EAST_PORT_ID],
-						epc_app.core_tx[EAST_PORT_ID]);
-
-	epc_alloc_lcore(epc_iface_core, NULL, epc_app.core_iface);
+#if defined(RUN_TO_COMPLETION)
+	/* tx pipelines only drain the mct rings */
+	for_each_port(port)
+		epc_alloc_lcore(epc_tx, &epc_app.tx_params[port][0],
+						epc_app.core_mct,
+						epc_app.tx_params[port][0].name);
+#elif defined(WORKER_DIRECT_TX)
+	/* tx pipelines only drain the mct rings, next to rx queue 0 */
+	for_each_port(port)
+		epc_alloc_lcore(epc_tx, &epc_app.tx_params[port][0],
+						epc_app.core_tx[port][0],
+						epc_app.tx_params[port][0].name);
+#else
+	for_each_port(port) {
+		for_each_queue(q)
+			epc_alloc_lcore(epc_tx, &epc_app.tx_params[port][q],
+						epc_app.core_tx[port][q],
+						epc_app.tx_params[port][q].name);
+	}
+#endif
 
-	epc_alloc_lcore(scan_dns_ring, NULL, epc_app.core_spns_dns);
+	/* CP msgs are drained IFACE_MSG_BUDGET at a time */
+	epc_alloc_service(epc_iface_core, NULL, epc_app.core_iface, "iface",
+			EPC_SCHED_PRIO_HIGH, 4);
+
+	epc_alloc_service(scan_dns_ring, NULL, epc_app.core_spns_dns,
+			"spns_dns", EPC_SCHED_PRIO_NORMAL, 2);
+	for (i = 1; i < epc_app.num_spns_dns; i++)
+		epc_alloc_service(scan_dns_ring, NULL,
+				epc_app.core_spns_dns_extra[i - 1], "spns_dns",
+				EPC_SCHED_PRIO_NORMAL, 2);
+#ifdef CDR_ASYNC
+	epc_alloc_service(cdr_writer_core, NULL, epc_app.core_cdr,
+			"cdr_writer", EPC_SCHED_PRIO_NORMAL, 1);
+#endif
+#ifdef PKT_CAPTURE
+	epc_alloc_lcore(capture_core, NULL, epc_app.core_capture, "capture");
+#endif
+#ifdef PKT_MIRROR
+	if (mirror_on)
+		epc_alloc_service(mirror_core, NULL, epc_app.core_mct,
+				"mirror", EPC_SCHED_PRIO_NORMAL, 1);
+#endif
+#ifdef DP_BENCH
+	if (bench_on)
+		epc_alloc_lcore(bench_core, NULL, epc_app.core_bench, "bench");
+#endif
 #ifdef STATS
-	epc_alloc_lcore(epc_stats_core, NULL, epc_app.core_stats);
+	epc_alloc_service(epc_stats_core, NULL, epc_app.core_stats, "stats",
+			EPC_SCHED_PRIO_LOW, 1);
 #endif
 }
 
-#define for_each_port(port) for (port = 0; port < epc_app.n_ports; port++)
-#define for_each_core(core) for (core = 0; core < DP_MAX_LCORE; core++)
-
 /* initialize rings common to all pipelines */
 static void epc_init_rings(void)
 {
 	uint32_t i;
 	uint32_t port;
+#ifndef NIC_RSS_STEERING
+	uint32_t q;
 
-	/* create communication rings between RX-core and lb core */
+	/* create communication rings between RX-cores and lb core */
 	for_each_port(port) {
-		char name[32];
+		for_each_queue(q) {
+			char name[32];
 
-		snprintf(name, sizeof(name), "rx_to_lb_%u", port);
-		epc_app.epc_lb_rx[port] = rte_ring_create(name,
-				epc_app.ring_rx_size,
-				rte_socket_id(),
-				RING_F_SP_ENQ |
-				RING_F_SC_DEQ);
+			snprintf(name, sizeof(name), "rx_to_lb_%u_%u", port, q);
+			epc_app.epc_lb_rx[port][q] = rte_ring_create(name,
+					epc_app.ring_rx_size,
+					dp_lcore_socket(epc_app.core_load_balance),
+					RING_F_SP_ENQ |
+					RING_F_SC_DEQ);
 
-		if (epc_app.epc_lb_rx[port] == NULL)
-			rte_exit(EXIT_FAILURE,"Cannot create RX ring %u\n", port);
+			if (epc_app.epc_lb_rx[port][q] == NULL)
+				rte_exit(EXIT_FAILURE,"Cannot create RX ring %u\n",
+						port);
+		}
 	}
+#endif
 
 	/* create communication rings between RX-core and mct core */
 	for_each_port(port) {
 		char name[32];
 
 		snprintf(name, sizeof(name), "rx_to_mct_%u", port);
+#ifdef NIC_RSS_STEERING
+		/* every worker hands control packets to the mct core */
+		epc_app.epc_mct_rx[port] = rte_ring_create(name,
+				epc_app.ring_rx_size,
+				dp_lcore_socket(epc_app.core_mct),
+				RING_F_SC_DEQ);
+#else
+		/* rx pipelines of all queues of the port enqueue here */
 		epc_app.epc_mct_rx[port] = rte_ring_create(name,
 				epc_app.ring_rx_size,
-				rte_socket_id(),
-				RING_F_SP_ENQ |
+				dp_lcore_socket(epc_app.core_mct),
+				(epc_app.n_queues > 1 ? 0 : RING_F_SP_ENQ) |
 				RING_F_SC_DEQ);
+#endif
 		if (epc_app.epc_mct_rx[port] == NULL)
 			rte_exit(EXIT_FAILURE,"Cannot create RX ring %u\n", port);
 
@@ -194,11 +328,13 @@ static void epc_init_rings(void)
 	snprintf(name, sizeof(name), "rx_to_mct_spns_dns%u", port);
 	epc_mct_spns_dns_rx = rte_ring_create(name,
 				epc_app.ring_rx_size * 16,
-				rte_socket_id(),
-				RING_F_SC_DEQ);
+				dp_lcore_socket(epc_app.core_spns_dns),
+				epc_app.num_spns_dns > 1 ? 0 : RING_F_SC_DEQ);
 	if (epc_mct_spns_dns_rx == NULL)
 		rte_panic("Cannot create RX ring %u\n", port);
 
+	/* Rings are placed on the socket of the lcore dequeuing them, tx
+	 * rings on the socket of their port. */
 	for_each_port(port) {
 		/* Create transmit & receive rings per core */
 		for_each_core(i) {
@@ -208,7 +344,7 @@ static void epc_init_rings(void)
 					port);
 			epc_app.epc_work_rx[i][port] =
 				rte_ring_create(name, epc_app.ring_rx_size,
-						rte_socket_id(),
+						dp_lcore_socket(i),
 						RING_F_SP_ENQ | RING_F_SC_DEQ);
 
 			if (epc_app.epc_work_rx[i][port] == NULL)
@@ -218,13 +354,9 @@ static void epc_init_rings(void)
 					port);
 
 			epc_app.ring_tx[i][port] = rte_ring_create(name,
-					epc_app.
-					ring_tx_size,
-					rte_socket_id
-					(),
-					RING_F_SP_ENQ
-					|
-					RING_F_SC_DEQ);
+					epc_app.ring_tx_size,
+					dp_port_socket(epc_app.ports[port]),
+					RING_F_SP_ENQ | RING_F_SC_DEQ);
 
 			if (epc_app.ring_tx[i][port] == NULL)
 				rte_exit(EXIT_FAILURE,"Cannot create TX ring %u\n", i);
@@ -258,8 +390,29 @@ static inline void epc_run_pipeline(void)
 		}
 	} else
 #endif
+	{
+#ifdef SERVICE_SCHED
+		uint64_t prev_tsc = rte_rdtsc();
+		uint32_t pkts = 0;
+
 		for (i = 0; i < config->allocated; i++)
+			pkts += epc_sched_run(&config->launch[i], &prev_tsc);
+		epc_sched_idle(config, pkts);
+#else
+		uint64_t prev_tsc = rte_rdtsc(), cur_tsc;
+
+		for (i = 0; i < config->allocated; i++) {
+			RTE_PER_LCORE(epc_stage_pkts) = 0;
 			config->launch[i].func(config->launch[i].arg);
+			cur_tsc = rte_rdtsc();
+			epc_stage_stats_update(&config->launch[i].stats,
+					cur_tsc - prev_tsc,
+					RTE_PER_LCORE(epc_stage_pkts));
+			prev_tsc = cur_tsc;
+		}
+#endif	/* SERVICE_SCHED */
+	}
+	dp_qsbr_quiescent(lcore);
 }
 static int epc_lcore_main_loop(__attribute__ ((unused))
 		void *arg)
@@ -285,6 +438,9 @@ static int epc_lcore_main_loop(__attribute__ ((unused))
 	RTE_LOG(INFO, DP, "RTE INFO enabled on lcore %d\n", lcore);
 	RTE_LOG(DEBUG, DP, "RTE DEBUG enabled on lcore %d\n", lcore);
 
+	if (lcore != (uint32_t)epc_app.core_iface)
+		dp_qsbr_register(lcore);
+
 	while (1)
 		epc_run_pipeline();
 
@@ -294,6 +450,10 @@ static int epc_lcore_main_loop(__attribute__ ((unused))
 void epc_init_packet_framework(uint8_t east_port_id, uint8_t west_port_id)
 {
 	unsigned i;
+	uint32_t port;
+#ifndef RUN_TO_COMPLETION
+	uint32_t q;
+#endif
 
 	if (epc_app.n_ports > NUM_SPGW_PORTS) {
 		printf("number of ports exceeds a configured number %d\n",
@@ -303,18 +463,41 @@ void epc_init_packet_framework(uint8_t east_port_id, uint8_t west_port_id)
 
 	epc_app.ports[WEST_PORT_ID] = west_port_id;
 	epc_app.ports[EAST_PORT_ID] = east_port_id;
-	RTE_LOG(INFO, DP, "west rx/tx running on lcore    :\t%d\n",
-						epc_app.core_rx[WEST_PORT_ID]);
-	RTE_LOG(INFO, DP, "east rx/tx running on lcore    :\t%d\n",
-						epc_app.core_rx[EAST_PORT_ID]);
+#ifdef RUN_TO_COMPLETION
+	RTE_LOG(INFO, DP, "rx/tx run to completion on worker lcores\n");
+#else
+	for_each_queue(q) {
+		RTE_LOG(INFO, DP, "west rx/tx q%u running on lcore :\t%d\n",
+				q, epc_app.core_rx[WEST_PORT_ID][q]);
+		RTE_LOG(INFO, DP, "east rx/tx q%u running on lcore :\t%d\n",
+				q, epc_app.core_rx[EAST_PORT_ID][q]);
+	}
+#endif
+#ifdef NIC_RSS_STEERING
+	RTE_LOG(INFO, DP, "load balancer disabled, workers poll NIC rx queues\n");
+#else
 	RTE_LOG(INFO, DP, "load balancer running on lcore:\t%d\n",
 						epc_app.core_load_balance);
+#endif
 	RTE_LOG(INFO, DP, "multicast running on lcore    :\t%d\n",
 						epc_app.core_mct);
 	RTE_LOG(INFO, DP, "iface running on lcore        :\t%d\n",
 						epc_app.core_iface);
 	RTE_LOG(INFO, DP, "spns dns running on lcore        :\t%d\n",
 						epc_app.core_spns_dns);
+#ifdef CDR_ASYNC
+	RTE_LOG(INFO, DP, "cdr writer running on lcore   :\t%d\n",
+						epc_app.core_cdr);
+#endif
+#ifdef PKT_CAPTURE
+	RTE_LOG(INFO, DP, "capture running on lcore      :\t%d\n",
+						epc_app.core_capture);
+#endif
+#ifdef DP_BENCH
+	if (bench_on)
+		RTE_LOG(INFO, DP, "bench running on lcore        :\t%d\n",
+						epc_app.core_bench);
+#endif
 
 
 #ifdef STATS
@@ -335,22 +518,41 @@ void epc_init_packet_framework(uint8_t east_port_id, uint8_t west_port_id)
 	/*
 	 * Initialize pipelines
 	 */
-	epc_tx_init(&epc_app.tx_params[WEST_PORT_ID],
-				epc_app.core_rx[WEST_PORT_ID], WEST_PORT_ID);
-	epc_tx_init(&epc_app.tx_params[EAST_PORT_ID],
-				epc_app.core_rx[EAST_PORT_ID], EAST_PORT_ID);
+#if defined(RUN_TO_COMPLETION)
+	for_each_port(port)
+		epc_tx_init(&epc_app.tx_params[port][0],
+				epc_app.core_mct, port, 0);
+#elif defined(WORKER_DIRECT_TX)
+	for_each_port(port)
+		epc_tx_init(&epc_app.tx_params[port][0],
+				epc_app.core_tx[port][0], port, 0);
+#else
+	for_each_port(port) {
+		for_each_queue(q)
+			epc_tx_init(&epc_app.tx_params[port][q],
+				epc_app.core_tx[port][q], port, q);
+	}
+#endif
 
 	epc_arp_icmp_init();
+#ifdef NIC_RSS_STEERING
+	for (i = 0; i < epc_app.num_workers; i++)
+		epc_app.worker_core_mapping[epc_app.worker_cores[i]] = i;
+#else
 	epc_load_balance_init(&epc_app.lb_params);
+#endif
 
 	for (i = 0; i < epc_app.num_workers; i++)
 		epc_worker_core_init(&epc_app.worker[i],
 				epc_app.worker_cores[i], i);
 
-	epc_rx_init(&epc_app.rx_params[WEST_PORT_ID],
-				epc_app.core_rx[WEST_PORT_ID], WEST_PORT_ID);
-	epc_rx_init(&epc_app.rx_params[EAST_PORT_ID],
-				epc_app.core_rx[EAST_PORT_ID], EAST_PORT_ID);
+#ifndef NIC_RSS_STEERING
+	for_each_port(port) {
+		for_each_queue(q)
+			epc_rx_init(&epc_app.rx_params[port][q],
+				epc_app.core_rx[port][q], port, q);
+	}
+#endif
 
 	/*
 	 * Assign pipelines to cores
@@ -440,7 +642,31 @@ void packet_framework_launch(void)
 		rte_exit(EXIT_FAILURE,"MP remote lauch fail !!!");
 }
 
-void epc_alloc_lcore(pipeline_func_t func, void *arg, int core)
+void epc_ctrl_thread_pin(pthread_t t, const char *name)
+{
+	long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	rte_cpuset_t set;
+	unsigned lcore;
+	long cpu;
+
+	CPU_ZERO(&set);
+	for (cpu = 0; cpu < nb_cpus && cpu < CPU_SETSIZE; cpu++)
+		CPU_SET(cpu, &set);
+	RTE_LCORE_FOREACH(lcore) {
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &lcore_config[lcore].cpuset))
+				CPU_CLR(cpu, &set);
+	}
+	/* no spare CPU, share the one of the control lcore */
+	if (CPU_COUNT(&set) == 0 && epc_app.core_iface >= 0)
+		set = lcore_config[epc_app.core_iface].cpuset;
+
+	if (pthread_setaffinity_np(t, sizeof(set), &set) != 0)
+		RTE_LOG(ERR, DP, "Cannot pin %s thread\n", name);
+}
+
+void epc_alloc_lcore(pipeline_func_t func, void *arg, int core,
+		const char *name)
 {
 	struct epc_lcore_config *lcore;
 
@@ -449,8 +675,123 @@ void epc_alloc_lcore(pipeline_func_t func, void *arg, int core)
 				DP_MAX_LCORE);
 
 	lcore = &epc_app.lcores[core];
+	if (lcore->allocated >= EPC_PIPELINE_MAX)
+		rte_exit(EXIT_FAILURE,"%s: Core %d runs more than %d pipelines\n",
+				__func__, core, EPC_PIPELINE_MAX);
+
 	lcore->launch[lcore->allocated].func = func;
 	lcore->launch[lcore->allocated].arg = arg;
+	lcore->launch[lcore->allocated].name = name;
+#ifdef SERVICE_SCHED
+	lcore->launch[lcore->allocated].weight = 1;
+	lcore->launch[lcore->allocated].prio = EPC_SCHED_PRIO_HIGH;
+	lcore->packet_stages++;
+#endif	/* SERVICE_SCHED */
+
+	lcore->allocated++;
+}
+
+#ifdef SERVICE_SCHED
+static const uint16_t epc_sched_backoff[EPC_SCHED_PRIO_MAX] = {
+	[EPC_SCHED_PRIO_LOW] = EPC_SCHED_BACKOFF_LOW,
+	[EPC_SCHED_PRIO_NORMAL] = EPC_SCHED_BACKOFF_NORMAL,
+	[EPC_SCHED_PRIO_HIGH] = EPC_SCHED_BACKOFF_HIGH,
+};
+
+void epc_alloc_service(pipeline_func_t func, void *arg, int core,
+		const char *name, enum epc_sched_prio prio, uint16_t weight)
+{
+	struct epc_lcore_config *lcore;
+	struct pipeline_launch *l;
+	int i;
+
+	if (core >= DP_MAX_LCORE)
+		rte_exit(EXIT_FAILURE,"%s: Core %d exceed Max core %d\n", __func__, core,
+				DP_MAX_LCORE);
+
+	lcore = &epc_app.lcores[core];
+	if (lcore->allocated >= EPC_PIPELINE_MAX)
+		rte_exit(EXIT_FAILURE,"%s: Core %d runs more than %d pipelines\n",
+				__func__, core, EPC_PIPELINE_MAX);
+
+	/* keep the launch list in priority order */
+	for (i = lcore->allocated; i > 0; i--) {
+		if (lcore->launch[i - 1].prio >= prio)
+			break;
+		lcore->launch[i] = lcore->launch[i - 1];
+	}
+
+	l = &lcore->launch[i];
+	memset(l, 0, sizeof(*l));
+	l->func = func;
+	l->arg = arg;
+	l->name = name;
+	l->weight = RTE_MAX(weight, 1);
+	l->backoff_max = epc_sched_backoff[prio];
+	l->prio = prio;
 
 	lcore->allocated++;
 }
+
+/**
+ * Run a pipeline function of the round, up to its weight while it finds
+ * work. An idle service is then skipped for twice as many rounds as
+ * after its previous idle call, up to its backoff_max.
+ *
+ * @return
+ *	packets processed
+ */
+static inline uint32_t
+epc_sched_run(struct pipeline_launch *l, uint64_t *prev_tsc)
+{
+	uint64_t cur_tsc;
+	uint32_t pkts, total = 0;
+	uint16_t i;
+
+	if (l->skip) {
+		l->skip--;
+		return 0;
+	}
+
+	for (i = 0; i < l->weight; i++) {
+		RTE_PER_LCORE(epc_stage_pkts) = 0;
+		l->func(l->arg);
+		pkts = RTE_PER_LCORE(epc_stage_pkts);
+		cur_tsc = rte_rdtsc();
+		epc_stage_stats_update(&l->stats, cur_tsc - *prev_tsc, pkts);
+		*prev_tsc = cur_tsc;
+		if (pkts == 0)
+			break;
+		total += pkts;
+	}
+
+	if (total != 0) {
+		l->backoff = 0;
+	} else if (l->backoff_max != 0) {
+		l->backoff = l->backoff ?
+			RTE_MIN(2 * l->backoff, l->backoff_max) : 1;
+		l->skip = l->backoff;
+	}
+	return total;
+}
+
+/**
+ * Back off an lcore that did no work for EPC_SCHED_IDLE_ROUNDS rounds.
+ * Lcores running only services sleep, the others pause.
+ */
+static inline void
+epc_sched_idle(struct epc_lcore_config *config, uint32_t pkts)
+{
+	if (pkts != 0) {
+		config->idle_rounds = 0;
+		return;
+	}
+	if (++config->idle_rounds < EPC_SCHED_IDLE_ROUNDS)
+		return;
+
+	if ((config->packet_stages == 0) && app.idle_sleep_us)
+		usleep(app.idle_sleep_us);
+	else
+		rte_pause();
+}
+#endif	/* SERVICE_SCHED */
@@ -22,8 +22,16 @@
  * This file contains data structure definitions to describe Data Plane
  * pipeline and function prototypes used to initialize pipeline.
  */
+#include <pthread.h>
+
 #include <rte_pipeline.h>
+#include <rte_ring.h>
 #include <rte_hash_crc.h>
+#include <rte_per_lcore.h>
+#include <rte_cycles.h>
+#ifdef NIC_RSS_STEERING
+#include <rte_thash.h>
+#endif
 
 extern uint64_t num_dns_processed;
 
@@ -64,6 +72,124 @@ extern uint64_t num_dns_processed;
 #define DL_PKT_POOL_CACHE_SIZE 32
 #define DL_PKTS_RING_SIZE 1024
 
+#ifdef DDN_BUF_POOL
+/** Paging buffers per worker, one per session with buffered DL pkts */
+#ifndef DDN_BUF_UES
+#define DDN_BUF_UES 1024
+#endif
+/** DL pkts buffered per session, the oldest ones are evicted beyond */
+#ifndef DDN_BUF_UE_PKTS
+#define DDN_BUF_UE_PKTS 64
+#endif
+/** DL bytes buffered per session, the oldest pkts are evicted beyond */
+#ifndef DDN_BUF_UE_BYTES
+#define DDN_BUF_UE_BYTES (64 * 1024)
+#endif
+/** DL pkts buffered by all the workers, new pkts are dropped beyond.
+ * Keeps paging from draining the port mbuf pools */
+#ifndef DDN_BUF_PKTS
+#define DDN_BUF_PKTS 4096
+#endif
+
+/** Buffered DL pkts released per worker run */
+#ifndef DDN_RELEASE_BURST
+#define DDN_RELEASE_BURST 32
+#endif
+/** Entries of the release queue, room for stale entries of deleted
+ * sessions */
+#define DDN_RELEASE_QUEUE_SZ (2 * DDN_BUF_UES)
+
+/** Sessions whose paging buffer is being released, round robin */
+struct ddn_release_queue {
+	uint64_t sess_id[DDN_RELEASE_QUEUE_SZ];
+	uint32_t head;
+	uint32_t n;
+};
+
+/** Paging buffer counters of a worker, updated by the worker only */
+struct ddn_buf_stats {
+	uint64_t buffered;	/** pkts buffered */
+	uint64_t released;	/** pkts sent once the session is modified */
+	uint64_t evicted;	/** oldest pkts dropped at the session cap */
+	uint64_t no_buf;	/** pkts dropped, no paging buffer left */
+	uint64_t full;		/** pkts dropped at DDN_BUF_PKTS */
+	uint64_t closed;	/** pkts dropped, session being deleted */
+};
+#endif	/* DDN_BUF_POOL */
+
+#if defined(RUN_TO_COMPLETION) && !defined(NIC_RSS_STEERING)
+#error "RUN_TO_COMPLETION requires NIC_RSS_STEERING"
+#endif
+
+/* Uplink RSS hashes the outer header, not the UE ip of the shard */
+#if defined(SHARDED_SESS_TABLE) && \
+	(defined(NIC_RSS_STEERING) || defined(SKIP_LB_GTPU_AH))
+#error "SHARDED_SESS_TABLE requires load balancer steering on UE ip"
+#endif
+
+/* Reclaim deletes sessions on the iface core, the ZMQ thread updates the
+ * session table concurrently */
+#if defined(SESS_AGING) && defined(SDN_ODL_BUILD)
+#error "SESS_AGING is not supported with SDN_ODL_BUILD"
+#endif
+
+/* The bypass rx ring is read by the rx core of the S5/S8 port */
+#if defined(S5S8_BYPASS) && defined(NIC_RSS_STEERING)
+#error "S5S8_BYPASS is not supported with NIC_RSS_STEERING"
+#endif
+
+/* Run to completion workers transmit on their own tx queues */
+#if defined(RUN_TO_COMPLETION) && !defined(WORKER_DIRECT_TX)
+#define WORKER_DIRECT_TX
+#endif
+
+#if defined(WORKER_DIRECT_TX) && defined(RX_LB_TX)
+#error "RX_LB_TX sends through the worker to tx core rings"
+#endif
+
+#ifdef WORKER_DIRECT_TX
+/**
+ * NIC tx queue used for packets originated by the mct core, worker i
+ * transmits on queue i.
+ */
+#define EPC_MCT_TX_QUEUE	(epc_app.num_workers)
+#endif	/* WORKER_DIRECT_TX */
+
+#ifdef EGRESS_QOS
+#if defined(WORKER_DIRECT_TX) || defined(RX_LB_TX)
+#error "EGRESS_QOS requires the worker to tx core rings"
+#endif
+
+/** Egress scheduler subports of each tx port, eNBs are hashed on them */
+#define EGRESS_QOS_SUBPORTS	4
+/** Egress scheduler pipes of each subport, UEs are hashed on them */
+#define EGRESS_QOS_PIPES	8
+/** Egress scheduler queue size, in pkts, halved until the schedulers
+ * of a port fit EGRESS_QOS_MBUFS */
+#define EGRESS_QOS_QSIZE	8
+/** mbufs of a port the egress schedulers of its tx queues may hold, the
+ * rest of the NUM_MBUFS of the port are left to rx */
+#define EGRESS_QOS_MBUFS	(NUM_MBUFS / 2)
+
+/** Egress traffic classes, strict priority from 0 */
+enum egress_qos_tc {
+	EGRESS_QOS_TC_SIGNALLING,	/**< IMS signalling and control pkts */
+	EGRESS_QOS_TC_GBR,		/**< GBR bearers */
+	EGRESS_QOS_TC_PRIO,		/**< prioritized non GBR bearers */
+	EGRESS_QOS_TC_BE,		/**< best effort */
+};
+#endif	/* EGRESS_QOS */
+
+#ifdef NIC_RSS_STEERING
+/**
+ * RSS hash key length.
+ */
+#define EPC_RSS_KEY_LEN	40
+
+/** RSS hash key programmed on the untunneled SGi port */
+extern uint8_t epc_rss_key[EPC_RSS_KEY_LEN];
+#endif	/* NIC_RSS_STEERING */
+
 /* Borrowed from dpdk ip_frag_internal.c */
 #define PRIME_VALUE	0xeaad8405
 
@@ -89,7 +215,28 @@ struct epc_meta_data {
 	uint32_t teid;
 	/** DL Bearer Map key */
 	struct dl_bm_key key;
+#ifdef PKT_LATENCY
+	/** TSC at rx, used to measure the rx to tx latency */
+	uint64_t rx_tsc;
+#endif
+};
+
+#ifdef PKT_LATENCY
+/* Sub buckets per power of two of the latency histogram */
+#define EPC_LAT_SUB_BITS	2
+#define EPC_LAT_BUCKETS		(64 << EPC_LAT_SUB_BITS)
+
+/** rx to tx latency histogram, in cycles */
+struct epc_latency_hist {
+	/** Number of samples */
+	uint64_t count;
+	/** Max latency seen */
+	uint64_t max;
+	/** Samples per bucket, each power of two is split in
+	 * 1 << EPC_LAT_SUB_BITS buckets */
+	uint64_t hist[EPC_LAT_BUCKETS];
 };
+#endif	/* PKT_LATENCY */
 
 /*
  * Defines the frequency when each pipeline stage should be flushed.
@@ -104,6 +251,35 @@ struct epc_meta_data {
  */
 #define EPC_PIPELINE_FLUSH_MAX	1
 
+#ifdef ADAPTIVE_FLUSH
+/*
+ * With ADAPTIVE_FLUSH the runs between flushes double, up to
+ * EPC_FLUSH_MAX_ADAPT, while each run reads a full burst, so that the
+ * writers send full bursts, and drop back to 1 as soon as a run reads
+ * less than a quarter burst. Buffered packets are flushed at the latest
+ * --flush_us after the previous flush.
+ */
+#define EPC_FLUSH_MAX_ADAPT	16
+/** Default flush deadline, us */
+#define EPC_FLUSH_DEADLINE_US	20
+
+/** Flush controller of a pipeline */
+struct epc_flush_ctl {
+	/** Packets read since last flush */
+	uint32_t pending;
+	/** Flush the pending packets at this tsc at the latest */
+	uint64_t deadline;
+};
+#define EPC_FLUSH_CTL(param)	(&(param)->flush_ctl)
+#else
+#define EPC_FLUSH_CTL(param)	NULL
+#endif	/* ADAPTIVE_FLUSH */
+
+/**
+ * Number of log2(packets) buckets of the stage burst size histograms.
+ */
+#define EPC_BURST_HIST_BUCKETS	8
+
 /*
  * Can only support as many lcores as the number of ports allowed in
  * a pipeline block
@@ -111,16 +287,144 @@ struct epc_meta_data {
 
 #define DP_MAX_LCORE RTE_PIPELINE_PORT_OUT_MAX
 
+/**
+ * Max number of NIC rx/tx queues per port, each queue served by its own
+ * rx and tx pipeline instance.
+ */
+#define EPC_MAX_PORT_QUEUES	4
+
+/**
+ * Max number of lcores sharing the sponsored DNS ring.
+ */
+#define EPC_MAX_SPNS_DNS	4
+
+/**
+ * Number of log2(cycles) buckets of the stage histograms.
+ */
+#define EPC_STAGE_HIST_BUCKETS	32
+
+/** Cycle accounting of one pipeline stage */
+struct epc_stage_stats {
+	/** Number of runs */
+	uint64_t calls;
+	/** Runs that processed at least one packet */
+	uint64_t busy_calls;
+	/** Cycles spent in busy runs */
+	uint64_t busy_cycles;
+	/** Cycles spent in idle runs */
+	uint64_t idle_cycles;
+	/** Packets processed */
+	uint64_t pkts;
+	/** Histogram of busy run cycles, bucket i holds [2^i, 2^(i+1)) */
+	uint64_t hist[EPC_STAGE_HIST_BUCKETS];
+	/** Histogram of busy run packets, bucket i holds [2^i, 2^(i+1)) */
+	uint64_t burst_hist[EPC_BURST_HIST_BUCKETS];
+};
+
+/**
+ * Max rings written through epc_port_ring_writer_ops.
+ */
+#define EPC_RING_STATS_MAX	(4 * DP_MAX_LCORE)
+
+/** Occupancy and drops of a ring written by a pipeline */
+struct epc_ring_stats {
+	/** Ring name */
+	char name[RTE_RING_NAMESIZE];
+	/** Ring */
+	struct rte_ring *ring;
+	/** Packets enqueued */
+	uint64_t n_pkts;
+	/** Packets dropped, ring full */
+	uint64_t n_drops;
+	/** Occupancy after the last enqueue */
+	uint32_t count;
+	/** Occupancy high watermark */
+	uint32_t hwm;
+} __rte_cache_aligned;
+
+/** Stats of the rings written through epc_port_ring_writer_ops */
+extern struct epc_ring_stats epc_ring_stats[EPC_RING_STATS_MAX];
+/** Number of epc_ring_stats entries in use */
+extern uint32_t epc_ring_stats_count;
+
+/**
+ * Ring writer port, same as rte_port_ring_writer_ops with per ring
+ * occupancy and drop stats, the writer parameters are passed in
+ * struct rte_port_ring_writer_params.
+ */
+extern struct rte_port_out_ops epc_port_ring_writer_ops;
+
+/**
+ * Get the stats of a ring, allocating them on first use. Called at
+ * init only.
+ *
+ * @param ring
+ *	Ring
+ *
+ * @return
+ *	ring stats, NULL if all are in use
+ */
+struct epc_ring_stats *epc_ring_stats_get(struct rte_ring *ring);
+
+#ifdef LB_LOAD_SHEDDING
+#ifdef NIC_RSS_STEERING
+#error "LB_LOAD_SHEDDING requires the load balancer"
+#endif
+
+/** UE slots of the load shedding class table, power of 2 */
+#define EPC_UE_CLASS_SIZE	(1 << 16)
+
+/**
+ * Count of signalling and GBR bearers of the UEs hashed on each slot,
+ * indexed by ue_ipv4_hash. UEs with none are shed first when a worker
+ * ring fills.
+ */
+extern uint16_t epc_ue_protected[EPC_UE_CLASS_SIZE];
+
+/**
+ * Check if UE has a signalling or GBR bearer.
+ *
+ * @param hash
+ *	ue_ipv4_hash of UE.
+ *
+ * @return
+ *	non zero if UE pkts are not shed.
+ */
+static inline int
+epc_ue_is_protected(uint32_t hash)
+{
+	return epc_ue_protected[hash & (EPC_UE_CLASS_SIZE - 1)] != 0;
+}
+#endif	/* LB_LOAD_SHEDDING */
+
+/** Processing stages inside the worker packet handlers */
+enum epc_wk_stage {
+	WK_STAGE_DECAP,
+	WK_STAGE_UL_FILTER,
+	WK_STAGE_DL_FILTER,
+	WK_STAGE_ENCAP,
+	WK_STAGE_NEXTHOP,
+	WK_STAGE_MAX
+};
+
 /** Rx pipeline parameters - Per input port */
 struct epc_rx_params {
 	/** Count since last flush */
 	int flush_count;
 	/** Number of pipeline runs between flush */
 	int flush_max;
+#ifdef ADAPTIVE_FLUSH
+	/** Flush controller */
+	struct epc_flush_ctl flush_ctl;
+#endif
 	/** RTE pipeline params */
 	struct rte_pipeline_params pipeline_params;
 	/** Input port id */
 	uint32_t port_in_id;
+#ifdef S5S8_BYPASS
+	/** Input port of the S5/S8 bypass rx ring, queue 0 of the port */
+	uint32_t port_in_bypass_id;
+#endif
 	/** Output port IDs  [0]-> load balance, [1]-> master
 	  * control thr
 	  */
@@ -139,18 +443,38 @@ struct epc_tx_params {
 	int flush_count;
 	/** Number of pipeline runs between flush */
 	int flush_max;
+#ifdef ADAPTIVE_FLUSH
+	/** Flush controller */
+	struct epc_flush_ctl flush_ctl;
+#endif
 	/** RTE pipeline params */
 	struct rte_pipeline_params pipeline_params;
 	/** Input port id */
 	uint32_t port_in_id[DP_MAX_LCORE];
+	/** Number of input ports */
+	uint32_t n_port_in;
 	/** Output port IDs */
 	uint32_t port_out_id;
 	/** Table ID - ports connect to this table */
 	uint32_t table_id;
+#ifdef EGRESS_QOS
+	/** Egress scheduler of the tx queue */
+	struct rte_sched_port *sched;
+	/** Scheduler writer port ID, the input ports send to it */
+	uint32_t sched_port_out_id;
+	/** Scheduler reader port ID */
+	uint32_t sched_port_in_id;
+	/** Table ID - the scheduler reader connects to this table */
+	uint32_t sched_table_id;
+#endif	/* EGRESS_QOS */
 	/** RTE pipeline */
 	struct rte_pipeline *pipeline;
 	/** pipeline name */
 	char name[PIPE_NAME_SIZE];
+#ifdef PKT_LATENCY
+	/** rx to tx latency of the packets sent by the workers */
+	struct epc_latency_hist latency;
+#endif
 } __rte_cache_aligned;
 
 /** Load Balance pipeline parameters - Per output port */
@@ -159,16 +483,28 @@ struct epc_load_balance_params {
 	int flush_count;
 	/** Number of pipeline runs between flush */
 	int flush_max;
+#ifdef ADAPTIVE_FLUSH
+	/** Flush controller */
+	struct epc_flush_ctl flush_ctl;
+#endif
 	/** RTE pipeline params */
 	struct rte_pipeline_params pipeline_params;
 	/** Input port id */
-	uint32_t port_in_id[NUM_SPGW_PORTS];
+	uint32_t port_in_id[NUM_SPGW_PORTS * EPC_MAX_PORT_QUEUES];
 	/** Output port IDs */
 	uint32_t port_out_id[DP_MAX_LCORE][NUM_SPGW_PORTS];
 	/** Both input ports connect to this table, default entry uses metadata
 	  * to decide output port
 	  */
 	uint32_t table_id;
+#ifdef LB_LOAD_SHEDDING
+	/** Stats of the worker rings, by worker index and port */
+	struct epc_ring_stats *work_ring_stats[DP_MAX_LCORE][NUM_SPGW_PORTS];
+	/** Worker ring occupancy from which unprotected UEs are shed */
+	uint32_t shed_threshold;
+	/** Packets shed */
+	uint64_t n_shed;
+#endif	/* LB_LOAD_SHEDDING */
 	/** RTE pipeline */
 	struct rte_pipeline *pipeline;
 	/** pipeline name */
@@ -181,6 +517,10 @@ struct epc_worker_params {
 	int flush_count;
 	/** Number of pipeline runs between flush */
 	int flush_max;
+#ifdef ADAPTIVE_FLUSH
+	/** Flush controller */
+	struct epc_flush_ctl flush_ctl;
+#endif
 	/** RTE pipeline params */
 	struct rte_pipeline_params pipeline_params;
 	/** Input port id */
@@ -201,44 +541,107 @@ struct epc_worker_params {
 	char name[PIPE_NAME_SIZE];
 	/** Number of dns packets cloned by this worker */
 	uint64_t num_dns_packets;
+#ifdef DDN_BUF_POOL
+	/** Paging buffers of the sessions handled by this worker */
+	struct rte_mempool *ddn_buf_pool;
+	/** Paging buffer counters */
+	struct ddn_buf_stats ddn_stats;
+	/** Paging buffers being released */
+	struct ddn_release_queue ddn_release;
+#else
 	/** Holds a set of rings to be used for downlink data buffering */
 	struct rte_ring *dl_ring_container;
 	/** Number of DL rings currently created */
 	uint32_t num_dl_rings;
+#endif	/* DDN_BUF_POOL */
 	/** For notification of modify_session so that buffered packets
 	 * can be dequeued*/
 	struct rte_ring *notify_ring;
 	/** Pool for notification msg pkts */
 	struct rte_mempool *notify_msg_pool;
+	/** Cycle accounting of the packet handler stages */
+	struct epc_stage_stats stage[WK_STAGE_MAX];
+#if defined(PKT_LATENCY) && defined(WORKER_DIRECT_TX)
+	/** rx to tx latency per output port, workers transmit directly */
+	struct epc_latency_hist latency[NUM_SPGW_PORTS];
+#endif
 } __rte_cache_aligned;
 
 typedef int (*epc_packet_handler) (struct rte_pipeline*, struct rte_mbuf **pkts,
 		uint32_t n, int wk_index);
 
-/* defines max number of pipelines per core */
-#define EPC_PIPELINE_MAX	4
+/* defines max number of pipelines per core: arp/icmp, iface, dns, cdr,
+ * stats, mirror, capture and bench can all be put on one core */
+#define EPC_PIPELINE_MAX	8
 typedef void pipeline_func_t(void *param);
 
+#ifdef SERVICE_SCHED
+/**
+ * Priorities of the service functions sharing an lcore. Higher ones run
+ * first in each round and are skipped for fewer rounds when idle.
+ */
+enum epc_sched_prio {
+	EPC_SCHED_PRIO_LOW,
+	EPC_SCHED_PRIO_NORMAL,
+	EPC_SCHED_PRIO_HIGH,
+	EPC_SCHED_PRIO_MAX
+};
+
+/** Rounds an idle service is skipped for at most, per priority */
+#define EPC_SCHED_BACKOFF_LOW		256
+#define EPC_SCHED_BACKOFF_NORMAL	32
+#define EPC_SCHED_BACKOFF_HIGH		4
+
+/** Idle rounds of an lcore before it pauses or sleeps */
+#define EPC_SCHED_IDLE_ROUNDS		64
+#endif	/* SERVICE_SCHED */
+
 struct pipeline_launch {
 	pipeline_func_t *func;	/* pipeline function called */
 	void *arg;		/* pipeline function argument */
+	const char *name;	/* stage name */
+	struct epc_stage_stats stats;	/* stage cycle accounting */
+#ifdef SERVICE_SCHED
+	uint16_t weight;	/* calls per round while the function is busy */
+	uint16_t backoff_max;	/* rounds skipped at most when idle,
+				 * 0 for packet stages, never skipped */
+	uint16_t backoff;	/* rounds skipped after the last idle call */
+	uint16_t skip;		/* rounds left to skip */
+	uint8_t prio;		/* enum epc_sched_prio */
+#endif	/* SERVICE_SCHED */
 };
 
 struct epc_lcore_config {
 	int allocated;		/* indicates a number of pipelines enebled */
 	struct pipeline_launch launch[EPC_PIPELINE_MAX];
+#ifdef SERVICE_SCHED
+	int packet_stages;	/* pipelines allocated with epc_alloc_lcore() */
+	uint32_t idle_rounds;	/* rounds in a row with no work done */
+#endif	/* SERVICE_SCHED */
 };
 
 struct epc_app_params {
 	/* CPU cores */
 	struct epc_lcore_config lcores[DP_MAX_LCORE];
-	int core_rx[NUM_SPGW_PORTS];
-	int core_tx[NUM_SPGW_PORTS];
+	int core_rx[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
+	int core_tx[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
 	int core_load_balance;
 	int core_mct;
 	int core_iface;
 	int core_stats;
 	int core_spns_dns;
+	/* lcores scanning the DNS ring besides core_spns_dns */
+	int core_spns_dns_extra[EPC_MAX_SPNS_DNS - 1];
+	unsigned num_spns_dns;
+#ifdef CDR_ASYNC
+	int core_cdr;
+#endif
+#ifdef PKT_CAPTURE
+	int core_capture;
+#endif
+#ifdef DP_BENCH
+	int core_bench;
+#endif
 	unsigned num_workers;
 	unsigned worker_cores[DP_MAX_LCORE];
 	unsigned worker_core_mapping[DP_MAX_LCORE];
@@ -246,11 +649,27 @@ struct epc_app_params {
 	/* Ports */
 	uint32_t ports[NUM_SPGW_PORTS];
 	uint32_t n_ports;
+	/* rx/tx queues per port */
+	uint32_t n_queues;
+	/* TX checksum offload flags set on the packets sent on a port */
+	uint64_t tx_cksum_ol[RTE_MAX_ETHPORTS];
 	uint32_t port_rx_ring_size;
 	uint32_t port_tx_ring_size;
+#ifdef NIC_RSS_STEERING
+	uint16_t rss_reta_size;
+#endif
+#ifdef HW_CTRL_STEERING
+	/* NIC rx queue of the control pkts, read by the mct core */
+	uint16_t ctrl_queue;
+#endif
+#ifdef PKT_MIRROR
+	/* tx queue of the mirrored pkts on the mirror port, sent by the
+	 * mct core */
+	uint16_t mirror_queue;
+#endif
 
 	/* Rx rings */
-	struct rte_ring *epc_lb_rx[NUM_SPGW_PORTS];
+	struct rte_ring *epc_lb_rx[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
 	struct rte_ring *epc_mct_rx[NUM_SPGW_PORTS];
 	struct rte_ring *epc_mct_spns_dns_rx;
 	struct rte_ring *epc_work_rx[DP_MAX_LCORE][NUM_SPGW_PORTS];
@@ -268,16 +687,201 @@ struct epc_app_params {
 	uint32_t burst_size_worker_write;
 	uint32_t burst_size_tx_read;
 	uint32_t burst_size_tx_write;
+#ifdef ADAPTIVE_FLUSH
+	/* Flush deadline of the pending packets */
+	uint32_t flush_us;
+	uint64_t flush_deadline_cycles;
+#endif
 
 	/* Pipeline params */
 	struct epc_load_balance_params lb_params;
-	struct epc_tx_params tx_params[NUM_SPGW_PORTS];
-	struct epc_rx_params rx_params[NUM_SPGW_PORTS];
+	struct epc_tx_params tx_params[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
+	struct epc_rx_params rx_params[NUM_SPGW_PORTS][EPC_MAX_PORT_QUEUES];
 	struct epc_worker_params worker[DP_MAX_LCORE];
+
+	/* Cycle accounting of CP message processing on the iface core */
+	struct epc_stage_stats iface_stats;
 } __rte_cache_aligned;
 
 extern struct epc_app_params epc_app;
 
+/** Packets processed by the current pipeline stage of this lcore */
+RTE_DECLARE_PER_LCORE(uint32_t, epc_stage_pkts);
+
+/**
+ * Report the packets processed by the running pipeline stage.
+ *
+ * @param n
+ *	Number of packets
+ */
+static inline void epc_stage_pkts_add(int n)
+{
+	if (n > 0)
+		RTE_PER_LCORE(epc_stage_pkts) += n;
+}
+
+/**
+ * Account one run of a pipeline stage.
+ *
+ * @param s
+ *	Stage stats
+ * @param cycles
+ *	Cycles spent in the run
+ * @param pkts
+ *	Packets processed in the run
+ */
+static inline void
+epc_stage_stats_update(struct epc_stage_stats *s, uint64_t cycles,
+		uint32_t pkts)
+{
+	uint32_t idx;
+
+	s->calls++;
+	if (pkts == 0) {
+		s->idle_cycles += cycles;
+		return;
+	}
+	s->busy_calls++;
+	s->busy_cycles += cycles;
+	s->pkts += pkts;
+
+	idx = 63 - __builtin_clzll(cycles | 1);
+	if (idx >= EPC_STAGE_HIST_BUCKETS)
+		idx = EPC_STAGE_HIST_BUCKETS - 1;
+	s->hist[idx]++;
+
+	idx = 31 - __builtin_clz(pkts);
+	if (idx >= EPC_BURST_HIST_BUCKETS)
+		idx = EPC_BURST_HIST_BUCKETS - 1;
+	s->burst_hist[idx]++;
+}
+
+/**
+ * Flush a pipeline every param flush_max runs, as set at init, or with
+ * ADAPTIVE_FLUSH, adapt flush_max to the run's burst and flush when the
+ * deadline of the pending packets expires.
+ *
+ * @param p
+ *	Pipeline run
+ * @param flush_count
+ *	Runs since last flush
+ * @param flush_max
+ *	Runs between flushes
+ * @param c
+ *	Flush controller, EPC_FLUSH_CTL() of the pipeline params
+ * @param n
+ *	Packets read by the run
+ * @param full
+ *	Packets of a full burst
+ */
+static inline void
+epc_pipeline_flush(struct rte_pipeline *p, int *flush_count, int *flush_max,
+		void *c, uint32_t n, uint32_t full)
+{
+#ifdef ADAPTIVE_FLUSH
+	struct epc_flush_ctl *ctl = c;
+	uint64_t now;
+
+	if (n >= full)
+		*flush_max = RTE_MIN(2 * *flush_max, EPC_FLUSH_MAX_ADAPT);
+	else if (n < full / 4)
+		*flush_max = 1;
+
+	ctl->pending += n;
+	now = rte_rdtsc();
+	if ((++*flush_count < *flush_max) &&
+			((ctl->pending == 0) || (now < ctl->deadline)))
+		return;
+
+	rte_pipeline_flush(p);
+	*flush_count = 0;
+	ctl->pending = 0;
+	ctl->deadline = now + epc_app.flush_deadline_cycles;
+#else
+	RTE_SET_USED(c);
+	RTE_SET_USED(n);
+	RTE_SET_USED(full);
+
+	if (++*flush_count >= *flush_max) {
+		rte_pipeline_flush(p);
+		*flush_count = 0;
+	}
+#endif	/* ADAPTIVE_FLUSH */
+}
+
+/**
+ * Account a worker packet handler stage which started at *tsc, and start
+ * the next stage.
+ *
+ * @param wk_index
+ *	Worker index
+ * @param stage
+ *	Stage that completed
+ * @param tsc
+ *	Start of the stage, updated to the current tsc
+ * @param n
+ *	Number of packets in the burst
+ */
+static inline void
+epc_wk_stage_end(int wk_index, enum epc_wk_stage stage, uint64_t *tsc,
+		uint32_t n)
+{
+	uint64_t now = rte_rdtsc();
+
+	epc_stage_stats_update(&epc_app.worker[wk_index].stage[stage],
+			now - *tsc, n);
+	*tsc = now;
+}
+
+#ifdef PKT_LATENCY
+/**
+ * Histogram bucket of a latency.
+ *
+ * @param cycles
+ *	Latency in cycles
+ *
+ * @return
+ *	Bucket index
+ */
+static inline uint32_t epc_latency_bucket(uint64_t cycles)
+{
+	uint32_t msb;
+
+	if (cycles < (1 << EPC_LAT_SUB_BITS))
+		return cycles;
+
+	msb = 63 - __builtin_clzll(cycles);
+	return ((msb - EPC_LAT_SUB_BITS + 1) << EPC_LAT_SUB_BITS) |
+		((cycles >> (msb - EPC_LAT_SUB_BITS)) &
+		 ((1 << EPC_LAT_SUB_BITS) - 1));
+}
+
+/**
+ * Upper bound in cycles of a latency histogram bucket.
+ *
+ * @param idx
+ *	Bucket index
+ *
+ * @return
+ *	First latency of the next bucket
+ */
+static inline uint64_t epc_latency_bucket_max(uint32_t idx)
+{
+	uint32_t msb;
+	uint64_t low;
+
+	if (idx < (1 << EPC_LAT_SUB_BITS))
+		return idx + 1;
+
+	msb = (idx >> EPC_LAT_SUB_BITS) + EPC_LAT_SUB_BITS - 1;
+	low = ((uint64_t)((1 << EPC_LAT_SUB_BITS) |
+			(idx & ((1 << EPC_LAT_SUB_BITS) - 1))))
+		<< (msb - EPC_LAT_SUB_BITS);
+	return low + (1ULL << (msb - EPC_LAT_SUB_BITS));
+}
+
+#endif	/* PKT_LATENCY */
+
 /**
  * Adds pipeline function to core's list of pipelines to run
  *
@@ -289,8 +893,44 @@ extern struct epc_app_params epc_app;
  *
  * @param core
  *	Core to run pipeline function on
+ *
+ * @param name
+ *	Stage name used in the cycle accounting stats
  */
-void epc_alloc_lcore(pipeline_func_t func, void *arg, int core);
+void epc_alloc_lcore(pipeline_func_t func, void *arg, int core,
+		const char *name);
+
+#ifdef SERVICE_SCHED
+/**
+ * Adds a service function to core's list of pipelines to run. Services
+ * run in priority order, up to weight times per round while they find
+ * work, and are skipped for a growing number of rounds while idle. An
+ * lcore with only services sleeps --idle_sleep us when all are idle.
+ *
+ * @param func
+ *	Function to run, reports its work with epc_stage_pkts_add()
+ *
+ * @param arg
+ *	Argument to pipeline function
+ *
+ * @param core
+ *	Core to run pipeline function on
+ *
+ * @param name
+ *	Stage name used in the cycle accounting stats
+ *
+ * @param prio
+ *	enum epc_sched_prio
+ *
+ * @param weight
+ *	Calls per round while busy
+ */
+void epc_alloc_service(pipeline_func_t func, void *arg, int core,
+		const char *name, enum epc_sched_prio prio, uint16_t weight);
+#else
+#define epc_alloc_service(func, arg, core, name, prio, weight) \
+	epc_alloc_lcore(func, arg, core, name)
+#endif	/* SERVICE_SCHED */
 
 /**
  *  Initialize the load balance pipeline
@@ -313,8 +953,12 @@ void epc_load_balance_init(struct epc_load_balance_params *param);
  * @param port_id
  *	Rx Port ID
  *
+ * @param queue_id
+ *	NIC rx queue read by this pipeline instance
+ *
  */
-void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id);
+void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id,
+		uint16_t queue_id);
 
 /**
  * Initializes Tx pipeline
@@ -330,8 +974,12 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id);
  * @param port_id
  *	Tx Port ID
  *
+ * @param queue_id
+ *	NIC tx queue written by this pipeline instance
+ *
  */
-void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port_id);
+void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port_id,
+		uint16_t queue_id);
 
 /**
  * Initializes arp icmp pipeline
@@ -446,6 +1094,17 @@ void register_worker(epc_packet_handler f, int port);
  */
 void packet_framework_launch(void);
 
+/**
+ * Pins a control thread off the CPUs of the EAL lcores, or onto the CPUs
+ * of the iface lcore if the lcores take all of them.
+ *
+ * @param t
+ *	control thread.
+ * @param name
+ *	name of the thread, for the log.
+ */
+void epc_ctrl_thread_pin(pthread_t t, const char *name);
+
 static inline void set_ue_ipv4_hash(uint32_t *hash, const uint32_t *ue_ip)
 {
 #ifdef SKIP_LB_HASH_CRC
@@ -464,4 +1123,45 @@ set_worker_core_id(uint32_t *worker_core_id, uint32_t *hash)
 		*worker_core_id = *hash % (epc_app.num_workers);
 }
 
+/**
+ * Get the worker index which processes the downlink traffic of a UE.
+ *
+ * @param worker_core_id
+ *	Worker index returned.
+ * @param ue_ip
+ *	UE ip address, in packet byte order.
+ */
+static inline void
+set_ue_worker_core_id(uint32_t *worker_core_id, const uint32_t *ue_ip)
+{
+#ifdef NIC_RSS_STEERING
+	/* Same Toeplitz hash and redirection table as the SGi NIC */
+	uint32_t tuple[2] = {0, rte_be_to_cpu_32(*ue_ip)};
+	uint32_t hash = rte_softrss(tuple, RTE_DIM(tuple), epc_rss_key);
+
+	*worker_core_id = (hash & (epc_app.rss_reta_size - 1))
+				% epc_app.num_workers;
+#else
+	uint32_t hash;
+
+	set_ue_ipv4_hash(&hash, ue_ip);
+	set_worker_core_id(worker_core_id, &hash);
+#endif
+}
+
+#ifdef NIC_RSS_STEERING
+/**
+ * Set the epc meta data of packets read directly from a port by a worker,
+ * the same way the rx pipeline does it.
+ *
+ * @param pkts
+ *	Packets received.
+ * @param n
+ *	Number of packets.
+ * @param port_id
+ *	Port the packets were received on.
+ */
+void epc_rx_set_meta(struct rte_mbuf **pkts, uint32_t n, uint8_t port_id);
+#endif	/* NIC_RSS_STEERING */
+
 #endif /* __EPC_PACKET_FRAMEWORK_H__ */
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_port_ring.h>
+
+#include "epc_packet_framework.h"
+
+struct epc_ring_stats epc_ring_stats[EPC_RING_STATS_MAX];
+uint32_t epc_ring_stats_count;
+
+/** Ring writer port */
+struct epc_port_ring_writer {
+	struct rte_mbuf *tx_buf[2 * RTE_PORT_IN_BURST_SIZE_MAX];
+	struct rte_ring *ring;
+	struct epc_ring_stats *stats;
+	uint32_t tx_burst_sz;
+	uint32_t tx_buf_count;
+	uint64_t bsz_mask;
+};
+
+struct epc_ring_stats *
+epc_ring_stats_get(struct rte_ring *ring)
+{
+	struct epc_ring_stats *s;
+	uint32_t i;
+
+	for (i = 0; i < epc_ring_stats_count; i++)
+		if (epc_ring_stats[i].ring == ring)
+			return &epc_ring_stats[i];
+
+	if (epc_ring_stats_count == EPC_RING_STATS_MAX)
+		return NULL;
+
+	s = &epc_ring_stats[epc_ring_stats_count++];
+	memset(s, 0, sizeof(*s));
+	s->ring = ring;
+	snprintf(s->name, sizeof(s->name), "%s", ring->name);
+	return s;
+}
+
+static void *
+epc_port_ring_writer_create(void *params, int socket_id)
+{
+	struct rte_port_ring_writer_params *conf =
+			(struct rte_port_ring_writer_params *)params;
+	struct epc_port_ring_writer *port;
+
+	if ((conf == NULL) || (conf->ring == NULL) ||
+			(conf->tx_burst_sz == 0) ||
+			(conf->tx_burst_sz > RTE_PORT_IN_BURST_SIZE_MAX) ||
+			(!rte_is_power_of_2(conf->tx_burst_sz))) {
+		RTE_LOG(ERR, EPC, "%s: Invalid Parameters\n", __func__);
+		return NULL;
+	}
+
+	port = rte_zmalloc_socket("PORT", sizeof(*port),
+			RTE_CACHE_LINE_SIZE, socket_id);
+	if (port == NULL) {
+		RTE_LOG(ERR, EPC, "%s: Failed to allocate port\n", __func__);
+		return NULL;
+	}
+
+	port->stats = epc_ring_stats_get(conf->ring);
+	if (port->stats == NULL) {
+		RTE_LOG(ERR, EPC, "%s: No ring stats left for %s\n",
+				__func__, conf->ring->name);
+		rte_free(port);
+		return NULL;
+	}
+	port->ring = conf->ring;
+	port->tx_burst_sz = conf->tx_burst_sz;
+	port->tx_buf_count = 0;
+	port->bsz_mask = 1LLU << (conf->tx_burst_sz - 1);
+
+	return port;
+}
+
+/**
+ * Account an enqueue of n pkts of which n_ok made it to the ring.
+ */
+static inline void
+epc_port_ring_writer_account(struct epc_port_ring_writer *p, uint32_t n,
+		uint32_t n_ok)
+{
+	struct epc_ring_stats *s = p->stats;
+	uint32_t count = rte_ring_count(p->ring);
+
+	s->n_pkts += n_ok;
+	s->n_drops += n - n_ok;
+	s->count = count;
+	if (count > s->hwm)
+		s->hwm = count;
+}
+
+static inline void
+send_burst(struct epc_port_ring_writer *p)
+{
+	uint32_t nb_tx;
+
+	nb_tx = rte_ring_sp_enqueue_burst(p->ring, (void **)p->tx_buf,
+			p->tx_buf_count);
+	epc_port_ring_writer_account(p, p->tx_buf_count, nb_tx);
+
+	for ( ; nb_tx < p->tx_buf_count; nb_tx++)
+		rte_pktmbuf_free(p->tx_buf[nb_tx]);
+
+	p->tx_buf_count = 0;
+}
+
+static int
+epc_port_ring_writer_tx(void *port, struct rte_mbuf *pkt)
+{
+	struct epc_port_ring_writer *p = (struct epc_port_ring_writer *)port;
+
+	p->tx_buf[p->tx_buf_count++] = pkt;
+	if (p->tx_buf_count >= p->tx_burst_sz)
+		send_burst(p);
+
+	return 0;
+}
+
+static int
+epc_port_ring_writer_tx_bulk(void *port, struct rte_mbuf **pkts,
+		uint64_t pkts_mask)
+{
+	struct epc_port_ring_writer *p = (struct epc_port_ring_writer *)port;
+	uint64_t bsz_mask = p->bsz_mask;
+	uint32_t tx_buf_count = p->tx_buf_count;
+	uint64_t expr = (pkts_mask & (pkts_mask + 1)) |
+			((pkts_mask & bsz_mask) ^ bsz_mask);
+
+	if (expr == 0) {
+		/* full burst at the head of pkts, enqueue it directly */
+		uint32_t n_pkts = __builtin_popcountll(pkts_mask);
+		uint32_t n_pkts_ok;
+
+		if (tx_buf_count)
+			send_burst(p);
+
+		n_pkts_ok = rte_ring_sp_enqueue_burst(p->ring, (void **)pkts,
+				n_pkts);
+		epc_port_ring_writer_account(p, n_pkts, n_pkts_ok);
+
+		for ( ; n_pkts_ok < n_pkts; n_pkts_ok++)
+			rte_pktmbuf_free(pkts[n_pkts_ok]);
+	} else {
+		for ( ; pkts_mask; ) {
+			uint32_t pkt_index = __builtin_ctzll(pkts_mask);
+			uint64_t pkt_mask = 1LLU << pkt_index;
+
+			p->tx_buf[tx_buf_count++] = pkts[pkt_index];
+			pkts_mask &= ~pkt_mask;
+		}
+
+		p->tx_buf_count = tx_buf_count;
+		if (tx_buf_count >= p->tx_burst_sz)
+			send_burst(p);
+	}
+
+	return 0;
+}
+
+static int
+epc_port_ring_writer_flush(void *port)
+{
+	struct epc_port_ring_writer *p = (struct epc_port_ring_writer *)port;
+
+	if (p->tx_buf_count > 0)
+		send_burst(p);
+
+	return 0;
+}
+
+static int
+epc_port_ring_writer_free(void *port)
+{
+	if (port == NULL) {
+		RTE_LOG(ERR, EPC, "%s: Port is NULL\n", __func__);
+		return -EINVAL;
+	}
+
+	epc_port_ring_writer_flush(port);
+	rte_free(port);
+
+	return 0;
+}
+
+static int
+epc_port_ring_writer_stats_read(void *port, struct rte_port_out_stats *stats,
+		int clear)
+{
+	struct epc_port_ring_writer *p = (struct epc_port_ring_writer *)port;
+
+	if (stats != NULL) {
+		stats->n_pkts_in = p->stats->n_pkts + p->stats->n_drops;
+		stats->n_pkts_drop = p->stats->n_drops;
+	}
+	if (clear) {
+		p->stats->n_pkts = 0;
+		p->stats->n_drops = 0;
+	}
+
+	return 0;
+}
+
+struct rte_port_out_ops epc_port_ring_writer_ops = {
+	.f_create = epc_port_ring_writer_create,
+	.f_free = epc_port_ring_writer_free,
+	.f_tx = epc_port_ring_writer_tx,
+	.f_tx_bulk = epc_port_ring_writer_tx_bulk,
+	.f_flush = epc_port_ring_writer_flush,
+	.f_stats = epc_port_ring_writer_stats_read,
+};
@@ -43,6 +43,10 @@
 #include "epc_packet_framework.h"
 #include "main.h"
 #include "gtpu.h"
+#include "trace.h"
+#include "s5s8_bypass.h"
+#include "gtpu_frag.h"
+#include "ipv6.h"
 
 #ifndef SKIP_LB_GTPU_AH
 static inline void epc_s1u_rx_set_port_id(struct rte_mbuf *m)
@@ -68,6 +72,11 @@ static inline void epc_s1u_rx_set_port_id(struct rte_mbuf *m)
 		RTE_LOG(ERR, EPC, "Bad checksum\n");
 		ipv4_packet = 0;
 	}
+#ifdef JUMBO_FRAMES
+	/* headers of chained pkts are read from the first segment */
+	if (unlikely(pkt_hdr_pullup(m) < 0))
+		ipv4_packet = 0;
+#endif
 
 	*port_id_offset = 1;
 
@@ -77,12 +86,6 @@ static inline void epc_s1u_rx_set_port_id(struct rte_mbuf *m)
 		    (struct udp_hdr *)&m_data[sizeof(struct ether_hdr) +
 					      ip_len];
 		if (likely(udph->dst_port == htons(2152))) {
-			/* TODO: Inner could be ipv6 ? */
-
-			RTE_LOG(DEBUG, EPC, "Function:%s::\n\t"
-					 "gtpu_hdrsz= %lu\n",
-					 __func__, sizeof(struct gtpu_hdr));
-
 			struct ipv4_hdr *inner_ipv4_hdr =
 			    (struct ipv4_hdr *)RTE_PTR_ADD(udph,
 							   UDP_HDR_SIZE +
@@ -91,8 +94,18 @@ static inline void epc_s1u_rx_set_port_id(struct rte_mbuf *m)
 
 			const uint32_t *p =
 			    (const uint32_t *)&inner_ipv4_hdr->src_addr;
-
-			RTE_LOG(DEBUG, EPC, "gtpu packet\n");
+#ifdef UE_IPV6
+			uint32_t ue_prefix;
+
+			/* IPv6 UEs are steered on their /64 */
+			if (ip_hdr_is_ipv6(inner_ipv4_hdr)) {
+				ue_prefix = ipv6_prefix_fold(((struct ipv6_hdr *)
+						inner_ipv4_hdr)->src_addr);
+				p = &ue_prefix;
+			}
+#endif /* UE_IPV6 */
+
+			TRACE_POINT(DP_TRACE_RX, TP_RX_GTPU, *p, 0, 0);
 			*port_id_offset = 0;
 
 			set_ue_ipv4_hash(ue_ipv4_hash_offset, p);
@@ -105,12 +118,25 @@ static int epc_s1u_rx_port_in_action_handler(struct rte_pipeline *p,
 					void *arg)
 {
 	uint32_t i;
+#ifdef GTPU_FRAG
+	uint64_t held = gtpu_reassemble(pkts, n);
+
+	if (unlikely(held))
+		rte_pipeline_ah_packet_hijack(p, held);
+#endif
 
 	RTE_SET_USED(arg);
 	RTE_SET_USED(p);
 
+#ifdef PKT_LATENCY
+	epc_latency_stamp(pkts, n);
+#endif
 	for (i = 0; i < n; i++) {
 		struct rte_mbuf *m = pkts[i];
+#ifdef GTPU_FRAG
+		if (unlikely(ISSET_BIT(held, i)))
+			continue;
+#endif
 #ifdef SKIP_RX_META
 		RTE_SET_USED(m);
 #else
@@ -135,16 +161,35 @@ static inline void epc_sgi_rx_set_port_id(struct rte_mbuf *m)
 	struct ether_hdr *eh = (struct ether_hdr *)&m_data[0];
 	uint32_t ipv4_packet;
 	int bcast;
+#ifdef UE_IPV6
+	struct ipv6_hdr *ipv6_hdr = (struct ipv6_hdr *)ipv4_hdr;
+	uint32_t ipv6_packet;
+	uint32_t ue_prefix;
+
+	ipv6_packet = (eh->ether_type == htons(ETHER_TYPE_IPv6));
+#endif /* UE_IPV6 */
 
 	ipv4_packet = (eh->ether_type == htons(ETHER_TYPE_IPv4));
 	bcast = is_broadcast_ether_addr(&eh->d_addr);
 
 	if (unlikely(m->ol_flags
 		& (PKT_RX_L4_CKSUM_BAD | PKT_RX_IP_CKSUM_BAD))) {
-		RTE_LOG(DEBUG, EPC, "Bad checksum\n");
+		TRACE_POINT(DP_TRACE_RX, TP_RX_BAD_CKSUM, m->ol_flags, m->port,
+				0);
 		/* put packets with bad checksum to kernel */
 		ipv4_packet = 0;
+#ifdef UE_IPV6
+		ipv6_packet = 0;
+#endif
 	}
+#ifdef JUMBO_FRAMES
+	if (unlikely(pkt_hdr_pullup(m) < 0)) {
+		ipv4_packet = 0;
+#ifdef UE_IPV6
+		ipv6_packet = 0;
+#endif
+	}
+#endif
 
 	if (app.spgw_cfg == SGWU) {
 		*port_id_offset = ipv4_packet &&
@@ -154,12 +199,47 @@ static inline void epc_sgi_rx_set_port_id(struct rte_mbuf *m)
 		*port_id_offset = ipv4_packet &&
 				((ipv4_hdr->dst_addr != app.sgi_ip) &&
 				 !bcast) ? 0 : 1;
+#ifdef UE_IPV6
+		/* IPv6 multicast (ND, MLD) goes to the kernel */
+		if (ipv6_packet && ipv6_hdr->dst_addr[0] != 0xff && !bcast)
+			*port_id_offset = 0;
+#endif /* UE_IPV6 */
 	}
 
 	if (likely(!*port_id_offset)) {
 		const uint32_t *p = (const uint32_t *)&ipv4_hdr->dst_addr;
 
-		RTE_LOG(DEBUG, EPC, "SGI packet\n");
+		/* SGWU downlink is tunneled: steer on the inner UE ip */
+		if (app.spgw_cfg == SGWU &&
+				ipv4_hdr->next_proto_id == IPPROTO_UDP) {
+			struct udp_hdr *udph = (struct udp_hdr *)RTE_PTR_ADD(
+				ipv4_hdr, (ipv4_hdr->version_ihl & 0xf) << 2);
+
+			if (udph->dst_port == htons(UDP_PORT_GTPU)) {
+				struct ipv4_hdr *inner_ipv4_hdr =
+					(struct ipv4_hdr *)RTE_PTR_ADD(udph,
+						UDP_HDR_SIZE +
+						sizeof(struct gtpu_hdr));
+
+				p = (const uint32_t *)&inner_ipv4_hdr->dst_addr;
+#ifdef UE_IPV6
+				if (ip_hdr_is_ipv6(inner_ipv4_hdr)) {
+					ue_prefix = ipv6_prefix_fold(
+						((struct ipv6_hdr *)
+						 inner_ipv4_hdr)->dst_addr);
+					p = &ue_prefix;
+				}
+#endif /* UE_IPV6 */
+			}
+		}
+#ifdef UE_IPV6
+		if (ipv6_packet) {
+			ue_prefix = ipv6_prefix_fold(ipv6_hdr->dst_addr);
+			p = &ue_prefix;
+		}
+#endif /* UE_IPV6 */
+
+		TRACE_POINT(DP_TRACE_RX, TP_RX_SGI, *p, 0, 0);
 
 		set_ue_ipv4_hash(ue_ipv4_hash_offset, p);
 	}
@@ -171,11 +251,25 @@ epc_sgi_rx_port_in_action_handler(struct rte_pipeline *p,
 					  uint32_t n, void *arg)
 {
 	uint32_t i;
+#ifdef GTPU_FRAG
+	/* S5/S8 downlink of the SGWU is GTPU */
+	uint64_t held = (app.spgw_cfg == SGWU) ? gtpu_reassemble(pkts, n) : 0;
+
+	if (unlikely(held))
+		rte_pipeline_ah_packet_hijack(p, held);
+#endif
 
 	RTE_SET_USED(arg);
 	RTE_SET_USED(p);
+#ifdef PKT_LATENCY
+	epc_latency_stamp(pkts, n);
+#endif
 	for (i = 0; i < n; i++) {
 		struct rte_mbuf *m = pkts[i];
+#ifdef GTPU_FRAG
+		if (unlikely(ISSET_BIT(held, i)))
+			continue;
+#endif
 #ifdef SKIP_RX_META
 
 		RTE_SET_USED(m);
@@ -186,7 +280,30 @@ epc_sgi_rx_port_in_action_handler(struct rte_pipeline *p,
 	return 0;
 }
 
-void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
+#ifdef NIC_RSS_STEERING
+void epc_rx_set_meta(struct rte_mbuf **pkts, uint32_t n, uint8_t port_id)
+{
+	uint32_t i;
+
+#ifdef PKT_LATENCY
+	epc_latency_stamp(pkts, n);
+#endif
+#ifndef SKIP_LB_GTPU_AH
+	if (port_id == WEST_PORT_ID) {
+		for (i = 0; i < n; i++)
+			epc_s1u_rx_set_port_id(pkts[i]);
+		return;
+	}
+#else
+	RTE_SET_USED(port_id);
+#endif
+	for (i = 0; i < n; i++)
+		epc_sgi_rx_set_port_id(pkts[i]);
+}
+#endif	/* NIC_RSS_STEERING */
+
+void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id,
+		uint16_t queue_id)
 {
 	struct rte_pipeline *p;
 	unsigned i;
@@ -220,8 +337,9 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 
 	memset(param, 0, sizeof(*param));
 
-	snprintf((char *)param->name, PIPE_NAME_SIZE, "epc_rx_%d", port_id);
-	param->pipeline_params.socket_id = rte_socket_id();
+	snprintf((char *)param->name, PIPE_NAME_SIZE, "epc_rx_%d_%d", port_id,
+			queue_id);
+	param->pipeline_params.socket_id = dp_lcore_socket(core);
 	param->pipeline_params.name = param->name;
 	param->pipeline_params.offset_port_id = META_DATA_OFFSET;
 
@@ -240,7 +358,7 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 
 	struct rte_port_ethdev_reader_params port_ethdev_params = {
 		.port_id = epc_app.ports[port_id],
-		.queue_id = 0,
+		.queue_id = queue_id,
 	};
 
 	struct rte_pipeline_port_in_params port_params = {
@@ -260,6 +378,23 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 			  __func__, port_id);
 	}
 
+#ifdef S5S8_BYPASS
+	/* pkts of the co-located peer take the path of the NIC pkts */
+	if (port_id == s5s8_bypass_port && queue_id == 0) {
+		struct rte_pipeline_port_in_params bypass_params = {
+			.ops = &s5s8_bypass_reader_ops,
+			.arg_create = NULL,
+			.f_action = port_params.f_action,
+			.burst_size = epc_app.burst_size_rx_read,
+		};
+
+		if (rte_pipeline_port_in_create(p, &bypass_params,
+				&param->port_in_bypass_id))
+			rte_panic("%s: Unable to configure S5/S8 bypass input "
+					"port\n", __func__);
+	}
+#endif
+
 	for (i = 0; i < NUM_SPGW_PORTS; i++) {
 		struct rte_port_ring_writer_params port_ring_params = {
 			.tx_burst_sz = epc_app.burst_size_rx_write,
@@ -276,7 +411,8 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 			port_ring_params.ring = epc_app.ring_tx[epc_app.core_mct][port_id ^ 1];
 #else
 		if (i == 0)
-			port_ring_params.ring = epc_app.epc_lb_rx[port_id];
+			port_ring_params.ring =
+				epc_app.epc_lb_rx[port_id][queue_id];
 #endif
 		else
 			port_ring_params.ring = epc_app.epc_mct_rx[port_id];
@@ -306,6 +442,13 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 		rte_panic("%s: Unable to connect input port %u to table %u\n",
 			  __func__, param->port_in_id, param->table_id);
 	}
+#ifdef S5S8_BYPASS
+	if (port_id == s5s8_bypass_port && queue_id == 0 &&
+		rte_pipeline_port_in_connect_to_table(p,
+			param->port_in_bypass_id, param->table_id))
+		rte_panic("%s: Unable to connect S5/S8 bypass input port\n",
+			  __func__);
+#endif
 
 	{
 		struct rte_pipeline_table_entry default_entry = {
@@ -331,6 +474,12 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 		rte_panic("%s: unable to enable input port %d\n", __func__,
 			  param->port_in_id);
 	}
+#ifdef S5S8_BYPASS
+	if (port_id == s5s8_bypass_port && queue_id == 0 &&
+		rte_pipeline_port_in_enable(p, param->port_in_bypass_id))
+		rte_panic("%s: unable to enable S5/S8 bypass input port\n",
+			  __func__);
+#endif
 
 	param->flush_max = EPC_PIPELINE_FLUSH_MAX;
 
@@ -343,10 +492,10 @@ void epc_rx_init(struct epc_rx_params *param, int core, uint8_t port_id)
 void epc_rx(void *args)
 {
 	struct epc_rx_params *param = (struct epc_rx_params *)args;
+	uint32_t n = rte_pipeline_run(param->pipeline);
 
-	rte_pipeline_run(param->pipeline);
-	if (++param->flush_count >= param->flush_max) {
-		rte_pipeline_flush(param->pipeline);
-		param->flush_count = 0;
-	}
+	epc_stage_pkts_add(n);
+	epc_pipeline_flush(param->pipeline, &param->flush_count,
+			&param->flush_max, EPC_FLUSH_CTL(param), n,
+			epc_app.burst_size_rx_read);
 }
@@ -67,10 +67,125 @@
 
 #define NB_CORE_MSGBUF 10000
 #define MAX_NAME_LEN    32
-static struct rte_mempool *message_pool;
+/** DNS responses dequeued per scan */
+#define DNS_SCAN_BURST	32
+/** Resolved addresses kept per DNS response */
+#define DNS_MAX_ADDR4	100
+/** ADC entries added to the table at once */
+#define DNS_ADC_BATCH	64
 extern struct rte_ring *epc_mct_spns_dns_rx;
 uint64_t num_dns_processed;
 
+/**
+ * Queue a resolved address for adc_dns_entry_add_bulk(), flushing a
+ * full batch.
+ */
+static inline void
+dns_adc_add(struct msg_adc *adc, unsigned *n_adc, struct in_addr addr,
+		unsigned rule_id, __rte_unused uint32_t ttl)
+{
+	RTE_LOG(DEBUG, DP, "adding a rule with IP: %s, rule id %d\n",
+			inet_ntoa(addr), rule_id);
+	adc[*n_adc].ipv4 = addr.s_addr;
+	adc[*n_adc].rule_id = rule_id;
+#ifdef ADC_DNS_AGING
+	adc[*n_adc].ttl = ttl;
+#endif
+	if (++(*n_adc) == DNS_ADC_BATCH) {
+		adc_dns_entry_add_bulk(adc, *n_adc);
+		*n_adc = 0;
+	}
+}
+
+#ifdef DNS_DESC_RING
+/** Parsed DNS responses queued to the DNS lcores */
+static struct rte_mempool *dns_desc_pool;
+
+void epc_spns_dns_init(void)
+{
+	dns_desc_pool = rte_mempool_create("dns_desc_pool",
+			NB_CORE_MSGBUF, sizeof(struct epc_sponsdn_desc),
+			32, 0, NULL, NULL, NULL, NULL,
+			rte_socket_id(), 0);
+	if (dns_desc_pool == NULL)
+		rte_exit(EXIT_FAILURE, "Create dns desc mempool failed\n");
+}
+
+int push_dns_ring(struct rte_mbuf *pkts)
+{
+	struct epc_sponsdn_desc *desc;
+	struct ipv4_hdr *ip;
+	unsigned off;
+
+	if (epc_mct_spns_dns_rx == NULL)
+		return -1;
+
+	if (rte_pktmbuf_data_len(pkts) <
+			sizeof(struct ether_hdr) + sizeof(struct ipv4_hdr))
+		return -1;
+	ip = (struct ipv4_hdr *)(rte_pktmbuf_mtod(pkts, uint8_t *) +
+			sizeof(struct ether_hdr));
+	off = sizeof(struct ether_hdr) +
+		(ip->version_ihl & IPV4_HDR_IHL_MASK) * IPV4_IHL_MULTIPLIER +
+		sizeof(struct udp_hdr);
+	if (rte_pktmbuf_data_len(pkts) <= off)
+		return -1;
+
+	if (rte_mempool_get(dns_desc_pool, (void **)&desc) != 0) {
+		RTE_LOG(DEBUG, DP, "Error to get dns descriptor\n");
+		return -1;
+	}
+
+	/* only responses with A records are worth scanning */
+	if (epc_sponsdn_parse(rte_pktmbuf_mtod(pkts, char *) + off,
+				rte_pktmbuf_data_len(pkts) - off, desc) < 0) {
+		rte_mempool_put(dns_desc_pool, desc);
+		return -1;
+	}
+
+	if (rte_ring_mp_enqueue(epc_mct_spns_dns_rx, desc) != 0) {
+		RTE_LOG(DEBUG, DP, "DNS ring: error enqueuing\n");
+		rte_mempool_put(dns_desc_pool, desc);
+		return -1;
+	}
+	return 0;
+}
+
+void scan_dns_ring(__rte_unused void *args)
+{
+	struct epc_sponsdn_desc *desc[DNS_SCAN_BURST];
+	struct msg_adc adc[DNS_ADC_BATCH];
+	unsigned match_id;
+	unsigned n, i, j, n_adc = 0;
+
+	if (epc_mct_spns_dns_rx == NULL)
+		return;
+
+#ifdef ADC_DNS_AGING
+	adc_dns_age_poll(ADC_DNS_AGE_BUDGET);
+#endif
+	n = rte_ring_dequeue_burst(epc_mct_spns_dns_rx, (void **)desc,
+			DNS_SCAN_BURST);
+	if (n == 0)
+		return;
+
+	for (i = 0; i < n; i++) {
+		if (epc_sponsdn_match(desc[i], &match_id) < 0)
+			continue;
+		for (j = 0; j < desc[i]->addr4_cnt; ++j)
+			dns_adc_add(adc, &n_adc, desc[i]->addr4[j], match_id,
+					desc[i]->ttl4[j]);
+	}
+	rte_mempool_put_bulk(dns_desc_pool, (void **)desc, n);
+	if (n_adc)
+		adc_dns_entry_add_bulk(adc, n_adc);
+
+	__sync_add_and_fetch(&num_dns_processed, n);
+	epc_stage_pkts_add(n);
+}
+#else
+static struct rte_mempool *message_pool;
+
 void epc_spns_dns_init(void)
 {
 	 message_pool = rte_pktmbuf_pool_create("ms_msg_pool",
@@ -106,42 +221,49 @@ int push_dns_ring(struct rte_mbuf *pkts)
 
 void scan_dns_ring(__rte_unused void *args)
 {
-	void *msg;
-	int ret;
-	int i;
+	/* DNSTODO: IP header with options */
+	const unsigned dns_payload_off =
+		sizeof(struct ether_hdr) +
+		sizeof(struct ipv4_hdr) +
+		sizeof(struct udp_hdr);
+	struct rte_mbuf *pkts[DNS_SCAN_BURST];
+	struct msg_adc adc[DNS_ADC_BATCH];
+	struct in_addr addr4[DNS_MAX_ADDR4];
+	uint32_t ttl4[DNS_MAX_ADDR4];
+	unsigned match_id;
+	unsigned n, i, n_adc = 0;
+	int addr4_cnt;
+	int j;
 
 	if (epc_mct_spns_dns_rx == NULL)
 		return;
-	ret = rte_ring_sc_dequeue(epc_mct_spns_dns_rx, &msg);
-	if (ret == 0) {
-		/* DNSTODO: IP header with options */
-		unsigned dns_payload_off =
-			sizeof(struct ether_hdr) +
-			sizeof(struct ipv4_hdr) +
-			sizeof(struct udp_hdr);
-		int addr4_cnt;
-		struct in_addr addr4[100];
-		unsigned match_id;
-		struct rte_mbuf *pkts = (struct rte_mbuf *)msg;
-
-		epc_sponsdn_scan(rte_pktmbuf_mtod(pkts, char *) + dns_payload_off,
-				rte_pktmbuf_data_len(pkts) - dns_payload_off,
-				NULL,
-				&match_id,
-				addr4,
-				&addr4_cnt,
-				NULL,
-				NULL,
-				NULL);
-		++num_dns_processed;
-
-		for (i = 0; i < addr4_cnt; ++i) {
-			struct msg_adc msg = { .ipv4 = addr4[i].s_addr, .rule_id = match_id };
-
-			RTE_LOG(DEBUG, DP, "adding a rule with IP: %s, rule id %d\n",
-					inet_ntoa(addr4[i]), match_id);
-			adc_dns_entry_add(&msg);
-		}
-		rte_pktmbuf_free(msg);
+
+#ifdef ADC_DNS_AGING
+	adc_dns_age_poll(ADC_DNS_AGE_BUDGET);
+#endif
+	n = rte_ring_dequeue_burst(epc_mct_spns_dns_rx, (void **)pkts,
+			DNS_SCAN_BURST);
+	if (n == 0)
+		return;
+
+	for (i = 0; i < n; i++) {
+		addr4_cnt = RTE_DIM(addr4);
+		if (rte_pktmbuf_data_len(pkts[i]) <= dns_payload_off ||
+				epc_sponsdn_scan_ttl(rte_pktmbuf_mtod(pkts[i], char *)
+					+ dns_payload_off,
+					rte_pktmbuf_data_len(pkts[i]) - dns_payload_off,
+					&match_id, addr4, ttl4, &addr4_cnt) < 0)
+			addr4_cnt = 0;
+		rte_pktmbuf_free(pkts[i]);
+
+		addr4_cnt = RTE_MIN(addr4_cnt, (int)RTE_DIM(addr4));
+		for (j = 0; j < addr4_cnt; ++j)
+			dns_adc_add(adc, &n_adc, addr4[j], match_id, ttl4[j]);
 	}
+	if (n_adc)
+		adc_dns_entry_add_bulk(adc, n_adc);
+
+	__sync_add_and_fetch(&num_dns_processed, n);
+	epc_stage_pkts_add(n);
 }
+#endif	/* DNS_DESC_RING */
@@ -34,15 +34,150 @@
 #include <rte_cycles.h>
 #include <rte_per_lcore.h>
 #include <rte_port_ring.h>
+#ifdef EGRESS_QOS
+#include <rte_sched.h>
+#include <rte_port_sched.h>
+#endif	/* EGRESS_QOS */
 
 #include "main.h"
 #include "epc_packet_framework.h"
 
-void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
+#ifdef PKT_LATENCY
+/**
+ * Port in action for the worker rings, samples the rx to tx latency of the
+ * packets before they are written to the NIC.
+ */
+static int epc_tx_port_in_latency(struct rte_pipeline *p,
+		struct rte_mbuf **pkts, uint32_t n, void *arg)
+{
+	struct epc_tx_params *param = (struct epc_tx_params *)arg;
+
+	RTE_SET_USED(p);
+	epc_latency_sample(&param->latency, pkts, n);
+	return 0;
+}
+#endif	/* PKT_LATENCY */
+
+#ifdef EGRESS_QOS
+/** Line rate used when the link speed is not known, 10G in bytes/sec */
+#define EGRESS_QOS_DEFAULT_RATE	1250000000
+
+/**
+ * Port in action for the mct ring. Pkts of the mct core (ARP, ICMP,
+ * lo-path) are not classified by a worker, send them as signalling.
+ */
+static int epc_tx_port_in_mct_class(struct rte_pipeline *p,
+		struct rte_mbuf **pkts, uint32_t n, void *arg)
+{
+	uint32_t i;
+
+	RTE_SET_USED(p);
+	RTE_SET_USED(arg);
+	for (i = 0; i < n; i++)
+		rte_sched_port_pkt_write(pkts[i], 0, 0,
+				EGRESS_QOS_TC_SIGNALLING, 0, e_RTE_METER_GREEN);
+	return 0;
+}
+
+/**
+ * Create the egress scheduler of a tx queue: port -> eNB subport ->
+ * UE pipe -> QCI traffic class -> ARP queue. Shaping is left to the
+ * meters, subports and pipes run at line rate and only the strict
+ * priority of the traffic classes and the WRR of the queues apply.
+ */
+static struct rte_sched_port *
+epc_tx_sched_create(const char *name, uint8_t port)
+{
+	struct rte_eth_link link;
+	struct rte_sched_port *sched;
+	uint64_t bytes_sec;
+	uint32_t rate, qsize, i;
+
+	memset(&link, 0, sizeof(link));
+	rte_eth_link_get_nowait(epc_app.ports[port], &link);
+	bytes_sec = (link.link_speed) ?
+		(uint64_t)link.link_speed * 1000000 / 8 :
+		EGRESS_QOS_DEFAULT_RATE;
+	/* rte_sched rates are 32 bit, 40G and up saturate, which only
+	 * caps the line rate the pipes are not shaped at anyway */
+	rate = (uint32_t)RTE_MIN(bytes_sec, (uint64_t)UINT32_MAX);
+
+	/* queued pkts hold their mbufs, the schedulers of all tx queues of
+	 * the port must leave mbufs to rx */
+	qsize = EGRESS_QOS_QSIZE;
+	while ((qsize > 1) && ((uint64_t)qsize * EGRESS_QOS_SUBPORTS *
+			EGRESS_QOS_PIPES * RTE_SCHED_QUEUES_PER_PIPE *
+			epc_app.n_queues > EGRESS_QOS_MBUFS))
+		qsize >>= 1;
+
+	struct rte_sched_pipe_params pipe_profile = {
+		.tb_rate = rate,
+		.tb_size = 1000000,
+		.tc_rate = {rate, rate, rate, rate},
+		.tc_period = 40,
+		.wrr_weights = {8, 4, 2, 1,  8, 4, 2, 1,
+				8, 4, 2, 1,  8, 4, 2, 1},
+	};
+	struct rte_sched_subport_params subport_params = {
+		.tb_rate = rate,
+		.tb_size = 1000000,
+		.tc_rate = {rate, rate, rate, rate},
+		.tc_period = 10,
+	};
+	struct rte_sched_port_params port_params = {
+		.name = name,
+		.socket = rte_socket_id(),
+		.rate = rate,
+#ifdef JUMBO_FRAMES
+		.mtu = RTE_MAX(app.max_pkt_len, (uint32_t)ETHER_MAX_LEN),
+#else
+		.mtu = ETHER_MAX_LEN,
+#endif
+		.frame_overhead = RTE_SCHED_FRAME_OVERHEAD_DEFAULT,
+		.n_subports_per_port = EGRESS_QOS_SUBPORTS,
+		.n_pipes_per_subport = EGRESS_QOS_PIPES,
+		.qsize = {qsize, qsize, qsize, qsize},
+		.pipe_profiles = &pipe_profile,
+		.n_pipe_profiles = 1,
+	};
+
+	sched = rte_sched_port_config(&port_params);
+	if (sched == NULL)
+		rte_panic("%s: Unable to configure scheduler %s\n",
+				__func__, name);
+
+	for (i = 0; i < EGRESS_QOS_SUBPORTS; i++) {
+		uint32_t pipe;
+
+		if (rte_sched_subport_config(sched, i, &subport_params))
+			rte_panic("%s: Unable to configure subport %u\n",
+					__func__, i);
+		for (pipe = 0; pipe < EGRESS_QOS_PIPES; pipe++)
+			if (rte_sched_pipe_config(sched, i, pipe, 0))
+				rte_panic("%s: Unable to configure pipe %u\n",
+						__func__, pipe);
+	}
+
+	RTE_LOG(INFO, EPC, "%s: egress scheduler at %u bytes/sec, %u pkt"
+			" queues\n", name, rate, qsize);
+	return sched;
+}
+#endif	/* EGRESS_QOS */
+
+void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port,
+		uint16_t queue_id)
 {
 	unsigned i;
 	struct rte_pipeline *p;
-	int wr_core;
+	unsigned n_in = 0;
+#ifdef WORKER_DIRECT_TX
+	/* workers transmit directly, only the mct ring is read */
+	uint16_t tx_queue = EPC_MCT_TX_QUEUE;
+
+	RTE_SET_USED(queue_id);
+#else
+	uint16_t tx_queue = queue_id;
+#endif
 
 	if (rte_eth_dev_socket_id(port) != (int)lcore_config[core].socket_id) {
 		RTE_LOG(WARNING, EPC,
@@ -74,17 +209,19 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 
 	memset(param, 0, sizeof(*param));
 
-	snprintf((char *)param->name, PIPE_NAME_SIZE, "epc_tx_%d", port);
-	param->pipeline_params.socket_id = rte_socket_id();
+	snprintf((char *)param->name, PIPE_NAME_SIZE, "epc_tx_%d_%d", port,
+			queue_id);
+	param->pipeline_params.socket_id = dp_lcore_socket(core);
 	param->pipeline_params.name = param->name;
 
 	p = rte_pipeline_create(&param->pipeline_params);
 	if (p == NULL)
 		rte_panic("%s: Unable to configure the pipeline\n", __func__);
 
-		/* one tx_params queue per core */
-	for (i = 0; i < epc_app.num_workers; ++i) {
-		wr_core = epc_app.worker_cores[i];
+#ifndef WORKER_DIRECT_TX
+	/* one tx_params queue per core, workers are spread over tx queues */
+	for (i = queue_id; i < epc_app.num_workers; i += epc_app.n_queues) {
+		int wr_core = epc_app.worker_cores[i];
 		struct rte_port_ring_reader_params port_ring_params = {
 			.ring = epc_app.ring_tx[wr_core][port]
 		};
@@ -92,17 +229,23 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 		struct rte_pipeline_port_in_params port_params = {
 			.ops = &rte_port_ring_reader_ops,
 			.arg_create = (void *)&port_ring_params,
+#ifdef PKT_LATENCY
+			.f_action = epc_tx_port_in_latency,
+			.arg_ah = (void *)param,
+#endif
 			.burst_size = epc_app.burst_size_tx_read,
 		};
 
 		if (rte_pipeline_port_in_create
-		    (p, &port_params, &param->port_in_id[i])) {
+		    (p, &port_params, &param->port_in_id[n_in])) {
 			rte_panic
 			    ("%s: Unable to configure input port\n"
 				"for ring TX %i\n", __func__, i);
 		}
+		n_in++;
 	}
-	{
+#endif	/* WORKER_DIRECT_TX */
+	if (queue_id == 0) {
 	/* read from mct core*/
 		struct rte_port_ring_reader_params port_ring_params = {
 			.ring = epc_app.ring_tx[epc_app.core_mct][port]
@@ -111,21 +254,47 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 		struct rte_pipeline_port_in_params port_params = {
 			.ops = &rte_port_ring_reader_ops,
 			.arg_create = (void *)&port_ring_params,
+#ifdef EGRESS_QOS
+			.f_action = epc_tx_port_in_mct_class,
+#endif
 			.burst_size = epc_app.burst_size_tx_read,
 		};
 
 		if (rte_pipeline_port_in_create
-		    (p, &port_params, &param->port_in_id[i])) {
+		    (p, &port_params, &param->port_in_id[n_in])) {
 			rte_panic
 			    ("%s: Unable to configure input port\n"
-				"for ring TX %i\n", __func__, i);
+				"for ring TX %i\n", __func__, n_in);
 		}
+		n_in++;
 	}
+	param->n_port_in = n_in;
+
+#ifdef EGRESS_QOS
+	param->sched = epc_tx_sched_create(param->name, port);
+	{
+		struct rte_port_sched_reader_params port_sched_params = {
+			.sched = param->sched,
+		};
+		struct rte_pipeline_port_in_params port_params = {
+			.ops = &rte_port_sched_reader_ops,
+			.arg_create = (void *)&port_sched_params,
+			.burst_size = epc_app.burst_size_tx_write,
+		};
+
+		if (rte_pipeline_port_in_create
+		    (p, &port_params, &param->sched_port_in_id)) {
+			rte_panic
+			    ("%s: Unable to configure scheduler input port\n",
+			     __func__);
+		}
+	}
+#endif	/* EGRESS_QOS */
 
 	{
 		struct rte_port_ethdev_writer_nodrop_params port_ethdev_params = {
 			.port_id = epc_app.ports[port],
-			.queue_id = 0,
+			.queue_id = tx_queue,
 			.tx_burst_sz = epc_app.burst_size_tx_write,
 			.n_retries = 0,
 		};
@@ -142,6 +311,26 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 		}
 	}
 
+#ifdef EGRESS_QOS
+	{
+		struct rte_port_sched_writer_params port_sched_params = {
+			.sched = param->sched,
+			.tx_burst_sz = epc_app.burst_size_tx_write,
+		};
+		struct rte_pipeline_port_out_params port_params = {
+			.ops = &rte_port_sched_writer_ops,
+			.arg_create = (void *)&port_sched_params
+		};
+
+		if (rte_pipeline_port_out_create
+		    (p, &port_params, &param->sched_port_out_id)) {
+			rte_panic
+			    ("%s: Unable to configure scheduler output port\n",
+			     __func__);
+		}
+	}
+#endif	/* EGRESS_QOS */
+
 	{
 		struct rte_pipeline_table_params table_params = {
 			.ops = &rte_table_stub_ops,
@@ -154,8 +343,29 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 				" (with extend)\n", __func__);
 		}
 	}
-	/* to process pkts from all workers and +1 to forward arpcimp pkts */
-	for (i = 0; i < epc_app.num_workers + 1; ++i) {
+#ifdef EGRESS_QOS
+	{
+		struct rte_pipeline_table_params table_params = {
+			.ops = &rte_table_stub_ops,
+		};
+
+		if (rte_pipeline_table_create
+		    (p, &table_params, &param->sched_table_id)) {
+			rte_panic
+			    ("%s: Unable to configure the scheduler table\n",
+			     __func__);
+		}
+	}
+	if (rte_pipeline_port_in_connect_to_table
+	    (p, param->sched_port_in_id, param->sched_table_id)) {
+		rte_panic
+		    ("%s: Unable to connect scheduler input port %u\n"
+			" to table %u\n", __func__, param->sched_port_in_id,
+		     param->sched_table_id);
+	}
+#endif	/* EGRESS_QOS */
+	/* to process pkts from the workers and the mct core */
+	for (i = 0; i < n_in; ++i) {
 		if (rte_pipeline_port_in_connect_to_table
 		    (p, param->port_in_id[i], param->table_id)) {
 			rte_panic
@@ -168,7 +378,12 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 	{
 		struct rte_pipeline_table_entry actions = {
 			.action = RTE_PIPELINE_ACTION_PORT,
+#ifdef EGRESS_QOS
+			/* pkts go through the scheduler to the NIC */
+			.port_id = param->sched_port_out_id
+#else
 			.port_id = 0
+#endif
 		};
 		struct rte_pipeline_table_entry *action_ptr;
 
@@ -179,10 +394,29 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 			     __func__, param->table_id);
 		}
 	}
+#ifdef EGRESS_QOS
+	{
+		struct rte_pipeline_table_entry actions = {
+			.action = RTE_PIPELINE_ACTION_PORT,
+			.port_id = param->port_out_id
+		};
+		struct rte_pipeline_table_entry *action_ptr;
+
+		if (rte_pipeline_table_default_entry_add
+		    (p, param->sched_table_id, &actions, &action_ptr)) {
+			rte_panic
+			    ("%s: Unable to add default entry to table %u\n",
+			     __func__, param->sched_table_id);
+		}
+	}
+#endif	/* EGRESS_QOS */
 
-	/* to process pkts from all workers and +1 to forward arpcimp pkts */
-	for (i = 0; i < epc_app.num_workers + 1; ++i)
+	/* to process pkts from the workers and the mct core */
+	for (i = 0; i < n_in; ++i)
 		rte_pipeline_port_in_enable(p, param->port_in_id[i]);
+#ifdef EGRESS_QOS
+	rte_pipeline_port_in_enable(p, param->sched_port_in_id);
+#endif	/* EGRESS_QOS */
 
 	if (rte_pipeline_check(p) < 0)
 		rte_panic("%s: Pipeline consistency check failed\n", __func__);
@@ -194,10 +428,10 @@ void epc_tx_init(struct epc_tx_params *param, int core, uint8_t port)
 void epc_tx(void *args)
 {
 	struct epc_tx_params *param = (struct epc_tx_params *)args;
+	uint32_t n = rte_pipeline_run(param->pipeline);
 
-	rte_pipeline_run(param->pipeline);
-	if (++param->flush_count >= param->flush_max) {
-		rte_pipeline_flush(param->pipeline);
-		param->flush_count = 0;
-	}
+	epc_stage_pkts_add(n);
+	epc_pipeline_flush(param->pipeline, &param->flush_count,
+			&param->flush_max, EPC_FLUSH_CTL(param), n,
+			epc_app.burst_size_tx_read);
 }
@@ -36,6 +36,7 @@
 
 #include "epc_packet_framework.h"
 #include "main.h"
+#include "gtpu_frag.h"
 
 #define BUILD_WK_ARG(x, y) ((x << 8) | (y & 0xff))
 #define WK_GET_PORT(x) (x >> 8)
@@ -52,8 +53,100 @@ static inline int port_in_func(struct rte_pipeline *p, struct rte_mbuf **pkts,
 	int wk_index = WK_GET_INDEX(arg);
 	epc_packet_handler f = epc_worker_func[port];
 
+#if defined(PKT_LATENCY) && defined(WORKER_DIRECT_TX)
+	{
+		int ret = f(p, pkts, n, wk_index);
+
+		/* packets leave on the other port within this run */
+		epc_latency_sample(&epc_app.worker[wk_index].latency[port ^ 1],
+				pkts, n);
+		return ret;
+	}
+#else
 	return f(p, pkts, n, wk_index);
+#endif
+}
+
+#ifdef NIC_RSS_STEERING
+/**
+ * Port in action for packets read directly from the NIC queue owned by the
+ * worker. Control packets are handed over to the mct core, the remaining
+ * packets are compacted at the head of the burst and passed to the
+ * registered worker function.
+ */
+static inline int port_in_steer_func(struct rte_pipeline *p,
+		struct rte_mbuf **pkts, uint32_t n, void *arg_p)
+{
+	int arg = (uintptr_t) arg_p;
+	int port = WK_GET_PORT(arg);
+	int wk_index = WK_GET_INDEX(arg);
+	epc_packet_handler f = epc_worker_func[port];
+	struct rte_mbuf *ctrl_pkts[MAX_BURST_SZ];
+	uint32_t nb_data = 0, nb_ctrl = 0;
+	uint32_t i;
+#ifdef GTPU_FRAG
+	uint64_t held = (port == WEST_PORT_ID || app.spgw_cfg == SGWU) ?
+			gtpu_reassemble(pkts, n) : 0;
+
+	if (unlikely(held)) {
+		uint32_t j = 0;
+
+		/* held fragments leave the burst, its tail is hijacked */
+		for (i = 0; i < n; i++)
+			if (!ISSET_BIT(held, i))
+				pkts[j++] = pkts[i];
+		rte_pipeline_ah_packet_hijack(p,
+				((~0LLU) >> (64 - (n - j))) << j);
+		n = j;
+		if (n == 0)
+			return 0;
+	}
+#endif
+
+	epc_rx_set_meta(pkts, n, port);
+
+	for (i = 0; i < n; i++) {
+		struct epc_meta_data *meta_data =
+			(struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(
+					pkts[i], META_DATA_OFFSET);
+
+		if (likely(meta_data->port_id == 0))
+			pkts[nb_data++] = pkts[i];
+		else
+			ctrl_pkts[nb_ctrl++] = pkts[i];
+	}
+
+	if (unlikely(nb_ctrl)) {
+		uint64_t ctrl_mask = ((~0LLU) >> (64 - nb_ctrl)) << nb_data;
+		uint32_t enq;
+
+		for (i = 0; i < nb_ctrl; i++)
+			pkts[nb_data + i] = ctrl_pkts[i];
+
+		rte_pipeline_ah_packet_hijack(p, ctrl_mask);
+		enq = rte_ring_enqueue_burst(epc_app.epc_mct_rx[port],
+				(void **)ctrl_pkts, nb_ctrl);
+		for (i = enq; i < nb_ctrl; i++)
+			rte_pktmbuf_free(ctrl_pkts[i]);
+	}
+
+	if (nb_data == 0)
+		return 0;
+
+#if defined(PKT_LATENCY) && defined(WORKER_DIRECT_TX)
+	{
+		int ret = f(p, pkts, nb_data, wk_index);
+
+		/* packets leave on the other port within this run */
+		epc_latency_sample(&epc_app.worker[wk_index].latency[port ^ 1],
+				pkts, nb_data);
+		return ret;
+	}
+#else
+	return f(p, pkts, nb_data, wk_index);
+#endif
 }
+#endif	/* NIC_RSS_STEERING */
 
 void epc_worker_core_init(struct epc_worker_params *param, int core,
 		int worker_index)
@@ -61,11 +154,12 @@ void epc_worker_core_init(struct epc_worker_params *param, int core,
 	unsigned i;
 	struct rte_pipeline *p;
 	char name[32];
+	int socket = dp_lcore_socket(core);
 
 	memset(param, 0, sizeof(*param));
 
 	snprintf((char *)param->name, PIPE_NAME_SIZE, "epc_worker_%d", core);
-	param->pipeline_params.socket_id = rte_socket_id();
+	param->pipeline_params.socket_id = socket;
 	param->pipeline_params.name = param->name;
 
 	p = rte_pipeline_create(&param->pipeline_params);
@@ -75,25 +169,44 @@ void epc_worker_core_init(struct epc_worker_params *param, int core,
 
 	param->notify_ring =
 		rte_ring_create(name, NOTIFY_RING_SIZE,
-			rte_socket_id(),
+			socket,
 			RING_F_SP_ENQ | RING_F_SC_DEQ);
 
+#ifdef DDN_BUF_POOL
+	ddn_buf_pool_init(param, core);
+#else
 	snprintf(name, sizeof(name), "ring_container_%d", core);
 	param->dl_ring_container =
 		rte_ring_create(name, DL_RING_CONTAINER_SIZE,
-			rte_socket_id(), RING_F_SC_DEQ);
+			socket, RING_F_SC_DEQ);
 	param->num_dl_rings = 0;
+#endif	/* DDN_BUF_POOL */
 	snprintf(name, sizeof(name), "notify_msg_pool_%d", core);
 	param->notify_msg_pool = rte_pktmbuf_pool_create(name, DL_PKT_POOL_SIZE,
 				DL_PKT_POOL_CACHE_SIZE, 0,
-				RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+				RTE_MBUF_DEFAULT_BUF_SIZE, socket);
 
 	for (i = 0; i < epc_app.n_ports; i++) {
+		int arg = BUILD_WK_ARG(i, worker_index);
+#ifdef NIC_RSS_STEERING
+		/* Worker owns rx queue worker_index on every port */
+		struct rte_port_ethdev_reader_params port_ethdev_params = {
+			.port_id = epc_app.ports[i],
+			.queue_id = worker_index,
+		};
+
+		struct rte_pipeline_port_in_params port_params = {
+			.ops = &rte_port_ethdev_reader_ops,
+			.arg_create = (void *)&port_ethdev_params,
+			.f_action = port_in_steer_func,
+			.arg_ah = (void *)(uintptr_t)arg,
+			.burst_size = epc_app.burst_size_rx_read
+		};
+#else
 		struct rte_port_ring_reader_params port_ring_params = {
 			.ring = epc_app.epc_work_rx[core][i],
 		};
 
-		int arg = BUILD_WK_ARG(i, worker_index);
 		struct rte_pipeline_port_in_params port_params = {
 			.ops = &rte_port_ring_reader_ops,
 			.arg_create = (void *)&port_ring_params,
@@ -101,6 +214,7 @@ void epc_worker_core_init(struct epc_worker_params *param, int core,
 			.arg_ah = (void *)(uintptr_t)arg,
 			.burst_size = epc_app.burst_size_worker_read
 		};
+#endif	/* NIC_RSS_STEERING */
 
 		if (rte_pipeline_port_in_create
 				(p, &port_params, &param->port_in_id[i])) {
@@ -127,15 +241,30 @@ void epc_worker_core_init(struct epc_worker_params *param, int core,
 	}
 
 	for (i = 0; i < epc_app.n_ports; i++) {
+#ifdef WORKER_DIRECT_TX
+		/* Worker owns tx queue worker_index on every port */
+		struct rte_port_ethdev_writer_nodrop_params port_ethdev_params = {
+			.port_id = epc_app.ports[i],
+			.queue_id = worker_index,
+			.tx_burst_sz = epc_app.burst_size_tx_write,
+			.n_retries = 0,
+		};
+
+		struct rte_pipeline_port_out_params port_params = {
+			.ops = &rte_port_ethdev_writer_nodrop_ops,
+			.arg_create = (void *)&port_ethdev_params,
+		};
+#else
 		struct rte_port_ring_writer_params port_ring_params = {
 			.ring = epc_app.ring_tx[core][i],
 			.tx_burst_sz = epc_app.burst_size_worker_write,
 		};
 
 		struct rte_pipeline_port_out_params port_params = {
-			.ops = &rte_port_ring_writer_ops,
+			.ops = &epc_port_ring_writer_ops,
 			.arg_create = (void *)&port_ring_params,
 		};
+#endif	/* WORKER_DIRECT_TX */
 
 		if (rte_pipeline_port_out_create
 				(p, &port_params, &param->port_out_id[i])) {
@@ -218,12 +347,23 @@ void epc_worker_core_init(struct epc_worker_params *param, int core,
 void epc_worker_core(void *args)
 {
 	struct epc_worker_params *param = (struct epc_worker_params *)args;
-
-	rte_pipeline_run(param->pipeline);
-	if (++param->flush_count >= param->flush_max) {
-		rte_pipeline_flush(param->pipeline);
-		param->flush_count = 0;
-	}
+	uint32_t n = rte_pipeline_run(param->pipeline);
+
+	epc_stage_pkts_add(n);
+#ifdef DDN_BUF_POOL
+	if (param->ddn_release.n)
+		ddn_buf_release_run(param, DDN_RELEASE_BURST);
+#endif	/* DDN_BUF_POOL */
+	/* full burst as read by the in ports above */
+#ifdef NIC_RSS_STEERING
+	epc_pipeline_flush(param->pipeline, &param->flush_count,
+			&param->flush_max, EPC_FLUSH_CTL(param), n,
+			epc_app.burst_size_rx_read);
+#else
+	epc_pipeline_flush(param->pipeline, &param->flush_count,
+			&param->flush_max, EPC_FLUSH_CTL(param), n,
+			epc_app.burst_size_worker_read);
+#endif	/* NIC_RSS_STEERING */
 }
 
 void register_worker(epc_packet_handler f, int port)
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef PKT_CAPTURE
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include <rte_ring.h>
+#include <rte_errno.h>
+#include <rte_cycles.h>
+#include <rte_udp.h>
+
+#include "main.h"
+#include "util.h"
+#include "ipv4.h"
+#include "gtpu.h"
+#include "qsbr.h"
+#include "epc_packet_framework.h"
+#include "pkt_capture.h"
+
+/* pcapng block types and options */
+#define PCAPNG_SHB		0x0A0D0D0A
+#define PCAPNG_IDB		0x00000001
+#define PCAPNG_EPB		0x00000006
+#define PCAPNG_BYTE_ORDER	0x1A2B3C4D
+#define PCAPNG_OPT_END		0
+#define PCAPNG_OPT_IF_NAME	2
+#define PCAPNG_OPT_IF_TSRESOL	9
+/** if_tsresol of 10^-9 s */
+#define PCAPNG_TSRESOL_NS	9
+#define PCAPNG_LINKTYPE_ETH	1
+#define PCAPNG_PAD(x)		(((x) + 3) & ~3u)
+
+#define NS_PER_SEC		1000000000ULL
+
+/**
+ * pcapng section header block.
+ */
+struct pcapng_shb {
+	uint32_t type;
+	uint32_t len;
+	uint32_t byte_order;
+	uint16_t major;
+	uint16_t minor;
+	int64_t section_len;
+	uint32_t len_trailer;
+} __attribute__((packed));
+
+/**
+ * pcapng enhanced packet block, up to the pkt data.
+ */
+struct pcapng_epb {
+	uint32_t type;
+	uint32_t len;
+	uint32_t if_id;
+	uint32_t ts_high;
+	uint32_t ts_low;
+	uint32_t caplen;
+	uint32_t origlen;
+} __attribute__((packed));
+
+enum capture_state {
+	CAPTURE_IDLE,
+	CAPTURE_RUNNING,
+	CAPTURE_STOPPING,
+};
+
+volatile uint32_t capture_on;
+struct capture_filter capture_filter;
+
+static struct capture_lcore capture_lcore[RTE_MAX_LCORE];
+/** pkts queued by the workers, by egress port */
+static struct rte_ring *capture_ring[NUM_SPGW_PORTS];
+static const char *capture_if_name[NUM_SPGW_PORTS] = {
+	[S1U_PORT_ID] = "s1u",
+	[SGI_PORT_ID] = "sgi",
+};
+
+/** Set by the CLI, IDLE again once the capture lcore closed the file */
+static volatile int capture_state = CAPTURE_IDLE;
+static FILE *capture_file;
+static char *capture_file_buf;
+static char capture_path[PATH_MAX];
+static uint64_t capture_written;
+/** wall clock and tsc at start of capture */
+static uint64_t capture_base_ns;
+static uint64_t capture_base_tsc;
+
+/**
+ * Check pkt against the teid and UE ip of the filter. Tunneled pkts
+ * match on the GTPU teid and inner ip, uplink pkts on the bearer teid.
+ */
+static inline int
+capture_match(struct rte_mbuf *m, uint32_t teid, uint32_t ue_ip)
+{
+	struct ipv4_hdr *ip;
+	struct udp_hdr *udp;
+	struct gtpu_hdr *gtpu;
+	struct epc_meta_data *meta_data;
+	uint32_t pkt_teid;
+
+	if (!teid && !ue_ip)
+		return 1;
+
+	ip = get_mtoip(m);
+	udp = (struct udp_hdr *)((uint8_t *)ip + IPv4_HDR_SIZE);
+	if ((ip->next_proto_id == IPPROTO_UDP) &&
+			(udp->dst_port == htons(UDP_PORT_GTPU))) {
+		gtpu = get_mtogtpu(m);
+		pkt_teid = ntohl(gtpu->teid);
+		ip = (struct ipv4_hdr *)((uint8_t *)gtpu + GPDU_HDR_SIZE);
+	} else {
+		meta_data = (struct epc_meta_data *)RTE_MBUF_METADATA_UINT8_PTR(
+				m, META_DATA_OFFSET);
+		pkt_teid = meta_data->teid;
+	}
+
+	if (teid && (pkt_teid != teid))
+		return 0;
+	if (ue_ip && (ip->src_addr != ue_ip) && (ip->dst_addr != ue_ip))
+		return 0;
+	return 1;
+}
+
+/**
+ * Read teid and UE ip of the filter as one pair, retrying while the
+ * CLI is updating them.
+ */
+static inline void
+capture_match_get(uint32_t *teid, uint32_t *ue_ip)
+{
+	uint32_t seq;
+
+	do {
+		seq = capture_filter.match_seq;
+		rte_smp_rmb();
+		*teid = capture_filter.teid;
+		*ue_ip = capture_filter.ue_ip;
+		rte_smp_rmb();
+	} while ((seq & 1) || (seq != capture_filter.match_seq));
+}
+
+void
+capture_burst(struct rte_mbuf **pkts, uint32_t n, uint64_t pkts_mask,
+		uint8_t port)
+{
+	struct capture_lcore *cl = &capture_lcore[rte_lcore_id()];
+	struct rte_mbuf *cap[MAX_BURST_SZ];
+	struct rte_mbuf *seg;
+	uint32_t sample = capture_filter.sample;
+	uint32_t teid, ue_ip;
+	uint64_t tsc;
+	uint32_t i, nb = 0, q;
+
+	if (!(capture_filter.port_mask & (1 << port)))
+		return;
+
+	capture_match_get(&teid, &ue_ip);
+	tsc = rte_rdtsc();
+	for (i = 0; i < n; i++) {
+		if (!ISSET_BIT(pkts_mask, i) ||
+				!capture_match(pkts[i], teid, ue_ip))
+			continue;
+		if ((sample > 1) && (cl->seq++ % sample))
+			continue;
+
+		/* every segment is freed by the tx path and the capture
+		 * lcore */
+		for (seg = pkts[i]; seg != NULL; seg = seg->next)
+			rte_mbuf_refcnt_update(seg, 1);
+		pkts[i]->udata64 = tsc;
+		cap[nb++] = pkts[i];
+	}
+	if (nb == 0)
+		return;
+
+	q = rte_ring_mp_enqueue_burst(capture_ring[port], (void **)cap, nb);
+	cl->queued += q;
+	if (unlikely(q < nb)) {
+		cl->full += nb - q;
+		for (i = q; i < nb; i++)
+			rte_pktmbuf_free(cap[i]);
+	}
+}
+
+void
+capture_init(void)
+{
+	char name[RTE_RING_NAMESIZE];
+	unsigned port;
+
+	for (port = 0; port < NUM_SPGW_PORTS; port++) {
+		snprintf(name, sizeof(name), "capture_ring_%u", port);
+		capture_ring[port] = rte_ring_create(name, CAPTURE_RING_SIZE,
+				rte_socket_id(), RING_F_SC_DEQ);
+		if (capture_ring[port] == NULL)
+			rte_panic("Failed to create capture ring - %s\n",
+					rte_strerror(rte_errno));
+	}
+}
+
+/**
+ * Write interface description block of port.
+ */
+static void
+pcapng_write_idb(FILE *f, const char *name)
+{
+	uint32_t name_len = strlen(name);
+	uint32_t len = 16 + 4 + PCAPNG_PAD(name_len) + 4 + 4 + 4 + 4;
+	/* 16 bit linktype and reserved share the third word */
+	uint32_t hdr[4] = {PCAPNG_IDB, len,
+		PCAPNG_LINKTYPE_ETH, CAPTURE_SNAPLEN};
+	uint16_t opt[2];
+	uint8_t tsresol[4] = {PCAPNG_TSRESOL_NS, 0, 0, 0};
+	static const uint8_t pad[4];
+	uint32_t end = PCAPNG_OPT_END;
+
+	fwrite(hdr, sizeof(hdr), 1, f);
+
+	opt[0] = PCAPNG_OPT_IF_NAME;
+	opt[1] = name_len;
+	fwrite(opt, sizeof(opt), 1, f);
+	fwrite(name, name_len, 1, f);
+	fwrite(pad, PCAPNG_PAD(name_len) - name_len, 1, f);
+
+	opt[0] = PCAPNG_OPT_IF_TSRESOL;
+	opt[1] = 1;
+	fwrite(opt, sizeof(opt), 1, f);
+	fwrite(tsresol, sizeof(tsresol), 1, f);
+
+	fwrite(&end, sizeof(end), 1, f);
+	fwrite(&len, sizeof(len), 1, f);
+}
+
+/**
+ * Convert tsc of a worker to ns since the epoch.
+ */
+static inline uint64_t
+capture_ns(uint64_t tsc)
+{
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t d = tsc - capture_base_tsc;
+
+	return capture_base_ns + (d / hz) * NS_PER_SEC +
+			(d % hz) * NS_PER_SEC / hz;
+}
+
+/**
+ * Write pkt as enhanced packet block.
+ */
+static void
+capture_write(struct rte_mbuf *m, unsigned port)
+{
+	static const uint8_t pad[4];
+	struct pcapng_epb epb;
+	struct rte_mbuf *seg;
+	uint64_t ns = capture_ns(m->udata64);
+	uint32_t caplen = RTE_MIN(rte_pktmbuf_pkt_len(m),
+			(uint32_t)CAPTURE_SNAPLEN);
+	uint32_t left = caplen;
+	uint32_t len;
+
+	epb.type = PCAPNG_EPB;
+	epb.len = sizeof(epb) + PCAPNG_PAD(caplen) + 4;
+	epb.if_id = port;
+	epb.ts_high = ns >> 32;
+	epb.ts_low = (uint32_t)ns;
+	epb.caplen = caplen;
+	epb.origlen = rte_pktmbuf_pkt_len(m);
+	fwrite(&epb, sizeof(epb), 1, capture_file);
+
+	for (seg = m; seg != NULL && left; seg = seg->next) {
+		len = RTE_MIN(left, (uint32_t)rte_pktmbuf_data_len(seg));
+		fwrite(rte_pktmbuf_mtod(seg, void *), len, 1, capture_file);
+		left -= len;
+	}
+	fwrite(pad, PCAPNG_PAD(caplen) - caplen, 1, capture_file);
+	fwrite(&epb.len, sizeof(epb.len), 1, capture_file);
+	++capture_written;
+}
+
+int
+capture_start(const char *path, uint32_t port_mask, uint32_t sample)
+{
+	struct pcapng_shb shb = {
+		.type = PCAPNG_SHB,
+		.len = sizeof(shb),
+		.byte_order = PCAPNG_BYTE_ORDER,
+		.major = 1,
+		.minor = 0,
+		.section_len = -1,
+		.len_trailer = sizeof(shb),
+	};
+	struct timespec ts;
+	unsigned port;
+	unsigned lcore;
+
+	if (capture_state != CAPTURE_IDLE) {
+		printf("Capture to %s running\n", capture_path);
+		return -1;
+	}
+
+	capture_file = fopen(path, "w");
+	if (capture_file == NULL) {
+		printf("Failed to open %s - %s\n", path, strerror(errno));
+		return -1;
+	}
+	capture_file_buf = malloc(CAPTURE_FILE_BUF_SIZE);
+	if (capture_file_buf != NULL)
+		setvbuf(capture_file, capture_file_buf, _IOFBF,
+				CAPTURE_FILE_BUF_SIZE);
+
+	fwrite(&shb, sizeof(shb), 1, capture_file);
+	/* interface id is the port id */
+	for (port = 0; port < NUM_SPGW_PORTS; port++)
+		pcapng_write_idb(capture_file, capture_if_name[port]);
+	if (fflush(capture_file)) {
+		printf("Failed to write %s - %s\n", path, strerror(errno));
+		fclose(capture_file);
+		capture_file = NULL;
+		free(capture_file_buf);
+		capture_file_buf = NULL;
+		return -1;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	capture_base_tsc = rte_rdtsc();
+	capture_base_ns = ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+	snprintf(capture_path, sizeof(capture_path), "%s", path);
+	capture_written = 0;
+	RTE_LCORE_FOREACH(lcore) {
+		capture_lcore[lcore].queued = 0;
+		capture_lcore[lcore].full = 0;
+	}
+	capture_filter.port_mask = port_mask;
+	capture_filter.sample = sample;
+
+	/* file and filter are set before the workers see the capture */
+	rte_smp_wmb();
+	capture_state = CAPTURE_RUNNING;
+	capture_on = 1;
+	return 0;
+}
+
+int
+capture_stop(void)
+{
+	if (capture_state != CAPTURE_RUNNING)
+		return -1;
+
+	capture_on = 0;
+	rte_smp_wmb();
+	capture_state = CAPTURE_STOPPING;
+	return 0;
+}
+
+void
+capture_set_match(uint32_t teid, uint32_t ue_ip)
+{
+	/* single writer, the CLI */
+	capture_filter.match_seq++;
+	rte_smp_wmb();
+	capture_filter.teid = teid;
+	capture_filter.ue_ip = ue_ip;
+	rte_smp_wmb();
+	capture_filter.match_seq++;
+}
+
+/**
+ * Close capture file of a stopped capture, on the capture lcore.
+ */
+static void
+capture_close(void)
+{
+	if (fclose(capture_file))
+		RTE_LOG(ERR, DP, "Failed to close %s - %s\n", capture_path,
+				strerror(errno));
+	capture_file = NULL;
+	free(capture_file_buf);
+	capture_file_buf = NULL;
+	RTE_LOG(INFO, DP, "Capture to %s stopped, %"PRIu64" pkts written\n",
+			capture_path, capture_written);
+}
+
+void
+display_capture_stats(void)
+{
+	uint64_t queued = 0, full = 0;
+	unsigned lcore;
+
+	RTE_LCORE_FOREACH(lcore) {
+		queued += capture_lcore[lcore].queued;
+		full += capture_lcore[lcore].full;
+	}
+
+	printf("Capture: %s", capture_state == CAPTURE_IDLE ? "stopped" :
+			capture_state == CAPTURE_RUNNING ? "running" :
+			"stopping");
+	if (capture_state != CAPTURE_IDLE)
+		printf(" to %s", capture_path);
+	printf("\n%-10s %-10s %-16s %-16s %-16s\n", "teid", "sample",
+			"queued", "ring full", "written");
+	printf("%-10u %-10u %-16"PRIu64" %-16"PRIu64" %-16"PRIu64"\n",
+			capture_filter.teid, capture_filter.sample, queued, full,
+			capture_written);
+}
+
+void
+capture_core(__rte_unused void *args)
+{
+	static struct dp_qsbr_token token;
+	static int draining;
+	struct rte_mbuf *m[CAPTURE_BURST];
+	unsigned port, i, n;
+
+	for (port = 0; port < NUM_SPGW_PORTS; port++) {
+		n = rte_ring_sc_dequeue_burst(capture_ring[port], (void **)m,
+				CAPTURE_BURST);
+		for (i = 0; i < n; i++) {
+			if (capture_file != NULL)
+				capture_write(m[i], port);
+			rte_pktmbuf_free(m[i]);
+		}
+	}
+
+	if ((capture_state == CAPTURE_RUNNING) && ferror(capture_file)) {
+		RTE_LOG(ERR, DP, "Failed to write %s, stopping capture\n",
+				capture_path);
+		capture_stop();
+	}
+	if (capture_state != CAPTURE_STOPPING)
+		return;
+
+	/* workers may still be in a burst that saw capture_on */
+	if (!draining) {
+		dp_qsbr_start(&token);
+		draining = 1;
+		return;
+	}
+	if (!dp_qsbr_elapsed(&token))
+		return;
+	for (port = 0; port < NUM_SPGW_PORTS; port++)
+		if (!rte_ring_empty(capture_ring[port]))
+			return;
+
+	capture_close();
+	draining = 0;
+	rte_smp_wmb();
+	capture_state = CAPTURE_IDLE;
+}
+#endif /* PKT_CAPTURE */
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _PKT_CAPTURE_H_
+#define _PKT_CAPTURE_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the runtime packet capture.
+ *
+ * Workers hand a reference (refcnt bump, no copy) to the egress pkts
+ * matching the capture filter to the capture ring; the capture lcore
+ * writes them to a pcapng file and drops the reference. Capture is
+ * started and stopped from the CLI without a rebuild, and costs one
+ * flag check per burst while stopped.
+ */
+#ifdef PKT_CAPTURE
+#include <stdint.h>
+#include <rte_mbuf.h>
+#include <rte_lcore.h>
+
+/** Pkts queued to the capture lcore, power of 2 */
+#define CAPTURE_RING_SIZE	(1 << 12)
+/** Pkts written by the capture lcore per call */
+#define CAPTURE_BURST		32
+/** Max bytes of a pkt written to the capture file */
+#define CAPTURE_SNAPLEN		65535
+/** stdio buffer of the capture file */
+#define CAPTURE_FILE_BUF_SIZE	(1 << 20)
+
+/**
+ * Capture filter. Zero fields match all pkts.
+ */
+struct capture_filter {
+	uint32_t port_mask;	/** egress ports, bit per port id */
+	/** odd while the CLI updates teid and ue_ip */
+	volatile uint32_t match_seq;
+	uint32_t teid;		/** GTPU or uplink bearer teid */
+	uint32_t ue_ip;		/** UE ip, network order */
+	uint32_t sample;	/** capture 1-in-sample matching pkts */
+};
+
+/**
+ * Capture counters of a worker lcore.
+ */
+struct capture_lcore {
+	uint32_t seq;		/** matching pkts, for sampling */
+	uint64_t queued;	/** pkts queued to the capture lcore */
+	uint64_t full;		/** pkts not captured, ring full */
+} __rte_cache_aligned;
+
+/** Set while a capture runs */
+extern volatile uint32_t capture_on;
+extern struct capture_filter capture_filter;
+
+/**
+ * Queue the pkts of pkts_mask matching the capture filter to the
+ * capture lcore. Use capture_pkts().
+ *
+ * @param pkts
+ *	pkts, with ether header at offset 0.
+ * @param n
+ *	number of pkts.
+ * @param pkts_mask
+ *	pkts to be sent.
+ * @param port
+ *	egress port id.
+ *
+ * @return
+ *	None
+ */
+void
+capture_burst(struct rte_mbuf **pkts, uint32_t n, uint64_t pkts_mask,
+		uint8_t port);
+
+/**
+ * Capture egress burst if a capture runs.
+ *
+ * @param pkts
+ *	pkts, with ether header at offset 0.
+ * @param n
+ *	number of pkts.
+ * @param pkts_mask
+ *	pkts to be sent.
+ * @param port
+ *	egress port id.
+ *
+ * @return
+ *	None
+ */
+static inline void
+capture_pkts(struct rte_mbuf **pkts, uint32_t n, uint64_t pkts_mask,
+		uint8_t port)
+{
+	if (likely(!capture_on))
+		return;
+	capture_burst(pkts, n, pkts_mask, port);
+}
+
+/**
+ * Create the capture ring.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void capture_init(void);
+
+/**
+ * Open the capture file and start capturing, matching the teid and UE
+ * ip set with capture_set_match(). Called from the CLI.
+ *
+ * @param path
+ *	pcapng file to write.
+ * @param port_mask
+ *	egress ports to capture, bit per port id.
+ * @param sample
+ *	capture 1-in-sample matching pkts, 0 or 1 for all.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if a capture runs or the file can't be opened
+ */
+int capture_start(const char *path, uint32_t port_mask, uint32_t sample);
+
+/**
+ * Stop capturing. The capture lcore writes the queued pkts and closes
+ * the file once the workers are past the capture.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if no capture runs
+ */
+int capture_stop(void);
+
+/**
+ * Set the teid and UE ip of the filter of the running or next capture.
+ *
+ * @param teid
+ *	teid, 0 for any.
+ * @param ue_ip
+ *	UE ip, network order, 0 for any.
+ *
+ * @return
+ *	None
+ */
+void capture_set_match(uint32_t teid, uint32_t ue_ip);
+
+/**
+ * Print capture state and counters.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_capture_stats(void);
+
+/**
+ * Capture lcore. Writes the queued pkts to the capture file.
+ *
+ * @param args
+ *	unused.
+ *
+ * @return
+ *	None
+ */
+void capture_core(__rte_unused void *args);
+
+#endif /* PKT_CAPTURE */
+#endif /* _PKT_CAPTURE_H_ */
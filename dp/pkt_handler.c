@@ -25,8 +25,16 @@
 #include <locale.h>
 
 #include "main.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "util.h"
 #include "acl.h"
 #include "interface.h"
+#include "flow_cache.h"
+#include "pkt_capture.h"
+#include "s5s8_bypass.h"
+#include "gtpu_frag.h"
+#include "pkt_mirror.h"
 
 #ifdef PCAP_GEN
 extern pcap_dumper_t *pcap_dumper_east;
@@ -39,15 +47,19 @@ notification_handler(struct rte_pipeline *p,
 	void *arg)
 {
 	struct rte_mbuf *buf_pkt = NULL;
-	uint64_t pkt_mask = 0, pkts_queue_mask = 0;
-	struct rte_ring *ring;
 	int64_t *sess;
-	unsigned int ret = 32, num = 32, i;
+	unsigned int i;
 	struct dp_session_info *data;
-	struct dp_session_info *sess_info[MAX_BURST_SZ];
 	int wk_index = (uintptr_t)arg;
 	struct epc_worker_params *wk_params = &epc_app.worker[wk_index];
+#ifndef DDN_BUF_POOL
+	uint64_t pkt_mask = 0, pkts_queue_mask = 0;
+	struct rte_ring *ring;
+	struct rte_mbuf *dl_pkts[MAX_BURST_SZ];
+	unsigned int ret, j;
+	struct dp_session_info *sess_info[MAX_BURST_SZ];
 	struct dp_sdf_per_bearer_info *sdf_info[MAX_BURST_SZ];
+#endif	/* !DDN_BUF_POOL */
 
 	for (i = 0; i < n; ++i) {
 		buf_pkt = pkts[i];
@@ -58,37 +70,47 @@ notification_handler(struct rte_pipeline *p,
 			continue;
 
 		rte_ctrlmbuf_free(buf_pkt);
-		ring = data->dl_ring;
 		if (data->sess_state != CONNECTED)
 			data->sess_state = CONNECTED;
 
+#ifdef DDN_BUF_POOL
+		/* sent by epc_worker_core() within its budget */
+		ddn_buf_release_queue(wk_params, data);
+#else
+		ring = data->dl_ring;
 		if (!ring)
 			continue; /* No dl ring*/
+		data->dl_ring = NULL;
 		/* de-queue this ring and send the downlink pkts*/
-		while (ret) {
-			ret = rte_ring_sc_dequeue_burst(ring,
-					(void **)pkts, num);
-			pkt_mask = (1 << ret) - 1;
-			for (i = 0; i < ret; ++i)
-				sess_info[i] = data;
-			gtpu_encap(&sess_info[0], (struct rte_mbuf **)pkts, ret,
+		while ((ret = rte_ring_sc_dequeue_burst(ring,
+					(void **)dl_pkts, MAX_BURST_SZ)) > 0) {
+			pkt_mask = (~0LLU) >> (64 - ret);
+			pkts_queue_mask = 0;
+			for (j = 0; j < ret; ++j)
+				sess_info[j] = data;
+			gtpu_encap(&sess_info[0], dl_pkts, ret,
 					&pkt_mask, &pkts_queue_mask);
 			if (pkts_queue_mask != 0)
 				RTE_LOG(ERR, DP, "Something is wrong!!, the "
 						"session still doesnt hv "
 						"enb teid\n");
-			update_nexthop_info((struct rte_mbuf **)pkts, num,
+			update_nexthop_info(dl_pkts, ret,
 					&pkt_mask, app.s1u_port, &sdf_info[0]);
-			for (i = 0; i < ret; ++i)
-				rte_pipeline_port_out_packet_insert(
-					epc_app.worker[wk_index].pipeline,
-					app.s1u_port, pkts[i]);
+			for (j = 0; j < ret; ++j) {
+				if (ISSET_BIT(pkt_mask, j))
+					rte_pipeline_port_out_packet_insert(
+						wk_params->pipeline,
+						app.s1u_port, dl_pkts[j]);
+				else
+					rte_pktmbuf_free(dl_pkts[j]);
+			}
 		}
 		if (rte_ring_enqueue(wk_params->dl_ring_container, ring) ==
 				ENOBUFS) {
 			RTE_LOG(ERR, DP, "Can't put ring back, so free it\n");
 			rte_ring_free(ring);
 		}
+#endif	/* DDN_BUF_POOL */
 	}
 
 	return 0;
@@ -101,20 +123,38 @@ sgw_s5_s8_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts,
 	struct dp_sdf_per_bearer_info *sdf_info[MAX_BURST_SZ];
 	struct dp_session_info *si[MAX_BURST_SZ];
 	uint64_t pkts_mask;
+	uint64_t tsc = rte_rdtsc();
 
 	pkts_mask = (~0LLU) >> (64 - n);
 
 	/* Get downlink session info */
 	dl_sess_info_get(pkts, n, &pkts_mask, &sdf_info[0], &si[0]);
+	epc_wk_stage_end(wk_index, WK_STAGE_DL_FILTER, &tsc, n);
 
 	update_enb_info(pkts, n, &pkts_mask, &sdf_info[0]);
+#ifdef EGRESS_QOS
+	if (DP_STAGE_ON(DP_STAGE_EGRESS_QOS))
+		egress_qos_classify(pkts, n, &pkts_mask, &sdf_info[0]);
+#endif /* EGRESS_QOS */
+	epc_wk_stage_end(wk_index, WK_STAGE_ENCAP, &tsc, n);
 
 	/* Update nexthop L2 header*/
 	update_nexthop_info(pkts, n, &pkts_mask, app.s1u_port, &sdf_info[0]);
+#ifdef GTPU_FRAG
+	gtpu_fragment(p, pkts, n, &pkts_mask, app.s1u_port);
+#endif
+	epc_wk_stage_end(wk_index, WK_STAGE_NEXTHOP, &tsc, n);
 
 #ifdef PCAP_GEN
-	dump_pcap(pkts, n, pcap_dumper_east);
+	if (DP_STAGE_ON(DP_STAGE_PCAP))
+		dump_pcap(pkts, n, pcap_dumper_east);
 #endif /* PCAP_GEN */
+#ifdef PKT_CAPTURE
+	capture_pkts(pkts, n, pkts_mask, S1U_PORT_ID);
+#endif /* PKT_CAPTURE */
+#ifdef PKT_MIRROR
+	mirror_pkts(pkts, n, pkts_mask, &sdf_info[0]);
+#endif /* PKT_MIRROR */
 
 	/* Intimate the packets to be dropped*/
 	rte_pipeline_ah_packet_drop(p, ~pkts_mask);
@@ -122,25 +162,35 @@ sgw_s5_s8_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts,
 	return 0;
 }
 
-void
-filter_ul_traffic(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
-		int wk_index, uint64_t *pkts_mask)
+/**
+ * Classify pkts on the SDF and ADC filters and resolve PCC of the results.
+ */
+typedef void (*classify_fn)(struct rte_mbuf **pkts, uint32_t n,
+		uint32_t *adc_rid, struct pcc_id_precedence *sdf_info,
+		struct pcc_id_precedence *adc_info);
+
+static void
+classify_ul_traffic(struct rte_mbuf **pkts, uint32_t n, uint32_t *adc_rid,
+		struct pcc_id_precedence *sdf_info,
+		struct pcc_id_precedence *adc_info)
 {
 	uint32_t *sdf_rule_id = NULL;
-	struct pcc_id_precedence sdf_info[MAX_BURST_SZ];
-	struct pcc_id_precedence adc_info[MAX_BURST_SZ];
-	void *adc_ue_info[MAX_BURST_SZ] = {NULL};
-	struct dp_sdf_per_bearer_info *sdf_bearer_info[MAX_BURST_SZ] = {NULL};
-	uint64_t adc_pkts_mask = 0;
 	uint32_t *adc_rule_a;
 	uint32_t adc_rule_b[MAX_BURST_SZ];
 
+#ifdef COMBINED_SDF_ADC_ACL
+	/* SDF and ADC table lookup*/
+	sdf_adc_ul_lookup(pkts, n, &sdf_rule_id, &adc_rule_a);
+
+	filter_pcc_entry_lookup(FILTER_SDF, sdf_rule_id, n, sdf_info);
+#else
 	sdf_rule_id = sdf_lookup(pkts, n);
 
-	filter_pcc_entry_lookup(FILTER_SDF, sdf_rule_id, n, &sdf_info[0]);
+	filter_pcc_entry_lookup(FILTER_SDF, sdf_rule_id, n, sdf_info);
 
 	/* ADC table lookup*/
 	adc_rule_a = adc_ul_lookup(pkts, n);
+#endif
 
 	/* ADC Hash table lookup*/
 	adc_hash_lookup(pkts, n, &adc_rule_b[0], UL_FLOW);
@@ -149,17 +199,461 @@ filter_ul_traffic(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 	 * overwrite the result from filter table.	*/
 	update_adc_rid_from_domain_lookup(adc_rule_a, &adc_rule_b[0], n);
 
-	/* get ADC UE info struct*/
-	adc_ue_info_get(pkts, n, adc_rule_a, &adc_ue_info[0], UL_FLOW);
+	filter_pcc_entry_lookup(FILTER_ADC, adc_rule_a, n, adc_info);
+
+	memcpy(adc_rid, adc_rule_a, n * sizeof(uint32_t));
+}
+
+static void
+classify_dl_traffic(struct rte_mbuf **pkts, uint32_t n, uint32_t *adc_rid,
+		struct pcc_id_precedence *sdf_info,
+		struct pcc_id_precedence *adc_info)
+{
+	uint32_t *sdf_rule_id = NULL;
+	uint32_t *adc_rule_a;
+	uint32_t adc_rule_b[MAX_BURST_SZ];
+
+#ifdef COMBINED_SDF_ADC_ACL
+	/* SDF and ADC table lookup*/
+	sdf_adc_dl_lookup(pkts, n, &sdf_rule_id, &adc_rule_a);
+
+	filter_pcc_entry_lookup(FILTER_SDF, sdf_rule_id, n, sdf_info);
+#else
+	sdf_rule_id = sdf_lookup(pkts, n);
+
+	filter_pcc_entry_lookup(FILTER_SDF, sdf_rule_id, n, sdf_info);
+
+	/* ADC table lookup*/
+	adc_rule_a = adc_dl_lookup(pkts, n);
+#endif
+
+	/* Identify the DNS rule and update the meta*/
+	update_dns_meta(pkts, n, adc_rule_a);
+
+	/* ADC Hash table lookup*/
+	adc_hash_lookup(pkts, n, &adc_rule_b[0], DL_FLOW);
+
+	/* if adc rule is found in adc domain name table (from hash lookup),
+	 * overwrite the result from filter table.	*/
+	update_adc_rid_from_domain_lookup(adc_rule_a, &adc_rule_b[0], n);
 
-	filter_pcc_entry_lookup(FILTER_ADC, adc_rule_a, n, &adc_info[0]);
+	filter_pcc_entry_lookup(FILTER_ADC, adc_rule_a, n, adc_info);
+
+	memcpy(adc_rid, adc_rule_a, n * sizeof(uint32_t));
+}
+
+#ifdef FLOW_CACHE
+/**
+ * Take the verdicts of known flows from the flow cache and classify
+ * the other pkts only.
+ */
+static inline void
+classify_traffic(struct rte_mbuf **pkts, uint32_t n, uint8_t dir,
+		classify_fn classify, uint32_t *adc_rid,
+		struct pcc_id_precedence *sdf_info,
+		struct pcc_id_precedence *adc_info)
+{
+	struct flow_cache_burst b;
+	struct rte_mbuf *miss_pkts[MAX_BURST_SZ];
+	uint32_t miss_idx[MAX_BURST_SZ];
+	uint32_t miss_rid[MAX_BURST_SZ];
+	struct pcc_id_precedence miss_sdf[MAX_BURST_SZ];
+	struct pcc_id_precedence miss_adc[MAX_BURST_SZ];
+	struct epc_meta_data *meta_data;
+	uint64_t hit_mask;
+	uint32_t i, j, k = 0;
+
+	hit_mask = flow_cache_lookup(&b, pkts, n, dir, adc_rid,
+			sdf_info, adc_info);
+
+	for (i = 0; i < n; i++) {
+		if (ISSET_BIT(hit_mask, i)) {
+			/* DNS pkts are never cached */
+			if (dir == DL_FLOW) {
+				meta_data = (struct epc_meta_data *)
+					RTE_MBUF_METADATA_UINT8_PTR(pkts[i],
+							META_DATA_OFFSET);
+				meta_data->dns = 0;
+			}
+			continue;
+		}
+		miss_pkts[k] = pkts[i];
+		miss_idx[k++] = i;
+	}
+	if (k == 0)
+		return;
+
+	classify(miss_pkts, k, miss_rid, miss_sdf, miss_adc);
+
+	for (i = 0; i < k; i++) {
+		j = miss_idx[i];
+		adc_rid[j] = miss_rid[i];
+		sdf_info[j] = miss_sdf[i];
+		adc_info[j] = miss_adc[i];
+
+		if (dir == DL_FLOW) {
+			meta_data = (struct epc_meta_data *)
+				RTE_MBUF_METADATA_UINT8_PTR(miss_pkts[i],
+						META_DATA_OFFSET);
+			if (meta_data->dns)
+				continue;
+		}
+		flow_cache_insert(&b, j, miss_rid[i], &miss_sdf[i],
+				&miss_adc[i]);
+	}
+}
+#else
+static inline void
+classify_traffic(struct rte_mbuf **pkts, uint32_t n, uint8_t dir,
+		classify_fn classify, uint32_t *adc_rid,
+		struct pcc_id_precedence *sdf_info,
+		struct pcc_id_precedence *adc_info)
+{
+	RTE_SET_USED(dir);
+	classify(pkts, n, adc_rid, sdf_info, adc_info);
+}
+#endif /* FLOW_CACHE */
+
+/**
+ * Apply SDF, ADC and PCC filters on pkts, reset bit of gated pkts.
+ */
+static inline void
+filter_traffic(struct rte_mbuf **pkts, uint32_t n, uint8_t dir,
+		classify_fn classify, void **adc_ue_info, uint64_t *pkts_mask)
+{
+	struct pcc_id_precedence sdf_info[MAX_BURST_SZ];
+	struct pcc_id_precedence adc_info[MAX_BURST_SZ];
+	uint32_t adc_rule_a[MAX_BURST_SZ];
+
+	classify_traffic(pkts, n, dir, classify, &adc_rule_a[0],
+			&sdf_info[0], &adc_info[0]);
+
+	/* get ADC UE info struct*/
+	if (dir == UL_FLOW)
+		adc_ue_info_get(pkts, n, &adc_rule_a[0], adc_ue_info, UL_FLOW);
 
 	pcc_gating(&sdf_info[0], &adc_info[0], n, pkts_mask);
+}
+
+#ifdef DEFAULT_BEARER_FAST_PATH
+/**
+ * Check for a DNS response, which is always filtered to feed the
+ * ADC domain table.
+ */
+static inline int
+is_dns_rsp(struct rte_mbuf *m)
+{
+	struct ipv4_hdr *ip = get_mtoip(m);
+
+#ifdef UE_IPV6
+	if (ip_hdr_is_ipv6(ip))
+		return 0;
+#endif /* UE_IPV6 */
+	return (ip->next_proto_id == IPPROTO_UDP) &&
+		(get_mtoudp(m)->src_port == rte_cpu_to_be_16(DNS_PORT));
+}
+
+/**
+ * Filter only the pkts of sessions not flagged for the default bearer
+ * fast path. Fast path pkts pass with no ADC rule, as matched by the
+ * catch-all PCC rule of their bearer.
+ */
+static inline void
+filter_full_traffic(struct rte_mbuf **pkts, uint32_t n, uint8_t dir,
+		classify_fn classify, struct dp_sdf_per_bearer_info **sdf_info,
+		void **adc_ue_info, uint64_t *pkts_mask)
+{
+	struct rte_mbuf *full_pkts[MAX_BURST_SZ];
+	void *full_adc_ue_info[MAX_BURST_SZ] = {NULL};
+	uint32_t full_idx[MAX_BURST_SZ];
+	struct epc_meta_data *meta_data;
+	struct dp_session_info *si;
+	uint64_t full_mask;
+	uint32_t i, k = 0;
+
+	for (i = 0; i < n; i++) {
+		/* pkts with no bearer are dropped already */
+		if (sdf_info[i] != NULL) {
+			si = sdf_info[i]->bear_sess_info;
+			if ((si == NULL) ||
+					(si->fast_path != sess_fast_path_gen) ||
+					((dir == DL_FLOW) && is_dns_rsp(pkts[i]))) {
+				full_pkts[k] = pkts[i];
+				full_idx[k++] = i;
+				continue;
+			}
+		}
+		if (dir == DL_FLOW) {
+			meta_data = (struct epc_meta_data *)
+				RTE_MBUF_METADATA_UINT8_PTR(pkts[i],
+						META_DATA_OFFSET);
+			meta_data->dns = 0;
+		}
+	}
+
+	if (k == n) {
+		filter_traffic(pkts, n, dir, classify, adc_ue_info, pkts_mask);
+		return;
+	}
+	if (k == 0)
+		return;
+
+	full_mask = (~0LLU) >> (64 - k);
+	filter_traffic(full_pkts, k, dir, classify, &full_adc_ue_info[0],
+			&full_mask);
+
+	for (i = 0; i < k; i++) {
+		adc_ue_info[full_idx[i]] = full_adc_ue_info[i];
+		if (!ISSET_BIT(full_mask, i))
+			RESET_BIT(*pkts_mask, full_idx[i]);
+	}
+}
+#endif /* DEFAULT_BEARER_FAST_PATH */
+
+#ifdef RUNTIME_STAGES
+/**
+ * State of a burst passed along the charging stages.
+ */
+struct pkt_stage_ctx {
+	struct rte_mbuf **pkts;
+	uint32_t n;
+	uint8_t dir;
+	uint64_t *pkts_mask;
+	uint64_t adc_pkts_mask;
+	struct dp_sdf_per_bearer_info **sdf_info;
+	void **adc_ue_info;
+};
+
+typedef void (*pkt_stage_fn)(struct pkt_stage_ctx *c);
+
+#define PKT_STAGES_MAX	8
+
+/**
+ * Charging stages of a direction, in the order they run.
+ */
+struct pkt_stage_list {
+	pkt_stage_fn fn[PKT_STAGES_MAX];
+	const char *name[PKT_STAGES_MAX];
+	uint32_t n;
+};
+
+static struct pkt_stage_list ul_stages;
+static struct pkt_stage_list dl_stages;
+
+#ifdef MTR_HIERARCHICAL
+static void
+stage_hier_mtr(struct pkt_stage_ctx *c)
+{
+	hier_mtr_process_pkt(c->sdf_info, c->adc_ue_info, c->dir, c->pkts,
+			c->n, c->pkts_mask);
+}
+#else
+#ifdef SDF_MTR
+static void
+stage_sdf_mtr(struct pkt_stage_ctx *c)
+{
+	sdf_mtr_process_pkt(c->sdf_info, c->adc_ue_info, &c->adc_pkts_mask,
+			c->pkts, c->n, c->pkts_mask);
+}
+#endif /* SDF_MTR */
+#ifdef APN_MTR
+static void
+stage_apn_mtr(struct pkt_stage_ctx *c)
+{
+	apn_mtr_process_pkt(c->sdf_info, c->dir, c->pkts, c->n, c->pkts_mask);
+}
+#endif /* APN_MTR */
+#endif /* MTR_HIERARCHICAL */
+
+static void
+stage_sdf_cdr(struct pkt_stage_ctx *c)
+{
+	update_sdf_cdr(c->adc_ue_info, c->sdf_info, c->pkts, c->n,
+			&c->adc_pkts_mask, c->pkts_mask, c->dir);
+}
+
+#ifdef RATING_GRP_CDR
+static void
+stage_rating_grp(struct pkt_stage_ctx *c)
+{
+	uint8_t rg_idx[MAX_BURST_SZ];
+
+	get_rating_grp(c->adc_ue_info, (void **)c->sdf_info, &rg_idx[0], c->n);
+	update_rating_grp_cdr((void **)c->sdf_info, &rg_idx[0], c->pkts, c->n,
+			c->pkts_mask, c->dir);
+}
+#endif /* RATING_GRP_CDR */
+
+#ifdef EGRESS_QOS
+static void
+stage_egress_qos(struct pkt_stage_ctx *c)
+{
+	egress_qos_classify(c->pkts, c->n, c->pkts_mask, c->sdf_info);
+}
+#endif /* EGRESS_QOS */
+
+#ifdef HYPERSCAN_DPI
+static void
+stage_dns(struct pkt_stage_ctx *c)
+{
+	/* Send cloned dns pkts to dns handler*/
+	clone_dns_pkts(c->pkts, c->n, *c->pkts_mask);
+}
+#endif /* HYPERSCAN_DPI */
+
+static void
+stage_add(struct pkt_stage_list *l, pkt_stage_fn fn, const char *name)
+{
+	if (l->n == PKT_STAGES_MAX)
+		rte_panic("Too many worker stages\n");
+	l->fn[l->n] = fn;
+	l->name[l->n++] = name;
+}
+
+static void
+stage_add_both(pkt_stage_fn fn, const char *name)
+{
+	stage_add(&ul_stages, fn, name);
+	stage_add(&dl_stages, fn, name);
+}
+
+static void
+stage_list_print(const char *dir, const struct pkt_stage_list *l)
+{
+	uint32_t i;
+
+	printf("%s worker stages:", dir);
+	for (i = 0; i < l->n; i++)
+		printf(" %s", l->name[i]);
+	printf("\n");
+}
+
+void
+pkt_stages_init(uint32_t stages)
+{
+	uint32_t built = 0;
+
+	ul_stages.n = 0;
+	dl_stages.n = 0;
+
+	/* meter before charging, dropped pkts are not counted */
+#ifdef MTR_HIERARCHICAL
+	built |= DP_STAGE_SDF_MTR | DP_STAGE_APN_MTR;
+	if (stages & (DP_STAGE_SDF_MTR | DP_STAGE_APN_MTR))
+		stage_add_both(stage_hier_mtr, "hier_mtr");
+#else
+#ifdef SDF_MTR
+	built |= DP_STAGE_SDF_MTR;
+	if (stages & DP_STAGE_SDF_MTR)
+		stage_add_both(stage_sdf_mtr, "sdf_mtr");
+#endif /* SDF_MTR */
+#ifdef APN_MTR
+	built |= DP_STAGE_APN_MTR;
+	if (stages & DP_STAGE_APN_MTR)
+		stage_add_both(stage_apn_mtr, "apn_mtr");
+#endif /* APN_MTR */
+#endif /* MTR_HIERARCHICAL */
+
+	stage_add_both(stage_sdf_cdr, "sdf_cdr");
+
+#ifdef RATING_GRP_CDR
+	built |= DP_STAGE_RATING_GRP;
+	if (stages & DP_STAGE_RATING_GRP)
+		stage_add_both(stage_rating_grp, "rating_grp");
+#endif /* RATING_GRP_CDR */
+#ifdef EGRESS_QOS
+	built |= DP_STAGE_EGRESS_QOS;
+	if (stages & DP_STAGE_EGRESS_QOS)
+		stage_add_both(stage_egress_qos, "egress_qos");
+#endif /* EGRESS_QOS */
+#ifdef HYPERSCAN_DPI
+	built |= DP_STAGE_DNS;
+	if (stages & DP_STAGE_DNS)
+		stage_add(&dl_stages, stage_dns, "dns");
+#endif /* HYPERSCAN_DPI */
+#ifdef PCAP_GEN
+	built |= DP_STAGE_PCAP;
+#endif /* PCAP_GEN */
+
+	if (stages & ~built & DP_STAGE_ALL)
+		RTE_LOG(NOTICE, DP, "Stages 0x%x not compiled in, ignored\n",
+				stages & ~built & DP_STAGE_ALL);
+	app.stages = stages & built;
+
+	stage_list_print("UL", &ul_stages);
+	stage_list_print("DL", &dl_stages);
+}
+
+static inline void
+run_stages(const struct pkt_stage_list *l, struct pkt_stage_ctx *c)
+{
+	uint32_t i;
+
+	for (i = 0; i < l->n; i++)
+		l->fn[i](c);
+}
+#endif /* RUNTIME_STAGES */
+
+void
+filter_ul_traffic(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
+		int wk_index, struct dp_sdf_per_bearer_info *sdf_bearer_info[],
+		uint64_t *pkts_mask)
+{
+	void *adc_ue_info[MAX_BURST_SZ] = {NULL};
+	uint64_t adc_pkts_mask = 0;
+#if defined(RATING_GRP_CDR) && !defined(RUNTIME_STAGES)
+	uint8_t rg_idx[MAX_BURST_SZ];
+#endif /* RATING_GRP_CDR */
+
+#ifdef DEFAULT_BEARER_FAST_PATH
+	/* session flags select the pkts to filter */
+	ul_sess_info_get(pkts, n, pkts_mask, &sdf_bearer_info[0]);
+
+	filter_full_traffic(pkts, n, UL_FLOW, classify_ul_traffic,
+			&sdf_bearer_info[0], &adc_ue_info[0], pkts_mask);
+#else
+	filter_traffic(pkts, n, UL_FLOW, classify_ul_traffic, &adc_ue_info[0],
+			pkts_mask);
 
 	ul_sess_info_get(pkts, n, pkts_mask, &sdf_bearer_info[0]);
+#endif /* DEFAULT_BEARER_FAST_PATH */
+
+#ifdef RUNTIME_STAGES
+	struct pkt_stage_ctx c = {
+		.pkts = pkts, .n = n, .dir = UL_FLOW, .pkts_mask = pkts_mask,
+		.adc_pkts_mask = adc_pkts_mask, .sdf_info = &sdf_bearer_info[0],
+		.adc_ue_info = &adc_ue_info[0],
+	};
+
+	run_stages(&ul_stages, &c);
+#else
+
+	/* meter before charging, dropped pkts are not counted */
+#ifdef MTR_HIERARCHICAL
+	hier_mtr_process_pkt(&sdf_bearer_info[0], &adc_ue_info[0], UL_FLOW, pkts, n,
+			pkts_mask);
+#else
+#ifdef SDF_MTR
+	sdf_mtr_process_pkt(&sdf_bearer_info[0], &adc_ue_info[0], &adc_pkts_mask,
+			pkts, n, pkts_mask);
+#endif /* SDF_MTR */
+#ifdef APN_MTR
+	apn_mtr_process_pkt(&sdf_bearer_info[0], UL_FLOW, pkts, n, pkts_mask);
+#endif /* APN_MTR */
+#endif /* MTR_HIERARCHICAL */
 
 	update_sdf_cdr(&adc_ue_info[0], &sdf_bearer_info[0], pkts, n,
 			&adc_pkts_mask, pkts_mask, UL_FLOW);
+#ifdef RATING_GRP_CDR
+	get_rating_grp(&adc_ue_info[0], (void **)&sdf_bearer_info[0],
+			&rg_idx[0], n);
+	update_rating_grp_cdr((void **)&sdf_bearer_info[0], &rg_idx[0], pkts, n,
+			pkts_mask, UL_FLOW);
+#endif /* RATING_GRP_CDR */
+#ifdef EGRESS_QOS
+	egress_qos_classify(pkts, n, pkts_mask, &sdf_bearer_info[0]);
+#endif /* EGRESS_QOS */
+#endif /* RUNTIME_STAGES */
 
 	return;
 }
@@ -171,6 +665,7 @@ s1u_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 	struct dp_sdf_per_bearer_info *sdf_info[MAX_BURST_SZ];
 	uint64_t pkts_mask;
 	uint32_t next_port;
+	uint64_t tsc = rte_rdtsc();
 
 	pkts_mask = (~0LLU) >> (64 - n);
 
@@ -178,9 +673,12 @@ s1u_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 		case SPGWU: {
 			/* Decap GTPU and update meta data*/
 			gtpu_decap(pkts, n, &pkts_mask);
+			epc_wk_stage_end(wk_index, WK_STAGE_DECAP, &tsc, n);
 
 			/*Apply adc, sdf, pcc filters on uplink traffic*/
-			filter_ul_traffic(p, pkts, n, wk_index, &pkts_mask);
+			filter_ul_traffic(p, pkts, n, wk_index, &sdf_info[0],
+					&pkts_mask);
+			epc_wk_stage_end(wk_index, WK_STAGE_UL_FILTER, &tsc, n);
 
 			/*Set next hop directly to SGi*/
 			next_port = app.sgi_port;
@@ -193,6 +691,12 @@ s1u_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 			/* Set next hop IP to S5/S8 PGW port*/
 			next_port = app.s5s8_sgwu_port;
 			update_nexts5s8_info(pkts, n, &pkts_mask, &sdf_info[0]);
+#ifdef EGRESS_QOS
+			if (DP_STAGE_ON(DP_STAGE_EGRESS_QOS))
+				egress_qos_classify(pkts, n, &pkts_mask,
+						&sdf_info[0]);
+#endif /* EGRESS_QOS */
+			epc_wk_stage_end(wk_index, WK_STAGE_UL_FILTER, &tsc, n);
 			break;
 		}
 
@@ -201,11 +705,28 @@ s1u_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 	}
 
 	/* Update nexthop L2 header*/
+#ifdef S5S8_BYPASS
+	if (next_port == s5s8_bypass_port)
+		s5s8_bypass_tx(pkts, n, &pkts_mask);
+#endif
 	update_nexthop_info(pkts, n, &pkts_mask, next_port, &sdf_info[0]);
+#ifdef GTPU_FRAG
+	/* reassembled uplink pkts carried on to the PGWU */
+	if (app.spgw_cfg == SGWU)
+		gtpu_fragment(p, pkts, n, &pkts_mask, next_port);
+#endif
+	epc_wk_stage_end(wk_index, WK_STAGE_NEXTHOP, &tsc, n);
 
 #ifdef PCAP_GEN
-	dump_pcap(pkts, n, pcap_dumper_west);
+	if (DP_STAGE_ON(DP_STAGE_PCAP))
+		dump_pcap(pkts, n, pcap_dumper_west);
 #endif /* PCAP_GEN */
+#ifdef PKT_CAPTURE
+	capture_pkts(pkts, n, pkts_mask, SGI_PORT_ID);
+#endif /* PKT_CAPTURE */
+#ifdef PKT_MIRROR
+	mirror_pkts(pkts, n, pkts_mask, &sdf_info[0]);
+#endif /* PKT_MIRROR */
 
 	/* Intimate the packets to be dropped*/
 	rte_pipeline_ah_packet_drop(p, ~pkts_mask);
@@ -219,20 +740,31 @@ pgw_s5_s8_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts,
 {
 	struct dp_sdf_per_bearer_info *sdf_info[MAX_BURST_SZ];
 	uint64_t pkts_mask;
+	uint64_t tsc = rte_rdtsc();
 
 	pkts_mask = (~0LLU) >> (64 - n);
 
 	gtpu_decap(pkts, n, &pkts_mask);
+	epc_wk_stage_end(wk_index, WK_STAGE_DECAP, &tsc, n);
 
 	/*Apply adc, sdf, pcc filters on uplink traffic*/
-	filter_ul_traffic(p, pkts, n, wk_index, &pkts_mask);
+	filter_ul_traffic(p, pkts, n, wk_index, &sdf_info[0], &pkts_mask);
+	epc_wk_stage_end(wk_index, WK_STAGE_UL_FILTER, &tsc, n);
 
 	/* Update nexthop L2 header*/
 	update_nexthop_info(pkts, n, &pkts_mask, app.sgi_port, &sdf_info[0]);
+	epc_wk_stage_end(wk_index, WK_STAGE_NEXTHOP, &tsc, n);
 
 #ifdef PCAP_GEN
-	dump_pcap(pkts, n, pcap_dumper_west);
+	if (DP_STAGE_ON(DP_STAGE_PCAP))
+		dump_pcap(pkts, n, pcap_dumper_west);
 #endif /* PCAP_GEN */
+#ifdef PKT_CAPTURE
+	capture_pkts(pkts, n, pkts_mask, SGI_PORT_ID);
+#endif /* PKT_CAPTURE */
+#ifdef PKT_MIRROR
+	mirror_pkts(pkts, n, pkts_mask, &sdf_info[0]);
+#endif /* PKT_MIRROR */
 
 	/* Intimate the packets to be dropped*/
 	rte_pipeline_ah_packet_drop(p, ~pkts_mask);
@@ -245,47 +777,67 @@ filter_dl_traffic(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 		int wk_index, struct dp_sdf_per_bearer_info *sdf_info[],
 		struct dp_session_info *si[])
 {
-	uint32_t *sdf_rule_id = NULL;
 	uint64_t pkts_mask;
-	struct pcc_id_precedence sdf_info_dl[MAX_BURST_SZ];
-	struct pcc_id_precedence adc_info_dl[MAX_BURST_SZ];
 	uint64_t adc_pkts_mask = 0;
 	void *adc_ue_info[MAX_BURST_SZ] = {NULL};
+#if defined(RATING_GRP_CDR) && !defined(RUNTIME_STAGES)
+	uint8_t rg_idx[MAX_BURST_SZ];
+#endif /* RATING_GRP_CDR */
 
 	pkts_mask = (~0LLU) >> (64 - n);
 
-	sdf_rule_id = sdf_lookup(pkts, n);
-
-	filter_pcc_entry_lookup(FILTER_SDF, sdf_rule_id, n, &sdf_info_dl[0]);
-
-	uint32_t *adc_rule_a;
-	uint32_t adc_rule_b[MAX_BURST_SZ];
-
-	/* ADC table lookup*/
-	adc_rule_a = adc_dl_lookup(pkts, n);
-
-	/* Identify the DNS rule and update the meta*/
-	update_dns_meta(pkts, n, adc_rule_a);
-
-	/* ADC Hash table lookup*/
-	adc_hash_lookup(pkts, n, &adc_rule_b[0], DL_FLOW);
-
-	/* if adc rule is found in adc domain name table (from hash lookup),
-	 * overwrite the result from filter table.	*/
-	update_adc_rid_from_domain_lookup(adc_rule_a, &adc_rule_b[0], n);
-
-	filter_pcc_entry_lookup(FILTER_ADC, adc_rule_a, n, &adc_info_dl[0]);
+#ifdef DEFAULT_BEARER_FAST_PATH
+	/* session flags select the pkts to filter */
+	dl_sess_info_get(pkts, n, &pkts_mask, &sdf_info[0], &si[0]);
 
-	pcc_gating(&sdf_info_dl[0], &adc_info_dl[0], n, &pkts_mask);
+	filter_full_traffic(pkts, n, DL_FLOW, classify_dl_traffic,
+			&sdf_info[0], &adc_ue_info[0], &pkts_mask);
+#else
+	filter_traffic(pkts, n, DL_FLOW, classify_dl_traffic, &adc_ue_info[0],
+			&pkts_mask);
 
 	dl_sess_info_get(pkts, n, &pkts_mask, &sdf_info[0], &si[0]);
+#endif /* DEFAULT_BEARER_FAST_PATH */
+
+#ifdef RUNTIME_STAGES
+	struct pkt_stage_ctx c = {
+		.pkts = pkts, .n = n, .dir = DL_FLOW, .pkts_mask = &pkts_mask,
+		.adc_pkts_mask = adc_pkts_mask, .sdf_info = &sdf_info[0],
+		.adc_ue_info = &adc_ue_info[0],
+	};
+
+	run_stages(&dl_stages, &c);
+#else
+
+	/* meter before charging, dropped pkts are not counted */
+#ifdef MTR_HIERARCHICAL
+	hier_mtr_process_pkt(&sdf_info[0], &adc_ue_info[0], DL_FLOW, pkts, n,
+			&pkts_mask);
+#else
+#ifdef SDF_MTR
+	sdf_mtr_process_pkt(&sdf_info[0], &adc_ue_info[0], &adc_pkts_mask,
+			pkts, n, &pkts_mask);
+#endif /* SDF_MTR */
+#ifdef APN_MTR
+	apn_mtr_process_pkt(&sdf_info[0], DL_FLOW, pkts, n, &pkts_mask);
+#endif /* APN_MTR */
+#endif /* MTR_HIERARCHICAL */
 
 	update_sdf_cdr(&adc_ue_info[0], &sdf_info[0], pkts, n,
 			&adc_pkts_mask, &pkts_mask, DL_FLOW);
+#ifdef RATING_GRP_CDR
+	get_rating_grp(&adc_ue_info[0], (void **)&sdf_info[0], &rg_idx[0], n);
+	update_rating_grp_cdr((void **)&sdf_info[0], &rg_idx[0], pkts, n,
+			&pkts_mask, DL_FLOW);
+#endif /* RATING_GRP_CDR */
+#ifdef EGRESS_QOS
+	egress_qos_classify(pkts, n, &pkts_mask, &sdf_info[0]);
+#endif /* EGRESS_QOS */
 #ifdef HYPERSCAN_DPI
 	/* Send cloned dns pkts to dns handler*/
 	clone_dns_pkts(pkts, n, pkts_mask);
 #endif /* HYPERSCAN_DPI */
+#endif /* RUNTIME_STAGES */
 
 	return pkts_mask;
 }
@@ -302,6 +854,7 @@ sgi_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 	struct dp_session_info *si[MAX_BURST_SZ];
 	uint64_t pkts_mask, pkts_queue_mask = 0;
 	uint32_t next_port;
+	uint64_t tsc = rte_rdtsc();
 
 	pkts_mask = (~0LLU) >> (64 - n);
 
@@ -314,9 +867,11 @@ sgi_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 		case SPGWU:
 			/* Filter Downlink traffic. Apply adc, sdf, pcc*/
 			pkts_mask = filter_dl_traffic(p, pkts, n, wk_index, sdf_info, si);
+			epc_wk_stage_end(wk_index, WK_STAGE_DL_FILTER, &tsc, n);
 
 			/* Encap GTPU header*/
 			gtpu_encap(&si[0], pkts, n, &pkts_mask, &pkts_queue_mask);
+			epc_wk_stage_end(wk_index, WK_STAGE_ENCAP, &tsc, n);
 
 			/*Next port is S1U for SPGW*/
 			next_port = app.s1u_port;
@@ -331,9 +886,11 @@ sgi_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 		case PGWU:
 			/*Filter downlink traffic. Apply adc, sdf, pcc*/
 			pkts_mask = filter_dl_traffic(p, pkts, n, wk_index, sdf_info, si);
+			epc_wk_stage_end(wk_index, WK_STAGE_DL_FILTER, &tsc, n);
 
 			/* Encap for S5/S8*/
 			gtpu_encap(&si[0], pkts, n, &pkts_mask, &pkts_queue_mask);
+			epc_wk_stage_end(wk_index, WK_STAGE_ENCAP, &tsc, n);
 
 			/*Set next port to S5/S8*/
 			next_port = app.s5s8_pgwu_port;
@@ -345,11 +902,27 @@ sgi_pkt_handler(struct rte_pipeline *p, struct rte_mbuf **pkts, uint32_t n,
 
 
 	/* Update nexthop L2 header*/
+#ifdef S5S8_BYPASS
+	if (next_port == s5s8_bypass_port)
+		s5s8_bypass_tx(pkts, n, &pkts_mask);
+#endif
 	update_nexthop_info(pkts, n, &pkts_mask, next_port, &sdf_info[0]);
+#ifdef GTPU_FRAG
+	/* the encap may take full size pkts over the MTU */
+	gtpu_fragment(p, pkts, n, &pkts_mask, next_port);
+#endif
+	epc_wk_stage_end(wk_index, WK_STAGE_NEXTHOP, &tsc, n);
 
 #ifdef PCAP_GEN
-	dump_pcap(pkts, n, pcap_dumper_east);
+	if (DP_STAGE_ON(DP_STAGE_PCAP))
+		dump_pcap(pkts, n, pcap_dumper_east);
 #endif /* PCAP_GEN */
+#ifdef PKT_CAPTURE
+	capture_pkts(pkts, n, pkts_mask, S1U_PORT_ID);
+#endif /* PKT_CAPTURE */
+#ifdef PKT_MIRROR
+	mirror_pkts(pkts, n, pkts_mask, &sdf_info[0]);
+#endif /* PKT_MIRROR */
 
 	/* Intimate the packets to be dropped*/
 	rte_pipeline_ah_packet_drop(p, ~pkts_mask);
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef PKT_MIRROR
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <rte_ring.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_hash.h>
+#include <rte_spinlock.h>
+
+#include "main.h"
+#include "util.h"
+#include "epc_packet_framework.h"
+#include "pkt_mirror.h"
+
+extern struct rte_hash *rte_sess_hash;
+
+volatile uint32_t mirror_on;
+uint8_t mirror_port = MIRROR_PORT_NONE;
+
+static struct mirror_lcore mirror_lcore[RTE_MAX_LCORE];
+static struct rte_ring *mirror_ring;
+/** indirect mbufs of the clones */
+static struct rte_mempool *mirror_pool;
+static uint32_t mirror_sample;
+static uint32_t mirror_snaplen;
+/** sent and dropped by the mct core */
+static uint64_t mirror_tx;
+static uint64_t mirror_tx_drop;
+
+/** CLI selectors, read by the iface core */
+static struct mirror_select mirror_sel[MIRROR_SELECT_MAX];
+static uint32_t mirror_sel_n;
+static rte_spinlock_t mirror_sel_lock = RTE_SPINLOCK_INITIALIZER;
+/** bumped by the CLI on a selector change */
+static volatile uint32_t mirror_sel_gen;
+/** selector change the bearers are updated for */
+static uint32_t mirror_sel_done;
+/** session table position of the running update, 0 between updates */
+static uint32_t mirror_sel_iter;
+
+int
+mirror_parse(const char *arg)
+{
+	char *end;
+	unsigned long port = strtoul(arg, &end, 10);
+
+	if (*arg == '\0' || *end != '\0' || port >= MIRROR_PORT_NONE) {
+		printf("Invalid mirror_port %s\n", arg);
+		return -1;
+	}
+	mirror_port = port;
+	printf("Parsed mirror_port:\t%u\n", mirror_port);
+	return 0;
+}
+
+/**
+ * Clone pkt, up to mirror_snaplen bytes. The segments of the clone
+ * reference the data of the pkt.
+ */
+static struct rte_mbuf *
+mirror_clone(struct rte_mbuf *m)
+{
+	struct rte_mbuf *c, *seg;
+	uint32_t left = mirror_snaplen;
+
+	c = rte_pktmbuf_clone(m, mirror_pool);
+	if (c == NULL)
+		return NULL;
+
+	/* the mirror port may not offload what the egress port does */
+	c->ol_flags &= epc_app.tx_cksum_ol[mirror_port];
+	if ((left == 0) || (left >= rte_pktmbuf_pkt_len(c)))
+		return c;
+
+	c->pkt_len = left;
+	c->nb_segs = 1;
+	for (seg = c; seg->data_len < left; seg = seg->next) {
+		left -= seg->data_len;
+		c->nb_segs++;
+	}
+	seg->data_len = left;
+	if (seg->next != NULL) {
+		rte_pktmbuf_free(seg->next);
+		seg->next = NULL;
+	}
+	return c;
+}
+
+void
+mirror_burst(struct rte_mbuf **pkts, uint32_t n, uint64_t mirror_mask)
+{
+	struct mirror_lcore *ml = &mirror_lcore[rte_lcore_id()];
+	struct rte_mbuf *clone[MAX_BURST_SZ];
+	uint32_t sample = mirror_sample;
+	uint32_t i, nb = 0, q;
+
+	for (i = 0; i < n; i++) {
+		if (!ISSET_BIT(mirror_mask, i))
+			continue;
+		if ((sample > 1) && (ml->seq++ % sample))
+			continue;
+
+		clone[nb] = mirror_clone(pkts[i]);
+		if (unlikely(clone[nb] == NULL)) {
+			ml->nombuf++;
+			continue;
+		}
+		nb++;
+	}
+	if (nb == 0)
+		return;
+
+	q = rte_ring_mp_enqueue_burst(mirror_ring, (void **)clone, nb);
+	ml->queued += q;
+	if (unlikely(q < nb)) {
+		ml->full += nb - q;
+		for (i = q; i < nb; i++)
+			rte_pktmbuf_free(clone[i]);
+	}
+}
+
+void
+mirror_init(void)
+{
+	if (mirror_port == MIRROR_PORT_NONE)
+		return;
+	if (mirror_port >= rte_eth_dev_count())
+		rte_exit(EXIT_FAILURE, "Invalid mirror port %u\n",
+				mirror_port);
+
+	mirror_ring = rte_ring_create("mirror_ring", MIRROR_RING_SIZE,
+			rte_eth_dev_socket_id(mirror_port), RING_F_SC_DEQ);
+	if (mirror_ring == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot create mirror ring - %s\n",
+				rte_strerror(rte_errno));
+
+	/* clones hold no data of their own */
+	mirror_pool = rte_pktmbuf_pool_create("MIRROR_POOL",
+			MIRROR_NUM_MBUFS, 250, 0, 0,
+			rte_eth_dev_socket_id(mirror_port));
+	if (mirror_pool == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot create mirror mempool\n");
+
+	rte_smp_wmb();
+	mirror_on = 1;
+	RTE_LOG(INFO, DP, "Mirroring to port %u tx queue %u\n",
+			mirror_port, epc_app.mirror_queue);
+}
+
+/**
+ * Check bearer against the CLI selectors.
+ */
+static int
+mirror_sess_match(const struct dp_session_info *data)
+{
+	const struct mirror_select *s;
+	uint32_t i;
+	int match = 0;
+
+	rte_spinlock_lock(&mirror_sel_lock);
+	for (i = 0; i < mirror_sel_n && !match; i++) {
+		s = &mirror_sel[i];
+		match = (!s->teid || (s->teid == data->ul_s1_info.sgw_teid)
+				|| (s->teid == data->dl_s1_info.enb_teid))
+			&& (!s->ue_ip || (s->ue_ip == data->ue_addr.u.ipv4_addr));
+	}
+	rte_spinlock_unlock(&mirror_sel_lock);
+	return match;
+}
+
+void
+mirror_sess_update(struct dp_session_info *data)
+{
+	data->mirror = data->mirror_cp || mirror_sess_match(data);
+}
+
+int
+mirror_select_set(uint32_t teid, uint32_t ue_ip, int add)
+{
+	uint32_t i;
+	int ret = -1;
+
+	rte_spinlock_lock(&mirror_sel_lock);
+	for (i = 0; i < mirror_sel_n; i++)
+		if ((mirror_sel[i].teid == teid) &&
+				(mirror_sel[i].ue_ip == ue_ip))
+			break;
+
+	if (add && (i < mirror_sel_n)) {
+		ret = 0;
+	} else if (add && (mirror_sel_n < MIRROR_SELECT_MAX)) {
+		mirror_sel[mirror_sel_n].teid = teid;
+		mirror_sel[mirror_sel_n].ue_ip = ue_ip;
+		mirror_sel_n++;
+		ret = 0;
+	} else if (!add && (i < mirror_sel_n)) {
+		mirror_sel[i] = mirror_sel[--mirror_sel_n];
+		ret = 0;
+	}
+	rte_spinlock_unlock(&mirror_sel_lock);
+
+	if (ret == 0)
+		__sync_add_and_fetch(&mirror_sel_gen, 1);
+	return ret;
+}
+
+void
+mirror_set_sample(uint32_t sample, uint32_t snaplen)
+{
+	mirror_sample = sample;
+	mirror_snaplen = snaplen;
+}
+
+void
+mirror_select_poll(unsigned budget)
+{
+	const void *next_key;
+	void *next_data;
+
+	if (rte_sess_hash == NULL)
+		return;
+	if (mirror_sel_iter == 0) {
+		if (mirror_sel_done == mirror_sel_gen)
+			return;
+		mirror_sel_done = mirror_sel_gen;
+	}
+
+	/* Only the iface core updates the table. A change while the walk
+	 * runs starts another walk once this one is done. */
+	while (budget--) {
+		if (rte_hash_iterate(rte_sess_hash, &next_key, &next_data,
+					&mirror_sel_iter) < 0) {
+			mirror_sel_iter = 0;
+			return;
+		}
+		mirror_sess_update(next_data);
+	}
+}
+
+void
+display_mirror_stats(void)
+{
+	uint64_t queued = 0, full = 0, nombuf = 0;
+	unsigned lcore;
+	uint32_t i;
+
+	if (!mirror_on)
+		return;
+
+	RTE_LCORE_FOREACH(lcore) {
+		queued += mirror_lcore[lcore].queued;
+		full += mirror_lcore[lcore].full;
+		nombuf += mirror_lcore[lcore].nombuf;
+	}
+
+	printf("Mirror: port %u sample %u snaplen %u\n", mirror_port,
+			mirror_sample, mirror_snaplen);
+	rte_spinlock_lock(&mirror_sel_lock);
+	for (i = 0; i < mirror_sel_n; i++)
+		printf(" teid %-10u ue ip " IPV4_ADDR "\n", mirror_sel[i].teid,
+				IPV4_ADDR_HOST_FORMAT(mirror_sel[i].ue_ip));
+	rte_spinlock_unlock(&mirror_sel_lock);
+	printf("%-16s %-16s %-16s %-16s %-16s\n", "queued", "ring full",
+			"no mbuf", "sent", "tx drop");
+	printf("%-16"PRIu64" %-16"PRIu64" %-16"PRIu64" %-16"PRIu64
+			" %-16"PRIu64"\n", queued, full, nombuf, mirror_tx,
+			mirror_tx_drop);
+}
+
+void
+mirror_core(__rte_unused void *args)
+{
+	struct rte_mbuf *m[MIRROR_BURST];
+	unsigned n, sent;
+
+	if (!mirror_on)
+		return;
+
+	n = rte_ring_sc_dequeue_burst(mirror_ring, (void **)m, MIRROR_BURST);
+	if (n == 0)
+		return;
+
+	sent = rte_eth_tx_burst(mirror_port, epc_app.mirror_queue, m, n);
+	mirror_tx += sent;
+	if (unlikely(sent < n)) {
+		/* the monitoring port is best effort */
+		mirror_tx_drop += n - sent;
+		while (sent < n)
+			rte_pktmbuf_free(m[sent++]);
+	}
+}
+#endif /* PKT_MIRROR */
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PKT_MIRROR_H_
+#define _PKT_MIRROR_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the per subscriber traffic mirror.
+ *
+ * Bearers are selected for mirroring by the CP, for the IMSIs it was
+ * started with, and from the CLI by teid or UE ip. A selected bearer has
+ * its mirror flag set, the only field the workers test for the pkts of
+ * other bearers. Workers sample the egress pkts of selected bearers and
+ * queue indirect clones, cut to the snap length, to the mirror ring. The
+ * mct core sends them on a tx queue of --mirror_port used for nothing
+ * else. Pkts are sent with their egress ether header.
+ */
+#ifdef PKT_MIRROR
+#include <stdint.h>
+#include <rte_mbuf.h>
+#include <rte_lcore.h>
+
+#include "main.h"
+
+/** Pkts queued to the mct core, power of 2 */
+#define MIRROR_RING_SIZE	(1 << 12)
+/** Clones of the pkts queued or being sent */
+#define MIRROR_NUM_MBUFS	(MIRROR_RING_SIZE * 2 - 1)
+/** Pkts sent by the mct core per call */
+#define MIRROR_BURST		32
+/** Teid and UE ip selectors set from the CLI */
+#define MIRROR_SELECT_MAX	16
+/** Sessions the iface core checks per call after a selector change */
+#define MIRROR_SELECT_BUDGET	256
+/** --mirror_port unset */
+#define MIRROR_PORT_NONE	UINT8_MAX
+
+/**
+ * Bearer selector. Zero fields match all bearers.
+ */
+struct mirror_select {
+	uint32_t teid;		/** S1U sgw or eNB teid */
+	uint32_t ue_ip;		/** UE ip, host order */
+};
+
+/**
+ * Mirror counters of a worker lcore.
+ */
+struct mirror_lcore {
+	uint32_t seq;		/** pkts of selected bearers, for sampling */
+	uint64_t queued;	/** pkts queued to the mct core */
+	uint64_t full;		/** pkts not mirrored, ring full */
+	uint64_t nombuf;	/** pkts not mirrored, no clone mbuf */
+} __rte_cache_aligned;
+
+/** Set once the mirror port and ring are set up */
+extern volatile uint32_t mirror_on;
+/** Monitoring port, MIRROR_PORT_NONE if none */
+extern uint8_t mirror_port;
+
+/**
+ * Parse --mirror_port.
+ *
+ * @param arg
+ *	port id of the monitoring port.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on parse error
+ */
+int
+mirror_parse(const char *arg);
+
+/**
+ * Queue clones of the sampled pkts of pkts_mask to the mct core. Use
+ * mirror_pkts().
+ *
+ * @param pkts
+ *	pkts, with ether header at offset 0.
+ * @param n
+ *	number of pkts.
+ * @param mirror_mask
+ *	pkts of selected bearers.
+ *
+ * @return
+ *	None
+ */
+void
+mirror_burst(struct rte_mbuf **pkts, uint32_t n, uint64_t mirror_mask);
+
+/**
+ * Mirror the egress pkts of the selected bearers.
+ *
+ * @param pkts
+ *	pkts, with ether header at offset 0.
+ * @param n
+ *	number of pkts.
+ * @param pkts_mask
+ *	pkts to be sent.
+ * @param sdf_info
+ *	bearer info of the pkts.
+ *
+ * @return
+ *	None
+ */
+static inline void
+mirror_pkts(struct rte_mbuf **pkts, uint32_t n, uint64_t pkts_mask,
+		struct dp_sdf_per_bearer_info **sdf_info)
+{
+	uint64_t mirror_mask = 0;
+	uint32_t i;
+
+	if (likely(!mirror_on))
+		return;
+
+	for (i = 0; i < n; i++) {
+		/* line 2 of the bearer is read by the stages before */
+		if (ISSET_BIT(pkts_mask, i) &&
+				unlikely(sdf_info[i]->bear_sess_info->mirror))
+			SET_BIT(mirror_mask, i);
+	}
+	if (unlikely(mirror_mask))
+		mirror_burst(pkts, n, mirror_mask);
+}
+
+/**
+ * Create the mirror ring and clone pool. Called after the ports are set
+ * up with the mirror tx queue.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void mirror_init(void);
+
+/**
+ * Set the mirror flag of bearer from the CP selection and the CLI
+ * selectors. Called by the iface core on session create and modify.
+ *
+ * @param data
+ *	dp bearer session.
+ *
+ * @return
+ *	None
+ */
+void mirror_sess_update(struct dp_session_info *data);
+
+/**
+ * Add or delete a bearer selector. Bearers are updated by the iface core
+ * in the next calls of mirror_select_poll(). Called from the CLI.
+ *
+ * @param teid
+ *	S1U sgw or eNB teid, 0 for any.
+ * @param ue_ip
+ *	UE ip, host order, 0 for any.
+ * @param add
+ *	1 to add, 0 to delete.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the selectors are full or the selector is not found
+ */
+int mirror_select_set(uint32_t teid, uint32_t ue_ip, int add);
+
+/**
+ * Set sampling and snap length of the mirrored pkts. Called from the
+ * CLI.
+ *
+ * @param sample
+ *	mirror 1-in-sample pkts of the selected bearers, 0 or 1 for all.
+ * @param snaplen
+ *	max bytes of a mirrored pkt, 0 for all.
+ *
+ * @return
+ *	None
+ */
+void mirror_set_sample(uint32_t sample, uint32_t snaplen);
+
+/**
+ * Update the mirror flag of up to budget sessions after a selector
+ * change. Called by the iface core.
+ *
+ * @param budget
+ *	sessions to check.
+ *
+ * @return
+ *	None
+ */
+void mirror_select_poll(unsigned budget);
+
+/**
+ * Print mirror selectors and counters.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_mirror_stats(void);
+
+/**
+ * mct core service. Sends the queued clones on the mirror tx queue.
+ *
+ * @param args
+ *	unused.
+ *
+ * @return
+ *	None
+ */
+void mirror_core(__rte_unused void *args);
+
+#endif /* PKT_MIRROR */
+#endif /* _PKT_MIRROR_H_ */
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <rte_malloc.h>
+#include <rte_mempool.h>
+#include <rte_spinlock.h>
+
+#include "qsbr.h"
+
+struct dp_qsbr_lcore dp_qsbr[RTE_MAX_LCORE];
+
+/**
+ * Entries unlinked by the iface core. Entries in waiting are freed
+ * once the grace period started with them is over, entries in pending
+ * wait for the next grace period.
+ */
+struct dp_qsbr_queue {
+	struct {
+		void *ptr;
+		struct rte_mempool *mp;	/** NULL for rte_malloc'ed entries */
+		void (*fn)(void *);	/** release function, NULL if none */
+	} e[DP_QSBR_QUEUE_SZ];
+	uint32_t n;
+};
+
+static struct dp_qsbr_queue qsbr_q[2];
+static struct dp_qsbr_queue *pending = &qsbr_q[0];
+static struct dp_qsbr_queue *waiting = &qsbr_q[1];
+/** Grace period of the waiting entries */
+static struct dp_qsbr_token qsbr_token;
+/** CP messages may be handled from both socket and zmq threads */
+static rte_spinlock_t qsbr_lock = RTE_SPINLOCK_INITIALIZER;
+/** Grace periods elapsed and the one in progress, see dp_qsbr_epoch() */
+static uint32_t qsbr_epoch;
+static struct dp_qsbr_token qsbr_epoch_token;
+
+void dp_qsbr_register(unsigned lcore)
+{
+	dp_qsbr[lcore].reader = 1;
+}
+
+void dp_qsbr_start(struct dp_qsbr_token *t)
+{
+	unsigned lcore;
+
+	/* objects are unlinked before the snapshot is taken */
+	rte_smp_mb();
+	RTE_LCORE_FOREACH(lcore) {
+		if (dp_qsbr[lcore].reader)
+			t->snap[lcore] = dp_qsbr[lcore].cnt;
+	}
+}
+
+int dp_qsbr_elapsed(const struct dp_qsbr_token *t)
+{
+	unsigned lcore;
+
+	RTE_LCORE_FOREACH(lcore) {
+		if (dp_qsbr[lcore].reader &&
+				dp_qsbr[lcore].cnt == t->snap[lcore])
+			return 0;
+	}
+	rte_smp_rmb();
+	return 1;
+}
+
+uint32_t dp_qsbr_epoch(void)
+{
+	uint32_t epoch;
+
+	rte_spinlock_lock(&qsbr_lock);
+	if (dp_qsbr_elapsed(&qsbr_epoch_token)) {
+		qsbr_epoch++;
+		dp_qsbr_start(&qsbr_epoch_token);
+	}
+	epoch = qsbr_epoch;
+	rte_spinlock_unlock(&qsbr_lock);
+	return epoch;
+}
+
+static void qsbr_reclaim_locked(void)
+{
+	struct dp_qsbr_queue *q;
+	uint32_t i;
+
+	if (waiting->n) {
+		if (!dp_qsbr_elapsed(&qsbr_token))
+			return;
+		for (i = 0; i < waiting->n; i++) {
+			if (waiting->e[i].fn != NULL)
+				waiting->e[i].fn(waiting->e[i].ptr);
+			else if (waiting->e[i].mp != NULL)
+				rte_mempool_put(waiting->e[i].mp,
+						waiting->e[i].ptr);
+			else
+				rte_free(waiting->e[i].ptr);
+		}
+		waiting->n = 0;
+	}
+
+	if (pending->n) {
+		q = waiting;
+		waiting = pending;
+		pending = q;
+		dp_qsbr_start(&qsbr_token);
+	}
+}
+
+void dp_qsbr_reclaim(void)
+{
+	rte_spinlock_lock(&qsbr_lock);
+	qsbr_reclaim_locked();
+	rte_spinlock_unlock(&qsbr_lock);
+}
+
+static void qsbr_defer(void *ptr, struct rte_mempool *mp,
+		void (*fn)(void *))
+{
+	if (ptr == NULL)
+		return;
+
+	rte_spinlock_lock(&qsbr_lock);
+	qsbr_reclaim_locked();
+	/* Queue full: wait for readers rather than free under them */
+	while (pending->n == DP_QSBR_QUEUE_SZ) {
+		rte_pause();
+		qsbr_reclaim_locked();
+	}
+	pending->e[pending->n].ptr = ptr;
+	pending->e[pending->n].fn = fn;
+	pending->e[pending->n++].mp = mp;
+	rte_spinlock_unlock(&qsbr_lock);
+}
+
+void dp_defer_free(void *ptr)
+{
+	qsbr_defer(ptr, NULL, NULL);
+}
+
+void dp_defer_mempool_put(struct rte_mempool *mp, void *obj)
+{
+	qsbr_defer(obj, mp, NULL);
+}
+
+void dp_defer_call(void (*fn)(void *), void *obj)
+{
+	qsbr_defer(obj, NULL, fn);
+}
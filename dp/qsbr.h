@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QSBR_H_
+#define _QSBR_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the quiescent state based reclamation (QSBR) used to
+ * release table entries that worker cores may still be reading.
+ *
+ * Reader lcores report a quiescent state once per epc_run_pipeline()
+ * iteration, at which point they hold no table entry pointer. An entry
+ * unlinked from its hash table is queued with dp_defer_free() and only
+ * handed to rte_free() once every reader lcore has gone through a
+ * quiescent state since the entry was unlinked.
+ */
+#include <stdint.h>
+#include <rte_lcore.h>
+#include <rte_atomic.h>
+
+struct rte_mempool;
+
+/** Max number of entries waiting for a grace period */
+#define DP_QSBR_QUEUE_SZ	(1 << 14)
+
+/**
+ * Per lcore quiescent state counter.
+ */
+struct dp_qsbr_lcore {
+	volatile uint64_t cnt;	/** quiescent states reported */
+	uint8_t reader;		/** lcore reads DP tables */
+} __rte_cache_aligned;
+
+extern struct dp_qsbr_lcore dp_qsbr[RTE_MAX_LCORE];
+
+/**
+ * Grace period: reader counters at its start.
+ */
+struct dp_qsbr_token {
+	uint64_t snap[RTE_MAX_LCORE];
+};
+
+/**
+ * Register calling lcore as a reader of DP tables.
+ *
+ * @param lcore
+ *	lcore id.
+ *
+ * @return
+ *	None
+ */
+void dp_qsbr_register(unsigned lcore);
+
+/**
+ * Report quiescent state of calling lcore. Must only be called when
+ * the lcore holds no pointer to any DP table entry.
+ *
+ * @param lcore
+ *	lcore id.
+ *
+ * @return
+ *	None
+ */
+static inline void dp_qsbr_quiescent(unsigned lcore)
+{
+	/* table reads of this iteration complete before the update */
+	rte_compiler_barrier();
+	dp_qsbr[lcore].cnt++;
+}
+
+/**
+ * Start a grace period. Objects unlinked from the readers before this
+ * call are unused once dp_qsbr_elapsed() returns 1 for the token.
+ *
+ * @param t
+ *	grace period token.
+ *
+ * @return
+ *	None
+ */
+void dp_qsbr_start(struct dp_qsbr_token *t);
+
+/**
+ * Check a grace period. Non blocking.
+ *
+ * @param t
+ *	token set by dp_qsbr_start().
+ *
+ * @return
+ *	1 if every reader went quiescent since dp_qsbr_start(), 0 otherwise.
+ */
+int dp_qsbr_elapsed(const struct dp_qsbr_token *t);
+
+/**
+ * Grace period count, for objects reused in place rather than freed.
+ * Objects unlinked from the readers before a call returning e are unused
+ * once a later call returns e + 2 or more. Non blocking.
+ *
+ * @return
+ *	grace periods elapsed so far, wraps around.
+ */
+uint32_t dp_qsbr_epoch(void);
+
+/**
+ * Queue entry for rte_free() after a grace period. The entry must
+ * already be unlinked from every table the readers look up.
+ *
+ * @param ptr
+ *	rte_malloc'ed entry.
+ *
+ * @return
+ *	None
+ */
+void dp_defer_free(void *ptr);
+
+/**
+ * Queue entry for rte_mempool_put() after a grace period. The entry must
+ * already be unlinked from every table the readers look up.
+ *
+ * @param mp
+ *	mempool the entry was taken from.
+ * @param obj
+ *	entry.
+ *
+ * @return
+ *	None
+ */
+void dp_defer_mempool_put(struct rte_mempool *mp, void *obj);
+
+/**
+ * Queue entry for fn(obj) after a grace period, for entries holding
+ * resources of their own. The entry must already be unlinked from every
+ * table the readers look up.
+ * @param fn
+ *	release function, called by the lcore reclaiming the entry.
+ * @param obj
+ *	entry.
+ * @return
+ *	None
+ */
+void dp_defer_call(void (*fn)(void *), void *obj);
+
+/**
+ * Free entries whose grace period has elapsed and start a new grace
+ * period for the pending ones. Non blocking.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void dp_qsbr_reclaim(void);
+
+#endif /* _QSBR_H_ */
@@ -23,7 +23,7 @@ COREMASK="0xfe"
 
 if [ "${SPGW_CFG}" == "01" ]; then
 
-	ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,0	\
+	ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,${MEMORY_SOCKET1:-0}	\
 				--file-prefix dp	\
 				-w $S1U_PORT -w $S5S8_SGWU_PORT --	\
 				--s1u_ip $S1U_IP	\
@@ -37,7 +37,7 @@ if [ "${SPGW_CFG}" == "01" ]; then
 
 elif [ "${SPGW_CFG}" == "02" ]; then
 
-	ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,0 	\
+	ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,${MEMORY_SOCKET1:-0} 	\
 				--file-prefix dp	\
 				-w $S5S8_PGWU_PORT -w $SGI_PORT	--	\
 				--s5s8_pgwu_ip $S5S8_PGWU_IP	\
@@ -51,7 +51,7 @@ elif [ "${SPGW_CFG}" == "02" ]; then
 
 elif [ "${SPGW_CFG}" == "03" ]; then
 
-	ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,0 	\
+	ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,${MEMORY_SOCKET1:-0} 	\
 				--file-prefix dp	\
 				-w $S1U_PORT -w $SGI_PORT --	\
 				--s1u_ip $S1U_IP	\
@@ -79,6 +79,25 @@ if [ -n "${SGI_GW_IP}" ]; then
 	fi
 fi
 
+if [ -n "${NUM_QUEUES}" ]; then
+	ARGS="$ARGS --num_queues $NUM_QUEUES"
+fi
+
+if [ -n "${NUM_SPNS_DNS}" ]; then
+	ARGS="$ARGS --num_spns_dns $NUM_SPNS_DNS"
+fi
+
+if [ -n "${STAGES}" ]; then
+	ARGS="$ARGS --stages $STAGES"
+fi
+
+if [ -n "${UE_IP_POOL}" ]; then
+	ARGS="$ARGS --ue_ip_pool $UE_IP_POOL"
+	if [ -n "${UE_IP_POOL_MASK}" ]; then
+		ARGS="$ARGS --ue_ip_pool_mask $UE_IP_POOL_MASK"
+	fi
+fi
+
 if [ -n "${CDR_PATH}" ]; then
 	ARGS="$ARGS --cdr_path $CDR_PATH"
 fi
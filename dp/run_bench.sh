@@ -0,0 +1,52 @@
+#! /bin/bash
+# Copyright (c) 2017 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Runs the DP capacity benchmark on ring ports, no NIC needed. Build the
+# DP with SIMU_CP and DP_BENCH, see ../config/bench.cfg.
+
+source ../config/dp_config.cfg
+
+APP_PATH="./build"
+APP="ngic_dataplane"
+LOG_LEVEL=1
+COREMASK=${BENCH_COREMASK:-"0x1fe"}
+BENCH_CFG=${BENCH_CFG:-"../config/bench.cfg"}
+
+mkdir -p logs
+
+ARGS="-c $COREMASK -n 4 --socket-mem $MEMORY,0	\
+			--file-prefix dp_bench	\
+			--no-pci --	\
+			--s1u_ip $S1U_IP	\
+			--s1u_mac $S1U_MAC	\
+			--sgi_ip $SGI_IP	\
+			--sgi_mac $SGI_MAC	\
+			--num_workers $NUM_WORKER	\
+			--log $LOG_LEVEL	\
+			--numa $NUMA	\
+			--spgw_cfg 03	\
+			--bench $BENCH_CFG"
+
+if [ -n "${NUM_QUEUES}" ]; then
+	ARGS="$ARGS --num_queues $NUM_QUEUES"
+fi
+
+if [ -n "${STAGES}" ]; then
+	ARGS="$ARGS --stages $STAGES"
+fi
+
+echo $ARGS | sed -e $'s/--/\\\n\\t--/g'
+
+$APP_PATH/$APP $ARGS
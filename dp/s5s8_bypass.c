@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef S5S8_BYPASS
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_branch_prediction.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+
+#include "main.h"
+#include "s5s8_bypass.h"
+
+/**
+ * Slot of a bypass ring.
+ */
+struct s5s8_bypass_slot {
+	uint32_t len;
+	/** reservation + 1 of the pkt copied in the slot */
+	volatile uint32_t seq;
+	uint8_t data[S5S8_BYPASS_DATA_LEN];
+};
+
+/**
+ * Ring of one direction. Workers of the sending instance are the
+ * producers, the rx core of the receiving instance is the consumer.
+ * Producers reserve slots on prod_head, copy the pkt, then publish their
+ * slot on its seq. No producer waits for another one, the consumer reads
+ * the slots in reservation order.
+ */
+struct s5s8_bypass_ring {
+	volatile uint32_t prod_head;
+	volatile uint32_t cons_tail __rte_cache_aligned;
+	struct s5s8_bypass_slot slot[S5S8_BYPASS_RING_SIZE] __rte_cache_aligned;
+};
+
+enum s5s8_bypass_dir {
+	S5S8_BYPASS_UL,		/* SGWU to PGWU */
+	S5S8_BYPASS_DL,		/* PGWU to SGWU */
+	S5S8_BYPASS_DIR_MAX
+};
+
+/**
+ * Shared memory region, zero filled on creation.
+ */
+struct s5s8_bypass_shm {
+	/** S5/S8 ip of the instance reading the ring of each direction,
+	 * 0 until it is up, packet byte order */
+	volatile uint32_t ip[S5S8_BYPASS_DIR_MAX] __rte_cache_aligned;
+	struct s5s8_bypass_ring ring[S5S8_BYPASS_DIR_MAX];
+};
+
+/**
+ * Rx ring reader, the rte_port_in of the rx pipeline.
+ */
+struct s5s8_bypass_reader {
+	struct s5s8_bypass_ring *ring;
+	struct rte_mempool *pool;
+	/** empty polls with a reserved slot at cons_tail */
+	uint32_t stall;
+	uint8_t port_id;
+};
+
+struct s5s8_bypass_stats s5s8_bypass_stats[RTE_MAX_LCORE];
+uint32_t s5s8_bypass_port = UINT32_MAX;
+
+static char s5s8_bypass_name[S5S8_BYPASS_NAME_LEN];
+static struct s5s8_bypass_ring *bypass_tx;
+static struct s5s8_bypass_ring *bypass_rx;
+/** S5/S8 ip of the co-located peer, written by the peer */
+static volatile uint32_t *bypass_peer_ip;
+static struct rte_mempool *bypass_pool;
+
+int
+s5s8_bypass_parse(const char *arg)
+{
+	int len;
+
+	/* shm_open() names start with a slash */
+	len = snprintf(s5s8_bypass_name, sizeof(s5s8_bypass_name), "%s%s",
+			(arg[0] == '/') ? "" : "/", arg);
+	if (len <= 1 || len >= (int)sizeof(s5s8_bypass_name)
+			|| strchr(s5s8_bypass_name + 1, '/')) {
+		printf("Invalid s5s8_bypass region name %s\n", arg);
+		s5s8_bypass_name[0] = '\0';
+		return -1;
+	}
+	printf("Parsed s5s8_bypass:\t%s\n", s5s8_bypass_name);
+	return 0;
+}
+
+void
+s5s8_bypass_init(void)
+{
+	struct s5s8_bypass_shm *shm;
+	int fd;
+
+	if (s5s8_bypass_name[0] == '\0')
+		return;
+
+	if (app.spgw_cfg != SGWU && app.spgw_cfg != PGWU) {
+		RTE_LOG(WARNING, DP, "S5/S8 bypass needs SGWU or PGWU, "
+				"ignoring %s\n", s5s8_bypass_name);
+		return;
+	}
+
+	fd = shm_open(s5s8_bypass_name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		rte_exit(EXIT_FAILURE, "Cannot open S5/S8 bypass %s\n",
+				s5s8_bypass_name);
+
+	/* the instance started first sizes the region, the size of a
+	 * region already sized is left as is */
+	if (ftruncate(fd, sizeof(*shm)) < 0)
+		rte_exit(EXIT_FAILURE, "Cannot size S5/S8 bypass %s\n",
+				s5s8_bypass_name);
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED)
+		rte_exit(EXIT_FAILURE, "Cannot map S5/S8 bypass %s\n",
+				s5s8_bypass_name);
+
+	bypass_pool = rte_pktmbuf_pool_create("S5S8_BYPASS_POOL",
+			S5S8_BYPASS_NUM_MBUFS, 250, 0,
+			RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (bypass_pool == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot create S5/S8 bypass mempool\n");
+
+	if (app.spgw_cfg == SGWU) {
+		bypass_tx = &shm->ring[S5S8_BYPASS_UL];
+		bypass_rx = &shm->ring[S5S8_BYPASS_DL];
+		bypass_peer_ip = &shm->ip[S5S8_BYPASS_UL];
+		shm->ip[S5S8_BYPASS_DL] = app.s5s8_sgwu_ip;
+		s5s8_bypass_port = app.s5s8_sgwu_port;
+	} else {
+		bypass_tx = &shm->ring[S5S8_BYPASS_DL];
+		bypass_rx = &shm->ring[S5S8_BYPASS_UL];
+		bypass_peer_ip = &shm->ip[S5S8_BYPASS_DL];
+		shm->ip[S5S8_BYPASS_UL] = app.s5s8_pgwu_ip;
+		s5s8_bypass_port = app.s5s8_pgwu_port;
+	}
+
+	RTE_LOG(INFO, DP, "S5/S8 port %u bypassed by %s\n",
+			s5s8_bypass_port, s5s8_bypass_name);
+}
+
+/**
+ * Copy a pkt to the tx ring.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the ring is full or the pkt does not fit a slot
+ */
+static inline int
+s5s8_bypass_put(struct s5s8_bypass_ring *r, struct rte_mbuf *m)
+{
+	struct s5s8_bypass_slot *slot;
+	struct rte_mbuf *seg;
+	uint32_t head, off, len = rte_pktmbuf_pkt_len(m);
+
+	if (unlikely(len > S5S8_BYPASS_DATA_LEN))
+		return -1;
+
+	do {
+		head = r->prod_head;
+		if (unlikely(head - r->cons_tail >= S5S8_BYPASS_RING_SIZE))
+			return -1;
+	} while (unlikely(!rte_atomic32_cmpset(&r->prod_head, head, head + 1)));
+
+	slot = &r->slot[head & (S5S8_BYPASS_RING_SIZE - 1)];
+	slot->len = len;
+	/* reassembled pkts are chained */
+	for (seg = m, off = 0; seg != NULL; seg = seg->next) {
+		rte_memcpy(slot->data + off, rte_pktmbuf_mtod(seg, void *),
+				rte_pktmbuf_data_len(seg));
+		off += rte_pktmbuf_data_len(seg);
+	}
+	/* slot contents before its seq */
+	rte_smp_wmb();
+	slot->seq = head + 1;
+	return 0;
+}
+
+void
+s5s8_bypass_tx(struct rte_mbuf **pkts, uint32_t n, uint64_t *pkts_mask)
+{
+	struct s5s8_bypass_stats *st = &s5s8_bypass_stats[rte_lcore_id()];
+	uint32_t peer_ip = *bypass_peer_ip;
+	struct ether_hdr *eth;
+	struct ipv4_hdr *ip;
+	uint32_t i;
+
+	/* co-located peer not up yet */
+	if (peer_ip == 0)
+		return;
+
+	for (i = 0; i < n; i++) {
+		if (!ISSET_BIT(*pkts_mask, i))
+			continue;
+
+		/* other peers are served by the NIC port */
+		ip = rte_pktmbuf_mtod_offset(pkts[i], struct ipv4_hdr *,
+				ETHER_HDR_LEN);
+		if (ip->dst_addr != peer_ip)
+			continue;
+
+		/* no next hop to resolve, rx only checks the ether type */
+		eth = rte_pktmbuf_mtod(pkts[i], struct ether_hdr *);
+		eth->ether_type = htons(ETHER_TYPE_IPv4);
+
+		if (s5s8_bypass_put(bypass_tx, pkts[i]) == 0)
+			st->tx++;
+		else
+			st->tx_drop++;
+		RESET_BIT(*pkts_mask, i);
+	}
+}
+
+static void *
+s5s8_bypass_reader_create(void *params, int socket_id)
+{
+	struct s5s8_bypass_reader *port;
+
+	RTE_SET_USED(params);
+	if (bypass_rx == NULL)
+		return NULL;
+
+	port = rte_zmalloc_socket("s5s8_bypass_reader", sizeof(*port),
+			RTE_CACHE_LINE_SIZE, socket_id);
+	if (port == NULL)
+		return NULL;
+
+	port->ring = bypass_rx;
+	port->pool = bypass_pool;
+	port->port_id = s5s8_bypass_port;
+	return port;
+}
+
+static int
+s5s8_bypass_reader_free(void *port)
+{
+	rte_free(port);
+	return 0;
+}
+
+static int
+s5s8_bypass_reader_rx(void *port, struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct s5s8_bypass_reader *p = port;
+	struct s5s8_bypass_ring *r = p->ring;
+	struct s5s8_bypass_slot *slot;
+	uint32_t tail = r->cons_tail;
+	uint32_t i, n;
+
+	/* published slots in reservation order */
+	for (n = 0; n < n_pkts; n++) {
+		slot = &r->slot[(tail + n) & (S5S8_BYPASS_RING_SIZE - 1)];
+		if (slot->seq != tail + n + 1)
+			break;
+	}
+	if (n == 0) {
+		if (r->prod_head == tail) {
+			p->stall = 0;
+			return 0;
+		}
+		/* producer died between reservation and publish */
+		if (unlikely(++p->stall >= S5S8_BYPASS_STALL_POLLS)) {
+			p->stall = 0;
+			r->cons_tail = tail + 1;
+			s5s8_bypass_stats[rte_lcore_id()].rx_stall++;
+		}
+		return 0;
+	}
+	p->stall = 0;
+	/* slot contents after their seq */
+	rte_smp_rmb();
+
+	if (unlikely(rte_pktmbuf_alloc_bulk(p->pool, pkts, n) != 0)) {
+		s5s8_bypass_stats[rte_lcore_id()].rx_nombuf++;
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		slot = &r->slot[(tail + i) & (S5S8_BYPASS_RING_SIZE - 1)];
+		rte_memcpy(rte_pktmbuf_append(pkts[i], slot->len),
+				slot->data, slot->len);
+		pkts[i]->port = p->port_id;
+	}
+
+	/* slots are copied before the producers reuse them */
+	rte_mb();
+	r->cons_tail = tail + n;
+	s5s8_bypass_stats[rte_lcore_id()].rx += n;
+	return n;
+}
+
+struct rte_port_in_ops s5s8_bypass_reader_ops = {
+	.f_create = s5s8_bypass_reader_create,
+	.f_free = s5s8_bypass_reader_free,
+	.f_rx = s5s8_bypass_reader_rx,
+	.f_stats = NULL,
+};
+#endif	/* S5S8_BYPASS */
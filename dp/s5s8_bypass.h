@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _S5S8_BYPASS_H_
+#define _S5S8_BYPASS_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the S5/S8 bypass of co-located SGWU and PGWU instances.
+ *
+ * With S5S8_BYPASS an SGWU and a PGWU DP running on the same host hand
+ * their S5/S8 pkts to each other through a shared memory region instead
+ * of the S5/S8 NIC port. The region holds one ring per direction, the
+ * workers copy the GTPU pkts that would be sent on the S5/S8 port into
+ * the slots of their tx ring, and an rx pipeline input port of the S5/S8
+ * port reads the rx ring into mbufs. The pkts then take the path of the
+ * pkts received on the NIC. Each instance publishes its S5/S8 ip in the
+ * region, only the pkts sent to that ip are bypassed: the NIC port keeps
+ * working for the peers that are not co-located.
+ */
+#ifdef S5S8_BYPASS
+#include <stdint.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_port.h>
+
+/** Slots of each direction, power of 2 */
+#define S5S8_BYPASS_RING_SIZE	1024
+/** Largest pkt carried by a slot */
+#define S5S8_BYPASS_DATA_LEN	2040
+/** mbufs of the pkts read from the rx ring */
+#define S5S8_BYPASS_NUM_MBUFS	8191
+/** Length of the region name */
+#define S5S8_BYPASS_NAME_LEN	64
+/** Empty polls after which a reserved slot left unpublished by a dead
+ * producer is skipped */
+#define S5S8_BYPASS_STALL_POLLS	(1 << 20)
+
+/**
+ * S5/S8 bypass statistics.
+ */
+struct s5s8_bypass_stats {
+	uint64_t tx;		/**< pkts put on the tx ring */
+	uint64_t tx_drop;	/**< pkts dropped, tx ring full or pkt too long */
+	uint64_t rx;		/**< pkts read from the rx ring */
+	uint64_t rx_nombuf;	/**< rx ring reads deferred for lack of mbufs */
+	uint64_t rx_stall;	/**< unpublished slots skipped */
+};
+
+/** Statistics of each lcore */
+extern struct s5s8_bypass_stats s5s8_bypass_stats[RTE_MAX_LCORE];
+
+/** S5/S8 port bypassed by the shared rings, UINT32_MAX if none */
+extern uint32_t s5s8_bypass_port;
+
+/** rx pipeline input port reading the rx ring */
+extern struct rte_port_in_ops s5s8_bypass_reader_ops;
+
+/**
+ * Parse --s5s8_bypass.
+ *
+ * @param arg
+ *	name of the shared memory region, the same on both instances.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on parse error
+ */
+int
+s5s8_bypass_parse(const char *arg);
+
+/**
+ * Map the shared memory region and select the bypassed port. The first
+ * instance started creates the region. Called after the ports are up and
+ * before the pipelines are created.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+s5s8_bypass_init(void);
+
+/**
+ * Copy the pkts of pkts_mask sent to the co-located peer to the tx ring.
+ * The copied pkts and the dropped ones are cleared from pkts_mask and
+ * freed by the pipeline, the pkts to other peers are left in pkts_mask
+ * for the S5/S8 port.
+ *
+ * @param pkts
+ *	pkts to send on the S5/S8 port, GTPU encapsulated.
+ * @param n
+ *	number of pkts.
+ * @param pkts_mask
+ *	bit mask of the pkts to send.
+ *
+ * @return
+ *	None
+ */
+void
+s5s8_bypass_tx(struct rte_mbuf **pkts, uint32_t n, uint64_t *pkts_mask);
+#endif	/* S5S8_BYPASS */
+#endif	/* _S5S8_BYPASS_H_ */
@@ -0,0 +1,1021 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef WARM_RESTART
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+
+#include "main.h"
+#include "sess_store.h"
+
+static char store_path[PATH_MAX];
+static struct sess_store_hdr *store_hdr;
+static struct sess_store_sess *store_sess;
+static struct sess_store_rule *store_rule;
+
+/** Free session slots, 1 based */
+static uint32_t *store_free;
+static uint32_t store_nb_free;
+
+/** type and id of the used rule records to their index */
+static struct rte_hash *store_rule_hash;
+/** Free rule records */
+static uint32_t *store_rule_free;
+static uint32_t store_nb_rule_free;
+
+/** Set while the tables are re-created from the store */
+static int store_replay;
+/** Slot of the session being re-created */
+static uint32_t store_replay_slot;
+
+static struct dp_id store_dp_id = {.id = DPN_ID, .name = "sess_store"};
+
+#ifdef SESS_SNAPSHOT
+/** Suffixes of the snapshot files */
+#define SNAP_SUFFIX		".snap"
+#define SNAP_TMP_SUFFIX		".snap.tmp"
+#define JRNL_SUFFIX		".jrnl"
+#define JRNL_OLD_SUFFIX		".jrnl.old"
+#define SNAP_NAME_MAX		(PATH_MAX - sizeof(SNAP_TMP_SUFFIX))
+
+static char snap_base[SNAP_NAME_MAX];
+static char restore_base[SNAP_NAME_MAX];
+
+static FILE *journal;
+static char *journal_buf;
+static uint64_t journal_flush_tsc;
+static uint64_t snap_next_tsc;
+/** Set by the iface core, cleared by the snapshot thread when done */
+static volatile int snap_busy;
+#endif /* SESS_SNAPSHOT */
+
+/**
+ * CRC of a record, less its crc field.
+ */
+static inline uint32_t
+store_crc(const void *rec, size_t size)
+{
+	return rte_hash_crc((const uint8_t *)rec + sizeof(uint32_t),
+			size - sizeof(uint32_t), 0);
+}
+
+/**
+ * Key of the rule hashes.
+ */
+static inline uint64_t
+store_rule_key(uint8_t type, uint32_t id)
+{
+	return ((uint64_t)type << 32) | id;
+}
+
+int
+sess_store_parse(const char *path)
+{
+	if (strlen(path) >= sizeof(store_path)) {
+		printf("warm_restart file name too long\n");
+		return -1;
+	}
+	strcpy(store_path, path);
+	printf("Parsed warm_restart:\t%s\n", store_path);
+	return 0;
+}
+
+/**
+ * Check that the store was written by a DP of the same layout and
+ * config.
+ */
+static int
+store_hdr_valid(const struct sess_store_hdr *h)
+{
+	return !memcmp(h->magic, SESS_STORE_MAGIC, sizeof(SESS_STORE_MAGIC))
+		&& (h->version == SESS_STORE_VERSION)
+		&& (h->sess_size == sizeof(struct sess_store_sess))
+		&& (h->rule_size == sizeof(struct sess_store_rule))
+		&& (h->max_sess == SESS_STORE_ENTRIES)
+		&& (h->max_rules == SESS_STORE_RULES)
+		&& (h->spgw_cfg == app.spgw_cfg)
+		&& (h->s1u_ip == app.s1u_ip)
+		&& (h->sgi_ip == app.sgi_ip);
+}
+
+static void
+store_hdr_init(struct sess_store_hdr *h)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, SESS_STORE_MAGIC, sizeof(SESS_STORE_MAGIC));
+	h->version = SESS_STORE_VERSION;
+	h->sess_size = sizeof(struct sess_store_sess);
+	h->rule_size = sizeof(struct sess_store_rule);
+	h->max_sess = SESS_STORE_ENTRIES;
+	h->max_rules = SESS_STORE_RULES;
+	h->spgw_cfg = app.spgw_cfg;
+	h->s1u_ip = app.s1u_ip;
+	h->sgi_ip = app.sgi_ip;
+}
+
+/**
+ * Re-create a stored rule.
+ */
+static int
+store_rule_replay(struct sess_store_rule *r)
+{
+	switch (r->type) {
+	case SESS_STORE_MTR:
+		return dp_meter_profile_entry_add(store_dp_id, &r->u.mtr);
+	case SESS_STORE_ADC:
+		return dp_adc_entry_add(store_dp_id, &r->u.adc);
+	case SESS_STORE_PCC:
+		return dp_pcc_entry_add(store_dp_id, &r->u.pcc);
+	case SESS_STORE_SDF:
+		return dp_sdf_filter_entry_add(store_dp_id, &r->u.sdf);
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Re-create a stored session in its stored state.
+ */
+static int
+store_sess_replay(const struct sess_store_sess *s)
+{
+	struct session_info si = s->si;
+	struct dp_session_info *data;
+
+	if (dp_session_create(store_dp_id, &si) < 0)
+		return -1;
+	/* look up only */
+	data = get_session_data(si.sess_id, 1);
+	if (data == NULL)
+		return -1;
+
+	/* The create built the DL encap of a known eNB tunnel. No DL pkts
+	 * are buffered yet, so the stored state is set without the worker
+	 * notify of dp_session_modify(). */
+	if (s->state <= IN_PROGRESS)
+		data->sess_state = s->state;
+	/* a restore is kept in the store of this DP */
+	if (!store_replay)
+		sess_store_sess_modify(data->store_slot, &si,
+				data->sess_state);
+	return 0;
+}
+
+/**
+ * Re-create the rules, then the default bearers and then the dedicated
+ * bearers of the record arrays. Records that fail their CRC or cannot
+ * be re-created are cleared.
+ *
+ * @param warm
+ *	records are those of the store, sessions keep their slot.
+ */
+static void
+store_replay_all(struct sess_store_rule *rules, uint32_t nb_rules,
+		struct sess_store_sess *sess, uint32_t nb_sess, int warm,
+		const char *from)
+{
+	uint64_t t0 = rte_rdtsc();
+	uint32_t nr = 0, ns = 0, dropped = 0;
+	uint32_t i, type;
+	int pass;
+
+	store_replay = warm;
+	for (type = 0; type < SESS_STORE_NUM_TYPES; type++) {
+		for (i = 0; i < nb_rules; i++) {
+			struct sess_store_rule *r = &rules[i];
+
+			if (!r->used || (r->type != type))
+				continue;
+			if ((r->crc != store_crc(r, sizeof(*r)))
+					|| (store_rule_replay(r) < 0)) {
+				memset(r, 0, sizeof(*r));
+				dropped++;
+				continue;
+			}
+			nr++;
+		}
+	}
+
+	/* dedicated bearers need their default bearer */
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < nb_sess; i++) {
+			struct sess_store_sess *s = &sess[i];
+
+			if (!s->used || ((UE_BEAR_ID(s->si.sess_id) ==
+					DEFAULT_BEARER) != (pass == 0)))
+				continue;
+			store_replay_slot = i + 1;
+			if ((s->crc != store_crc(s, sizeof(*s)))
+					|| (store_sess_replay(s) < 0)) {
+				memset(s, 0, sizeof(*s));
+				dropped++;
+				continue;
+			}
+			ns++;
+		}
+	}
+	store_replay = 0;
+
+	RTE_LOG(NOTICE, DP, "Restored from %s: %u sessions, %u rules,"
+			" %u records dropped in %.1f sec\n", from, ns, nr,
+			dropped, (double)(rte_rdtsc() - t0) / rte_get_tsc_hz());
+}
+
+/**
+ * Map the store file, or anonymous memory if only the snapshots need
+ * the store, and restore a valid store file.
+ */
+static void
+store_map(void)
+{
+	size_t size = sizeof(struct sess_store_hdr) +
+		(size_t)SESS_STORE_ENTRIES * sizeof(struct sess_store_sess) +
+		(size_t)SESS_STORE_RULES * sizeof(struct sess_store_rule);
+	struct statfs fs;
+	struct stat st;
+	int valid = 0;
+	void *p;
+	int fd;
+
+	if (store_path[0] == '\0') {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			rte_exit(EXIT_FAILURE, "Cannot map session store\n");
+	} else {
+		fd = open(store_path, O_RDWR | O_CREAT, 0600);
+		if (fd < 0)
+			rte_exit(EXIT_FAILURE, "Cannot open session store"
+					" %s\n", store_path);
+		/* hugetlbfs files are sized in whole hugepages */
+		if (fstatfs(fd, &fs) == 0 && fs.f_bsize > 0)
+			size = RTE_ALIGN_CEIL(size, (size_t)fs.f_bsize);
+		if (fstat(fd, &st) < 0)
+			rte_exit(EXIT_FAILURE, "Cannot stat session store"
+					" %s\n", store_path);
+		valid = ((size_t)st.st_size == size);
+		if (!valid && ((ftruncate(fd, 0) < 0) ||
+					(ftruncate(fd, size) < 0)))
+			rte_exit(EXIT_FAILURE, "Cannot size session store %s"
+					" to %zu bytes\n", store_path, size);
+
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+				fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+			rte_exit(EXIT_FAILURE, "Cannot map session store"
+					" %s\n", store_path);
+	}
+	store_hdr = p;
+	store_sess = (struct sess_store_sess *)(store_hdr + 1);
+	store_rule = (struct sess_store_rule *)
+		(store_sess + SESS_STORE_ENTRIES);
+
+	valid = valid && store_hdr_valid(store_hdr);
+	if (valid) {
+		store_hdr->restarts++;
+		RTE_LOG(NOTICE, DP, "Warm restart %u\n", store_hdr->restarts);
+		store_replay_all(store_rule, SESS_STORE_RULES, store_sess,
+				SESS_STORE_ENTRIES, 1, store_path);
+		return;
+	}
+	if (store_path[0] != '\0') {
+		RTE_LOG(NOTICE, DP, "Session store %s not valid for this DP,"
+				" cleared\n", store_path);
+		memset(p, 0, size);
+	}
+	store_hdr_init(store_hdr);
+}
+
+#ifdef SESS_SNAPSHOT
+static int
+snap_name_set(char *dst, const char *base, const char *opt)
+{
+	if (strlen(base) >= SNAP_NAME_MAX) {
+		printf("%s file name too long\n", opt);
+		return -1;
+	}
+	strcpy(dst, base);
+	printf("Parsed %s:\t%s\n", opt, dst);
+	return 0;
+}
+
+int
+sess_snapshot_parse(const char *base)
+{
+	return snap_name_set(snap_base, base, "sess_snapshot");
+}
+
+int
+sess_restore_parse(const char *base)
+{
+	return snap_name_set(restore_base, base, "sess_restore");
+}
+
+static void
+snap_hdr_init(struct sess_snap_hdr *h)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, SESS_SNAP_MAGIC, sizeof(SESS_SNAP_MAGIC));
+	h->version = SESS_STORE_VERSION;
+	h->sess_size = sizeof(struct sess_store_sess);
+	h->rule_size = sizeof(struct sess_store_rule);
+}
+
+/**
+ * Open a snapshot or journal file for writing and write its header.
+ */
+static FILE *
+snap_file_open(const char *base, const char *suffix)
+{
+	char name[PATH_MAX];
+	struct sess_snap_hdr h;
+	FILE *f;
+
+	snprintf(name, sizeof(name), "%s%s", base, suffix);
+	f = fopen(name, "w");
+	if (f == NULL) {
+		RTE_LOG(ERR, DP, "Cannot open %s\n", name);
+		return NULL;
+	}
+	snap_hdr_init(&h);
+	if (fwrite(&h, sizeof(h), 1, f) != 1) {
+		RTE_LOG(ERR, DP, "Cannot write %s\n", name);
+		fclose(f);
+		return NULL;
+	}
+	return f;
+}
+
+static void
+journal_open(void)
+{
+	journal = snap_file_open(snap_base, JRNL_SUFFIX);
+	if (journal == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot create session journal\n");
+	setvbuf(journal, journal_buf, _IOFBF, SESS_JOURNAL_BUF);
+}
+
+static void
+journal_put(uint8_t op, uint8_t type, uint32_t id, uint64_t sess_id,
+		const void *rec, size_t size)
+{
+	struct sess_journal_rec j = {
+		.op = op, .type = type, .id = id, .sess_id = sess_id};
+
+	if (journal == NULL)
+		return;
+	if ((fwrite(&j, sizeof(j), 1, journal) != 1) ||
+			(size && (fwrite(rec, size, 1, journal) != 1)))
+		RTE_LOG(ERR, DP, "Session journal write failed\n");
+}
+
+/**
+ * Copy a store record being written by the iface core, retrying until
+ * the copy matches its CRC.
+ *
+ * @return
+ *	- 1 if the record is used
+ *	- 0 if not
+ *	- -1 if no copy matched its CRC, the record is corrupt
+ */
+static int
+snap_rec_copy(void *dst, const void *src, size_t size)
+{
+	const struct sess_store_sess *s = dst;
+	unsigned i;
+
+	for (i = 0; i < SESS_SNAP_COPY_RETRIES; i++) {
+		memcpy(dst, src, size);
+		if (!s->used)
+			return 0;
+		if (s->crc == store_crc(dst, size))
+			return 1;
+		rte_pause();
+	}
+	return -1;
+}
+
+/**
+ * Snapshot thread, writes the live store records to the .snap file.
+ */
+static void *
+snap_thread(__rte_unused void *arg)
+{
+	char tmp[PATH_MAX], name[PATH_MAX];
+	struct sess_journal_rec j = {0};
+	struct sess_store_rule r;
+	struct sess_store_sess s;
+	uint64_t t0 = rte_rdtsc();
+	uint32_t i, n = 0;
+	int err = 0, ret;
+	FILE *f;
+
+	f = snap_file_open(snap_base, SNAP_TMP_SUFFIX);
+	if (f == NULL) {
+		snap_busy = 0;
+		return NULL;
+	}
+
+	j.op = SESS_JRNL_RULE_PUT;
+	for (i = 0; i < SESS_STORE_RULES && !err; i++) {
+		ret = snap_rec_copy(&r, &store_rule[i], sizeof(r));
+		if (ret <= 0) {
+			err = ret;
+			continue;
+		}
+		j.type = r.type;
+		j.id = r.id;
+		err = (fwrite(&j, sizeof(j), 1, f) != 1) ||
+			(fwrite(&r, sizeof(r), 1, f) != 1);
+		n++;
+	}
+	j.op = SESS_JRNL_SESS_PUT;
+	j.type = 0;
+	j.id = 0;
+	for (i = 0; i < SESS_STORE_ENTRIES && !err; i++) {
+		ret = snap_rec_copy(&s, &store_sess[i], sizeof(s));
+		if (ret <= 0) {
+			err = ret;
+			continue;
+		}
+		j.sess_id = s.si.sess_id;
+		err = (fwrite(&j, sizeof(j), 1, f) != 1) ||
+			(fwrite(&s, sizeof(s), 1, f) != 1);
+		n++;
+	}
+	err = err || fflush(f) || fsync(fileno(f));
+	fclose(f);
+
+	snprintf(tmp, sizeof(tmp), "%s%s", snap_base, SNAP_TMP_SUFFIX);
+	snprintf(name, sizeof(name), "%s%s", snap_base, SNAP_SUFFIX);
+	if (err || rename(tmp, name) < 0) {
+		/* the old snapshot and both journals stay valid */
+		RTE_LOG(ERR, DP, "Session snapshot %s failed\n", name);
+		unlink(tmp);
+	} else {
+		/* all of .jrnl.old is older than the snapshot */
+		snprintf(name, sizeof(name), "%s%s", snap_base,
+				JRNL_OLD_SUFFIX);
+		unlink(name);
+		RTE_LOG(INFO, DP, "Session snapshot of %u records in %.1f"
+				" sec\n", n, (double)(rte_rdtsc() - t0) /
+				rte_get_tsc_hz());
+	}
+	rte_smp_wmb();
+	snap_busy = 0;
+	return NULL;
+}
+
+/**
+ * Start a snapshot. The journal is renamed to .jrnl.old unless the
+ * .jrnl.old of a failed snapshot is still there, in which case the
+ * journal keeps growing until a snapshot succeeds.
+ */
+static void
+snap_start(void)
+{
+	char name[PATH_MAX], old[PATH_MAX];
+	pthread_t t;
+
+	snprintf(name, sizeof(name), "%s%s", snap_base, JRNL_SUFFIX);
+	snprintf(old, sizeof(old), "%s%s", snap_base, JRNL_OLD_SUFFIX);
+	if (access(old, F_OK) < 0) {
+		fclose(journal);
+		if (rename(name, old) < 0)
+			RTE_LOG(ERR, DP, "Cannot rename %s\n", name);
+		journal_open();
+	} else {
+		fflush(journal);
+	}
+
+	snap_busy = 1;
+	if (pthread_create(&t, NULL, &snap_thread, NULL) != 0) {
+		RTE_LOG(ERR, DP, "Cannot create session snapshot thread\n");
+		snap_busy = 0;
+		return;
+	}
+	/* the iface lcore is where the thread was created */
+	epc_ctrl_thread_pin(t, "session snapshot");
+	pthread_detach(t);
+}
+
+void
+sess_store_poll(void)
+{
+	uint64_t now;
+
+	if (journal == NULL)
+		return;
+
+	now = rte_rdtsc();
+	if (now - journal_flush_tsc > rte_get_tsc_hz() / 1000 *
+			SESS_JOURNAL_FLUSH_MS) {
+		fflush(journal);
+		journal_flush_tsc = now;
+	}
+	if (!snap_busy && (now >= snap_next_tsc)) {
+		snap_start();
+		snap_next_tsc = now + rte_get_tsc_hz() * SESS_SNAP_SEC;
+	}
+}
+
+/**
+ * Start the journal. Files of an earlier run do not match the store,
+ * they are replaced by the first snapshot, taken at the first poll.
+ */
+static void
+snap_init(void)
+{
+	char name[PATH_MAX];
+
+	if (snap_base[0] == '\0')
+		return;
+
+	snprintf(name, sizeof(name), "%s%s", snap_base, SNAP_SUFFIX);
+	unlink(name);
+	snprintf(name, sizeof(name), "%s%s", snap_base, JRNL_OLD_SUFFIX);
+	unlink(name);
+
+	journal_buf = malloc(SESS_JOURNAL_BUF);
+	if (journal_buf == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot allocate session journal\n");
+	journal_open();
+	snap_next_tsc = rte_rdtsc();
+	journal_flush_tsc = snap_next_tsc;
+}
+
+/** Scratch tables of the restore */
+struct restore_ctx {
+	struct rte_hash *hash;		/** sess_id to index in sess */
+	struct sess_store_sess *sess;
+	uint32_t nb_sess;
+	uint32_t max_sess;
+	size_t sess_size;		/** bytes mapped for sess */
+	struct rte_hash *rule_hash;	/** type and id to index in rules */
+	struct sess_store_rule *rules;
+	uint32_t nb_rules;
+	uint32_t *rule_free;		/** indexes of deleted rules */
+	uint32_t nb_rule_free;
+	uint32_t bad;			/** records of bad files or CRC */
+};
+
+/**
+ * Find a rule of the restore.
+ *
+ * @param add
+ *	take a free rule if not found.
+ *
+ * @return
+ *	the rule, NULL if not found and not added
+ */
+static struct sess_store_rule *
+restore_rule_find(struct restore_ctx *c, uint8_t type, uint32_t id, int add)
+{
+	uint64_t key = store_rule_key(type, id);
+	uintptr_t idx;
+	void *data;
+
+	if (rte_hash_lookup_data(c->rule_hash, &key, &data) >= 0)
+		return &c->rules[(uintptr_t)data];
+	if (!add)
+		return NULL;
+
+	if (c->nb_rule_free)
+		idx = c->rule_free[--c->nb_rule_free];
+	else if (c->nb_rules < SESS_STORE_RULES)
+		idx = c->nb_rules++;
+	else
+		return NULL;
+	if (rte_hash_add_key_data(c->rule_hash, &key, (void *)idx) < 0) {
+		c->rule_free[c->nb_rule_free++] = idx;
+		return NULL;
+	}
+	return &c->rules[idx];
+}
+
+/**
+ * Delete a rule of the restore.
+ */
+static void
+restore_rule_del(struct restore_ctx *c, uint8_t type, uint32_t id)
+{
+	uint64_t key = store_rule_key(type, id);
+	void *data;
+
+	if (rte_hash_lookup_data(c->rule_hash, &key, &data) < 0)
+		return;
+	memset(&c->rules[(uintptr_t)data], 0, sizeof(struct sess_store_rule));
+	rte_hash_del_key(c->rule_hash, &key);
+	c->rule_free[c->nb_rule_free++] = (uintptr_t)data;
+}
+
+/**
+ * Apply the records of a snapshot or journal file to the scratch
+ * tables. A file of another layout is skipped, a truncated last record
+ * ends the file.
+ */
+static void
+restore_file(struct restore_ctx *c, const char *suffix)
+{
+	char name[PATH_MAX];
+	struct sess_snap_hdr h, ref;
+	struct sess_journal_rec j;
+	struct sess_store_sess s;
+	struct sess_store_rule r, *pr;
+	uint64_t sess_id;
+	uintptr_t idx;
+	uint32_t n = 0;
+	void *data;
+	FILE *f;
+
+	snprintf(name, sizeof(name), "%s%s", restore_base, suffix);
+	f = fopen(name, "r");
+	if (f == NULL)
+		return;
+	snap_hdr_init(&ref);
+	if ((fread(&h, sizeof(h), 1, f) != 1) || memcmp(&h, &ref, sizeof(h))) {
+		RTE_LOG(ERR, DP, "%s is not a session snapshot of this DP\n",
+				name);
+		fclose(f);
+		return;
+	}
+
+	while (fread(&j, sizeof(j), 1, f) == 1) {
+		n++;
+		switch (j.op) {
+		case SESS_JRNL_SESS_PUT:
+			if (fread(&s, sizeof(s), 1, f) != 1)
+				goto end;
+			if (s.crc != store_crc(&s, sizeof(s))) {
+				c->bad++;
+				break;
+			}
+			sess_id = s.si.sess_id;
+			if (rte_hash_lookup_data(c->hash, &sess_id, &data) < 0) {
+				if (c->nb_sess == c->max_sess)
+					goto end;
+				data = (void *)(uintptr_t)c->nb_sess++;
+				rte_hash_add_key_data(c->hash, &sess_id, data);
+			}
+			idx = (uintptr_t)data;
+			c->sess[idx] = s;
+			break;
+		case SESS_JRNL_SESS_DEL:
+			sess_id = j.sess_id;
+			if (rte_hash_lookup_data(c->hash, &sess_id, &data) < 0)
+				break;
+			idx = (uintptr_t)data;
+			c->sess[idx].used = 0;
+			rte_hash_del_key(c->hash, &sess_id);
+			break;
+		case SESS_JRNL_RULE_PUT:
+			if (fread(&r, sizeof(r), 1, f) != 1)
+				goto end;
+			if (r.crc != store_crc(&r, sizeof(r))) {
+				c->bad++;
+				break;
+			}
+			pr = restore_rule_find(c, r.type, r.id, 1);
+			if (pr != NULL)
+				*pr = r;
+			break;
+		case SESS_JRNL_RULE_DEL:
+			restore_rule_del(c, j.type, j.id);
+			break;
+		default:
+			RTE_LOG(ERR, DP, "%s: bad record %u\n", name, n);
+			goto end;
+		}
+	}
+end:
+	fclose(f);
+	RTE_LOG(INFO, DP, "Loaded %u records of %s\n", n, name);
+}
+
+/**
+ * Load the snapshot and journals of --sess_restore into scratch tables
+ * sized from the files.
+ *
+ * @return
+ *	- 1 if the files were loaded
+ *	- 0 if there is no restore
+ */
+static int
+restore_load(struct restore_ctx *c)
+{
+	static const char *const suffix[] = {
+		SNAP_SUFFIX, JRNL_OLD_SUFFIX, JRNL_SUFFIX};
+	struct rte_hash_parameters params = {
+		.name = "sess_restore",
+		.key_len = sizeof(uint64_t),
+		.hash_func = rte_hash_crc,
+		.socket_id = rte_socket_id(),
+	};
+	struct rte_hash_parameters rule_params = {
+		.name = "sess_restore_rule",
+		.entries = SESS_STORE_RULES,
+		.key_len = sizeof(uint64_t),
+		.hash_func = rte_hash_crc,
+		.socket_id = rte_socket_id(),
+	};
+	char name[PATH_MAX];
+	size_t total = 0;
+	struct stat st;
+	uint32_t i;
+
+	memset(c, 0, sizeof(*c));
+	if (restore_base[0] == '\0')
+		return 0;
+
+	for (i = 0; i < RTE_DIM(suffix); i++) {
+		snprintf(name, sizeof(name), "%s%s", restore_base, suffix[i]);
+		if (stat(name, &st) == 0)
+			total += st.st_size;
+	}
+	c->max_sess = RTE_MAX(total / (sizeof(struct sess_journal_rec) +
+				sizeof(struct sess_store_sess)), (size_t)1);
+	c->sess_size = (size_t)c->max_sess * sizeof(struct sess_store_sess);
+	params.entries = RTE_MAX(c->max_sess, 8U);
+	c->hash = rte_hash_create(&params);
+	c->rule_hash = rte_hash_create(&rule_params);
+	c->sess = mmap(NULL, c->sess_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	c->rules = calloc(SESS_STORE_RULES, sizeof(struct sess_store_rule));
+	c->rule_free = calloc(SESS_STORE_RULES, sizeof(uint32_t));
+	if ((c->hash == NULL) || (c->rule_hash == NULL)
+			|| (c->sess == MAP_FAILED) || (c->rules == NULL)
+			|| (c->rule_free == NULL))
+		rte_exit(EXIT_FAILURE, "Cannot allocate session restore of"
+				" %u records\n", c->max_sess);
+
+	for (i = 0; i < RTE_DIM(suffix); i++)
+		restore_file(c, suffix[i]);
+	if (c->bad)
+		RTE_LOG(ERR, DP, "%u restore records failed their CRC\n",
+				c->bad);
+	return 1;
+}
+
+/**
+ * Create the rules and sessions loaded by restore_load() and free the
+ * scratch tables.
+ */
+static void
+restore_replay(struct restore_ctx *c)
+{
+	store_replay_all(c->rules, c->nb_rules, c->sess, c->nb_sess, 0,
+			restore_base);
+
+	free(c->rule_free);
+	free(c->rules);
+	munmap(c->sess, c->sess_size);
+	rte_hash_free(c->rule_hash);
+	rte_hash_free(c->hash);
+}
+#endif /* SESS_SNAPSHOT */
+
+void
+sess_store_init(void)
+{
+	struct rte_hash_parameters rule_params = {
+		.name = "sess_store_rule",
+		.entries = SESS_STORE_RULES,
+		.key_len = sizeof(uint64_t),
+		.hash_func = rte_hash_crc,
+		.socket_id = rte_socket_id(),
+	};
+	uint32_t i;
+
+#ifdef SESS_SNAPSHOT
+	if ((store_path[0] == '\0') && (snap_base[0] == '\0'))
+#else
+	if (store_path[0] == '\0')
+#endif /* SESS_SNAPSHOT */
+		goto restore;
+
+	store_map();
+
+	store_free = rte_malloc("sess_store_free",
+			SESS_STORE_ENTRIES * sizeof(uint32_t), 0);
+	if (store_free == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot allocate session store slots\n");
+	/* lowest slots are used first */
+	store_nb_free = 0;
+	for (i = SESS_STORE_ENTRIES; i > 0; i--)
+		if (!store_sess[i - 1].used)
+			store_free[store_nb_free++] = i;
+
+	store_rule_hash = rte_hash_create(&rule_params);
+	store_rule_free = rte_malloc("sess_store_rule_free",
+			SESS_STORE_RULES * sizeof(uint32_t), 0);
+	if ((store_rule_hash == NULL) || (store_rule_free == NULL))
+		rte_exit(EXIT_FAILURE, "Cannot allocate session store rule"
+				" index\n");
+	store_nb_rule_free = 0;
+	for (i = SESS_STORE_RULES; i > 0; i--) {
+		struct sess_store_rule *r = &store_rule[i - 1];
+		uint64_t key = store_rule_key(r->type, r->id);
+
+		if (!r->used)
+			store_rule_free[store_nb_rule_free++] = i - 1;
+		else if (rte_hash_add_key_data(store_rule_hash, &key,
+				(void *)(uintptr_t)(i - 1)) < 0)
+			rte_exit(EXIT_FAILURE, "Cannot index session store"
+					" rule %u\n", r->id);
+	}
+
+restore:
+#ifdef SESS_SNAPSHOT
+	{
+		struct restore_ctx c;
+		int restore;
+
+		/* read before snap_init() replaces the files of the same
+		 * base, then the journal records the restored sessions */
+		restore = restore_load(&c);
+		snap_init();
+		if (restore)
+			restore_replay(&c);
+	}
+#endif /* SESS_SNAPSHOT */
+	return;
+}
+
+void
+sess_store_sess_add(const struct session_info *si, uint32_t *slot)
+{
+	struct sess_store_sess *s;
+
+	if (store_hdr == NULL)
+		return;
+	if (store_replay) {
+		*slot = store_replay_slot;
+		return;
+	}
+	if (*slot == 0) {
+		if (store_nb_free == 0) {
+			RTE_LOG(ERR, DP, "Session store full, session 0x%"
+					PRIx64" not kept\n", si->sess_id);
+			return;
+		}
+		*slot = store_free[--store_nb_free];
+	}
+
+	s = &store_sess[*slot - 1];
+	s->si = *si;
+	s->state = IN_PROGRESS;
+	s->used = 1;
+	s->crc = store_crc(s, sizeof(*s));
+#ifdef SESS_SNAPSHOT
+	journal_put(SESS_JRNL_SESS_PUT, 0, 0, si->sess_id, s, sizeof(*s));
+#endif /* SESS_SNAPSHOT */
+}
+
+void
+sess_store_sess_modify(uint32_t slot, const struct session_info *si,
+		uint8_t state)
+{
+	uint32_t adc_rule_id[MAX_ADC_RULES];
+	struct sess_store_sess *s;
+	uint32_t num_adc_rules;
+
+	if ((store_hdr == NULL) || store_replay || (slot == 0))
+		return;
+
+	s = &store_sess[slot - 1];
+	/* a modify without ADC rules keeps those of the bearer */
+	if (si->num_adc_rules == 0) {
+		num_adc_rules = s->si.num_adc_rules;
+		memcpy(adc_rule_id, s->si.adc_rule_id, sizeof(adc_rule_id));
+		s->si = *si;
+		s->si.num_adc_rules = num_adc_rules;
+		memcpy(s->si.adc_rule_id, adc_rule_id, sizeof(adc_rule_id));
+	} else {
+		s->si = *si;
+	}
+	s->state = state;
+	s->crc = store_crc(s, sizeof(*s));
+#ifdef SESS_SNAPSHOT
+	journal_put(SESS_JRNL_SESS_PUT, 0, 0, s->si.sess_id, s, sizeof(*s));
+#endif /* SESS_SNAPSHOT */
+}
+
+void
+sess_store_sess_del(uint32_t slot)
+{
+	struct sess_store_sess *s;
+
+	if ((store_hdr == NULL) || store_replay || (slot == 0))
+		return;
+
+	s = &store_sess[slot - 1];
+#ifdef SESS_SNAPSHOT
+	journal_put(SESS_JRNL_SESS_DEL, 0, 0, s->si.sess_id, NULL, 0);
+#endif /* SESS_SNAPSHOT */
+	memset(s, 0, sizeof(*s));
+	store_free[store_nb_free++] = slot;
+}
+
+/**
+ * Find the record of a rule.
+ *
+ * @param add
+ *	take a free record if not stored.
+ *
+ * @return
+ *	the record, NULL if not found and not added
+ */
+static struct sess_store_rule *
+store_rule_find(enum sess_store_rule_type type, uint32_t id, int add)
+{
+	uint64_t key = store_rule_key(type, id);
+	uintptr_t idx;
+	void *data;
+
+	if (rte_hash_lookup_data(store_rule_hash, &key, &data) >= 0)
+		return &store_rule[(uintptr_t)data];
+	if (!add || (store_nb_rule_free == 0))
+		return NULL;
+
+	idx = store_rule_free[--store_nb_rule_free];
+	if (rte_hash_add_key_data(store_rule_hash, &key, (void *)idx) < 0) {
+		store_rule_free[store_nb_rule_free++] = idx;
+		return NULL;
+	}
+	return &store_rule[idx];
+}
+
+void
+sess_store_rule_add(enum sess_store_rule_type type, uint32_t id,
+		const void *rule, uint32_t len)
+{
+	struct sess_store_rule *r;
+
+	if ((store_hdr == NULL) || store_replay)
+		return;
+
+	r = store_rule_find(type, id, 1);
+	if ((r == NULL) || (len > sizeof(r->u))) {
+		RTE_LOG(ERR, DP, "Session store cannot keep rule %u\n", id);
+		return;
+	}
+	memcpy(&r->u, rule, len);
+	r->type = type;
+	r->id = id;
+	r->used = 1;
+	r->crc = store_crc(r, sizeof(*r));
+#ifdef SESS_SNAPSHOT
+	journal_put(SESS_JRNL_RULE_PUT, type, id, 0, r, sizeof(*r));
+#endif /* SESS_SNAPSHOT */
+}
+
+void
+sess_store_rule_del(enum sess_store_rule_type type, uint32_t id)
+{
+	struct sess_store_rule *r;
+	uint64_t key;
+
+	if ((store_hdr == NULL) || store_replay)
+		return;
+
+	r = store_rule_find(type, id, 0);
+	if (r == NULL)
+		return;
+	memset(r, 0, sizeof(*r));
+	key = store_rule_key(type, id);
+	rte_hash_del_key(store_rule_hash, &key);
+	store_rule_free[store_nb_rule_free++] = r - store_rule;
+#ifdef SESS_SNAPSHOT
+	journal_put(SESS_JRNL_RULE_DEL, type, id, 0, NULL, 0);
+#endif /* SESS_SNAPSHOT */
+}
+#endif /* WARM_RESTART */
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SESS_STORE_H_
+#define _SESS_STORE_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the persistent session store used for warm restarts.
+ *
+ * With --warm_restart <file> the DP keeps a copy of every session,
+ * PCC rule, SDF filter, ADC rule and meter profile pushed by the CP in
+ * a shared file mapping, typically on a hugetlbfs mount or /dev/shm. The
+ * mapping outlives the DP process, so a restarted DP finds the file,
+ * checks that it was written with the same layout and config, and
+ * re-creates its tables from it before the CP connects.
+ *
+ * The tables themselves cannot be reattached: a DPDK primary process
+ * clears the hugepages of its predecessor at start up, and the hashes
+ * and ACL contexts hold pointers of the old process. Re-creating them
+ * from the store is local and takes seconds for millions of sessions.
+ *
+ * Each record carries a CRC, a record torn by a crash in the middle of
+ * an update is dropped at restart. Volumes counted since the last CDR
+ * export are not kept.
+ */
+#ifdef WARM_RESTART
+#include <stdint.h>
+
+#include "main.h"
+
+/** Sessions held by the store, override in the Makefile */
+#ifndef SESS_STORE_ENTRIES
+#define SESS_STORE_ENTRIES	(1 << 20)
+#endif
+
+/** PCC, SDF, ADC and meter entries held by the store */
+#define SESS_STORE_RULES	(SDF_FILTER_TABLE_SIZE + ADC_TABLE_SIZE + \
+		PCC_TABLE_SIZE + METER_PROFILE_SDF_TABLE_SIZE)
+
+#define SESS_STORE_MAGIC	"NGICSST"
+#define SESS_STORE_VERSION	1
+
+/**
+ * Rule types of the store, in the order they are re-created: meters
+ * and ADC rules are referred to by PCC rules, which are referred to by
+ * SDF filters.
+ */
+enum sess_store_rule_type {
+	SESS_STORE_MTR,
+	SESS_STORE_ADC,
+	SESS_STORE_PCC,
+	SESS_STORE_SDF,
+	SESS_STORE_NUM_TYPES,
+};
+
+/**
+ * Store file header.
+ */
+struct sess_store_hdr {
+	char magic[8];		/** SESS_STORE_MAGIC */
+	uint32_t version;	/** SESS_STORE_VERSION */
+	uint32_t sess_size;	/** size of a session record */
+	uint32_t rule_size;	/** size of a rule record */
+	uint32_t max_sess;	/** session records */
+	uint32_t max_rules;	/** rule records */
+	uint32_t spgw_cfg;	/** DP type the records were pushed to */
+	uint32_t s1u_ip;	/** DP addresses the records were pushed to */
+	uint32_t sgi_ip;
+	uint32_t restarts;	/** warm restarts of the store */
+} __rte_cache_aligned;
+
+/**
+ * Session record, the session info as last created or modified and the
+ * session state after it.
+ */
+struct sess_store_sess {
+	uint32_t crc;		/** CRC of the rest of the record */
+	uint8_t used;
+	uint8_t state;		/** enum dp_session_state */
+	uint16_t pad;
+	struct session_info si;
+} __rte_cache_aligned;
+
+/**
+ * Rule record.
+ */
+struct sess_store_rule {
+	uint32_t crc;		/** CRC of the rest of the record */
+	uint8_t used;
+	uint8_t type;		/** enum sess_store_rule_type */
+	uint16_t pad;
+	uint32_t id;		/** rule id or meter profile index */
+	union {
+		struct mtr_entry mtr;
+		struct adc_rules adc;
+		struct pcc_rules pcc;
+		struct pkt_filter sdf;
+	} u;
+} __rte_cache_aligned;
+
+/**
+ * Set the store file, --warm_restart.
+ *
+ * @param path
+ *	store file.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if path is too long
+ */
+int
+sess_store_parse(const char *path);
+
+/**
+ * Map the store file, creating it if needed, and re-create the rules
+ * and sessions of a valid store. An invalid store is cleared. With
+ * SESS_SNAPSHOT, restore the --sess_restore files and start the journal
+ * of --sess_snapshot. Called after dp_table_init(), before the CP
+ * messages are processed.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_init(void);
+
+/**
+ * Store a created session.
+ *
+ * @param si
+ *	session info of the create.
+ * @param slot
+ *	store slot of the bearer, set if 0.
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_sess_add(const struct session_info *si, uint32_t *slot);
+
+/**
+ * Store a modified session and its state. The session info of the modify
+ * replaces the stored one, but for the ADC rules which are kept if the
+ * modify has none, as in dp_session_modify().
+ *
+ * @param slot
+ *	store slot of the bearer.
+ * @param si
+ *	session info of the modify.
+ * @param state
+ *	session state after the modify.
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_sess_modify(uint32_t slot, const struct session_info *si,
+		uint8_t state);
+
+/**
+ * Remove a deleted session.
+ *
+ * @param slot
+ *	store slot of the bearer.
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_sess_del(uint32_t slot);
+
+/**
+ * Store an added rule, replacing a stored one of the same type and id.
+ *
+ * @param type
+ *	rule type.
+ * @param id
+ *	rule id or meter profile index.
+ * @param rule
+ *	rule as passed to the table add.
+ * @param len
+ *	size of rule.
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_rule_add(enum sess_store_rule_type type, uint32_t id,
+		const void *rule, uint32_t len);
+
+/**
+ * Remove a deleted rule.
+ *
+ * @param type
+ *	rule type.
+ * @param id
+ *	rule id or meter profile index.
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_rule_del(enum sess_store_rule_type type, uint32_t id);
+
+#ifdef SESS_SNAPSHOT
+/**
+ * With --sess_snapshot <base> every store update is appended to the
+ * journal <base>.jrnl, and every SESS_SNAP_SEC the live records are
+ * written to <base>.snap by a snapshot thread. At the start of a
+ * snapshot the journal is renamed to <base>.jrnl.old, which is removed
+ * once the snapshot is complete.
+ *
+ * A standby DP started with --sess_restore <base> loads the snapshot and
+ * then the journals into a scratch table sized from the files, keeping
+ * the last version of each record, and creates the surviving rules and
+ * sessions in one pass. Journal records hold the whole record, so
+ * replaying journal records older than the snapshot is harmless.
+ */
+
+/** Seconds between snapshots */
+#ifndef SESS_SNAP_SEC
+#define SESS_SNAP_SEC		60
+#endif
+/** Journal records are written out after at most this many ms */
+#define SESS_JOURNAL_FLUSH_MS	100
+/** stdio buffer of the journal */
+#define SESS_JOURNAL_BUF	(1 << 20)
+/** Copies of a record the snapshot tries before it fails */
+#define SESS_SNAP_COPY_RETRIES	1024
+
+#define SESS_SNAP_MAGIC		"NGICSSN"
+
+/** Journal record ops */
+enum sess_journal_op {
+	SESS_JRNL_SESS_PUT = 1,	/** followed by a struct sess_store_sess */
+	SESS_JRNL_SESS_DEL,
+	SESS_JRNL_RULE_PUT,	/** followed by a struct sess_store_rule */
+	SESS_JRNL_RULE_DEL,
+};
+
+/**
+ * Snapshot and journal file header, followed by journal records. A
+ * snapshot holds PUT records only.
+ */
+struct sess_snap_hdr {
+	char magic[8];		/** SESS_SNAP_MAGIC */
+	uint32_t version;	/** SESS_STORE_VERSION */
+	uint32_t sess_size;	/** size of a session record */
+	uint32_t rule_size;	/** size of a rule record */
+	uint32_t pad;
+};
+
+/**
+ * Journal record.
+ */
+struct sess_journal_rec {
+	uint8_t op;		/** enum sess_journal_op */
+	uint8_t type;		/** rule type of rule records */
+	uint16_t pad;
+	uint32_t id;		/** rule id of rule records */
+	uint64_t sess_id;	/** session id of session records */
+} __attribute__((packed));
+
+/**
+ * Set the snapshot and journal files, --sess_snapshot.
+ *
+ * @param base
+ *	file name, without the .snap and .jrnl suffixes.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if base is too long
+ */
+int
+sess_snapshot_parse(const char *base);
+
+/**
+ * Set the snapshot and journal files to restore, --sess_restore.
+ *
+ * @param base
+ *	file name, without the .snap and .jrnl suffixes.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if base is too long
+ */
+int
+sess_restore_parse(const char *base);
+
+/**
+ * Flush the journal and start the periodic snapshots. Called by the
+ * iface core.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+sess_store_poll(void);
+#endif /* SESS_SNAPSHOT */
+#endif /* WARM_RESTART */
+#endif /* _SESS_STORE_H_ */
@@ -16,25 +16,40 @@
 
 #define _GNU_SOURCE     /* Expose declaration of tdestroy() */
 #include <search.h>
+#include <sys/queue.h>
+#include <arpa/inet.h>
 #include <rte_mbuf.h>
 #include <rte_common.h>
 #include <rte_eal.h>
 #include <rte_log.h>
 #include <rte_malloc.h>
+#include <rte_mempool.h>
+#include <rte_errno.h>
+#include <rte_prefetch.h>
 #include <rte_jhash.h>
 #include <rte_cfgfile.h>
 #include <rte_hash.h>
 #include <rte_hash_crc.h>
+#include <rte_cycles.h>
+#include <rte_spinlock.h>
 
 
 #include "vepc_cp_dp_api.h"
 #include "main.h"
 #include "util.h"
+#include "gtpu.h"
 #include "acl.h"
 #include "interface.h"
 #include "cdr.h"
 #include "session_cdr.h"
 #include "meter.h"
+#include "qsbr.h"
+#include "flow_cache.h"
+#include "cdr_shard.h"
+#include "sess_store.h"
+#include "pkt_mirror.h"
+#include "table_budget.h"
+#include "ipv6.h"
 
 #define SESS_CREATE 0
 #define SESS_MODIFY 1
@@ -44,9 +59,170 @@ extern struct rte_hash *rte_sess_hash;
 extern struct rte_hash *rte_ue_hash;
 extern struct rte_hash *rte_uplink_hash;
 extern struct rte_hash *rte_downlink_hash;
+#ifdef UE_IPV6
+extern struct rte_hash *rte_downlink6_hash;
+#endif
 extern struct rte_hash *rte_adc_hash;
 extern struct rte_hash *rte_adc_ue_hash;
 
+/** Serializes the DNS lcores adding to rte_adc_hash */
+static rte_spinlock_t adc_dns_lock = RTE_SPINLOCK_INITIALIZER;
+
+#ifdef ADC_DNS_AGING
+/** Ticks of the ADC dns aging wheel are 2^ADC_DNS_WHEEL_SHIFT seconds */
+#define ADC_DNS_WHEEL_SHIFT	4
+/** Wheel slots, spanning more than ADC_DNS_TTL_MAX */
+#define ADC_DNS_WHEEL_SLOTS	(1 << 13)
+#define ADC_DNS_WHEEL_MASK	(ADC_DNS_WHEEL_SLOTS - 1)
+
+/**
+ * ADC dns table entry. Workers read it as struct msg_adc.
+ */
+struct adc_dns_entry {
+	struct msg_adc adc;
+	/** tick the entry expires at */
+	uint32_t expire;
+	LIST_ENTRY(adc_dns_entry) next;
+};
+
+/** Entries by expiry tick, refreshed entries move when their old slot
+ * is reached. Protected by adc_dns_lock. */
+static LIST_HEAD(, adc_dns_entry) adc_dns_wheel[ADC_DNS_WHEEL_SLOTS];
+/** Next tick to age */
+static uint32_t adc_dns_wheel_tick;
+
+static inline uint32_t
+adc_dns_now(void)
+{
+	return (rte_rdtsc() / rte_get_tsc_hz()) >> ADC_DNS_WHEEL_SHIFT;
+}
+
+static inline uint32_t
+adc_dns_expire(uint32_t ttl)
+{
+	ttl = RTE_MAX(RTE_MIN(ttl, ADC_DNS_TTL_MAX), ADC_DNS_TTL_MIN);
+	return adc_dns_now() + ((ttl + (1 << ADC_DNS_WHEEL_SHIFT) - 1)
+			>> ADC_DNS_WHEEL_SHIFT);
+}
+#endif	/* ADC_DNS_AGING */
+
+#ifdef SHARDED_SESS_TABLE
+/*
+ * Per worker shards of the uplink, downlink and adc ue tables, indexed
+ * by worker index. All the entries of a UE live in the shard of the
+ * worker the load balancer steers the UE ip to.
+ */
+static struct rte_hash *ul_hash_shard[DP_MAX_LCORE];
+static struct rte_hash *dl_hash_shard[DP_MAX_LCORE];
+static struct rte_hash *adc_ue_hash_shard[DP_MAX_LCORE];
+#ifdef UE_IPV6
+static struct rte_hash *dl6_hash_shard[DP_MAX_LCORE];
+#endif
+
+#define UL_HASH(shard)		(ul_hash_shard[(shard)])
+#define DL_HASH(shard)		(dl_hash_shard[(shard)])
+#define DL6_HASH(shard)		(dl6_hash_shard[(shard)])
+#define ADC_UE_HASH(shard)	(adc_ue_hash_shard[(shard)])
+#else
+#define UL_HASH(shard)		(rte_uplink_hash)
+#define DL_HASH(shard)		(rte_downlink_hash)
+#define DL6_HASH(shard)		(rte_downlink6_hash)
+#define ADC_UE_HASH(shard)	(rte_adc_ue_hash)
+#endif	/* SHARDED_SESS_TABLE */
+
+/**
+ * @brief Shard of the tables looked up by the calling worker.
+ */
+static inline uint32_t worker_shard(void)
+{
+#ifdef SHARDED_SESS_TABLE
+	return epc_app.worker_core_mapping[rte_lcore_id()];
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief Shard holding the table entries of a UE.
+ *
+ * @param ue_ipv4
+ *	UE ip address, host order.
+ */
+static inline uint32_t ue_shard(uint32_t ue_ipv4)
+{
+#ifdef SHARDED_SESS_TABLE
+	uint32_t ue_ip = htonl(ue_ipv4);
+	uint32_t shard;
+
+	set_ue_worker_core_id(&shard, &ue_ip);
+	return shard;
+#else
+	RTE_SET_USED(ue_ipv4);
+	return 0;
+#endif
+}
+
+/**
+ * @brief Shard holding the table entries of a UE of either address
+ * family.
+ *
+ * @param ue_addr
+ *	UE ip address.
+ */
+static inline uint32_t ue_addr_shard(const struct ip_addr *ue_addr)
+{
+#ifdef SHARDED_SESS_TABLE
+	uint32_t ue_ip = ue_addr_lb_ip(ue_addr);
+	uint32_t shard;
+
+	set_ue_worker_core_id(&shard, &ue_ip);
+	return shard;
+#else
+	RTE_SET_USED(ue_addr);
+	return 0;
+#endif
+}
+
+#define sess_shard(sess)	ue_addr_shard(&(sess)->ue_addr)
+
+#ifdef SHARDED_SESS_TABLE
+void sess_table_shards_init(void)
+{
+	uint32_t entries = DP_BEARER_ENTRIES;
+	uint32_t adc_entries = DP_UE_ENTRIES;
+	char name[RTE_HASH_NAMESIZE];
+	unsigned i;
+
+	/* UE ip hash does not spread evenly, leave 2x headroom per shard */
+	if (epc_app.num_workers > 1) {
+		entries = entries / epc_app.num_workers * 2;
+		adc_entries = adc_entries / epc_app.num_workers * 2;
+	}
+
+	for (i = 0; i < epc_app.num_workers; i++) {
+		/* shards are only read by their worker */
+		int socket = dp_lcore_socket(epc_app.worker_cores[i]);
+
+		snprintf(name, sizeof(name), "iface_uplink_db_%u", i);
+		hash_create_socket(name, &ul_hash_shard[i], entries,
+				sizeof(struct ul_bm_key), socket);
+		snprintf(name, sizeof(name), "iface_downlink_db_%u", i);
+		hash_create_socket(name, &dl_hash_shard[i], entries,
+				sizeof(struct dl_bm_key), socket);
+		snprintf(name, sizeof(name), "adc_ue_info_%u", i);
+		hash_create_socket(name, &adc_ue_hash_shard[i], adc_entries,
+				sizeof(struct dl_bm_key), socket);
+#ifdef UE_IPV6
+		snprintf(name, sizeof(name), "iface_downlink6_db_%u", i);
+		hash_create_socket(name, &dl6_hash_shard[i], entries,
+				sizeof(struct dl6_bm_key), socket);
+#endif
+	}
+	RTE_LOG(INFO, DP, "Session tables sharded on %u workers, "
+			"%u entries per shard\n", epc_app.num_workers, entries);
+}
+#endif	/* SHARDED_SESS_TABLE */
+
 #define DEBUG_SESS_TABLE 0
 
 #if DEBUG_SESS_TABLE
@@ -131,35 +307,482 @@ int
 iface_lookup_uplink_data(struct ul_bm_key *key,
 		void **value)
 {
-	return rte_hash_lookup_data(rte_uplink_hash, key, value);
+	return rte_hash_lookup_data(UL_HASH(worker_shard()), key, value);
+}
+
+#ifdef UL_TEID_TABLE
+/**
+ * Number of slots of the TEID indexed uplink table, power of 2.
+ */
+#ifdef TABLE_BUDGET
+static uint32_t ul_teid_table_size;
+#define UL_TEID_TABLE_SIZE	ul_teid_table_size
+#else
+#define UL_TEID_TABLE_SIZE	(LDB_ENTRIES_DEFAULT * HASH_SIZE_FACTOR)
+#endif
+
+/**
+ * TEID indexed uplink table slot. Holds one of the uplink hash entries
+ * whose TEID maps to the slot, other entries are only in the hash.
+ */
+struct ul_teid_entry {
+	uint32_t teid;		/**< s1u sgw teid, 0 when free */
+	uint32_t rid;		/**< rule id of the key */
+	void *data;		/**< sdf per bearer info */
+};
+
+static struct ul_teid_entry *ul_teid_table;
+
+/**
+ * Slot of a TEID. The CP allocates (0xf0 + bearer index) << 24 | context
+ * teid, the bearer index is moved to the low bits so the bearers of a UE
+ * use consecutive slots.
+ */
+static inline struct ul_teid_entry *ul_teid_slot(uint32_t teid)
+{
+	uint32_t idx = ((teid & 0x00ffffff) << 4) | ((teid >> 24) & 0xf);
+
+	return &ul_teid_table[idx & (UL_TEID_TABLE_SIZE - 1)];
 }
 
+void ul_teid_table_init(void)
+{
+#ifdef TABLE_BUDGET
+	size_t mark = table_budget_mark();
+
+	ul_teid_table_size = rte_align32pow2(DP_BEARER_ENTRIES);
+#else
+	RTE_BUILD_BUG_ON(UL_TEID_TABLE_SIZE & (UL_TEID_TABLE_SIZE - 1));
+#endif
+
+	ul_teid_table = rte_zmalloc_socket("ul_teid_table",
+			sizeof(struct ul_teid_entry) * UL_TEID_TABLE_SIZE,
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (ul_teid_table == NULL)
+		rte_panic("Failed to allocate TEID indexed uplink table\n");
+#ifdef TABLE_BUDGET
+	table_budget_account("ul_teid_table", mark);
+#endif
+}
+
+/**
+ * Add an uplink entry to the slot of its TEID if the slot is free, or
+ * refresh the data of the slot if it holds the same key, as the hash add
+ * does.
+ */
+static void ul_teid_table_add(struct ul_bm_key *key, void *data)
+{
+	struct ul_teid_entry *e = ul_teid_slot(key->s1u_sgw_teid);
+
+	if (key->s1u_sgw_teid == 0)
+		return;
+	if (e->teid == key->s1u_sgw_teid && e->rid == key->rid) {
+		/* the old data is freed after a grace period */
+		e->data = data;
+		return;
+	}
+	if (e->teid != 0)
+		return;
+
+	e->rid = key->rid;
+	e->data = data;
+	rte_smp_wmb();
+	e->teid = key->s1u_sgw_teid;
+}
+
+/**
+ * Remove an uplink entry from the slot of its TEID.
+ */
+static void ul_teid_table_del(struct ul_bm_key *key)
+{
+	struct ul_teid_entry *e = ul_teid_slot(key->s1u_sgw_teid);
+
+	if (e->teid != key->s1u_sgw_teid || e->rid != key->rid)
+		return;
+
+	/* data stays valid for the workers until the grace period of the
+	 * bearer ends, they check the key again after loading it */
+	e->teid = 0;
+}
+
+int
+iface_lookup_uplink_bulk_data(const void **key, uint32_t n,
+		uint64_t *hit_mask, void **value)
+{
+	struct ul_teid_entry *slot[MAX_BURST_SZ];
+	const void *miss_key[MAX_BURST_SZ];
+	void *miss_data[MAX_BURST_SZ];
+	uint32_t miss_idx[MAX_BURST_SZ];
+	uint64_t hits = 0, miss_hits = 0;
+	uint32_t i, n_miss = 0;
+
+	for (i = 0; i < n; i++) {
+		slot[i] = ul_teid_slot(
+			((const struct ul_bm_key *)key[i])->s1u_sgw_teid);
+		rte_prefetch0(slot[i]);
+	}
+
+	for (i = 0; i < n; i++) {
+		const struct ul_bm_key *k = key[i];
+		volatile struct ul_teid_entry *e = slot[i];
+		void *data;
+
+		if (likely(k->s1u_sgw_teid && e->teid == k->s1u_sgw_teid &&
+				e->rid == k->rid)) {
+			rte_smp_rmb();
+			data = e->data;
+			rte_smp_rmb();
+			/* slot may have been deleted or reused meanwhile */
+			if (likely(data != NULL &&
+					e->teid == k->s1u_sgw_teid &&
+					e->rid == k->rid)) {
+				value[i] = data;
+				hits |= 1ULL << i;
+				continue;
+			}
+		}
+		miss_idx[n_miss] = i;
+		miss_key[n_miss++] = key[i];
+	}
+
+	/* TEIDs sharing a slot fall back to the hash */
+	if (unlikely(n_miss)) {
+		if (rte_hash_lookup_bulk_data(UL_HASH(worker_shard()), miss_key,
+				n_miss, &miss_hits, miss_data) < 0)
+			miss_hits = 0;
+
+		for (i = 0; i < n_miss; i++) {
+			if (ISSET_BIT(miss_hits, i)) {
+				value[miss_idx[i]] = miss_data[i];
+				hits |= 1ULL << miss_idx[i];
+			}
+		}
+	}
+
+	*hit_mask = hits;
+	return __builtin_popcountll(hits);
+}
+#else
 int
 iface_lookup_uplink_bulk_data(const void **key, uint32_t n,
 		uint64_t *hit_mask, void **value)
 {
-	return rte_hash_lookup_bulk_data(rte_uplink_hash, key, n, hit_mask, value);
+	return rte_hash_lookup_bulk_data(UL_HASH(worker_shard()), key, n,
+			hit_mask, value);
+}
+#endif	/* UL_TEID_TABLE */
+
+/**
+ * Max number of UE addresses indexed by the UE ip pool tables.
+ */
+#define UE_POOL_TABLE_MAX	DP_UE_ENTRIES
+
+/**
+ * Rule entries kept per UE in the UE ip pool tables.
+ */
+#define UE_POOL_WAYS		2
+
+/**
+ * UE ip pool table slot, holds the first UE_POOL_WAYS rules of a UE,
+ * other rules are only in the hash.
+ */
+struct ue_pool_slot {
+	struct {
+		uint32_t rid;	/**< rule id of the key */
+		void *data;	/**< looked up data, NULL when free */
+	} way[UE_POOL_WAYS];
+};
+
+/**
+ * Direct mapped table indexed by the offset of the UE ip within the
+ * configured UE ip pool, used ahead of a dl_bm_key hash.
+ */
+struct ue_pool_table {
+	uint32_t base;			/**< first UE ip, host order */
+	uint32_t size;			/**< number of slots */
+	struct ue_pool_slot *slots;	/**< NULL when not in use */
+	struct rte_hash **hash;		/**< hash holding all the entries,
+					 * per worker shard */
+};
+
+#ifdef SHARDED_SESS_TABLE
+static struct ue_pool_table dl_pool_table = {.hash = dl_hash_shard};
+static struct ue_pool_table adc_ue_pool_table = {.hash = adc_ue_hash_shard};
+#else
+static struct ue_pool_table dl_pool_table = {.hash = &rte_downlink_hash};
+static struct ue_pool_table adc_ue_pool_table = {.hash = &rte_adc_ue_hash};
+#endif
+
+static void
+ue_pool_table_create(struct ue_pool_table *t, const char *name)
+{
+	uint32_t mask = ntohl(app.ue_pool_mask);
+#ifdef TABLE_BUDGET
+	size_t mark = table_budget_mark();
+#endif
+
+	t->base = ntohl(app.ue_pool_ip) & mask;
+	t->size = RTE_MIN((uint64_t)~mask + 1, (uint64_t)UE_POOL_TABLE_MAX);
+	t->slots = rte_zmalloc_socket(name,
+			sizeof(struct ue_pool_slot) * t->size,
+			RTE_CACHE_LINE_SIZE, rte_socket_id());
+	if (t->slots == NULL)
+		rte_panic("Failed to allocate %s\n", name);
+#ifdef TABLE_BUDGET
+	table_budget_account(name, mark);
+#endif
+}
+
+void ue_pool_tables_init(void)
+{
+	if (app.ue_pool_mask == 0)
+		return;
+
+	ue_pool_table_create(&dl_pool_table, "dl_pool_table");
+	ue_pool_table_create(&adc_ue_pool_table, "adc_ue_pool_table");
+	RTE_LOG(INFO, DP, "UE ip pool tables: %u slots\n", dl_pool_table.size);
+}
+
+static inline struct ue_pool_slot *
+ue_pool_slot(struct ue_pool_table *t, uint32_t ue_ipv4)
+{
+	uint32_t off = ue_ipv4 - t->base;
+
+	if (t->slots == NULL || off >= t->size)
+		return NULL;
+	return &t->slots[off];
+}
+
+static void
+ue_pool_table_add(struct ue_pool_table *t, struct dl_bm_key *key, void *data)
+{
+	struct ue_pool_slot *slot = ue_pool_slot(t, key->ue_ipv4);
+	uint32_t i;
+
+	if (slot == NULL)
+		return;
+
+	for (i = 0; i < UE_POOL_WAYS; i++) {
+		if (slot->way[i].data && slot->way[i].rid == key->rid) {
+			slot->way[i].data = data;
+			return;
+		}
+	}
+	for (i = 0; i < UE_POOL_WAYS; i++) {
+		if (slot->way[i].data == NULL) {
+			slot->way[i].rid = key->rid;
+			rte_smp_wmb();
+			slot->way[i].data = data;
+			return;
+		}
+	}
+}
+
+static void
+ue_pool_table_del(struct ue_pool_table *t, struct dl_bm_key *key)
+{
+	struct ue_pool_slot *slot = ue_pool_slot(t, key->ue_ipv4);
+	uint32_t i;
+
+	if (slot == NULL)
+		return;
+
+	for (i = 0; i < UE_POOL_WAYS; i++) {
+		if (slot->way[i].data && slot->way[i].rid == key->rid) {
+			slot->way[i].data = NULL;
+			rte_smp_wmb();
+			slot->way[i].rid = 0;
+			return;
+		}
+	}
+}
+
+static int
+ue_pool_lookup_bulk(struct ue_pool_table *t, const void **key, uint32_t n,
+		uint64_t *hit_mask, void **value)
+{
+	const void *miss_key[MAX_BURST_SZ];
+	void *miss_data[MAX_BURST_SZ];
+	uint32_t miss_idx[MAX_BURST_SZ];
+	uint64_t hits = 0, miss_hits = 0;
+	uint32_t i, j, n_miss = 0;
+
+	if (t->slots == NULL)
+		return rte_hash_lookup_bulk_data(t->hash[worker_shard()], key, n, hit_mask,
+				value);
+
+	for (i = 0; i < n; i++) {
+		const struct dl_bm_key *k = key[i];
+		struct ue_pool_slot *slot = ue_pool_slot(t, k->ue_ipv4);
+
+		if (likely(slot != NULL)) {
+			for (j = 0; j < UE_POOL_WAYS; j++) {
+				void *data = slot->way[j].data;
+
+				if (data && slot->way[j].rid == k->rid) {
+					value[i] = data;
+					hits |= 1ULL << i;
+					break;
+				}
+			}
+			if (likely(j < UE_POOL_WAYS))
+				continue;
+		}
+		miss_idx[n_miss] = i;
+		miss_key[n_miss++] = key[i];
+	}
+
+	/* UEs outside of the pool and extra rules fall back to the hash */
+	if (unlikely(n_miss)) {
+		if (rte_hash_lookup_bulk_data(t->hash[worker_shard()], miss_key, n_miss,
+				&miss_hits, miss_data) < 0)
+			miss_hits = 0;
+
+		for (i = 0; i < n_miss; i++) {
+			if (ISSET_BIT(miss_hits, i)) {
+				value[miss_idx[i]] = miss_data[i];
+				hits |= 1ULL << miss_idx[i];
+			}
+		}
+	}
+
+	*hit_mask = hits;
+	return __builtin_popcountll(hits);
 }
 
 int
 iface_lookup_downlink_data(struct dl_bm_key *key,
 		void **value)
 {
-	return rte_hash_lookup_data(rte_downlink_hash, key, value);
+	return rte_hash_lookup_data(DL_HASH(worker_shard()), key, value);
 }
 
 int
 iface_lookup_downlink_bulk_data(const void **key, uint32_t n,
 		uint64_t *hit_mask, void **value)
 {
-	return rte_hash_lookup_bulk_data(rte_downlink_hash, key, n, hit_mask, value);
+	return ue_pool_lookup_bulk(&dl_pool_table, key, n, hit_mask, value);
 }
 
 int
 iface_lookup_adc_ue_data(struct dl_bm_key *key,
 		void **value)
 {
-	return rte_hash_lookup_data(rte_adc_ue_hash, key, value);
+	return rte_hash_lookup_data(ADC_UE_HASH(worker_shard()), key, value);
+}
+
+int
+iface_lookup_adc_ue_bulk_data(const void **key, uint32_t n,
+		uint64_t *hit_mask, void **value)
+{
+	return ue_pool_lookup_bulk(&adc_ue_pool_table, key, n, hit_mask,
+			value);
+}
+
+#ifdef UE_IPV6
+int
+iface_lookup_downlink6_bulk_data(const void **key, uint32_t n,
+		uint64_t *hit_mask, void **value)
+{
+	return rte_hash_lookup_bulk_data(DL6_HASH(worker_shard()), key, n,
+			hit_mask, value);
+}
+#endif /* UE_IPV6 */
+
+/**
+ * @brief Look up the sdf per bearer info of a rule of a UE in the
+ * downlink table of its address family.
+ *
+ * @param ue_addr
+ *	UE ip address.
+ * @param rid
+ *	rule id.
+ * @param data
+ *	sdf per bearer info found.
+ *
+ * @return
+ *	rte_hash_lookup_data() return value.
+ */
+static inline int
+dl_sess_lookup(const struct ip_addr *ue_addr, uint32_t rid, void **data)
+{
+	struct dl_bm_key key;
+#ifdef UE_IPV6
+	struct dl6_bm_key key6;
+
+	if (UE_ADDR_IS_IPV6(ue_addr)) {
+		key6.ue_prefix = ipv6_prefix64(ue_addr->u.ipv6_addr);
+		key6.rid = rid;
+		key6.pad = 0;
+		return rte_hash_lookup_data(DL6_HASH(ue_addr_shard(ue_addr)),
+				&key6, data);
+	}
+#endif /* UE_IPV6 */
+	key.ue_ipv4 = ue_addr->u.ipv4_addr;
+	key.rid = rid;
+	return rte_hash_lookup_data(DL_HASH(ue_addr_shard(ue_addr)), &key,
+			data);
+}
+
+/**
+ * @brief Add the sdf per bearer info of a rule of a UE to the downlink
+ * table of its address family.
+ *
+ * @return
+ *	rte_hash_add_key_data() return value.
+ */
+static inline int
+dl_sess_add(const struct ip_addr *ue_addr, uint32_t rid,
+		struct dp_sdf_per_bearer_info *psdf)
+{
+	struct dl_bm_key key;
+	int ret;
+#ifdef UE_IPV6
+	struct dl6_bm_key key6;
+
+	if (UE_ADDR_IS_IPV6(ue_addr)) {
+		key6.ue_prefix = ipv6_prefix64(ue_addr->u.ipv6_addr);
+		key6.rid = rid;
+		key6.pad = 0;
+		return rte_hash_add_key_data(DL6_HASH(ue_addr_shard(ue_addr)),
+				&key6, psdf);
+	}
+#endif /* UE_IPV6 */
+	key.ue_ipv4 = ue_addr->u.ipv4_addr;
+	key.rid = rid;
+	ret = rte_hash_add_key_data(DL_HASH(ue_addr_shard(ue_addr)), &key,
+			psdf);
+	if (ret >= 0)
+		ue_pool_table_add(&dl_pool_table, &key, psdf);
+	return ret;
+}
+
+/**
+ * @brief Delete the sdf per bearer info of a rule of a UE from the
+ * downlink table of its address family.
+ *
+ * @return
+ *	rte_hash_del_key() return value.
+ */
+static inline int
+dl_sess_del(const struct ip_addr *ue_addr, uint32_t rid)
+{
+	struct dl_bm_key key;
+#ifdef UE_IPV6
+	struct dl6_bm_key key6;
+
+	if (UE_ADDR_IS_IPV6(ue_addr)) {
+		key6.ue_prefix = ipv6_prefix64(ue_addr->u.ipv6_addr);
+		key6.rid = rid;
+		key6.pad = 0;
+		return rte_hash_del_key(DL6_HASH(ue_addr_shard(ue_addr)),
+				&key6);
+	}
+#endif /* UE_IPV6 */
+	key.ue_ipv4 = ue_addr->u.ipv4_addr;
+	key.rid = rid;
+	ue_pool_table_del(&dl_pool_table, &key);
+	return rte_hash_del_key(DL_HASH(ue_addr_shard(ue_addr)), &key);
 }
 
 /******************** DP- ADC, PCC funcitons **********************/
@@ -177,19 +800,21 @@ int iface_lookup_adc_bulk_data(const void **key, uint32_t n,
 struct rte_hash_bucket *bucket_ul_addr(uint64_t key)
 {
 	uint32_t bucket_idx;
-	hash_sig_t sig = rte_hash_hash(rte_uplink_hash, &key);
+	struct rte_hash *h = UL_HASH(worker_shard());
+	hash_sig_t sig = rte_hash_hash(h, &key);
 
-	bucket_idx = sig & rte_uplink_hash->bucket_bitmask;
-	return &rte_uplink_hash->buckets[bucket_idx];
+	bucket_idx = sig & h->bucket_bitmask;
+	return &h->buckets[bucket_idx];
 }
 
 struct rte_hash_bucket *bucket_dl_addr(uint64_t key)
 {
 	uint32_t bucket_idx;
-	hash_sig_t sig = rte_hash_hash(rte_downlink_hash, &key);
+	struct rte_hash *h = DL_HASH(worker_shard());
+	hash_sig_t sig = rte_hash_hash(h, &key);
 
-	bucket_idx = sig & rte_downlink_hash->bucket_bitmask;
-	return &rte_downlink_hash->buckets[bucket_idx];
+	bucket_idx = sig & h->bucket_bitmask;
+	return &h->buckets[bucket_idx];
 }
 
 int
@@ -197,20 +822,234 @@ add_rg_idx(uint32_t rg_val, struct rating_group_index_map *rg_idx_map)
 {
 	uint32_t i;
 
+	if (rg_val == 0)
+		return MAX_RATING_GRP;
+
 	for (i = 0; i < MAX_RATING_GRP; i++) {
 
 		if ((rg_idx_map+i)->rg_val == rg_val)
-			return 0;
+			return i;
 
 		if ((rg_idx_map+i)->rg_val == 0) {
 			(rg_idx_map+i)->rg_val = rg_val;
-			return 0;
+			(rg_idx_map+i)->rg_idx = i;
+			return i;
 		}
 	}
-	return -1;
+	return -1;
+}
+
+/******************** Session object allocation **********************/
+/**
+ * Names and sizes of the session table objects.
+ */
+static const struct {
+	const char *name;
+	size_t size;
+} sess_obj_desc[SESS_OBJ_MAX] = {
+	[SESS_OBJ_BEARER] = {"bearer_sess_pool",
+				sizeof(struct dp_session_info)},
+	[SESS_OBJ_UE] = {"ue_sess_pool", sizeof(struct ue_session_info)},
+	[SESS_OBJ_SDF] = {"sdf_bearer_pool",
+				sizeof(struct dp_sdf_per_bearer_info)},
+	[SESS_OBJ_ADC_UE] = {"adc_ue_pool", sizeof(struct dp_adc_ue_info)},
+};
+
+#ifdef SESS_MEMPOOL
+struct rte_mempool *sess_obj_pool[SESS_OBJ_MAX];
+
+/**
+ * @brief Create the session object pools, each holding n objects.
+ */
+static void
+sess_obj_pools_init(uint32_t n)
+{
+	uint32_t t;
+#ifdef TABLE_BUDGET
+	size_t mark;
+#endif
+
+	for (t = 0; t < SESS_OBJ_MAX; t++) {
+		if (sess_obj_pool[t] != NULL)
+			continue;
+
+#ifdef TABLE_BUDGET
+		mark = table_budget_mark();
+#endif
+		sess_obj_pool[t] = rte_mempool_create(sess_obj_desc[t].name,
+				n, sess_obj_desc[t].size, SESS_POOL_CACHE_SIZE,
+				0, NULL, NULL, NULL, NULL, rte_socket_id(), 0);
+		if (sess_obj_pool[t] == NULL)
+			rte_exit(EXIT_FAILURE, "%s create failed: %s (%u)\n",
+					sess_obj_desc[t].name,
+					rte_strerror(rte_errno), rte_errno);
+#ifdef TABLE_BUDGET
+		table_budget_account(sess_obj_desc[t].name, mark);
+#endif
+	}
+	RTE_LOG(INFO, DP, "Session object pools: %u objects each\n", n);
+}
+#endif	/* SESS_MEMPOOL */
+
+/**
+ * @brief Allocate a zeroed session table object.
+ *
+ * @return
+ *	object, NULL when out of memory.
+ */
+#ifdef CDR_COUNTER_SHARDS
+/**
+ * @brief Get the counter slot of a new session table object. Rating
+ * group slots of UEs are taken by ue_rg_cdr_slot_alloc() when used.
+ */
+static void
+sess_obj_cdr_slot_alloc(enum sess_obj_type t, void *obj)
+{
+	switch (t) {
+	case SESS_OBJ_BEARER:
+		((struct dp_session_info *)obj)->cdr_slot = cdr_slot_alloc();
+		break;
+	case SESS_OBJ_SDF:
+		((struct dp_sdf_per_bearer_info *)obj)->cdr_slot =
+				cdr_slot_alloc();
+		break;
+	case SESS_OBJ_ADC_UE:
+		((struct dp_adc_ue_info *)obj)->cdr_slot = cdr_slot_alloc();
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Release the counter slots of a session table object.
+ */
+static void
+sess_obj_cdr_slot_free(enum sess_obj_type t, void *obj)
+{
+	uint32_t i;
+
+	switch (t) {
+	case SESS_OBJ_BEARER:
+		cdr_slot_free(((struct dp_session_info *)obj)->cdr_slot);
+		break;
+	case SESS_OBJ_SDF:
+		cdr_slot_free(((struct dp_sdf_per_bearer_info *)obj)->cdr_slot);
+		break;
+	case SESS_OBJ_ADC_UE:
+		cdr_slot_free(((struct dp_adc_ue_info *)obj)->cdr_slot);
+		break;
+	case SESS_OBJ_UE:
+		for (i = 0; i < MAX_RATING_GRP; i++)
+			cdr_slot_free(
+				((struct ue_session_info *)obj)->rg_cdr_slot[i]);
+		break;
+	default:
+		break;
+	}
+}
+#endif	/* CDR_COUNTER_SHARDS */
+
+/**
+ * @brief Sum the worker counters of a CDR into it before export.
+ */
+#ifdef CDR_COUNTER_SHARDS
+#define CDR_SYNC(cdr, slot)	cdr_slot_sum((slot), &(cdr)->data_vol)
+#else
+#define CDR_SYNC(cdr, slot)
+#endif	/* CDR_COUNTER_SHARDS */
+
+/**
+ * @brief Take the counter slot of a UE rating group CDR on first use.
+ */
+static inline void
+ue_rg_cdr_slot_alloc(struct ue_session_info *ue, int idx)
+{
+#ifdef CDR_COUNTER_SHARDS
+	if ((idx >= 0) && (idx < MAX_RATING_GRP)
+			&& (ue->rg_cdr_slot[idx] == CDR_SLOT_NONE))
+		ue->rg_cdr_slot[idx] = cdr_slot_alloc();
+#else
+	RTE_SET_USED(ue);
+	RTE_SET_USED(idx);
+#endif	/* CDR_COUNTER_SHARDS */
+}
+
+static void *
+sess_obj_zalloc(enum sess_obj_type t)
+{
+	void *obj;
+
+#ifdef SESS_MEMPOOL
+	if (rte_mempool_get(sess_obj_pool[t], &obj) < 0)
+		return NULL;
+	memset(obj, 0, sess_obj_desc[t].size);
+#else
+	obj = rte_zmalloc(sess_obj_desc[t].name, sess_obj_desc[t].size,
+			RTE_CACHE_LINE_SIZE);
+	if (obj == NULL)
+		return NULL;
+#endif
+#ifdef CDR_COUNTER_SHARDS
+	sess_obj_cdr_slot_alloc(t, obj);
+#endif
+	return obj;
+}
+
+/**
+ * @brief Release a session table object once workers are done with it.
+ */
+static void
+sess_obj_free(enum sess_obj_type t, void *obj)
+{
+#ifdef CDR_COUNTER_SHARDS
+	sess_obj_cdr_slot_free(t, obj);
+#endif
+#ifdef SESS_MEMPOOL
+	dp_defer_mempool_put(sess_obj_pool[t], obj);
+#else
+	RTE_SET_USED(t);
+	dp_defer_free(obj);
+#endif
+}
+
+/********************* PCC rules update functions ***********************/
+/**
+ * @brief Function to fill a newly allocated sdf per bearer info, the
+ * per packet fields are copied out of the pcc rule.
+ */
+static void
+sdf_per_bearer_info_init(struct dp_sdf_per_bearer_info *psdf,
+		struct dp_pcc_rules *pcc_info, struct dp_session_info *sess)
+{
+	/* Keep the per packet fields in their cache lines */
+	RTE_BUILD_BUG_ON(offsetof(struct dp_sdf_per_bearer_info, qos) +
+			sizeof(struct qos_info) > RTE_CACHE_LINE_SIZE);
+#ifndef MTR_TRTCM
+	/* the trTCM meter object fills a cache line on its own */
+	RTE_BUILD_BUG_ON(offsetof(struct dp_sdf_per_bearer_info, sdf_mtr_drops)
+			+ sizeof(uint64_t) > 2 * RTE_CACHE_LINE_SIZE);
+#endif	/* MTR_TRTCM */
+	RTE_BUILD_BUG_ON(offsetof(struct dp_session_info, s5s8_sgwu_ipv4) +
+			sizeof(uint32_t) > 3 * RTE_CACHE_LINE_SIZE);
+	RTE_BUILD_BUG_ON(offsetof(struct dp_session_info, ipcan_dp_bearer_cdr)
+			!= 3 * RTE_CACHE_LINE_SIZE);
+
+	psdf->pcc_info = *pcc_info;
+	psdf->rating_group = pcc_info->rating_group;
+	psdf->rg_idx = MAX_RATING_GRP;
+	if (sess->ue_info_ptr != NULL) {
+		/* index is resolved once, not per packet */
+		int idx = add_rg_idx(pcc_info->rating_group,
+				sess->ue_info_ptr->rg_idx_map);
+		if (idx >= 0)
+			psdf->rg_idx = idx;
+		ue_rg_cdr_slot_alloc(sess->ue_info_ptr, idx);
+	}
+	psdf->qos = pcc_info->qos;
+	psdf->bear_sess_info = sess;
 }
 
-/********************* PCC rules update functions ***********************/
 /**
  * @brief Function to add UL pcc entry with key and
  * update pcc address and rating group.
@@ -221,7 +1060,6 @@ add_ul_pcc_entry_key_with_idx(struct dp_session_info *old,
 			struct dp_session_info *data, uint32_t idx)
 {
 	int ret;
-	struct dl_bm_key dl_key;
 	struct ul_bm_key ul_key;
 	struct dp_pcc_rules *pcc_info;
 	uint32_t pcc_id;
@@ -238,27 +1076,22 @@ add_ul_pcc_entry_key_with_idx(struct dp_session_info *old,
 	/* update rating group idx*/
 	if (old->ue_info_ptr != NULL) {
 		ret = add_rg_idx(pcc_info->rating_group, old->ue_info_ptr->rg_idx_map);
-		if (ret)
+		if (ret < 0)
 			rte_panic("Failed to add rating group to index map");
+		ue_rg_cdr_slot_alloc(old->ue_info_ptr, ret);
 	}
 
 	/* look for previously allocated sdf per bearer info in downlink hash */
-	dl_key.ue_ipv4 = old->ue_addr.u.ipv4_addr;
-	dl_key.rid = pcc_id;
-	if (rte_hash_lookup_data(rte_downlink_hash, &dl_key,
-			(void **)&psdf) < 0) {
+	if (dl_sess_lookup(&old->ue_addr, pcc_id, (void **)&psdf) < 0) {
 		/* alloc memory for per sdf per bearer info structure*/
-		psdf = rte_zmalloc("sdf per bearer",
-				sizeof(struct dp_sdf_per_bearer_info),
-				RTE_CACHE_LINE_SIZE);
+		psdf = sess_obj_zalloc(SESS_OBJ_SDF);
 		if (psdf == NULL) {
 			RTE_LOG(ERR, DP, "Failed to allocate memory for sdf "
 					"per bearer info");
 			return;
 		}
 
-		psdf->pcc_info = *pcc_info;
-		psdf->bear_sess_info = old;
+		sdf_per_bearer_info_init(psdf, pcc_info, old);
 	}
 
 #ifdef SDF_MTR
@@ -266,6 +1099,12 @@ add_ul_pcc_entry_key_with_idx(struct dp_session_info *old,
 	RTE_LOG(DEBUG, DP, "SDF MTR ADD:UL pcc %d, mtr_idx %d\n",
 			pcc_info->rule_id, pcc_info->qos.ul_mtr_profile_index);
 #endif	/* SDF_MTR */
+#ifdef MTR_HIERARCHICAL
+	/* GBR bearer level of the meter chain */
+	if (pcc_info->qos.ul_gbr_profile_index != 0)
+		mtr_cfg_entry(pcc_info->qos.ul_gbr_profile_index,
+				&old->ul_bearer_mtr_obj);
+#endif	/* MTR_HIERARCHICAL */
 
 	ul_key.s1u_sgw_teid = data->ul_s1_info.sgw_teid;
 	ul_key.rid = pcc_id;
@@ -273,11 +1112,14 @@ add_ul_pcc_entry_key_with_idx(struct dp_session_info *old,
 	RTE_LOG(DEBUG, DP, "SDF ADD:UL_KEY: teid:%u, rid:%u\n",
 			ul_key.s1u_sgw_teid, ul_key.rid);
 
-	ret = rte_hash_add_key_data(rte_uplink_hash,
+	ret = rte_hash_add_key_data(UL_HASH(sess_shard(old)),
 			&ul_key, psdf);
 
 	if (ret < 0)
 		rte_panic("Failed to add entry in hash table");
+#ifdef UL_TEID_TABLE
+	ul_teid_table_add(&ul_key, psdf);
+#endif
 }
 
 /**
@@ -289,7 +1131,6 @@ static void
 del_ul_pcc_entry_key_with_idx(struct dp_session_info *data, uint32_t idx)
 {
 	int ret;
-	struct dl_bm_key dl_key;
 	struct ul_bm_key ul_key;
 	struct dp_sdf_per_bearer_info *psdf;
 
@@ -303,14 +1144,18 @@ del_ul_pcc_entry_key_with_idx(struct dp_session_info *data, uint32_t idx)
 		return;
 
 	/* Get the sdf per bearer info */
-	ret = iface_lookup_uplink_data(&ul_key, (void **)&psdf);
+	ret = rte_hash_lookup_data(UL_HASH(sess_shard(data)), &ul_key,
+			(void **)&psdf);
 	if (ret < 0) {
 		RTE_LOG(DEBUG, DP, "BEAR_SESS DEL FAIL:UL_KEY: teid:%u, rid:%u\n",
 			ul_key.s1u_sgw_teid, ul_key.rid);
 		return ;
 	}
 
-	ret = rte_hash_del_key(rte_uplink_hash,
+#ifdef UL_TEID_TABLE
+	ul_teid_table_del(&ul_key);
+#endif
+	ret = rte_hash_del_key(UL_HASH(sess_shard(data)),
 			&ul_key);
 	if (ret == -ENOENT)
 		RTE_LOG(DEBUG, DP, "key is not found\n");
@@ -321,12 +1166,10 @@ del_ul_pcc_entry_key_with_idx(struct dp_session_info *data, uint32_t idx)
 
 
 	/* look for sdf per bearer info in downlink hash */
-	dl_key.ue_ipv4 = data->ue_addr.u.ipv4_addr;
-	dl_key.rid = data->dl_pcc_rule_id[idx];
-	if (rte_hash_lookup_data(rte_downlink_hash, &dl_key,
+	if (dl_sess_lookup(&data->ue_addr, data->dl_pcc_rule_id[idx],
 			(void **)&psdf) < 0) {
 		/* remove sdf per bearer info if not present in downlink hash */
-		rte_free(psdf);
+		sess_obj_free(SESS_OBJ_SDF, psdf);
 	}
 }
 
@@ -359,27 +1202,25 @@ add_dl_pcc_entry_key_with_idx(struct dp_session_info *old,
 	/* update rating group idx*/
 	if (old->ue_info_ptr != NULL) {
 		ret = add_rg_idx(pcc_info->rating_group, old->ue_info_ptr->rg_idx_map);
-		if (ret)
+		if (ret < 0)
 			rte_panic("Failed to add rating group to index map");
+		ue_rg_cdr_slot_alloc(old->ue_info_ptr, ret);
 	}
 
 	/* look for previously allocated sdf per bearer info in uplink hash */
 	ul_key.s1u_sgw_teid = data->ul_s1_info.sgw_teid;
 	ul_key.rid = pcc_id;
-	if (rte_hash_lookup_data(rte_uplink_hash, &ul_key,
+	if (rte_hash_lookup_data(UL_HASH(sess_shard(old)), &ul_key,
 			(void **)&psdf) < 0) {
 		/* alloc memory for per sdf per bearer info */
-		psdf = rte_zmalloc("sdf per bearer",
-				sizeof(struct dp_sdf_per_bearer_info),
-				RTE_CACHE_LINE_SIZE);
+		psdf = sess_obj_zalloc(SESS_OBJ_SDF);
 		if (psdf == NULL) {
 			RTE_LOG(ERR, DP, "Failed to allocate memory for sdf "
 					"per bearer info");
 			return;
 		}
 
-		psdf->pcc_info = *pcc_info;
-		psdf->bear_sess_info = old;
+		sdf_per_bearer_info_init(psdf, pcc_info, old);
 	}
 
 #ifdef SDF_MTR
@@ -387,6 +1228,12 @@ add_dl_pcc_entry_key_with_idx(struct dp_session_info *old,
 	RTE_LOG(DEBUG, DP, "SDF MTR ADD:DL pcc %d, mtr_idx %d\n",
 			pcc_info->rule_id, pcc_info->qos.dl_mtr_profile_index);
 #endif	/* SDF_MTR */
+#ifdef MTR_HIERARCHICAL
+	/* GBR bearer level of the meter chain */
+	if (pcc_info->qos.dl_gbr_profile_index != 0)
+		mtr_cfg_entry(pcc_info->qos.dl_gbr_profile_index,
+				&old->dl_bearer_mtr_obj);
+#endif	/* MTR_HIERARCHICAL */
 
 	dl_key.ue_ipv4 = old->ue_addr.u.ipv4_addr;
 	dl_key.rid = pcc_id;
@@ -394,10 +1241,7 @@ add_dl_pcc_entry_key_with_idx(struct dp_session_info *old,
 	RTE_LOG(DEBUG, DP, "SDF ADD:DL_KEY: ue_addr:"IPV4_ADDR ", rid: %d\n",
 			IPV4_ADDR_HOST_FORMAT(dl_key.ue_ipv4), pcc_id);
 
-	ret = rte_hash_add_key_data(rte_downlink_hash,
-			&dl_key, psdf);
-
-
+	ret = dl_sess_add(&old->ue_addr, pcc_id, psdf);
 	if (ret < 0)
 		rte_panic("Failed to add entry in hash table");
 }
@@ -447,15 +1291,14 @@ del_dl_pcc_entry_key_with_idx(struct dp_session_info *data, uint32_t idx)
 		dl_key.rid, IPV4_ADDR_HOST_FORMAT(dl_key.ue_ipv4));
 
 	/* Get the sdf per bearer info */
-	ret = iface_lookup_downlink_data(&dl_key, (void **)&psdf);
+	ret = dl_sess_lookup(&data->ue_addr, dl_key.rid, (void **)&psdf);
 	if (ret < 0) {
 		RTE_LOG(DEBUG, DP, "BEAR_SESS DEL FAIL:DL_KEY: ue_addr:"IPV4_ADDR ",",
 			IPV4_ADDR_HOST_FORMAT(dl_key.ue_ipv4));
 		return ;
 	}
 
-	ret = rte_hash_del_key(rte_downlink_hash,
-			&dl_key);
+	ret = dl_sess_del(&data->ue_addr, dl_key.rid);
 	if (ret < 0)
 		rte_panic("Failed to del entry from hash table");
 
@@ -466,10 +1309,10 @@ del_dl_pcc_entry_key_with_idx(struct dp_session_info *data, uint32_t idx)
 	/* look for sdf per bearer info in uplink hash */
 	ul_key.s1u_sgw_teid = data->ul_s1_info.sgw_teid;
 	ul_key.rid = data->dl_pcc_rule_id[idx];
-	if (rte_hash_lookup_data(rte_uplink_hash, &ul_key,
+	if (rte_hash_lookup_data(UL_HASH(sess_shard(data)), &ul_key,
 			(void **)&psdf) < 0) {
 		/* remove sdf per bearer info if not present in uplink hash */
-		rte_free(psdf);
+		sess_obj_free(SESS_OBJ_SDF, psdf);
 	}
 }
 
@@ -567,12 +1410,14 @@ add_adc_entry_key_with_idx(struct ue_session_info *old,
 	void *data = NULL;
 
 	adc_id = new->adc_rule_id[idx];
-	if (adc_id == 0)
+	/* the ADC UE table is keyed on IPv4 UEs only */
+	if (adc_id == 0 || UE_ADDR_IS_IPV6(&old->ue_addr))
 		return;
 	key.ue_ipv4 = old->ue_addr.u.ipv4_addr;
 	key.rid = adc_id;
 
-	ret = rte_hash_lookup_data(rte_adc_ue_hash, &key, &data);
+	ret = rte_hash_lookup_data(ADC_UE_HASH(ue_shard(key.ue_ipv4)), &key,
+			&data);
 	if (data)
 		return;
 
@@ -581,22 +1426,26 @@ add_adc_entry_key_with_idx(struct ue_session_info *old,
 	old->adc_rule_id[idx] = adc_id;
 
 	/* alloc memory for per ADC per UE info structure*/
-	padc_ue = rte_zmalloc("adc ue info", sizeof(struct dp_adc_ue_info),
-			RTE_CACHE_LINE_SIZE);
+	padc_ue = sess_obj_zalloc(SESS_OBJ_ADC_UE);
 	if (padc_ue == NULL) {
 		RTE_LOG(ERR, DP, "Failed to allocate memory for adc ue info");
 		return ;
 	}
 	copy_dp_adc_rules(&padc_ue->adc_info, adc_info);
+	ret = add_rg_idx(padc_ue->adc_info.rating_group, old->rg_idx_map);
+	/* no rating group CDR if the map is full */
+	padc_ue->rg_idx = (ret < 0) ? MAX_RATING_GRP : ret;
+	ue_rg_cdr_slot_alloc(old, ret);
 
 	RTE_LOG(DEBUG, DP, "ADC UE INFO ADD: ue_addr:"IPV4_ADDR ",",
 					IPV4_ADDR_HOST_FORMAT(key.ue_ipv4));
 	RTE_LOG(DEBUG, DP, "adc_id:%u\n",
 					old->adc_rule_id[idx]);
-	ret = rte_hash_add_key_data(rte_adc_ue_hash,
+	ret = rte_hash_add_key_data(ADC_UE_HASH(ue_shard(key.ue_ipv4)),
 					&key, padc_ue);
 	if (ret < 0)
 			rte_panic("Failed to add entry in hash table");
+	ue_pool_table_add(&adc_ue_pool_table, &key, padc_ue);
 
 #ifdef SDF_MTR
 	mtr_cfg_entry(padc_ue->adc_info.mtr_profile_index, &padc_ue->mtr_obj);
@@ -618,28 +1467,30 @@ del_adc_entry_key_with_idx(struct ue_session_info *data, uint32_t idx)
 	key.ue_ipv4 = data->ue_addr.u.ipv4_addr;
 	key.rid = data->adc_rule_id[idx];
 
-	if (key.rid == 0)
+	if (key.rid == 0 || UE_ADDR_IS_IPV6(&data->ue_addr))
 		return;
 
 	RTE_LOG(DEBUG, DP, "ADC UE DEL:key: adc_id: %d, ue_addr:"IPV4_ADDR ",",
 		key.rid, IPV4_ADDR_HOST_FORMAT(key.ue_ipv4));
 
 	/* Get per ADC per UE info structure */
-	ret = iface_lookup_adc_ue_data(&key, (void **)&padc_ue);
+	ret = rte_hash_lookup_data(ADC_UE_HASH(ue_shard(key.ue_ipv4)), &key,
+			(void **)&padc_ue);
 	if (ret < 0) {
 	RTE_LOG(DEBUG, DP, "ADC UE DEL Fail !!:key: adc_id: %d, ue_addr:"IPV4_ADDR ",",
 		key.rid, IPV4_ADDR_HOST_FORMAT(key.ue_ipv4));
 		return ;
 	}
 
-	ret = rte_hash_del_key(rte_adc_ue_hash,
+	ue_pool_table_del(&adc_ue_pool_table, &key);
+	ret = rte_hash_del_key(ADC_UE_HASH(ue_shard(key.ue_ipv4)),
 			&key);
 
 	if (ret < 0)
 		rte_panic("Failed to del entry from hash table");
 
-	/* free the memory*/
-	rte_free(padc_ue);
+	/* free the memory once workers are done with it */
+	sess_obj_free(SESS_OBJ_ADC_UE, padc_ue);
 }
 
 /**
@@ -702,26 +1553,75 @@ void print_adc_hash(void)
 
 int
 adc_dns_entry_add(struct msg_adc *data)
+{
+	return adc_dns_entry_add_bulk(data, 1);
+}
+
+int
+adc_dns_entry_add_bulk(const struct msg_adc *data, uint32_t n)
 {
 	struct msg_adc *adc;
-	uint32_t key32 = 0;
-	int32_t ret;
-	adc = rte_malloc("data", sizeof(struct msg_adc),
-			RTE_CACHE_LINE_SIZE);
-	if (adc == NULL){
-		RTE_LOG(ERR, DP, "Failed to allocate memory");
-		return -1;
-	}
-	*adc = *data;
+	uint32_t key32;
+	uint32_t i, added = 0;
+	int32_t ret = 0;
+#ifdef ADC_DNS_AGING
+	struct adc_dns_entry *e;
+	uint32_t expire;
+#endif
 
-	key32 = adc->ipv4;
-	ret = rte_hash_add_key_data(rte_adc_hash, &key32,
-			adc);
-	if (ret < 0){
-		RTE_LOG(ERR, DP, "Failed to add entry in hash table");
-		return -1;
+	rte_spinlock_lock(&adc_dns_lock);
+	for (i = 0; i < n; i++) {
+		key32 = data[i].ipv4;
+		if (rte_hash_lookup_data(rte_adc_hash, &key32,
+					(void **)&adc) >= 0) {
+			/* repeated DNS responses resolve to known IPs */
+			if (adc->rule_id != data[i].rule_id) {
+				adc->rule_id = data[i].rule_id;
+				added++;
+			}
+#ifdef ADC_DNS_AGING
+			/* stays in its slot until the wheel reaches it */
+			e = (struct adc_dns_entry *)adc;
+			expire = adc_dns_expire(data[i].ttl);
+			if ((int32_t)(expire - e->expire) > 0)
+				e->expire = expire;
+#endif
+			continue;
+		}
+
+#ifdef ADC_DNS_AGING
+		e = rte_malloc("data", sizeof(struct adc_dns_entry),
+				RTE_CACHE_LINE_SIZE);
+		adc = (struct msg_adc *)e;
+#else
+		adc = rte_malloc("data", sizeof(struct msg_adc),
+				RTE_CACHE_LINE_SIZE);
+#endif
+		if (adc == NULL) {
+			RTE_LOG(ERR, DP, "Failed to allocate memory");
+			ret = -1;
+			break;
+		}
+		*adc = data[i];
+		if (rte_hash_add_key_data(rte_adc_hash, &key32, adc) < 0) {
+			RTE_LOG(ERR, DP, "Failed to add entry in hash table");
+			rte_free(adc);
+			ret = -1;
+			break;
+		}
+#ifdef ADC_DNS_AGING
+		e->expire = adc_dns_expire(data[i].ttl);
+		LIST_INSERT_HEAD(&adc_dns_wheel[e->expire & ADC_DNS_WHEEL_MASK],
+				e, next);
+#endif
+		added++;
 	}
-	return 0;
+	rte_spinlock_unlock(&adc_dns_lock);
+#ifdef FLOW_CACHE
+	if (added)
+		flow_cache_invalidate();
+#endif /* FLOW_CACHE */
+	return ret;
 }
 
 int adc_dns_entry_delete(struct msg_adc *data)
@@ -730,23 +1630,208 @@ int adc_dns_entry_delete(struct msg_adc *data)
 	uint32_t key32 = 0;
 	int32_t ret;
 	key32 = data->ipv4;
+	rte_spinlock_lock(&adc_dns_lock);
 	ret = rte_hash_lookup_data(rte_adc_hash, &key32,
 			(void **)&adc);
 	if (ret < 0) {
+		rte_spinlock_unlock(&adc_dns_lock);
 		RTE_LOG(ERR, DP, "Failed to del\n"
 				"adc key 0x%x to hash table\n",
 				data->ipv4);
 		return -1;
 	}
 	ret = rte_hash_del_key(rte_adc_hash, &key32);
+#ifdef ADC_DNS_AGING
+	if (ret >= 0)
+		LIST_REMOVE((struct adc_dns_entry *)adc, next);
+#endif
+	rte_spinlock_unlock(&adc_dns_lock);
 	if (ret < 0){
 		RTE_LOG(ERR, DP, "Failed to del entry in hash table");
 		return -1;
 	}
-	rte_free(adc);
+#ifdef FLOW_CACHE
+	flow_cache_invalidate();
+#endif /* FLOW_CACHE */
+	dp_defer_free(adc);
+	return 0;
+}
+
+#ifdef ADC_DNS_AGING
+void
+adc_dns_age_poll(unsigned budget)
+{
+	struct adc_dns_entry *e, *next;
+	uint32_t now, slot, key32;
+	uint32_t removed = 0;
+
+	if (!rte_spinlock_trylock(&adc_dns_lock))
+		return;
+
+	now = adc_dns_now();
+	if (unlikely(adc_dns_wheel_tick == 0))
+		adc_dns_wheel_tick = now;
+
+	while ((int32_t)(now - adc_dns_wheel_tick) >= 0 && budget) {
+		slot = adc_dns_wheel_tick & ADC_DNS_WHEEL_MASK;
+		for (e = LIST_FIRST(&adc_dns_wheel[slot]); e != NULL && budget;
+				e = next, budget--) {
+			next = LIST_NEXT(e, next);
+			if ((int32_t)(e->expire - now) > 0) {
+				/* refreshed since it was put in this slot */
+				if ((e->expire & ADC_DNS_WHEEL_MASK) != slot) {
+					LIST_REMOVE(e, next);
+					LIST_INSERT_HEAD(&adc_dns_wheel[e->expire
+							& ADC_DNS_WHEEL_MASK], e, next);
+				}
+				continue;
+			}
+			key32 = e->adc.ipv4;
+			LIST_REMOVE(e, next);
+			rte_hash_del_key(rte_adc_hash, &key32);
+			dp_defer_free(e);
+			removed++;
+		}
+		/* resume the slot on the next call if the budget ran out */
+		if (e != NULL)
+			break;
+		adc_dns_wheel_tick++;
+	}
+	rte_spinlock_unlock(&adc_dns_lock);
+
+#ifdef FLOW_CACHE
+	if (removed)
+		flow_cache_invalidate();
+#endif /* FLOW_CACHE */
+	if (removed)
+		RTE_LOG(DEBUG, DP, "ADC dns: %u entries aged out\n", removed);
+}
+#endif	/* ADC_DNS_AGING */
+
+volatile uint32_t sess_fast_path_gen = 1;
+/** Set while bearers are left to re-evaluate for the changed rules */
+static int sess_fast_path_walk;
+static uint32_t sess_fast_path_iter;
+
+/**
+ * @brief Check that a PCC rule passes every pkt: open gate and one of
+ * its SDF rules a catch-all.
+ */
+static int
+pcc_is_open_catch_all(uint32_t pcc_id)
+{
+	struct dp_pcc_rules *pcc = NULL;
+	uint32_t i;
+
+	if ((iface_lookup_pcc_data(pcc_id, &pcc) < 0) || (pcc == NULL)
+			|| (pcc->gate_status != OPEN))
+		return 0;
+	for (i = 0; (i < pcc->sdf_idx_cnt) && (i < MAX_SDF_IDX_COUNT); i++)
+		/* SDF rule ids are shifted by 1, see filter_pcc_entry_add() */
+		if (dp_sdf_rule_is_catch_all(pcc->sdf_idx[i] + 1))
+			return 1;
 	return 0;
 }
 
+/**
+ * @brief Flag the bearer for the default bearer fast path: the only
+ * bearer of its UE, no ADC rule and a single PCC rule per direction
+ * that is an open catch-all, so that gating could not drop a pkt.
+ */
+static void
+update_sess_fast_path(struct dp_session_info *data)
+{
+	struct ue_session_info *ue = data->ue_info_ptr;
+	int fast_path;
+
+	fast_path = (ue != NULL) && (ue->bearer_count == 1)
+			&& (ue->num_adc_rules == 0)
+			&& (data->num_ul_pcc_rules == 1)
+			&& (data->num_dl_pcc_rules == 1)
+			&& pcc_is_open_catch_all(data->ul_pcc_rule_id[0])
+			&& pcc_is_open_catch_all(data->dl_pcc_rule_id[0]);
+	data->fast_path = fast_path ? sess_fast_path_gen : 0;
+}
+
+void
+sess_fast_path_rules_changed(void)
+{
+	/* workers stop taking the fast path of every bearer at once */
+	if (++sess_fast_path_gen == 0)
+		sess_fast_path_gen = 1;
+	sess_fast_path_iter = 0;
+	sess_fast_path_walk = 1;
+}
+
+void
+sess_fast_path_poll(unsigned budget)
+{
+	const void *next_key;
+	void *next_data;
+
+	while (sess_fast_path_walk && budget--) {
+		if (rte_hash_iterate(rte_sess_hash, &next_key, &next_data,
+				&sess_fast_path_iter) < 0) {
+			sess_fast_path_walk = 0;
+			break;
+		}
+		update_sess_fast_path(next_data);
+	}
+}
+
+#ifdef LB_LOAD_SHEDDING
+/**
+ * Check if QCI is signalling or GBR.
+ */
+static inline int
+is_qci_protected(uint8_t qci)
+{
+	return ((qci >= 1) && (qci <= 5)) || ((qci >= 65) && (qci <= 67))
+			|| (qci == 69) || (qci == 75);
+}
+
+/**
+ * Count bearer in the load shedding class of its UE if one of its PCC
+ * rules is signalling or GBR.
+ *
+ * @param data
+ *	bearer session.
+ * @param del
+ *	bearer is being deleted.
+ *
+ * @return
+ *	None
+ */
+static void
+update_sess_shed_class(struct dp_session_info *data, int del)
+{
+	struct dp_pcc_rules *pcc_info;
+	uint8_t prot = 0;
+	uint32_t i, hash, ue_ip;
+
+	for (i = 0; !del && !prot && (i < data->num_ul_pcc_rules); i++)
+		if ((iface_lookup_pcc_data(data->ul_pcc_rule_id[i],
+				&pcc_info) >= 0) && (pcc_info != NULL))
+			prot = is_qci_protected(pcc_info->qos.qci);
+	for (i = 0; !del && !prot && (i < data->num_dl_pcc_rules); i++)
+		if ((iface_lookup_pcc_data(data->dl_pcc_rule_id[i],
+				&pcc_info) >= 0) && (pcc_info != NULL))
+			prot = is_qci_protected(pcc_info->qos.qci);
+
+	if (prot == data->shed_protected)
+		return;
+
+	/* same hash as the rx pipelines, UE ip in packet byte order */
+	ue_ip = ue_addr_lb_ip(&data->ue_addr);
+	set_ue_ipv4_hash(&hash, &ue_ip);
+	if (prot)
+		epc_ue_protected[hash & (EPC_UE_CLASS_SIZE - 1)]++;
+	else
+		epc_ue_protected[hash & (EPC_UE_CLASS_SIZE - 1)]--;
+	data->shed_protected = prot;
+}
+#endif	/* LB_LOAD_SHEDDING */
+
 /******************** Session functions **********************/
 /**
  * @brief Function to return session info entry address.
@@ -780,18 +1865,21 @@ get_session_data(uint64_t sess_id, uint32_t is_mod)
 		return NULL;
 
 	/* allocate memory for session info*/
-	data = rte_zmalloc("data", sizeof(struct dp_session_info),
-			RTE_CACHE_LINE_SIZE);
+	data = sess_obj_zalloc(SESS_OBJ_BEARER);
 	if (data == NULL){
 		RTE_LOG(ERR, DP, "Failed to allocate memory for session info");
 		return NULL;
 	}
+	/* no tunnel yet, teid 0 */
+	data->dl_encap = &data->dl_encap_buf[0];
+	/* the spare template was never published */
+	data->dl_encap_epoch = dp_qsbr_epoch() - 2;
 
 	/* add entry*/
 	ret = rte_hash_add_key_data(rte_sess_hash, &sess_id, data);
 	if (ret < 0){
 		RTE_LOG(ERR, DP, "Failed to add entry in hash table");
-		rte_free(data);
+		sess_obj_free(SESS_OBJ_BEARER, data);
 		return NULL;
 	}
 
@@ -809,6 +1897,13 @@ dp_session_table_create(struct dp_id dp_id, uint32_t max_elements)
 	}
 	rc = hash_create(dp_id.name, &rte_sess_hash, max_elements * 4,
 			sizeof(uint64_t));
+#ifdef SESS_MEMPOOL
+#ifdef SESS_POOL_ENTRIES
+	sess_obj_pools_init(SESS_POOL_ENTRIES);
+#else
+	sess_obj_pools_init(max_elements);
+#endif
+#endif
 	return rc;
 }
 
@@ -840,6 +1935,84 @@ copy_session_info(struct dp_session_info *dst,
 	dst->service_id = src->service_id;
 }
 
+/**
+ * Build the downlink encap header template in the spare buffer of the
+ * bearer and switch the workers to it in a single pointer store, so that
+ * they never see the teid of one tunnel with the address of another. The
+ * previous template is only overwritten by the next modify.
+ *
+ * @param data
+ *	dp bearer session.
+ * @param src_ip
+ *	outer source ip, network byte order.
+ * @param dst_ip
+ *	tunnel peer ip, host byte order.
+ * @param teid
+ *	tunnel peer teid.
+ *
+ * @return
+ * Void
+ */
+static void
+publish_dl_encap(struct dp_session_info *data, uint32_t src_ip,
+		uint32_t dst_ip, uint32_t teid)
+{
+	struct dl_encap_tmpl *next = &data->dl_encap_buf[
+			data->dl_encap == &data->dl_encap_buf[0]];
+
+	/* workers may still encap with the spare, in use before the last
+	 * switch, until a grace period started after it */
+	while ((int32_t)(dp_qsbr_epoch() - data->dl_encap_epoch) < 2)
+		rte_pause();
+
+	gtpu_encap_tmpl_build(next, src_ip, dst_ip, teid);
+	rte_smp_wmb();
+	data->dl_encap = next;
+	data->dl_encap_epoch = dp_qsbr_epoch();
+}
+
+/**
+ * Update the per packet fields of a bearer from its UL and DL info:
+ * downlink encap header template and tunnel peer copies.
+ *
+ * @param data
+ *	dp bearer session.
+ *
+ * @return
+ * Void
+ */
+static void
+update_fwd_info(struct dp_session_info *data)
+{
+	data->enb_teid = data->dl_s1_info.enb_teid;
+	data->enb_ipv4 = data->dl_s1_info.enb_addr.u.ipv4_addr;
+	data->s5s8_pgwu_ipv4 = data->ul_s1_info.s5s8_pgwu_addr.u.ipv4_addr;
+	data->s5s8_sgwu_ipv4 = data->dl_s1_info.s5s8_sgwu_addr.u.ipv4_addr;
+
+	switch (app.spgw_cfg) {
+	case SPGWU:
+		publish_dl_encap(data, app.s1u_ip,
+				data->dl_s1_info.enb_addr.u.ipv4_addr,
+				data->dl_s1_info.enb_teid);
+		break;
+
+	case PGWU:
+		publish_dl_encap(data, app.s5s8_pgwu_ip,
+				data->dl_s1_info.s5s8_sgwu_addr.u.ipv4_addr,
+				data->dl_s1_info.enb_teid);
+		break;
+
+	default:
+		/* SGWU rewrites the received GTP-U headers, no template */
+		break;
+	}
+}
+
+#ifdef APN_MTR_SHARDED
+/** Last apn_mtr_gen given to a UE context */
+static uint32_t apn_mtr_gen;
+#endif	/* APN_MTR_SHARDED */
+
 int
 dp_session_create(struct dp_id dp_id,
 		struct session_info *entry)
@@ -879,6 +2052,7 @@ dp_session_create(struct dp_id dp_id,
 	}
 
 	copy_session_info(data, entry);
+	update_fwd_info(data);
 
 	data->num_ul_pcc_rules = 0;
 	data->num_dl_pcc_rules = 0;
@@ -897,12 +2071,11 @@ dp_session_create(struct dp_id dp_id,
 			RTE_LOG(ERR, DP, "BEAR_SESS ADD Fail: Default bearer not found for sess_id:%u, bear_id:%u\n",
 						ue_sess_id, bear_id);
 			rte_hash_del_key(rte_sess_hash, &entry->sess_id);
-			free(data);
+			sess_obj_free(SESS_OBJ_BEARER, data);
 			return 0;
 		}
 		/* add UE data*/
-		ue_data = rte_zmalloc("ue sess info", sizeof(struct ue_session_info),
-				RTE_CACHE_LINE_SIZE);
+		ue_data = sess_obj_zalloc(SESS_OBJ_UE);
 		if (ue_data == NULL)
 			rte_panic("Failed to alloc mem for ue session");
 		ret = rte_hash_add_key_data(rte_ue_hash, &ue_sess_id, ue_data);
@@ -916,6 +2089,10 @@ dp_session_create(struct dp_id dp_id,
 		ue_data->dl_apn_mtr_idx = entry->dl_apn_mtr_idx;
 		ue_data->bearer_count = 1;
 
+#ifdef APN_MTR_SHARDED
+		rte_spinlock_init(&ue_data->apn_mtr_lock);
+		ue_data->apn_mtr_gen = ++apn_mtr_gen;
+#endif	/* APN_MTR_SHARDED */
 #ifdef APN_MTR
 		mtr_cfg_entry(ue_data->ul_apn_mtr_idx,
 				&ue_data->ul_apn_mtr_obj);
@@ -932,15 +2109,26 @@ dp_session_create(struct dp_id dp_id,
 				(uint64_t)&ue_data->dl_apn_mtr_obj);
 #endif	/* APN_MTR */
 	} else {
+		struct dp_session_info *def_data;
+
 		/* update UE data*/
 		ue_data->bearer_count += 1;
 		RTE_LOG(DEBUG, DP, "BEAR_SESS ADD:bear_id:%u, bear_count:%u,\n",
 				bear_id, ue_data->bearer_count);
+
+		/* default bearer is no more the only bearer */
+		def_data = get_session_data(SESS_ID(ue_sess_id, DEFAULT_BEARER),
+				SESS_MODIFY);
+		if (def_data != NULL)
+			update_sess_fast_path(def_data);
 	}
 
 	/* Update UE session info ptr */
 	data->ue_info_ptr = ue_data;
 	data->sess_state = IN_PROGRESS;
+#ifdef SESS_AGING
+	data->last_active = sess_age_now;
+#endif	/* SESS_AGING */
 	/* Update adc rules */
 	if (entry->num_adc_rules) {
 		struct ue_session_info new_ue_data;
@@ -952,14 +2140,52 @@ dp_session_create(struct dp_id dp_id,
 	}
 	/* Update PCC rules addr*/
 	update_pcc_rules(data, &new);
+	update_sess_fast_path(data);
+#ifdef PKT_MIRROR
+	data->mirror_cp = entry->mirror;
+	mirror_sess_update(data);
+#endif	/* PKT_MIRROR */
+#ifdef LB_LOAD_SHEDDING
+	update_sess_shed_class(data, 0);
+#endif	/* LB_LOAD_SHEDDING */
 
 
 	data->client_id = entry->client_id;
 	new.client_id = entry->client_id;
+#ifdef WARM_RESTART
+	sess_store_sess_add(entry, &data->store_slot);
+#endif	/* WARM_RESTART */
 
 	return 0;
 }
 
+/**
+ * @brief Check if the PCC and ADC rules of a session modify are those the
+ * bearer has already, as on handover where only the eNB F-TEID changes.
+ * A modify without ADC rules leaves those of the UE as they are.
+ */
+static int
+sess_rules_unchanged(const struct dp_session_info *data,
+		const struct session_info *entry)
+{
+	const struct ue_session_info *ue = data->ue_info_ptr;
+
+	if ((entry->num_ul_pcc_rules != data->num_ul_pcc_rules) ||
+			(entry->num_dl_pcc_rules != data->num_dl_pcc_rules))
+		return 0;
+	if (memcmp(entry->ul_pcc_rule_id, data->ul_pcc_rule_id,
+			entry->num_ul_pcc_rules * sizeof(uint32_t)) ||
+			memcmp(entry->dl_pcc_rule_id, data->dl_pcc_rule_id,
+			entry->num_dl_pcc_rules * sizeof(uint32_t)))
+		return 0;
+
+	if (entry->num_adc_rules == 0)
+		return 1;
+	return (ue != NULL) && (entry->num_adc_rules == ue->num_adc_rules) &&
+			!memcmp(entry->adc_rule_id, ue->adc_rule_id,
+			entry->num_adc_rules * sizeof(uint32_t));
+}
+
 int
 dp_session_modify(struct dp_id dp_id,
 		struct session_info *entry)
@@ -998,24 +2224,39 @@ dp_session_modify(struct dp_id dp_id,
 	}
 
 
-	copy_session_info(&mod_data, entry);
-	/* Update adc rules */
-	if (entry->num_adc_rules) {
-		struct ue_session_info new_ue_data;
-		new_ue_data.num_adc_rules = entry->num_adc_rules;
-		for (i = 0; i < new_ue_data.num_adc_rules; i++)
-			new_ue_data.adc_rule_id[i] = entry->adc_rule_id[i];
-		/* Update ADC rules addr*/
-		update_adc_rules(data->ue_info_ptr, &new_ue_data);
-	}
+	/* Handover only moves the DL tunnel, leave the rules alone */
+	if (!sess_rules_unchanged(data, entry)) {
+		copy_session_info(&mod_data, entry);
+		/* Update adc rules */
+		if (entry->num_adc_rules) {
+			struct ue_session_info new_ue_data;
+			new_ue_data.num_adc_rules = entry->num_adc_rules;
+			for (i = 0; i < new_ue_data.num_adc_rules; i++)
+				new_ue_data.adc_rule_id[i] =
+					entry->adc_rule_id[i];
+			/* Update ADC rules addr*/
+			update_adc_rules(data->ue_info_ptr, &new_ue_data);
+		}
 
-	/* Update PCC rules addr*/
-	update_pcc_rules(data, &mod_data);
+		/* Update PCC rules addr*/
+		update_pcc_rules(data, &mod_data);
+#ifdef LB_LOAD_SHEDDING
+		update_sess_shed_class(data, 0);
+#endif	/* LB_LOAD_SHEDDING */
+	}
+	update_sess_fast_path(data);
 
 	/* Copy dl information */
 	struct dl_s1_info *dl_info;
 	dl_info = &data->dl_s1_info;
-	*dl_info = mod_data.dl_s1_info;
+	if (memcmp(dl_info, &entry->dl_s1_info, sizeof(*dl_info))) {
+		*dl_info = entry->dl_s1_info;
+		update_fwd_info(data);
+#ifdef PKT_MIRROR
+		/* selectors may match the new eNB teid */
+		mirror_sess_update(data);
+#endif	/* PKT_MIRROR */
+	}
 
 	if (!dl_info->enb_teid) {
 		if (data->sess_state == CONNECTED)
@@ -1030,15 +2271,13 @@ dp_session_modify(struct dp_id dp_id,
 			{
 			struct ue_session_info *ue_data = NULL;
 			int ret;
-			uint32_t hash;
-			int wk_id;
+			uint32_t wk_id;
 			uint32_t ue_sess_id = UE_SESS_ID(entry->sess_id);
 
 			ret = rte_hash_lookup_data(rte_ue_hash, &ue_sess_id,
 					(void **)&ue_data);
-			hash = rte_hash_crc_4byte(ue_data->ue_addr.u.ipv4_addr,
-					PRIME_VALUE);
-			wk_id = hash % (epc_app.num_workers);
+			set_ue_worker_core_id(&wk_id,
+					&ue_data->ue_addr.u.ipv4_addr);
 			{
 				struct rte_mbuf *buf_pkt =
 					rte_ctrlmbuf_alloc(
@@ -1057,6 +2296,9 @@ dp_session_modify(struct dp_id dp_id,
 			RTE_LOG(DEBUG, DP, "No state change");
 		}
 	}
+#ifdef WARM_RESTART
+	sess_store_sess_modify(data->store_slot, entry, data->sess_state);
+#endif	/* WARM_RESTART */
 
 	return 0;
 }
@@ -1105,12 +2347,11 @@ flush_session_pcc_records(struct dp_session_info *session)
 		dl_key.rid = ul_dl_pcc_rules[i];
 		ul_key.rid = ul_dl_pcc_rules[i];
 
-		rte_hash_lookup_data(rte_downlink_hash, &dl_key,
-				(void **)&psdf);
+		dl_sess_lookup(&session->ue_addr, dl_key.rid, (void **)&psdf);
 
 		if (psdf == NULL)
-			rte_hash_lookup_data(rte_uplink_hash, &ul_key,
-					(void **)&psdf);
+			rte_hash_lookup_data(UL_HASH(sess_shard(session)),
+					&ul_key, (void **)&psdf);
 
 		if (psdf == NULL) {
 			RTE_LOG(ERR, DP, "CDR read error for session id 0x%"
@@ -1121,6 +2362,7 @@ flush_session_pcc_records(struct dp_session_info *session)
 			continue;
 		}
 
+		CDR_SYNC(&psdf->sdf_cdr, psdf->cdr_slot);
 		export_session_pcc_record(&psdf->pcc_info, &psdf->sdf_cdr, session);
 	}
 }
@@ -1150,14 +2392,17 @@ flush_session_adc_records(struct dp_session_info *session)
 			IPV4_ADDR_HOST_FORMAT(session->ue_addr.u.ipv4_addr));
 
 	key.ue_ipv4 = session->ue_addr.u.ipv4_addr;
-	for (i = 0; i < session->ue_info_ptr->num_adc_rules; i++) {
+	for (i = 0; !UE_ADDR_IS_IPV6(&session->ue_addr) &&
+			i < session->ue_info_ptr->num_adc_rules; i++) {
 		adc_id = session->ue_info_ptr->adc_rule_id[i];
 		m = 1;
 		adc_rule_info_get(&adc_id, 1, &m, (void **)&adc_info);
 
 		key.rid = adc_id;
-		if ((rte_hash_lookup_data(rte_adc_ue_hash, &key, (void **)&adc_ue_info)) < 0)
+		if ((rte_hash_lookup_data(ADC_UE_HASH(sess_shard(session)), &key,
+				(void **)&adc_ue_info)) < 0)
 			continue;
+		CDR_SYNC(&adc_ue_info->adc_cdr, adc_ue_info->cdr_slot);
 		export_session_adc_record(adc_info, &adc_ue_info->adc_cdr, session);
 	}
 }
@@ -1184,8 +2429,8 @@ flush_apn_records(struct dp_session_info *session)
 			IPV4_ADDR_HOST_FORMAT(session->ue_addr.u.ipv4_addr));
 	dl_key.ue_ipv4 = session->ue_addr.u.ipv4_addr;
 	dl_key.rid = session->dl_pcc_rule_id[0];
-	if ((rte_hash_lookup_data(rte_downlink_hash, &dl_key,
-			(void **)&psdf)) < 0)
+	if (dl_sess_lookup(&session->ue_addr, dl_key.rid,
+			(void **)&psdf) < 0)
 		return;
 	flush_apn_mtr(psdf);
 }
@@ -1202,6 +2447,7 @@ flush_apn_records(struct dp_session_info *session)
 static void
 export_bearer_cdr_record(struct dp_session_info *session)
 {
+	CDR_SYNC(&session->ipcan_dp_bearer_cdr, session->cdr_slot);
 	export_cdr_record(session, "BEARER",
 				UE_BEAR_ID(session->sess_id), &session->ipcan_dp_bearer_cdr);
 }
@@ -1224,15 +2470,18 @@ export_adc_cdr_record(struct dp_session_info *session)
 	struct dp_adc_ue_info *adc_ue_info = NULL;
 
 	key.ue_ipv4 = session->ue_addr.u.ipv4_addr;
-	for (i = 0; i < session->ue_info_ptr->num_adc_rules; i++) {
+	for (i = 0; !UE_ADDR_IS_IPV6(&session->ue_addr) &&
+			i < session->ue_info_ptr->num_adc_rules; i++) {
 		key.rid = session->ue_info_ptr->adc_rule_id[i];
-		if ((rte_hash_lookup_data(rte_adc_ue_hash, &key, (void **)&adc_ue_info)) < 0) {
+		if ((rte_hash_lookup_data(ADC_UE_HASH(sess_shard(session)), &key,
+				(void **)&adc_ue_info)) < 0) {
 			RTE_LOG(ERR, DP, "CDR read error for session id 0x%"PRIx64", ADC %d, "IPV4_ADDR"\n",
 			session->sess_id, key.rid,
 			IPV4_ADDR_HOST_FORMAT(session->ue_addr.u.ipv4_addr));
 			continue;
 		}
 
+		CDR_SYNC(&adc_ue_info->adc_cdr, adc_ue_info->cdr_slot);
 		export_cdr_record(session, "ADC", key.rid, &adc_ue_info->adc_cdr);
 	}
 }
@@ -1245,61 +2494,286 @@ export_adc_cdr_record(struct dp_session_info *session)
  * @return
  * Void
  */
-static void
-export_flow_cdr_record(struct dp_session_info *session)
+static void
+export_flow_cdr_record(struct dp_session_info *session)
+{
+	uint32_t i, j;
+	struct ul_bm_key ul_key;
+	struct dl_bm_key dl_key;
+	struct dp_sdf_per_bearer_info *psdf = NULL;
+
+	/* list of pcc rules for all all ul and dl */
+	uint32_t ul_dl_pcc_rules[MAX_PCC_RULES + MAX_PCC_RULES];
+	uint32_t num_ul_dl_pcc_rules = session->num_dl_pcc_rules;
+
+	/* add all dl pcc rules to list */
+	for (i = 0; i < session->num_dl_pcc_rules; ++i)
+		ul_dl_pcc_rules[i] = session->dl_pcc_rule_id[i];
+	/* add all ul pcc rules to list if not added previously */
+	for (i = 0; i < session->num_ul_pcc_rules; i++) {
+		for (j = 0; j < session->num_dl_pcc_rules; ++j) {
+			if (session->ul_pcc_rule_id[i] ==
+					session->dl_pcc_rule_id[j])
+				break;
+		}
+		if (j == session->num_dl_pcc_rules) {
+			ul_dl_pcc_rules[num_ul_dl_pcc_rules] =
+					session->ul_pcc_rule_id[i];
+			++num_ul_dl_pcc_rules;
+		}
+	}
+
+	dl_key.ue_ipv4 = session->ue_addr.u.ipv4_addr;
+	ul_key.s1u_sgw_teid = session->ul_s1_info.sgw_teid;
+	for (i = 0; i < num_ul_dl_pcc_rules; ++i) {
+		dl_key.rid = ul_dl_pcc_rules[i];
+		ul_key.rid = ul_dl_pcc_rules[i];
+
+		dl_sess_lookup(&session->ue_addr, dl_key.rid, (void **)&psdf);
+
+		if (psdf == NULL)
+			rte_hash_lookup_data(UL_HASH(sess_shard(session)),
+					&ul_key, (void **)&psdf);
+
+		if (psdf == NULL) {
+			RTE_LOG(ERR, DP, "CDR read error for session id 0x%"
+					PRIx64", PCC %d, "IPV4_ADDR"\n",
+					session->sess_id, dl_key.rid,
+					IPV4_ADDR_HOST_FORMAT(
+						session->ue_addr.u.ipv4_addr));
+			continue;
+		}
+
+		CDR_SYNC(&psdf->sdf_cdr, psdf->cdr_slot);
+		export_cdr_record(session, "PCC", ul_dl_pcc_rules[i],
+				&psdf->sdf_cdr);
+	}
+}
+
+/**
+ * Export all CDRs of the bearer session.
+ * @param data
+ *	dp bearer session.
+ *
+ * @return
+ * Void
+ */
+static void
+export_session_cdrs(struct dp_session_info *data)
+{
+#ifdef ADC_UPFRONT
+	flush_session_adc_records(data);
+#endif
+	flush_session_pcc_records(data);
+#ifdef APN_MTR
+	flush_apn_records(data);
+#endif /* APN_MTR*/
+
+	/*added for debugging*/
+	export_bearer_cdr_record(data);
+	export_adc_cdr_record(data);
+	export_flow_cdr_record(data);
+}
+
+#ifdef DEFERRED_SESS_CDR
+/**
+ * CDR counters of a PCC rule of a deleted bearer.
+ */
+struct sess_cdr_snap_pcc {
+	uint32_t rid;
+	struct dp_pcc_rules pcc_info;
+	struct ipcan_dp_bearer_cdr sdf_cdr;
+};
+
+/**
+ * CDR counters of an ADC rule of a deleted bearer.
+ */
+struct sess_cdr_snap_adc {
+	uint32_t rid;
+	uint8_t has_rule;		/** adc_info is valid */
+	struct adc_rules adc_info;
+	struct ipcan_dp_bearer_cdr adc_cdr;
+};
+
+/**
+ * Counters of a deleted bearer, exported after the delete returns.
+ */
+struct sess_cdr_snap {
+	TAILQ_ENTRY(sess_cdr_snap) next;
+	struct dp_session_info sess;	/** copy, ue_info_ptr is NULL */
+#ifdef APN_MTR
+	uint8_t has_apn;
+	uint32_t ul_apn_mtr_idx;
+	uint32_t dl_apn_mtr_idx;
+	uint64_t ul_apn_mtr_drops;
+	uint64_t dl_apn_mtr_drops;
+#endif /* APN_MTR */
+	uint32_t num_pcc;
+	uint32_t num_adc;
+	struct sess_cdr_snap_pcc pcc[MAX_PCC_RULES + MAX_PCC_RULES];
+	struct sess_cdr_snap_adc adc[MAX_ADC_RULES];
+};
+
+static TAILQ_HEAD(, sess_cdr_snap) sess_cdr_snaps =
+		TAILQ_HEAD_INITIALIZER(sess_cdr_snaps);
+
+/**
+ * Copy the CDR counters of the bearer session, the same ones
+ * export_session_cdrs() reads.
+ *
+ * @return
+ *	snapshot, NULL if out of memory.
+ */
+static struct sess_cdr_snap *
+sess_cdr_snap_take(struct dp_session_info *session)
 {
-	uint32_t i, j;
+	struct sess_cdr_snap *snap;
+	struct sess_cdr_snap_pcc *pcc;
+	struct sess_cdr_snap_adc *adc;
 	struct ul_bm_key ul_key;
 	struct dl_bm_key dl_key;
-	struct dp_sdf_per_bearer_info *psdf = NULL;
+	struct dp_sdf_per_bearer_info *psdf;
+	struct dp_adc_ue_info *adc_ue_info;
+	uint32_t i, j;
 
-	/* list of pcc rules for all all ul and dl */
-	uint32_t ul_dl_pcc_rules[MAX_PCC_RULES + MAX_PCC_RULES];
-	uint32_t num_ul_dl_pcc_rules = session->num_dl_pcc_rules;
+	snap = rte_malloc("sess_cdr_snap", sizeof(*snap), 0);
+	if (snap == NULL)
+		return NULL;
 
-	/* add all dl pcc rules to list */
+	CDR_SYNC(&session->ipcan_dp_bearer_cdr, session->cdr_slot);
+	snap->sess = *session;
+	snap->sess.ue_info_ptr = NULL;
+
+	/* ul and dl pcc rules, each once */
+	snap->num_pcc = 0;
 	for (i = 0; i < session->num_dl_pcc_rules; ++i)
-		ul_dl_pcc_rules[i] = session->dl_pcc_rule_id[i];
-	/* add all ul pcc rules to list if not added previously */
+		snap->pcc[snap->num_pcc++].rid = session->dl_pcc_rule_id[i];
 	for (i = 0; i < session->num_ul_pcc_rules; i++) {
-		for (j = 0; j < session->num_dl_pcc_rules; ++j) {
+		for (j = 0; j < session->num_dl_pcc_rules; ++j)
 			if (session->ul_pcc_rule_id[i] ==
 					session->dl_pcc_rule_id[j])
 				break;
-		}
-		if (j == session->num_dl_pcc_rules) {
-			ul_dl_pcc_rules[num_ul_dl_pcc_rules] =
+		if (j == session->num_dl_pcc_rules)
+			snap->pcc[snap->num_pcc++].rid =
 					session->ul_pcc_rule_id[i];
-			++num_ul_dl_pcc_rules;
-		}
 	}
 
 	dl_key.ue_ipv4 = session->ue_addr.u.ipv4_addr;
 	ul_key.s1u_sgw_teid = session->ul_s1_info.sgw_teid;
-	for (i = 0; i < num_ul_dl_pcc_rules; ++i) {
-		dl_key.rid = ul_dl_pcc_rules[i];
-		ul_key.rid = ul_dl_pcc_rules[i];
-
-		rte_hash_lookup_data(rte_downlink_hash, &dl_key,
-				(void **)&psdf);
-
+	for (i = 0, j = 0; i < snap->num_pcc; ++i) {
+		pcc = &snap->pcc[i];
+		dl_key.rid = pcc->rid;
+		ul_key.rid = pcc->rid;
+		psdf = NULL;
+		dl_sess_lookup(&session->ue_addr, dl_key.rid, (void **)&psdf);
 		if (psdf == NULL)
-			rte_hash_lookup_data(rte_uplink_hash, &ul_key,
-					(void **)&psdf);
-
+			rte_hash_lookup_data(UL_HASH(sess_shard(session)),
+					&ul_key, (void **)&psdf);
 		if (psdf == NULL) {
 			RTE_LOG(ERR, DP, "CDR read error for session id 0x%"
 					PRIx64", PCC %d, "IPV4_ADDR"\n",
-					session->sess_id, dl_key.rid,
+					session->sess_id, pcc->rid,
+					IPV4_ADDR_HOST_FORMAT(
+						session->ue_addr.u.ipv4_addr));
+			continue;
+		}
+		CDR_SYNC(&psdf->sdf_cdr, psdf->cdr_slot);
+		snap->pcc[j].rid = pcc->rid;
+		snap->pcc[j].pcc_info = psdf->pcc_info;
+		snap->pcc[j].sdf_cdr = psdf->sdf_cdr;
+		++j;
+	}
+	snap->num_pcc = j;
+
+	snap->num_adc = 0;
+	for (i = 0; !UE_ADDR_IS_IPV6(&session->ue_addr) &&
+			i < session->ue_info_ptr->num_adc_rules; i++) {
+		struct adc_rules *adc_info = NULL;
+		uint64_t m = 1;
+
+		adc = &snap->adc[snap->num_adc];
+		adc->rid = session->ue_info_ptr->adc_rule_id[i];
+		dl_key.rid = adc->rid;
+		if ((rte_hash_lookup_data(ADC_UE_HASH(sess_shard(session)),
+				&dl_key, (void **)&adc_ue_info)) < 0) {
+			RTE_LOG(ERR, DP, "CDR read error for session id 0x%"
+					PRIx64", ADC %d, "IPV4_ADDR"\n",
+					session->sess_id, adc->rid,
 					IPV4_ADDR_HOST_FORMAT(
 						session->ue_addr.u.ipv4_addr));
 			continue;
 		}
+		CDR_SYNC(&adc_ue_info->adc_cdr, adc_ue_info->cdr_slot);
+		adc->adc_cdr = adc_ue_info->adc_cdr;
+		adc_rule_info_get(&adc->rid, 1, &m, (void **)&adc_info);
+		adc->has_rule = (adc_info != NULL);
+		if (adc_info != NULL)
+			adc->adc_info = *adc_info;
+		++snap->num_adc;
+	}
 
-		export_cdr_record(session, "PCC", ul_dl_pcc_rules[i],
-				&psdf->sdf_cdr);
+#ifdef APN_MTR
+	dl_key.rid = session->dl_pcc_rule_id[0];
+	snap->has_apn = (dl_sess_lookup(&session->ue_addr, dl_key.rid,
+			(void **)&psdf) >= 0);
+	snap->ul_apn_mtr_idx = session->ue_info_ptr->ul_apn_mtr_idx;
+	snap->dl_apn_mtr_idx = session->ue_info_ptr->dl_apn_mtr_idx;
+	snap->ul_apn_mtr_drops = session->ue_info_ptr->ul_apn_mtr_drops;
+	snap->dl_apn_mtr_drops = session->ue_info_ptr->dl_apn_mtr_drops;
+#endif /* APN_MTR */
+	return snap;
+}
+
+/**
+ * Export the CDRs of a snapshot in the order of export_session_cdrs().
+ */
+static void
+sess_cdr_snap_export(struct sess_cdr_snap *snap)
+{
+	struct dp_session_info *session = &snap->sess;
+	uint32_t i;
+
+#ifdef ADC_UPFRONT
+	for (i = 0; i < snap->num_adc; i++)
+		if (snap->adc[i].has_rule)
+			export_session_adc_record(&snap->adc[i].adc_info,
+					&snap->adc[i].adc_cdr, session);
+#endif
+	for (i = 0; i < snap->num_pcc; i++)
+		export_session_pcc_record(&snap->pcc[i].pcc_info,
+				&snap->pcc[i].sdf_cdr, session);
+#ifdef APN_MTR
+	if (snap->has_apn) {
+		export_mtr(session, "UL-APN", snap->ul_apn_mtr_idx,
+				snap->ul_apn_mtr_drops);
+		export_mtr(session, "DL-APN", snap->dl_apn_mtr_idx,
+				snap->dl_apn_mtr_drops);
+	}
+#endif /* APN_MTR */
+
+	export_cdr_record(session, "BEARER",
+			UE_BEAR_ID(session->sess_id),
+			&session->ipcan_dp_bearer_cdr);
+	for (i = 0; i < snap->num_adc; i++)
+		export_cdr_record(session, "ADC", snap->adc[i].rid,
+				&snap->adc[i].adc_cdr);
+	for (i = 0; i < snap->num_pcc; i++)
+		export_cdr_record(session, "PCC", snap->pcc[i].rid,
+				&snap->pcc[i].sdf_cdr);
+}
+
+void
+sess_cdr_snap_drain(unsigned budget)
+{
+	struct sess_cdr_snap *snap;
+
+	while (budget-- && (snap = TAILQ_FIRST(&sess_cdr_snaps)) != NULL) {
+		TAILQ_REMOVE(&sess_cdr_snaps, snap, next);
+		sess_cdr_snap_export(snap);
+		rte_free(snap);
 	}
 }
+#endif /* DEFERRED_SESS_CDR */
 
 int
 dp_session_delete(struct dp_id dp_id,
@@ -1313,11 +2787,13 @@ dp_session_delete(struct dp_id dp_id,
 		printf("Session id 0x%"PRIx64" not found\n", entry->sess_id);
 		return -1;
 	}
+#ifdef DDN_BUF_POOL
+	ddn_buf_close(data);
+#else
 	if (data->dl_ring != NULL) {
 		uint32_t worker_core_id;
-		uint32_t ue_ipv4_hash;
-		set_ue_ipv4_hash(&ue_ipv4_hash, &data->ue_addr.u.ipv4_addr);
-		set_worker_core_id(&worker_core_id, &ue_ipv4_hash);
+		set_ue_worker_core_id(&worker_core_id,
+				&data->ue_addr.u.ipv4_addr);
 		struct epc_worker_params *wk_params =
 				&epc_app.worker[worker_core_id];
 
@@ -1351,20 +2827,21 @@ dp_session_delete(struct dp_id dp_id,
 			rte_ring_free(ring);
 		}
 	}
+#endif	/* DDN_BUF_POOL */
 
-#ifdef ADC_UPFRONT
-	flush_session_adc_records(data);
-#endif
-	flush_session_pcc_records(data);
-#ifdef APN_MTR
-	flush_apn_records(data);
-#endif /* APN_MTR*/
-
-	/*added for debugging*/
-	export_bearer_cdr_record(data);
-	export_adc_cdr_record(data);
-	export_flow_cdr_record(data);
+#ifdef DEFERRED_SESS_CDR
+	{
+		/* export after the bearer is gone from the tables */
+		struct sess_cdr_snap *snap = sess_cdr_snap_take(data);
 
+		if (snap != NULL)
+			TAILQ_INSERT_TAIL(&sess_cdr_snaps, snap, next);
+		else
+			export_session_cdrs(data);
+	}
+#else
+	export_session_cdrs(data);
+#endif /* DEFERRED_SESS_CDR */
 
 	struct dp_session_info new;
 
@@ -1378,10 +2855,28 @@ dp_session_delete(struct dp_id dp_id,
 		update_adc_rules(data->ue_info_ptr, &new_ue_data);
 	}
 
+#ifdef LB_LOAD_SHEDDING
+	update_sess_shed_class(data, 1);
+#endif	/* LB_LOAD_SHEDDING */
 	/* remove entry from session hash table*/
 	if (rte_hash_del_key(rte_sess_hash, &entry->sess_id) < 0)
 		return -1;
-	rte_free(data);
+	if ((UE_BEAR_ID(entry->sess_id) != DEFAULT_BEARER)
+			&& (data->ue_info_ptr != NULL)
+			&& (data->ue_info_ptr->bearer_count > 0)) {
+		struct dp_session_info *def_data;
+
+		/* default bearer may be the only bearer again */
+		data->ue_info_ptr->bearer_count -= 1;
+		def_data = get_session_data(SESS_ID(UE_SESS_ID(entry->sess_id),
+					DEFAULT_BEARER), SESS_MODIFY);
+		if (def_data != NULL)
+			update_sess_fast_path(def_data);
+	}
+#ifdef WARM_RESTART
+	sess_store_sess_del(data->store_slot);
+#endif	/* WARM_RESTART */
+	sess_obj_free(SESS_OBJ_BEARER, data);
 	return 0;
 }
 
@@ -1401,6 +2896,8 @@ export_rg_cdr_record(struct dp_session_info *session)
 	uint32_t i;
 
 	for (i = 0; i < MAX_RATING_GRP; i++) {
+		CDR_SYNC(&session->ue_info_ptr->rating_grp[i],
+				session->ue_info_ptr->rg_cdr_slot[i]);
 		if (session->ue_info_ptr->rg_idx_map[i].rg_val)
 			export_cdr_record(session, "Rating_Group",
 					session->ue_info_ptr->rg_idx_map[i].rg_val,
@@ -1408,26 +2905,21 @@ export_rg_cdr_record(struct dp_session_info *session)
 	}
 }
 #endif /* RATING_GRP_CDR */
-int
-dp_ue_cdr_flush(struct dp_id dp_id, struct msg_ue_cdr *ue_cdr)
+/**
+ * Export the CDRs of a type of session.
+ *
+ * @param session
+ *	dp bearer session.
+ * @param type
+ *	type of cdrs to export.
+ *
+ * @return
+ *	- 0 Success.
+ *	- -1 Failure.
+ */
+static int
+export_sess_cdrs(struct dp_session_info *session, enum cdr_type type)
 {
-	struct dp_session_info *session;
-	uint64_t sess_id = ue_cdr->session_id;
-	enum cdr_type type = ue_cdr->type;
-	RTE_SET_USED(dp_id);
-	session = get_session_data(sess_id, SESS_MODIFY);
-	if (session == NULL) {
-		RTE_LOG(ERR, DP, "CDR flush fail, Session id 0x%"PRIx64" not found\n", sess_id);
-		return -1;
-	}
-
-	RTE_LOG(INFO, DP, "Flushing CDRs type %d for session id 0x%"PRIx64": ebi %d @ "IPV4_ADDR"\n",
-			type, session->sess_id, (uint8_t)UE_BEAR_ID(session->sess_id),
-			IPV4_ADDR_HOST_FORMAT(session->ue_addr.u.ipv4_addr));
-
-	if (ue_cdr->action)
-		sess_cdr_reset();
-
 	switch (type) {
 	case CDR_TYPE_BEARER:
 		export_bearer_cdr_record(session);
@@ -1455,11 +2947,243 @@ dp_ue_cdr_flush(struct dp_id dp_id, struct msg_ue_cdr *ue_cdr)
 		break;
 	default:
 		RTE_LOG(ERR, DP, "Invalid cdr type request\n");
-		break;
+		return -1;
+	}
+	return 0;
+}
+
+int
+dp_ue_cdr_flush(struct dp_id dp_id, struct msg_ue_cdr *ue_cdr)
+{
+	struct dp_session_info *session;
+	uint64_t sess_id = ue_cdr->session_id;
+	enum cdr_type type = ue_cdr->type;
+	RTE_SET_USED(dp_id);
+	session = get_session_data(sess_id, SESS_MODIFY);
+	if (session == NULL) {
+		RTE_LOG(ERR, DP, "CDR flush fail, Session id 0x%"PRIx64" not found\n", sess_id);
+		return -1;
+	}
+
+	RTE_LOG(INFO, DP, "Flushing CDRs type %d for session id 0x%"PRIx64": ebi %d @ "IPV4_ADDR"\n",
+			type, session->sess_id, (uint8_t)UE_BEAR_ID(session->sess_id),
+			IPV4_ADDR_HOST_FORMAT(session->ue_addr.u.ipv4_addr));
+
+	if (ue_cdr->action)
+		sess_cdr_reset();
+
+	export_sess_cdrs(session, type);
+	/* explicit flush request, write the records out now */
+	sess_cdr_flush();
+	return 0;
+}
+
+int
+dp_ue_cdr_flush_bulk(struct dp_id dp_id, struct msg_ue_cdr_bulk *ue_cdr)
+{
+	struct dp_session_info *session;
+	const void *next_key;
+	void *next_data;
+	uint32_t iter = 0;
+	uint32_t i, walk = 0, found = 0;
+	uint64_t id, sess_id;
+
+	RTE_SET_USED(dp_id);
+	if (ue_cdr->n > MSG_UE_CDR_BULK_MAX) {
+		RTE_LOG(ERR, DP, "CDR bulk flush fail, %u ranges\n", ue_cdr->n);
+		return -1;
+	}
+	if ((ue_cdr->type > CDR_TYPE_ALL) || (rte_sess_hash == NULL))
+		return -1;
+
+	if (ue_cdr->action)
+		sess_cdr_reset();
+
+	for (i = 0; i < ue_cdr->n; i++) {
+		struct sess_id_range *r = &ue_cdr->range[i];
+
+		if (r->first > r->last)
+			continue;
+		if (r->last - r->first >= UE_CDR_RANGE_LOOKUP_MAX) {
+			SET_BIT(walk, i);
+			continue;
+		}
+		id = r->first;
+		do {
+			session = get_session_data(id, SESS_MODIFY);
+			if (session != NULL) {
+				export_sess_cdrs(session, ue_cdr->type);
+				found++;
+			}
+		} while (id++ != r->last);
+	}
+
+	/* all large ranges in one pass over the session table */
+	while (walk && rte_hash_iterate(rte_sess_hash, &next_key, &next_data,
+				&iter) >= 0) {
+		sess_id = *(const uint64_t *)next_key;
+		for (i = 0; i < ue_cdr->n; i++) {
+			if (ISSET_BIT(walk, i)
+					&& (sess_id >= ue_cdr->range[i].first)
+					&& (sess_id <= ue_cdr->range[i].last)) {
+				export_sess_cdrs(next_data, ue_cdr->type);
+				found++;
+				break;
+			}
+		}
 	}
+
+	RTE_LOG(INFO, DP, "Flushed CDRs type %d of %u sessions in %u ranges\n",
+			ue_cdr->type, found, ue_cdr->n);
+	sess_cdr_flush();
 	return 0;
 }
 
+#ifdef INTERIM_CDR
+/** session table position of the running round, 0 between rounds */
+static uint32_t interim_cdr_iter;
+/** start of the next round */
+static uint64_t interim_cdr_next_tsc;
+
+void
+interim_cdr_poll(unsigned budget)
+{
+	const void *next_key;
+	void *next_data;
+	uint64_t now;
+
+	if ((app.interim_cdr_sec == 0) || (rte_sess_hash == NULL))
+		return;
+
+	if (interim_cdr_iter == 0) {
+		now = rte_rdtsc();
+		if (now < interim_cdr_next_tsc)
+			return;
+		interim_cdr_next_tsc = now +
+			(uint64_t)app.interim_cdr_sec * rte_get_tsc_hz();
+	}
+
+	/* The table may change between calls, only the iface core
+	 * updates it. Sessions added behind the walk wait for the next
+	 * round, moved ones may be exported twice. */
+	while (budget--) {
+		if (rte_hash_iterate(rte_sess_hash, &next_key, &next_data,
+					&interim_cdr_iter) < 0) {
+			interim_cdr_iter = 0;
+			return;
+		}
+		export_sess_cdrs(next_data, CDR_TYPE_ALL);
+	}
+}
+#endif	/* INTERIM_CDR */
+
+#ifdef SESS_AGING
+struct sess_age_stats sess_age_stats;
+volatile uint32_t sess_age_now;
+/** tsc of the next aging clock tick */
+static uint64_t sess_age_tick_tsc;
+/** session table position of the running round, 0 between rounds */
+static uint32_t sess_age_iter;
+/** aging clock at the start of the running round */
+static uint32_t sess_age_round;
+/** connected bearers found idle so far in the running round */
+static uint32_t sess_age_idle;
+
+/**
+ * Delete a connected bearer no pkt was seen for in app.sess_reclaim_sec,
+ * as its delete from the CP would, and tell the CP.
+ */
+static void
+sess_age_reclaim(struct dp_session_info *si, uint32_t idle)
+{
+	struct dp_id dp_id = {0};
+	struct session_info sess;
+
+	memset(&sess, 0, sizeof(sess));
+	sess.sess_id = si->sess_id;
+	RTE_LOG(NOTICE, DP, "Reclaim session id 0x%"PRIx64" idle for %us\n",
+			sess.sess_id, idle);
+	if (dp_session_delete(dp_id, &sess) < 0)
+		return;
+	sess_age_stats.reclaimed++;
+
+	struct msgbuf msg_payload = {
+		.mtype = MSG_SESS_RECLAIM,
+		.dp_id.id = DPN_ID,
+		.msg_union.sess_entry.sess_id = sess.sess_id };
+
+	if (comm_node[COMM_CP_DP].send(&msg_payload,
+			sizeof(struct msgbuf)) < 0)
+		perror("msgsnd");
+}
+
+void
+sess_age_poll(unsigned budget)
+{
+	const void *next_key;
+	void *next_data;
+	struct dp_session_info *si;
+	uint64_t now = rte_rdtsc();
+	uint32_t idle;
+
+	if (now >= sess_age_tick_tsc) {
+		sess_age_tick_tsc = now + rte_get_tsc_hz();
+		sess_age_now++;
+	}
+
+	if (((app.sess_idle_sec == 0) && (app.sess_reclaim_sec == 0))
+			|| (rte_sess_hash == NULL))
+		return;
+
+	if (sess_age_iter == 0) {
+		if (sess_age_round == sess_age_now)
+			return;
+		sess_age_round = sess_age_now;
+		sess_age_idle = 0;
+	}
+
+	/* Only the iface core updates the table, reclaiming the entry
+	 * of the walk keeps its position valid. */
+	while (budget--) {
+		if (rte_hash_iterate(rte_sess_hash, &next_key, &next_data,
+					&sess_age_iter) < 0) {
+			sess_age_iter = 0;
+			sess_age_stats.idle = sess_age_idle;
+			sess_age_stats.rounds++;
+			return;
+		}
+
+		si = next_data;
+		/* workers stamp with this clock or an older read of it */
+		idle = sess_age_now - si->last_active;
+		/* IDLE and paging bearers are up to the CP */
+		if (app.sess_reclaim_sec && (idle >= app.sess_reclaim_sec)
+				&& (si->sess_state == CONNECTED)) {
+			sess_age_reclaim(si, idle);
+			continue;
+		}
+
+		if (!app.sess_idle_sec || (idle < app.sess_idle_sec)) {
+			si->idle_reported = 0;
+			continue;
+		}
+
+		/* candidates for idle mode, which is up to the CP. IDLE
+		 * bearers have their S1 released already. */
+		if (si->sess_state != CONNECTED)
+			continue;
+
+		sess_age_idle++;
+		if (!si->idle_reported) {
+			si->idle_reported = 1;
+			sess_age_stats.reported++;
+			RTE_LOG(INFO, DP, "Session id 0x%"PRIx64" idle for %us\n",
+					si->sess_id, idle);
+		}
+	}
+}
+#endif	/* SESS_AGING */
+
 /**
  *  Call back to parse msg to flush cdr to file.
  *
@@ -1475,6 +3199,22 @@ cb_ue_cdr_flush(struct msgbuf *msg_payload)
 	return ue_cdr_flush(msg_payload->dp_id,
 			msg_payload->msg_union.ue_cdr);
 }
+
+/**
+ *  Call back to parse msg to flush the cdrs of session id ranges.
+ *
+ * @param
+ *	msg_payload - payload from CP
+ * @return
+ *	- 0 Success.
+ *	- -1 Failure.
+ */
+static int
+cb_ue_cdr_flush_bulk(struct msgbuf *msg_payload)
+{
+	return ue_cdr_flush_bulk(msg_payload->dp_id,
+			&msg_payload->msg_union.ue_cdr_bulk);
+}
 /******************** Call back functions for Bearer Session ******************/
 /**
  *  Call back to parse msg to create bearer session table
@@ -1555,6 +3295,60 @@ cb_session_delete(struct msgbuf *msg_payload)
 			msg_payload->msg_union.sess_entry);
 }
 
+/**
+ *  Call back to apply a bulk session msg
+ *
+ * @param
+ *	msg_payload - payload from CP
+ * @param
+ *	op - bulk session operation
+ * @return
+ *	- 0 Success.
+ *	- -1 Failure of any session.
+ */
+static int
+cb_session_bulk(struct msgbuf *msg_payload,
+		int (*op)(struct dp_id, struct session_info *, uint32_t, int *))
+{
+	struct msg_sess_bulk *bulk = &msg_payload->msg_union.sess_bulk;
+	int status[MSG_SESS_BULK_MAX];
+	uint32_t i;
+
+	if (bulk->n > MSG_SESS_BULK_MAX) {
+		RTE_LOG(ERR, DP, "Bulk session msg with %u sessions\n",
+				bulk->n);
+		return -1;
+	}
+
+	if (op(msg_payload->dp_id, bulk->sess, bulk->n, status) >= 0)
+		return 0;
+
+	for (i = 0; i < bulk->n; i++)
+		if (status[i] < 0)
+			RTE_LOG(ERR, DP, "Bulk session msg type %ld: sess_id "
+					"0x%"PRIx64" failed\n",
+					msg_payload->mtype, bulk->sess[i].sess_id);
+	return -1;
+}
+
+static int
+cb_session_create_bulk(struct msgbuf *msg_payload)
+{
+	return cb_session_bulk(msg_payload, session_create_bulk);
+}
+
+static int
+cb_session_modify_bulk(struct msgbuf *msg_payload)
+{
+	return cb_session_bulk(msg_payload, session_modify_bulk);
+}
+
+static int
+cb_session_delete_bulk(struct msgbuf *msg_payload)
+{
+	return cb_session_bulk(msg_payload, session_delete_bulk);
+}
+
 /**
  * Initialization of Session Table Callback functions.
  */
@@ -1567,7 +3361,11 @@ app_sess_tbl_init(void)
 	iface_ipc_register_msg_cb(MSG_SESS_CRE, cb_session_create);
 	iface_ipc_register_msg_cb(MSG_SESS_MOD, cb_session_modify);
 	iface_ipc_register_msg_cb(MSG_SESS_DEL, cb_session_delete);
+	iface_ipc_register_msg_cb(MSG_SESS_BULK_CRE, cb_session_create_bulk);
+	iface_ipc_register_msg_cb(MSG_SESS_BULK_MOD, cb_session_modify_bulk);
+	iface_ipc_register_msg_cb(MSG_SESS_BULK_DEL, cb_session_delete_bulk);
 	/* Export CDR to file */
 	iface_ipc_register_msg_cb(MSG_EXP_CDR, cb_ue_cdr_flush);
+	iface_ipc_register_msg_cb(MSG_EXP_CDR_BULK, cb_ue_cdr_flush_bulk);
 }
 
@@ -25,6 +25,7 @@
 
 #include <rte_ether.h>
 #include <rte_debug.h>
+#include <rte_cycles.h>
 
 #include "cdr.h"
 #include "session_cdr.h"
@@ -32,6 +33,10 @@
 
 #define SESS_CDR_FILE "/var/log/dpn/sess_cdr.csv"
 FILE *sess_cdr_file;
+/** bytes of records not yet written out */
+static size_t sess_cdr_pending;
+/** tsc of the oldest pending record */
+static uint64_t sess_cdr_pending_tsc;
 
 void
 sess_cdr_init(void)
@@ -51,6 +56,8 @@ sess_cdr_init(void)
 	if (!sess_cdr_file)
 		rte_panic("CDR file %s failed to open for writing\n - %s (%d)",
 					filename, strerror(errno), errno);
+	/* records are written out by sess_cdr_flush() */
+	setvbuf(sess_cdr_file, NULL, _IOFBF, SESS_CDR_BUF_SIZE);
 
 	if (fprintf(sess_cdr_file, "#%s,%s,%s,%s,%s,%s,%s,"
 				"%s,%s,%s,%s,%s,%s,%s\n",
@@ -74,45 +81,51 @@ sess_cdr_init(void)
 	if (fflush(sess_cdr_file))
 		rte_panic("%s [%d] fflush(sess_cdr_file failed - %s (%d)\n",
 				__FILE__, __LINE__, strerror(errno), errno);
+	sess_cdr_pending = 0;
 }
 
 void
-sess_cdr_reset(void)
+sess_cdr_flush(void)
 {
-	fclose(sess_cdr_file);
-	sess_cdr_init();
+	if (sess_cdr_pending == 0)
+		return;
+	if (fflush(sess_cdr_file))
+		RTE_LOG(ERR, DP, "fflush(sess_cdr_file) failed - %s (%d)\n",
+				strerror(errno), errno);
+	sess_cdr_pending = 0;
 }
 
-/**
- * @brief Function to update timestamp of records to file.
- */
-static void
-update_timestamp(FILE *cfile)
+void
+sess_cdr_flush_check(void)
 {
-	/* create time string */
-	char time_str[30];
-	time_t t = time(NULL);
-	struct tm *tmp = localtime(&t);
-	if (tmp == NULL)
-		return;
-	strftime(time_str, sizeof(time_str), "%y%m%d_%H%M%S", tmp);
-	fprintf(cfile, "%s", time_str);
+	if (sess_cdr_pending && (rte_rdtsc() - sess_cdr_pending_tsc >
+			rte_get_tsc_hz() / 1000 * SESS_CDR_FLUSH_MS))
+		sess_cdr_flush();
 }
 
-/**
- * @brief Function to update Uplink and downlink records to file.
- */
-static void
-update_pkt_counts(FILE *cfile,
-				struct ipcan_dp_bearer_cdr *charge_record)
+void
+sess_cdr_reset(void)
 {
-	if (!charge_record)
-		return;
+	fclose(sess_cdr_file);
+	sess_cdr_init();
+}
 
-	fprintf(cfile, ",%"PRIu64",%"PRIu64
+void
+export_cdr_record(struct dp_session_info *session, char *name,
+			uint32_t id, struct ipcan_dp_bearer_cdr *charge_record)
+{
+	char time_str[RECORD_TIME_LENGTH];
+	int ret;
+
+	cdr_time_get(time_str, CDR_TIME_LOG);
+	ret = fprintf(sess_cdr_file, "%s,%"PRIu64",%s,%u,%s"
+				",%"PRIu64",%"PRIu64
 				",%"PRIu64",%"PRIu64
 				",%"PRIu64",%"PRIu64
-				",%"PRIu64",%"PRIu64,
+				",%"PRIu64",%"PRIu64
+				",%"PRIu32"\n",
+				time_str, session->sess_id, name, id,
+				iptoa(session->ue_addr),
 				charge_record->data_vol.dl_cdr.pkt_count,
 				charge_record->data_vol.dl_cdr.bytes,
 				charge_record->data_vol.ul_cdr.pkt_count,
@@ -120,18 +133,14 @@ update_pkt_counts(FILE *cfile,
 				charge_record->data_vol.dl_drop.pkt_count,
 				charge_record->data_vol.dl_drop.bytes,
 				charge_record->data_vol.ul_drop.pkt_count,
-				charge_record->data_vol.ul_drop.bytes);
-}
+				charge_record->data_vol.ul_drop.bytes,
+				charge_record->rating_group);
+	if (ret < 0)
+		return;
 
-void
-export_cdr_record(struct dp_session_info *session, char *name,
-			uint32_t id, struct ipcan_dp_bearer_cdr *charge_record)
-{
-	update_timestamp(sess_cdr_file);
-	fprintf(sess_cdr_file, ",%"PRIu64"", session->sess_id);
-	fprintf(sess_cdr_file, ",%s,%u,%s", name, id,
-						iptoa(session->ue_addr));
-	update_pkt_counts(sess_cdr_file, charge_record);
-	fprintf(sess_cdr_file, ",%"PRIu32"\n", charge_record->rating_group);
-	fflush(sess_cdr_file);
+	if (sess_cdr_pending == 0)
+		sess_cdr_pending_tsc = rte_rdtsc();
+	sess_cdr_pending += ret;
+	if (sess_cdr_pending >= SESS_CDR_FLUSH_BYTES)
+		sess_cdr_flush();
 }
@@ -23,6 +23,12 @@
  */
 #include "main.h"
 
+/** stdio buffer of the session CDR file */
+#define SESS_CDR_BUF_SIZE	(1 << 20)
+/** pending session CDRs are written out after at most this many ms */
+#define SESS_CDR_FLUSH_MS	1000
+/** or once this many bytes are pending */
+#define SESS_CDR_FLUSH_BYTES	(SESS_CDR_BUF_SIZE / 2)
 
 /**
  * Open Session Charging data record file.
@@ -36,6 +42,19 @@ sess_cdr_init(void);
 void
 sess_cdr_reset(void);
 
+/**
+ * Write out the pending session CDRs.
+ */
+void
+sess_cdr_flush(void);
+
+/**
+ * Write out the pending session CDRs once the oldest one is
+ * SESS_CDR_FLUSH_MS old. Called by the iface core.
+ */
+void
+sess_cdr_flush_check(void);
+
 /**
  * Export CDR record to file.
  * @param session
@@ -46,8 +46,15 @@
 #include "epc_packet_framework.h"
 #include "interface.h"
 #include "meter.h"
+#include "s5s8_bypass.h"
+#include "gtpu_frag.h"
 #include "acl.h"
 #include "commands.h"
+#include "cdr.h"
+#include "epc_arp_icmp.h"
+#include "telemetry.h"
+#include "health.h"
+#include "dp_load.h"
 
 #ifdef MTR_STATS
 
@@ -141,18 +148,21 @@ display_pip_istats(struct rte_pipeline *p, char *name, uint8_t port_id)
 
 void display_pip_ictrs(void)
 {
-	uint32_t i = 0;
+	uint32_t i = 0, q;
 
 	printf("----- Ring IN counters ------\n");
-	display_pip_istats(epc_app.rx_params[0].pipeline,
-			epc_app.rx_params[0].name, 0);
-	display_pip_istats(epc_app.rx_params[1].pipeline,
-			epc_app.rx_params[1].name, 0);
+#ifndef NIC_RSS_STEERING
+	for (q = 0; q < epc_app.n_queues; q++) {
+		display_pip_istats(epc_app.rx_params[0][q].pipeline,
+				epc_app.rx_params[0][q].name, 0);
+		display_pip_istats(epc_app.rx_params[1][q].pipeline,
+				epc_app.rx_params[1][q].name, 0);
+	}
 
-	display_pip_istats(epc_app.lb_params.pipeline, epc_app.lb_params.name,
-			0);
-	display_pip_istats(epc_app.lb_params.pipeline, epc_app.lb_params.name,
-			1);
+	for (i = 0; i < epc_app.n_ports * epc_app.n_queues; i++)
+		display_pip_istats(epc_app.lb_params.pipeline,
+				epc_app.lb_params.name, i);
+#endif
 
 	for (i = 0; i < epc_app.num_workers; i++) {
 		display_pip_istats(epc_app.worker[i].pipeline,
@@ -163,11 +173,13 @@ void display_pip_ictrs(void)
 			"ddn", epc_app.worker[i].port_in_id[NUM_SPGW_PORTS]);
 	}
 
-	for (i = 0; i < epc_app.num_workers; i++) {
-		display_pip_istats(epc_app.tx_params[0].pipeline,
-				epc_app.tx_params[0].name, i);
-		display_pip_istats(epc_app.tx_params[1].pipeline,
-				epc_app.tx_params[1].name, i);
+	for (q = 0; q < epc_app.n_queues; q++) {
+		for (i = 0; i < epc_app.tx_params[0][q].n_port_in; i++)
+			display_pip_istats(epc_app.tx_params[0][q].pipeline,
+					epc_app.tx_params[0][q].name, i);
+		for (i = 0; i < epc_app.tx_params[1][q].n_port_in; i++)
+			display_pip_istats(epc_app.tx_params[1][q].pipeline,
+					epc_app.tx_params[1][q].name, i);
 	}
 }
 
@@ -192,13 +204,16 @@ display_pip_ostats(struct rte_pipeline *p, char *name, uint8_t port_id)
 void
 display_pip_octrs(void)
 {
-	uint32_t i = 0;
+	uint32_t i = 0, q;
 
 	printf("----- Ring OUT counters ------\n");
-	display_pip_ostats(epc_app.rx_params[0].pipeline,
-			epc_app.rx_params[0].name, 0);
-	display_pip_ostats(epc_app.rx_params[1].pipeline,
-			epc_app.rx_params[1].name, 0);
+#ifndef NIC_RSS_STEERING
+	for (q = 0; q < epc_app.n_queues; q++) {
+		display_pip_ostats(epc_app.rx_params[0][q].pipeline,
+				epc_app.rx_params[0][q].name, 0);
+		display_pip_ostats(epc_app.rx_params[1][q].pipeline,
+				epc_app.rx_params[1][q].name, 0);
+	}
 
 	for (i = 0; i < epc_app.num_workers; i++) {
 		unsigned core_id = epc_app.worker_cores[i];
@@ -209,6 +224,7 @@ display_pip_octrs(void)
 				epc_app.lb_params.name,
 				epc_app.lb_params.port_out_id[core_id][1]);
 	}
+#endif
 
 	for (i = 0; i < epc_app.num_workers; i++) {
 		display_pip_ostats(epc_app.worker[i].pipeline,
@@ -217,10 +233,16 @@ display_pip_octrs(void)
 				epc_app.worker[i].name, 1);
 	}
 
-	display_pip_ostats(epc_app.tx_params[0].pipeline,
-			epc_app.tx_params[0].name, 0);
-	display_pip_ostats(epc_app.tx_params[1].pipeline,
-			epc_app.tx_params[1].name, 0);
+	for (q = 0; q < epc_app.n_queues; q++) {
+		/* workers transmitting directly leave no tx pipeline on
+		 * queues other than 0 */
+		if (epc_app.tx_params[0][q].pipeline == NULL)
+			continue;
+		display_pip_ostats(epc_app.tx_params[0][q].pipeline,
+				epc_app.tx_params[0][q].name, 0);
+		display_pip_ostats(epc_app.tx_params[1][q].pipeline,
+				epc_app.tx_params[1][q].name, 0);
+	}
 
 }
 #endif
@@ -264,6 +286,321 @@ void display_ah_ctrs(void)
 }
 #endif
 
+/**
+ * Upper bound in cycles of the histogram bucket holding the given
+ * percentile of the busy runs.
+ */
+static uint64_t
+stage_hist_percentile(const struct epc_stage_stats *s, uint32_t percent)
+{
+	uint64_t target = (s->busy_calls * percent + 99) / 100;
+	uint64_t cnt = 0;
+	uint32_t i;
+
+	for (i = 0; i < EPC_STAGE_HIST_BUCKETS; i++) {
+		cnt += s->hist[i];
+		if (cnt >= target)
+			return 1ULL << (i + 1);
+	}
+	return 1ULL << EPC_STAGE_HIST_BUCKETS;
+}
+
+static void
+display_stage(const char *name, const struct epc_stage_stats *s)
+{
+	uint32_t i;
+
+	printf("  %-24s calls: %12" PRIu64 " busy: %12" PRIu64
+			" pkts: %12" PRIu64 " cyc/pkt: %8" PRIu64
+			" idle cyc: %14" PRIu64 " p50: %8" PRIu64
+			" p99: %8" PRIu64 "\n", name, s->calls, s->busy_calls,
+			s->pkts, s->pkts ? s->busy_cycles / s->pkts : 0,
+			s->idle_cycles,
+			s->busy_calls ? stage_hist_percentile(s, 50) : 0,
+			s->busy_calls ? stage_hist_percentile(s, 99) : 0);
+
+	if (!s->busy_calls)
+		return;
+	printf("  %-24s log2(cycles):", "");
+	for (i = 0; i < EPC_STAGE_HIST_BUCKETS; i++)
+		if (s->hist[i])
+			printf(" %u:%" PRIu64, i, s->hist[i]);
+	printf("\n");
+	printf("  %-24s log2(pkts):", "");
+	for (i = 0; i < EPC_BURST_HIST_BUCKETS; i++)
+		if (s->burst_hist[i])
+			printf(" %u:%" PRIu64, i, s->burst_hist[i]);
+	printf("\n");
+}
+
+static void display_iface_ipc_stats(void)
+{
+	const struct iface_ipc_stats *s = &iface_ipc_stats;
+	uint32_t i;
+
+	printf("  %-24s polls: %12" PRIu64 " msgs: %12" PRIu64
+			" budget full: %12" PRIu64 " depth: %6u max depth: %6u\n",
+			"iface ipc", s->polls, s->msgs, s->budget_full,
+			s->depth, s->max_depth);
+	for (i = 0; i < MSG_END; i++) {
+		if (!s->msg[i].cnt)
+			continue;
+		printf("  %-24s msg type %2u cnt: %12" PRIu64
+				" avg cyc: %10" PRIu64 " max cyc: %12" PRIu64 "\n",
+				"", i, s->msg[i].cnt,
+				s->msg[i].cycles / s->msg[i].cnt,
+				s->msg[i].max_cycles);
+	}
+}
+
+void display_stage_stats(void)
+{
+	uint32_t lcore, i;
+
+	printf("----- Stage cycles per lcore ------\n");
+	for (lcore = 0; lcore < DP_MAX_LCORE; lcore++) {
+		struct epc_lcore_config *config = &epc_app.lcores[lcore];
+
+		if (config->allocated == 0)
+			continue;
+
+		printf(" lcore %u:\n", lcore);
+		for (i = 0; i < (uint32_t)config->allocated; i++)
+			display_stage(config->launch[i].name,
+					&config->launch[i].stats);
+	}
+
+	printf("----- Worker handler stage cycles ------\n");
+	for (i = 0; i < epc_app.num_workers; i++) {
+		static const char *stage_name[WK_STAGE_MAX] = {
+			[WK_STAGE_DECAP] = "decap",
+			[WK_STAGE_UL_FILTER] = "ul_filter",
+			[WK_STAGE_DL_FILTER] = "dl_filter",
+			[WK_STAGE_ENCAP] = "encap",
+			[WK_STAGE_NEXTHOP] = "nexthop",
+		};
+		uint32_t st;
+
+		printf(" %s:\n", epc_app.worker[i].name);
+		for (st = 0; st < WK_STAGE_MAX; st++)
+			display_stage(stage_name[st],
+					&epc_app.worker[i].stage[st]);
+	}
+
+	display_stage("iface msgs", &epc_app.iface_stats);
+	display_iface_ipc_stats();
+}
+
+void display_ring_stats(void)
+{
+	uint32_t i;
+
+	printf("----- Ring occupancy ------\n");
+	for (i = 0; i < epc_ring_stats_count; i++) {
+		struct epc_ring_stats *s = &epc_ring_stats[i];
+
+		printf(" %20s size: %6u count: %6u hwm: %6u"
+				" n_pkts: %12" PRIu64 " n_drops: %12" PRIu64 "\n",
+				s->name, s->ring->prod.size, s->count,
+				s->hwm, s->n_pkts, s->n_drops);
+	}
+#ifdef LB_LOAD_SHEDDING
+	printf(" %20s n_shed: %12" PRIu64 " from count %u\n",
+			epc_app.lb_params.name, epc_app.lb_params.n_shed,
+			epc_app.lb_params.shed_threshold);
+#endif	/* LB_LOAD_SHEDDING */
+}
+
+#ifdef PKT_LATENCY
+/**
+ * Upper bound in cycles of the latency below which the given per mille of
+ * the samples fall.
+ */
+static uint64_t
+latency_percentile(const struct epc_latency_hist *h, uint32_t per_mille)
+{
+	uint64_t target = (h->count * per_mille + 999) / 1000;
+	uint64_t cnt = 0;
+	uint32_t i;
+
+	for (i = 0; i < EPC_LAT_BUCKETS; i++) {
+		cnt += h->hist[i];
+		if (cnt >= target)
+			return epc_latency_bucket_max(i);
+	}
+	return h->max;
+}
+
+static inline void
+latency_hist_add(struct epc_latency_hist *total,
+		const struct epc_latency_hist *h)
+{
+	uint32_t i;
+
+	total->count += h->count;
+	if (h->max > total->max)
+		total->max = h->max;
+	for (i = 0; i < EPC_LAT_BUCKETS; i++)
+		total->hist[i] += h->hist[i];
+}
+
+#ifdef SESS_MEMPOOL
+void display_sess_pool_stats(void)
+{
+	static const char *obj_name[SESS_OBJ_MAX] = {
+		[SESS_OBJ_BEARER] = "bearer",
+		[SESS_OBJ_UE] = "ue",
+		[SESS_OBJ_SDF] = "sdf",
+		[SESS_OBJ_ADC_UE] = "adc_ue",
+	};
+	uint32_t t;
+
+	printf("----- Session object pools (in use / size) ------\n");
+	for (t = 0; t < SESS_OBJ_MAX; t++) {
+		struct rte_mempool *mp = sess_obj_pool[t];
+
+		if (mp == NULL)
+			continue;
+		printf(" %-8s %10u / %u\n", obj_name[t],
+				rte_mempool_in_use_count(mp), mp->size);
+	}
+}
+#endif	/* SESS_MEMPOOL */
+
+#ifdef DDN_BUF_POOL
+void display_ddn_buf_stats(void)
+{
+	uint32_t i;
+
+	printf("----- DDN paging buffers ------\n");
+	for (i = 0; i < epc_app.num_workers; i++) {
+		struct epc_worker_params *wk = &epc_app.worker[i];
+		struct ddn_buf_stats *s = &wk->ddn_stats;
+
+		printf(" %15s in use: %5u / %u buffered: %12" PRIu64
+				" released: %12" PRIu64 " evicted: %12" PRIu64
+				" no_buf: %12" PRIu64 " full: %12" PRIu64
+				" closed: %12" PRIu64 "\n",
+				wk->name,
+				rte_mempool_in_use_count(wk->ddn_buf_pool),
+				wk->ddn_buf_pool->size, s->buffered,
+				s->released, s->evicted, s->no_buf, s->full,
+				s->closed);
+	}
+	printf(" buffered pkts: %5u / %u\n", ddn_buf_pkts, DDN_BUF_PKTS);
+	printf(" dropped on session delete: %12" PRIu64 "\n",
+			ddn_buf_deleted);
+}
+#endif	/* DDN_BUF_POOL */
+
+#ifdef ARP_LOCKLESS_QUEUE
+void display_arp_queue_stats(void)
+{
+	struct arp_queue_stats total = {0};
+	unsigned lcore;
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		total.queued += arp_queue_stats[lcore].queued;
+		total.full += arp_queue_stats[lcore].full;
+		total.no_mbuf += arp_queue_stats[lcore].no_mbuf;
+		total.sent += arp_queue_stats[lcore].sent;
+	}
+	printf("----- ARP unresolved pkts ------\n");
+	printf(" queued: %12" PRIu64 " full: %12" PRIu64
+			" no_mbuf: %12" PRIu64 " sent: %12" PRIu64 "\n",
+			total.queued, total.full, total.no_mbuf, total.sent);
+}
+#endif	/* ARP_LOCKLESS_QUEUE */
+
+#ifdef SESS_AGING
+void display_sess_age_stats(void)
+{
+	printf("----- Session aging ------\n");
+	printf(" rounds: %12" PRIu64 " idle: %10u reported: %12" PRIu64
+			" reclaimed: %12" PRIu64 "\n",
+			sess_age_stats.rounds, sess_age_stats.idle,
+			sess_age_stats.reported, sess_age_stats.reclaimed);
+}
+#endif	/* SESS_AGING */
+
+#ifdef S5S8_BYPASS
+void display_s5s8_bypass_stats(void)
+{
+	struct s5s8_bypass_stats total = {0};
+	unsigned lcore;
+
+	if (s5s8_bypass_port == UINT32_MAX)
+		return;
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		total.tx += s5s8_bypass_stats[lcore].tx;
+		total.tx_drop += s5s8_bypass_stats[lcore].tx_drop;
+		total.rx += s5s8_bypass_stats[lcore].rx;
+		total.rx_nombuf += s5s8_bypass_stats[lcore].rx_nombuf;
+		total.rx_stall += s5s8_bypass_stats[lcore].rx_stall;
+	}
+	printf("----- S5/S8 bypass ------\n");
+	printf(" tx: %12" PRIu64 " tx_drop: %12" PRIu64
+			" rx: %12" PRIu64 " rx_nombuf: %12" PRIu64
+			" rx_stall: %12" PRIu64 "\n",
+			total.tx, total.tx_drop, total.rx, total.rx_nombuf,
+			total.rx_stall);
+}
+#endif	/* S5S8_BYPASS */
+
+#ifdef GTPU_FRAG
+void display_gtpu_frag_stats(void)
+{
+	struct gtpu_frag_stats total = {0};
+	unsigned lcore;
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		total.reasm_in += gtpu_frag_stats[lcore].reasm_in;
+		total.reasm_out += gtpu_frag_stats[lcore].reasm_out;
+		total.frag_in += gtpu_frag_stats[lcore].frag_in;
+		total.frag_out += gtpu_frag_stats[lcore].frag_out;
+		total.frag_fail += gtpu_frag_stats[lcore].frag_fail;
+	}
+	printf("----- GTPU fragments ------\n");
+	printf(" reasm in: %12" PRIu64 " out: %12" PRIu64
+			" frag in: %12" PRIu64 " out: %12" PRIu64
+			" fail: %12" PRIu64 "\n",
+			total.reasm_in, total.reasm_out, total.frag_in,
+			total.frag_out, total.frag_fail);
+}
+#endif	/* GTPU_FRAG */
+
+void display_latency_stats(void)
+{
+	static struct epc_latency_hist total;
+	double ns_per_cycle = 1.0E9 / rte_get_tsc_hz();
+	uint32_t port, i;
+
+	printf("----- rx to tx latency (ns) ------\n");
+	for (port = 0; port < epc_app.n_ports; port++) {
+		memset(&total, 0, sizeof(total));
+#ifdef WORKER_DIRECT_TX
+		for (i = 0; i < epc_app.num_workers; i++)
+			latency_hist_add(&total, &epc_app.worker[i].latency[port]);
+#else
+		for (i = 0; i < epc_app.n_queues; i++)
+			latency_hist_add(&total,
+					&epc_app.tx_params[port][i].latency);
+#endif
+		if (!total.count) {
+			printf(" port %u: no samples\n", port);
+			continue;
+		}
+		printf(" port %u: pkts: %12" PRIu64 " p50: %10.0f p99: %10.0f"
+				" p999: %10.0f max: %10.0f\n", port, total.count,
+				latency_percentile(&total, 500) * ns_per_cycle,
+				latency_percentile(&total, 990) * ns_per_cycle,
+				latency_percentile(&total, 999) * ns_per_cycle,
+				total.max * ns_per_cycle);
+	}
+}
+#endif	/* PKT_LATENCY */
+
 #ifdef INSTMNT
 
 uint64_t diff_tsc_wrkr, total_wrkr_pkts_processed;
@@ -371,7 +708,31 @@ static void timer_cb(__attribute__ ((unused))
 #ifdef MTR_STATS
 	display_mtr_stats();
 #endif
+	/* also on the show command */
+	display_stage_stats();
 #endif	/* STATS */
+	display_ring_stats();
+#ifdef PKT_LATENCY
+	display_latency_stats();
+#endif
+#ifdef SESS_MEMPOOL
+	display_sess_pool_stats();
+#endif
+#ifdef DDN_BUF_POOL
+	display_ddn_buf_stats();
+#endif
+#ifdef ARP_LOCKLESS_QUEUE
+	display_arp_queue_stats();
+#endif
+#ifdef SESS_AGING
+	display_sess_age_stats();
+#endif
+#ifdef S5S8_BYPASS
+	display_s5s8_bypass_stats();
+#endif
+#ifdef GTPU_FRAG
+	display_gtpu_frag_stats();
+#endif
 	/* this timer is automatically reloaded until we decide to
 	 * stop it, when counter reaches 20. */
 	if ((counter++) == 200)
@@ -398,6 +759,17 @@ void epc_stats_core(__rte_unused void *args)
 	int status;
 	static int cmd_ready;
 
+	cdr_time_refresh();
+#ifdef TELEMETRY_SHM
+	dp_telemetry_poll();
+#endif
+#ifdef HEALTH_MON
+	health_poll();
+#endif
+#ifdef MULTI_DP
+	dp_load_poll();
+#endif
+
 	if (cmd_ready == 0) {
 		cl = cmdline_stdin_new(main_ctx, "vepc>");
 		if (cl == NULL)
@@ -415,24 +787,39 @@ void epc_stats_core(__rte_unused void *args)
 	}
 
 #else
-	uint64_t hz;
-	unsigned lcore_id;
-	/* init timer structures */
-	rte_timer_init(&timer0);
-
-	/* load timer0, every second, on master lcore, reloaded automatically */
-	hz = rte_get_timer_hz();
-	lcore_id = rte_lcore_id();
-	rte_timer_reset(&timer0, hz * TIMER_INTERVAL, PERIODICAL, lcore_id,
-			timer_cb, NULL);
-
-	while (1) {
-		cur_tsc = rte_rdtsc();
-		diff_tsc = cur_tsc - prev_tsc;
-		if (diff_tsc > TIMER_RESOLUTION_CYCLES) {
-			rte_timer_manage();
-			prev_tsc = cur_tsc;
-		}
+	static int timer_ready;
+
+	if (timer_ready == 0) {
+		uint64_t hz;
+		unsigned lcore_id;
+		/* init timer structures */
+		rte_timer_init(&timer0);
+
+		/* load timer0, every second, on master lcore, reloaded
+		 * automatically */
+		hz = rte_get_timer_hz();
+		lcore_id = rte_lcore_id();
+		rte_timer_reset(&timer0, hz * TIMER_INTERVAL, PERIODICAL,
+				lcore_id, timer_cb, NULL);
+		timer_ready = 1;
+	}
+
+	/* returns, so stats can share its lcore with other stages */
+	cur_tsc = rte_rdtsc();
+	diff_tsc = cur_tsc - prev_tsc;
+	if (diff_tsc > TIMER_RESOLUTION_CYCLES) {
+		cdr_time_refresh();
+		rte_timer_manage();
+#ifdef TELEMETRY_SHM
+		dp_telemetry_poll();
+#endif
+#ifdef HEALTH_MON
+		health_poll();
+#endif
+#ifdef MULTI_DP
+		dp_load_poll();
+#endif
+		prev_tsc = cur_tsc;
 	}
 #endif
 
@@ -105,6 +105,125 @@ void display_ah_ctrs(void);
  */
 void display_instmnt_wrkr(void);
 
+/**
+ * Function to display cycle accounting and histograms of every pipeline
+ * stage on every lcore and of the worker handler stages.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_stage_stats(void);
+
+/**
+ * Function to display occupancy, high watermark and drops of the
+ * worker rings, and the pkts shed by the load balancer.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_ring_stats(void);
+
+#ifdef SESS_MEMPOOL
+/**
+ * Function to display occupancy of the session object pools.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_sess_pool_stats(void);
+#endif	/* SESS_MEMPOOL */
+
+#ifdef DDN_BUF_POOL
+/**
+ * Function to display occupancy and drops of the worker DDN paging
+ * buffers.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_ddn_buf_stats(void);
+#endif	/* DDN_BUF_POOL */
+
+#ifdef ARP_LOCKLESS_QUEUE
+/**
+ * Function to display the pkts queued and dropped for unresolved
+ * neighbors, summed over all lcores.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_arp_queue_stats(void);
+#endif	/* ARP_LOCKLESS_QUEUE */
+
+#ifdef SESS_AGING
+/**
+ * Function to display the idle and reclaimed bearers of the session
+ * aging walk.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_sess_age_stats(void);
+#endif	/* SESS_AGING */
+
+#ifdef S5S8_BYPASS
+/**
+ * Function to display the pkts exchanged with the co-located SGWU or
+ * PGWU through the S5/S8 bypass.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_s5s8_bypass_stats(void);
+#endif	/* S5S8_BYPASS */
+
+#ifdef GTPU_FRAG
+/**
+ * Function to display the reassembled and fragmented GTPU pkts.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_gtpu_frag_stats(void);
+#endif	/* GTPU_FRAG */
+
+#ifdef PKT_LATENCY
+/**
+ * Function to display p50/p99/p999 rx to tx latency per port.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void display_latency_stats(void);
+#endif
+
 /**
  * Core to print the pipeline stats.
  *
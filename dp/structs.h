@@ -17,17 +17,33 @@
 #ifndef _STRUCTS_H_
 #define _STRUCTS_H_
 
+/* 8 bytes, so that a rule id indexed entry is read and written at once */
 struct pcc_id_precedence {
 	uint32_t pcc_id;		/* pcc rule id */
 	uint8_t precedence;		/* precedence */
 	uint8_t gate_status;	/* gate status */
-} __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
+} __attribute__((packed, aligned(8)));
+
+/* PCC of a SDF/ADC rule, node of the precedence heap of the rule */
+struct filter_pcc_node {
+	struct pcc_id_precedence pcc;	/* pcc information */
+	uint32_t seq;			/* add order, older wins precedence ties */
+	uint32_t heap_idx;		/* position in the rule heap */
+};
 
 struct filter_pcc_data {
-	uint32_t entries;					/* number of elements in pcc_info */
-	struct pcc_id_precedence *pcc_info;	/* pcc information */
+	uint32_t entries;			/* number of PCCs of the rule */
+	uint32_t size;				/* capacity of heap */
+	struct filter_pcc_node **heap;	/* min heap on precedence, heap[0] wins */
 } __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
 
+/* Key of the PCC node of a SDF/ADC rule */
+struct filter_pcc_node_key {
+	uint32_t ruleid;		/* SDF/ADC rule id */
+	uint32_t pcc_id;		/* pcc rule id */
+	uint32_t type;			/* enum filter_pcc_type */
+};
+
 enum filter_pcc_type {
 	FILTER_SDF,		/* SDF filter type */
 	FILTER_ADC,		/* ADC filter type */
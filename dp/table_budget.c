@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef TABLE_BUDGET
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+
+#include <rte_common.h>
+#include <rte_malloc.h>
+#include <rte_lcore.h>
+#include <rte_hash.h>
+
+#include "main.h"
+#include "table_budget.h"
+
+/** Estimated footprint of a mempool or malloc object of size s */
+#define OBJ_BYTES(s)	RTE_CACHE_LINE_ROUNDUP((s) + RTE_CACHE_LINE_SIZE)
+/** Slot sizes of the TEID indexed uplink table and UE ip pool tables */
+#define UL_TEID_SLOT_BYTES	16
+#define UE_POOL_SLOT_BYTES	32
+
+#define MB	(1024 * 1024)
+
+struct dp_table_size dp_tbl_size;
+
+/** Parsed --table_budget */
+static uint64_t budget_mb;
+static uint32_t budget_bearers;
+static uint32_t budget_ues;
+static int budget_set;
+
+static struct {
+	char name[RTE_HASH_NAMESIZE];	/** copied, callers reuse theirs */
+	size_t bytes;
+} report[TABLE_BUDGET_MAX_REPORT];
+static uint32_t nb_report;
+
+int
+table_budget_parse(const char *arg)
+{
+	char *end;
+
+	budget_mb = strtoull(arg, &end, 10);
+	if (*end == ',')
+		budget_bearers = strtoul(end + 1, &end, 10);
+	if (*end == ',')
+		budget_ues = strtoul(end + 1, &end, 10);
+	if (*end != '\0') {
+		printf("Invalid table_budget %s\n", arg);
+		return -1;
+	}
+	budget_set = 1;
+	printf("Parsed table_budget:\t%"PRIu64" MB, %u bearers, %u UEs\n",
+			budget_mb, budget_bearers, budget_ues);
+	return 0;
+}
+
+/**
+ * Estimated size of a DPDK 16.11 rte_hash: buckets of 8 entries, the
+ * key store and the free slot ring.
+ */
+static uint64_t
+hash_bytes(uint32_t entries, uint32_t key_len)
+{
+	uint64_t buckets = rte_align32pow2(entries) / 8;
+
+	return buckets * RTE_CACHE_LINE_SIZE +
+		(uint64_t)(entries + 1) *
+		RTE_ALIGN_CEIL(key_len + sizeof(void *), 16) +
+		(uint64_t)rte_align32pow2(entries + 1) * sizeof(void *);
+}
+
+/**
+ * Hash bytes, split on the worker shards with the headroom of
+ * sess_table_shards_init().
+ */
+static uint64_t
+shard_hash_bytes(uint32_t entries, uint32_t key_len)
+{
+#ifdef SHARDED_SESS_TABLE
+	uint32_t n = epc_app.num_workers;
+
+	if (n > 1)
+		return n * hash_bytes(entries / n * 2, key_len);
+#endif
+	return hash_bytes(entries, key_len);
+}
+
+/**
+ * Estimated memory of the session tables and objects of a table size.
+ */
+static uint64_t
+table_bytes(uint32_t bearers, uint32_t ues)
+{
+	uint64_t b;
+
+	b = shard_hash_bytes(bearers, sizeof(struct ul_bm_key)) +
+		shard_hash_bytes(bearers, sizeof(struct dl_bm_key)) +
+		shard_hash_bytes(ues, sizeof(struct dl_bm_key)) +
+		hash_bytes(ues, sizeof(uint32_t)) +
+		/* dp_session_table_create() */
+		hash_bytes(bearers * 4, sizeof(uint64_t));
+#ifdef UL_TEID_TABLE
+	b += (uint64_t)rte_align32pow2(bearers) * UL_TEID_SLOT_BYTES;
+#endif
+	if (app.ue_pool_mask)
+		b += (uint64_t)2 * RTE_MIN((uint64_t)ues,
+				(uint64_t)~ntohl(app.ue_pool_mask) + 1) *
+			UE_POOL_SLOT_BYTES;
+
+	/* objects, pooled with SESS_MEMPOOL or allocated per session */
+	b += (uint64_t)bearers *
+		(OBJ_BYTES(sizeof(struct dp_session_info)) +
+		 OBJ_BYTES(sizeof(struct dp_sdf_per_bearer_info)));
+	b += (uint64_t)ues *
+		(OBJ_BYTES(sizeof(struct ue_session_info)) +
+		 OBJ_BYTES(sizeof(struct dp_adc_ue_info)));
+#if defined(SESS_MEMPOOL) && !defined(SESS_POOL_ENTRIES)
+	/* pools of all object types hold bearers objects */
+	b += (uint64_t)(bearers - RTE_MIN(bearers, ues)) *
+		(OBJ_BYTES(sizeof(struct ue_session_info)) +
+		 OBJ_BYTES(sizeof(struct dp_adc_ue_info)));
+#endif
+	return b;
+}
+
+static inline uint32_t
+ues_of(uint32_t bearers)
+{
+	return budget_ues ? budget_ues :
+		RTE_MAX(bearers / TABLE_BEARERS_PER_UE, 1U);
+}
+
+void
+table_budget_init(void)
+{
+	struct rte_malloc_socket_stats st;
+	uint64_t budget, need;
+	uint32_t lo, hi, mid;
+
+	if (!budget_set) {
+		dp_tbl_size.bearers = LDB_ENTRIES_DEFAULT * HASH_SIZE_FACTOR;
+		dp_tbl_size.ues = LDB_ENTRIES_DEFAULT;
+		return;
+	}
+
+	budget = budget_mb * MB;
+	if (budget == 0) {
+		if (rte_malloc_get_socket_stats(rte_socket_id(), &st) < 0)
+			rte_exit(EXIT_FAILURE, "Cannot get hugepage stats\n");
+		budget = (uint64_t)st.heap_freesz_bytes *
+			(100 - TABLE_BUDGET_RESERVE_PCT) / 100;
+	}
+
+	if (budget_bearers == 0) {
+		/* largest bearer count that fits */
+		lo = TABLE_MIN_BEARERS;
+		/* the session hash has 4 entries per bearer */
+		hi = 1 << 29;
+		if (table_bytes(lo, ues_of(lo)) > budget)
+			rte_exit(EXIT_FAILURE, "table_budget of %"PRIu64
+					" MB is below the %u bearers minimum\n",
+					budget / MB, lo);
+		while (lo < hi) {
+			mid = lo + (hi - lo + 1) / 2;
+			if (table_bytes(mid, ues_of(mid)) <= budget)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		budget_bearers = lo;
+	}
+
+	dp_tbl_size.bearers = RTE_MAX(budget_bearers,
+			(uint32_t)TABLE_MIN_BEARERS);
+	dp_tbl_size.ues = ues_of(dp_tbl_size.bearers);
+	need = table_bytes(dp_tbl_size.bearers, dp_tbl_size.ues);
+	if (need > budget)
+		rte_exit(EXIT_FAILURE, "%u bearers and %u UEs need %"PRIu64
+				" MB, over the table_budget of %"PRIu64" MB\n",
+				dp_tbl_size.bearers, dp_tbl_size.ues,
+				need / MB, budget / MB);
+
+	RTE_LOG(NOTICE, DP, "Tables sized for %u bearers and %u UEs,"
+			" %"PRIu64" MB estimated of %"PRIu64" MB budget\n",
+			dp_tbl_size.bearers, dp_tbl_size.ues, need / MB,
+			budget / MB);
+}
+
+size_t
+table_budget_mark(void)
+{
+	struct rte_malloc_socket_stats st;
+	size_t bytes = 0;
+	int socket;
+
+	/* tables may be placed on the sockets of their lcores */
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++)
+		if (rte_malloc_get_socket_stats(socket, &st) == 0)
+			bytes += st.heap_allocsz_bytes;
+	return bytes;
+}
+
+void
+table_budget_account(const char *name, size_t mark)
+{
+	size_t now = table_budget_mark();
+
+	if (nb_report == TABLE_BUDGET_MAX_REPORT)
+		return;
+	snprintf(report[nb_report].name, sizeof(report[nb_report].name),
+			"%s", name);
+	report[nb_report].bytes = (now > mark) ? now - mark : 0;
+	nb_report++;
+}
+
+void
+table_budget_print(void)
+{
+	struct rte_malloc_socket_stats st;
+	uint64_t total = 0;
+	uint32_t i;
+
+	printf("%-24s %12s\n", "Table memory", "KB");
+	for (i = 0; i < nb_report; i++) {
+		printf("%-24s %12zu\n", report[i].name,
+				report[i].bytes / 1024);
+		total += report[i].bytes;
+	}
+	printf("%-24s %12"PRIu64"\n", "total", total / 1024);
+	if (rte_malloc_get_socket_stats(rte_socket_id(), &st) == 0)
+		printf("%-24s %12zu\n", "hugepages free",
+				st.heap_freesz_bytes / 1024);
+}
+#endif /* TABLE_BUDGET */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _TABLE_BUDGET_H_
+#define _TABLE_BUDGET_H_
+/**
+ * @file
+ * This file contains macros and function prototypes of the session table
+ * sizing.
+ *
+ * With TABLE_BUDGET the uplink, downlink, session and UE tables and the
+ * session object pools are sized at start up, from the bearer and UE
+ * counts and hugepage budget of --table_budget, instead of from
+ * LDB_ENTRIES_DEFAULT and HASH_SIZE_FACTOR. Without counts the largest
+ * tables that fit the budget are used, without a budget the budget is
+ * the free hugepage memory less TABLE_BUDGET_RESERVE_PCT. The memory
+ * taken by each structure is printed once the tables are created.
+ */
+#ifdef TABLE_BUDGET
+#include <stddef.h>
+#include <stdint.h>
+
+/** Free hugepage memory left for rules and runtime allocations, percent */
+#define TABLE_BUDGET_RESERVE_PCT	25
+/** Bearers per UE when only the bearer count or budget is set */
+#define TABLE_BEARERS_PER_UE		2
+/** Smallest bearer count */
+#define TABLE_MIN_BEARERS		1024
+/** Structures in the memory report */
+#define TABLE_BUDGET_MAX_REPORT		64
+
+/**
+ * Parse --table_budget.
+ *
+ * @param arg
+ *	<budget MB>[,<bearers>[,<UEs>]], a budget of 0 is the free
+ *	hugepage memory.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on parse error
+ */
+int
+table_budget_parse(const char *arg);
+
+/**
+ * Set dp_tbl_size from the parsed counts and budget. Exits if the counts
+ * do not fit the budget. Called by dp_table_init() before the tables
+ * are created.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+table_budget_init(void);
+
+/**
+ * Hugepage memory in use, to be passed to table_budget_account().
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	bytes allocated on all sockets.
+ */
+size_t
+table_budget_mark(void);
+
+/**
+ * Add a structure to the memory report.
+ *
+ * @param name
+ *	structure name.
+ * @param mark
+ *	table_budget_mark() before the structure was created.
+ *
+ * @return
+ *	None
+ */
+void
+table_budget_account(const char *name, size_t mark);
+
+/**
+ * Print the memory report of the structures created.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void
+table_budget_print(void);
+#endif /* TABLE_BUDGET */
+#endif /* _TABLE_BUDGET_H_ */
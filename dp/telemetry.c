@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef TELEMETRY_SHM
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_debug.h>
+
+#include "main.h"
+#include "epc_packet_framework.h"
+#include "telemetry.h"
+
+#ifndef STATS
+#error "TELEMETRY_SHM requires STATS"
+#endif
+
+static struct dp_telemetry *dp_tm;
+static uint64_t dp_tm_interval;
+static uint64_t dp_tm_last;
+
+static const char *wk_stage_name[WK_STAGE_MAX] = {
+	[WK_STAGE_DECAP] = "decap",
+	[WK_STAGE_UL_FILTER] = "ul_filter",
+	[WK_STAGE_DL_FILTER] = "dl_filter",
+	[WK_STAGE_ENCAP] = "encap",
+	[WK_STAGE_NEXTHOP] = "nexthop",
+};
+
+void
+dp_telemetry_init(void)
+{
+	int fd;
+
+	RTE_BUILD_BUG_ON(NUM_SPGW_PORTS > DP_TM_PORTS);
+	RTE_BUILD_BUG_ON(DP_MAX_LCORE > DP_TM_MAX_LCORES);
+	RTE_BUILD_BUG_ON(EPC_PIPELINE_MAX > DP_TM_LCORE_STAGES);
+	RTE_BUILD_BUG_ON(WK_STAGE_MAX > DP_TM_WK_STAGES);
+	RTE_BUILD_BUG_ON(EPC_RING_STATS_MAX > DP_TM_MAX_RINGS);
+	RTE_BUILD_BUG_ON(EPC_STAGE_HIST_BUCKETS != DP_TM_HIST_BUCKETS);
+
+	fd = shm_open(DP_TM_SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		rte_panic("Failed to open shm %s - %s\n", DP_TM_SHM_NAME,
+				strerror(errno));
+	if (ftruncate(fd, sizeof(*dp_tm)) < 0)
+		rte_panic("Failed to size shm %s - %s\n", DP_TM_SHM_NAME,
+				strerror(errno));
+	dp_tm = mmap(NULL, sizeof(*dp_tm), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (dp_tm == MAP_FAILED)
+		rte_panic("Failed to map shm %s - %s\n", DP_TM_SHM_NAME,
+				strerror(errno));
+
+	/* a restarted DP keeps the object, seq stays monotonic for
+	 * collectors that did not remap */
+	dp_tm->seq |= 1;
+	rte_smp_wmb();
+	memset(&dp_tm->tsc, 0, sizeof(*dp_tm) -
+			offsetof(struct dp_telemetry, tsc));
+	memcpy(dp_tm->magic, DP_TM_MAGIC, sizeof(dp_tm->magic));
+	dp_tm->version = DP_TM_VERSION;
+	dp_tm->size = sizeof(*dp_tm);
+	dp_tm->tsc_hz = rte_get_tsc_hz();
+	rte_smp_wmb();
+	dp_tm->seq++;
+
+	dp_tm_interval = rte_get_tsc_hz() * DP_TM_INTERVAL_MS / 1000;
+	RTE_LOG(INFO, DP, "Telemetry published to shm %s, %zu bytes\n",
+			DP_TM_SHM_NAME, sizeof(*dp_tm));
+}
+
+static void
+tm_stage_copy(struct dp_tm_stage *d, const char *name,
+		const struct epc_stage_stats *s)
+{
+	snprintf(d->name, sizeof(d->name), "%s", name ? name : "");
+	d->calls = s->calls;
+	d->busy_calls = s->busy_calls;
+	d->busy_cycles = s->busy_cycles;
+	d->idle_cycles = s->idle_cycles;
+	d->pkts = s->pkts;
+	memcpy(d->hist, s->hist, sizeof(d->hist));
+}
+
+static void
+tm_update(struct dp_telemetry *t)
+{
+	struct rte_eth_stats es;
+	uint32_t lcore, i, n;
+	uint8_t port;
+
+	t->n_ports = epc_app.n_ports;
+	for (port = 0; port < epc_app.n_ports; port++) {
+		struct dp_tm_port *p = &t->port[port];
+
+		if (rte_eth_stats_get(port, &es) < 0)
+			continue;
+		p->ipackets = es.ipackets;
+		p->opackets = es.opackets;
+		p->ibytes = es.ibytes;
+		p->obytes = es.obytes;
+		p->imissed = es.imissed;
+		p->ierrors = es.ierrors;
+		p->oerrors = es.oerrors;
+		p->rx_nombuf = es.rx_nombuf;
+	}
+
+	n = 0;
+	for (lcore = 0; lcore < DP_MAX_LCORE; lcore++) {
+		struct epc_lcore_config *config = &epc_app.lcores[lcore];
+		struct dp_tm_lcore *l = &t->lcore[n];
+
+		if (config->allocated == 0)
+			continue;
+		l->lcore = lcore;
+		l->n_stages = config->allocated;
+		for (i = 0; i < (uint32_t)config->allocated; i++)
+			tm_stage_copy(&l->stage[i], config->launch[i].name,
+					&config->launch[i].stats);
+		n++;
+	}
+	t->n_lcores = n;
+
+	t->n_workers = epc_app.num_workers;
+	for (i = 0; i < epc_app.num_workers; i++) {
+		struct dp_tm_worker *w = &t->worker[i];
+		uint32_t st;
+
+		snprintf(w->name, sizeof(w->name), "%s",
+				epc_app.worker[i].name);
+		w->lcore = epc_app.worker_cores[i];
+		w->n_stages = WK_STAGE_MAX;
+		for (st = 0; st < WK_STAGE_MAX; st++)
+			tm_stage_copy(&w->stage[st], wk_stage_name[st],
+					&epc_app.worker[i].stage[st]);
+	}
+
+	t->n_rings = epc_ring_stats_count;
+	for (i = 0; i < epc_ring_stats_count; i++) {
+		const struct epc_ring_stats *s = &epc_ring_stats[i];
+		struct dp_tm_ring *r = &t->ring[i];
+
+		snprintf(r->name, sizeof(r->name), "%s", s->name);
+		r->n_pkts = s->n_pkts;
+		r->n_drops = s->n_drops;
+		r->size = s->ring->prod.size;
+		r->count = s->count;
+		r->hwm = s->hwm;
+	}
+}
+
+void
+dp_telemetry_poll(void)
+{
+	uint64_t now = rte_rdtsc();
+
+	if (dp_tm == NULL || now - dp_tm_last < dp_tm_interval)
+		return;
+	dp_tm_last = now;
+
+	dp_tm->seq++;
+	rte_smp_wmb();
+	tm_update(dp_tm);
+	dp_tm->tsc = now;
+	dp_tm->updates++;
+	rte_smp_wmb();
+	dp_tm->seq++;
+}
+#endif /* TELEMETRY_SHM */
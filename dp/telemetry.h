@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+/**
+ * @file
+ * This file contains the layout of the DP telemetry region and the
+ * prototypes of its publisher.
+ *
+ * The stats lcore copies the NIC, per lcore stage, worker handler stage
+ * and ring counters into the POSIX shared memory object DP_TM_SHM_NAME
+ * every DP_TM_INTERVAL_MS. Collectors map it read only and never touch
+ * the DP: seq is odd while an update is in progress, so a reader copies
+ * the region and retries if seq was odd or changed meanwhile. Counters
+ * are cumulative, except the NIC counters with STATS_CLR. The layout
+ * only depends on this file, a collector needs no DPDK header; any
+ * change to it bumps DP_TM_VERSION. tmdump.py is a reference reader.
+ */
+#include <stdint.h>
+
+#define DP_TM_SHM_NAME		"/ngic_dp_telemetry"
+#define DP_TM_MAGIC		"NGICDPTM"
+#define DP_TM_VERSION		2
+/** Publish interval of the stats lcore */
+#define DP_TM_INTERVAL_MS	1000
+
+#define DP_TM_NAME_SIZE		32
+#define DP_TM_PORTS		2
+#define DP_TM_MAX_LCORES	64
+#define DP_TM_LCORE_STAGES	8
+#define DP_TM_MAX_WORKERS	64
+#define DP_TM_WK_STAGES		8
+#define DP_TM_MAX_RINGS		256
+#define DP_TM_HIST_BUCKETS	32
+
+/**
+ * Cycle accounting of a stage, see struct epc_stage_stats.
+ */
+struct dp_tm_stage {
+	char name[DP_TM_NAME_SIZE];
+	uint64_t calls;
+	uint64_t busy_calls;
+	uint64_t busy_cycles;
+	uint64_t idle_cycles;
+	uint64_t pkts;
+	uint64_t hist[DP_TM_HIST_BUCKETS];	/** log2 of busy run cycles */
+};
+
+/**
+ * Stages run by an lcore.
+ */
+struct dp_tm_lcore {
+	uint32_t lcore;
+	uint32_t n_stages;
+	struct dp_tm_stage stage[DP_TM_LCORE_STAGES];
+};
+
+/**
+ * Handler stages of a worker.
+ */
+struct dp_tm_worker {
+	char name[DP_TM_NAME_SIZE];
+	uint32_t lcore;
+	uint32_t n_stages;
+	struct dp_tm_stage stage[DP_TM_WK_STAGES];
+};
+
+/**
+ * Pipeline ring counters.
+ */
+struct dp_tm_ring {
+	char name[DP_TM_NAME_SIZE];
+	uint64_t n_pkts;
+	uint64_t n_drops;
+	uint32_t size;
+	uint32_t count;
+	uint32_t hwm;
+	uint32_t pad;
+};
+
+/**
+ * NIC counters of a port.
+ */
+struct dp_tm_port {
+	uint64_t ipackets;
+	uint64_t opackets;
+	uint64_t ibytes;
+	uint64_t obytes;
+	uint64_t imissed;
+	uint64_t ierrors;
+	uint64_t oerrors;
+	uint64_t rx_nombuf;
+};
+
+/**
+ * Telemetry region.
+ */
+struct dp_telemetry {
+	char magic[8];
+	uint32_t version;
+	uint32_t size;			/** bytes of the region */
+	uint64_t tsc_hz;
+	volatile uint64_t seq;		/** odd while being updated */
+	uint64_t tsc;			/** tsc of last update */
+	uint64_t updates;
+	uint32_t n_ports;
+	uint32_t n_lcores;
+	uint32_t n_workers;
+	uint32_t n_rings;
+	struct dp_tm_port port[DP_TM_PORTS];
+	struct dp_tm_lcore lcore[DP_TM_MAX_LCORES];
+	struct dp_tm_worker worker[DP_TM_MAX_WORKERS];
+	struct dp_tm_ring ring[DP_TM_MAX_RINGS];
+};
+
+#ifdef TELEMETRY_SHM
+/**
+ * Create and map the telemetry region.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void dp_telemetry_init(void);
+
+/**
+ * Publish the counters if DP_TM_INTERVAL_MS passed since the last
+ * update. Called by the stats lcore.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void dp_telemetry_poll(void);
+#endif /* TELEMETRY_SHM */
+#endif /* _TELEMETRY_H_ */
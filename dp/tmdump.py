@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2017 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Print a consistent snapshot of the DP telemetry region (dp/telemetry.h)
+# as JSON:
+#   tmdump.py [/dev/shm/ngic_dp_telemetry]
+
+import sys
+import json
+import mmap
+import struct
+import time
+
+VERSION = 2
+PORTS = 2
+MAX_LCORES = 64
+LCORE_STAGES = 8
+MAX_WORKERS = 64
+WK_STAGES = 8
+MAX_RINGS = 256
+HIST = 32
+
+HDR = '<8sIIQQQQIIII'
+PORT = '<8Q'
+STAGE = '<32s5Q%dQ' % HIST
+LCORE = '<II'
+WORKER = '<32sII'
+RING = '<32sQQIIII'
+SEQ_OFF = 24
+
+def cstr(b):
+  return b.split(b'\0', 1)[0].decode()
+
+def stage(buf, off):
+  v = struct.unpack_from(STAGE, buf, off)
+  return {'name': cstr(v[0]), 'calls': v[1], 'busy_calls': v[2],
+          'busy_cycles': v[3], 'idle_cycles': v[4], 'pkts': v[5],
+          'hist': list(v[6:])}
+
+def parse(buf):
+  (magic, version, size, hz, seq, tsc, updates,
+   n_ports, n_lcores, n_workers, n_rings) = struct.unpack_from(HDR, buf, 0)
+  if magic != b'NGICDPTM' or version != VERSION:
+    raise ValueError('not a version %u DP telemetry region' % VERSION)
+  out = {'tsc_hz': hz, 'tsc': tsc, 'updates': updates}
+
+  off = struct.calcsize(HDR)
+  names = ('ipackets', 'opackets', 'ibytes', 'obytes', 'imissed',
+           'ierrors', 'oerrors', 'rx_nombuf')
+  out['ports'] = [dict(zip(names, struct.unpack_from(PORT, buf,
+                  off + i * struct.calcsize(PORT)))) for i in range(n_ports)]
+  off += PORTS * struct.calcsize(PORT)
+
+  ssz = struct.calcsize(STAGE)
+  lsz = struct.calcsize(LCORE) + LCORE_STAGES * ssz
+  out['lcores'] = []
+  for i in range(n_lcores):
+    base = off + i * lsz
+    lcore, n = struct.unpack_from(LCORE, buf, base)
+    base += struct.calcsize(LCORE)
+    out['lcores'].append({'lcore': lcore,
+        'stages': [stage(buf, base + j * ssz) for j in range(n)]})
+  off += MAX_LCORES * lsz
+
+  wsz = struct.calcsize(WORKER) + WK_STAGES * ssz
+  out['workers'] = []
+  for i in range(n_workers):
+    base = off + i * wsz
+    name, lcore, n = struct.unpack_from(WORKER, buf, base)
+    base += struct.calcsize(WORKER)
+    out['workers'].append({'name': cstr(name), 'lcore': lcore,
+        'stages': [stage(buf, base + j * ssz) for j in range(n)]})
+  off += MAX_WORKERS * wsz
+
+  rsz = struct.calcsize(RING)
+  out['rings'] = []
+  for i in range(n_rings):
+    v = struct.unpack_from(RING, buf, off + i * rsz)
+    out['rings'].append({'name': cstr(v[0]), 'n_pkts': v[1],
+        'n_drops': v[2], 'size': v[3], 'count': v[4], 'hwm': v[5]})
+  off += MAX_RINGS * rsz
+
+  if off != size:
+    raise ValueError('region size %u, layout %u' % (size, off))
+  return out
+
+def snapshot(m):
+  while True:
+    seq = struct.unpack_from('<Q', m, SEQ_OFF)[0]
+    if seq & 1:
+      time.sleep(0.001)
+      continue
+    buf = m[:]
+    if struct.unpack_from('<Q', m, SEQ_OFF)[0] == seq:
+      return buf
+
+def main():
+  path = sys.argv[1] if len(sys.argv) > 1 else '/dev/shm/ngic_dp_telemetry'
+  with open(path, 'rb') as f:
+    m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    print(json.dumps(parse(snapshot(m)), indent=1))
+
+if __name__ == '__main__':
+  main()
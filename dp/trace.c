@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef TRACE_POINTS
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_malloc.h>
+#include <rte_log.h>
+
+#include "main.h"
+#include "trace.h"
+
+volatile uint32_t dp_trace_mask;
+struct dp_trace_buf *dp_trace_bufs[RTE_MAX_LCORE];
+
+static const char *dp_trace_sub_name[DP_TRACE_SUB_MAX] = {
+	[DP_TRACE_RX] = "rx",
+	[DP_TRACE_GTPU] = "gtpu",
+	[DP_TRACE_SESS] = "sess",
+	[DP_TRACE_ADC] = "adc",
+};
+
+/**
+ * Dump file header, followed per lcore by lcore id, number of records
+ * and the records, oldest first.
+ */
+struct dp_trace_file_hdr {
+	char magic[8];
+	uint64_t tsc_hz;
+	uint32_t n_lcores;
+	uint32_t rec_size;
+};
+
+void
+dp_trace_init(void)
+{
+	unsigned lcore;
+
+	RTE_LCORE_FOREACH(lcore) {
+		dp_trace_bufs[lcore] = rte_zmalloc_socket("dp_trace",
+				sizeof(struct dp_trace_buf), RTE_CACHE_LINE_SIZE,
+				rte_lcore_to_socket_id(lcore));
+		if (dp_trace_bufs[lcore] == NULL)
+			rte_panic("Failed to allocate trace buffer of lcore %u\n",
+					lcore);
+	}
+}
+
+int
+dp_trace_parse(const char *list, uint32_t *mask)
+{
+	char buf[64];
+	char *tok, *save = NULL;
+	unsigned i;
+
+	snprintf(buf, sizeof(buf), "%s", list);
+	*mask = 0;
+	for (tok = strtok_r(buf, ",", &save); tok != NULL;
+			tok = strtok_r(NULL, ",", &save)) {
+		if (!strcmp(tok, "all")) {
+			*mask = (1u << DP_TRACE_SUB_MAX) - 1;
+			continue;
+		}
+		if (!strcmp(tok, "none"))
+			continue;
+		for (i = 0; i < DP_TRACE_SUB_MAX; i++)
+			if (!strcmp(tok, dp_trace_sub_name[i]))
+				break;
+		if (i == DP_TRACE_SUB_MAX) {
+			printf("Unknown trace subsystem %s\n", tok);
+			return -1;
+		}
+		*mask |= 1u << i;
+	}
+	return 0;
+}
+
+int
+dp_trace_dump(const char *path)
+{
+	struct dp_trace_file_hdr hdr;
+	struct dp_trace_buf *b;
+	FILE *f;
+	unsigned lcore;
+	uint64_t head, first;
+	uint32_t id, n, start;
+
+	f = fopen(path, "w");
+	if (f == NULL) {
+		RTE_LOG(ERR, DP, "Failed to open %s - %s\n", path,
+				strerror(errno));
+		return -1;
+	}
+
+	memcpy(hdr.magic, DP_TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.tsc_hz = rte_get_tsc_hz();
+	hdr.n_lcores = 0;
+	hdr.rec_size = sizeof(struct dp_trace_rec);
+	RTE_LCORE_FOREACH(lcore)
+		if (dp_trace_bufs[lcore] != NULL)
+			hdr.n_lcores++;
+	fwrite(&hdr, sizeof(hdr), 1, f);
+
+	RTE_LCORE_FOREACH(lcore) {
+		b = dp_trace_bufs[lcore];
+		if (b == NULL)
+			continue;
+		head = b->head;
+		first = head > DP_TRACE_BUF_SZ ? head - DP_TRACE_BUF_SZ : 0;
+		n = head - first;
+		start = first & (DP_TRACE_BUF_SZ - 1);
+
+		id = lcore;
+		fwrite(&id, sizeof(id), 1, f);
+		fwrite(&n, sizeof(n), 1, f);
+		/* ring wraps at most once */
+		if (start + n > DP_TRACE_BUF_SZ) {
+			fwrite(&b->rec[start], sizeof(b->rec[0]),
+					DP_TRACE_BUF_SZ - start, f);
+			fwrite(&b->rec[0], sizeof(b->rec[0]),
+					start + n - DP_TRACE_BUF_SZ, f);
+		} else {
+			fwrite(&b->rec[start], sizeof(b->rec[0]), n, f);
+		}
+	}
+
+	if (fclose(f)) {
+		RTE_LOG(ERR, DP, "Failed to write %s - %s\n", path,
+				strerror(errno));
+		return -1;
+	}
+	RTE_LOG(INFO, DP, "Trace buffers written to %s\n", path);
+	return 0;
+}
+#endif /* TRACE_POINTS */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+/**
+ * @file
+ * This file contains macros, data structure definitions and function
+ * prototypes of the DP trace points.
+ *
+ * A trace point writes a binary record (tsc, id, three 32 bit args) to
+ * the ring buffer of the calling lcore; old records are overwritten.
+ * Subsystems are enabled at runtime with --trace or the trace CLI, the
+ * buffers are dumped to a file and decoded offline by tracedecode.py.
+ * Without TRACE_POINTS the trace points and their args compile away;
+ * with it a disabled trace point costs one predicted branch.
+ */
+#include <stdint.h>
+#include <rte_lcore.h>
+#include <rte_cycles.h>
+#include <rte_branch_prediction.h>
+
+/**
+ * Trace subsystems, bit of dp_trace_mask.
+ */
+enum dp_trace_sub {
+	DP_TRACE_RX,		/** rx action handlers */
+	DP_TRACE_GTPU,		/** GTPU encap/decap */
+	DP_TRACE_SESS,		/** session lookups */
+	DP_TRACE_ADC,		/** ADC lookups */
+	DP_TRACE_SUB_MAX,
+};
+
+/**
+ * Trace point ids. Keep in sync with tracedecode.py.
+ */
+enum dp_trace_id {
+	TP_RX_GTPU = 1,		/** inner UE ip */
+	TP_RX_SGI,		/** UE ip */
+	TP_RX_BAD_CKSUM,	/** ol_flags, port */
+	TP_GTPU_DECAP,		/** teid, inner UE ip */
+	TP_GTPU_DECAP_LEN,	/** data_off, data_len, pkt_len */
+	TP_GTPU_ENCAP_LEN,	/** data_off, data_len, pkt_len */
+	TP_UL_SESS_MISS,	/** teid, rid */
+	TP_DL_SESS_KEY,		/** UE ip (host order), rid */
+	TP_DL_SESS_MISS,	/** UE ip (host order), rid */
+	TP_ADC_DNS_HIT,		/** burst index, rule id */
+};
+
+#ifdef TRACE_POINTS
+/** Records of each lcore buffer, power of 2 */
+#define DP_TRACE_BUF_SZ		(1 << 14)
+/** Dump file written on SIGINT */
+#define DP_TRACE_FILE		"./logs/dp_trace.bin"
+#define DP_TRACE_MAGIC		"DPTRACE1"
+
+/**
+ * Trace record.
+ */
+struct dp_trace_rec {
+	uint64_t tsc;
+	uint32_t id;
+	uint32_t arg[3];
+};
+
+/**
+ * Trace ring buffer of an lcore.
+ */
+struct dp_trace_buf {
+	uint64_t head;		/** records written */
+	struct dp_trace_rec rec[DP_TRACE_BUF_SZ];
+} __rte_cache_aligned;
+
+/** Enabled subsystems, bit per dp_trace_sub */
+extern volatile uint32_t dp_trace_mask;
+extern struct dp_trace_buf *dp_trace_bufs[RTE_MAX_LCORE];
+
+/**
+ * Write trace record to the buffer of calling lcore. Use TRACE_POINT().
+ */
+static inline void
+dp_trace_emit(uint32_t id, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+	unsigned lcore = rte_lcore_id();
+	struct dp_trace_buf *b;
+	struct dp_trace_rec *r;
+
+	/* not an EAL thread, or buffers not allocated */
+	if (unlikely(lcore >= RTE_MAX_LCORE))
+		return;
+	b = dp_trace_bufs[lcore];
+	if (unlikely(b == NULL))
+		return;
+
+	r = &b->rec[b->head & (DP_TRACE_BUF_SZ - 1)];
+	r->tsc = rte_rdtsc();
+	r->id = id;
+	r->arg[0] = a0;
+	r->arg[1] = a1;
+	r->arg[2] = a2;
+	b->head++;
+}
+
+/**
+ * Trace point of subsystem sub. The args are only evaluated when sub
+ * is enabled.
+ */
+#define TRACE_POINT(sub, id, a0, a1, a2) do {				\
+	if (unlikely(dp_trace_mask & (1u << (sub))))			\
+		dp_trace_emit((id), (uint32_t)(a0), (uint32_t)(a1),	\
+				(uint32_t)(a2));			\
+} while (0)
+
+/**
+ * Allocate the trace buffer of every lcore.
+ *
+ * @param
+ *	Void
+ *
+ * @return
+ *	None
+ */
+void dp_trace_init(void);
+
+/**
+ * Parse subsystem list, e.g. "rx,gtpu", "all" or "none".
+ *
+ * @param list
+ *	comma separated subsystem names.
+ * @param mask
+ *	parsed subsystem mask.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on unknown subsystem
+ */
+int dp_trace_parse(const char *list, uint32_t *mask);
+
+/**
+ * Write the trace buffers to a file. Records written while dumping
+ * may be torn, disable the trace first for a consistent dump.
+ *
+ * @param path
+ *	dump file.
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 on failure
+ */
+int dp_trace_dump(const char *path);
+
+#else
+#define TRACE_POINT(sub, id, a0, a1, a2) do { } while (0)
+#endif /* TRACE_POINTS */
+#endif /* _TRACE_H_ */
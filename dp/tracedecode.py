@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2017 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Decode a DP trace dump (dp/trace.h) to text, records of all lcores
+# merged in time order:
+#   tracedecode.py logs/dp_trace.bin
+
+import sys
+import struct
+import socket
+
+HDR = '<8sQII'
+LCORE_HDR = '<II'
+REC = '<QI3I'
+
+def ip_net(v):
+  return socket.inet_ntoa(struct.pack('<I', v))
+
+def ip_host(v):
+  return socket.inet_ntoa(struct.pack('>I', v))
+
+def dec(v):
+  return '%u' % v
+
+def hexa(v):
+  return '0x%x' % v
+
+# id: (name, (arg name, format) per arg), same order as enum dp_trace_id
+TRACE_POINTS = {
+  1: ('rx_gtpu', (('ue', ip_net),)),
+  2: ('rx_sgi', (('ue', ip_net),)),
+  3: ('rx_bad_cksum', (('ol_flags', hexa), ('port', dec))),
+  4: ('gtpu_decap', (('teid', hexa), ('ue', ip_net))),
+  5: ('gtpu_decap_len', (('data_off', dec), ('data_len', dec),
+                         ('pkt_len', dec))),
+  6: ('gtpu_encap_len', (('data_off', dec), ('data_len', dec),
+                         ('pkt_len', dec))),
+  7: ('ul_sess_miss', (('teid', dec), ('rid', dec))),
+  8: ('dl_sess_key', (('ue', ip_host), ('rid', dec))),
+  9: ('dl_sess_miss', (('ue', ip_host), ('rid', dec))),
+  10: ('adc_dns_hit', (('idx', dec), ('rule_id', dec))),
+}
+
+def main():
+  if len(sys.argv) != 2:
+    print('usage: %s <trace dump>' % sys.argv[0])
+    sys.exit(1)
+
+  data = open(sys.argv[1], 'rb').read()
+  magic, hz, n_lcores, rec_size = struct.unpack_from(HDR, data, 0)
+  if magic != b'DPTRACE1' or rec_size != struct.calcsize(REC):
+    print('%s: not a DP trace dump' % sys.argv[1])
+    sys.exit(1)
+
+  off = struct.calcsize(HDR)
+  recs = []
+  for _ in range(n_lcores):
+    lcore, n = struct.unpack_from(LCORE_HDR, data, off)
+    off += struct.calcsize(LCORE_HDR)
+    for _ in range(n):
+      tsc, tp, a0, a1, a2 = struct.unpack_from(REC, data, off)
+      off += rec_size
+      recs.append((tsc, lcore, tp, (a0, a1, a2)))
+
+  if not recs:
+    return
+  recs.sort()
+  base = recs[0][0]
+  for tsc, lcore, tp, args in recs:
+    name, fmts = TRACE_POINTS.get(tp, ('tp%u' % tp, ()))
+    fields = ' '.join('%s=%s' % (a, f(v)) for (a, f), v in zip(fmts, args))
+    print('%14.3f us lcore %-3u %-16s %s' %
+          ((tsc - base) * 1e6 / hz, lcore, name, fields))
+
+if __name__ == '__main__':
+  main()
@@ -16,6 +16,8 @@
 
 #include <arpa/inet.h>
 
+#include <rte_memcpy.h>
+
 #include "util.h"
 
 void
@@ -32,3 +34,39 @@ construct_udp_hdr(struct rte_mbuf *m, uint16_t len,
 	/* update Udp checksum */
 	udp_hdr->dgram_cksum = 0;
 }
+
+#ifdef JUMBO_FRAMES
+int
+pkt_hdr_pullup_chain(struct rte_mbuf *m, uint32_t len)
+{
+	struct rte_mbuf *seg;
+	uint32_t copy;
+
+	if (len > rte_pktmbuf_pkt_len(m))
+		len = rte_pktmbuf_pkt_len(m);
+	if (rte_pktmbuf_tailroom(m) < len - rte_pktmbuf_data_len(m))
+		return -1;
+
+	while (rte_pktmbuf_data_len(m) < len) {
+		seg = m->next;
+		copy = RTE_MIN(len - rte_pktmbuf_data_len(m),
+				(uint32_t)rte_pktmbuf_data_len(seg));
+		rte_memcpy(rte_pktmbuf_mtod_offset(m, uint8_t *,
+				rte_pktmbuf_data_len(m)),
+				rte_pktmbuf_mtod(seg, uint8_t *), copy);
+		m->data_len += copy;
+		seg->data_off += copy;
+		seg->data_len -= copy;
+
+		if (seg->data_len == 0) {
+			/* drained segments leave the chain */
+			m->next = seg->next;
+			m->nb_segs--;
+			seg->next = NULL;
+			seg->nb_segs = 1;
+			rte_pktmbuf_free_seg(seg);
+		}
+	}
+	return 0;
+}
+#endif	/* JUMBO_FRAMES */
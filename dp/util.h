@@ -107,6 +107,56 @@ static inline struct udp_hdr *get_mtoudp(struct rte_mbuf *m)
 				    ETH_HDR_SIZE + IPv4_HDR_SIZE);
 }
 
+#ifdef JUMBO_FRAMES
+/**
+ * Largest frame received on the ports, 9000 bytes MTU.
+ */
+#define JUMBO_FRAME_MAX_LEN	(9000 + ETHER_HDR_LEN + ETHER_CRC_LEN)
+
+/**
+ * Headers of a pkt kept in its first segment: ether, outer ipv4, udp,
+ * gtpu and the inner ipv4 and l4 headers, with room for options.
+ */
+#define PKT_HDR_PULLUP_LEN	128
+
+/**
+ * Function to move the first len bytes of a chained pkt to its first
+ * segment. Called by pkt_hdr_pullup().
+ *
+ * @param m
+ *	mbuf pointer
+ * @param len
+ *	bytes needed in the first segment
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the first segment has no room for them
+ */
+int
+pkt_hdr_pullup_chain(struct rte_mbuf *m, uint32_t len);
+
+/**
+ * Function to make sure the headers of a pkt are in its first segment,
+ * so that get_mtoip(), get_mtoudp() and get_mtogtpu() can be used on
+ * chained pkts. Single segment pkts and chained pkts with a large first
+ * segment, as received by the NIC, are left as is.
+ *
+ * @param m
+ *	mbuf pointer
+ *
+ * @return
+ *	- 0 on success
+ *	- -1 if the headers could not be moved
+ */
+static inline int pkt_hdr_pullup(struct rte_mbuf *m)
+{
+	if (likely(m->nb_segs == 1 ||
+			rte_pktmbuf_data_len(m) >= PKT_HDR_PULLUP_LEN))
+		return 0;
+	return pkt_hdr_pullup_chain(m, PKT_HDR_PULLUP_LEN);
+}
+#endif	/* JUMBO_FRAMES */
+
 /**
  * Function to construct udp header.
  *
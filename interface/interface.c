@@ -30,7 +30,14 @@
 #include <rte_log.h>
 #include <rte_malloc.h>
 #include <rte_jhash.h>
+#include <rte_cycles.h>
 #include <rte_cfgfile.h>
+#ifdef CP_DP_SHM_RING
+#include <rte_ring.h>
+#include <rte_mempool.h>
+#include <rte_memcpy.h>
+#include <rte_errno.h>
+#endif
 
 #include "interface.h"
 #include "util.h"
@@ -46,6 +53,7 @@
 #endif
 #ifndef CP_BUILD
 #include "cdr.h"
+#include "trace.h"
 #endif
 
 /*
@@ -58,6 +66,12 @@ struct in_addr cp_comm_ip;
 uint16_t dp_comm_port;
 uint16_t cp_comm_port;
 
+#if defined(CP_BUILD) && defined(MULTI_DP)
+uint8_t nb_dp = 1;
+udp_sock_t dp_sock[MAX_DP];
+struct in_addr dp_s1u_ip[MAX_DP];
+#endif
+
 #ifdef SDN_ODL_BUILD
 struct in_addr fpc_ip;
 uint16_t fpc_port;
@@ -110,17 +124,93 @@ int unset_comm_type(enum cp_dp_comm id)
 	}
 	return 0;
 }
+#ifdef CP_DP_COALESCE
+/**
+ * Process the msgs of a frame in order. Each is copied to an aligned
+ * msgbuf, with the dp_id of the frame.
+ *
+ * @return
+ *	0 - success
+ *	-1 - fail, the msgs ahead of the malformed record are processed
+ */
+static int process_comm_frame(struct msgbuf *frame)
+{
+	static struct msgbuf msg;
+	uint8_t *pos = (uint8_t *)frame + CP_DP_FRAME_HDR_LEN;
+	uint8_t *end = (uint8_t *)frame + CP_DP_FRAME_SIZE;
+	struct msg_frame_rec *rec;
+	uint32_t i;
+
+	if (frame->msg_union.frame.len > (uint32_t)(end - pos))
+		goto malformed;
+	end = pos + frame->msg_union.frame.len;
+
+	msg.dp_id = frame->dp_id;
+	for (i = 0; i < frame->msg_union.frame.n; i++) {
+		rec = (struct msg_frame_rec *)pos;
+		if (pos + sizeof(*rec) > end
+				|| rec->len > end - pos - sizeof(*rec)
+				|| rec->mtype == MSG_FRAME)
+			goto malformed;
+
+		msg.mtype = rec->mtype;
+		memcpy(&msg.msg_union, rec + 1, rec->len);
+		if (MSGBUF_HDR_LEN + rec->len < dp_msg_len(&msg))
+			goto malformed;
+		process_comm_msg(&msg);
+		pos += sizeof(*rec) + rec->len;
+	}
+	return 0;
+
+malformed:
+	RTE_LOG(ERR, DP, "Malformed msg frame !!!\n");
+	return -1;
+}
+#endif /* CP_DP_COALESCE */
+
+#ifndef CP_BUILD
+/**
+ * Account the processing cycles of a msg of type mtype.
+ */
+static inline void
+iface_msg_stats_add(uint16_t mtype, uint64_t cycles)
+{
+	struct iface_msg_stats *st = &iface_ipc_stats.msg[mtype];
+
+	st->cnt++;
+	st->cycles += cycles;
+	if (cycles > st->max_cycles)
+		st->max_cycles = cycles;
+}
+#endif
+
 int process_comm_msg(void *buf)
 {
 	struct msgbuf *rbuf = (struct msgbuf *)buf;
 	struct ipc_node *cb;
+#ifndef CP_BUILD
+	uint64_t cycles;
+	int ret;
+#endif
 
 	if (rbuf->mtype >= MSG_END)
 		return -1;
+#ifdef CP_DP_COALESCE
+	if (rbuf->mtype == MSG_FRAME)
+		return process_comm_frame(rbuf);
+#endif
 	/* Callback APIs */
 	cb = &basenode[rbuf->mtype];
+#ifdef CP_BUILD
 	return cb->msg_cb(rbuf);
+#else
+	cycles = rte_rdtsc();
+	ret = cb->msg_cb(rbuf);
+	iface_msg_stats_add(rbuf->mtype, rte_rdtsc() - cycles);
+	return ret;
+#endif
 }
+#ifndef CP_DP_SHM_RING
 static int
 udp_send_socket(void *msg_payload, uint32_t size)
 {
@@ -132,16 +222,126 @@ udp_send_socket(void *msg_payload, uint32_t size)
 static int
 udp_recv_socket(void *msg_payload, uint32_t size)
 {
-	uint32_t bytes = recvfrom(my_sock.sock_fd, msg_payload, size, 0,
+	ssize_t bytes = recvfrom(my_sock.sock_fd, msg_payload, size, 0,
 			NULL, NULL);
-	if (bytes < size) {
+
+	/* Messages only carry the payload of their type */
+	if (bytes < (ssize_t)MSGBUF_HDR_LEN) {
 		RTE_LOG(ERR, DP, "Failed recv msg !!!\n");
 		return -1;
 	}
+	if ((size_t)bytes < dp_msg_len(msg_payload)) {
+		RTE_LOG(ERR, DP, "Truncated msg !!!\n");
+		return -1;
+	}
 	return 0;
 }
 #endif
+#else
+/*
+ * Shared memory ring setup
+ */
+static struct rte_ring *ring_tx;
+static struct rte_ring *ring_rx;
+static struct rte_mempool *ring_msg_pool;
+
+/**
+ * Init shared memory rings. DP creates the rings and message pool, CP
+ * looks them up.
+ *
+ * @return
+ *	0 - success
+ *	-1 - fail
+ */
+static int
+ring_init(void)
+{
 #ifdef CP_BUILD
+	ring_tx = rte_ring_lookup(CP_DP_RING_NAME);
+	ring_rx = rte_ring_lookup(DP_CP_RING_NAME);
+	ring_msg_pool = rte_mempool_lookup(CP_DP_MSG_POOL_NAME);
+	if (ring_tx == NULL || ring_rx == NULL || ring_msg_pool == NULL)
+		rte_exit(EXIT_FAILURE, "CP DP shared rings not found, start DP "
+			"first and run CP with --proc-type=secondary "
+			"--file-prefix dp !!!\n");
+#else
+	ring_rx = rte_ring_create(CP_DP_RING_NAME, CP_DP_RING_SIZE,
+			rte_socket_id(), RING_F_SC_DEQ);
+	ring_tx = rte_ring_create(DP_CP_RING_NAME, CP_DP_RING_SIZE,
+			rte_socket_id(), RING_F_SC_DEQ);
+	ring_msg_pool = rte_mempool_create(CP_DP_MSG_POOL_NAME,
+			CP_DP_MSG_POOL_SIZE, sizeof(struct msgbuf), 0, 0,
+			NULL, NULL, NULL, NULL, rte_socket_id(), 0);
+	if (ring_tx == NULL || ring_rx == NULL || ring_msg_pool == NULL)
+		rte_exit(EXIT_FAILURE, "Create CP DP shared rings failed: %s\n",
+			rte_strerror(rte_errno));
+#endif
+	return 0;
+}
+
+/**
+ * Copy msg into a shared msgbuf and enqueue it to the peer.
+ * Only the given size, i.e. the payload of the msg type, is copied.
+ */
+static int
+ring_send(void *msg_payload, uint32_t size)
+{
+	void *msg;
+
+	if (size > sizeof(struct msgbuf) ||
+			rte_mempool_get(ring_msg_pool, &msg) < 0) {
+		RTE_LOG(ERR, DP, "Failed to send msg !!!\n");
+		return -1;
+	}
+	rte_memcpy(msg, msg_payload, size);
+	if (rte_ring_enqueue(ring_tx, msg) == -ENOBUFS) {
+		rte_mempool_put(ring_msg_pool, msg);
+		RTE_LOG(ERR, DP, "Failed to send msg, ring full !!!\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int
+ring_recv(void *msg_payload, uint32_t size)
+{
+	void *msg;
+
+	if (rte_ring_dequeue(ring_rx, &msg) < 0)
+		return -1;
+	rte_memcpy(msg_payload, msg, RTE_MIN(size, sizeof(struct msgbuf)));
+	rte_mempool_put(ring_msg_pool, msg);
+	return 0;
+}
+
+int
+ring_process_msgs(unsigned max)
+{
+	void *msgs[CP_DP_RING_BURST];
+	unsigned i, n, total = 0;
+
+	while (total < max) {
+		n = rte_ring_dequeue_burst(ring_rx, msgs,
+				RTE_MIN(max - total, CP_DP_RING_BURST));
+		if (n == 0)
+			break;
+
+		for (i = 0; i < n; i++)
+			process_comm_msg(msgs[i]);
+
+		rte_mempool_put_bulk(ring_msg_pool, msgs, n);
+		total += n;
+	}
+	return total;
+}
+
+unsigned
+ring_pending_msgs(void)
+{
+	return rte_ring_count(ring_rx);
+}
+#endif /* CP_DP_SHM_RING */
+#if defined(CP_BUILD) && !defined(CP_DP_SHM_RING)
 /**
  * Init listen socket.
  *
@@ -161,14 +361,37 @@ udp_init_cp_socket(void)
 		rte_exit(EXIT_FAILURE, "Create CP UDP Socket Failed "
 			"for IP %s:%u!!!\n",
 			inet_ntoa(dp_comm_ip), dp_comm_port);
+#ifdef MULTI_DP
+	uint8_t dp;
+
+	dp_sock[0].other_addr = my_sock.other_addr;
+	for (dp = 0; dp < nb_dp; dp++) {
+		dp_sock[dp].my_addr = my_sock.my_addr;
+		dp_sock[dp].sock_fd = my_sock.sock_fd;
+	}
+#endif
+
+	return 0;
+}
 
+#ifdef MULTI_DP
+int
+udp_send_dp(uint8_t dp, void *msg_payload, uint32_t size)
+{
+	if (dp >= nb_dp ||
+			__send_udp_packet(&dp_sock[dp], msg_payload, size) < 0) {
+		RTE_LOG(ERR, DP, "Failed to send msg to DP %u !!!\n", dp);
+		return -1;
+	}
 	return 0;
 }
+#endif
 
 
-#endif		/* CP_BUILD */
+#endif		/* CP_BUILD && !CP_DP_SHM_RING */
 
 #ifndef CP_BUILD
+#ifndef CP_DP_SHM_RING
 /**
  * Init listen socket.
  *
@@ -186,6 +409,7 @@ udp_init_dp_socket(void)
 			inet_ntoa(cp_comm_ip), cp_comm_port);
 	return 0;
 }
+#endif /* !CP_DP_SHM_RING */
 
 /**
  * UDP packet receive API.
@@ -496,36 +720,23 @@ get_sdf_indices(char *sdf_idx, uint32_t *out_sdf_idx)
 }
 
 /**
- * @Name : zmq_buf_process
- * @argument :
- * 	[IN] zmqmsgbuf_rx : Pointer to received zmq buffer
- * 	[IN] zmqmsglen : Length of the zmq buffer
- * @return : 0 - success
- * @Description : Converts zmq message type to session_info or
- * respective rules info
+ * @brief Decodes a session msg of the FPC controller into sess, and the
+ * ids of its response into zmqmsgbuf_tx.
+ *
+ * @return
+ *	msg type of sess, MSG_END if not a session msg
  */
-
-int
-zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
+static uint16_t
+zmq_sess_decode(struct zmqbuf *zmqmsgbuf_rx, struct session_info *sess,
+		struct zmqbuf *zmqmsgbuf_tx)
 {
-	int ret;
-	struct msgbuf buf = {0};
-	struct zmqbuf zmqmsgbuf_tx;
-	struct msgbuf *rbuf = &buf;
-	struct session_info *sess = &rbuf->msg_union.sess_entry;
-
 	memset(sess, 0, sizeof(*sess));
 
-	rbuf->mtype = MSG_END;
-
 	switch (zmqmsgbuf_rx->type) {
 	case CREATE_SESSION: {
 		struct create_session_t *csm =
 			&zmqmsgbuf_rx->msg_union.create_session_msg;
 
-		rbuf->mtype = MSG_SESS_CRE;
-		rbuf->dp_id.id = DPN_ID;
-
 		sess->ue_addr.iptype = IPTYPE_IPV4;
 		sess->ue_addr.u.ipv4_addr = ntohl(csm->ue_ipv4);
 		sess->ul_s1_info.enb_addr.u.ipv4_addr = 0;
@@ -544,17 +755,15 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 
 		sess->sess_id = rte_bswap64(csm->session_id);
 		sess->client_id = csm->client_id;
-		zmqmsgbuf_tx.msg_union.dpn_response.client_id = csm->client_id;
-		zmqmsgbuf_tx.msg_union.dpn_response.op_id = csm->op_id;
-		zmqmsgbuf_tx.topic_id = csm->controller_topic;
-		break;
+		zmqmsgbuf_tx->msg_union.dpn_response.client_id = csm->client_id;
+		zmqmsgbuf_tx->msg_union.dpn_response.op_id = csm->op_id;
+		zmqmsgbuf_tx->topic_id = csm->controller_topic;
+		return MSG_SESS_CRE;
 	}
 
 	case MODIFY_BEARER: {
 		struct modify_bearer_t *mbm =
 			&zmqmsgbuf_rx->msg_union.modify_bearer_msg;
-		rbuf->mtype = MSG_SESS_MOD;
-		rbuf->dp_id.id = DPN_ID;
 
 		sess->ue_addr.u.ipv4_addr = 0;
 		sess->ul_s1_info.enb_addr.iptype = IPTYPE_IPV4;
@@ -574,17 +783,15 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 		sess->dl_pcc_rule_id[0] = 1;
 
 		sess->sess_id = rte_bswap64(mbm->session_id);
-		zmqmsgbuf_tx.msg_union.dpn_response.client_id = mbm->client_id;
-		zmqmsgbuf_tx.msg_union.dpn_response.op_id = mbm->op_id;
-		zmqmsgbuf_tx.topic_id = mbm->controller_topic;
-		break;
+		zmqmsgbuf_tx->msg_union.dpn_response.client_id = mbm->client_id;
+		zmqmsgbuf_tx->msg_union.dpn_response.op_id = mbm->op_id;
+		zmqmsgbuf_tx->topic_id = mbm->controller_topic;
+		return MSG_SESS_MOD;
 	}
 
 	case DELETE_SESSION: {
 		struct delete_session_t *dsm =
 			&zmqmsgbuf_rx->msg_union.delete_session_msg;
-		rbuf->mtype = MSG_SESS_DEL;
-		rbuf->dp_id.id = DPN_ID;
 
 		sess->ue_addr.u.ipv4_addr = 0;
 		sess->ul_s1_info.enb_addr.u.ipv4_addr = 0;
@@ -596,11 +803,115 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 
 		sess->sess_id = rte_bswap64(dsm->session_id);
 
-		zmqmsgbuf_tx.msg_union.dpn_response.client_id = dsm->client_id;
-		zmqmsgbuf_tx.msg_union.dpn_response.op_id = dsm->op_id;
-		zmqmsgbuf_tx.topic_id = dsm->controller_topic;
-		break;
+		zmqmsgbuf_tx->msg_union.dpn_response.client_id = dsm->client_id;
+		zmqmsgbuf_tx->msg_union.dpn_response.op_id = dsm->op_id;
+		zmqmsgbuf_tx->topic_id = dsm->controller_topic;
+		return MSG_SESS_DEL;
 	}
+	default:
+		return MSG_END;
+	}
+}
+
+/**
+ * @brief Sends the DPN_RESPONSE of a msg to the FPC controller.
+ *
+ * @return
+ *	0 - success
+ *	-1 - fail
+ */
+static int
+zmq_mbuf_respond(struct zmqbuf *zmqmsgbuf_tx, int ret, uint8_t type)
+{
+	if (ret < 0)
+		zmqmsgbuf_tx->msg_union.dpn_response.cause =
+			GTPV2C_CAUSE_SYSTEM_FAILURE;
+	else
+		zmqmsgbuf_tx->msg_union.dpn_response.cause =
+			GTPV2C_CAUSE_REQUEST_ACCEPTED;
+
+	zmqmsgbuf_tx->type = DPN_RESPONSE;
+	ret = do_zmq_mbuf_send(zmqmsgbuf_tx);
+
+	if (ret < 0)
+		printf("do_zmq_mbuf_send failed for type: %"PRIu8"\n", type);
+
+	return ret;
+}
+
+#ifdef ZMQ_BATCH
+/** DP session ops of the session msgs, by msg type */
+static int (*const zmq_sess_ops[MSG_END])(struct dp_id,
+		struct session_info *) = {
+	[MSG_SESS_CRE] = dp_session_create,
+	[MSG_SESS_MOD] = dp_session_modify,
+	[MSG_SESS_DEL] = dp_session_delete,
+};
+
+/**
+ * @brief Applies a session msg of the FPC controller, the bulk of the
+ * controller bursts, straight from its session_info: no msgbuf, no msg
+ * callback and no copy of the session_info on the way.
+ *
+ * @return
+ *	0 - success
+ *	-1 - fail
+ */
+static int
+zmq_sess_process(struct zmqbuf *zmqmsgbuf_rx)
+{
+	struct dp_id dp_id = {.id = DPN_ID};
+	struct session_info sess;
+	struct zmqbuf zmqmsgbuf_tx;
+	uint64_t cycles;
+	uint16_t mtype;
+	int ret;
+
+	mtype = zmq_sess_decode(zmqmsgbuf_rx, &sess, &zmqmsgbuf_tx);
+	cycles = rte_rdtsc();
+	ret = zmq_sess_ops[mtype](dp_id, &sess);
+	iface_msg_stats_add(mtype, rte_rdtsc() - cycles);
+
+	return zmq_mbuf_respond(&zmqmsgbuf_tx, ret, zmqmsgbuf_rx->type);
+}
+#endif /* ZMQ_BATCH */
+
+/**
+ * @Name : zmq_buf_process
+ * @argument :
+ * 	[IN] zmqmsgbuf_rx : Pointer to received zmq buffer
+ * 	[IN] zmqmsglen : Length of the zmq buffer
+ * @return : 0 - success
+ * @Description : Converts zmq message type to session_info or
+ * respective rules info
+ */
+
+int
+zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
+{
+	int ret;
+	struct msgbuf buf;
+	struct zmqbuf zmqmsgbuf_tx;
+	struct msgbuf *rbuf = &buf;
+
+	/* msg_union is sized for the bulk and frame msgs, only the entry of
+	 * the msg type is cleared */
+	memset(&rbuf->dp_id, 0, sizeof(rbuf->dp_id));
+
+	rbuf->mtype = MSG_END;
+
+	switch (zmqmsgbuf_rx->type) {
+	case CREATE_SESSION:
+	case MODIFY_BEARER:
+	case DELETE_SESSION:
+#ifdef ZMQ_BATCH
+		return zmq_sess_process(zmqmsgbuf_rx);
+#else
+		rbuf->mtype = zmq_sess_decode(zmqmsgbuf_rx,
+				&rbuf->msg_union.sess_entry, &zmqmsgbuf_tx);
+		rbuf->dp_id.id = DPN_ID;
+		break;
+#endif
 
 	case ADC_RULE: {
 		/*
@@ -613,6 +924,7 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 		struct adc_rules *adc =
 			&(rbuf->msg_union.adc_filter_entry);
 
+		memset(adc, 0, sizeof(*adc));
 		rbuf->mtype = MSG_ADC_TBL_ADD;
 		rbuf->dp_id.id = DPN_ID;
 
@@ -641,6 +953,7 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 		uint8_t sdf_idx[MAX_SDF_STR_LEN]={0};
 		uint8_t len=0, offset = 0;
 
+		memset(pcc, 0, sizeof(*pcc));
 		rbuf->mtype = MSG_PCC_TBL_ADD;
 		rbuf->dp_id.id = DPN_ID;
 
@@ -705,6 +1018,7 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 			&(zmqmsgbuf_rx->msg_union.mtr_entry_m);
 		struct mtr_entry *mtr = &(rbuf->msg_union.mtr_entry);
 
+		memset(mtr, 0, sizeof(*mtr));
 		rbuf->mtype = MSG_MTR_ADD;
 		rbuf->dp_id.id = DPN_ID;
 
@@ -713,6 +1027,9 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 		mtr->mtr_param.cir = rte_bswap64(mtr_t->cir);
 		mtr->mtr_param.cbs = rte_bswap64(mtr_t->cbs);
 		mtr->mtr_param.ebs = rte_bswap64(mtr_t->ebs);
+		/* peak rate is not carried by the ZMQ meter table */
+		mtr->mtr_param.pir = 0;
+		mtr->mtr_param.pbs = 0;
 		mtr->metering_method = mtr_t->metering_method;
 #ifdef PRINT_NEW_RULE_ENTRY
 		print_mtr_val(mtr);
@@ -731,6 +1048,7 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 			&(zmqmsgbuf_rx->msg_union.sdf_entry_m);
 		struct pkt_filter *sdf = &(rbuf->msg_union.pkt_filter_entry);
 
+		memset(sdf, 0, sizeof(*sdf));
 		rbuf->mtype = MSG_SDF_ADD;
 		rbuf->dp_id.id = DPN_ID;
 
@@ -768,21 +1086,7 @@ zmq_mbuf_process(struct zmqbuf *zmqmsgbuf_rx, int zmqmsglen)
 	}
 
 	ret = process_comm_msg((void *)rbuf);
-	if (ret < 0)
-		zmqmsgbuf_tx.msg_union.dpn_response.cause =
-			GTPV2C_CAUSE_SYSTEM_FAILURE;
-	else
-		zmqmsgbuf_tx.msg_union.dpn_response.cause =
-			GTPV2C_CAUSE_REQUEST_ACCEPTED;
-
-	zmqmsgbuf_tx.type = DPN_RESPONSE;
-	ret = do_zmq_mbuf_send(&zmqmsgbuf_tx);
-
-	if (ret < 0)
-		printf("do_zmq_mbuf_send failed for type: %"PRIu8"\n",
-				zmqmsgbuf_rx->type);
-
-	return ret;
+	return zmq_mbuf_respond(&zmqmsgbuf_tx, ret, zmqmsgbuf_rx->type);
 }
 
 static int
@@ -832,6 +1136,34 @@ static void read_interface_config(void)
 	SET_CONFIG_IP(cp_comm_ip, file, "0", file_entry);
 	SET_CONFIG_PORT(cp_comm_port, file, "0", file_entry);
 
+#if defined(CP_BUILD) && defined(MULTI_DP)
+	/* the S1U ip of DP 0 defaults to the s1u_sgw_ip of the CP */
+	file_entry = rte_cfgfile_get_entry(file, "0", "s1u_sgw_ip");
+	if (file_entry != NULL && inet_aton(file_entry, &dp_s1u_ip[0]) == 0)
+		rte_panic("Invalid s1u_sgw_ip in %s", IFACE_FILE);
+
+	/* DP i is dp_comm_ip:port of section [i], up to the first gap */
+	for (nb_dp = 1; nb_dp < MAX_DP; nb_dp++) {
+		char section[4];
+		struct in_addr dp_comm_ip;
+		uint16_t dp_comm_port;
+		struct in_addr s1u_sgw_ip;
+
+		snprintf(section, sizeof(section), "%u", nb_dp);
+		if (!rte_cfgfile_has_section(file, section))
+			break;
+		SET_CONFIG_IP(dp_comm_ip, file, section, file_entry);
+		SET_CONFIG_PORT(dp_comm_port, file, section, file_entry);
+		SET_CONFIG_IP(s1u_sgw_ip, file, section, file_entry);
+
+		dp_sock[nb_dp].other_addr.sin_family = AF_INET;
+		dp_sock[nb_dp].other_addr.sin_port = htons(dp_comm_port);
+		dp_sock[nb_dp].other_addr.sin_addr = dp_comm_ip;
+		dp_s1u_ip[nb_dp] = s1u_sgw_ip;
+	}
+	printf("IFACE: %u DP(s) configured\n", nb_dp);
+#endif
+
 #else	/* Communication over the ZMQ */
 
 	const char *zmq_proto = "tcp";
@@ -881,6 +1213,13 @@ void iface_module_constructor(void)
 				NULL,
 				NULL);
 	set_comm_type(COMM_SOCKET);
+#elif defined CP_DP_SHM_RING
+	register_comm_msg_cb(COMM_RING,
+				ring_init,
+				ring_send,
+				ring_recv,
+				NULL);
+	set_comm_type(COMM_RING);
 #else
 	register_comm_msg_cb(COMM_SOCKET,
 				udp_init_cp_socket,
@@ -892,11 +1231,19 @@ void iface_module_constructor(void)
 #else		/* CP_BUILD */
 #ifndef SDN_ODL_BUILD
 	RTE_LOG(NOTICE, DP, "IFACE: DP Initialization\n");
+#ifdef CP_DP_SHM_RING
+	register_comm_msg_cb(COMM_RING,
+				ring_init,
+				ring_send,
+				ring_recv,
+				NULL);
+#else
 	register_comm_msg_cb(COMM_SOCKET,
 				udp_init_dp_socket,
 				udp_send_socket,
 				udp_recv_socket,
 				NULL);
+#endif /* CP_DP_SHM_RING */
 #else
 /* Code Rel. Jan 30, 2017
 * Note: PCC, ADC, Session table initial creation on the DP sent over UDP by CP
@@ -927,6 +1274,10 @@ void sig_handler(int signo)
 
 #ifndef CP_BUILD
 		cdr_close();
+#ifdef TRACE_POINTS
+		if (dp_trace_mask)
+			dp_trace_dump(DP_TRACE_FILE);
+#endif
 #endif
 		rte_exit(EXIT_SUCCESS, "received SIGINT\n");
 	}
@@ -49,13 +49,82 @@ extern uint16_t cp_nb_port;
 
 extern udp_sock_t my_sock;
 
+extern struct in_addr dp_comm_ip;
+extern uint16_t dp_comm_port;
+
+#ifdef MULTI_DP
+#if defined(SDN_ODL_BUILD) || defined(CP_DP_SHM_RING)
+#error "MULTI_DP is only supported with the UDP transport"
+#endif
+/**
+ * One CP drives up to MAX_DP DPs over UDP. DP 0 is the dp_comm_ip:port of
+ * section [0] of interface.cfg, DP i the one of section [i].
+ */
+#define MAX_DP			8
+/** Interval of the DP load reports, see struct msg_dp_load */
+#define DP_LOAD_INTERVAL_MS	1000
+
+#ifdef CP_BUILD
+/** Number of DPs configured */
+extern uint8_t nb_dp;
+/** Sockets of the DPs, sharing the fd of my_sock */
+extern udp_sock_t dp_sock[MAX_DP];
+/** S1U SGW ip of each DP, s1u_sgw_ip of its section, 0 for the CP one */
+extern struct in_addr dp_s1u_ip[MAX_DP];
+
+/**
+ * Send msg to a DP.
+ * @param dp
+ *	dp - index of the DP, below nb_dp.
+ * @param msg_payload
+ *	msg_payload - message payload.
+ * @param size
+ *	size - size of message payload.
+ *
+ * @return
+ *	0 - success
+ *	-1 - fail
+ */
+int udp_send_dp(uint8_t dp, void *msg_payload, uint32_t size);
+#endif /* CP_BUILD */
+#endif /* MULTI_DP */
+
 /* CP DP communication message type*/
 enum cp_dp_comm {
 	COMM_QUEUE,
 	COMM_SOCKET,
 	COMM_ZMQ,
+	COMM_RING,
 	COMM_END,
 };
+
+#ifdef CP_DP_SHM_RING
+#ifdef SDN_ODL_BUILD
+#error "CP_DP_SHM_RING is not supported with SDN_ODL_BUILD"
+#endif
+/**
+ * Shared memory transport between a co-located CP and DP. The DP, as the
+ * DPDK primary process, creates the rings and message pool; the CP attaches
+ * to them as a secondary process (--proc-type=secondary --file-prefix dp).
+ */
+#define CP_DP_RING_NAME		"cp_dp_msg_ring"
+#define DP_CP_RING_NAME		"dp_cp_msg_ring"
+#define CP_DP_MSG_POOL_NAME	"cp_dp_msg_pool"
+/** Ring size, power of 2 */
+#define CP_DP_RING_SIZE		1024
+/** msgbufs shared by both directions */
+#define CP_DP_MSG_POOL_SIZE	(2 * CP_DP_RING_SIZE - 1)
+/** Max msgs handled per poll */
+#define CP_DP_RING_BURST	32
+/** CP listener back off when the ring is empty, in us */
+#define CP_DP_RING_IDLE_US	100
+
+/** Communication type carrying msgbufs between CP and DP */
+#define COMM_CP_DP		COMM_RING
+#else
+#define COMM_CP_DP		COMM_SOCKET
+#endif /* CP_DP_SHM_RING */
+
 /**
  * CP DP Communication message structure.
  */
@@ -123,6 +192,25 @@ int unset_comm_type(enum cp_dp_comm id);
  */
 int process_comm_msg(void *buf);
 
+#ifdef CP_DP_SHM_RING
+/**
+ * Dequeue up to max msgbufs from the shared receive ring and process them
+ * in place, then return them to the shared message pool.
+ *
+ * @param max
+ *	Max msgs to process
+ * @return
+ *	Number of msgs processed
+ */
+int ring_process_msgs(unsigned max);
+
+/**
+ * @return
+ *	Number of msgs queued on the shared receive ring
+ */
+unsigned ring_pending_msgs(void);
+#endif /* CP_DP_SHM_RING */
+
 /**
  * @brief Initialize iface message passing
  *
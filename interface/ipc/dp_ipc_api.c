@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE     /* Expose declaration of recvmmsg() */
 #include <stdint.h>
+#include <errno.h>
+#include <sys/socket.h>
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <time.h>
@@ -52,6 +55,49 @@ void iface_init_ipc_node(void)
 		exit(0);
 }
 
+#if defined(SDN_ODL_BUILD) && defined(ZMQ_BATCH) && !defined(CP_BUILD)
+/**
+ * @brief Drains up to ZMQ_RX_BURST msgs of the sub socket, each processed
+ * in the zmq message it was received in. Only msgs shorter than struct
+ * zmqbuf are copied, zero filled as zmq_mbuf_rcv leaves them.
+ *
+ * @return
+ *	number of msgs processed
+ */
+static int
+zmq_remove_burst(void)
+{
+	zmq_msg_t msg;
+	struct zmqbuf zbuf;
+	struct zmqbuf *mbuf;
+	int i, rc;
+
+	for (i = 0; i < ZMQ_RX_BURST; i++) {
+		zmq_msg_init(&msg);
+		rc = zmq_mbuf_rcv_msg(&msg, i);
+		if (rc < 0 && i) {
+			zmq_msg_close(&msg);
+			break;
+		}
+
+		if (rc >= (int)sizeof(struct zmqbuf)) {
+			mbuf = zmq_msg_data(&msg);
+		} else {
+			memset(&zbuf, 0, sizeof(zbuf));
+			if (rc > 0)
+				memcpy(&zbuf, zmq_msg_data(&msg), rc);
+			mbuf = &zbuf;
+		}
+
+		rc = dp_lifecycle_process(mbuf, rc);
+		if (rc > 0)
+			zmq_mbuf_process(mbuf, rc);
+		zmq_msg_close(&msg);
+	}
+	return i;
+}
+#endif
+
 /**
  * @brief Function to Process msgs.
  *
@@ -60,6 +106,10 @@ int iface_remove_que(enum cp_dp_comm id)
 {
 
 
+#ifdef CP_DP_SHM_RING
+	if (id == COMM_RING)
+		return ring_process_msgs(CP_DP_RING_BURST);
+#endif
 #ifdef CP_BUILD
 	RTE_SET_USED(id);
 
@@ -75,6 +125,9 @@ int iface_remove_que(enum cp_dp_comm id)
 		return 0;
 #ifdef SDN_ODL_BUILD
 	if (id == COMM_ZMQ) {
+#ifdef ZMQ_BATCH
+		return zmq_remove_burst();
+#else
 		int rc;
 		struct zmqbuf zbuf = {0};
 
@@ -84,6 +137,7 @@ int iface_remove_que(enum cp_dp_comm id)
 		if (rc <= 0)
 			return rc;
 		return zmq_mbuf_process(&zbuf, rc);
+#endif
 	}
 #endif /*SDN_ODL_BUILD*/
 	if (id == COMM_SOCKET) {
@@ -100,6 +154,22 @@ int iface_remove_que(enum cp_dp_comm id)
 }
 
 
+#ifdef CP_BUILD
+#ifdef CP_DP_SHM_RING
+/**
+ * @brief Function to Poll the shared memory ring.
+ *
+ */
+int iface_process_ipc_msgs(void)
+{
+	int ret;
+
+	ret = iface_remove_que(COMM_RING);
+	if (ret == 0)
+		usleep(CP_DP_RING_IDLE_US);
+	return ret;
+}
+#else
 /**
  * @brief Function to Poll message que.
  *
@@ -134,9 +204,86 @@ int iface_process_ipc_msgs(void)
 		perror("select");	/* error occurred in select() */
 	} else if (rv > 0) {
 		/* one or both of the descriptors have data */
-		if (FD_ISSET(my_sock.sock_fd, &readfds))
+		if (FD_ISSET(my_sock.sock_fd, &readfds)) {
 			ret = iface_remove_que(COMM_SOCKET);
+		}
 	}
 	return ret;
 }
+#endif /* CP_DP_SHM_RING */
+#else
+struct iface_ipc_stats iface_ipc_stats;
+
+#ifndef CP_DP_SHM_RING
+static struct msgbuf iface_rx_bufs[IFACE_MSG_BUDGET];
+
+/**
+ * @brief Function to receive up to budget msgs from the UDP socket with one
+ * non-blocking recvmmsg() and process them.
+ *
+ */
+static int iface_udp_poll(uint32_t budget, uint32_t *depth)
+{
+	struct mmsghdr mmsg[IFACE_MSG_BUDGET];
+	struct iovec iov[IFACE_MSG_BUDGET];
+	uint32_t i;
+	int n;
+
+	memset(mmsg, 0, sizeof(mmsg[0]) * budget);
+	for (i = 0; i < budget; i++) {
+		iov[i].iov_base = &iface_rx_bufs[i];
+		iov[i].iov_len = sizeof(struct msgbuf);
+		mmsg[i].msg_hdr.msg_iov = &iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	n = recvmmsg(my_sock.sock_fd, mmsg, budget, MSG_DONTWAIT, NULL);
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			perror("recvmmsg");
+		*depth = 0;
+		return 0;
+	}
+	*depth = n;
 
+	for (i = 0; i < (uint32_t)n; i++) {
+		/* Messages only carry the payload of their type */
+		if (mmsg[i].msg_len < MSGBUF_HDR_LEN) {
+			RTE_LOG(ERR, DP, "Failed recv msg !!!\n");
+			continue;
+		}
+		process_comm_msg((void *)&iface_rx_bufs[i]);
+	}
+	return n;
+}
+#endif /* !CP_DP_SHM_RING */
+
+int iface_poll_ipc_msgs(uint32_t budget)
+{
+	uint64_t start_tsc = rte_rdtsc();
+	uint32_t depth;
+	int n;
+
+	if (budget > IFACE_MSG_BUDGET)
+		budget = IFACE_MSG_BUDGET;
+
+#ifdef CP_DP_SHM_RING
+	depth = ring_pending_msgs();
+	n = ring_process_msgs(budget);
+#else
+	n = iface_udp_poll(budget, &depth);
+#endif
+
+	iface_ipc_stats.polls++;
+	iface_ipc_stats.msgs += n;
+	if (depth >= budget)
+		iface_ipc_stats.budget_full++;
+	iface_ipc_stats.depth = depth;
+	if (depth > iface_ipc_stats.max_depth)
+		iface_ipc_stats.max_depth = depth;
+
+	epc_stage_stats_update(&epc_app.iface_stats,
+			rte_rdtsc() - start_tsc, n);
+	return n;
+}
+#endif /* CP_BUILD */
@@ -56,10 +56,63 @@ enum dp_msg_type {
 	MSG_EXP_CDR,
 	/* DDN from DP to CP*/
 	MSG_DDN,
+	/* Session Bearer Map, MSG_SESS_BULK_MAX sessions per msg*/
+	MSG_SESS_BULK_CRE,
+	MSG_SESS_BULK_MOD,
+	MSG_SESS_BULK_DEL,
+	/* Export the CDRs of session id ranges */
+	MSG_EXP_CDR_BULK,
+	/* Load report from DP to CP*/
+	MSG_DP_LOAD,
+	/* Coalesced msgs from CP to DP, see struct msg_frame*/
+	MSG_FRAME,
+	/* SDF filters and ADC rules, MSG_RULE_BULK_MAX rules per msg*/
+	MSG_SDF_BULK_ADD,
+	MSG_ADC_BULK_ADD,
+	/* Session the DP reclaimed for inactivity, DP to CP*/
+	MSG_SESS_RECLAIM,
 
 	MSG_END,
 };
 
+/* Bulk session msg payload */
+struct msg_sess_bulk {
+	uint32_t n;		/* number of sessions */
+	struct session_info sess[MSG_SESS_BULK_MAX];
+} __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
+
+/* Bulk rule msg payload. The rules of a batch are built once, after the
+ * msg with more cleared. */
+struct msg_rule_bulk {
+	uint32_t n;		/* number of rules */
+	uint8_t more;		/* more msgs of the batch follow */
+	union {
+		struct pkt_filter sdf[MSG_RULE_BULK_MAX];
+		struct adc_rules adc[MSG_RULE_BULK_MAX];
+	} u;
+} __attribute__((packed, aligned(RTE_CACHE_LINE_SIZE)));
+
+/* DP load report payload, sent every DP_LOAD_INTERVAL_MS */
+struct msg_dp_load {
+	struct in_addr dp_ip;	/* dp_comm_ip of the DP */
+	uint16_t dp_port;	/* dp_comm_port of the DP */
+	uint32_t kpps;		/* NIC rx, thousand pkts per second */
+	uint32_t drops;		/* NIC rx drops per second */
+};
+
+/* Frame payload, followed by n records of a struct msg_frame_rec and
+ * the msg_union bytes of the msg. The msgs of a frame share its dp_id. */
+struct msg_frame {
+	uint32_t n;		/* number of records */
+	uint32_t len;		/* bytes of the records */
+} __attribute__((packed));
+
+/* Frame record header */
+struct msg_frame_rec {
+	uint16_t len;		/* bytes of msg_union that follow */
+	uint16_t mtype;		/* type of the msg */
+} __attribute__((packed));
+
 /* Table Callback msg payload */
 struct cb_args_table {
 	char name[MAX_LEN];	/* table name */
@@ -81,8 +134,28 @@ struct msgbuf {
 		struct mtr_entry mtr_entry;
 		struct cb_args_table msg_table;
 		struct msg_ue_cdr ue_cdr;
+		struct msg_ue_cdr_bulk ue_cdr_bulk;
+		struct msg_sess_bulk sess_bulk;
+		struct msg_rule_bulk rule_bulk;
+		struct msg_dp_load dp_load;
+		struct msg_frame frame;
 	} msg_union;
 };
+
+/* Size of the msgbuf header, ahead of msg_union */
+#define MSGBUF_HDR_LEN	offsetof(struct msgbuf, msg_union)
+
+#ifdef CP_DP_COALESCE
+#if defined(SDN_ODL_BUILD) || defined(CP_DP_SHM_RING)
+#error "CP_DP_COALESCE is only supported with the UDP transport"
+#endif
+/* Max frame, what the DP receives in one msgbuf */
+#define CP_DP_FRAME_SIZE	sizeof(struct msgbuf)
+/* Size of the frame header, ahead of the records */
+#define CP_DP_FRAME_HDR_LEN	(MSGBUF_HDR_LEN + sizeof(struct msg_frame))
+/* Max time the first msg of a frame waits for more, in us */
+#define CP_DP_FLUSH_US		50
+#endif /* CP_DP_COALESCE */
 struct msgbuf sbuf;
 struct msgbuf rbuf;
 /* IPC msg node */
@@ -92,12 +165,62 @@ struct ipc_node {
 };
 struct ipc_node *basenode;
 
+#ifndef CP_BUILD
+/** Max msgs the iface core handles per poll */
+#define IFACE_MSG_BUDGET	32
+
+/** Processing cost of one msg type */
+struct iface_msg_stats {
+	uint64_t cnt;
+	uint64_t cycles;
+	uint64_t max_cycles;
+};
+
+/** iface core IPC stats, updated by the iface core only */
+struct iface_ipc_stats {
+	uint64_t polls;
+	uint64_t msgs;
+	/** polls which left msgs queued */
+	uint64_t budget_full;
+	/** msgs queued at the last poll, lower bound when budget_full */
+	uint32_t depth;
+	uint32_t max_depth;
+	struct iface_msg_stats msg[MSG_END];
+};
+extern struct iface_ipc_stats iface_ipc_stats;
+
+/**
+ * @brief Function to poll the CP DP transport and process up to budget
+ * messages without blocking.
+ *
+ * This function is not thread safe and should only be called by the iface
+ * core.
+ *
+ * @param budget
+ *	Max msgs to process, capped to IFACE_MSG_BUDGET.
+ * @return
+ *	Number of msgs processed
+ */
+int iface_poll_ipc_msgs(uint32_t budget);
+#else
 /**
  * @brief Function to recv the IPC message and process them.
  *
  * This function is not thread safe and should only be called once by DP.
  */
 int iface_process_ipc_msgs(void);
+#endif /* !CP_BUILD */
+
+/**
+ * @brief Length of a msg: header and the payload of its type. The bulk
+ * msgs only count their n entries.
+ *
+ * @param msg_payload
+ *	msg_payload - message payload.
+ * @return
+ *	length in bytes
+ */
+uint32_t dp_msg_len(struct msgbuf *msg_payload);
 
 /**
  * @brief Function to Inilialize memory for IPC msg.
@@ -142,5 +265,19 @@ int iface_remove_que(enum cp_dp_comm id);
 
 void simu_cp(void);
 
+/** Set once simu_cp() created all its sessions */
+extern volatile int simu_cp_ready;
+
+#ifdef SIMU_CP_LOAD
+/**
+ * @brief Start the session setup load test of the [load] section of
+ * simu_cp.cfg, if configured. Generator threads send session create,
+ * modify and delete msgs to the DP at the configured rate, as a CP over
+ * the CP DP socket or ring. The iface core polls them with
+ * iface_poll_ipc_msgs(), wrapped DP handlers record their latency.
+ */
+void simu_cp_load_start(void);
+#endif /* SIMU_CP_LOAD */
+
 #endif /* _DP_IPC_API_H_ */
 
@@ -475,6 +475,17 @@ int zmq_mbuf_rcv(struct zmqbuf *buf, uint32_t zmqbufsz)
 	return zmq_recv(zmqsub_socket, buf, zmqbufsz, flag);
 }
 
+#ifdef ZMQ_BATCH
+int zmq_mbuf_rcv_msg(zmq_msg_t *msg, int more)
+{
+	int flag = (more || dpn_lifecycle_state == INIT ||
+			dpn_lifecycle_state == ASSIGN_TOPIC_WAIT) ?
+			ZMQ_DONTWAIT : 0;
+
+	return zmq_msg_recv(msg, zmqsub_socket, flag);
+}
+#endif
+
 int dp_lifecycle_process(struct zmqbuf *mbuf, int rc)
 {
 	switch (mbuf->type) {
@@ -225,6 +225,24 @@ void zmq_subsocket_destroy(void);
  */
 int zmq_mbuf_rcv(struct zmqbuf *mbuf, uint32_t zmqbufsz);
 
+#ifdef ZMQ_BATCH
+/* Max msgs drained from the sub socket per iface_remove_que call */
+#define ZMQ_RX_BURST	32
+
+/**
+ * @brief
+ * receives zmq message from FPC controller without copying it. Waits as
+ * zmq_mbuf_rcv for the first msg of a burst, not for the others
+ * @param msg
+ * initialized zmq message to receive into
+ * @param more
+ * non zero for the msgs following the first of a burst
+ * @return
+ * size of zmq message recieved, -1 on error or if no msg is pending
+ */
+int zmq_mbuf_rcv_msg(zmq_msg_t *msg, int more);
+#endif
+
 /**
  * @brief
  * generates and sends goodbye message from the data plane to the FPC controller
@@ -20,9 +20,13 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <rte_common.h>
 #include <rte_malloc.h>
+#include <rte_lcore.h>
+#include <rte_branch_prediction.h>
+#include <rte_atomic.h>
 #include <hs.h>
 
 #include <rte_common.h>
@@ -35,6 +39,11 @@
  */
 #define MAX_DNS_NAME_LEN 256
 
+/** Names added before the delta database is merged into the main one */
+#ifndef SPONSDN_DELTA_MAX
+#define SPONSDN_DELTA_MAX 256
+#endif
+
 struct ctx {
 	unsigned matching_id;
 	unsigned long long off;
@@ -65,18 +74,46 @@ struct dns_response {
 	struct in_addr addr[0];
 } __attribute__ ((packed));
 
-static struct ctx ctx;
 static unsigned *host_ids;
 static unsigned *rule_ids;
 static unsigned *flags;
 
-static hs_database_t *database;
-static hs_scratch_t *scratch;
-static hs_compile_error_t *compile_err;
+/**
+ * Databases scanned for sponsored DNs. main holds the names before
+ * main_cnt, delta the names added since, until the merge thread folds
+ * them into a new main database.
+ */
+struct dn_dbs {
+	hs_database_t *main;
+	hs_database_t *delta;
+	uint32_t gen;
+};
+
+/** Databases in use by the scanning lcores */
+static struct dn_dbs *volatile active_dbs;
+static uint32_t dbs_gen;
+
+/**
+ * Scratch space of each scanning lcore, sized for the databases of
+ * generation lcore_scratch_gen.
+ */
+static hs_scratch_t *lcore_scratch[RTE_MAX_LCORE];
+static uint32_t lcore_scratch_gen[RTE_MAX_LCORE];
+
+/** Protects the name table and active_dbs updates */
+static pthread_mutex_t tbl_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Held while the names before main_cnt may change or be compiled */
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int merging;
+/** Merges that published a new main database */
+static volatile unsigned merges;
+
+static epc_sponsdn_retire_t retire_cb;
 
 static char (*host_names)[MAX_DNS_NAME_LEN];
 static char **host_name_tbl;
 static unsigned free_idx;
+static unsigned main_cnt;
 static uint32_t max_host_names;
 
 static inline bool is_compressed_name(uint16_t name)
@@ -84,16 +121,41 @@ static inline bool is_compressed_name(uint16_t name)
 	return !!(rte_be_to_cpu_16(name) & 0xe000);
 }
 
-static int compile_tbl(void)
+static void free_db(void *db)
+{
+	hs_free_database(db);
+}
+
+static void free_dbs(void *dbs)
+{
+	rte_free(dbs);
+}
+
+static void retire(void (*fn)(void *), void *obj)
+{
+	if (obj == NULL)
+		return;
+	if (retire_cb)
+		retire_cb(fn, obj);
+	else
+		fn(obj);
+}
+
+/**
+ * Compile names [first, first + n) into a database.
+ */
+static int compile_range(unsigned first, unsigned n, hs_database_t **db)
 {
+	hs_compile_error_t *compile_err;
 	hs_error_t err;
 
-	if (!free_idx)
+	*db = NULL;
+	if (!n)
 		return 0;
 
 	err = hs_compile_multi
-		((const char *const *)host_name_tbl, flags, host_ids, free_idx,
-		HS_MODE_BLOCK, NULL, &database, &compile_err);
+		((const char *const *)&host_name_tbl[first], &flags[first],
+		&host_ids[first], n, HS_MODE_BLOCK, NULL, db, &compile_err);
 
 	if (err != HS_SUCCESS) {
 		fprintf(stderr, "ERROR: Unable to compile pattern : %s\n",
@@ -102,19 +164,144 @@ static int compile_tbl(void)
 		return -1;
 	}
 
-	err = hs_alloc_scratch(database, &scratch);
+	return 0;
+}
 
-	if (err != HS_SUCCESS) {
-		fprintf(stderr,
-			"ERROR: %d Unable to allocate scratch space. Exiting.\n",
-			err);
-		hs_free_database(database);
-		return -1;
+/**
+ * Make main_db and delta_db the databases scanned, and retire the
+ * replaced ones once no lcore scans them. Called with tbl_lock held.
+ */
+static int publish_dbs(hs_database_t *main_db, hs_database_t *delta_db)
+{
+	struct dn_dbs *old = active_dbs;
+	struct dn_dbs *dbs = NULL;
+
+	if (main_db || delta_db) {
+		dbs = rte_zmalloc("dns dbs", sizeof(*dbs), 0);
+		if (!dbs)
+			return -ENOMEM;
+		dbs->main = main_db;
+		dbs->delta = delta_db;
+		dbs->gen = ++dbs_gen;
 	}
+	rte_smp_wmb();
+	active_dbs = dbs;
+
+	if (old) {
+		if (old->main != main_db)
+			retire(free_db, old->main);
+		if (old->delta != delta_db)
+			retire(free_db, old->delta);
+		retire(free_dbs, old);
+	}
+	return 0;
+}
 
+/**
+ * Recompile the names added since the last merge. Called with tbl_lock
+ * held.
+ */
+static int compile_delta(void)
+{
+	hs_database_t *delta;
+
+	if (compile_range(main_cnt, free_idx - main_cnt, &delta))
+		return -1;
+	if (publish_dbs(active_dbs ? active_dbs->main : NULL, delta)) {
+		hs_free_database(delta);
+		return -ENOMEM;
+	}
 	return 0;
 }
 
+/**
+ * Fold the delta names into a new main database, compiled without
+ * holding tbl_lock so that names keep being added meanwhile.
+ */
+static void *merge_thread(__rte_unused void *arg)
+{
+	hs_database_t *main_db;
+	hs_database_t *delta;
+	unsigned n;
+
+	pthread_mutex_lock(&merge_lock);
+	pthread_mutex_lock(&tbl_lock);
+	n = free_idx;
+	pthread_mutex_unlock(&tbl_lock);
+
+	/* names before n only change under merge_lock */
+	if (compile_range(0, n, &main_db) == 0) {
+		pthread_mutex_lock(&tbl_lock);
+		if (compile_range(n, free_idx - n, &delta) == 0) {
+			if (publish_dbs(main_db, delta) == 0) {
+				main_cnt = n;
+				merges++;
+			} else {
+				hs_free_database(main_db);
+				hs_free_database(delta);
+			}
+		} else {
+			hs_free_database(main_db);
+		}
+		pthread_mutex_unlock(&tbl_lock);
+	}
+
+	merging = 0;
+	pthread_mutex_unlock(&merge_lock);
+	return NULL;
+}
+
+/**
+ * Start a merge once the delta database grew past SPONSDN_DELTA_MAX
+ * names. Called with tbl_lock held.
+ */
+static void merge_check(void)
+{
+	pthread_t t;
+
+	if (free_idx - main_cnt < SPONSDN_DELTA_MAX || merging)
+		return;
+
+	merging = 1;
+	if (pthread_create(&t, NULL, merge_thread, NULL) != 0) {
+		fprintf(stderr, "ERROR: Unable to start DN merge thread\n");
+		merging = 0;
+		return;
+	}
+	pthread_detach(t);
+}
+
+/**
+ * Get scratch space of calling lcore, growing it when dbs changed. Each
+ * lcore only touches its own scratch.
+ */
+static hs_scratch_t *get_scratch(const struct dn_dbs *dbs)
+{
+	unsigned lcore_id = rte_lcore_id();
+
+	if (lcore_id >= RTE_MAX_LCORE)
+		return NULL;
+
+	if (likely(lcore_scratch_gen[lcore_id] == dbs->gen))
+		return lcore_scratch[lcore_id];
+
+	if ((dbs->main && hs_alloc_scratch(dbs->main,
+				&lcore_scratch[lcore_id]) != HS_SUCCESS) ||
+			(dbs->delta && hs_alloc_scratch(dbs->delta,
+				&lcore_scratch[lcore_id]) != HS_SUCCESS)) {
+		fprintf(stderr, "ERROR: Unable to allocate scratch space"
+				" for lcore %u\n", lcore_id);
+		return NULL;
+	}
+	lcore_scratch_gen[lcore_id] = dbs->gen;
+	return lcore_scratch[lcore_id];
+}
+
+void epc_sponsdn_set_retire(epc_sponsdn_retire_t retire_fn)
+{
+	retire_cb = retire_fn;
+}
+
 int epc_sponsdn_create(uint32_t max_dn)
 {
 	unsigned i;
@@ -167,6 +354,13 @@ err:
 
 void epc_sponsdn_free(void)
 {
+	pthread_mutex_lock(&merge_lock);
+	pthread_mutex_lock(&tbl_lock);
+	publish_dbs(NULL, NULL);
+	free_idx = main_cnt = 0;
+	pthread_mutex_unlock(&tbl_lock);
+	pthread_mutex_unlock(&merge_lock);
+
 	if (host_names) {
 		rte_free(host_names);
 		rte_free(host_ids);
@@ -181,26 +375,21 @@ void epc_sponsdn_free(void)
 
 int epc_sponsdn_dn_add_single(char *dn, const unsigned int rule)
 {
-	if (free_idx + 1 > max_host_names || free_idx + 1 < free_idx)
-		return -EINVAL;
-
-	strncpy(host_names[free_idx], dn, MAX_DNS_NAME_LEN);
-	rule_ids[free_idx] = rule;
-
-	free_idx += 1;
-
-	return free_idx ? compile_tbl() : 0;
+	return epc_sponsdn_dn_add_multi(&dn, &rule, 1);
 }
 
-
 /*
- * TODO: handle frees, RCU etc.
+ * Names are appended after the ones being merged, only the delta
+ * database is compiled here.
  */
 int epc_sponsdn_dn_add_multi(char **dn, const unsigned int *rules, uint32_t num)
 {
 	unsigned i;
+	int ret;
 
+	pthread_mutex_lock(&tbl_lock);
 	if (free_idx + num > max_host_names || free_idx + num < free_idx) {
+		pthread_mutex_unlock(&tbl_lock);
 		return -EINVAL;
 	}
 
@@ -211,14 +400,32 @@ int epc_sponsdn_dn_add_multi(char **dn, const unsigned int *rules, uint32_t num)
 	}
 
 	free_idx += num;
-	return free_idx ? compile_tbl() : 0;
+	ret = compile_delta();
+	if (ret == 0)
+		merge_check();
+	pthread_mutex_unlock(&tbl_lock);
+	return ret;
+}
+
+unsigned epc_sponsdn_merge_wait(void)
+{
+	/* merging is set before the merge thread starts */
+	while (merging)
+		usleep(1000);
+	return merges;
 }
 
 int epc_sponsdn_dn_del(char **dn, unsigned int num)
 {
+	hs_database_t *main_db;
 	unsigned i;
 	unsigned j;
 	unsigned num_del = 0;
+	int ret = 0;
+
+	/* Names are moved around, wait for a running merge */
+	pthread_mutex_lock(&merge_lock);
+	pthread_mutex_lock(&tbl_lock);
 
 	/* Reset entries that match */
 	for (i = 0; i < free_idx; i++)
@@ -245,13 +452,20 @@ int epc_sponsdn_dn_del(char **dn, unsigned int num)
 	}
 
 	free_idx -= num_del;
-	if (free_idx)
-		return compile_tbl();
+	if (compile_range(0, free_idx, &main_db) == 0) {
+		if (publish_dbs(main_db, NULL) == 0) {
+			main_cnt = free_idx;
+		} else {
+			hs_free_database(main_db);
+			ret = -ENOMEM;
+		}
+	} else {
+		ret = -1;
+	}
 
-	hs_free_scratch(scratch);
-	hs_free_database(database);
-	database = NULL;
-	return 0;
+	pthread_mutex_unlock(&tbl_lock);
+	pthread_mutex_unlock(&merge_lock);
+	return ret;
 }
 
 static int event_handler(unsigned int id, __rte_unused unsigned long long from,
@@ -273,18 +487,49 @@ static const struct dns_response *next_response(const struct dns_response *resp)
 	return (const struct dns_response *)(buf + len);
 }
 
-int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
-		     unsigned *rule_id, struct in_addr *addr4, int *addr4_cnt,
-		     __rte_unused char **hname_6,
-		     __rte_unused struct in6_addr *addr6,
-		     __rte_unused int *addr6_cnt)
+/**
+ * Scan buf with the main and delta databases.
+ */
+static int scan_dbs(const char *buf, unsigned len, struct ctx *ctx)
+{
+	const struct dn_dbs *dbs;
+	hs_scratch_t *lcore_scr;
+
+	dbs = active_dbs;
+	if (dbs == NULL)
+		return -1;
+	rte_smp_rmb();
+
+	lcore_scr = get_scratch(dbs);
+	if (lcore_scr == NULL)
+		return -1;
+
+	ctx->matching_id = (unsigned)~0;
+	if ((dbs->main && hs_scan(dbs->main, buf, len, 0, lcore_scr,
+				event_handler, ctx) != HS_SUCCESS) ||
+			(ctx->matching_id == (unsigned)~0 && dbs->delta &&
+			 hs_scan(dbs->delta, buf, len, 0, lcore_scr,
+				 event_handler, ctx) != HS_SUCCESS)) {
+		fprintf(stderr,
+			"ERROR: Unable to scan input buffer. Exiting.\n");
+
+		return -1;
+	}
+	return 0;
+}
+
+static int sponsdn_scan(const char *resp, unsigned len, char *hname,
+			unsigned *rule_id, struct in_addr *addr4,
+			uint32_t *ttl4, int *addr4_cnt)
 {
 	const struct dns_query *query;
 	const struct dns_response *response;
 	const struct dns_header *header = (const struct dns_header *)resp;
+	struct ctx ctx;
 	unsigned i;
 	unsigned num_ans;
 	int cnt4;
+	int max4 = addr4 ? *addr4_cnt : 0;
 
 	if (!header->ans)
 		return -1;
@@ -294,14 +539,8 @@ int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
 		return -1;
 
 
-	ctx.matching_id = (unsigned)~0;
-	if (hs_scan(database, resp, len, 0, scratch, event_handler,
-		    &ctx) != HS_SUCCESS) {
-		fprintf(stderr,
-			"ERROR: Unable to scan input buffer. Exiting.\n");
-
+	if (scan_dbs(resp, len, &ctx))
 		return -1;
-	}
 
 	if (ctx.matching_id == (unsigned)~0) {
 		*addr4_cnt = 0;
@@ -322,9 +561,11 @@ int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
 			continue;
 
 		if (is_compressed_name(response->name)) {
-			cnt4++;
-			if (addr4)
+			if (cnt4++ < max4) {
 				*addr4++ = *response->addr;
+				if (ttl4)
+					*ttl4++ = rte_be_to_cpu_32(response->ttl);
+			}
 		} else {
 			const char *b = (const char *)resp;
 
@@ -334,9 +575,11 @@ int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
 				b += skip + 1;
 			}
 			response = (const struct dns_response *)(b - 1);
-			cnt4++;
-			if (addr4)
+			if (cnt4++ < max4) {
 				*addr4++ = *response->addr;
+				if (ttl4)
+					*ttl4++ = rte_be_to_cpu_32(response->ttl);
+			}
 		}
 	}
 
@@ -349,3 +592,102 @@ int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
 
 	return 0;
 }
+
+int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
+		     unsigned *rule_id, struct in_addr *addr4, int *addr4_cnt,
+		     __rte_unused char **hname_6,
+		     __rte_unused struct in6_addr *addr6,
+		     __rte_unused int *addr6_cnt)
+{
+	return sponsdn_scan(resp, len, hname, rule_id, addr4, NULL, addr4_cnt);
+}
+
+int epc_sponsdn_scan_ttl(const char *resp, unsigned len, unsigned *rule_id,
+			 struct in_addr *addr4, uint32_t *ttl4, int *addr4_cnt)
+{
+	return sponsdn_scan(resp, len, NULL, rule_id, addr4, ttl4, addr4_cnt);
+}
+
+static inline uint16_t get_be16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | p[3];
+}
+
+int epc_sponsdn_parse(const char *resp, unsigned len,
+		      struct epc_sponsdn_desc *desc)
+{
+	const struct dns_header *header = (const struct dns_header *)resp;
+	const uint8_t *end = (const uint8_t *)resp + len;
+	const uint8_t *p;
+	unsigned num_ans;
+	unsigned i, l;
+	uint16_t rdlen;
+
+	if (len < sizeof(*header) || rte_be_to_cpu_16(header->qns) != 1)
+		return -1;
+
+	num_ans = rte_be_to_cpu_16(header->ans);
+	if (!num_ans)
+		return -1;
+
+	/* question name, never compressed */
+	p = (const uint8_t *)(header + 1);
+	for (l = 0; p + l < end && p[l]; l += p[l] + 1) {
+		if ((p[l] & 0xc0) || l + p[l] + 1 >= EPC_SPONSDN_QNAME_MAX)
+			return -1;
+	}
+	if (p + l + 1 + sizeof(struct dns_query) > end)
+		return -1;
+	desc->qname_len = l + 1;
+	memcpy(desc->qname, p, desc->qname_len);
+
+	p += desc->qname_len;
+	if (get_be16(p) != 1 ||		/* Type = A */
+			get_be16(p + 2) != 1)	/* Class = IN */
+		return -1;
+	p += sizeof(struct dns_query);
+
+	desc->addr4_cnt = 0;
+	for (i = 0; i < num_ans && desc->addr4_cnt < EPC_SPONSDN_DESC_ADDR;
+			i++) {
+		/* owner name, labels ended by a compression pointer or 0 */
+		while (p < end && *p && (*p & 0xc0) != 0xc0)
+			p += *p + 1;
+		if (p >= end)
+			break;
+		p += ((*p & 0xc0) == 0xc0) ? 2 : 1;
+
+		/* type, class, ttl, data len */
+		if (p + 10 > end)
+			break;
+		rdlen = get_be16(p + 8);
+		if (p + 10 + rdlen > end)
+			break;
+		if (get_be16(p) == 1 && rdlen == sizeof(struct in_addr)) {
+			memcpy(&desc->addr4[desc->addr4_cnt], p + 10, rdlen);
+			desc->ttl4[desc->addr4_cnt++] = get_be32(p + 4);
+		}
+		p += 10 + rdlen;
+	}
+
+	return desc->addr4_cnt ? 0 : -1;
+}
+
+int epc_sponsdn_match(const struct epc_sponsdn_desc *desc,
+		      unsigned int *rule_id)
+{
+	struct ctx ctx;
+
+	if (scan_dbs(desc->qname, desc->qname_len, &ctx) ||
+			ctx.matching_id == (unsigned)~0)
+		return -1;
+
+	*rule_id = rule_ids[ctx.matching_id];
+	return 0;
+}
@@ -28,6 +28,21 @@
  */
 int epc_sponsdn_create(uint32_t max_dn);
 
+/**
+ * Release function of objects retired by the library.
+ */
+typedef void (*epc_sponsdn_retire_t)(void (*free_fn)(void *), void *obj);
+
+/**
+ * Set how databases replaced by an update are released. Without it
+ * they are freed at once, which is only safe if no other lcore scans.
+ *
+ * @param retire
+ *	called with the free function and the object, free_fn(obj) must
+ *	be called once no lcore scans the object any more.
+ */
+void epc_sponsdn_set_retire(epc_sponsdn_retire_t retire);
+
 /**
  * Free sponsored DN resources
  *
@@ -51,7 +66,9 @@ void epc_sponsdn_free(void);
 int epc_sponsdn_dn_add_single(char *dn, const unsigned int rule);
 
 /**
- * Add multiple sponsored DNs
+ * Add multiple sponsored DNs. Only the names added since the last merge
+ * are compiled, a background thread merges them into the main database
+ * once they grow past SPONSDN_DELTA_MAX names.
  *
  * @param dn
  *	Domain names to add.
@@ -66,6 +83,15 @@ int epc_sponsdn_dn_add_single(char *dn, const unsigned int rule);
  */
 int epc_sponsdn_dn_add_multi(char **dn, const unsigned int *rule_id, uint32_t num);
 
+/**
+ * Wait until a merge of the delta names into the main database, started
+ * by epc_sponsdn_dn_add_multi(), completed.
+ *
+ * @return
+ *   number of merges completed so far
+ */
+unsigned epc_sponsdn_merge_wait(void);
+
 /**
  * Delete sponsored DN
  *
@@ -82,7 +108,8 @@ int epc_sponsdn_dn_add_multi(char **dn, const unsigned int *rule_id, uint32_t nu
 int epc_sponsdn_dn_del(char **dn, unsigned int num);
 
 /**
- * Scan a DNS response for any matching DNs
+ * Scan a DNS response for any matching DNs. Several lcores may scan at
+ * once, each lcore scans with its own scratch space.
  *
  * @param resp
  *	DNS response to scan
@@ -112,4 +139,85 @@ int epc_sponsdn_scan(const char *resp, unsigned len, char *hname,
 		     int *addr4_cnt, char **hname_6, struct in6_addr *addr6,
 		     int *addr6_cnt);
 
+/**
+ * Scan a DNS response for any matching DNs, returning the TTL of each
+ * address as well.
+ *
+ * @param resp
+ *	DNS response to scan
+ * @param len
+ *	Response length.
+ * @param rule_id
+ *	Rule identifier.
+ * @addr4
+ *	Array of IP addresses returned
+ * @ttl4
+ *	TTL in seconds of each entry of addr4
+ * @addr4_cnt
+ *	Size of addr4 and ttl4, also return value indicates the number of
+ *	valid entries in addr4, addr4_cnt could be larger than the size of
+ *	addr4
+ *
+ * @return
+ *  - 0: Success
+ *  - <0: Error code on failure
+ */
+int epc_sponsdn_scan_ttl(const char *resp, unsigned len, unsigned int *rule_id,
+			 struct in_addr *addr4, uint32_t *ttl4, int *addr4_cnt);
+
+/** A records kept per parsed DNS response */
+#define EPC_SPONSDN_DESC_ADDR	16
+/** Max length of a question name in wire format */
+#define EPC_SPONSDN_QNAME_MAX	256
+
+/**
+ * DNS response reduced to the parts needed to learn sponsored addresses.
+ */
+struct epc_sponsdn_desc {
+	/** length of qname, including the final 0 label */
+	uint16_t qname_len;
+	/** entries of addr4 and ttl4 */
+	uint16_t addr4_cnt;
+	/** A record addresses */
+	struct in_addr addr4[EPC_SPONSDN_DESC_ADDR];
+	/** A record TTLs, seconds */
+	uint32_t ttl4[EPC_SPONSDN_DESC_ADDR];
+	/** question name, wire format */
+	char qname[EPC_SPONSDN_QNAME_MAX];
+};
+
+/**
+ * Parse the question name and A records of a DNS response into desc,
+ * without scanning for DNs. Safe to call from any lcore.
+ *
+ * @param resp
+ *	DNS response to parse
+ * @param len
+ *	Response length.
+ * @param desc
+ *	parsed response.
+ *
+ * @return
+ *  - 0: response to an A query with at least one A record
+ *  - <0: otherwise
+ */
+int epc_sponsdn_parse(const char *resp, unsigned len,
+		      struct epc_sponsdn_desc *desc);
+
+/**
+ * Scan the question name of a parsed DNS response for any matching DNs.
+ * Several lcores may scan at once.
+ *
+ * @param desc
+ *	response parsed with epc_sponsdn_parse().
+ * @param rule_id
+ *	Rule identifier of the matching DN.
+ *
+ * @return
+ *  - 0: Success
+ *  - <0: no matching DN or error
+ */
+int epc_sponsdn_match(const struct epc_sponsdn_desc *desc,
+		      unsigned int *rule_id);
+
 #endif	/* _EPC_SPONSDN_H */
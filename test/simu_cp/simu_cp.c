@@ -38,7 +38,9 @@
 #include "nsb_test_util.h"
 
 #ifdef SIMU_CP
+#ifndef SIMU_CP_FILE
 #define SIMU_CP_FILE "../config/simu_cp.cfg"
+#endif
 #define NSB_SIMU
 
 #define ADC_RULE_FILENAME "../config/adc_rules.cfg"
@@ -49,6 +51,7 @@
 #define DDN_TEST 1
 
 uint32_t num_adc_rule;
+volatile int simu_cp_ready;
 
 static uint32_t name_to_num(char *name)
 {
@@ -380,6 +383,8 @@ void simu_cp(void)
 	mtr_entry.metering_method = SRTCM_COLOR_BLIND;
 	mtr_entry.mtr_param.cbs = 2048;
 	mtr_entry.mtr_param.ebs = 2048;
+	mtr_entry.mtr_param.pir = 0;
+	mtr_entry.mtr_param.pbs = 0;
 
 	/* For UL:
 	 * CIR is defined as (PPS x (Out Packet Size - Ethernet Hdr Size))
@@ -617,6 +622,7 @@ void simu_cp(void)
 		}
 	}
 	printf("Simulted simu_cp.cfg config done\n");
+	simu_cp_ready = 1;
 
 	struct msg_ue_cdr ue_cdr;
 	ue_cdr.session_id = (1 << 4) + 5;
@@ -631,6 +637,17 @@ void simu_cp(void)
 	printf("Simu export CDR for sess id %"PRIu64"\n", ue_cdr.session_id);
 	ue_cdr_flush(dp_id, ue_cdr);
 
+	/* then the CDRs of every bearer of the simulated UEs at once */
+	struct msg_ue_cdr_bulk ue_cdr_bulk = {
+		.type = CDR_TYPE_ALL,
+		.action = 0,
+		.n = 1,
+	};
+	ue_cdr_bulk.range[0].first = 1 << 4;
+	ue_cdr_bulk.range[0].last = ((uint64_t)max_ue_sess << 4) + 0xf;
+	sleep(10);
+	printf("Simu export CDRs of %u UEs\n", max_ue_sess);
+	ue_cdr_flush_bulk(dp_id, &ue_cdr_bulk);
 }
 #endif				/* SIMU_CP */
 
@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2017 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ring.h>
+#include <rte_mempool.h>
+#include <rte_cfgfile.h>
+#include <rte_memcpy.h>
+
+#include "interface.h"
+#include "main.h"
+#include "util.h"
+#include "dp_ipc_api.h"
+
+#ifdef SIMU_CP_LOAD
+#ifndef SIMU_CP
+#error "SIMU_CP_LOAD requires SIMU_CP"
+#endif
+
+#ifndef SIMU_CP_FILE
+#define SIMU_CP_FILE "../config/simu_cp.cfg"
+#endif
+/** APN meter profile created by simu_cp */
+#define SIMU_LOAD_APN_MTR_IDX	3
+
+/** Load msgs sent and not yet applied by the iface core. Bounds the
+ * backlog of the DP socket, a dropped msg would never complete. */
+#define SIMU_LOAD_WINDOW	256
+#define SIMU_LOAD_MAX_THREADS	16
+/** log2 latency buckets, in TSC cycles */
+#define SIMU_LOAD_HIST		64
+
+enum simu_load_op {
+	LOAD_CREATE,
+	LOAD_MODIFY,
+	LOAD_DELETE,
+	LOAD_OPS
+};
+
+static const char *simu_load_op_name[LOAD_OPS] = {
+	"create", "modify", "delete"
+};
+
+static const long simu_load_mtype[LOAD_OPS] = {
+	MSG_SESS_CRE, MSG_SESS_MOD, MSG_SESS_DEL
+};
+
+/** msg_union of the CP msgs of the load: the session, as a CP sends it,
+ * stamped when the generator built it. The DP handlers only read the
+ * session. */
+struct simu_load_msg {
+	struct session_info sess;
+	uint64_t tsc;
+	uint32_t op;
+} __attribute__((packed));
+
+/** [load] section of simu_cp.cfg, and the simu_cp values it needs */
+struct simu_load_cfg {
+	uint32_t threads;	/** generator threads, 0- load test off */
+	uint32_t sessions;	/** sessions attached in the first cycle */
+	uint32_t step;		/** sessions added by each further cycle */
+	uint32_t rate;		/** attaches per sec, 0- as fast as possible */
+	uint32_t ramp_sec;	/** secs the rate ramps up from 0 to rate */
+	uint32_t hold_sec;	/** secs between attach and detach */
+	uint32_t cycles;	/** attach/detach cycles, 0- run forever */
+	uint32_t modify;	/** attach is create and modify, else create */
+
+	uint32_t enb_ip;
+	uint32_t ue_ip_s;
+	uint32_t first_ue;	/** after the sessions of simu_cp */
+	uint32_t ul_rule;	/** default PCC rule of simu_cp, UL */
+	uint32_t dl_rule;	/** default PCC rule of simu_cp, DL */
+	uint32_t bearer;
+};
+
+/** Op results, updated by the iface core only */
+struct simu_load_stats {
+	uint64_t done[LOAD_OPS];
+	uint64_t failed[LOAD_OPS];
+	uint64_t cycles[LOAD_OPS];
+	uint64_t max[LOAD_OPS];
+	uint64_t hist[LOAD_OPS][SIMU_LOAD_HIST];
+};
+
+struct simu_load_thread {
+	pthread_t t;
+	uint32_t id;
+	uint64_t submitted[LOAD_OPS];
+	/** waits for room in SIMU_LOAD_WINDOW or the CP DP ring */
+	uint64_t stalls;
+#ifndef CP_DP_SHM_RING
+	int fd;
+#endif
+} __rte_cache_aligned;
+
+static struct simu_load_cfg load_cfg;
+static struct simu_load_stats load_stats;
+static struct simu_load_thread load_thread[SIMU_LOAD_MAX_THREADS];
+static pthread_barrier_t load_barrier;
+/** DP msg handlers the load callbacks wrap */
+static int (*load_cb[LOAD_OPS])(struct msgbuf *msg_payload);
+/** set by the coordinator, load_stats.max is cleared by the iface core */
+static volatile int load_max_reset;
+#ifdef CP_DP_SHM_RING
+static struct rte_ring *load_ring;
+static struct rte_mempool *load_pool;
+#else
+static struct sockaddr_in load_dp_addr;
+#endif
+
+/* phase set by the coordinator between the barriers */
+static int load_detach;
+static uint32_t load_n;
+static uint64_t load_t0;
+
+static uint32_t
+cfg_u32(struct rte_cfgfile *file, const char *sec, const char *key,
+		uint32_t def)
+{
+	const char *entry = rte_cfgfile_get_entry(file, sec, key);
+
+	return entry ? (uint32_t)strtoul(entry, NULL, 10) : def;
+}
+
+static uint32_t
+cfg_ip(struct rte_cfgfile *file, const char *key)
+{
+	const char *entry = rte_cfgfile_get_entry(file, "0", key);
+	struct in_addr addr;
+
+	if (entry == NULL || inet_aton(entry, &addr) == 0)
+		rte_exit(EXIT_FAILURE, "simu_cp load: invalid %s\n", key);
+	return ntohl(addr.s_addr);
+}
+
+/**
+ * Read the [load] section of simu_cp.cfg.
+ *
+ * @return
+ *	- 0 if the load test is configured
+ *	- -1 otherwise
+ */
+static int
+simu_load_parse(void)
+{
+	struct rte_cfgfile *file = rte_cfgfile_load(SIMU_CP_FILE, 0);
+	uint32_t max_rules;
+
+	if (file == NULL)
+		return -1;
+
+	load_cfg.threads = cfg_u32(file, "load", "threads", 0);
+	if (load_cfg.threads == 0) {
+		rte_cfgfile_close(file);
+		return -1;
+	}
+	load_cfg.threads = RTE_MIN(load_cfg.threads,
+			(uint32_t)SIMU_LOAD_MAX_THREADS);
+	load_cfg.sessions = cfg_u32(file, "load", "sessions", 10000);
+	load_cfg.step = cfg_u32(file, "load", "step", 0);
+	load_cfg.rate = cfg_u32(file, "load", "rate", 1000);
+	load_cfg.ramp_sec = cfg_u32(file, "load", "ramp_sec", 0);
+	load_cfg.hold_sec = cfg_u32(file, "load", "hold_sec", 5);
+	load_cfg.cycles = cfg_u32(file, "load", "cycles", 1);
+	load_cfg.modify = cfg_u32(file, "load", "modify", 1);
+
+	load_cfg.enb_ip = cfg_ip(file, "enodeb_ip");
+	load_cfg.ue_ip_s = cfg_ip(file, "ue_ip_start");
+	load_cfg.first_ue = cfg_u32(file, "0", "max_ue_sess", 0);
+	max_rules = cfg_u32(file, "0", "max_rules", 0);
+	load_cfg.ul_rule = max_rules + 1;
+	load_cfg.dl_rule = max_rules + 2;
+	load_cfg.bearer = cfg_u32(file, "0", "default_bearer", 5);
+	rte_cfgfile_close(file);
+
+	printf("simu_cp load: %u threads, %u sessions +%u per cycle, "
+			"%u attach/s, ramp %us, hold %us, %u cycles%s\n",
+			load_cfg.threads, load_cfg.sessions, load_cfg.step,
+			load_cfg.rate, load_cfg.ramp_sec, load_cfg.hold_sec,
+			load_cfg.cycles, load_cfg.modify ? ", modify" : "");
+	return 0;
+}
+
+/**
+ * TSC at which op k of a generator thread is due, from the phase start.
+ * With a ramp the rate grows linearly to its target over ramp_sec, so
+ * k ops are due at sqrt(2 * ramp * k / rate) while ramping.
+ */
+static uint64_t
+simu_load_due(uint64_t k)
+{
+	double rate = (double)load_cfg.rate / load_cfg.threads;
+	double ramp = load_cfg.ramp_sec;
+	double t;
+
+	if (load_cfg.rate == 0)
+		return load_t0;
+
+	if (k < rate * ramp / 2)
+		t = sqrt(2 * ramp * k / rate);
+	else
+		t = ramp + (k - rate * ramp / 2) / rate;
+	return load_t0 + (uint64_t)(t * rte_get_tsc_hz());
+}
+
+static void
+simu_load_sess(uint32_t ue, struct session_info *si)
+{
+	uint32_t u = load_cfg.first_ue + ue;
+
+	memset(si, 0, sizeof(*si));
+	si->sess_id = SESS_ID(u + 1, load_cfg.bearer);
+	si->ue_addr.iptype = IPTYPE_IPV4;
+	si->ue_addr.u.ipv4_addr = load_cfg.ue_ip_s + u;
+	si->ul_apn_mtr_idx = SIMU_LOAD_APN_MTR_IDX;
+	si->dl_apn_mtr_idx = SIMU_LOAD_APN_MTR_IDX;
+	si->ipcan_dp_bearer_cdr.charging_id = 10;
+	si->ipcan_dp_bearer_cdr.pdn_conn_charging_id = 10;
+	si->ul_s1_info.sgw_teid = u + 1;
+	si->ul_s1_info.enb_addr.iptype = IPTYPE_IPV4;
+	si->ul_s1_info.enb_addr.u.ipv4_addr = load_cfg.enb_ip;
+	si->num_ul_pcc_rules = 1;
+	si->ul_pcc_rule_id[0] = load_cfg.ul_rule;
+	si->num_dl_pcc_rules = 1;
+	si->dl_pcc_rule_id[0] = load_cfg.dl_rule;
+}
+
+static uint64_t
+simu_load_pending(void)
+{
+	uint64_t n = 0;
+	uint32_t i, op;
+
+	/* polled, counters of the other threads and the iface core */
+	rte_smp_rmb();
+	for (i = 0; i < load_cfg.threads; i++) {
+		for (op = 0; op < LOAD_OPS; op++)
+			n += load_thread[i].submitted[op];
+	}
+	for (op = 0; op < LOAD_OPS; op++)
+		n -= load_stats.done[op] + load_stats.failed[op];
+	return n;
+}
+
+/**
+ * Send CP msg to the DP as a CP would, over the CP DP socket or ring,
+ * waiting for room in SIMU_LOAD_WINDOW. The wait counts in the latency of
+ * the op, as a CP would see it.
+ */
+static void
+simu_load_submit(struct simu_load_thread *th, uint32_t op,
+		const struct session_info *si)
+{
+	struct msgbuf msg;
+	struct simu_load_msg *m = (struct simu_load_msg *)&msg.msg_union;
+	uint32_t len = MSGBUF_HDR_LEN + sizeof(*m);
+	uint64_t tsc = rte_rdtsc();
+#ifdef CP_DP_SHM_RING
+	void *buf;
+#endif
+
+	while (simu_load_pending() >= SIMU_LOAD_WINDOW) {
+		th->stalls++;
+		rte_pause();
+	}
+	msg.mtype = simu_load_mtype[op];
+	msg.dp_id.id = 0;
+	m->sess = *si;
+	m->tsc = tsc;
+	m->op = op;
+	/* pending before the msg can complete */
+	th->submitted[op]++;
+
+#ifdef CP_DP_SHM_RING
+	while (rte_mempool_get(load_pool, &buf) < 0) {
+		th->stalls++;
+		rte_pause();
+	}
+	rte_memcpy(buf, &msg, len);
+	while (rte_ring_mp_enqueue(load_ring, buf) == -ENOBUFS) {
+		th->stalls++;
+		rte_pause();
+	}
+#else
+	if (sendto(th->fd, &msg, len, 0, (struct sockaddr *)&load_dp_addr,
+			sizeof(load_dp_addr)) != (ssize_t)len)
+		rte_exit(EXIT_FAILURE, "simu_cp load: send failed: %s\n",
+				strerror(errno));
+#endif
+}
+
+/**
+ * Generator thread. Attaches or detaches its share of the phase
+ * sessions, UEs id, id + threads .., at its share of the rate.
+ */
+static void *
+simu_load_thread_main(void *arg)
+{
+	struct simu_load_thread *th = arg;
+	struct session_info si;
+	uint64_t due, k;
+	uint32_t ue;
+
+	while (1) {
+		pthread_barrier_wait(&load_barrier);
+
+		for (ue = th->id, k = 0; ue < load_n;
+				ue += load_cfg.threads, k++) {
+			due = simu_load_due(k);
+			while (rte_rdtsc() < due)
+				rte_pause();
+
+			simu_load_sess(ue, &si);
+			if (load_detach) {
+				simu_load_submit(th, LOAD_DELETE, &si);
+				continue;
+			}
+			if (load_cfg.modify)
+				simu_load_submit(th, LOAD_CREATE, &si);
+			/* eNB tunnel, known once the bearer is set up */
+			si.dl_s1_info.enb_teid = load_cfg.first_ue + ue + 1;
+			si.dl_s1_info.enb_addr.iptype = IPTYPE_IPV4;
+			si.dl_s1_info.enb_addr.u.ipv4_addr = load_cfg.enb_ip;
+			if (load_cfg.modify)
+				simu_load_submit(th, LOAD_MODIFY, &si);
+			else
+				simu_load_submit(th, LOAD_CREATE, &si);
+		}
+
+		pthread_barrier_wait(&load_barrier);
+	}
+	return NULL;
+}
+
+/**
+ * Latency below which pct percent of the ops of hist completed, as the
+ * upper bound of the log2 bucket, in usec.
+ */
+static double
+simu_load_pct(const uint64_t *hist, uint64_t n, double pct)
+{
+	uint64_t sum = 0;
+	uint32_t b;
+
+	for (b = 0; b < SIMU_LOAD_HIST; b++) {
+		sum += hist[b];
+		if (sum * 100.0 >= pct * n)
+			break;
+	}
+	if (b >= 63)
+		return (double)UINT64_MAX * 1e6 / rte_get_tsc_hz();
+	return (double)(2ULL << b) * 1e6 / rte_get_tsc_hz();
+}
+
+static void
+simu_load_report(const char *phase, uint32_t cycle, uint32_t n,
+		const struct simu_load_stats *s0, uint64_t stalls,
+		uint64_t tsc)
+{
+	const struct simu_load_stats *s1 = &load_stats;
+	uint64_t hist[SIMU_LOAD_HIST];
+	double hz = rte_get_tsc_hz();
+	double sec = tsc / hz;
+	uint64_t done, failed;
+	uint32_t op, b;
+
+	printf("simu_cp load: cycle %u %s %u sessions in %.3fs, %.0f/s,"
+			" %"PRIu64" stalls\n", cycle, phase, n, sec,
+			sec > 0 ? n / sec : 0, stalls);
+	for (op = 0; op < LOAD_OPS; op++) {
+		done = s1->done[op] - s0->done[op];
+		failed = s1->failed[op] - s0->failed[op];
+		if (done + failed == 0)
+			continue;
+		for (b = 0; b < SIMU_LOAD_HIST; b++)
+			hist[b] = s1->hist[op][b] - s0->hist[op][b];
+		printf("simu_cp load:   %-6s %"PRIu64" ok %"PRIu64" failed,"
+				" usec mean %.1f p50 <%.1f p99 <%.1f"
+				" p99.9 <%.1f max %.1f\n",
+				simu_load_op_name[op], done, failed,
+				(s1->cycles[op] - s0->cycles[op]) * 1e6 /
+				hz / (done + failed),
+				simu_load_pct(hist, done + failed, 50),
+				simu_load_pct(hist, done + failed, 99),
+				simu_load_pct(hist, done + failed, 99.9),
+				s1->max[op] * 1e6 / hz);
+	}
+}
+
+/**
+ * Run one attach or detach phase of n sessions and report it once the
+ * iface core applied all its msgs.
+ */
+static void
+simu_load_phase(uint32_t cycle, int detach, uint32_t n)
+{
+	struct simu_load_stats s0;
+	uint64_t stalls = 0;
+	uint32_t i;
+
+	for (i = 0; i < load_cfg.threads; i++)
+		stalls -= load_thread[i].stalls;
+	/* the iface core is done with the msgs of the last phase */
+	s0 = load_stats;
+	load_max_reset = 1;
+
+	load_detach = detach;
+	load_n = n;
+	load_t0 = rte_rdtsc();
+	pthread_barrier_wait(&load_barrier);
+	pthread_barrier_wait(&load_barrier);
+	while (simu_load_pending())
+		usleep(1000);
+
+	for (i = 0; i < load_cfg.threads; i++)
+		stalls += load_thread[i].stalls;
+	simu_load_report(detach ? "detach" : "attach", cycle, n, &s0,
+			stalls, rte_rdtsc() - load_t0);
+}
+
+static void *
+simu_load_main(__rte_unused void *arg)
+{
+	uint32_t c, n;
+
+	for (c = 0; load_cfg.cycles == 0 || c < load_cfg.cycles; c++) {
+		n = load_cfg.sessions + c * load_cfg.step;
+		simu_load_phase(c, 0, n);
+		sleep(load_cfg.hold_sec);
+		simu_load_phase(c, 1, n);
+	}
+	printf("simu_cp load: done\n");
+	return NULL;
+}
+
+/**
+ * DP handler of the load msgs: applies the msg with the handler it wraps
+ * and records the latency of the op. Runs on the iface core.
+ */
+static int
+simu_load_cb(struct msgbuf *msg_payload)
+{
+	struct simu_load_msg *m =
+		(struct simu_load_msg *)&msg_payload->msg_union;
+	uint32_t op = m->op;
+	uint64_t lat;
+	uint32_t b;
+	int ret;
+
+	if (load_max_reset) {
+		memset(load_stats.max, 0, sizeof(load_stats.max));
+		load_max_reset = 0;
+	}
+	if (op >= LOAD_OPS || simu_load_mtype[op] != msg_payload->mtype)
+		return -1;
+
+	ret = load_cb[op](msg_payload);
+	if (ret < 0)
+		load_stats.failed[op]++;
+	else
+		load_stats.done[op]++;
+
+	lat = rte_rdtsc() - m->tsc;
+	load_stats.cycles[op] += lat;
+	if (lat > load_stats.max[op])
+		load_stats.max[op] = lat;
+	b = lat ? 63 - __builtin_clzll(lat) : 0;
+	load_stats.hist[op][b]++;
+	return ret;
+}
+
+void
+simu_cp_load_start(void)
+{
+	pthread_t t;
+	uint32_t i, op;
+
+	RTE_BUILD_BUG_ON(sizeof(struct simu_load_msg) >
+			sizeof(((struct msgbuf *)0)->msg_union));
+
+	if (simu_load_parse() < 0)
+		return;
+
+#ifdef CP_DP_SHM_RING
+	/* enqueue to the DP as ring_send() of a CP does */
+	load_ring = rte_ring_lookup(CP_DP_RING_NAME);
+	load_pool = rte_mempool_lookup(CP_DP_MSG_POOL_NAME);
+	if (load_ring == NULL || load_pool == NULL)
+		rte_exit(EXIT_FAILURE, "simu_cp load: CP DP ring not found\n");
+#else
+	load_dp_addr.sin_family = AF_INET;
+	load_dp_addr.sin_port = htons(dp_comm_port);
+	load_dp_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#endif
+
+	for (op = 0; op < LOAD_OPS; op++) {
+		load_cb[op] = basenode[simu_load_mtype[op]].msg_cb;
+		iface_ipc_register_msg_cb(simu_load_mtype[op], simu_load_cb);
+	}
+
+	pthread_barrier_init(&load_barrier, NULL, load_cfg.threads + 1);
+	for (i = 0; i < load_cfg.threads; i++) {
+		load_thread[i].id = i;
+#ifndef CP_DP_SHM_RING
+		load_thread[i].fd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (load_thread[i].fd < 0)
+			rte_exit(EXIT_FAILURE, "simu_cp load: cannot create"
+					" socket\n");
+#endif
+		if (pthread_create(&load_thread[i].t, NULL,
+				&simu_load_thread_main, &load_thread[i]) != 0)
+			rte_exit(EXIT_FAILURE, "simu_cp load: cannot create"
+					" thread\n");
+	}
+	if (pthread_create(&t, NULL, &simu_load_main, NULL) != 0)
+		rte_exit(EXIT_FAILURE, "simu_cp load: cannot create thread\n");
+}
+#endif /* SIMU_CP_LOAD */
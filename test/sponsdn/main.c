@@ -33,9 +33,19 @@
 #include <rte_cfgfile.h>
 #include <rte_udp.h>
 #include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_random.h>
 
 #define MAX_DN 10
 #define MAX_DNS_NAME_LEN 256
+
+/** Benchmark defaults, see bench_main() */
+#define BENCH_RESP		4096
+#define BENCH_SCANS		1000000
+#define BENCH_HIT_PCT		50
+#define BENCH_MAX_ANS		8
+#define BENCH_MAX_LEVELS	16
+#define BENCH_RESP_LEN		512
 int cnt;
 
 static unsigned char *handler(const unsigned char *bytes)
@@ -146,6 +156,224 @@ static void scan_and_print(unsigned char *pkt, char (*hname)[MAX_DNS_NAME_LEN])
 
 }
 
+/** Synthetic DNS response */
+struct bench_resp {
+	char buf[BENCH_RESP_LEN];
+	unsigned len;
+	int hit;
+};
+
+static void bench_name(unsigned i, char *name)
+{
+	snprintf(name, MAX_DNS_NAME_LEN, "cdn%u.svc%u.sponsor.com", i,
+		 i % 1000);
+}
+
+/**
+ * Build a DNS response for name with n A records.
+ */
+static void bench_resp_build(struct bench_resp *r, const char *name,
+			     unsigned n)
+{
+	uint8_t *p = (uint8_t *)r->buf;
+	const char *label = name;
+	size_t l;
+	unsigned i;
+
+	memset(r->buf, 0, sizeof(r->buf));
+	p[2] = 0x81;	/* response, recursion desired and available */
+	p[3] = 0x80;
+	p[5] = 1;	/* 1 question */
+	p[7] = n;	/* n answers */
+	p += 12;
+	while (*label) {
+		l = strcspn(label, ".");
+		*p++ = l;
+		memcpy(p, label, l);
+		p += l;
+		label += l;
+		if (*label == '.')
+			label++;
+	}
+	*p++ = 0;
+	*p++ = 0; *p++ = 1;	/* type A */
+	*p++ = 0; *p++ = 1;	/* class IN */
+	for (i = 0; i < n; i++) {
+		*p++ = 0xc0; *p++ = 12;	/* pointer to question name */
+		*p++ = 0; *p++ = 1;
+		*p++ = 0; *p++ = 1;
+		*p++ = 0; *p++ = 0; *p++ = 0x0e; *p++ = 0x10;	/* TTL */
+		*p++ = 0; *p++ = 4;
+		*p++ = 10; *p++ = i; *p++ = 0; *p++ = 1;
+	}
+	r->len = p - (uint8_t *)r->buf;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double bench_ns(uint64_t cycles)
+{
+	return cycles * 1e9 / rte_get_tsc_hz();
+}
+
+/**
+ * Scan the responses nscans times in turn and print scans/sec and the
+ * latency percentiles of a scan.
+ */
+static void bench_scan(unsigned names, const struct bench_resp *resp,
+		       unsigned nresp, unsigned nscans, uint64_t *lat)
+{
+	struct in_addr addr4[BENCH_MAX_ANS];
+	unsigned i, rule_id, hits = 0, exp = 0;
+	int cnt4, cnt6;
+	uint64_t t0, t1, start;
+
+	start = rte_rdtsc();
+	for (i = 0; i < nscans; i++) {
+		const struct bench_resp *r = &resp[i % nresp];
+
+		cnt4 = BENCH_MAX_ANS;
+		cnt6 = 0;
+		t0 = rte_rdtsc();
+		epc_sponsdn_scan(r->buf, r->len, NULL, &rule_id, addr4,
+				 &cnt4, NULL, NULL, &cnt6);
+		t1 = rte_rdtsc();
+		lat[i] = t1 - t0;
+		hits += (cnt4 > 0);
+		exp += r->hit;
+	}
+	t1 = rte_rdtsc();
+
+	qsort(lat, nscans, sizeof(lat[0]), bench_cmp);
+	printf("%7u names: %10.0f scans/s, ns p50 %.0f p90 %.0f p99 %.0f "
+	       "p99.9 %.0f max %.0f, %u/%u hits\n", names,
+	       nscans * (double)rte_get_tsc_hz() / (t1 - start),
+	       bench_ns(lat[nscans / 2]), bench_ns(lat[nscans * 9 / 10]),
+	       bench_ns(lat[nscans * 99 / 100]),
+	       bench_ns(lat[nscans * 999 / 1000]),
+	       bench_ns(lat[nscans - 1]), hits, exp);
+}
+
+/**
+ * Benchmark mode:
+ *	sponsdn <EAL args> -- --bench <names>[,<names>..] [responses] [scans]
+ *
+ * Grows the database to each number of sponsored names in turn, prints
+ * the compile time of the added names and of the merged database, and
+ * scans a set of synthetic responses, BENCH_HIT_PCT percent of them for
+ * a sponsored name, with 1 to BENCH_MAX_ANS A records.
+ */
+static int bench_main(int argc, char **argv)
+{
+	unsigned level[BENCH_MAX_LEVELS];
+	unsigned nlevels = 0, nresp = BENCH_RESP, nscans = BENCH_SCANS;
+	unsigned i, l, n = 0, max = 0;
+	char (*names)[MAX_DNS_NAME_LEN];
+	char miss[MAX_DNS_NAME_LEN];
+	char **dn;
+	unsigned *ids;
+	struct bench_resp *resp;
+	uint64_t *lat;
+	uint64_t t0, t1, t2;
+	unsigned merges;
+	char *tok, *save;
+	int rc;
+
+	if (argc < 1) {
+		printf("Usage: --bench <names>[,<names>..] [responses] "
+		       "[scans]\n");
+		return EXIT_FAILURE;
+	}
+	for (tok = strtok_r(argv[0], ",", &save);
+	     tok && nlevels < BENCH_MAX_LEVELS;
+	     tok = strtok_r(NULL, ",", &save)) {
+		level[nlevels] = strtoul(tok, NULL, 10);
+		max = RTE_MAX(max, level[nlevels]);
+		nlevels++;
+	}
+	if (argc > 1)
+		nresp = RTE_MAX(strtoul(argv[1], NULL, 10), 1UL);
+	if (argc > 2)
+		nscans = RTE_MAX(strtoul(argv[2], NULL, 10), 1UL);
+
+	names = malloc(sizeof(names[0]) * max);
+	dn = malloc(sizeof(dn[0]) * max);
+	ids = malloc(sizeof(ids[0]) * max);
+	resp = malloc(sizeof(resp[0]) * nresp);
+	lat = malloc(sizeof(lat[0]) * nscans);
+	if (!names || !dn || !ids || !resp || !lat) {
+		printf("bench: out of memory\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < max; i++) {
+		bench_name(i, names[i]);
+		dn[i] = names[i];
+		ids[i] = i;
+	}
+
+	rc = epc_sponsdn_create(max);
+	if (rc) {
+		printf("error allocating sponsored DN context %d\n", rc);
+		return EXIT_FAILURE;
+	}
+
+	for (l = 0; l < nlevels; l++) {
+		if (level[l] <= n)
+			continue;
+
+		/* add the names, then wait for them to be merged */
+		merges = epc_sponsdn_merge_wait();
+		t0 = rte_rdtsc();
+		rc = epc_sponsdn_dn_add_multi(&dn[n], &ids[n], level[l] - n);
+		t1 = rte_rdtsc();
+		if (rc) {
+			printf("failed to add DN error code %d\n", rc);
+			return rc;
+		}
+		/* few added names stay in the delta database */
+		if (epc_sponsdn_merge_wait() == merges) {
+			printf("%7u names: compiled %u added names in %.1f ms, "
+			       "merged database in n/a\n", level[l],
+			       level[l] - n, bench_ns(t1 - t0) / 1e6);
+		} else {
+			t2 = rte_rdtsc();
+			printf("%7u names: compiled %u added names in %.1f ms, "
+			       "merged database in %.1f ms\n", level[l],
+			       level[l] - n, bench_ns(t1 - t0) / 1e6,
+			       bench_ns(t2 - t1) / 1e6);
+		}
+		n = level[l];
+
+		for (i = 0; i < nresp; i++) {
+			resp[i].hit = (rte_rand() % 100) < BENCH_HIT_PCT;
+			if (resp[i].hit) {
+				bench_resp_build(&resp[i],
+						 names[rte_rand() % n],
+						 1 + rte_rand() % BENCH_MAX_ANS);
+				continue;
+			}
+			snprintf(miss, sizeof(miss), "www%u.unsponsored.net", i);
+			bench_resp_build(&resp[i], miss,
+					 1 + rte_rand() % BENCH_MAX_ANS);
+		}
+		bench_scan(n, resp, nresp, nscans, lat);
+	}
+
+	epc_sponsdn_free();
+	free(lat);
+	free(resp);
+	free(ids);
+	free(dn);
+	free(names);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	int rc;
@@ -162,6 +390,9 @@ int main(int argc, char **argv)
 
 	ret++;
 
+	if (ret < argc && !strcmp(argv[ret], "--bench"))
+		return bench_main(argc - ret - 1, &argv[ret + 1]);
+
 	for (i = 0; i < MAX_DN; i++)
 		hname_tbl[i] = (char *)&hname[i];
 